@@ -0,0 +1,471 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+#include <sstream> // stringstream
+#include <stdexcept>
+
+#include <QtCore/QDateTime>
+#include <QtCore/QString>
+
+#include "Global/GitVersion.h"
+
+#include "Engine/AppManager.h"
+#include "Engine/ImageConvertSIMD.h"
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+struct RegisteredBenchmark
+{
+    std::string group;
+    std::string name;
+    BenchmarkFunction func;
+};
+
+struct BenchmarkOptions
+{
+    std::vector<RegisteredBenchmark> benchmarks;
+    std::string rendererPath;
+    std::string projectsPath;
+};
+
+// Created on first use: the benchmarks are registered by the constructors of static objects
+BenchmarkOptions&
+getOptions()
+{
+    static BenchmarkOptions options;
+
+    return options;
+}
+
+void
+writeJSONString(std::ostream& os,
+                const std::string& str)
+{
+    os << '"';
+    for (std::size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = (unsigned char)str[i];
+        if ( (c == '"') || (c == '\\') ) {
+            os << '\\' << (char)c;
+        } else if (c < 0x20) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+        } else {
+            os << (char)c;
+        }
+    }
+    os << '"';
+}
+
+const char*
+getInstructionSetName(ImageConvertSIMD::InstructionSetEnum set)
+{
+    switch (set) {
+    case ImageConvertSIMD::eInstructionSetSSE41:
+
+        return "SSE4.1";
+    case ImageConvertSIMD::eInstructionSetAVX2:
+
+        return "AVX2";
+    case ImageConvertSIMD::eInstructionSetScalar:
+    default:
+
+        return "scalar";
+    }
+}
+
+struct BenchmarkStatistics
+{
+    double min;
+    double median;
+    double mean;
+    double stddev;
+};
+
+BenchmarkStatistics
+computeStatistics(std::vector<double> samples)
+{
+    assert( !samples.empty() );
+    BenchmarkStatistics stats;
+    std::sort( samples.begin(), samples.end() );
+    const std::size_t n = samples.size();
+    stats.min = samples[0];
+    stats.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2.;
+    double sum = 0.;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += samples[i];
+    }
+    stats.mean = sum / n;
+    double var = 0.;
+    for (std::size_t i = 0; i < n; ++i) {
+        var += (samples[i] - stats.mean) * (samples[i] - stats.mean);
+    }
+    stats.stddev = n > 1 ? std::sqrt( var / (n - 1) ) : 0.;
+
+    return stats;
+}
+
+/// Prints a time in seconds with a readable unit
+std::string
+formatTime(double t)
+{
+    std::stringstream ss;
+
+    ss << std::fixed << std::setprecision(3);
+    if (t < 1e-6) {
+        ss << t * 1e9 << " ns";
+    } else if (t < 1e-3) {
+        ss << t * 1e6 << " us";
+    } else if (t < 1.) {
+        ss << t * 1e3 << " ms";
+    } else {
+        ss << t << " s";
+    }
+
+    return ss.str();
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+BenchmarkState::BenchmarkState(int nSamples)
+    : _nSamples( std::max(1, nSamples) )
+    , _skipped(false)
+    , _skipReason()
+    , _label()
+    , _nItems(0)
+    , _nBytes(0)
+    , _iterationsPerSample(0)
+    , _iteration(0)
+    , _calibrating(true)
+    , _paused(false)
+    , _clock()
+    , _sampleClock()
+    , _totalClock()
+    , _sampleTime(0)
+    , _samples()
+{
+}
+
+void
+BenchmarkState::startSample()
+{
+    _iteration = 1;
+    _sampleTime = 0;
+    _paused = false;
+    _clock.start();
+    _sampleClock.start();
+}
+
+bool
+BenchmarkState::keepRunning()
+{
+    if (_skipped) {
+        return false;
+    }
+    if (_iteration < _iterationsPerSample) {
+        ++_iteration;
+
+        return true;
+    }
+
+    if (_iterationsPerSample == 0) {
+        // First iteration
+        _iterationsPerSample = 1;
+        _totalClock.start();
+        startSample();
+
+        return true;
+    }
+
+    // End of a sample
+    if (!_paused) {
+        _sampleTime += _clock.nsecsElapsed();
+    }
+    const double sampleTime = _sampleTime * 1e-9;
+    if (_calibrating) {
+        const double wallTime = _sampleClock.nsecsElapsed() * 1e-9;
+        if ( (sampleTime >= NATRON_BENCHMARK_MIN_SAMPLE_TIME) || (wallTime * 2. >= NATRON_BENCHMARK_MAX_CALIBRATION_TIME) ) {
+            // This sample was the warm-up
+            _calibrating = false;
+        } else {
+            // Aim a bit above the minimum, at most 10 times more iterations at once, within the maximum wall clock time
+            double factor = sampleTime > 0. ? NATRON_BENCHMARK_MIN_SAMPLE_TIME * 1.2 / sampleTime : 10.;
+            factor = std::min( factor, NATRON_BENCHMARK_MAX_CALIBRATION_TIME / std::max(wallTime, 1e-9) );
+            _iterationsPerSample = (U64)std::ceil( _iterationsPerSample * std::min( 10., std::max(2., factor) ) );
+        }
+    } else {
+        _samples.push_back(sampleTime / _iterationsPerSample);
+        if ( ( (int)_samples.size() >= _nSamples ) ||
+             ( ( (int)_samples.size() >= NATRON_BENCHMARK_MIN_SAMPLES ) && (_totalClock.elapsed() * 1e-3 >= NATRON_BENCHMARK_MAX_TIME) ) ) {
+            return false;
+        }
+    }
+    startSample();
+
+    return true;
+} // BenchmarkState::keepRunning
+
+void
+BenchmarkState::pauseTiming()
+{
+    assert(!_paused);
+    _sampleTime += _clock.nsecsElapsed();
+    _paused = true;
+}
+
+void
+BenchmarkState::resumeTiming()
+{
+    assert(_paused);
+    _paused = false;
+    _clock.start();
+}
+
+void
+BenchmarkState::setItemsProcessed(U64 nItems)
+{
+    _nItems = nItems;
+}
+
+void
+BenchmarkState::setBytesProcessed(U64 nBytes)
+{
+    _nBytes = nBytes;
+}
+
+void
+BenchmarkState::setLabel(const std::string& label)
+{
+    _label = label;
+}
+
+void
+BenchmarkState::setMaxSamples(int nSamples)
+{
+    _nSamples = std::max( 1, std::min(_nSamples, nSamples) );
+}
+
+void
+BenchmarkState::skip(const std::string& reason)
+{
+    _skipped = true;
+    _skipReason = reason;
+}
+
+bool
+BenchmarkState::isSkipped() const
+{
+    return _skipped;
+}
+
+const std::string&
+BenchmarkState::getSkipReason() const
+{
+    return _skipReason;
+}
+
+const std::string&
+BenchmarkState::getLabel() const
+{
+    return _label;
+}
+
+U64
+BenchmarkState::getItemsProcessed() const
+{
+    return _nItems;
+}
+
+U64
+BenchmarkState::getBytesProcessed() const
+{
+    return _nBytes;
+}
+
+U64
+BenchmarkState::getIterationsPerSample() const
+{
+    return _iterationsPerSample;
+}
+
+const std::vector<double>&
+BenchmarkState::getSamples() const
+{
+    return _samples;
+}
+
+void
+BenchmarkRunner::registerBenchmark(const char* group,
+                                   const char* name,
+                                   BenchmarkFunction func)
+{
+    RegisteredBenchmark b;
+
+    b.group = group;
+    b.name = name;
+    b.func = func;
+    getOptions().benchmarks.push_back(b);
+}
+
+void
+BenchmarkRunner::list(std::ostream& os)
+{
+    const std::vector<RegisteredBenchmark>& benchmarks = getOptions().benchmarks;
+
+    for (std::size_t i = 0; i < benchmarks.size(); ++i) {
+        os << benchmarks[i].group << '/' << benchmarks[i].name << std::endl;
+    }
+}
+
+int
+BenchmarkRunner::run(const std::string& filter,
+                     int nSamples,
+                     std::ostream& out,
+                     std::ostream& json)
+{
+    const std::vector<RegisteredBenchmark>& benchmarks = getOptions().benchmarks;
+    const ImageConvertSIMD::InstructionSetEnum instructionSet = ImageConvertSIMD::getSupportedInstructionSet();
+
+    json << std::setprecision(9);
+    json << "{\n\"context\":{\"version\":";
+    writeJSONString(json, NATRON_VERSION_STRING);
+    json << ",\"commit\":";
+    writeJSONString(json, GIT_COMMIT);
+    json << ",\"date\":";
+    writeJSONString( json, QDateTime::currentDateTime().toString(Qt::ISODate).toStdString() );
+    json << ",\"hardwareThreads\":" << appPTR->getHardwareIdealThreadCount()
+         << ",\"maxThreads\":" << appPTR->getMaxThreadCount()
+         << ",\"instructionSet\":\"" << getInstructionSetName(instructionSet) << '"'
+         << ",\"samples\":" << nSamples << "},\n\"benchmarks\":[";
+
+    int nFailed = 0;
+    bool first = true;
+    for (std::size_t i = 0; i < benchmarks.size(); ++i) {
+        const std::string fullName = benchmarks[i].group + '/' + benchmarks[i].name;
+        if ( !filter.empty() && (fullName.find(filter) == std::string::npos) ) {
+            continue;
+        }
+        out << std::left << std::setw(40) << fullName << std::flush;
+
+        BenchmarkState state(nSamples);
+        std::string error;
+        try {
+            benchmarks[i].func(state);
+            if ( !state.isSkipped() && state.getSamples().empty() ) {
+                error = "the benchmark did not run its loop";
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        json << (first ? "\n" : ",\n") << "{\"name\":";
+        first = false;
+        writeJSONString(json, fullName);
+        if ( !error.empty() ) {
+            ++nFailed;
+            out << "FAILED: " << error << std::endl;
+            json << ",\"error\":";
+            writeJSONString(json, error);
+            json << '}';
+            continue;
+        }
+        if ( state.isSkipped() ) {
+            out << "skipped: " << state.getSkipReason() << std::endl;
+            json << ",\"skipped\":";
+            writeJSONString( json, state.getSkipReason() );
+            json << '}';
+            continue;
+        }
+
+        const std::vector<double>& samples = state.getSamples();
+        const BenchmarkStatistics stats = computeStatistics(samples);
+        out << std::right << std::setw(14) << formatTime(stats.median) << " +- " << std::setw(5) << std::fixed << std::setprecision(1)
+            << (stats.mean > 0. ? stats.stddev / stats.mean * 100. : 0.) << '%';
+        if ( state.getItemsProcessed() && (stats.median > 0.) ) {
+            out << std::setw(14) << std::setprecision(1) << state.getItemsProcessed() / stats.median << " items/s";
+        }
+        if ( state.getBytesProcessed() && (stats.median > 0.) ) {
+            out << std::setw(10) << std::setprecision(1) << state.getBytesProcessed() / stats.median / (1024. * 1024.) << " MiB/s";
+        }
+        if ( !state.getLabel().empty() ) {
+            out << "  (" << state.getLabel() << ')';
+        }
+        out.unsetf(std::ios::floatfield);
+        out << std::left << std::setprecision(6) << std::endl;
+
+        if ( !state.getLabel().empty() ) {
+            json << ",\"label\":";
+            writeJSONString( json, state.getLabel() );
+        }
+        json << ",\"unit\":\"s\",\"iterationsPerSample\":" << state.getIterationsPerSample()
+             << ",\"min\":" << stats.min << ",\"median\":" << stats.median << ",\"mean\":" << stats.mean << ",\"stddev\":" << stats.stddev;
+        if ( state.getItemsProcessed() && (stats.median > 0.) ) {
+            json << ",\"itemsPerSecond\":" << state.getItemsProcessed() / stats.median;
+        }
+        if ( state.getBytesProcessed() && (stats.median > 0.) ) {
+            json << ",\"bytesPerSecond\":" << state.getBytesProcessed() / stats.median;
+        }
+        json << ",\"samples\":[";
+        for (std::size_t s = 0; s < samples.size(); ++s) {
+            json << (s ? "," : "") << samples[s];
+        }
+        json << "]}";
+    }
+    json << "\n]}\n";
+
+    return nFailed;
+} // BenchmarkRunner::run
+
+void
+BenchmarkRunner::setRendererPath(const std::string& path)
+{
+    getOptions().rendererPath = path;
+}
+
+const std::string&
+BenchmarkRunner::getRendererPath()
+{
+    return getOptions().rendererPath;
+}
+
+void
+BenchmarkRunner::setProjectsPath(const std::string& path)
+{
+    getOptions().projectsPath = path;
+}
+
+const std::string&
+BenchmarkRunner::getProjectsPath()
+{
+    return getOptions().projectsPath;
+}
+
+NATRON_NAMESPACE_EXIT
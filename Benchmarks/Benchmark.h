@@ -0,0 +1,214 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Benchmarks_Benchmark_h
+#define Benchmarks_Benchmark_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <QtCore/QElapsedTimer>
+
+#include "Global/GlobalDefines.h"
+
+// Minimum duration of a sample, in seconds: fast benchmarks run several iterations per sample
+#define NATRON_BENCHMARK_MIN_SAMPLE_TIME 0.01
+
+// Maximum wall clock duration of a sample during the calibration, in seconds: when most of an iteration is not measured
+// (see BenchmarkState::pauseTiming()), the samples may not reach NATRON_BENCHMARK_MIN_SAMPLE_TIME
+#define NATRON_BENCHMARK_MAX_CALIBRATION_TIME 0.5
+
+// Default number of samples of a benchmark
+#define NATRON_BENCHMARK_DEFAULT_SAMPLES 10
+
+// Once a benchmark has run for this many seconds, it stops after NATRON_BENCHMARK_MIN_SAMPLES samples
+#define NATRON_BENCHMARK_MAX_TIME 20.
+#define NATRON_BENCHMARK_MIN_SAMPLES 3
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The state of a running benchmark. The function of a benchmark does its setup, then measures the body of the loop:
+ *
+ *     while ( state.keepRunning() ) {
+ *         ...
+ *     }
+ *
+ * The first iterations calibrate the number of iterations per sample so that a sample lasts at least
+ * NATRON_BENCHMARK_MIN_SAMPLE_TIME, and warm up the caches and the thread pool: they are not measured.
+ **/
+class BenchmarkState
+{
+public:
+
+    explicit BenchmarkState(int nSamples);
+
+    /**
+     * @brief Returns true while the body of the loop must be run again
+     **/
+    bool keepRunning();
+
+    /**
+     * @brief The time spent between pauseTiming() and resumeTiming() is not measured, e.g to reset what an iteration changed
+     **/
+    void pauseTiming();
+
+    void resumeTiming();
+
+    /**
+     * @brief The number of items (pixels, frames, lookups...) processed by each iteration, to report a throughput
+     **/
+    void setItemsProcessed(U64 nItems);
+
+    /**
+     * @brief The number of bytes processed by each iteration, to report a bandwidth
+     **/
+    void setBytesProcessed(U64 nBytes);
+
+    /**
+     * @brief A description of what is measured, e.g. the instruction set or the image size
+     **/
+    void setLabel(const std::string& label);
+
+    /**
+     * @brief Lowers the number of samples, for slow benchmarks. Must be called before the loop.
+     **/
+    void setMaxSamples(int nSamples);
+
+    /**
+     * @brief Marks the benchmark as skipped, e.g when a plug-in it needs is missing. keepRunning() then returns false.
+     **/
+    void skip(const std::string& reason);
+
+    bool isSkipped() const;
+
+    const std::string& getSkipReason() const;
+
+    const std::string& getLabel() const;
+
+    U64 getItemsProcessed() const;
+
+    U64 getBytesProcessed() const;
+
+    U64 getIterationsPerSample() const;
+
+    /**
+     * @brief The time of an iteration in each sample, in seconds
+     **/
+    const std::vector<double>& getSamples() const;
+
+private:
+
+    void startSample();
+
+    int _nSamples;
+    bool _skipped;
+    std::string _skipReason;
+    std::string _label;
+    U64 _nItems;
+    U64 _nBytes;
+
+    // 0 before the first iteration
+    U64 _iterationsPerSample;
+    U64 _iteration;
+    bool _calibrating;
+    bool _paused;
+    QElapsedTimer _clock;
+    QElapsedTimer _sampleClock; // wall clock of the sample, including the pauses
+    QElapsedTimer _totalClock;
+    qint64 _sampleTime; // in nanoseconds
+    std::vector<double> _samples;
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState& state);
+
+/**
+ * @brief The benchmarks registered with NATRON_BENCHMARK, and the options of the run
+ **/
+class BenchmarkRunner
+{
+public:
+
+    static void registerBenchmark(const char* group, const char* name, BenchmarkFunction func);
+
+    /**
+     * @brief Prints the names of the benchmarks, one per line
+     **/
+    static void list(std::ostream& os);
+
+    /**
+     * @brief Runs the benchmarks whose name ("group/name") contains filter, prints their results to out
+     * and writes them to json. Returns the number of benchmarks that failed.
+     **/
+    static int run(const std::string& filter, int nSamples, std::ostream& out, std::ostream& json);
+
+    /**
+     * @brief The NatronRenderer executable used by the end-to-end benchmarks
+     **/
+    static void setRendererPath(const std::string& path);
+
+    static const std::string& getRendererPath();
+
+    /**
+     * @brief The directory of the synthetic projects rendered by the end-to-end benchmarks
+     **/
+    static void setProjectsPath(const std::string& path);
+
+    static const std::string& getProjectsPath();
+};
+
+class BenchmarkRegistrar
+{
+public:
+
+    BenchmarkRegistrar(const char* group,
+                       const char* name,
+                       BenchmarkFunction func)
+    {
+        BenchmarkRunner::registerBenchmark(group, name, func);
+    }
+};
+
+/**
+ * @brief Defines and registers the benchmark group/name, e.g.
+ *
+ *     NATRON_BENCHMARK(Curve, GetValueAt)
+ *     {
+ *         ...
+ *         while ( state.keepRunning() ) {
+ *             ...
+ *         }
+ *     }
+ **/
+#define NATRON_BENCHMARK(group, name) \
+    static void group ## _ ## name ## _Benchmark(NATRON_NAMESPACE::BenchmarkState & state); \
+    static NATRON_NAMESPACE::BenchmarkRegistrar group ## _ ## name ## _Registrar(# group, # name, group ## _ ## name ## _Benchmark); \
+    static void group ## _ ## name ## _Benchmark(NATRON_NAMESPACE::BenchmarkState & state)
+
+NATRON_NAMESPACE_EXIT
+
+#endif // Benchmarks_Benchmark_h
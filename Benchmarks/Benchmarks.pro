@@ -0,0 +1,63 @@
+# ***** BEGIN LICENSE BLOCK *****
+# This file is part of Natron <https://natrongithub.github.io/>,
+# Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+#
+# Natron is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# Natron is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+# ***** END LICENSE BLOCK *****
+
+# Benchmarks of the engine, without GUI. Run "Benchmarks --help" for the options,
+# and compare two result files with compare.py.
+
+QT       += core network
+QT       -= gui
+greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
+
+TARGET = Benchmarks
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += moc
+CONFIG += boost boost-serialization-lib qt cairo python shiboken pyside
+CONFIG += static-engine static-host-support static-breakpadclient static-libmv static-openmvg static-ceres static-libtess
+
+!noexpat: CONFIG += expat
+
+TEMPLATE = app
+
+# The synthetic projects rendered by the Render benchmarks, see the --projects option
+DEFINES += NATRON_BENCHMARK_PROJECTS_PATH=\\\"$$PWD/Projects\\\"
+
+include(../global.pri)
+
+SOURCES += \
+    Benchmark.cpp \
+    Cache_Benchmark.cpp \
+    Curve_Benchmark.cpp \
+    Expression_Benchmark.cpp \
+    Hash64_Benchmark.cpp \
+    Image_Benchmark.cpp \
+    Lut_Benchmark.cpp \
+    Render_Benchmark.cpp \
+    Roto_Benchmark.cpp \
+    TLSHolder_Benchmark.cpp \
+    Viewer_Benchmark.cpp \
+    main.cpp
+
+HEADERS += \
+    Benchmark.h
+
+OTHER_FILES += \
+    compare.py \
+    Projects/BlurMerge.py \
+    Projects/ColorCorrect.py \
+    Projects/RotoTransform.py
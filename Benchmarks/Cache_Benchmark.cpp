@@ -0,0 +1,190 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <list>
+#include <sstream> // stringstream
+#include <stdexcept>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/bind.hpp>
+#endif
+
+#include <QtCore/QAtomicInt>
+
+#include "Engine/AppManager.h"
+#include "Engine/Image.h"
+#include "Engine/ImageKey.h"
+#include "Engine/TaskScheduler.h"
+#include "Engine/ViewIdx.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+// The size of the images: a tile
+#define CACHE_BENCHMARK_IMAGE_SIZE 64
+
+// Number of images looked up by the Get benchmarks
+#define CACHE_BENCHMARK_N_IMAGES 256
+
+// Number of operations of each thread per iteration
+#define CACHE_BENCHMARK_LOOKUPS_PER_THREAD 256
+#define CACHE_BENCHMARK_INSERTS_PER_THREAD 16
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The hashes of the keys of the images inserted, unique across iterations
+QAtomicInt nextHash(1);
+
+ImageKey
+makeKey(U64 hash)
+{
+    return ImageKey(0, hash, false, 0, ViewIdx(0), 1., false, false);
+}
+
+ImageParamsPtr
+makeParams()
+{
+    const RectI bounds(0, 0, CACHE_BENCHMARK_IMAGE_SIZE, CACHE_BENCHMARK_IMAGE_SIZE);
+    const RectD rod(0, 0, CACHE_BENCHMARK_IMAGE_SIZE, CACHE_BENCHMARK_IMAGE_SIZE);
+
+    return Image::makeParams(rod, bounds, 1., 0, false, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat,
+                             eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+}
+
+/// Inserts nImages new images in the cache, like the renders of the tiles
+void
+insertImages(const ImageParamsPtr& params,
+             int nImages,
+             int /*threadIndex*/)
+{
+    for (int i = 0; i < nImages; ++i) {
+        ImagePtr image;
+        appPTR->getImageOrCreate(makeKey( (U64)nextHash.fetchAndAddOrdered(1) ), params, &image);
+        if (!image) {
+            throw std::runtime_error("Failed to allocate an image");
+        }
+        image->allocateMemory();
+    }
+}
+
+/// Looks up the images of keys in an order that depends on the thread
+void
+lookupImages(const std::vector<ImageKey>* keys,
+             int threadIndex)
+{
+    std::list<ImagePtr> images;
+
+    for (int i = 0; i < CACHE_BENCHMARK_LOOKUPS_PER_THREAD; ++i) {
+        const ImageKey& key = (*keys)[(threadIndex * 7919 + i * 31) % keys->size()];
+        images.clear();
+        if ( !appPTR->getImage(key, &images) ) {
+            throw std::runtime_error("An image was evicted from the cache");
+        }
+    }
+}
+
+std::string
+getThreadsLabel(int nThreads)
+{
+    std::stringstream ss;
+
+    ss << nThreads << " thread(s)";
+
+    return ss.str();
+}
+
+void
+benchmarkInsert(BenchmarkState& state,
+                int nThreads)
+{
+    const ImageParamsPtr params = makeParams();
+
+    appPTR->clearNodeCache();
+    state.setLabel( getThreadsLabel(nThreads) );
+    state.setItemsProcessed(nThreads * CACHE_BENCHMARK_INSERTS_PER_THREAD);
+    while ( state.keepRunning() ) {
+        appPTR->getTaskScheduler()->parallelFor( nThreads, boost::bind(&insertImages, params, CACHE_BENCHMARK_INSERTS_PER_THREAD, _1) );
+    }
+    appPTR->clearNodeCache();
+}
+
+void
+benchmarkGet(BenchmarkState& state,
+             int nThreads)
+{
+    const ImageParamsPtr params = makeParams();
+    std::vector<ImageKey> keys;
+    // Keep the images alive, so that they cannot be evicted
+    std::vector<ImagePtr> images;
+
+    appPTR->clearNodeCache();
+    for (int i = 0; i < CACHE_BENCHMARK_N_IMAGES; ++i) {
+        keys.push_back( makeKey( (U64)nextHash.fetchAndAddOrdered(1) ) );
+        ImagePtr image;
+        appPTR->getImageOrCreate(keys.back(), params, &image);
+        if (!image) {
+            state.skip("Failed to allocate an image");
+
+            return;
+        }
+        image->allocateMemory();
+        images.push_back(image);
+    }
+    state.setLabel( getThreadsLabel(nThreads) );
+    state.setItemsProcessed(nThreads * CACHE_BENCHMARK_LOOKUPS_PER_THREAD);
+    while ( state.keepRunning() ) {
+        appPTR->getTaskScheduler()->parallelFor( nThreads, boost::bind(&lookupImages, &keys, _1) );
+    }
+    images.clear();
+    appPTR->clearNodeCache();
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+NATRON_BENCHMARK(Cache, Get)
+{
+    benchmarkGet(state, 1);
+}
+
+// All the threads of the pool look up images at the same time, as the tiles of a render do
+NATRON_BENCHMARK(Cache, GetContended)
+{
+    benchmarkGet( state, std::max( 1, appPTR->getMaxThreadCount() ) );
+}
+
+NATRON_BENCHMARK(Cache, Insert)
+{
+    benchmarkInsert(state, 1);
+}
+
+NATRON_BENCHMARK(Cache, InsertContended)
+{
+    benchmarkInsert( state, std::max( 1, appPTR->getMaxThreadCount() ) );
+}
@@ -0,0 +1,128 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <vector>
+
+#include "Engine/Curve.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+#define CURVE_BENCHMARK_KEYFRAMES 100
+#define CURVE_BENCHMARK_TIMES 10000
+
+static volatile double curveSink;
+
+/// A curve with nKeys keyframes of the given interpolation, one every 10 frames
+static void
+makeCurve(Curve* curve,
+          int nKeys,
+          KeyframeTypeEnum interp)
+{
+    for (int i = 0; i < nKeys; ++i) {
+        ignore_result( curve->addKeyFrame( KeyFrame(i * 10., std::sin(i * 0.7) * 100., 0., 0., interp) ) );
+    }
+}
+
+/// Times spread over the curve, and a bit outside
+static void
+makeTimes(std::vector<double>* times,
+          int nKeys)
+{
+    const int n = CURVE_BENCHMARK_TIMES;
+
+    times->resize(n);
+    for (int i = 0; i < n; ++i) {
+        (*times)[i] = -10. + (nKeys * 10. + 20.) * i / n;
+    }
+}
+
+static void
+benchmarkGetValueAt(BenchmarkState& state,
+                    KeyframeTypeEnum interp)
+{
+    Curve curve;
+
+    makeCurve(&curve, CURVE_BENCHMARK_KEYFRAMES, interp);
+    std::vector<double> times;
+    makeTimes(&times, CURVE_BENCHMARK_KEYFRAMES);
+    state.setItemsProcessed( times.size() );
+    while ( state.keepRunning() ) {
+        double sum = 0.;
+        for (std::size_t i = 0; i < times.size(); ++i) {
+            sum += curve.getValueAt(times[i]);
+        }
+        curveSink = sum;
+    }
+}
+
+NATRON_BENCHMARK(Curve, GetValueAtLinear)
+{
+    benchmarkGetValueAt(state, eKeyframeTypeLinear);
+}
+
+NATRON_BENCHMARK(Curve, GetValueAtSmooth)
+{
+    benchmarkGetValueAt(state, eKeyframeTypeSmooth);
+}
+
+NATRON_BENCHMARK(Curve, GetValueAtCatmullRom)
+{
+    benchmarkGetValueAt(state, eKeyframeTypeCatmullRom);
+}
+
+// The batched evaluation used by the curve editor and the motion blur
+NATRON_BENCHMARK(Curve, GetValuesAt)
+{
+    Curve curve;
+
+    makeCurve(&curve, CURVE_BENCHMARK_KEYFRAMES, eKeyframeTypeSmooth);
+    std::vector<double> times;
+    makeTimes(&times, CURVE_BENCHMARK_KEYFRAMES);
+    std::vector<double> values( times.size() );
+    state.setItemsProcessed( times.size() );
+    while ( state.keepRunning() ) {
+        curve.getValuesAt( &times[0], &values[0], (int)times.size() );
+        curveSink = values[0];
+    }
+}
+
+// A modification invalidates the snapshot of the keyframes, which the next evaluation rebuilds
+NATRON_BENCHMARK(Curve, ModifyAndEvaluate)
+{
+    Curve curve;
+
+    makeCurve(&curve, CURVE_BENCHMARK_KEYFRAMES, eKeyframeTypeSmooth);
+    state.setItemsProcessed(1);
+    int i = 0;
+    while ( state.keepRunning() ) {
+        ignore_result( curve.addKeyFrame( KeyFrame(5. + (i % CURVE_BENCHMARK_KEYFRAMES) * 10., i * 0.1, 0., 0., eKeyframeTypeSmooth) ) );
+        curveSink = curve.getValueAt(i % (CURVE_BENCHMARK_KEYFRAMES * 10));
+        ++i;
+    }
+}
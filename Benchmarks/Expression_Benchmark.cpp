@@ -0,0 +1,142 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <exception>
+#include <string>
+
+#include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/CreateNodeArgs.h"
+#include "Engine/KnobExpression.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/Node.h"
+#include "Engine/Project.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+// Number of frames at which the expression is evaluated per iteration
+#define EXPRESSION_BENCHMARK_TIMES 1000
+
+// Keeps the results alive, so that the compiler does not remove the code measured
+static volatile double expressionSink;
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+NodePtr
+createRotoNode()
+{
+    AppInstancePtr app = appPTR->getTopLevelInstance();
+
+    if (!app) {
+        return NodePtr();
+    }
+    CreateNodeArgs args( PLUGINID_NATRON_ROTO, app->getProject() );
+    args.setProperty<bool>(kCreateNodeArgsPropNoNodeGUI, true);
+
+    return app->createNode(args);
+}
+
+/**
+ * @brief Measures the evaluation of an expression set on the opacity of a Roto node, natively (see KnobExpression)
+ * or with Python. The expression may refer to the opacity of another Roto node with the {other} placeholder.
+ * The results cached by the knob are cleared before each iteration, so that every frame is evaluated.
+ **/
+void
+benchmarkExpression(BenchmarkState& state,
+                    const std::string& expression,
+                    bool native)
+{
+    NodePtr node = createRotoNode();
+    NodePtr other = createRotoNode();
+    KnobDoublePtr knob = node ? boost::dynamic_pointer_cast<KnobDouble>( node->getKnobByName("opacity") ) : KnobDoublePtr();
+    KnobDoublePtr otherKnob = other ? boost::dynamic_pointer_cast<KnobDouble>( other->getKnobByName("opacity") ) : KnobDoublePtr();
+
+    if (!knob || !otherKnob) {
+        state.skip("Cannot create a Roto node");
+
+        return;
+    }
+    otherKnob->setValueAtTime(0, 0., ViewSpec::all(), 0);
+    otherKnob->setValueAtTime(EXPRESSION_BENCHMARK_TIMES, 1., ViewSpec::all(), 0);
+
+    std::string expr = expression;
+    const std::string placeholder("{other}");
+    const std::size_t pos = expr.find(placeholder);
+    if (pos != std::string::npos) {
+        expr.replace( pos, placeholder.size(), other->getScriptName_mt_safe() + ".opacity" );
+    }
+    try {
+        knob->setExpression(0, expr, false, true);
+    } catch (const std::exception& e) {
+        state.skip( std::string("Invalid expression: ") + e.what() );
+
+        return;
+    }
+    KnobExpression::setEnabled(native);
+    state.setLabel(expr);
+    state.setItemsProcessed(EXPRESSION_BENCHMARK_TIMES);
+    while ( state.keepRunning() ) {
+        state.pauseTiming();
+        knob->clearExpressionsResults(0);
+        state.resumeTiming();
+        double sum = 0.;
+        for (int i = 0; i < EXPRESSION_BENCHMARK_TIMES; ++i) {
+            sum += knob->getValueAtTime(i * 0.5);
+        }
+        expressionSink = sum;
+    }
+    KnobExpression::setEnabled(true);
+    knob->clearExpression(0, true);
+    other->destroyNode(true, false);
+    node->destroyNode(true, false);
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+// Arithmetic and math functions of the frame
+NATRON_BENCHMARK(Expression, ArithmeticNative)
+{
+    benchmarkExpression(state, "frame * 2 + sin(frame)", true);
+}
+
+NATRON_BENCHMARK(Expression, ArithmeticPython)
+{
+    benchmarkExpression(state, "frame * 2 + sin(frame)", false);
+}
+
+// The value of a parameter of another node, the most common link
+NATRON_BENCHMARK(Expression, ParamNative)
+{
+    benchmarkExpression(state, "{other}.getValueAtTime(frame + 1) * 0.5", true);
+}
+
+NATRON_BENCHMARK(Expression, ParamPython)
+{
+    benchmarkExpression(state, "{other}.getValueAtTime(frame + 1) * 0.5", false);
+}
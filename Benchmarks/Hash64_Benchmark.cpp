@@ -0,0 +1,214 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm> // for std::for_each
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/crc.hpp>
+#endif
+
+#include <QtCore/QString>
+
+#include "Engine/Hash64.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+// Keeps the results alive, so that the compiler does not remove the code measured
+static volatile U64 hashSink;
+
+// Size of the node graph hashed by the NodeGraph benchmarks
+#define HASH64_BENCHMARK_NODES 500
+#define HASH64_BENCHMARK_KNOBS_PER_NODE 40
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The implementation of Hash64 prior to the streaming version, for comparison
+class LegacyHash64
+{
+public:
+    LegacyHash64()
+        : hash(0)
+    {
+    }
+
+    template<typename T>
+    void append(T value)
+    {
+        node_values.push_back( Hash64::toU64(value) );
+    }
+
+    void computeHash()
+    {
+        if ( node_values.empty() ) {
+            return;
+        }
+
+        const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
+        boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
+        crc_64 = std::for_each( data, data + node_values.size() * sizeof(node_values[0]), crc_64 );
+        hash = crc_64();
+    }
+
+    U64 value() const
+    {
+        return hash;
+    }
+
+    U64 hash;
+    std::vector<U64> node_values;
+};
+
+void
+legacyAppendQString(LegacyHash64* hash,
+                    const QString& str)
+{
+    Q_FOREACH (QChar ch, str) {
+        hash->append<unsigned short>( ch.unicode() );
+    }
+}
+
+// Mimics what a node appends to its hash: its knob values, its label, its inputs hashes and its creation time
+template<typename HASH>
+U64
+hashNode(HASH* hash,
+         int nodeIndex,
+         const std::vector<U64>& nodeHashes,
+         const std::vector<double>& knobValues,
+         const QString& label,
+         void (*appendString)(HASH*, const QString&))
+{
+    hash->append(nodeIndex);
+    for (std::size_t i = 0; i < knobValues.size(); ++i) {
+        hash->append(knobValues[i]);
+    }
+    appendString(hash, label);
+    // Each node has 2 inputs among the previous nodes
+    if (nodeIndex > 0) {
+        hash->append(nodeHashes[nodeIndex - 1]);
+        hash->append(nodeHashes[nodeIndex / 2] + 1);
+    }
+    hash->append( (double)nodeIndex * 1000. );
+    hash->computeHash();
+
+    return hash->value();
+}
+
+/// Measures the hashing of a whole node graph, as done when a knob changes upstream of the viewer
+template<typename HASH>
+void
+benchmarkNodeGraph(BenchmarkState& state,
+                   void (*appendString)(HASH*, const QString&))
+{
+    std::vector<double> knobValues(HASH64_BENCHMARK_KNOBS_PER_NODE);
+
+    for (int i = 0; i < HASH64_BENCHMARK_KNOBS_PER_NODE; ++i) {
+        knobValues[i] = i * 0.25;
+    }
+    const QString label = QString::fromUtf8("Transform_node_with_a_label_of_average_length");
+    std::vector<U64> nodeHashes(HASH64_BENCHMARK_NODES);
+
+    state.setItemsProcessed(HASH64_BENCHMARK_NODES);
+    while ( state.keepRunning() ) {
+        for (int n = 0; n < HASH64_BENCHMARK_NODES; ++n) {
+            HASH hash;
+            nodeHashes[n] = hashNode<HASH>(&hash, n, nodeHashes, knobValues, label, appendString);
+        }
+        hashSink = nodeHashes.back();
+    }
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+// The hash of a node: its knob values, a few hundred words
+NATRON_BENCHMARK(Hash64, AppendValues)
+{
+    const int nValues = 512;
+    std::vector<double> values(nValues);
+
+    for (int i = 0; i < nValues; ++i) {
+        values[i] = i * 0.1;
+    }
+    state.setItemsProcessed(nValues);
+    state.setBytesProcessed( nValues * sizeof(U64) );
+    while ( state.keepRunning() ) {
+        Hash64 hash;
+        for (int i = 0; i < nValues; ++i) {
+            hash.append(values[i]);
+        }
+        hash.computeHash();
+        hashSink = hash.value();
+    }
+}
+
+// Large blocks, e.g. strings and keyframes
+NATRON_BENCHMARK(Hash64, AppendBytes)
+{
+    const std::size_t nBytes = 1024 * 1024;
+    std::vector<unsigned char> data(nBytes);
+
+    for (std::size_t i = 0; i < nBytes; ++i) {
+        data[i] = (unsigned char)(i * 7);
+    }
+    state.setBytesProcessed(nBytes);
+    while ( state.keepRunning() ) {
+        Hash64 hash;
+        hash.appendBytes(&data[0], nBytes);
+        hash.computeHash();
+        hashSink = hash.value();
+    }
+}
+
+// Many short hashes, e.g. the image keys of the cache
+NATRON_BENCHMARK(Hash64, ShortHashes)
+{
+    const int nHashes = 1000;
+
+    state.setItemsProcessed(nHashes);
+    while ( state.keepRunning() ) {
+        for (int i = 0; i < nHashes; ++i) {
+            Hash64 hash;
+            hash.append<U64>(i);
+            hash.append<double>(i * 0.5);
+            hash.append<int>(3);
+            hash.computeHash();
+            hashSink = hash.value();
+        }
+    }
+}
+
+NATRON_BENCHMARK(Hash64, NodeGraph)
+{
+    benchmarkNodeGraph<Hash64>(state, Hash64_appendQString);
+}
+
+// The same graph hashed with the former crc64 implementation
+NATRON_BENCHMARK(Hash64, NodeGraphCrc64)
+{
+    benchmarkNodeGraph<LegacyHash64>(state, legacyAppendQString);
+}
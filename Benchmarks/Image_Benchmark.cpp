@@ -0,0 +1,233 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#include "Engine/Image.h"
+#include "Engine/ImageConvertSIMD.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+// An HD frame
+#define IMAGE_BENCHMARK_WIDTH 1920
+#define IMAGE_BENCHMARK_HEIGHT 1080
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/// Fills the image with a ramp, which covers the whole range of the look-up tables
+void
+fillRamp(Image* image)
+{
+    const RectI& bounds = image->getBounds();
+    const int nComps = image->getComponentsCount();
+    const int rowElements = bounds.width() * nComps;
+    Image::WriteAccess acc(image);
+
+    for (int y = bounds.y1; y < bounds.y2; ++y) {
+        unsigned char* row = acc.pixelAt(bounds.x1, y);
+        for (int i = 0; i < rowElements; ++i) {
+            const float v = (float)( (i + y) % 1024 ) / 1023.f;
+            switch ( image->getBitDepth() ) {
+            case eImageBitDepthByte:
+                row[i] = (unsigned char)(v * 255.f);
+                break;
+            case eImageBitDepthShort:
+                ( (unsigned short*)row )[i] = (unsigned short)(v * 65535.f);
+                break;
+            case eImageBitDepthFloat:
+                ( (float*)row )[i] = v;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+const char*
+getDepthName(ImageBitDepthEnum depth)
+{
+    switch (depth) {
+    case eImageBitDepthByte:
+
+        return "8u";
+    case eImageBitDepthShort:
+
+        return "16u";
+    case eImageBitDepthFloat:
+
+        return "32f";
+    default:
+
+        return "?";
+    }
+}
+
+/**
+ * @brief Measures the conversion of an HD frame with the given instruction set. If scalar is false, the best
+ * instruction set supported is used.
+ **/
+void
+benchmarkConvertToFormat(BenchmarkState& state,
+                         const ImagePlaneDesc& srcComps,
+                         ImageBitDepthEnum srcDepth,
+                         ViewerColorSpaceEnum srcColorSpace,
+                         const ImagePlaneDesc& dstComps,
+                         ImageBitDepthEnum dstDepth,
+                         ViewerColorSpaceEnum dstColorSpace,
+                         bool requiresUnpremult,
+                         bool scalar)
+{
+    const RectI bounds(0, 0, IMAGE_BENCHMARK_WIDTH, IMAGE_BENCHMARK_HEIGHT);
+    const RectD rod(0, 0, IMAGE_BENCHMARK_WIDTH, IMAGE_BENCHMARK_HEIGHT);
+    Image srcImg(srcComps, rod, bounds, 0, 1., srcDepth, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+    Image dstImg(dstComps, rod, bounds, 0, 1., dstDepth, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+
+    fillRamp(&srcImg);
+
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    const ImageConvertSIMD::InstructionSetEnum set = scalar ? ImageConvertSIMD::eInstructionSetScalar : supported;
+    ImageConvertSIMD::setInstructionSet(set);
+
+    std::string label = std::string(getDepthName(srcDepth)) + " -> " + getDepthName(dstDepth) + ", instruction set ";
+    label += set == ImageConvertSIMD::eInstructionSetScalar ? "scalar" : (set == ImageConvertSIMD::eInstructionSetSSE41 ? "SSE4.1" : "AVX2");
+    state.setLabel(label);
+    state.setItemsProcessed( bounds.area() );
+    state.setBytesProcessed( (U64)bounds.area() * srcComps.getNumComponents() * getSizeOfForBitDepth(srcDepth) );
+    while ( state.keepRunning() ) {
+        srcImg.convertToFormat(bounds, srcColorSpace, dstColorSpace, -1, false, requiresUnpremult, &dstImg);
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
+
+/**
+ * @brief Measures the downscaling of an HD frame to the given mipmap level, as done to build the mipmaps of the renders
+ * at a lower scale. If scalar is false, the best instruction set supported is used.
+ **/
+void
+benchmarkDownscale(BenchmarkState& state,
+                   const ImagePlaneDesc& comps,
+                   ImageBitDepthEnum depth,
+                   unsigned int level,
+                   bool scalar)
+{
+    const RectI bounds(0, 0, IMAGE_BENCHMARK_WIDTH, IMAGE_BENCHMARK_HEIGHT);
+    const RectD rod(0, 0, IMAGE_BENCHMARK_WIDTH, IMAGE_BENCHMARK_HEIGHT);
+    Image srcImg(comps, rod, bounds, 0, 1., depth, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+    const RectI dstBounds = bounds.downscalePowerOfTwoSmallestEnclosing(level);
+    Image dstImg(comps, rod, dstBounds, level, 1., depth, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+
+    fillRamp(&srcImg);
+
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    const ImageConvertSIMD::InstructionSetEnum set = scalar ? ImageConvertSIMD::eInstructionSetScalar : supported;
+    ImageConvertSIMD::setInstructionSet(set);
+
+    std::string label = std::string( getDepthName(depth) ) + ", instruction set ";
+    label += set == ImageConvertSIMD::eInstructionSetScalar ? "scalar" : (set == ImageConvertSIMD::eInstructionSetSSE41 ? "SSE4.1" : "AVX2");
+    state.setLabel(label);
+    state.setItemsProcessed( bounds.area() );
+    state.setBytesProcessed( (U64)bounds.area() * comps.getNumComponents() * getSizeOfForBitDepth(depth) );
+    while ( state.keepRunning() ) {
+        srcImg.downscaleMipMap(rod, bounds, 0, level, false, &dstImg);
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+// The conversion of the viewer: linear float to sRGB bytes
+NATRON_BENCHMARK(Image, ConvertFloatToByteSRGB)
+{
+    benchmarkConvertToFormat(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, eViewerColorSpaceLinear,
+                             ImagePlaneDesc::getRGBAComponents(), eImageBitDepthByte, eViewerColorSpaceSRGB, false, false);
+}
+
+NATRON_BENCHMARK(Image, ConvertFloatToByteSRGBScalar)
+{
+    benchmarkConvertToFormat(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, eViewerColorSpaceLinear,
+                             ImagePlaneDesc::getRGBAComponents(), eImageBitDepthByte, eViewerColorSpaceSRGB, false, true);
+}
+
+// The conversion of 8-bit inputs to the float images of the effects
+NATRON_BENCHMARK(Image, ConvertByteSRGBToFloat)
+{
+    benchmarkConvertToFormat(state, ImagePlaneDesc::getRGBComponents(), eImageBitDepthByte, eViewerColorSpaceSRGB,
+                             ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, eViewerColorSpaceLinear, false, false);
+}
+
+NATRON_BENCHMARK(Image, ConvertByteSRGBToFloatScalar)
+{
+    benchmarkConvertToFormat(state, ImagePlaneDesc::getRGBComponents(), eImageBitDepthByte, eViewerColorSpaceSRGB,
+                             ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, eViewerColorSpaceLinear, false, true);
+}
+
+NATRON_BENCHMARK(Image, ConvertShortToFloat)
+{
+    benchmarkConvertToFormat(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthShort, eViewerColorSpaceLinear,
+                             ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, eViewerColorSpaceLinear, false, false);
+}
+
+// RGBA to RGB with unpremultiplication, e.g. for a writer
+NATRON_BENCHMARK(Image, ConvertFloatUnpremultToRGB)
+{
+    benchmarkConvertToFormat(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, eViewerColorSpaceLinear,
+                             ImagePlaneDesc::getRGBComponents(), eImageBitDepthFloat, eViewerColorSpaceLinear, true, false);
+}
+
+NATRON_BENCHMARK(Image, HalveFloatRGBA)
+{
+    benchmarkDownscale(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, 1, false);
+}
+
+NATRON_BENCHMARK(Image, HalveByteRGBA)
+{
+    benchmarkDownscale(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthByte, 1, false);
+}
+
+NATRON_BENCHMARK(Image, HalveFloatAlpha)
+{
+    benchmarkDownscale(state, ImagePlaneDesc::getAlphaComponents(), eImageBitDepthFloat, 1, false);
+}
+
+NATRON_BENCHMARK(Image, HalveFloatRGBAScalar)
+{
+    benchmarkDownscale(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, 1, true);
+}
+
+// A render at scale 1/8, all the levels are built in a single pass
+NATRON_BENCHMARK(Image, DownscaleLevel3FloatRGBA)
+{
+    benchmarkDownscale(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, 3, false);
+}
+
+NATRON_BENCHMARK(Image, DownscaleLevel3FloatRGBAScalar)
+{
+    benchmarkDownscale(state, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat, 3, true);
+}
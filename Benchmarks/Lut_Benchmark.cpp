@@ -0,0 +1,154 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+#include <vector>
+
+#include "Engine/ImageConvertSIMD.h"
+#include "Engine/Lut.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+using namespace NATRON_NAMESPACE::Color;
+
+// The values of an HD RGBA frame
+#define LUT_BENCHMARK_N_VALUES (1920 * 1080 * 4)
+
+// Keeps the results alive, so that the compiler does not remove the code measured
+static volatile float lutSink;
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+const Lut*
+getValidatedLut()
+{
+    const Lut* lut = LutManager::sRGBLut();
+
+    lut->validate();
+
+    return lut;
+}
+
+void
+setInstructionSetLabel(BenchmarkState& state)
+{
+    const ImageConvertSIMD::InstructionSetEnum set = ImageConvertSIMD::getInstructionSet();
+
+    state.setLabel( std::string("instruction set ") +
+                    (set == ImageConvertSIMD::eInstructionSetScalar ? "scalar" : (set == ImageConvertSIMD::eInstructionSetSSE41 ? "SSE4.1" : "AVX2")) );
+}
+
+std::vector<float>
+makeFloatValues()
+{
+    std::vector<float> values(LUT_BENCHMARK_N_VALUES);
+
+    for (int i = 0; i < LUT_BENCHMARK_N_VALUES; ++i) {
+        values[i] = (i % 4099) / 4098.f;
+    }
+
+    return values;
+}
+
+std::vector<unsigned short>
+makeUint16Values()
+{
+    std::vector<unsigned short> values(LUT_BENCHMARK_N_VALUES);
+
+    for (int i = 0; i < LUT_BENCHMARK_N_VALUES; ++i) {
+        values[i] = (unsigned short)(i % 65536);
+    }
+
+    return values;
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+// The interpolated table, as used by the readers
+NATRON_BENCHMARK(Lut, FloatToLinear)
+{
+    const Lut* lut = getValidatedLut();
+    const std::vector<float> from = makeFloatValues();
+    std::vector<float> to(LUT_BENCHMARK_N_VALUES);
+
+    setInstructionSetLabel(state);
+    state.setItemsProcessed(LUT_BENCHMARK_N_VALUES);
+    state.setBytesProcessed( LUT_BENCHMARK_N_VALUES * sizeof(float) );
+    while ( state.keepRunning() ) {
+        lut->fromColorSpaceFloatToLinearFloatFast(&from[0], &to[0], LUT_BENCHMARK_N_VALUES);
+        lutSink = to.back();
+    }
+}
+
+// The exact conversion, without the table
+NATRON_BENCHMARK(Lut, FloatToLinearExact)
+{
+    const Lut* lut = getValidatedLut();
+    const std::vector<float> from = makeFloatValues();
+    std::vector<float> to(LUT_BENCHMARK_N_VALUES);
+
+    state.setItemsProcessed(LUT_BENCHMARK_N_VALUES);
+    state.setBytesProcessed( LUT_BENCHMARK_N_VALUES * sizeof(float) );
+    while ( state.keepRunning() ) {
+        for (int i = 0; i < LUT_BENCHMARK_N_VALUES; ++i) {
+            to[i] = lut->fromColorSpaceFloatToLinearFloat(from[i]);
+        }
+        lutSink = to.back();
+    }
+}
+
+NATRON_BENCHMARK(Lut, Uint16ToLinear)
+{
+    const Lut* lut = getValidatedLut();
+    const std::vector<unsigned short> from = makeUint16Values();
+    std::vector<float> to(LUT_BENCHMARK_N_VALUES);
+
+    setInstructionSetLabel(state);
+    state.setItemsProcessed(LUT_BENCHMARK_N_VALUES);
+    state.setBytesProcessed( LUT_BENCHMARK_N_VALUES * sizeof(unsigned short) );
+    while ( state.keepRunning() ) {
+        lut->fromColorSpaceUint16ToLinearFloatFast(&from[0], &to[0], LUT_BENCHMARK_N_VALUES);
+        lutSink = to.back();
+    }
+}
+
+NATRON_BENCHMARK(Lut, Uint16ToLinearExact)
+{
+    const Lut* lut = getValidatedLut();
+    const std::vector<unsigned short> from = makeUint16Values();
+    std::vector<float> to(LUT_BENCHMARK_N_VALUES);
+
+    state.setItemsProcessed(LUT_BENCHMARK_N_VALUES);
+    state.setBytesProcessed( LUT_BENCHMARK_N_VALUES * sizeof(unsigned short) );
+    while ( state.keepRunning() ) {
+        for (int i = 0; i < LUT_BENCHMARK_N_VALUES; ++i) {
+            to[i] = lut->fromColorSpaceFloatToLinearFloat( intToFloat<65536>(from[i]) );
+        }
+        lutSink = to.back();
+    }
+}
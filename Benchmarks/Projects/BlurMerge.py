@@ -0,0 +1,40 @@
+# -*- coding: utf-8 -*-
+# Synthetic project of the Render/BlurMerge benchmark.
+# Blurs and merges: the blurs ask their inputs for large regions of interest, and the intermediate images go through the cache.
+# The Output1 node is replaced by a Write node by the -o option of NatronRenderer.
+
+import NatronEngine
+
+def createInstance(app,group):
+    checker = app.createNode("net.sf.openfx.CheckerBoardPlugin", -1, group)
+    checker.setScriptName("CheckerBoard1")
+
+    blur1 = app.createNode("net.sf.cimg.CImgBlur", -1, group)
+    blur1.setScriptName("Blur1")
+    param = blur1.getParam("size")
+    if param is not None:
+        param.setValue(20, 0)
+        param.setValue(20, 1)
+    blur1.connectInput(0, checker)
+
+    radial = app.createNode("net.sf.openfx.Radial", -1, group)
+    radial.setScriptName("Radial1")
+
+    blur2 = app.createNode("net.sf.cimg.CImgBlur", -1, group)
+    blur2.setScriptName("Blur2")
+    param = blur2.getParam("size")
+    if param is not None:
+        param.setValueAtTime(5, 1, 0)
+        param.setValueAtTime(50, 10, 0)
+        param.setValueAtTime(5, 1, 1)
+        param.setValueAtTime(50, 10, 1)
+    blur2.connectInput(0, radial)
+
+    merge = app.createNode("net.sf.openfx.MergePlugin", -1, group)
+    merge.setScriptName("Merge1")
+    merge.connectInput(0, blur1)
+    merge.connectInput(1, blur2)
+
+    output = app.createNode("fr.inria.built-in.Output", -1, group)
+    output.setScriptName("Output1")
+    output.connectInput(0, merge)
@@ -0,0 +1,29 @@
+# -*- coding: utf-8 -*-
+# Synthetic project of the Render/ColorCorrect benchmark.
+# Generators and color corrections in the project format: the render time is mostly the overhead of the engine.
+# The Output1 node is replaced by a Write node by the -o option of NatronRenderer.
+
+import NatronEngine
+
+def createInstance(app,group):
+    checker = app.createNode("net.sf.openfx.CheckerBoardPlugin", -1, group)
+    checker.setScriptName("CheckerBoard1")
+
+    grade = app.createNode("net.sf.openfx.GradePlugin", -1, group)
+    grade.setScriptName("Grade1")
+    param = grade.getParam("gamma")
+    if param is not None:
+        param.setValueAtTime(0.8, 1, 0)
+        param.setValueAtTime(1.2, 20, 0)
+    grade.connectInput(0, checker)
+
+    saturation = app.createNode("net.sf.openfx.SaturationPlugin", -1, group)
+    saturation.setScriptName("Saturation1")
+    param = saturation.getParam("saturation")
+    if param is not None:
+        param.setValue(0.5)
+    saturation.connectInput(0, grade)
+
+    output = app.createNode("fr.inria.built-in.Output", -1, group)
+    output.setScriptName("Output1")
+    output.connectInput(0, saturation)
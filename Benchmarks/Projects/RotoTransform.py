@@ -0,0 +1,31 @@
+# -*- coding: utf-8 -*-
+# Synthetic project of the Render/RotoTransform benchmark.
+# Roto shapes rendered over a generator, then an animated transform: the masks are rendered by cairo
+# and the transform filters its input.
+# The Output1 node is replaced by a Write node by the -o option of NatronRenderer.
+
+import NatronEngine
+
+def createInstance(app,group):
+    checker = app.createNode("net.sf.openfx.CheckerBoardPlugin", -1, group)
+    checker.setScriptName("CheckerBoard1")
+
+    roto = app.createNode("fr.inria.built-in.Roto", -1, group)
+    roto.setScriptName("Roto1")
+    roto.connectInput(0, checker)
+    context = roto.getRotoContext()
+    for i in range(8):
+        context.createEllipse(200 + i * 200, 540, 150 + i * 20, True, 1)
+        context.createRectangle(100 + i * 220, 100, 120, 1)
+
+    transform = app.createNode("net.sf.openfx.TransformPlugin", -1, group)
+    transform.setScriptName("Transform1")
+    param = transform.getParam("rotate")
+    if param is not None:
+        param.setValueAtTime(0, 1, 0)
+        param.setValueAtTime(45, 20, 0)
+    transform.connectInput(0, roto)
+
+    output = app.createNode("fr.inria.built-in.Output", -1, group)
+    output.setScriptName("Output1")
+    output.connectInput(0, transform)
@@ -0,0 +1,114 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <sstream> // stringstream
+#include <stdexcept>
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QProcess>
+#include <QtCore/QStringList>
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/**
+ * @brief Measures the render of the frames of the synthetic project by NatronRenderer, from the start of the process to its end.
+ * The project is a Python script of the Projects directory whose Output1 node is replaced by a Write node.
+ **/
+void
+benchmarkRender(BenchmarkState& state,
+                const char* projectName,
+                int nFrames)
+{
+    const QString renderer = QString::fromUtf8( BenchmarkRunner::getRendererPath().c_str() );
+
+    if ( renderer.isEmpty() || !QFileInfo(renderer).isExecutable() ) {
+        state.skip("NatronRenderer was not found, use the --renderer option");
+
+        return;
+    }
+    const QString project = QDir( QString::fromUtf8( BenchmarkRunner::getProjectsPath().c_str() ) ).absoluteFilePath( QString::fromUtf8(projectName) );
+    if ( !QFileInfo(project).exists() ) {
+        state.skip("The project " + project.toStdString() + " was not found, use the --projects option");
+
+        return;
+    }
+
+    QDir outputDir( QDir::tempPath() );
+    outputDir.mkpath( QString::fromUtf8("NatronBenchmarks") );
+    outputDir.cd( QString::fromUtf8("NatronBenchmarks") );
+
+    QStringList args;
+    args << QString::fromUtf8("--no-settings");
+    args << QString::fromUtf8("-o");
+    args << outputDir.absoluteFilePath( QFileInfo(project).baseName() + QString::fromUtf8("_###.exr") );
+    args << QString::fromUtf8("1-%1").arg(nFrames);
+    args << project;
+
+    std::stringstream label;
+    label << nFrames << " frames of " << projectName;
+    state.setLabel( label.str() );
+    state.setItemsProcessed(nFrames);
+    // Each sample takes several seconds
+    state.setMaxSamples(NATRON_BENCHMARK_MIN_SAMPLES);
+    while ( state.keepRunning() ) {
+        QProcess process;
+        process.setProcessChannelMode(QProcess::MergedChannels);
+        process.start(renderer, args);
+        if ( !process.waitForFinished(-1) || (process.exitStatus() != QProcess::NormalExit) || (process.exitCode() != 0) ) {
+            std::string output = QString::fromUtf8( process.readAll() ).toStdString();
+            if (output.size() > 1000) {
+                output = "..." + output.substr(output.size() - 1000);
+            }
+            throw std::runtime_error("NatronRenderer failed: " + output);
+        }
+    }
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+// Generators and color corrections: mostly the overhead of the engine per tile
+NATRON_BENCHMARK(Render, ColorCorrect)
+{
+    benchmarkRender(state, "ColorCorrect.py", 20);
+}
+
+// Blurs and merges: large regions of interest and intermediate images in the cache
+NATRON_BENCHMARK(Render, BlurMerge)
+{
+    benchmarkRender(state, "BlurMerge.py", 10);
+}
+
+// Animated roto shapes and a transform
+NATRON_BENCHMARK(Render, RotoTransform)
+{
+    benchmarkRender(state, "RotoTransform.py", 20);
+}
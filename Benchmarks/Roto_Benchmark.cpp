@@ -0,0 +1,143 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/Bezier.h"
+#include "Engine/CreateNodeArgs.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/Image.h"
+#include "Engine/Node.h"
+#include "Engine/Project.h"
+#include "Engine/RotoContext.h"
+#include "Engine/ViewIdx.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif
+
+// The shapes are rendered in an HD frame
+#define ROTO_BENCHMARK_WIDTH 1920
+#define ROTO_BENCHMARK_HEIGHT 1080
+
+// Number of points of the star
+#define ROTO_BENCHMARK_STAR_POINTS 64
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+NodePtr
+createRotoNode()
+{
+    AppInstancePtr app = appPTR->getTopLevelInstance();
+
+    if (!app) {
+        return NodePtr();
+    }
+    CreateNodeArgs args( PLUGINID_NATRON_ROTO, app->getProject() );
+    args.setProperty<bool>(kCreateNodeArgsPropNoNodeGUI, true);
+
+    return app->createNode(args);
+}
+
+/// A star with ROTO_BENCHMARK_STAR_POINTS points, whose edges cross many scan-lines
+BezierPtr
+makeStar(const RotoContextPtr& context)
+{
+    const double cx = ROTO_BENCHMARK_WIDTH / 2.;
+    const double cy = ROTO_BENCHMARK_HEIGHT / 2.;
+    BezierPtr star;
+
+    for (int i = 0; i < ROTO_BENCHMARK_STAR_POINTS; ++i) {
+        const double angle = 2. * M_PI * i / ROTO_BENCHMARK_STAR_POINTS;
+        const double radius = i % 2 ? 150. : 500.;
+        const double x = cx + radius * std::cos(angle);
+        const double y = cy + radius * std::sin(angle);
+        if (i == 0) {
+            star = context->makeBezier(x, y, kRotoBezierBaseName, 0., false);
+        } else {
+            star->addControlPoint(x, y, 0.);
+        }
+    }
+    star->setCurveFinished(true);
+
+    return star;
+}
+
+/// Measures the rendering of the mask of shape at the given mipmap level. The mask is removed from the cache before each iteration.
+void
+benchmarkMask(BenchmarkState& state,
+              bool ellipse,
+              unsigned int mipmapLevel)
+{
+    NodePtr node = createRotoNode();
+    RotoContextPtr context = node ? node->getRotoContext() : RotoContextPtr();
+
+    if (!context) {
+        state.skip("Cannot create a Roto node");
+
+        return;
+    }
+
+    BezierPtr shape = ellipse ? context->makeEllipse(ROTO_BENCHMARK_WIDTH / 2., ROTO_BENCHMARK_HEIGHT / 2., 800., true, 0.) : makeStar(context);
+    const RectD rod(0, 0, ROTO_BENCHMARK_WIDTH, ROTO_BENCHMARK_HEIGHT);
+    state.setItemsProcessed( (ROTO_BENCHMARK_WIDTH >> mipmapLevel) * (ROTO_BENCHMARK_HEIGHT >> mipmapLevel) );
+    while ( state.keepRunning() ) {
+        state.pauseTiming();
+        appPTR->removeAllCacheEntriesForHolder(shape.get(), true);
+        state.resumeTiming();
+        ImagePtr mask = shape->renderMaskFromStroke(ImagePlaneDesc::getAlphaComponents(), 0., ViewIdx(0), eImageBitDepthFloat, mipmapLevel, rod);
+        if (!mask) {
+            throw std::runtime_error("Failed to render the mask");
+        }
+    }
+    appPTR->removeAllCacheEntriesForHolder(shape.get(), true);
+    node->destroyNode(true, false);
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+NATRON_BENCHMARK(Roto, EllipseMask)
+{
+    benchmarkMask(state, true, 0);
+}
+
+NATRON_BENCHMARK(Roto, EllipseMaskHalfScale)
+{
+    benchmarkMask(state, true, 1);
+}
+
+NATRON_BENCHMARK(Roto, StarMask)
+{
+    benchmarkMask(state, false, 0);
+}
@@ -0,0 +1,107 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <sstream> // stringstream
+#include <stdexcept>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/bind.hpp>
+#endif
+
+#include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/CreateNodeArgs.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/Node.h"
+#include "Engine/Project.h"
+#include "Engine/TaskScheduler.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+// Number of reads of each thread per iteration
+#define TLS_BENCHMARK_READS_PER_THREAD 100000
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/// Reads the ParallelRenderArgs of an effect in a loop, as the render functions of a tile do
+void
+readParallelRenderArgs(const EffectInstancePtr& effect,
+                       int /*threadIndex*/)
+{
+    for (int i = 0; i < TLS_BENCHMARK_READS_PER_THREAD; ++i) {
+        if ( effect->getParallelRenderArgsTLS() ) {
+            throw std::runtime_error("A thread of the pool has ParallelRenderArgs");
+        }
+    }
+}
+
+void
+benchmarkParallelRenderArgs(BenchmarkState& state,
+                            int nThreads)
+{
+    AppInstancePtr app = appPTR->getTopLevelInstance();
+
+    if (!app) {
+        state.skip("No application instance");
+
+        return;
+    }
+    CreateNodeArgs args( PLUGINID_NATRON_DOT, app->getProject() );
+    args.setProperty<bool>(kCreateNodeArgsPropNoNodeGUI, true);
+    NodePtr node = app->createNode(args);
+    if (!node) {
+        state.skip("Failed to create a Dot node");
+
+        return;
+    }
+    const EffectInstancePtr effect = node->getEffectInstance();
+    std::stringstream ss;
+
+    ss << nThreads << " thread(s)";
+    state.setLabel( ss.str() );
+    state.setItemsProcessed( (U64)nThreads * TLS_BENCHMARK_READS_PER_THREAD );
+    while ( state.keepRunning() ) {
+        appPTR->getTaskScheduler()->parallelFor( nThreads, boost::bind(&readParallelRenderArgs, effect, _1) );
+    }
+    node->destroyNode(true, false);
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+NATRON_BENCHMARK(TLSHolder, ParallelRenderArgs)
+{
+    benchmarkParallelRenderArgs(state, 1);
+}
+
+// All the threads of the pool read their TLS at the same time
+NATRON_BENCHMARK(TLSHolder, ParallelRenderArgsContended)
+{
+    benchmarkParallelRenderArgs( state, std::max( 1, appPTR->getMaxThreadCount() ) );
+}
@@ -0,0 +1,150 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "Engine/ImageConvertSIMD.h"
+#include "Engine/Lut.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+// A UHD frame, as displayed by a 4K viewer
+#define VIEWER_BENCHMARK_WIDTH 3840
+#define VIEWER_BENCHMARK_HEIGHT 2160
+
+// Same as GAMMA_LUT_NB_VALUES in ViewerInstancePrivate.h
+#define VIEWER_BENCHMARK_GAMMA_LUT_SIZE 1023
+
+// Same as NATRON_VIEWER_SIMD_CHUNK_SIZE in ViewerInstance.cpp
+#define VIEWER_BENCHMARK_CHUNK_SIZE 256
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/**
+ * @brief Measures the conversion of a float RGBA frame to the 8-bit sRGB texture of the viewer, row by row as
+ * scaleToTexture8bits does with the SIMD kernels: the channels are split in planes by chunks, go through the gain,
+ * the gamma and the sRGB table, then the error is diffused over the row and the bytes are packed.
+ * If scalar is true, the scalar kernels are used.
+ **/
+void
+benchmarkViewerTexture8bits(BenchmarkState& state,
+                            double gamma,
+                            bool luminance,
+                            bool scalar)
+{
+    const int width = VIEWER_BENCHMARK_WIDTH;
+    const int height = VIEWER_BENCHMARK_HEIGHT;
+    std::vector<float> src( (std::size_t)width * height * 4 );
+
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        src[i] = (float)(i % 1031) / 1030.f;
+    }
+
+    // Same as ViewerInstancePrivate::fillGammaLut
+    std::vector<float> gammaLut(VIEWER_BENCHMARK_GAMMA_LUT_SIZE + 1);
+    for (int i = 0; i <= VIEWER_BENCHMARK_GAMMA_LUT_SIZE; ++i) {
+        gammaLut[i] = (float)std::max( 0., std::min( 1., std::pow(double(i) / VIEWER_BENCHMARK_GAMMA_LUT_SIZE, 1. / gamma) ) );
+    }
+    ImageConvertSIMD::ViewerTransform transform;
+    transform.gain = 1.5;
+    transform.offset = 0.;
+    transform.gammaZero = false;
+    transform.gammaLut = gamma != 1. ? &gammaLut[0] : 0;
+    transform.gammaLutSize = VIEWER_BENCHMARK_GAMMA_LUT_SIZE;
+    transform.luminance = luminance;
+
+    const Color::Lut* lut = Color::LutManager::sRGBLut();
+    lut->validate();
+
+    std::vector<float> planes[4];
+    std::vector<unsigned short> uint8xx[3];
+    std::vector<unsigned char> bytes[4];
+    for (int c = 0; c < 4; ++c) {
+        planes[c].resize(VIEWER_BENCHMARK_CHUNK_SIZE);
+        bytes[c].resize(width, 255);
+    }
+    for (int c = 0; c < 3; ++c) {
+        uint8xx[c].resize(width);
+    }
+    std::vector<U32> texture( (std::size_t)width * height );
+
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    const ImageConvertSIMD::InstructionSetEnum set = scalar ? ImageConvertSIMD::eInstructionSetScalar : supported;
+    ImageConvertSIMD::setInstructionSet(set);
+
+    std::string label = set == ImageConvertSIMD::eInstructionSetScalar ? "instruction set scalar" : (set == ImageConvertSIMD::eInstructionSetSSE41 ? "instruction set SSE4.1" : "instruction set AVX2");
+    state.setLabel(label);
+    state.setItemsProcessed( (U64)width * height );
+    state.setBytesProcessed( (U64)width * height * 4 * sizeof(float) );
+    while ( state.keepRunning() ) {
+        for (int y = 0; y < height; ++y) {
+            const float* row = &src[(std::size_t)y * width * 4];
+            for (int x = 0; x < width; x += VIEWER_BENCHMARK_CHUNK_SIZE) {
+                const int n = std::min(VIEWER_BENCHMARK_CHUNK_SIZE, width - x);
+                ImageConvertSIMD::rgbaToPlanes(row + x * 4, &planes[0][0], &planes[1][0], &planes[2][0], &planes[3][0], n);
+                ImageConvertSIMD::viewerTransform(transform, &planes[0][0], &planes[1][0], &planes[2][0], n);
+                for (int c = 0; c < 3; ++c) {
+                    lut->toColorSpaceUint8xxFromLinearFloatFast(&planes[c][0], &uint8xx[c][x], n);
+                }
+            }
+            for (int c = 0; c < 3; ++c) {
+                ImageConvertSIMD::diffuseErrorUint8xx(&uint8xx[c][0], &bytes[c][0], width, false);
+            }
+            ImageConvertSIMD::planesToBGRA(&bytes[0][0], &bytes[1][0], &bytes[2][0], &bytes[3][0], &texture[(std::size_t)y * width], width);
+        }
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+// The default display of a linear float image: sRGB with gain
+NATRON_BENCHMARK(Viewer, Texture8bits)
+{
+    benchmarkViewerTexture8bits(state, 1., false, false);
+}
+
+NATRON_BENCHMARK(Viewer, Texture8bitsScalar)
+{
+    benchmarkViewerTexture8bits(state, 1., false, true);
+}
+
+// With the gamma look-up table and the luminance
+NATRON_BENCHMARK(Viewer, Texture8bitsGammaLuminance)
+{
+    benchmarkViewerTexture8bits(state, 2.2, true, false);
+}
+
+NATRON_BENCHMARK(Viewer, Texture8bitsGammaLuminanceScalar)
+{
+    benchmarkViewerTexture8bits(state, 2.2, true, true);
+}
@@ -0,0 +1,47 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# Compares two result files of the Benchmarks executable.
+# Usage: compare.py <baseline.json> <contender.json> [<threshold in percent, default 5>]
+# Prints the change of the median time of each benchmark, and exits with 1 if a benchmark is slower by more
+# than the threshold and than the spread of its samples.
+
+from __future__ import print_function
+
+import json
+import sys
+
+def load(filename):
+    with open(filename) as f:
+        results = json.load(f)
+    return dict((b["name"], b) for b in results["benchmarks"]), results["context"]
+
+def main():
+    if len(sys.argv) < 3:
+        print("Usage: compare.py <baseline.json> <contender.json> [<threshold in percent, default 5>]")
+        return 2
+    baseline, baselineContext = load(sys.argv[1])
+    contender, contenderContext = load(sys.argv[2])
+    threshold = float(sys.argv[3]) / 100. if len(sys.argv) > 3 else 0.05
+
+    print("baseline:  %s (%s) %s" % (baselineContext["version"], baselineContext["commit"], baselineContext["date"]))
+    print("contender: %s (%s) %s" % (contenderContext["version"], contenderContext["commit"], contenderContext["date"]))
+    regressions = 0
+    for name in sorted(contender):
+        b = baseline.get(name)
+        c = contender[name]
+        if b is None or "median" not in b or "median" not in c:
+            continue
+        change = c["median"] / b["median"] - 1. if b["median"] > 0 else 0.
+        # The change must exceed the noise of both runs
+        noise = (b["stddev"] + c["stddev"]) / b["median"] if b["median"] > 0 else 0.
+        status = ""
+        if change > max(threshold, noise):
+            status = "SLOWER"
+            regressions += 1
+        elif -change > max(threshold, noise):
+            status = "faster"
+        print("%-40s %12.6g s -> %12.6g s %+7.1f%% %s" % (name, b["median"], c["median"], change * 100., status))
+    return 1 if regressions else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
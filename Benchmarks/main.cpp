@@ -0,0 +1,163 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QStringList>
+#include <QtCore/QThreadPool>
+
+#include "Global/FStreamsSupport.h"
+
+#include "Engine/AppManager.h"
+#include "Engine/CLArgs.h"
+
+#include "Benchmark.h"
+
+NATRON_NAMESPACE_USING
+
+static void
+printUsage(const char* programName)
+{
+    std::cout << "Usage: " << programName << " [options]\n"
+        "Runs the benchmarks of the engine and writes their results in JSON format.\n"
+        "  --output <file>\n"
+        "    Write the results to <file> (default NatronBenchmarks.json).\n"
+        "  --filter <string>\n"
+        "    Only run the benchmarks whose name (group/name) contains <string>.\n"
+        "  --samples <n>\n"
+        "    Number of samples of each benchmark (default " << NATRON_BENCHMARK_DEFAULT_SAMPLES << ").\n"
+        "  --renderer <path>\n"
+        "    The NatronRenderer executable used by the Render benchmarks.\n"
+        "  --projects <dir>\n"
+        "    The directory of the projects rendered by the Render benchmarks.\n"
+        "  --list\n"
+        "    Print the names of the benchmarks and exit.\n"
+        "Compare two result files with compare.py.\n";
+}
+
+/// Looks for NatronRenderer next to this executable, and in the Renderer directory of the build tree
+static std::string
+findRenderer(const char* argv0)
+{
+    QDir dir = QFileInfo( QString::fromUtf8(argv0) ).absoluteDir();
+    QStringList candidates;
+#ifdef __NATRON_WIN32__
+    const QString exe = QString::fromUtf8("NatronRenderer.exe");
+#else
+    const QString exe = QString::fromUtf8("NatronRenderer");
+#endif
+
+    candidates << dir.absoluteFilePath(exe);
+    candidates << dir.absoluteFilePath(QString::fromUtf8("../Renderer/") + exe);
+    candidates << dir.absoluteFilePath(QString::fromUtf8("../Renderer/release/") + exe);
+    candidates << dir.absoluteFilePath(QString::fromUtf8("../Renderer/debug/") + exe);
+    Q_FOREACH(const QString &path, candidates) {
+        if ( QFileInfo(path).isExecutable() ) {
+            return QDir::cleanPath(path).toStdString();
+        }
+    }
+
+    return std::string();
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    std::string outputFile = "NatronBenchmarks.json";
+    std::string filter;
+    int nSamples = NATRON_BENCHMARK_DEFAULT_SAMPLES;
+    std::string rendererPath = findRenderer(argv[0]);
+#ifdef NATRON_BENCHMARK_PROJECTS_PATH
+    std::string projectsPath = NATRON_BENCHMARK_PROJECTS_PATH;
+#else
+    std::string projectsPath = QFileInfo( QString::fromUtf8(argv[0]) ).absoluteDir().absoluteFilePath( QString::fromUtf8("Projects") ).toStdString();
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if ( !std::strcmp(argv[i], "--output") && hasValue ) {
+            outputFile = argv[++i];
+        } else if ( !std::strcmp(argv[i], "--filter") && hasValue ) {
+            filter = argv[++i];
+        } else if ( !std::strcmp(argv[i], "--samples") && hasValue ) {
+            nSamples = std::atoi(argv[++i]);
+        } else if ( !std::strcmp(argv[i], "--renderer") && hasValue ) {
+            rendererPath = argv[++i];
+        } else if ( !std::strcmp(argv[i], "--projects") && hasValue ) {
+            projectsPath = argv[++i];
+        } else if ( !std::strcmp(argv[i], "--list") ) {
+            BenchmarkRunner::list(std::cout);
+
+            return 0;
+        } else {
+            printUsage(argv[0]);
+
+            return !std::strcmp(argv[i], "--help") || !std::strcmp(argv[i], "-h") ? 0 : 1;
+        }
+    }
+    if (nSamples <= 0) {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+    BenchmarkRunner::setRendererPath(rendererPath);
+    BenchmarkRunner::setProjectsPath(projectsPath);
+
+    AppManager manager;
+    {
+        int argc = 0;
+        QStringList args;
+        args << QString::fromUtf8("--clear-cache");
+        args << QString::fromUtf8("--no-settings");
+        CLArgs cl(args, true);
+        if ( !manager.load(argc, 0, cl) ) {
+            std::cerr << "Failed to load AppManager" << std::endl;
+
+            return 1;
+        }
+    }
+
+    FStreamsSupport::ofstream ofile;
+    FStreamsSupport::open(&ofile, outputFile);
+    if (!ofile) {
+        std::cerr << "Cannot write to " << outputFile << std::endl;
+
+        return 1;
+    }
+    const int nFailed = BenchmarkRunner::run(filter, nSamples, std::cout, ofile);
+    ofile.close();
+    std::cout << "Results written to " << outputFile << std::endl;
+
+    ///Caches may have launched some threads to delete images, wait for them to be done
+    QThreadPool::globalInstance()->waitForDone();
+
+    return nFailed ? 1 : 0;
+} // main
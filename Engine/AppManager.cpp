@@ -125,7 +125,9 @@
 #include "Engine/ProcessHandler.h" // ProcessInputChannel
 #include "Engine/Project.h"
 #include "Engine/PrecompNode.h"
+#include "Engine/RamBufferPool.h"
 #include "Engine/ReadNode.h"
+#include "Engine/RenderTrace.h"
 #include "Engine/RotoPaint.h"
 #include "Engine/RotoSmear.h"
 #include "Engine/StandardPaths.h"
@@ -586,9 +588,18 @@ AppManager::~AppManager()
     } catch (std::runtime_error&) {
         // ignore errors
     }
+    _imp->closeCachesTOCJournals();
 
     ///Caches may have launched some threads to delete images, wait for them to be done
     QThreadPool::globalInstance()->waitForDone();
+    _imp->taskScheduler.reset();
+
+    if ( !_imp->traceFilePath.isEmpty() ) {
+        RenderTrace::setEnabled(false);
+        if ( !RenderTrace::writeChromeTrace( _imp->traceFilePath.toStdString() ) ) {
+            std::cerr << tr("Cannot write the render trace to %1").arg(_imp->traceFilePath).toStdString() << std::endl;
+        }
+    }
 
     ///Kill caches now because decreaseNCacheFilesOpened can be called
     _imp->_nodeCache->waitForDeleterThread();
@@ -816,6 +827,12 @@ AppManager::loadInternal(const CLArgs& cl)
     setApplicationLocale();
     
     Log::instance(); //< enable logging
+
+    _imp->traceFilePath = cl.getTraceFilePath();
+    if ( !_imp->traceFilePath.isEmpty() ) {
+        RenderTrace::setEnabled(true);
+    }
+
     bool mustSetSignalsHandlers = true;
 #ifdef NATRON_USE_BREAKPAD
     //Enabled breakpad only if the process was spawned from the crash reporter
@@ -1068,9 +1085,19 @@ AppManager::loadInternalAfterInitGui(const CLArgs& cl)
         U64 viewerCacheSize = _imp->_settings->getMaximumViewerDiskCacheSize();
         U64 maxDiskCacheNode = _imp->_settings->getMaximumDiskCacheNodeSize();
 
-        _imp->_nodeCache = boost::make_shared<Cache<Image> >("NodeCache", NATRON_CACHE_VERSION, maxCacheRAM, 1.);
-        _imp->_diskCache = boost::make_shared<Cache<Image> >("DiskCache", NATRON_CACHE_VERSION, maxDiskCacheNode, 0.);
-        _imp->_viewerCache = boost::make_shared<Cache<FrameEntry> >("ViewerCache", NATRON_CACHE_VERSION, viewerCacheSize, 0.);
+        // When sharded, use one shard per core, rounded up to a power of 2
+        int nCacheShards = 1;
+        if ( _imp->_settings->isShardedCacheEnabled() ) {
+            int idealThreadCount = std::max(1, _imp->idealThreadCount);
+            while (nCacheShards < idealThreadCount && nCacheShards < NATRON_CACHE_MAX_SHARDS) {
+                nCacheShards *= 2;
+            }
+        }
+
+        _imp->_nodeCache = boost::make_shared<Cache<Image> >("NodeCache", NATRON_CACHE_VERSION, maxCacheRAM, 1., nCacheShards);
+        _imp->_diskCache = boost::make_shared<Cache<Image> >("DiskCache", NATRON_CACHE_VERSION, maxDiskCacheNode, 0., nCacheShards);
+        _imp->_viewerCache = boost::make_shared<Cache<FrameEntry> >("ViewerCache", NATRON_CACHE_VERSION, viewerCacheSize, 0., nCacheShards);
+        setApplicationsCachesReplacementPolicy( _imp->_settings->getImageCacheReplacementPolicy(), _imp->_settings->getViewerCacheReplacementPolicy() );
         _imp->setViewerCacheTileSize();
     } catch (std::logic_error&) {
         // ignore
@@ -1207,9 +1234,11 @@ AppManagerPrivate::setViewerCacheTileSize()
     ImageBitDepthEnum viewerDepth = _settings->getViewersBitDepth();
     switch (viewerDepth) {
         case eImageBitDepthFloat:
-        case eImageBitDepthHalf:
             tileSize *= sizeof(float);
             break;
+        case eImageBitDepthHalf:
+            tileSize *= sizeof(unsigned short);
+            break;
         default:
             break;
     }
@@ -1403,6 +1432,7 @@ AppManager::clearAllCaches()
 
     clearDiskCache();
     clearNodeCache();
+    RamBufferPool::clear();
 
 
     ///for each app instance clear all its nodes cache
@@ -1431,6 +1461,7 @@ AppManager::wipeAndCreateDiskCacheStructure()
     _imp->cleanUpCacheDiskStructure( _imp->_diskCache->getCachePath(), false );
     assert(_imp->_viewerCache);
     _imp->cleanUpCacheDiskStructure( _imp->_viewerCache->getCachePath() , true);
+    _imp->resetCachesTOCJournals();
 }
 
 AppInstancePtr
@@ -1507,6 +1538,18 @@ AppManager::setApplicationsCachesMaximumDiskSpace(unsigned long long size)
     _imp->_diskCache->setMaximumCacheSize(size);
 }
 
+void
+AppManager::setApplicationsCachesReplacementPolicy(CacheReplacementPolicyEnum imagesPolicy,
+                                                   CacheReplacementPolicyEnum viewerPolicy)
+{
+    if (!_imp->_nodeCache) {
+        return;
+    }
+    _imp->_nodeCache->setReplacementPolicy(imagesPolicy);
+    _imp->_diskCache->setReplacementPolicy(imagesPolicy);
+    _imp->_viewerCache->setReplacementPolicy(viewerPolicy);
+}
+
 void
 AppManager::loadAllPlugins()
 {
@@ -2562,6 +2605,12 @@ AppManager::getCachesTotalMemorySize() const
     return  _imp->_nodeCache->getMemoryCacheSize();
 }
 
+U64
+AppManager::getCachesMaximumMemorySize() const
+{
+    return  _imp->_nodeCache->getMaximumMemorySize();
+}
+
 U64
 AppManager::getCachesTotalDiskSize() const
 {
@@ -3694,6 +3743,12 @@ AppManager::getAppTLS() const
     return &_imp->globalTLS;
 }
 
+TaskScheduler*
+AppManager::getTaskScheduler() const
+{
+    return _imp->taskScheduler.get();
+}
+
 
 QString
 AppManager::getBoostVersion() const
@@ -219,6 +219,7 @@ public:
 
 
     U64 getCachesTotalMemorySize() const;
+    U64 getCachesMaximumMemorySize() const;
     U64 getCachesTotalDiskSize() const;
     CacheSignalEmitterPtr getOrActivateViewerCacheSignalEmitter() const;
 
@@ -228,6 +229,8 @@ public:
 
     void setApplicationsCachesMaximumDiskSpace(unsigned long long size);
 
+    void setApplicationsCachesReplacementPolicy(CacheReplacementPolicyEnum imagesPolicy, CacheReplacementPolicyEnum viewerPolicy);
+
     void removeFromNodeCache(const ImagePtr & image);
     void removeFromViewerCache(const FrameEntryPtr & texture);
 
@@ -494,6 +497,7 @@ public:
     OFX::Host::ImageEffect::Descriptor* getPluginContextAndDescribe(OFX::Host::ImageEffect::ImageEffectPlugin* plugin,
                                                                     ContextEnum* ctx);
     AppTLS* getAppTLS() const;
+    TaskScheduler* getTaskScheduler() const;
     const OfxHost* getOFXHost() const;
     GPUContextPool* getGPUContextPool() const;
 
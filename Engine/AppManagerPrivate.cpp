@@ -65,6 +65,7 @@ GCC_DIAG_ON(unused-parameter)
 #include "Engine/Format.h"
 #include "Engine/FrameEntry.h"
 #include "Engine/Image.h"
+#include "Engine/NUMATopology.h"
 #include "Engine/OfxHost.h"
 #include "Engine/OSGLContext.h"
 #include "Engine/ProcessHandler.h" // ProcessInputChannel
@@ -83,6 +84,8 @@ BOOST_CLASS_EXPORT(NATRON_NAMESPACE::ImageParams)
 NATRON_NAMESPACE_ENTER
 AppManagerPrivate::AppManagerPrivate()
     : globalTLS()
+    , taskScheduler( new TaskScheduler() )
+    , traceFilePath()
     , _appType(AppManager::eAppTypeBackground)
     , _appInstancesMutex()
     , _appInstances()
@@ -136,6 +139,7 @@ AppManagerPrivate::AppManagerPrivate()
     , openGLRenderers()
 {
     setMaxCacheFiles();
+    NUMATopology::detect();
 
     runningThreadsCount = 0;
 }
@@ -309,81 +313,112 @@ AppManagerPrivate::declareSettingsToPython()
     }
 }
 
-template <typename T>
 void
-saveCache(Cache<T>* cache)
+AppManagerPrivate::saveCaches()
 {
-    std::string cacheRestoreFilePath = cache->getRestoreFilePath();
-    FStreamsSupport::ofstream ofile;
-    FStreamsSupport::open(&ofile, cacheRestoreFilePath);
+    // The table of contents journals are kept up to date, and compacted by their writer thread when they grow:
+    // only the entries left in memory need to be written
+    if (!appPTR->isBackground()) {
+        _viewerCache->save();
+    }
+    _diskCache->save();
+} // saveCaches
 
-    if (!ofile) {
-        std::cerr << "Failed to save cache to " << cacheRestoreFilePath.c_str() << std::endl;
+void
+AppManagerPrivate::closeCachesTOCJournals()
+{
+    _viewerCache->closeTOCJournal();
+    _diskCache->closeTOCJournal();
+}
 
-        return;
-    }
+void
+AppManagerPrivate::resetCachesTOCJournals()
+{
+    std::vector<CacheTOCJournal::Record> noRecords;
 
+    _viewerCache->openTOCJournal(&serializeCacheTOCPayload<FrameEntry>, noRecords);
+    _diskCache->openTOCJournal(&serializeCacheTOCPayload<Image>, noRecords);
+}
+
+/**
+ * @brief Reads the table of contents saved by versions that did not have a journal.
+ **/
+template <typename T>
+bool
+readLegacyCacheRestoreFile(AppManagerPrivate* p,
+                           Cache<T>* cache,
+                           typename Cache<T>::CacheTOC* tableOfContents)
+{
+    std::string settingsFilePath = cache->getRestoreFilePath();
+    FStreamsSupport::ifstream ifile;
+    FStreamsSupport::open(&ifile, settingsFilePath);
+    if (!ifile) {
+        std::cerr << "Failure to open cache restore file at: " << settingsFilePath << std::endl;
 
-    typename Cache<T>::CacheTOC toc;
-    cache->save(&toc);
-    unsigned int version = cache->cacheVersion();
+        return false;
+    }
+    unsigned int cacheVersion = 0x1; //< default to 1 before NATRON_CACHE_VERSION was introduced
     try {
-        boost::archive::binary_oarchive oArchive(ofile);
-        oArchive << version;
-        oArchive << toc;
+        boost::archive::binary_iarchive iArchive(ifile);
+        if (cache->cacheVersion() >= NATRON_CACHE_VERSION) {
+            iArchive >> cacheVersion;
+        }
+        //Only load caches with same version, otherwise wipe it!
+        if ( cacheVersion == cache->cacheVersion() ) {
+            iArchive >> *tableOfContents;
+        } else {
+            p->cleanUpCacheDiskStructure( cache->getCachePath(), cache->isTileCache() );
+        }
     } catch (const std::exception & e) {
-        qDebug() << "Failed to serialize the cache table of contents:" << e.what();
-    }
-}
+        qDebug() << "Exception when reading disk cache TOC:" << e.what();
+        p->cleanUpCacheDiskStructure( cache->getCachePath(), cache->isTileCache() );
 
-void
-AppManagerPrivate::saveCaches()
-{
-    if (!appPTR->isBackground()) {
-        saveCache<FrameEntry>( _viewerCache.get() );
+        return false;
     }
-    saveCache<Image>( _diskCache.get() );
-} // saveCaches
+
+    ifile.close();
+    QFile restoreFile( QString::fromUtf8( settingsFilePath.c_str() ) );
+    restoreFile.remove();
+
+    return true;
+}
 
 template <typename T>
 void
 restoreCache(AppManagerPrivate* p,
              Cache<T>* cache)
 {
-    if ( p->checkForCacheDiskStructure( cache->getCachePath(), cache->isTileCache() ) ) {
-        std::string settingsFilePath = cache->getRestoreFilePath();
-        FStreamsSupport::ifstream ifile;
-        FStreamsSupport::open(&ifile, settingsFilePath);
-        if (!ifile) {
-            std::cerr << "Failure to open cache restore file at: " << settingsFilePath << std::endl;
+    // The journal is appended to as it is when it could be read, otherwise it is started with these records
+    bool journalRead = false;
+    CacheTOCJournal::ReadInfo journalInfo;
+    std::vector<CacheTOCJournal::Record> records;
 
-            return;
-        }
+    if ( p->checkForCacheDiskStructure( cache->getCachePath(), cache->isTileCache() ) ) {
         typename Cache<T>::CacheTOC tableOfContents;
-        unsigned int cacheVersion = 0x1; //< default to 1 before NATRON_CACHE_VERSION was introduced
-        try {
-            boost::archive::binary_iarchive iArchive(ifile);
-            if (cache->cacheVersion() >= NATRON_CACHE_VERSION) {
-                iArchive >> cacheVersion;
-            }
-            //Only load caches with same version, otherwise wipe it!
-            if ( cacheVersion == cache->cacheVersion() ) {
-                iArchive >> tableOfContents;
-            } else {
-                p->cleanUpCacheDiskStructure( cache->getCachePath(), cache->isTileCache() );
+        CacheTOCBuilder<T> tocBuilder(&tableOfContents);
+        if ( CacheTOCJournal::readLiveRecords(cache->getTOCJournalFilePath(), cache->cacheVersion(), &tocBuilder, &journalInfo) ) {
+            journalRead = true;
+        } else if ( QFile::exists( QString::fromUtf8( cache->getRestoreFilePath().c_str() ) ) ) {
+            if ( readLegacyCacheRestoreFile<T>(p, cache, &tableOfContents) ) {
+                cacheTOCToJournalRecords<T>(tableOfContents, &records);
             }
-        } catch (const std::exception & e) {
-            qDebug() << "Exception when reading disk cache TOC:" << e.what();
+        } else {
+            // The journal was written by another version of the cache or is not readable
             p->cleanUpCacheDiskStructure( cache->getCachePath(), cache->isTileCache() );
-
-            return;
         }
 
-        QFile restoreFile( QString::fromUtf8( settingsFilePath.c_str() ) );
-        restoreFile.remove();
-
         cache->restore(tableOfContents);
     }
+
+    bool journalOpened;
+    if (journalRead) {
+        journalOpened = cache->reopenTOCJournal(&serializeCacheTOCPayload<T>, journalInfo);
+    } else {
+        journalOpened = cache->openTOCJournal(&serializeCacheTOCPayload<T>, records);
+    }
+    if (!journalOpened) {
+        std::cerr << "Failed to open the cache table of contents at " << cache->getTOCJournalFilePath().c_str() << std::endl;
+    }
 }
 
 void
@@ -401,9 +436,10 @@ AppManagerPrivate::checkForCacheDiskStructure(const QString & cachePath, bool is
     if ( !settingsFilePath.endsWith( QChar::fromLatin1('/') ) ) {
         settingsFilePath += QChar::fromLatin1('/');
     }
+    QString journalFilePath = settingsFilePath + QString::fromUtf8(NATRON_CACHE_TOC_JOURNAL_FILE_NAME);
     settingsFilePath += QString::fromUtf8("restoreFile." NATRON_CACHE_FILE_EXT);
 
-    if ( !QFile::exists(settingsFilePath) ) {
+    if ( !QFile::exists(journalFilePath) && !QFile::exists(settingsFilePath) ) {
         cleanUpCacheDiskStructure(cachePath, isTiled);
 
         return false;
@@ -54,6 +54,7 @@
 #include "Engine/GPUContextPool.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
 #include "Engine/TLSHolder.h"
+#include "Engine/TaskScheduler.h"
 
 // include breakpad after Engine, because it includes /usr/include/AssertMacros.h on OS X which defines a check(x) macro, which conflicts with boost
 #ifdef NATRON_USE_BREAKPAD
@@ -85,6 +86,8 @@ public:
     typedef boost::shared_ptr<FrameEntryCache> FrameEntryCachePtr;
 
     AppTLS globalTLS;
+    boost::scoped_ptr<TaskScheduler> taskScheduler; //< runs the parallel loops of the renders
+    QString traceFilePath; //< where the RenderTrace is written on exit, empty if tracing is disabled
     AppManager::AppTypeEnum _appType; //< the type of app
     mutable QMutex _appInstancesMutex;
     std::vector<AppInstancePtr> _appInstances; //< the instances mapped against their ID
@@ -212,6 +215,16 @@ public:
 
     void restoreCaches();
 
+    /**
+     * @brief Stops updating the tables of contents of the caches on disk, before destroying the caches.
+     **/
+    void closeCachesTOCJournals();
+
+    /**
+     * @brief Restarts the tables of contents of the caches on disk from scratch, after wiping the caches directories.
+     **/
+    void resetCachesTOCJournals();
+
     static void addOpenGLRequirementsString(QString& str, OpenGLRequirementsTypeEnum type);
 
     bool checkForCacheDiskStructure(const QString & cachePath, bool isTiled);
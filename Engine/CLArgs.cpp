@@ -66,6 +66,7 @@ public:
     std::list<std::pair<int, std::pair<int, int> > > frameRanges;
     bool rangeSet;
     bool enableRenderStats;
+    QString traceFilePath;
     bool isEmpty;
     mutable QString imageFilename;
     QString breakpadPipeFilePath;
@@ -93,6 +94,7 @@ public:
         , frameRanges()
         , rangeSet(false)
         , enableRenderStats(false)
+        , traceFilePath()
         , isEmpty(true)
         , imageFilename()
         , breakpadPipeFilePath()
@@ -229,6 +231,7 @@ CLArgs::operator=(const CLArgs& other)
     _imp->frameRanges = other._imp->frameRanges;
     _imp->rangeSet = other._imp->rangeSet;
     _imp->enableRenderStats = other._imp->enableRenderStats;
+    _imp->traceFilePath = other._imp->traceFilePath;
     _imp->isEmpty = other._imp->isEmpty;
     _imp->imageFilename = other._imp->imageFilename;
     _imp->exportDocsPath = other._imp->exportDocsPath;
@@ -338,7 +341,13 @@ CLArgs::printUsage(const std::string& programName)
         "     breakdown contains information about each nodes, render times etc...\n"
         "     This option is useful for debugging purposes or to control that a render\n"
         "     is working correctly.\n"
-        "     **Please note** that it does not work when writing video files."
+        "     **Please note** that it does not work when writing video files.\n"
+        "  --trace <filename>\n"
+        "     Record the actions of the effects, the tiles rendered, the cache\n"
+        "     lookups, the image allocations and the waits on locks of all threads,\n"
+        "     and write them to <filename> on exit in the Chrome trace event JSON\n"
+        "     format. Open it in chrome://tracing or https://ui.perfetto.dev.\n"
+        "     Only the last events of each thread are kept.\n"
         "Sample uses:\n"
         "  %1 /Users/Me/MyNatronProjects/MyProject.ntp\n"
         "  %1 -b -w MyWriter /Users/Me/MyNatronProjects/MyProject.ntp\n"
@@ -517,6 +526,12 @@ CLArgs::areRenderStatsEnabled() const
     return _imp->enableRenderStats;
 }
 
+const QString&
+CLArgs::getTraceFilePath() const
+{
+    return _imp->traceFilePath;
+}
+
 bool
 CLArgs::isPythonScript() const
 {
@@ -878,6 +893,24 @@ CLArgsPrivate::parse()
         }
     }
 
+    {
+        QStringList::iterator it = hasToken( QString::fromUtf8("trace"), QString() );
+        if ( it != args.end() ) {
+            QStringList::iterator next = it;
+            ++next;
+            if ( next != args.end() ) {
+                traceFilePath = *next;
+                args.erase(next);
+                args.erase(it);
+            } else {
+                std::cout << tr("You must specify the trace file path").toStdString() << std::endl;
+                error = 1;
+
+                return;
+            }
+        }
+    }
+
     {
         QStringList::iterator it = hasToken( QString::fromUtf8("export-docs"), QString() );
         if ( it != args.end() ) {
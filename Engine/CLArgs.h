@@ -135,6 +135,8 @@ public:
 
     bool areRenderStatsEnabled() const;
 
+    const QString& getTraceFilePath() const;
+
     const QString& getBreakpadProcessExecutableFilePath() const;
 
     qint64 getBreakpadProcessPID() const;
@@ -45,9 +45,11 @@ GCC_DIAG_OFF(deprecated)
 #include <QtCore/QThread>
 #include <QtCore/QWaitCondition>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QReadWriteLock>
 #include <QtCore/QObject>
 #include <QtCore/QBuffer>
 #include <QtCore/QRunnable>
+#include <QtCore/QAtomicInt>
 GCC_DIAG_ON(deprecated)
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
@@ -56,7 +58,9 @@ GCC_DIAG_ON(deprecated)
 
 #include "Engine/AppManager.h" //for access to settings
 #include "Engine/CacheEntry.h"
+#include "Engine/CacheTOCJournal.h"
 #include "Engine/ImageLocker.h"
+#include "Engine/Timer.h"
 #include "Engine/LRUHashTable.h"
 #include "Engine/MemoryInfo.h" // getSystemTotalRAM
 #include "Engine/Settings.h"
@@ -69,6 +73,20 @@ GCC_DIAG_ON(deprecated)
 
 #define NATRON_TILE_CACHE_FILE_SIZE_BYTES 2000000000
 
+//Maximum number of independently locked shards a cache can be split into
+#define NATRON_CACHE_MAX_SHARDS 64
+
+// When the occupation of a portion of the cache goes above the high watermark, the evictor thread is woken up
+// and evicts entries in the background until the occupation is under the low watermark.
+#define NATRON_CACHE_HIGH_WATERMARK_PERCENT NATRON_CACHE_LIMIT_PERCENT
+#define NATRON_CACHE_LOW_WATERMARK_PERCENT 0.8
+
+// Maximum number of entries evicted by the evictor thread before handing them over to the deleter thread
+#define NATRON_CACHE_EVICTION_BATCH_SIZE 32
+
+// Number of buckets of the eviction latency histograms, see CacheLatencyHistogram
+#define NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS 24
+
 ///When defined, number of opened files, memory size and disk size of the cache are printed whenever there's activity.
 //#define NATRON_DEBUG_CACHE
 
@@ -322,6 +340,122 @@ private:
 };
 
 
+/**
+ * @brief The point of this thread is to keep some free room in the cache, so that threads creating entries do not
+ * have to evict entries themselves. It is woken up when the cache goes above its high watermark and evicts
+ * least recently used entries by batches until the cache is under its low watermark.
+ * Entries backed by a file are written to disk by this thread only, one after another.
+ **/
+class CacheEvictorThread
+    : public QThread
+{
+    mutable QMutex _requestMutex;
+    QWaitCondition _requestCond;
+    bool _evictionRequested; // protected by _requestMutex
+    bool _mustQuit; // protected by _requestMutex
+    CacheAPI* cache;
+
+public:
+
+    CacheEvictorThread(CacheAPI* cache)
+        : QThread()
+        , _requestMutex()
+        , _requestCond()
+        , _evictionRequested(false)
+        , _mustQuit(false)
+        , cache(cache)
+    {
+        setObjectName( QString::fromUtf8("CacheEvictor") );
+    }
+
+    virtual ~CacheEvictorThread()
+    {
+    }
+
+    /**
+     * @brief Wakes up the thread if it is not already evicting. This never blocks.
+     **/
+    void requestEviction()
+    {
+        {
+            QMutexLocker k(&_requestMutex);
+            if (_evictionRequested) {
+                return;
+            }
+            _evictionRequested = true;
+        }
+        if ( !isRunning() ) {
+            start();
+        } else {
+            QMutexLocker k(&_requestMutex);
+            _requestCond.wakeOne();
+        }
+    }
+
+    void quitThread()
+    {
+        if ( !isRunning() ) {
+            return;
+        }
+        {
+            QMutexLocker k(&_requestMutex);
+            _mustQuit = true;
+            _requestCond.wakeOne();
+        }
+        wait();
+        QMutexLocker k(&_requestMutex);
+        _mustQuit = false;
+        _evictionRequested = false;
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        for (;; ) {
+            {
+                QMutexLocker k(&_requestMutex);
+                while (!_evictionRequested && !_mustQuit) {
+                    _requestCond.wait(&_requestMutex);
+                }
+                if (_mustQuit) {
+                    return;
+                }
+                _evictionRequested = false;
+            }
+            cache->evictToLowWatermark();
+        }
+    }
+};
+
+/**
+ * @brief A histogram of latencies: bucket 0 counts the latencies under 1 microsecond and bucket i > 0 the latencies
+ * in [2^(i-1), 2^i[ microseconds. The last bucket also counts all larger latencies.
+ * Not MT-safe.
+ **/
+class CacheLatencyHistogram
+{
+public:
+
+    std::vector<U64> buckets;
+
+    CacheLatencyHistogram()
+        : buckets(NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS, 0)
+    {
+    }
+
+    void add(double seconds)
+    {
+        U64 us = seconds <= 0. ? 0 : (U64)(seconds * 1e6);
+        int bucket = 0;
+        while (us > 0 && bucket < NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS - 1) {
+            us >>= 1;
+            ++bucket;
+        }
+        ++buckets[bucket];
+    }
+};
+
 class CacheSignalEmitter
     : public QObject
 {
@@ -397,6 +531,43 @@ public:
 
     typedef std::list<SerializedEntry> CacheTOC;
 
+    // Serializes the key and params of an entry for the table of contents journal, see CacheSerialization.h
+    typedef void (*TOCPayloadSerializer)(const key_t& key, const ParamsTypePtr& params, std::string* payload);
+
+private:
+
+    /**
+     * @brief The payload of the journal record of an entry, serialized by the thread writing the journal
+     **/
+    class TOCPayload
+        : public CacheTOCJournal::PayloadSerializer
+    {
+        key_t _key;
+        ParamsTypePtr _params;
+        TOCPayloadSerializer _serializer;
+
+public:
+
+        TOCPayload(const key_t& key,
+                   const ParamsTypePtr& params,
+                   TOCPayloadSerializer serializer)
+            : CacheTOCJournal::PayloadSerializer()
+            , _key(key)
+            , _params(params)
+            , _serializer(serializer)
+        {
+        }
+
+        virtual ~TOCPayload()
+        {
+        }
+
+        virtual void serialize(std::string* payload) const OVERRIDE FINAL
+        {
+            _serializer(_key, _params, payload);
+        }
+    };
+
 public:
 
 
@@ -462,6 +633,33 @@ public:
 
 private:
 
+    /**
+     * @brief A shard holds the entries of the cache whose hash maps to it (@see getShard()).
+     * Each shard has its own LRU containers and its own locks, so that look-ups on hashes
+     * falling into different shards never contend. A non-sharded cache has a single shard.
+     * Lock ordering: getLock must always be taken before lock, and a thread never holds
+     * the lock of more than one shard at once.
+     **/
+    struct CacheShard
+    {
+        mutable QMutex lock; //protects memoryCache & diskCache
+        mutable QMutex getLock;  //prevents get() and getOrCreate() to be called simultaneously on this shard
+
+        /*These 2 are mutable because we need to modify the LRU list even
+             when we call get() and we want this function to be const.*/
+        mutable CacheContainer memoryCache;
+        mutable CacheContainer diskCache;
+
+        CacheShard()
+            : lock()
+            , getLock()
+            , memoryCache()
+            , diskCache()
+        {
+        }
+    };
+
+    typedef boost::shared_ptr<CacheShard> CacheShardPtr;
 
     std::size_t _maximumInMemorySize;     // the maximum size of the in-memory portion of the cache.(in % of the maximum cache size)
     std::size_t _maximumCacheSize;     // maximum size allowed for the cache
@@ -472,14 +670,12 @@ private:
     mutable std::size_t _memoryCacheSize;     // current size of the cache in bytes
     mutable std::size_t _diskCacheSize;
     mutable QMutex _sizeLock; // protects _memoryCacheSize & _diskCacheSize & _maximumInMemorySize & _maximumCacheSize
-    mutable QMutex _lock; //protects _memoryCache & _diskCache
-    mutable QMutex _getLock;  //prevents get() and getOrCreate() to be called simultaneously
 
+    // The shards, never resized after construction so this can be read without a lock
+    std::vector<CacheShardPtr> _shards;
 
-    /*These 2 are mutable because we need to modify the LRU list even
-         when we call get() and we want this function to be const.*/
-    mutable CacheContainer _memoryCache;
-    mutable CacheContainer _diskCache;
+    // The shard from which the next global eviction starts, so that all shards are evicted in turn
+    mutable QAtomicInt _nextEvictionShard;
     const std::string _cacheName;
     const unsigned int _version;
 
@@ -493,29 +689,38 @@ private:
     mutable DeleterThread<EntryType> _deleterThread;
     mutable QWaitCondition _memoryFullCondition; //< protected by _sizeLock
     mutable CacheCleanerThread _cleanerThread;
+    mutable CacheEvictorThread _evictorThread;
+
+    // Time spent by the evictor thread per batch and time spent by threads creating entries waiting for room in the cache
+    mutable QMutex _evictionStatsLock;
+    mutable CacheLatencyHistogram _evictionBatchLatency; //< protected by _evictionStatsLock
+    mutable CacheLatencyHistogram _creationBlockedLatency; //< protected by _evictionStatsLock
 
     // If tiled, the cache will consist only of a few large files that each contain tiles of the same size.
     // This is useful to cache chunks of data that always have the same size.
-    mutable QMutex _tileCacheMutex;
+    // Allocating and freeing tiles only takes it for reading: the tiles of each file are protected
+    // by TileCacheFile::usedTilesMutex. It is taken for writing only to add or remove files.
+    mutable QReadWriteLock _tileCacheLock;
     bool _isTiled;
     std::size_t _tileByteSize;
 
-    // True when clearing the cache, protected by _tileCacheMutex
+    // True when clearing the cache, protected by _tileCacheLock
     bool _clearingCache;
 
     // Used when the cache is tiled
     std::set<TileCacheFilePtr> _cacheFiles;
 
-    // When set these are used for fast search of a free tile
-    TileCacheFileWPtr _nextAvailableCacheFile;
-    int _nextAvailableCacheFileIndex;
+    // The table of contents of the disk portion, updated as entries are stored on disk and removed
+    mutable CacheTOCJournal _tocJournal;
+    TOCPayloadSerializer _tocPayloadSerializer;
 public:
 
 
     Cache(const std::string & cacheName,
           unsigned int version,
           U64 maximumCacheSize,      // total size
-          double maximumInMemoryPercentage //how much should live in RAM
+          double maximumInMemoryPercentage, //how much should live in RAM
+          int nShards = 1 // number of independently locked partitions of the cache
           )
         : CacheAPI()
         , _maximumInMemorySize(maximumCacheSize * maximumInMemoryPercentage)
@@ -523,10 +728,8 @@ public:
         , _memoryCacheSize(0)
         , _diskCacheSize(0)
         , _sizeLock()
-        , _lock()
-        , _getLock()
-        , _memoryCache()
-        , _diskCache()
+        , _shards()
+        , _nextEvictionShard(0)
         , _cacheName(cacheName)
         , _version(version)
         , _signalEmitter()
@@ -535,35 +738,52 @@ public:
         , _deleterThread(this)
         , _memoryFullCondition()
         , _cleanerThread(this)
-        , _tileCacheMutex()
+        , _evictorThread(this)
+        , _evictionStatsLock()
+        , _evictionBatchLatency()
+        , _creationBlockedLatency()
+        , _tileCacheLock()
         , _isTiled(false)
         , _tileByteSize(0)
         , _clearingCache(false)
         , _cacheFiles()
-        , _nextAvailableCacheFile()
-        , _nextAvailableCacheFileIndex(-1)
+        , _tocJournal()
+        , _tocPayloadSerializer(0)
     {
         _signalEmitter = boost::make_shared<CacheSignalEmitter>();
+
+        nShards = std::min(std::max(1, nShards), NATRON_CACHE_MAX_SHARDS);
+        _shards.resize(nShards);
+        for (int i = 0; i < nShards; ++i) {
+            _shards[i] = boost::make_shared<CacheShard>();
+        }
     }
 
     virtual ~Cache()
     {
-        QMutexLocker locker(&_lock);
-
         _tearingDown = true;
-        _memoryCache.clear();
-        _diskCache.clear();
+        for (typename std::vector<CacheShardPtr>::iterator it = _shards.begin(); it != _shards.end(); ++it) {
+            QMutexLocker locker(&(*it)->lock);
+            (*it)->memoryCache.clear();
+            (*it)->diskCache.clear();
+        }
+    }
+
+    // const data member: no need to take the lock
+    int getNumShards() const
+    {
+        return (int)_shards.size();
     }
 
     virtual bool isTileCache() const OVERRIDE FINAL
     {
-        QMutexLocker k(&_tileCacheMutex);
+        QReadLocker k(&_tileCacheLock);
         return _isTiled;
     }
 
     virtual std::size_t getTileSizeBytes() const OVERRIDE FINAL
     {
-        QMutexLocker k(&_tileCacheMutex);
+        QReadLocker k(&_tileCacheLock);
         return _tileByteSize;
     }
 
@@ -574,16 +794,64 @@ public:
      **/
     void setTiled(bool tiled, std::size_t tileByteSize)
     {
-        QMutexLocker k(&_tileCacheMutex);
+        QWriteLocker k(&_tileCacheLock);
         _isTiled = tiled;
         _tileByteSize = tileByteSize;
     }
 
+    /**
+     * @brief Set which entries are evicted first when the cache is full, both in memory and on disk.
+     * eCacheReplacementPolicy2Q protects the entries that are re-used (e.g: the images of the frame being tweaked)
+     * from one-pass accesses such as scrubbing the timeline or a background render.
+     **/
+    void setReplacementPolicy(CacheReplacementPolicyEnum policy)
+    {
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard& shard = *_shards[i];
+            QMutexLocker locker(&shard.lock);
+            shard.memoryCache.setReplacementPolicy(policy);
+            shard.diskCache.setReplacementPolicy(policy);
+        }
+    }
+
+    CacheReplacementPolicyEnum getReplacementPolicy() const
+    {
+        QMutexLocker locker(&_shards[0]->lock);
+
+        return _shards[0]->memoryCache.getReplacementPolicy();
+    }
+
 
     void waitForDeleterThread()
     {
+        _evictorThread.quitThread();
         _deleterThread.quitThread();
         _cleanerThread.quitThread();
+
+#ifdef NATRON_DEBUG_CACHE
+        std::vector<U64> evictionBatches, creationBlocked;
+        getEvictionLatencyHistograms(&evictionBatches, &creationBlocked);
+        QString evictionStr, blockedStr;
+        for (std::size_t i = 0; i < evictionBatches.size(); ++i) {
+            evictionStr += QString::number(evictionBatches[i]) + QLatin1Char(' ');
+            blockedStr += QString::number(creationBlocked[i]) + QLatin1Char(' ');
+        }
+        qDebug() << cacheName().c_str() << "eviction batches latency histogram (log2 us):" << evictionStr;
+        qDebug() << cacheName().c_str() << "blocked entry creations latency histogram (log2 us):" << blockedStr;
+#endif
+    }
+
+    /**
+     * @brief Returns the histograms of the time spent evicting each batch of entries by the evictor thread and of the
+     * time spent by threads creating an entry waiting for room in the cache. See CacheLatencyHistogram for the buckets.
+     **/
+    void getEvictionLatencyHistograms(std::vector<U64>* evictionBatches,
+                                      std::vector<U64>* creationBlocked) const
+    {
+        QMutexLocker k(&_evictionStatsLock);
+
+        *evictionBatches = _evictionBatchLatency.buckets;
+        *creationBlocked = _creationBlockedLatency.buckets;
     }
 
     /**
@@ -600,22 +868,37 @@ public:
     bool get(const typename EntryType::key_type & key,
              std::list<EntryTypePtr>* returnValue) const
     {
+        CacheShard& shard = getShard( key.getHash() );
+
         ///Be atomic, so it cannot be created by another thread in the meantime
-        QMutexLocker getlocker(&_getLock);
+        QMutexLocker getlocker(&shard.getLock);
 
         ///lock the cache before reading it.
-        QMutexLocker locker(&_lock);
+        QMutexLocker locker(&shard.lock);
 
-        return getInternal(key, returnValue);
+        return getInternal(shard, key, returnValue);
     } // get
 
 private:
 
+    /**
+     * @brief Returns the shard holding the entries with the given hash.
+     **/
+    CacheShard& getShard(hash_type hash) const
+    {
+        if (_shards.size() == 1) {
+            return *_shards.front();
+        }
+        // Fold the high bits in so that the shard does not only depend on the low bits of the hash
+        U64 h = (U64)hash;
+        h ^= (h >> 33);
 
+        return *_shards[h % _shards.size()];
+    }
 
     virtual TileCacheFilePtr getTileCacheFile(const std::string& filepath, std::size_t dataOffset) OVERRIDE FINAL WARN_UNUSED_RETURN
     {
-        QMutexLocker k(&_tileCacheMutex);
+        QWriteLocker k(&_tileCacheLock);
         assert(_isTiled);
         if (!_isTiled) {
             throw std::logic_error("allocTile() but cache is not tiled!");
@@ -626,8 +909,9 @@ private:
 
                 // The dataOffset should be a multiple of the tile size
                 assert(_tileByteSize * index == dataOffset);
-                assert(!(*it)->usedTiles[index]);
-                (*it)->usedTiles[index] = true;
+                QMutexLocker tk(&(*it)->usedTilesMutex);
+                assert(!(*it)->usedTiles.isUsed(index));
+                (*it)->usedTiles.setUsed(index, true);
                 return *it;
             }
         }
@@ -637,14 +921,13 @@ private:
             TileCacheFilePtr ret = boost::make_shared<TileCacheFile>();
             ret->file = boost::make_shared<MemoryFile>(filepath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail);
             std::size_t nTilesPerFile = std::floor( ( (double)NATRON_TILE_CACHE_FILE_SIZE_BYTES ) / _tileByteSize );
-            ret->usedTiles.resize(nTilesPerFile, false);
+            ret->usedTiles.resize(nTilesPerFile);
             int index = dataOffset / _tileByteSize;
 
             // The dataOffset should be a multiple of the tile size
             assert(_tileByteSize * index == dataOffset);
             assert(index >= 0 && index < (int)ret->usedTiles.size());
-            assert(!ret->usedTiles[index]);
-            ret->usedTiles[index] = true;
+            ret->usedTiles.setUsed(index, true);
             _cacheFiles.insert(ret);
             return ret;
 
@@ -662,67 +945,45 @@ private:
      **/
     virtual TileCacheFilePtr allocTile(std::size_t *dataOffset) OVERRIDE FINAL
     {
-
-        QMutexLocker k(&_tileCacheMutex);
-
-        assert(_isTiled);
-        if (!_isTiled) {
-            throw std::logic_error("allocTile() but cache is not tiled!");
-        }
-        // First, search for a file with available space.
-        // If not found create one
-        TileCacheFilePtr foundAvailableFile;
-        int foundTileIndex = -1;
         {
-            foundAvailableFile = _nextAvailableCacheFile.lock();
-            if (_nextAvailableCacheFileIndex != -1 && foundAvailableFile) {
-                foundTileIndex = _nextAvailableCacheFileIndex;
-                *dataOffset = foundTileIndex * _tileByteSize;
-                _nextAvailableCacheFileIndex = -1;
-                _nextAvailableCacheFile.reset();
-            } else {
-                foundTileIndex = -1;
-                foundAvailableFile.reset();
+            // First, search for a file with available space. Full files are skipped in constant time.
+            QReadLocker k(&_tileCacheLock);
+
+            assert(_isTiled);
+            if (!_isTiled) {
+                throw std::logic_error("allocTile() but cache is not tiled!");
             }
-        }
-        if (foundTileIndex == -1) {
-            for (std::set<TileCacheFilePtr>::iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
-                for (std::size_t i = 0; i < (*it)->usedTiles.size(); ++i) {
-                    if (!(*it)->usedTiles[i])  {
-                        foundTileIndex = i;
-                        *dataOffset = i * _tileByteSize;
-                        break;
-                    }
-                }
-                if (foundTileIndex != -1) {
-                    foundAvailableFile = *it;
-                    break;
-                }
+            TileCacheFilePtr foundAvailableFile = allocTileInExistingFile(dataOffset);
+            if (foundAvailableFile) {
+                return foundAvailableFile;
             }
         }
 
-        if (!foundAvailableFile) {
-            // Create a file if all space is taken
-            foundAvailableFile = boost::make_shared<TileCacheFile>();
-            int nCacheFiles = (int)_cacheFiles.size();
-            std::stringstream cacheFilePathSs;
-            cacheFilePathSs << getCachePath().toStdString() << "/CachePart" << nCacheFiles;
-            std::string cacheFilePath = cacheFilePathSs.str();
-            foundAvailableFile->file = boost::make_shared<MemoryFile>(cacheFilePath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate);
-
-            std::size_t nTilesPerFile = std::floor(((double)NATRON_TILE_CACHE_FILE_SIZE_BYTES) / _tileByteSize);
-            std::size_t cacheFileSize = nTilesPerFile * _tileByteSize;
-            foundAvailableFile->file->resize(cacheFileSize);
-            foundAvailableFile->usedTiles.resize(nTilesPerFile, false);
-            *dataOffset = 0;
-            foundTileIndex = 0;
-            _cacheFiles.insert(foundAvailableFile);
-            _nextAvailableCacheFile = foundAvailableFile;
-            _nextAvailableCacheFileIndex = 1;
-        }
-
-        // Notify the memory file that this portion of the file is valid
-        foundAvailableFile->usedTiles[foundTileIndex] = true;
+        QWriteLocker k(&_tileCacheLock);
+
+        // Another thread may have created a file or freed a tile while we were not holding the lock
+        TileCacheFilePtr foundAvailableFile = allocTileInExistingFile(dataOffset);
+        if (foundAvailableFile) {
+            return foundAvailableFile;
+        }
+
+        // Create a file if all space is taken
+        foundAvailableFile = boost::make_shared<TileCacheFile>();
+        int nCacheFiles = (int)_cacheFiles.size();
+        std::stringstream cacheFilePathSs;
+        cacheFilePathSs << getCachePath().toStdString() << "/CachePart" << nCacheFiles;
+        std::string cacheFilePath = cacheFilePathSs.str();
+        foundAvailableFile->file = boost::make_shared<MemoryFile>(cacheFilePath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate);
+
+        std::size_t nTilesPerFile = std::floor(((double)NATRON_TILE_CACHE_FILE_SIZE_BYTES) / _tileByteSize);
+        std::size_t cacheFileSize = nTilesPerFile * _tileByteSize;
+        foundAvailableFile->file->resize(cacheFileSize);
+        foundAvailableFile->usedTiles.resize(nTilesPerFile);
+        int foundTileIndex = foundAvailableFile->usedTiles.allocFirstFree();
+        assert(foundTileIndex == 0);
+        *dataOffset = foundTileIndex * _tileByteSize;
+        _cacheFiles.insert(foundAvailableFile);
+
         return foundAvailableFile;
     }
 
@@ -731,50 +992,90 @@ private:
              **/
     virtual void freeTile(const TileCacheFilePtr& file, std::size_t dataOffset) OVERRIDE FINAL
     {
-        QMutexLocker k(&_tileCacheMutex);
+        bool mustRemoveFile = false;
+        {
+            QReadLocker k(&_tileCacheLock);
 
-        assert(_isTiled);
-        if (!_isTiled) {
-            throw std::logic_error("allocTile() but cache is not tiled!");
-        }
-        std::set<TileCacheFilePtr>::iterator foundTileFile = _cacheFiles.find(file);
-        assert(foundTileFile != _cacheFiles.end());
-        if (foundTileFile == _cacheFiles.end()) {
-            return;
+            assert(_isTiled);
+            if (!_isTiled) {
+                throw std::logic_error("allocTile() but cache is not tiled!");
+            }
+            std::set<TileCacheFilePtr>::iterator foundTileFile = _cacheFiles.find(file);
+            assert(foundTileFile != _cacheFiles.end());
+            if (foundTileFile == _cacheFiles.end()) {
+                return;
+            }
+            int index = dataOffset / _tileByteSize;
+
+            // The dataOffset should be a multiple of the tile size
+            assert(_tileByteSize * index == dataOffset);
+
+            // If the file does not have any tile associated, remove it
+            // A use_count of 2 means that the tile file is only referenced by the cache itself and the entry calling
+            // the freeTile() function, hence once its freed, no tile should be using it anymore
+            if (file.use_count() <= 2) {
+                // Do not remove the file except if we are clearing the cache
+                if (_clearingCache) {
+                    mustRemoveFile = true;
+                } else {
+                    // Invalidate this portion of the cache while the tile is still marked as used, so that
+                    // a concurrent allocTile() cannot take it and lose the data it writes
+                    file->file->flush(MemoryFile::eFlushTypeInvalidate, file->file->data() + dataOffset, _tileByteSize);
+                }
+            }
+            {
+                QMutexLocker tk(&file->usedTilesMutex);
+                assert(index >= 0 && index < (int)file->usedTiles.size());
+                assert(file->usedTiles.isUsed(index));
+                // Queue the remove record before the tile can be reused, so that it precedes the add record of the next entry
+                _tocJournal.appendRemove(file->file->path(), dataOffset);
+                file->usedTiles.setUsed(index, false);
+            }
         }
-        int index = dataOffset / _tileByteSize;
-
-        // The dataOffset should be a multiple of the tile size
-        assert(_tileByteSize * index == dataOffset);
-        assert(index >= 0 && index < (int)(*foundTileFile)->usedTiles.size());
-        assert((*foundTileFile)->usedTiles[index]);
-        (*foundTileFile)->usedTiles[index] = false;
-
-        // If the file does not have any tile associated, remove it
-        // A use_count of 2 means that the tile file is only referenced by the cache itself and the entry calling
-        // the freeTile() function, hence once its freed, no tile should be using it anymore
-        if ((*foundTileFile).use_count() <= 2) {
-            // Do not remove the file except if we are clearing the cache
-            if (_clearingCache) {
-                (*foundTileFile)->file->remove();
-                _cacheFiles.erase(foundTileFile);
-            } else {
-                // Invalidate this portion of the cache
-                (*foundTileFile)->file->flush(MemoryFile::eFlushTypeInvalidate, (*foundTileFile)->file->data() + dataOffset, _tileByteSize);
+
+        if (mustRemoveFile) {
+            QWriteLocker k(&_tileCacheLock);
+            std::set<TileCacheFilePtr>::iterator foundTileFile = _cacheFiles.find(file);
+            if (foundTileFile != _cacheFiles.end()) {
+                // A tile may have been allocated in this file before we took the write lock
+                bool isEmpty;
+                {
+                    QMutexLocker tk(&(*foundTileFile)->usedTilesMutex);
+                    isEmpty = (*foundTileFile)->usedTiles.getNumFreeTiles() == (*foundTileFile)->usedTiles.size();
+                }
+                if (isEmpty) {
+                    (*foundTileFile)->file->remove();
+                    _cacheFiles.erase(foundTileFile);
+                }
             }
-        } else {
-            _nextAvailableCacheFile = *foundTileFile;
-            _nextAvailableCacheFileIndex = index;
         }
     }
 
+    /**
+     * @brief Marks as used a free tile in one of the existing tile files and returns the file, or
+     * returns NULL if all files are full. Must be called with _tileCacheLock held (for reading or writing).
+     **/
+    TileCacheFilePtr allocTileInExistingFile(std::size_t *dataOffset)
+    {
+        for (std::set<TileCacheFilePtr>::iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
+            QMutexLocker tk(&(*it)->usedTilesMutex);
+            int foundTileIndex = (*it)->usedTiles.allocFirstFree();
+            if (foundTileIndex != -1) {
+                *dataOffset = foundTileIndex * _tileByteSize;
+
+                return *it;
+            }
+        }
+
+        return TileCacheFilePtr();
+    }
 
     void createInternal(const typename EntryType::key_type & key,
                         const ParamsTypePtr & params,
                         ImageLockerHelper<EntryType>* entryLocker,
                         EntryTypePtr* returnValue) const
     {
-        //_lock must not be taken here
+        //No shard lock must be taken here
 
         ///Before allocating the memory check that there's enough space to fit in memory
         appPTR->checkCacheFreeMemoryIsGoodEnough();
@@ -793,27 +1094,33 @@ private:
             ++safeCounter;
         }
 
+        TimeLapse blockedTimer;
+        bool blocked = false;
+
         U64 memoryCacheSize, maximumInMemorySize;
         {
             QMutexLocker k(&_sizeLock);
             memoryCacheSize = _memoryCacheSize;
             maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize );
         }
-        {
-            QMutexLocker locker(&_lock);
+        double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
+        if (occupationPercentage > NATRON_CACHE_HIGH_WATERMARK_PERCENT) {
+            ///Let the evictor thread make room in the background
+            _evictorThread.requestEviction();
+        }
+        if (occupationPercentage >= 1.) {
+            ///The evictor thread did not keep up: erase the last recently used entries until the new entry can fit
+            blocked = true;
             std::list<EntryTypePtr> entriesToBeDeleted;
-            double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
-            ///While the current cache size can't fit the new entry, erase the last recently used entries.
-            ///Also if the total free RAM is under the limit of the system free RAM to keep free, erase LRU entries.
-            while (occupationPercentage > NATRON_CACHE_LIMIT_PERCENT) {
+            while (occupationPercentage >= 1.) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictInMemoryEntry(deleted) ) {
+                if ( !tryEvictInMemoryEntryFromAnyShard(deleted) ) {
                     break;
                 }
 
                 for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
                     entriesToBeDeleted.push_back(*it);
-                    memoryCacheSize -= (*it)->size();
+                    memoryCacheSize -= std::min( (U64)(*it)->size(), memoryCacheSize );
                 }
 
                 occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
@@ -836,15 +1143,14 @@ private:
             //_memoryCacheSize member will get updated while images are being destroyed by the parallel thread.
             //we wait for cache memory occupation to be < 100% to be sure we don't hit swap here
             while ( occupationPercentage >= 1. && _deleterThread.isWorking() ) {
+                blocked = true;
                 _memoryFullCondition.wait(&_sizeLock);
                 occupationPercentage =  _maximumCacheSize == 0 ? 0.99 : (double)_memoryCacheSize / _maximumCacheSize;
             }
         }
         if (_isTiled) {
 
-            QMutexLocker locker(&_lock);
             // For tiled caches, we insert directly into the disk cache, so make sure there is room for it
-            std::list<EntryTypePtr> entriesToBeDeleted;
             U64 diskCacheSize, maximumDiskCacheSize;
             {
                 QMutexLocker k(&_sizeLock);
@@ -852,30 +1158,42 @@ private:
                 maximumDiskCacheSize = std::max( (std::size_t)1, _maximumCacheSize - _maximumInMemorySize );
             }
             double diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
-            while (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
-                std::list<EntryTypePtr> deleted;
-                if ( !tryEvictDiskEntry(deleted) ) {
-                    break;
-                }
+            if (diskPercentage >= NATRON_CACHE_HIGH_WATERMARK_PERCENT) {
+                _evictorThread.requestEviction();
+            }
+            if (diskPercentage >= 1.) {
+                blocked = true;
+                std::list<EntryTypePtr> entriesToBeDeleted;
+                while (diskPercentage >= 1.) {
+                    std::list<EntryTypePtr> deleted;
+                    if ( !tryEvictDiskEntryFromAnyShard(deleted) ) {
+                        break;
+                    }
 
-                for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
-                    diskCacheSize -= (*it)->size();
-                    entriesToBeDeleted.push_back(*it);
+                    for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
+                        diskCacheSize -= std::min( (U64)(*it)->size(), diskCacheSize );
+                        entriesToBeDeleted.push_back(*it);
+                    }
+                    diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
                 }
-                diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
-            }
-            if ( !entriesToBeDeleted.empty() ) {
-                ///Launch a separate thread whose function will be to delete all the entries to be deleted
-                _deleterThread.appendToQueue(entriesToBeDeleted);
+                if ( !entriesToBeDeleted.empty() ) {
+                    ///Launch a separate thread whose function will be to delete all the entries to be deleted
+                    _deleterThread.appendToQueue(entriesToBeDeleted);
 
-                ///Clearing the list here will not delete the objects pointing to by the shared_ptr's because we made a copy
-                ///that the separate thread will delete
-                entriesToBeDeleted.clear();
+                    ///Clearing the list here will not delete the objects pointing to by the shared_ptr's because we made a copy
+                    ///that the separate thread will delete
+                    entriesToBeDeleted.clear();
+                }
             }
 
         }
+        if (blocked) {
+            QMutexLocker k(&_evictionStatsLock);
+            _creationBlockedLatency.add( blockedTimer.getTimeSinceCreation() );
+        }
         {
-            QMutexLocker locker(&_lock);
+            CacheShard& shard = getShard( key.getHash() );
+            QMutexLocker locker(&shard.lock);
 
             try {
                 returnValue->reset( new EntryType(key, params, this ) );
@@ -894,7 +1212,7 @@ private:
                 if (entryLocker) {
                     entryLocker->lock(*returnValue);
                 }
-                sealEntry(*returnValue, _isTiled ? false : true);
+                sealEntry(shard, *returnValue, _isTiled ? false : true);
             }
         }
     } // createInternal
@@ -904,13 +1222,14 @@ public:
     void swapOrInsert(const EntryTypePtr& entryToBeEvicted,
                       const EntryTypePtr& newEntry)
     {
-        QMutexLocker locker(&_lock);
-
         const typename EntryType::key_type& key = entryToBeEvicted->getKey();
         typename EntryType::hash_type hash = entryToBeEvicted->getHashKey();
+        CacheShard& shard = getShard(hash);
+        QMutexLocker locker(&shard.lock);
+
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache(hash);
-        if ( memoryCached != _memoryCache.end() ) {
+        CacheIterator memoryCached = shard.memoryCache.find(hash);
+        if ( memoryCached != shard.memoryCache.end() ) {
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
             for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                 if ( ( (*it)->getKey() == key ) && ( (*it)->getParams() == entryToBeEvicted->getParams() ) ) {
@@ -922,8 +1241,8 @@ public:
             ret.push_back(newEntry);
         } else {
             ///Look in disk cache
-            CacheIterator diskCached = _diskCache(hash);
-            if ( diskCached != _diskCache.end() ) {
+            CacheIterator diskCached = shard.diskCache.find(hash);
+            if ( diskCached != shard.diskCache.end() ) {
                 ///Remove the old entry
                 std::list<EntryTypePtr> & ret = getValueFromIterator(diskCached);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
@@ -934,7 +1253,7 @@ public:
                 }
             }
             ///Insert in mem cache
-            _memoryCache.insert(hash, newEntry);
+            shard.memoryCache.insert(hash, newEntry);
         }
     }
 
@@ -973,14 +1292,15 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
 
+        CacheShard& shard = getShard( key.getHash() );
         {
             ///Be atomic, so it cannot be created by another thread in the meantime
-            QMutexLocker getlocker(&_getLock);
+            QMutexLocker getlocker(&shard.getLock);
             std::list<EntryTypePtr> entries;
             bool didGetSucceed;
             {
-                QMutexLocker locker(&_lock);
-                didGetSucceed = getInternal(key, &entries);
+                QMutexLocker locker(&shard.lock);
+                didGetSucceed = getInternal(shard, key, &entries);
             }
             if (didGetSucceed) {
                 for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
@@ -1004,7 +1324,7 @@ public:
     void clear()
     {
         {
-            QMutexLocker k(&_tileCacheMutex);
+            QWriteLocker k(&_tileCacheLock);
             _clearingCache = true;
         }
         clearDiskPortion();
@@ -1014,13 +1334,16 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            if ( !_isTiled && evictedFromMemory.second->isStoredOnDisk() ) {
-                evictedFromMemory.second->removeAnyBackingFile();
+        for (typename std::vector<CacheShardPtr>::const_iterator shardIt = _shards.begin(); shardIt != _shards.end(); ++shardIt) {
+            CacheShard& shard = **shardIt;
+            QMutexLocker locker(&shard.lock);
+            std::pair<hash_type, EntryTypePtr> evictedFromMemory = shard.memoryCache.evict();
+            while (evictedFromMemory.second) {
+                if ( !_isTiled && evictedFromMemory.second->isStoredOnDisk() ) {
+                    evictedFromMemory.second->removeAnyBackingFile();
+                }
+                evictedFromMemory = shard.memoryCache.evict();
             }
-            evictedFromMemory = _memoryCache.evict();
         }
 
         if (_signalEmitter) {
@@ -1029,7 +1352,7 @@ public:
         }
 
         {
-            QMutexLocker k(&_tileCacheMutex);
+            QWriteLocker k(&_tileCacheLock);
             _clearingCache = false;
         }
     }
@@ -1044,19 +1367,22 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-
-        /// An entry which has a use_count greater than 1 is not removable:
-        /// The backing file must not be removed because it might be read/written to
-        /// at the same time. The best we can do is just let it here in the cache.
-        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-        //we'll let the user of these entries purge the extra entries left in the cache later on
-        while (evictedFromDisk.second) {
-            if (!_isTiled) {
-                evictedFromDisk.second->removeAnyBackingFile();
+        for (typename std::vector<CacheShardPtr>::const_iterator shardIt = _shards.begin(); shardIt != _shards.end(); ++shardIt) {
+            CacheShard& shard = **shardIt;
+            QMutexLocker locker(&shard.lock);
+
+            /// An entry which has a use_count greater than 1 is not removable:
+            /// The backing file must not be removed because it might be read/written to
+            /// at the same time. The best we can do is just let it here in the cache.
+            std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
+            //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+            //we'll let the user of these entries purge the extra entries left in the cache later on
+            while (evictedFromDisk.second) {
+                if (!_isTiled) {
+                    evictedFromDisk.second->removeAnyBackingFile();
+                }
+                evictedFromDisk = shard.diskCache.evict();
             }
-            evictedFromDisk = _diskCache.evict();
         }
 
 
@@ -1073,51 +1399,54 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            // Move back the entry on disk if it can be store on disk
-            // For tiled caches, the tile is sharing the same file with other entries
-            // so we cannot close it, just remove the entry
-            if ( evictedFromMemory.second->isStoredOnDisk() && !_isTiled) {
-                evictedFromMemory.second->deallocate();
-                /*insert it back into the disk portion */
-
-                U64 diskCacheSize, maximumCacheSize;
-                {
-                    QMutexLocker k(&_sizeLock);
-                    diskCacheSize = _diskCacheSize;
-                    maximumCacheSize = _maximumCacheSize;
-                }
-
-                /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-                while (diskCacheSize + evictedFromMemory.second->size() >= maximumCacheSize) {
-                    {
-                        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-                        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-                        //we'll let the user of these entries purge the extra entries left in the cache later on
-                        if (!evictedFromDisk.second) {
-                            break;
-                        }
-                        ///Erase the file from the disk if we reach the limit.
-                        evictedFromDisk.second->removeAnyBackingFile();
-                    }
+        for (typename std::vector<CacheShardPtr>::const_iterator shardIt = _shards.begin(); shardIt != _shards.end(); ++shardIt) {
+            CacheShard& shard = **shardIt;
+            QMutexLocker locker(&shard.lock);
+            std::pair<hash_type, EntryTypePtr> evictedFromMemory = shard.memoryCache.evict();
+            while (evictedFromMemory.second) {
+                // Move back the entry on disk if it can be store on disk
+                // For tiled caches, the tile is sharing the same file with other entries
+                // so we cannot close it, just remove the entry
+                if ( evictedFromMemory.second->isStoredOnDisk() && !_isTiled) {
+                    evictedFromMemory.second->deallocate();
+                    /*insert it back into the disk portion */
+
+                    U64 diskCacheSize, maximumCacheSize;
                     {
                         QMutexLocker k(&_sizeLock);
                         diskCacheSize = _diskCacheSize;
                         maximumCacheSize = _maximumCacheSize;
                     }
-                }
 
-                /*update the disk cache size*/
-                CacheIterator existingDiskCacheEntry = _diskCache( evictedFromMemory.second->getHashKey() );
-                /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-                if ( existingDiskCacheEntry == _diskCache.end() ) {
-                    _diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
+                    /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
+                    while (diskCacheSize + evictedFromMemory.second->size() >= maximumCacheSize) {
+                        {
+                            std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
+                            //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+                            //we'll let the user of these entries purge the extra entries left in the cache later on
+                            if (!evictedFromDisk.second) {
+                                break;
+                            }
+                            ///Erase the file from the disk if we reach the limit.
+                            evictedFromDisk.second->removeAnyBackingFile();
+                        }
+                        {
+                            QMutexLocker k(&_sizeLock);
+                            diskCacheSize = _diskCacheSize;
+                            maximumCacheSize = _maximumCacheSize;
+                        }
+                    }
+
+                    /*update the disk cache size*/
+                    CacheIterator existingDiskCacheEntry = shard.diskCache.find( evictedFromMemory.second->getHashKey() );
+                    /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
+                    if ( existingDiskCacheEntry == shard.diskCache.end() ) {
+                        shard.diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
+                    }
                 }
-            }
 
-            evictedFromMemory = _memoryCache.evict();
+                evictedFromMemory = shard.memoryCache.evict();
+            }
         }
 
         _signalEmitter->blockSignals(false);
@@ -1126,6 +1455,91 @@ public:
         }
     } // clearInMemoryPortion
 
+    /**
+     * @brief Evicts least recently used entries by batches until both the in-memory and on-disk portions of the cache
+     * are under NATRON_CACHE_LOW_WATERMARK_PERCENT. Called by the evictor thread.
+     **/
+    virtual void evictToLowWatermark() const OVERRIDE FINAL
+    {
+        U64 diskCacheSize, maximumDiskCacheSize;
+        {
+            QMutexLocker k(&_sizeLock);
+            diskCacheSize = _diskCacheSize;
+            maximumDiskCacheSize = std::max( (std::size_t)1, _maximumCacheSize - _maximumInMemorySize );
+        }
+        bool memoryDone = false;
+        bool diskDone = (double)diskCacheSize / maximumDiskCacheSize <= NATRON_CACHE_LOW_WATERMARK_PERCENT;
+
+        while (!memoryDone || !diskDone) {
+            TimeLapse batchTimer;
+
+            ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
+            std::list<EntryTypePtr> entriesToBeDeleted;
+
+            // Bytes of the entries evicted by this batch: they still count in _memoryCacheSize until the batch is destroyed
+            U64 pendingMemoryBytes = 0;
+            for (int i = 0; i < NATRON_CACHE_EVICTION_BATCH_SIZE && !memoryDone; ++i) {
+                // Entries backed by a file are not deleted but written to disk, which updates _memoryCacheSize right away
+                U64 memoryCacheSize, maximumInMemorySize;
+                {
+                    QMutexLocker k(&_sizeLock);
+                    memoryCacheSize = _memoryCacheSize;
+                    maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize );
+                }
+                memoryCacheSize -= std::min(pendingMemoryBytes, memoryCacheSize);
+                if ( (double)memoryCacheSize / maximumInMemorySize <= NATRON_CACHE_LOW_WATERMARK_PERCENT ) {
+                    memoryDone = true;
+                    break;
+                }
+
+                std::list<EntryTypePtr> deleted;
+                if ( !tryEvictInMemoryEntryFromAnyShard(deleted) ) {
+                    memoryDone = true;
+                    break;
+                }
+                for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
+                    if ( !(*it)->isStoredOnDisk() ) {
+                        pendingMemoryBytes += (*it)->size();
+                    }
+                    entriesToBeDeleted.push_back(*it);
+                }
+            }
+
+            for (int i = 0; i < NATRON_CACHE_EVICTION_BATCH_SIZE && !diskDone; ++i) {
+                std::list<EntryTypePtr> deleted;
+                if ( !tryEvictDiskEntryFromAnyShard(deleted) ) {
+                    diskDone = true;
+                    break;
+                }
+                for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
+                    diskCacheSize -= std::min( (U64)(*it)->size(), diskCacheSize );
+                    entriesToBeDeleted.push_back(*it);
+                }
+                diskDone = (double)diskCacheSize / maximumDiskCacheSize <= NATRON_CACHE_LOW_WATERMARK_PERCENT;
+            }
+
+            if ( !entriesToBeDeleted.empty() ) {
+                ///Destroy the batch in this thread rather than in the deleter thread: we are already in the background,
+                ///and the next batch must read a _memoryCacheSize that no longer counts the entries of this one,
+                ///otherwise we would evict past the low watermark
+                for (typename std::list<EntryTypePtr>::iterator it = entriesToBeDeleted.begin(); it != entriesToBeDeleted.end(); ++it) {
+                    (*it)->scheduleForDestruction();
+                }
+                entriesToBeDeleted.clear();
+                notifyMemoryDeallocated();
+            }
+
+            double batchTime = batchTimer.getTimeSinceCreation();
+            {
+                QMutexLocker k(&_evictionStatsLock);
+                _evictionBatchLatency.add(batchTime);
+            }
+#ifdef NATRON_DEBUG_CACHE
+            qDebug() << cacheName().c_str() << "evicted a batch in" << batchTime * 1000. << "ms";
+#endif
+        }
+    } // evictToLowWatermark
+
     void clearExceedingEntries()
     {
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
@@ -1133,7 +1547,6 @@ public:
         std::list<EntryTypePtr> entriesToBeDeleted;
 
         {
-            QMutexLocker locker(&_lock);
             U64 memoryCacheSize, maximumInMemorySize;
             {
                 QMutexLocker k(&_sizeLock);
@@ -1143,7 +1556,7 @@ public:
             double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             while (occupationPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictInMemoryEntry(deleted) ) {
+                if ( !tryEvictInMemoryEntryFromAnyShard(deleted) ) {
                     break;
                 }
 
@@ -1165,7 +1578,7 @@ public:
             double diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
             while (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictDiskEntry(deleted) ) {
+                if ( !tryEvictDiskEntryFromAnyShard(deleted) ) {
                     break;
                 }
 
@@ -1175,7 +1588,7 @@ public:
                 }
                 diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
             }
-            
+
 
         }
     }
@@ -1187,15 +1600,18 @@ public:
      **/
     void getCopy(std::list<EntryTypePtr>* copy) const
     {
-        QMutexLocker locker(&_lock);
+        for (typename std::vector<CacheShardPtr>::const_iterator shardIt = _shards.begin(); shardIt != _shards.end(); ++shardIt) {
+            CacheShard& shard = **shardIt;
+            QMutexLocker locker(&shard.lock);
 
-        for (CacheIterator it = _memoryCache.begin(); it != _memoryCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
-        }
-        for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
+            for (CacheIterator it = shard.memoryCache.begin(); it != shard.memoryCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
+            for (CacheIterator it = shard.diskCache.begin(); it != shard.diskCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
         }
     }
 
@@ -1209,13 +1625,8 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
         std::list<EntryTypePtr> entriesToBeDeleted;
-        bool ret;
-        {
-            QMutexLocker locker(&_lock);
-            ret = tryEvictInMemoryEntry(entriesToBeDeleted);
-        }
 
-        return ret;
+        return tryEvictInMemoryEntryFromAnyShard(entriesToBeDeleted);
     }
 
     /**
@@ -1225,10 +1636,9 @@ public:
      **/
     bool evictLRUDiskEntry() const
     {
-
-        QMutexLocker locker(&_lock);
         std::list<EntryTypePtr> entriesToBeDeleted;
-        return tryEvictDiskEntry(entriesToBeDeleted);
+
+        return tryEvictDiskEntryFromAnyShard(entriesToBeDeleted);
     }
 
     /**
@@ -1373,6 +1783,32 @@ public:
         appPTR->decreaseNCacheFilesOpened();
     }
 
+    virtual void notifyEntryStoredOnDisk(const AbstractCacheEntryBase* entry) const OVERRIDE FINAL
+    {
+        if ( !_tocPayloadSerializer || !_tocJournal.isOpen() ) {
+            return;
+        }
+        // All the entries of this cache are of type EntryType
+        const EntryType* cacheEntry = static_cast<const EntryType*>(entry);
+        CacheTOCJournal::Record record;
+        record.hash = cacheEntry->getHashKey();
+        record.size = cacheEntry->dataSize();
+        record.filePath = cacheEntry->getFilePath();
+        record.dataOffsetInFile = cacheEntry->getOffsetInFile();
+        CacheTOCJournal::PayloadSerializerPtr payload( new TOCPayload(cacheEntry->getKey(), cacheEntry->getParams(), _tocPayloadSerializer) );
+        _tocJournal.appendAdd(record, payload);
+    }
+
+    virtual void notifyEntryRemovedFromDisk(const std::string& filePath,
+                                            std::size_t dataOffsetInFile) const OVERRIDE FINAL
+    {
+        // The tiles of a tiled cache are removed from the journal by freeTile()
+        if ( _isTiled || filePath.empty() ) {
+            return;
+        }
+        _tocJournal.appendRemove(filePath, dataOffsetInFile);
+    }
+
     // const data member: no need to take the lock
     const std::string & cacheName() const
     {
@@ -1409,6 +1845,50 @@ public:
         return newCachePath.toStdString();
     }
 
+    std::string getTOCJournalFilePath() const
+    {
+        QString newCachePath( getCachePath() );
+        StrUtils::ensureLastPathSeparator(newCachePath);
+
+        newCachePath.append( QString::fromUtf8(NATRON_CACHE_TOC_JOURNAL_FILE_NAME) );
+
+        return newCachePath.toStdString();
+    }
+
+    /**
+     * @brief Replaces the table of contents journal by one holding the given records, then keeps it up to date
+     * as entries are stored on disk and removed.
+     * @param serializer Serializes the key and params of the entries stored on disk from now on.
+     **/
+    bool openTOCJournal(TOCPayloadSerializer serializer,
+                        const std::vector<CacheTOCJournal::Record>& records)
+    {
+        _tocPayloadSerializer = serializer;
+
+        return _tocJournal.open(getTOCJournalFilePath(), _version, records);
+    }
+
+    /**
+     * @brief Same as openTOCJournal(), but keeps appending to the journal read by CacheTOCJournal::readLiveRecords()
+     * instead of rewriting it.
+     **/
+    bool reopenTOCJournal(TOCPayloadSerializer serializer,
+                          const CacheTOCJournal::ReadInfo& info)
+    {
+        _tocPayloadSerializer = serializer;
+
+        return _tocJournal.openForAppend(getTOCJournalFilePath(), _version, info);
+    }
+
+    /**
+     * @brief Stops updating the table of contents journal: this must be called before destroying the cache,
+     * otherwise freeing the entries would remove them from the journal.
+     **/
+    void closeTOCJournal()
+    {
+        _tocJournal.close();
+    }
+
     void setMaximumCacheSize(U64 newSize)
     {
         QMutexLocker k(&_sizeLock);
@@ -1468,9 +1948,10 @@ public:
         std::list<EntryTypePtr> toRemove;
 
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( entry->getHashKey() );
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheShard& shard = getShard( entry->getHashKey() );
+            QMutexLocker l(&shard.lock);
+            CacheIterator existingEntry = shard.memoryCache.find( entry->getHashKey() );
+            if ( existingEntry != shard.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     if ( (*it)->getKey() == entry->getKey() ) {
@@ -1480,11 +1961,11 @@ public:
                     }
                 }
                 if ( ret.empty() ) {
-                    _memoryCache.erase(existingEntry);
+                    shard.memoryCache.erase(existingEntry);
                 }
             } else {
-                existingEntry = _diskCache( entry->getHashKey() );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = shard.diskCache.find( entry->getHashKey() );
+                if ( existingEntry != shard.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         if ( (*it)->getKey() == entry->getKey() ) {
@@ -1494,11 +1975,11 @@ public:
                         }
                     }
                     if ( ret.empty() ) {
-                        _diskCache.erase(existingEntry);
+                        shard.diskCache.erase(existingEntry);
                     }
                 }
             }
-        } // QMutexLocker l(&_lock);
+        } // QMutexLocker l(&shard.lock);
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
 
@@ -1512,25 +1993,26 @@ public:
     {
         std::list<EntryTypePtr> toRemove;
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( hash);
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheShard& shard = getShard(hash);
+            QMutexLocker l(&shard.lock);
+            CacheIterator existingEntry = shard.memoryCache.find(hash);
+            if ( existingEntry != shard.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     toRemove.push_back(*it);
                 }
-                _memoryCache.erase(existingEntry);
+                shard.memoryCache.erase(existingEntry);
             } else {
-                existingEntry = _diskCache( hash );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = shard.diskCache.find(hash);
+                if ( existingEntry != shard.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         toRemove.push_back(*it);
                     }
-                    _diskCache.erase(existingEntry);
+                    shard.diskCache.erase(existingEntry);
                 }
             }
-        } // QMutexLocker l(&_lock);
+        } // QMutexLocker l(&shard.lock);
 
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
@@ -1541,9 +2023,10 @@ public:
         }
     }
 
-    /*Saves cache to disk as a settings file.
+    /*Writes the entries left in memory to disk and syncs the backing files.
+       The table of contents journal already lists the entries on disk.
      */
-    void save(CacheTOC* tableOfContents);
+    void save();
 
 
     /*Restores the cache from disk.*/
@@ -1574,83 +2057,89 @@ public:
         *diskOccupied = 0;
 
         std::string holderID = holder->getCacheID();
-        QMutexLocker locker(&_lock);
-
-        for (CacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
-            std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                const EntryTypePtr & front = entries.front();
-
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *ramOccupied += (*it)->size();
-                    }
-                }
-            }
-        }
-
-        for (CacheIterator memIt = _diskCache.begin(); memIt != _diskCache.end(); ++memIt) {
-            std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                const EntryTypePtr & front = entries.front();
-
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *diskOccupied += (*it)->size();
-                    }
-                }
-            }
-        }
-    }
-
-private:
 
-    virtual void removeAllEntriesWithDifferentNodeHashForHolderPrivate(const std::string & holderID,
-                                                                       U64 nodeHash,
-                                                                       bool removeAll) OVERRIDE FINAL
-    {
-        std::list<EntryTypePtr> toDelete;
-        CacheContainer newMemCache, newDiskCache;
-        {
-            QMutexLocker locker(&_lock);
+        for (typename std::vector<CacheShardPtr>::const_iterator shardIt = _shards.begin(); shardIt != _shards.end(); ++shardIt) {
+            CacheShard& shard = **shardIt;
+            QMutexLocker locker(&shard.lock);
 
-            for (CacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
+            for (CacheIterator memIt = shard.memoryCache.begin(); memIt != shard.memoryCache.end(); ++memIt) {
                 std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
 
-                    if ( (front->getKey().getCacheHolderID() == holderID) &&
-                         ( ( front->getKey().getTreeVersion() != nodeHash) || removeAll ) ) {
+                    if (front->getKey().getCacheHolderID() == holderID) {
                         for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                            toDelete.push_back(*it);
+                            *ramOccupied += (*it)->size();
                         }
-                    } else {
-                        typename EntryType::hash_type hash = front->getHashKey();
-                        newMemCache.insert(hash, entries);
                     }
                 }
             }
 
-            for (CacheIterator dIt = _diskCache.begin(); dIt != _diskCache.end(); ++dIt) {
-                std::list<EntryTypePtr> & entries = getValueFromIterator(dIt);
+            for (CacheIterator memIt = shard.diskCache.begin(); memIt != shard.diskCache.end(); ++memIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
 
-                    if ( (front->getKey().getCacheHolderID() == holderID) &&
-                         ( ( front->getKey().getTreeVersion() != nodeHash) || removeAll ) ) {
+                    if (front->getKey().getCacheHolderID() == holderID) {
                         for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                            toDelete.push_back(*it);
+                            *diskOccupied += (*it)->size();
                         }
-                    } else {
-                        typename EntryType::hash_type hash = front->getHashKey();
-                        newDiskCache.insert(hash, entries);
                     }
                 }
             }
+        }
+    }
 
-            _memoryCache = newMemCache;
-            _diskCache = newDiskCache;
-        } // QMutexLocker locker(&_lock);
+private:
+
+    /**
+     * @brief Erases from the container the entries of holderID whose node hash is not nodeHash (or all of them if removeAll is true)
+     * and appends them to toDelete. The lock of the shard owning the container must be held.
+     **/
+    static void removeEntriesWithDifferentNodeHash(const std::string & holderID,
+                                                   U64 nodeHash,
+                                                   bool removeAll,
+                                                   CacheContainer & container,
+                                                   std::list<EntryTypePtr>* toDelete)
+    {
+        CacheIterator it = container.begin();
+
+        while ( it != container.end() ) {
+            std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+            bool mustErase = entries.empty();
+            if (!mustErase) {
+                const EntryTypePtr & front = entries.front();
+
+                if ( (front->getKey().getCacheHolderID() == holderID) &&
+                     ( ( front->getKey().getTreeVersion() != nodeHash) || removeAll ) ) {
+                    toDelete->insert( toDelete->end(), entries.begin(), entries.end() );
+                    mustErase = true;
+                }
+            }
+            if (mustErase) {
+                CacheIterator next = it;
+                ++next;
+                container.erase(it);
+                it = next;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    virtual void removeAllEntriesWithDifferentNodeHashForHolderPrivate(const std::string & holderID,
+                                                                       U64 nodeHash,
+                                                                       bool removeAll) OVERRIDE FINAL
+    {
+        std::list<EntryTypePtr> toDelete;
+        for (typename std::vector<CacheShardPtr>::const_iterator shardIt = _shards.begin(); shardIt != _shards.end(); ++shardIt) {
+            CacheShard& shard = **shardIt;
+            QMutexLocker locker(&shard.lock);
+
+            // Erase the stale entries in place so that the containers keep their replacement policy and history
+            removeEntriesWithDifferentNodeHash(holderID, nodeHash, removeAll, shard.memoryCache, &toDelete);
+            removeEntriesWithDifferentNodeHash(holderID, nodeHash, removeAll, shard.diskCache, &toDelete);
+        } // for each shard
 
         if ( !toDelete.empty() ) {
             _deleterThread.appendToQueue(toDelete);
@@ -1661,16 +2150,17 @@ private:
         }
     } // removeAllEntriesWithDifferentNodeHashForHolderPrivate
 
-    bool getInternal(const typename EntryType::key_type & key,
+    bool getInternal(CacheShard& shard,
+                     const typename EntryType::key_type & key,
                      std::list<EntryTypePtr>* returnValue) const
     {
         ///Private should be locked
-        assert( !_lock.tryLock() );
+        assert( !shard.lock.tryLock() );
 
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache( key.getHash() );
+        CacheIterator memoryCached = shard.memoryCache( key.getHash() );
 
-        if ( memoryCached != _memoryCache.end() ) {
+        if ( memoryCached != shard.memoryCache.end() ) {
             ///we found something with a matching hash key. There may be several entries linked to
             ///this key, we need to find one with matching params
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
@@ -1689,9 +2179,9 @@ private:
             return returnValue->size() > 0;
         } else {
             ///fallback on the disk cache internal container
-            CacheIterator diskCached = _diskCache( key.getHash() );
+            CacheIterator diskCached = shard.diskCache( key.getHash() );
 
-            if ( diskCached == _diskCache.end() ) {
+            if ( diskCached == shard.diskCache.end() ) {
                 /*the entry was neither in memory or disk, just allocate a new one*/
                 return false;
             } else {
@@ -1723,7 +2213,7 @@ private:
                             }
 
                             //put it back into the RAM
-                            _memoryCache.insert( (*it)->getHashKey(), *it );
+                            shard.memoryCache.insert( (*it)->getHashKey(), *it );
 
 
                             U64 memoryCacheSize, maximumInMemorySize;
@@ -1735,8 +2225,10 @@ private:
                             std::list<EntryTypePtr> entriesToBeDeleted;
 
                             //now clear extra entries from the disk cache so it doesn't exceed the RAM limit.
+                            //Only this shard is locked, so we can only evict from it: other shards are trimmed
+                            //by the next call to createInternal()
                             while (memoryCacheSize > maximumInMemorySize) {
-                                if ( !tryEvictInMemoryEntry(entriesToBeDeleted) ) {
+                                if ( !tryEvictInMemoryEntry(shard, entriesToBeDeleted) ) {
                                     break;
                                 }
 
@@ -1747,7 +2239,7 @@ private:
                                 }
                             }
                         }
-                        
+
                         returnValue->push_back(*it);
                         ///Q_EMIT the added signal otherwise when first reading something that's already cached
                         ///the timeline wouldn't update
@@ -1760,7 +2252,7 @@ private:
                             ret.erase(it);
 
                             ///Remove it from the disk cache
-                            _diskCache.erase(diskCached);
+                            shard.diskCache.erase(diskCached);
                         }
 
                         return true;
@@ -1777,36 +2269,70 @@ private:
     /** @brief Inserts into the cache an entry that was previously allocated by the createInternal()
      * function. This is called directly by createInternal() if the allocation was successful
      **/
-    void sealEntry(const EntryTypePtr & entry,
+    void sealEntry(CacheShard& shard,
+                   const EntryTypePtr & entry,
                    bool inMemory) const
     {
-        assert( !_lock.tryLock() );   // must be locked
+        assert( !shard.lock.tryLock() );   // must be locked
         typename EntryType::hash_type hash = entry->getHashKey();
 
+        /*if the entry doesn't exist in the container, make a new list and insert it, otherwise append to the existing list.
+           This is not a look-up: it does not count as a hit of the existing record*/
         if (inMemory) {
-            /*if the entry doesn't exist on the memory cache,make a new list and insert it*/
-            CacheIterator existingEntry = _memoryCache(hash);
-            if ( existingEntry == _memoryCache.end() ) {
-                _memoryCache.insert(hash, entry);
-            } else {
-                /*append to the existing list*/
-                getValueFromIterator(existingEntry).push_back(entry);
-            }
+            shard.memoryCache.insert(hash, entry);
         } else {
-            CacheIterator existingEntry = _diskCache(hash);
-            if ( existingEntry == _diskCache.end() ) {
-                _diskCache.insert(hash, entry);
-            } else {
-                /*append to the existing list*/
-                getValueFromIterator(existingEntry).push_back(entry);
+            shard.diskCache.insert(hash, entry);
+        }
+    }
+
+    /**
+     * @brief Evicts the LRU entry of the in-memory portion of one shard, trying each shard in turn
+     * starting from a different one at each call. The caller must not hold any shard lock.
+     * Returns false if nothing could be evicted from any shard.
+     * The access order is only kept within each shard: the evicted entry is the LRU entry of its shard,
+     * not of the whole cache. Evicting the shards in round-robin is an approximation of a global LRU,
+     * which is good enough since the hashes spread the entries evenly across the shards.
+     **/
+    bool tryEvictInMemoryEntryFromAnyShard(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        std::size_t nShards = _shards.size();
+        std::size_t first = (unsigned int)_nextEvictionShard.fetchAndAddRelaxed(1);
+
+        for (std::size_t i = 0; i < nShards; ++i) {
+            CacheShard& shard = *_shards[(first + i) % nShards];
+            QMutexLocker locker(&shard.lock);
+            if ( tryEvictInMemoryEntry(shard, entriesToBeDeleted) ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Same as tryEvictInMemoryEntryFromAnyShard() for the disk portion.
+     **/
+    bool tryEvictDiskEntryFromAnyShard(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        std::size_t nShards = _shards.size();
+        std::size_t first = (unsigned int)_nextEvictionShard.fetchAndAddRelaxed(1);
+
+        for (std::size_t i = 0; i < nShards; ++i) {
+            CacheShard& shard = *_shards[(first + i) % nShards];
+            QMutexLocker locker(&shard.lock);
+            if ( tryEvictDiskEntry(shard, entriesToBeDeleted) ) {
+                return true;
             }
         }
+
+        return false;
     }
 
-    bool tryEvictInMemoryEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    bool tryEvictInMemoryEntry(CacheShard& shard,
+                               std::list<EntryTypePtr> & entriesToBeDeleted) const
     {
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _memoryCache.evict();
+        assert( !shard.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = shard.memoryCache.evict();
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
@@ -1837,7 +2363,7 @@ private:
 
             /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
             while ( ( diskCacheSize  + evicted.second->size() ) >= (maximumCacheSize - maximumInMemorySize) ) {
-                std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
+                std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
                 //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
                 //we'll let the user of these entries purge the extra entries left in the cache later on
                 if (!evictedFromDisk.second) {
@@ -1861,10 +2387,10 @@ private:
                 diskCacheSize -= fsize;
             }
 
-            CacheIterator existingDiskCacheEntry = _diskCache(evicted.first);
+            CacheIterator existingDiskCacheEntry = shard.diskCache.find(evicted.first);
             /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-            if ( existingDiskCacheEntry == _diskCache.end() ) {
-                _diskCache.insert(evicted.first, evicted.second);
+            if ( existingDiskCacheEntry == shard.diskCache.end() ) {
+                shard.diskCache.insert(evicted.first, evicted.second);
             } else {   /*append to the existing list*/
                 getValueFromIterator(existingDiskCacheEntry).push_back(evicted.second);
             }
@@ -1873,11 +2399,12 @@ private:
         return true;
     } // tryEvictEntry
 
-    bool tryEvictDiskEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    bool tryEvictDiskEntry(CacheShard& shard,
+                           std::list<EntryTypePtr> & entriesToBeDeleted) const
     {
 
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _diskCache.evict();
+        assert( !shard.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = shard.diskCache.evict();
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
@@ -33,6 +33,7 @@
 #include <cstring> // for std::memcpy
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
 #ifndef _WIN32
 #include <fstream>
 #endif
@@ -61,6 +62,8 @@
 #include "Engine/Hash64.h"
 #include "Engine/CacheEntryHolder.h"
 #include "Engine/MemoryFile.h"
+#include "Engine/RamBufferPool.h"
+#include "Engine/RenderTrace.h"
 #include "Engine/NonKeyParams.h"
 #include "Engine/Texture.h"
 #include "Engine/EngineFwd.h"
@@ -112,50 +115,189 @@ public:
         if (size == 0) {
             return;
         }
-        count = size;
+        if ( data && ( RamBufferPool::getAllocationSize( size * sizeof(T) ) == RamBufferPool::getAllocationSize( data, count * sizeof(T) ) ) ) {
+            // The buffer is already of the good size class, keep it
+            count = size;
+
+            return;
+        }
         if (data) {
-            free(data);
+            RamBufferPool::deallocate( data, count * sizeof(T) );
             data = 0;
         }
-        if (count == 0) {
-            return;
-        }
-        data = (T*)malloc( size * sizeof(T) );
+        count = size;
+        data = (T*)RamBufferPool::allocate( size * sizeof(T) );
         if (!data) {
+            count = 0;
             throw std::bad_alloc();
         }
     }
 
     void clear()
     {
-        count = 0;
         if (data) {
-            free(data);
+            RamBufferPool::deallocate( data, count * sizeof(T) );
             data = 0;
         }
+        count = 0;
     }
 
     ~RamBuffer()
     {
         if (data) {
-            free(data);
+            RamBufferPool::deallocate( data, count * sizeof(T) );
             data = 0;
         }
     }
 };
 
+/**
+ * @brief A 2-level bitmap of the tiles of a tile cache file.
+ * A bit set in the tiles level means that a tile is used by a cache entry.
+ * A bit set in the summary level means that the corresponding 64-bit word of the tiles level is full,
+ * so that finding a free tile only scans one summary bit per 64 tiles, starting from the first
+ * summary word that may have room, and then uses a find-first-zero in the selected words.
+ * Not MT-safe: see TileCacheFile::usedTilesMutex.
+ **/
+class TileUsageBitmap
+{
+    std::vector<U64> _tiles;
+    std::vector<U64> _summary;
+    std::size_t _nTiles;
+    std::size_t _nFreeTiles;
+
+    // No summary word before this index has a free tile
+    std::size_t _firstNonFullSummaryWord;
+
+public:
+
+    TileUsageBitmap()
+        : _tiles()
+        , _summary()
+        , _nTiles(0)
+        , _nFreeTiles(0)
+        , _firstNonFullSummaryWord(0)
+    {
+    }
+
+    /**
+     * @brief Resize the bitmap to nTiles tiles, all of them free.
+     **/
+    void resize(std::size_t nTiles)
+    {
+        _nTiles = nTiles;
+        _nFreeTiles = nTiles;
+        _firstNonFullSummaryWord = 0;
+        _tiles.assign( (nTiles + 63) / 64, 0 );
+        _summary.assign( (_tiles.size() + 63) / 64, 0 );
+
+        // Mark the bits past the end as used so they are never returned
+        if (nTiles % 64) {
+            _tiles.back() = ~U64(0) << (nTiles % 64);
+        }
+        // Likewise for the summary words past the end of the tiles level
+        if (_tiles.size() % 64) {
+            _summary.back() = ~U64(0) << (_tiles.size() % 64);
+        }
+    }
+
+    std::size_t size() const
+    {
+        return _nTiles;
+    }
+
+    std::size_t getNumFreeTiles() const
+    {
+        return _nFreeTiles;
+    }
+
+    bool isUsed(std::size_t index) const
+    {
+        assert(index < _nTiles);
+
+        return (_tiles[index / 64] >> (index % 64)) & 1;
+    }
+
+    void setUsed(std::size_t index, bool used)
+    {
+        assert(index < _nTiles);
+        std::size_t w = index / 64;
+        U64 mask = U64(1) << (index % 64);
+        if ( ( (_tiles[w] & mask) != 0 ) == used ) {
+            return;
+        }
+        if (used) {
+            _tiles[w] |= mask;
+            --_nFreeTiles;
+            if ( _tiles[w] == ~U64(0) ) {
+                _summary[w / 64] |= U64(1) << (w % 64);
+            }
+        } else {
+            _tiles[w] &= ~mask;
+            ++_nFreeTiles;
+            _summary[w / 64] &= ~( U64(1) << (w % 64) );
+            _firstNonFullSummaryWord = std::min(_firstNonFullSummaryWord, w / 64);
+        }
+    }
+
+    /**
+     * @brief Marks the first free tile as used and returns its index, or -1 if all tiles are used.
+     **/
+    int allocFirstFree()
+    {
+        if (_nFreeTiles == 0) {
+            return -1;
+        }
+        while ( _firstNonFullSummaryWord < _summary.size() && (_summary[_firstNonFullSummaryWord] == ~U64(0)) ) {
+            ++_firstNonFullSummaryWord;
+        }
+        assert( _firstNonFullSummaryWord < _summary.size() );
+        std::size_t w = _firstNonFullSummaryWord * 64 + findFirstZero(_summary[_firstNonFullSummaryWord]);
+        std::size_t index = w * 64 + findFirstZero(_tiles[w]);
+        setUsed(index, true);
+
+        return (int)index;
+    }
+
+private:
+
+    /**
+     * @brief Returns the index of the least significant zero bit of word, which must not be all ones.
+     **/
+    static int findFirstZero(U64 word)
+    {
+        assert( word != ~U64(0) );
+#if defined(__GNUC__) || defined(__clang__)
+
+        return __builtin_ctzll(~word);
+#else
+        int i = 0;
+        while (word & 1) {
+            word >>= 1;
+            ++i;
+        }
+
+        return i;
+#endif
+    }
+};
+
 // This is a cache file with a fixed size that is a multiple of the tileByteSize.
-// A bitset represents the allocated tiles in the file.
-// A value of true means that a tile is used by a cache entry.
+// A bitmap represents the allocated tiles in the file.
 class TileCacheFile
 {
 public:
     MemoryFilePtr file;
-    std::vector<bool> usedTiles;
+
+    // Protects usedTiles, so that tiles of different files may be allocated concurrently
+    QMutex usedTilesMutex;
+    TileUsageBitmap usedTiles;
 };
 
 typedef TileCacheFilePtr TileCacheFilePtr;
 
+class AbstractCacheEntryBase;
+
 /**
  * @brief Defines the API of the Cache as seen by the cache entries
  **/
@@ -205,6 +347,17 @@ public:
      **/
     virtual void backingFileClosed() const = 0;
 
+    /**
+     * @brief To be called once the backing storage on disk of an entry has been allocated, so that the entry
+     * is part of the table of contents of the cache restored on the next launch.
+     **/
+    virtual void notifyEntryStoredOnDisk(const AbstractCacheEntryBase* entry) const = 0;
+
+    /**
+     * @brief To be called when the backing storage on disk of an entry has been removed.
+     **/
+    virtual void notifyEntryRemovedFromDisk(const std::string& filePath, std::size_t dataOffsetInFile) const = 0;
+
     /**
      * @brief To be called whenever an entry is deallocated from memory and put back on disk or whenever
      * it is reallocated in the RAM.
@@ -218,6 +371,12 @@ public:
      **/
     virtual void removeAllEntriesWithDifferentNodeHashForHolderPrivate(const std::string& holderID, U64 nodeHash, bool removeAll) = 0;
 
+    /**
+     * @brief Called by the cache evictor thread: evicts least recently used entries until the cache
+     * occupation is under its low watermark.
+     **/
+    virtual void evictToLowWatermark() const = 0;
+
     /**
      * @brief Relevant only for tiled caches. This will allocate the memory required for a tile in the cache and lock it.
      * Note that the calling entry should have exactly the size of a tile in the cache.
@@ -842,12 +1001,16 @@ public:
             if ( _data.isAllocated() ) {
                 return;
             }
+            RenderTraceScope trace(kRenderTraceCategoryMemory, "allocateMemory");
             allocate();
             onMemoryAllocated(false);
         }
 
         if (_cache) {
             _cache->notifyEntryAllocated( getTime(), size(), storageInfo.mode );
+            if (storageInfo.mode == eStorageModeDisk) {
+                _cache->notifyEntryStoredOnDisk(this);
+            }
         }
     }
 
@@ -1051,12 +1214,17 @@ public:
 
         bool isAlloc;
         bool hasRemovedFile;
+        std::string filePath;
+        std::size_t dataOffset;
         {
             QWriteLocker k(&_entryLock);
             isAlloc = _data.isAllocated();
+            filePath = _data.getFilePath();
+            dataOffset = _data.getOffsetInFile();
             hasRemovedFile = _data.removeAnyBackingFile();
         }
 
+        _cache->notifyEntryRemovedFromDisk(filePath, dataOffset);
         if (hasRemovedFile) {
             _cache->backingFileClosed();
         }
@@ -45,6 +45,8 @@ GCC_DIAG_ON(unused-parameter)
 #endif
 
 #include "Engine/Cache.h"
+#include "Engine/CacheTOCJournal.h"
+#include "Engine/CacheTOCRecordArchive.h"
 #include "Engine/ImageSerialization.h"
 #include "Engine/ImageParamsSerialization.h"
 #include "Engine/FrameEntrySerialization.h"
@@ -63,33 +65,24 @@ GCC_DIAG_ON(unused-parameter)
 
 NATRON_NAMESPACE_ENTER
 
-/*Saves cache to disk as a settings file.
+/*Writes the entries left in memory to disk and syncs the backing files.
  */
 template<typename EntryType>
 void
-Cache<EntryType>::save(CacheTOC* tableOfContents)
+Cache<EntryType>::save()
 {
     clearInMemoryPortion(false);
-    {
-        QMutexLocker l(&_lock);     // must be locked
+    for (typename std::vector<CacheShardPtr>::const_iterator shardIt = _shards.begin(); shardIt != _shards.end(); ++shardIt) {
+        CacheShard& shard = **shardIt;
+        QMutexLocker l(&shard.lock);     // must be locked
 
-        for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
+        for (CacheIterator it = shard.diskCache.begin(); it != shard.diskCache.end(); ++it) {
             std::list<EntryTypePtr> & listOfValues  = getValueFromIterator(it);
             for (typename std::list<EntryTypePtr>::const_iterator it2 = listOfValues.begin(); it2 != listOfValues.end(); ++it2) {
                 if ( (*it2)->isStoredOnDisk() ) {
-                    SerializedEntry serialization;
-                    serialization.hash = (*it2)->getHashKey();
-                    serialization.params = (*it2)->getParams();
-                    serialization.key = (*it2)->getKey();
-                    serialization.size = (*it2)->dataSize();
-                    serialization.filePath = (*it2)->getFilePath();
-                    serialization.dataOffsetInFile = (*it2)->getOffsetInFile();
-
                     (*it2)->syncBackingFile();
-                    
-                    tableOfContents->push_back(serialization);
 #ifdef DEBUG
-                    if ( !_isTiled && !CacheAPI::checkFileNameMatchesHash(serialization.filePath, serialization.hash) ) {
+                    if ( !_isTiled && !CacheAPI::checkFileNameMatchesHash( (*it2)->getFilePath(), (*it2)->getHashKey() ) ) {
                         qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
                     }
 #endif
@@ -148,8 +141,9 @@ Cache<EntryType>::restore(const CacheTOC & tableOfContents)
         const std::string& filePath = value->getFilePath();
         usedFilePaths.insert(QString::fromUtf8(filePath.c_str()));
         {
-            QMutexLocker locker(&_lock);
-            sealEntry(EntryTypePtr(value), false /*inMemory*/);
+            CacheShard& shard = getShard( value->getHashKey() );
+            QMutexLocker locker(&shard.lock);
+            sealEntry(shard, EntryTypePtr(value), false /*inMemory*/);
         }
     }
 
@@ -224,6 +218,88 @@ struct Cache<EntryType>::SerializedEntry
     }
 };
 
+/**
+ * @brief Serializes the key and params of an entry, this is the payload of its record in the table of contents journal.
+ **/
+template<typename EntryType>
+void
+serializeCacheTOCPayload(const typename EntryType::key_type& key,
+                         const boost::shared_ptr<typename EntryType::param_t>& params,
+                         std::string* payload)
+{
+    payload->clear();
+    if (!params) {
+        return;
+    }
+    CacheTOCRecordOArchive oArchive(payload);
+    oArchive << key;
+    oArchive << *params;
+}
+
+/**
+ * @brief Converts the table of contents of a cache to records of its journal
+ **/
+template<typename EntryType>
+void
+cacheTOCToJournalRecords(const typename Cache<EntryType>::CacheTOC& tableOfContents,
+                         std::vector<CacheTOCJournal::Record>* records)
+{
+    records->reserve( tableOfContents.size() );
+    for (typename Cache<EntryType>::CacheTOC::const_iterator it = tableOfContents.begin(); it != tableOfContents.end(); ++it) {
+        CacheTOCJournal::Record record;
+        record.hash = it->hash;
+        record.size = it->size;
+        record.filePath = it->filePath;
+        record.dataOffsetInFile = it->dataOffsetInFile;
+        serializeCacheTOCPayload<EntryType>(it->key, it->params, &record.payload);
+        records->push_back(record);
+    }
+}
+
+/**
+ * @brief Builds the table of contents of a cache from the live records of its journal, read from the mapped journal.
+ * Records that cannot be read are skipped.
+ **/
+template<typename EntryType>
+class CacheTOCBuilder
+    : public CacheTOCJournal::RecordVisitor
+{
+    typename Cache<EntryType>::CacheTOC* _tableOfContents;
+
+public:
+
+    CacheTOCBuilder(typename Cache<EntryType>::CacheTOC* tableOfContents)
+        : CacheTOCJournal::RecordVisitor()
+        , _tableOfContents(tableOfContents)
+    {
+    }
+
+    virtual ~CacheTOCBuilder()
+    {
+    }
+
+    virtual void visit(const CacheTOCJournal::RecordView& record) OVERRIDE FINAL
+    {
+        typename Cache<EntryType>::SerializedEntry entry;
+
+        entry.hash = record.hash;
+        entry.size = record.size;
+        entry.filePath.assign(record.filePath, record.filePathLength);
+        entry.dataOffsetInFile = record.dataOffsetInFile;
+        entry.params.reset(new typename EntryType::param_t);
+
+        CacheTOCRecordIArchive iArchive(record.payload, record.payloadLength);
+        iArchive >> entry.key;
+        iArchive >> *entry.params;
+        if ( !iArchive.isAtEnd() ) {
+            qDebug() << "Failed to read a cache table of contents record of" << entry.filePath.c_str();
+
+            return;
+        }
+        _tableOfContents->push_back(entry);
+    }
+};
+
 NATRON_NAMESPACE_EXIT
 
 
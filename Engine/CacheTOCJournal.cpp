@@ -0,0 +1,769 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheTOCJournal.h"
+
+#include <cassert>
+#include <cstring> // memcpy, memcmp
+#include <cstdio> // std::rename
+#include <map>
+#include <list>
+#include <algorithm>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/crc.hpp>
+#endif
+
+#include <QtCore/QDebug>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+NATRON_NAMESPACE_ENTER
+
+#define NATRON_CACHE_TOC_JOURNAL_MAGIC "NatronTC"
+#define NATRON_CACHE_TOC_RECORD_MAGIC 0x4e54524bU // "NTRK"
+
+namespace {
+enum RecordTypeEnum
+{
+    eRecordTypeAdd = 1,
+    eRecordTypeRemove = 2
+};
+
+struct JournalHeader
+{
+    char magic[8];
+    U32 formatVersion;
+    U32 cacheVersion;
+    U64 reserved;
+};
+
+// Followed by filePathLength bytes for the file path and payloadLength bytes for the payload,
+// then padded so that the next record is 8-byte aligned.
+struct RecordHeader
+{
+    U32 magic;
+    U32 type;
+    U64 hash;
+    U64 size;
+    U64 dataOffsetInFile;
+    U32 filePathLength;
+    U32 payloadLength;
+    U32 checksum; //< of the header with a null checksum, followed by the path and payload
+    U32 padding;
+};
+
+std::size_t
+getRecordPaddedSize(std::size_t filePathLength,
+                    std::size_t payloadLength)
+{
+    return ( sizeof(RecordHeader) + filePathLength + payloadLength + 7 ) & ~(std::size_t)7;
+}
+
+U32
+computeRecordChecksum(const RecordHeader& header,
+                      const char* filePath,
+                      const char* payload)
+{
+    RecordHeader h = header;
+
+    h.checksum = 0;
+    boost::crc_32_type crc;
+    crc.process_bytes( &h, sizeof(RecordHeader) );
+    crc.process_bytes(filePath, header.filePathLength);
+    crc.process_bytes(payload, header.payloadLength);
+
+    return crc.checksum();
+}
+
+void
+makeJournalHeader(unsigned int cacheVersion,
+                  JournalHeader* header)
+{
+    std::memset( header, 0, sizeof(JournalHeader) );
+    std::memcpy(header->magic, NATRON_CACHE_TOC_JOURNAL_MAGIC, sizeof(header->magic));
+    header->formatVersion = NATRON_CACHE_TOC_JOURNAL_FORMAT_VERSION;
+    header->cacheVersion = cacheVersion;
+}
+
+/**
+ * @brief Starts the content of a new journal file in buffer.
+ **/
+void
+beginJournal(unsigned int cacheVersion,
+             std::vector<char>* buffer)
+{
+    JournalHeader header;
+
+    makeJournalHeader(cacheVersion, &header);
+    buffer->resize( sizeof(JournalHeader) );
+    std::memcpy( &(*buffer)[0], &header, sizeof(JournalHeader) );
+}
+
+CacheTOCJournal::RecordView
+getRecordView(const CacheTOCJournal::Record& record)
+{
+    CacheTOCJournal::RecordView view;
+
+    view.hash = record.hash;
+    view.size = record.size;
+    view.dataOffsetInFile = record.dataOffsetInFile;
+    view.filePath = record.filePath.data();
+    view.filePathLength = record.filePath.size();
+    view.payload = record.payload.data();
+    view.payloadLength = record.payload.size();
+
+    return view;
+}
+
+/**
+ * @brief Serializes a record in a buffer, so that it is written to the file with a single write call.
+ **/
+void
+serializeRecord(U32 type,
+                const CacheTOCJournal::RecordView& record,
+                std::vector<char>* buffer)
+{
+    RecordHeader header;
+
+    std::memset( &header, 0, sizeof(RecordHeader) );
+    header.magic = NATRON_CACHE_TOC_RECORD_MAGIC;
+    header.type = type;
+    header.hash = record.hash;
+    header.size = record.size;
+    header.dataOffsetInFile = record.dataOffsetInFile;
+    header.filePathLength = (U32)record.filePathLength;
+    header.payloadLength = (U32)record.payloadLength;
+    header.checksum = computeRecordChecksum(header, record.filePath, record.payload);
+
+    std::size_t offset = buffer->size();
+    buffer->resize(offset + getRecordPaddedSize(record.filePathLength, record.payloadLength), 0);
+    char* data = &(*buffer)[offset];
+    std::memcpy( data, &header, sizeof(RecordHeader) );
+    data += sizeof(RecordHeader);
+    if (record.filePathLength > 0) {
+        std::memcpy(data, record.filePath, record.filePathLength);
+        data += record.filePathLength;
+    }
+    if (record.payloadLength > 0) {
+        std::memcpy(data, record.payload, record.payloadLength);
+    }
+}
+
+/**
+ * @brief The location of the entry of a record, pointing into the mapped journal
+ **/
+struct RecordLocation
+{
+    const char* filePath;
+    std::size_t filePathLength;
+    U64 dataOffsetInFile;
+
+    bool operator<(const RecordLocation& other) const
+    {
+        if (dataOffsetInFile != other.dataOffsetInFile) {
+            return dataOffsetInFile < other.dataOffsetInFile;
+        }
+        if (filePathLength != other.filePathLength) {
+            return filePathLength < other.filePathLength;
+        }
+
+        return std::memcmp(filePath, other.filePath, filePathLength) < 0;
+    }
+};
+
+/**
+ * @brief Copies the live records of a journal to a new one, to compact it.
+ **/
+class RecordCopier
+    : public CacheTOCJournal::RecordVisitor
+{
+    std::vector<char>* _buffer;
+
+public:
+
+    RecordCopier(std::vector<char>* buffer)
+        : CacheTOCJournal::RecordVisitor()
+        , _buffer(buffer)
+    {
+    }
+
+    virtual ~RecordCopier()
+    {
+    }
+
+    virtual void visit(const CacheTOCJournal::RecordView& record) OVERRIDE FINAL
+    {
+        serializeRecord(eRecordTypeAdd, record, _buffer);
+    }
+};
+
+struct PendingRecord
+{
+    U32 type;
+    CacheTOCJournal::Record record;
+    CacheTOCJournal::PayloadSerializerPtr payloadSerializer;
+
+    PendingRecord()
+        : type(0)
+        , record()
+        , payloadSerializer()
+    {
+    }
+};
+
+/**
+ * @brief Writes the queued records of a journal to its file.
+ **/
+class CacheTOCJournalWriterThread
+    : public QThread
+{
+    CacheTOCJournalPrivate* _journal;
+
+public:
+
+    CacheTOCJournalWriterThread(CacheTOCJournalPrivate* journal)
+        : QThread()
+        , _journal(journal)
+    {
+        setObjectName( QString::fromUtf8("CacheTOCJournalWriter") );
+    }
+
+    virtual ~CacheTOCJournalWriterThread()
+    {
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+};
+} // anon namespace
+
+struct CacheTOCJournalPrivate
+{
+    // Protects the queue and the open flag. Never held while writing to the file.
+    mutable QMutex queueMutex;
+    QWaitCondition queueNotEmptyCond;
+
+    // Signaled when the writer thread is done with the records that were queued
+    QWaitCondition queueWrittenCond;
+    std::list<PendingRecord> queue;
+
+    // True while the writer thread writes records it took from the queue
+    bool writing;
+    bool isOpen;
+    bool mustQuit;
+
+    // Set when the journal was opened with too many dead records, so that the writer thread compacts it
+    bool compactionRequested;
+
+    // Only accessed by the writer thread, or by open() and close() once the queue is written
+    QFile file;
+    std::string filePath;
+    unsigned int cacheVersion;
+
+    // Number of records in the file and number of live records when it was last compacted, to trigger compactions
+    U64 nRecords;
+    U64 nLiveRecords;
+
+    CacheTOCJournalWriterThread writer;
+
+    CacheTOCJournalPrivate()
+        : queueMutex()
+        , queueNotEmptyCond()
+        , queueWrittenCond()
+        , queue()
+        , writing(false)
+        , isOpen(false)
+        , mustQuit(false)
+        , compactionRequested(false)
+        , file()
+        , filePath()
+        , cacheVersion(0)
+        , nRecords(0)
+        , nLiveRecords(0)
+        , writer(this)
+    {
+    }
+
+    void enqueue(const PendingRecord& record)
+    {
+        QMutexLocker k(&queueMutex);
+
+        if (!isOpen) {
+            return;
+        }
+        queue.push_back(record);
+        wakeUpWriter();
+    }
+
+    /**
+     * @brief Starts the writer thread, or wakes it up. queueMutex must be held.
+     **/
+    void wakeUpWriter()
+    {
+        assert( !queueMutex.tryLock() );
+        if ( !writer.isRunning() ) {
+            writer.start(QThread::LowPriority);
+        } else {
+            queueNotEmptyCond.wakeOne();
+        }
+    }
+
+    /**
+     * @brief Waits for the writer thread to write all the queued records. queueMutex must be held.
+     **/
+    void waitForQueueWritten()
+    {
+        assert( !queueMutex.tryLock() );
+        while ( writer.isRunning() && ( !queue.empty() || writing || compactionRequested ) ) {
+            queueWrittenCond.wait(&queueMutex);
+        }
+    }
+
+    void quitWriter()
+    {
+        {
+            QMutexLocker k(&queueMutex);
+            if ( !writer.isRunning() ) {
+                return;
+            }
+            mustQuit = true;
+            queueNotEmptyCond.wakeOne();
+        }
+        writer.wait();
+    }
+
+    bool openFile(const std::string& filePath, unsigned int cacheVersion, const std::vector<CacheTOCJournal::Record>& records);
+
+    bool replaceFile(const std::string& filePath, unsigned int cacheVersion, const std::vector<char>& content, U64 nRecords);
+
+    bool openFileForAppend(const std::string& filePath, unsigned int cacheVersion, const CacheTOCJournal::ReadInfo& info);
+
+    bool reopenForAppend();
+
+    void reopenForAppendAfterCompaction();
+
+    void writeRecords(const std::list<PendingRecord>& records);
+
+    bool mustCompact() const
+    {
+        // An add record may supersede a previous one at the same location, so the number of live records is only known
+        // after reading the journal: compact when the journal has grown by a factor of the live records at the last compaction,
+        // so that the cost of compactions stays proportional to the number of appends.
+        return nRecords >= NATRON_CACHE_TOC_JOURNAL_COMPACTION_RATIO * nLiveRecords + NATRON_CACHE_TOC_JOURNAL_COMPACTION_MIN_RECORDS;
+    }
+
+    void compactIfNeeded();
+};
+
+void
+CacheTOCJournalWriterThread::run()
+{
+    for (;; ) {
+        std::list<PendingRecord> records;
+        bool compact;
+        {
+            QMutexLocker k(&_journal->queueMutex);
+            _journal->writing = false;
+            _journal->queueWrittenCond.wakeAll();
+            while ( _journal->queue.empty() && !_journal->compactionRequested && !_journal->mustQuit ) {
+                _journal->queueNotEmptyCond.wait(&_journal->queueMutex);
+            }
+            if ( _journal->queue.empty() && !_journal->compactionRequested ) {
+                // Only quit once every queued record is written
+                _journal->mustQuit = false;
+
+                return;
+            }
+            records.swap(_journal->queue);
+            compact = _journal->compactionRequested;
+            _journal->compactionRequested = false;
+            _journal->writing = true;
+        }
+        _journal->writeRecords(records);
+        if (compact) {
+            _journal->compactIfNeeded();
+        }
+    }
+}
+
+bool
+CacheTOCJournal::readLiveRecords(const std::string& filePath,
+                                 unsigned int cacheVersion,
+                                 RecordVisitor* visitor,
+                                 ReadInfo* info)
+{
+    QFile file( QString::fromUtf8( filePath.c_str() ) );
+
+    if ( !file.open(QIODevice::ReadOnly) ) {
+        return false;
+    }
+    qint64 fileSize = file.size();
+    if ( fileSize < (qint64)sizeof(JournalHeader) ) {
+        return false;
+    }
+    const uchar* data = file.map(0, fileSize);
+    if (!data) {
+        return false;
+    }
+
+    JournalHeader expectedHeader;
+    makeJournalHeader(cacheVersion, &expectedHeader);
+    if (std::memcmp( data, &expectedHeader, sizeof(JournalHeader) ) != 0) {
+        return false;
+    }
+
+    // The live records, indexed by location, and their position in the file to keep the order in which they were added
+    typedef std::map<RecordLocation, std::size_t> LiveRecordsMap;
+    LiveRecordsMap liveRecords;
+    std::size_t offset = sizeof(JournalHeader);
+    U64 nRecords = 0;
+    while (offset + sizeof(RecordHeader) <= (std::size_t)fileSize) {
+        RecordHeader header;
+        std::memcpy( &header, data + offset, sizeof(RecordHeader) );
+        if (header.magic != NATRON_CACHE_TOC_RECORD_MAGIC) {
+            break;
+        }
+        std::size_t recordSize = getRecordPaddedSize(header.filePathLength, header.payloadLength);
+        if (offset + recordSize > (std::size_t)fileSize) {
+            // Truncated by a crash
+            break;
+        }
+        const char* recordFilePath = (const char*)data + offset + sizeof(RecordHeader);
+        const char* recordPayload = recordFilePath + header.filePathLength;
+        if ( computeRecordChecksum(header, recordFilePath, recordPayload) != header.checksum ) {
+            qDebug() << "Cache table of contents" << filePath.c_str() << "has an invalid record, ignoring the following ones";
+            break;
+        }
+
+        RecordLocation location;
+        location.filePath = recordFilePath;
+        location.filePathLength = header.filePathLength;
+        location.dataOffsetInFile = header.dataOffsetInFile;
+        if (header.type == eRecordTypeAdd) {
+            liveRecords[location] = offset;
+        } else {
+            liveRecords.erase(location);
+        }
+        offset += recordSize;
+        ++nRecords;
+    }
+
+    std::vector<std::size_t> liveOffsets;
+    liveOffsets.reserve( liveRecords.size() );
+    for (LiveRecordsMap::const_iterator it = liveRecords.begin(); it != liveRecords.end(); ++it) {
+        liveOffsets.push_back(it->second);
+    }
+    std::sort( liveOffsets.begin(), liveOffsets.end() );
+
+    for (std::size_t i = 0; i < liveOffsets.size(); ++i) {
+        RecordHeader header;
+        std::memcpy( &header, data + liveOffsets[i], sizeof(RecordHeader) );
+        RecordView view;
+        view.hash = header.hash;
+        view.size = header.size;
+        view.dataOffsetInFile = header.dataOffsetInFile;
+        view.filePath = (const char*)data + liveOffsets[i] + sizeof(RecordHeader);
+        view.filePathLength = header.filePathLength;
+        view.payload = view.filePath + header.filePathLength;
+        view.payloadLength = header.payloadLength;
+        visitor->visit(view);
+    }
+
+    info->validSize = offset;
+    info->nRecords = nRecords;
+    info->nLiveRecords = liveOffsets.size();
+
+    return true;
+} // CacheTOCJournal::readLiveRecords
+
+bool
+CacheTOCJournalPrivate::openFile(const std::string& filePath,
+                                 unsigned int cacheVersion,
+                                 const std::vector<CacheTOCJournal::Record>& records)
+{
+    std::vector<char> buffer;
+
+    beginJournal(cacheVersion, &buffer);
+    for (std::vector<CacheTOCJournal::Record>::const_iterator it = records.begin(); it != records.end(); ++it) {
+        serializeRecord( eRecordTypeAdd, getRecordView(*it), &buffer );
+    }
+
+    return replaceFile(filePath, cacheVersion, buffer, records.size());
+}
+
+bool
+CacheTOCJournalPrivate::replaceFile(const std::string& filePath,
+                                    unsigned int cacheVersion,
+                                    const std::vector<char>& content,
+                                    U64 nRecords)
+{
+    if ( file.isOpen() ) {
+        file.close();
+    }
+
+    // Write the compacted journal next to the current one and replace it once complete,
+    // so that a crash while compacting leaves the previous journal intact
+    std::string tmpFilePath = filePath + ".tmp";
+    {
+        QFile tmpFile( QString::fromUtf8( tmpFilePath.c_str() ) );
+        if ( !tmpFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ) {
+            qDebug() << "Failed to write the cache table of contents" << tmpFilePath.c_str();
+
+            return false;
+        }
+        if ( tmpFile.write( &content[0], content.size() ) != (qint64)content.size() ) {
+            qDebug() << "Failed to write the cache table of contents" << tmpFilePath.c_str();
+            tmpFile.remove();
+
+            return false;
+        }
+        tmpFile.close();
+    }
+#ifdef __NATRON_WIN32__
+    // rename() does not replace existing files on Windows
+    QFile::remove( QString::fromUtf8( filePath.c_str() ) );
+#endif
+    if (std::rename( tmpFilePath.c_str(), filePath.c_str() ) != 0) {
+        qDebug() << "Failed to replace the cache table of contents" << filePath.c_str();
+        QFile::remove( QString::fromUtf8( tmpFilePath.c_str() ) );
+
+        return false;
+    }
+
+    file.setFileName( QString::fromUtf8( filePath.c_str() ) );
+    if ( !file.open(QIODevice::WriteOnly | QIODevice::Append) ) {
+        qDebug() << "Failed to open the cache table of contents" << filePath.c_str();
+
+        return false;
+    }
+    this->filePath = filePath;
+    this->cacheVersion = cacheVersion;
+    this->nRecords = nRecords;
+    nLiveRecords = nRecords;
+
+    return true;
+} // CacheTOCJournalPrivate::replaceFile
+
+bool
+CacheTOCJournalPrivate::openFileForAppend(const std::string& filePath,
+                                          unsigned int cacheVersion,
+                                          const CacheTOCJournal::ReadInfo& info)
+{
+    if ( file.isOpen() ) {
+        file.close();
+    }
+
+    // Cut the record torn by a crash: the records appended after it would never be read
+    QString qFilePath = QString::fromUtf8( filePath.c_str() );
+    if ( ( QFile(qFilePath).size() > (qint64)info.validSize ) && !QFile::resize(qFilePath, info.validSize) ) {
+        qDebug() << "Failed to repair the cache table of contents" << filePath.c_str();
+
+        return false;
+    }
+
+    this->filePath = filePath;
+    this->cacheVersion = cacheVersion;
+    nRecords = info.nRecords;
+    nLiveRecords = info.nLiveRecords;
+
+    return reopenForAppend();
+}
+
+bool
+CacheTOCJournalPrivate::reopenForAppend()
+{
+    file.setFileName( QString::fromUtf8( filePath.c_str() ) );
+    if ( !file.open(QIODevice::WriteOnly | QIODevice::Append) ) {
+        qDebug() << "Failed to open the cache table of contents" << filePath.c_str() << ", the cache will not be restored";
+
+        return false;
+    }
+
+    return true;
+}
+
+void
+CacheTOCJournalPrivate::reopenForAppendAfterCompaction()
+{
+    // Called by the writer thread only
+    if ( !reopenForAppend() ) {
+        QMutexLocker k(&queueMutex);
+        isOpen = false;
+        queue.clear();
+    }
+}
+
+void
+CacheTOCJournalPrivate::writeRecords(const std::list<PendingRecord>& records)
+{
+    // Called by the writer thread only
+    if ( !file.isOpen() ) {
+        return;
+    }
+
+    std::vector<char> buffer;
+    for (std::list<PendingRecord>::const_iterator it = records.begin(); it != records.end(); ++it) {
+        if (it->payloadSerializer) {
+            CacheTOCJournal::Record record = it->record;
+            it->payloadSerializer->serialize(&record.payload);
+            serializeRecord( it->type, getRecordView(record), &buffer );
+        } else {
+            serializeRecord( it->type, getRecordView(it->record), &buffer );
+        }
+    }
+    if ( buffer.empty() ) {
+        return;
+    }
+
+    // Flush right away: the records are in the OS buffers and survive a crash of the application
+    if ( ( file.write( &buffer[0], buffer.size() ) != (qint64)buffer.size() ) || !file.flush() ) {
+        qDebug() << "Failed to append to the cache table of contents" << filePath.c_str();
+
+        return;
+    }
+    nRecords += records.size();
+    compactIfNeeded();
+}
+
+void
+CacheTOCJournalPrivate::compactIfNeeded()
+{
+    // Called by the writer thread only
+    if ( !file.isOpen() || !mustCompact() ) {
+        return;
+    }
+
+    file.close();
+    std::vector<char> buffer;
+    beginJournal(cacheVersion, &buffer);
+    RecordCopier copier(&buffer);
+    CacheTOCJournal::ReadInfo info;
+    if ( !CacheTOCJournal::readLiveRecords(filePath, cacheVersion, &copier, &info) ) {
+        // Keep appending to the journal as it is, and do not retry before it grows again
+        qDebug() << "Failed to compact the cache table of contents" << filePath.c_str();
+        nLiveRecords = nRecords;
+        reopenForAppendAfterCompaction();
+
+        return;
+    }
+
+    std::string journalFilePath = filePath;
+    if ( !replaceFile(journalFilePath, cacheVersion, buffer, info.nLiveRecords) ) {
+        // The previous journal is left intact when the compacted one could not replace it
+        nLiveRecords = nRecords;
+        reopenForAppendAfterCompaction();
+    }
+}
+
+CacheTOCJournal::CacheTOCJournal()
+    : _imp( new CacheTOCJournalPrivate() )
+{
+}
+
+CacheTOCJournal::~CacheTOCJournal()
+{
+    close();
+    _imp->quitWriter();
+}
+
+bool
+CacheTOCJournal::open(const std::string& filePath,
+                      unsigned int cacheVersion,
+                      const std::vector<Record>& records)
+{
+    QMutexLocker k(&_imp->queueMutex);
+
+    // The writer thread is idle once the queue is written: the file can be replaced
+    _imp->waitForQueueWritten();
+    _imp->isOpen = _imp->openFile(filePath, cacheVersion, records);
+
+    return _imp->isOpen;
+}
+
+bool
+CacheTOCJournal::openForAppend(const std::string& filePath,
+                               unsigned int cacheVersion,
+                               const ReadInfo& info)
+{
+    QMutexLocker k(&_imp->queueMutex);
+
+    _imp->waitForQueueWritten();
+    _imp->isOpen = _imp->openFileForAppend(filePath, cacheVersion, info);
+    if ( _imp->isOpen && _imp->mustCompact() ) {
+        _imp->compactionRequested = true;
+        _imp->wakeUpWriter();
+    }
+
+    return _imp->isOpen;
+}
+
+void
+CacheTOCJournal::close()
+{
+    QMutexLocker k(&_imp->queueMutex);
+
+    _imp->waitForQueueWritten();
+    _imp->isOpen = false;
+    if ( _imp->file.isOpen() ) {
+        _imp->file.close();
+    }
+}
+
+bool
+CacheTOCJournal::isOpen() const
+{
+    QMutexLocker k(&_imp->queueMutex);
+
+    return _imp->isOpen;
+}
+
+void
+CacheTOCJournal::appendAdd(const Record& record,
+                           const PayloadSerializerPtr& payloadSerializer)
+{
+    PendingRecord pending;
+
+    pending.type = eRecordTypeAdd;
+    pending.record = record;
+    pending.payloadSerializer = payloadSerializer;
+    _imp->enqueue(pending);
+}
+
+void
+CacheTOCJournal::appendRemove(const std::string& filePath,
+                              U64 dataOffsetInFile)
+{
+    PendingRecord pending;
+
+    pending.type = eRecordTypeRemove;
+    pending.record.filePath = filePath;
+    pending.record.dataOffsetInFile = dataOffsetInFile;
+    _imp->enqueue(pending);
+}
+
+NATRON_NAMESPACE_EXIT
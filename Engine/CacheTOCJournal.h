@@ -0,0 +1,230 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHETOCJOURNAL_H
+#define NATRON_ENGINE_CACHETOCJOURNAL_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+#include "Engine/EngineFwd.h"
+
+// Name of the journal file in the cache directory
+#define NATRON_CACHE_TOC_JOURNAL_FILE_NAME "toc." NATRON_CACHE_FILE_EXT
+
+// Bump this when the layout of the journal records changes
+#define NATRON_CACHE_TOC_JOURNAL_FORMAT_VERSION 2
+
+// The journal is compacted once it holds more than RATIO times the number of live records at the last compaction
+// plus MIN_RECORDS records
+#define NATRON_CACHE_TOC_JOURNAL_COMPACTION_RATIO 2
+#define NATRON_CACHE_TOC_JOURNAL_COMPACTION_MIN_RECORDS 4096
+
+NATRON_NAMESPACE_ENTER
+
+struct CacheTOCJournalPrivate;
+
+/**
+ * @brief The table of contents of the on-disk portion of a cache, kept up to date while the cache is used.
+ * It is an append-only file: a header followed by fixed-layout records, each followed by the path of the
+ * backing file and an opaque payload (the key and params of the entry, written by the cache with a CacheTOCRecordOArchive).
+ * A record either adds the entry stored at a location (file path + offset in the file) or removes it: the last
+ * record for a location wins, so a tile reused by another entry does not need a remove record first.
+ * Each record has a checksum: reading stops at the first invalid record, which is what a crash in the middle of
+ * an append leaves behind, so a crash loses at most the last entry instead of the whole table of contents.
+ * Reading maps the file, validates the records in place and hands the live ones to a visitor which decodes them
+ * from the mapped file.
+ * When too many records are dead, the journal is compacted: the live records are written to a new file which
+ * atomically replaces the journal.
+ * Appending only queues the record: a background thread serializes the payloads, writes the records in
+ * the order they were queued and compacts the journal, so that neither cache allocations nor the launch of the
+ * application wait for the disk.
+ * This class is MT-safe.
+ **/
+class CacheTOCJournal
+{
+public:
+
+    struct Record
+    {
+        U64 hash;
+        U64 size; //< the data size in bytes
+        U64 dataOffsetInFile;
+        std::string filePath;
+        std::string payload;
+
+        Record()
+            : hash(0)
+            , size(0)
+            , dataOffsetInFile(0)
+            , filePath()
+            , payload()
+        {
+        }
+    };
+
+    /**
+     * @brief A live record as it is in the mapped journal: the file path and payload point into the file.
+     **/
+    struct RecordView
+    {
+        U64 hash;
+        U64 size;
+        U64 dataOffsetInFile;
+        const char* filePath;
+        std::size_t filePathLength;
+        const char* payload;
+        std::size_t payloadLength;
+
+        RecordView()
+            : hash(0)
+            , size(0)
+            , dataOffsetInFile(0)
+            , filePath(0)
+            , filePathLength(0)
+            , payload(0)
+            , payloadLength(0)
+        {
+        }
+    };
+
+    /**
+     * @brief Receives the live records of the journal while it is mapped, in the order they were added.
+     **/
+    class RecordVisitor
+    {
+public:
+
+        RecordVisitor()
+        {
+        }
+
+        virtual ~RecordVisitor()
+        {
+        }
+
+        virtual void visit(const RecordView& record) = 0;
+    };
+
+    /**
+     * @brief What readLiveRecords() found, so that the journal can be appended to without being rewritten.
+     **/
+    struct ReadInfo
+    {
+        // Size of the header and of the valid records: anything after was left by a crash
+        U64 validSize;
+        U64 nRecords;
+        U64 nLiveRecords;
+
+        ReadInfo()
+            : validSize(0)
+            , nRecords(0)
+            , nLiveRecords(0)
+        {
+        }
+    };
+
+    /**
+     * @brief Produces the payload of an add record, called from the thread writing the journal.
+     **/
+    class PayloadSerializer
+    {
+public:
+
+        PayloadSerializer()
+        {
+        }
+
+        virtual ~PayloadSerializer()
+        {
+        }
+
+        virtual void serialize(std::string* payload) const = 0;
+    };
+
+    typedef boost::shared_ptr<const PayloadSerializer> PayloadSerializerPtr;
+
+    CacheTOCJournal();
+
+    ~CacheTOCJournal();
+
+    /**
+     * @brief Maps the journal at filePath and passes its live records to visitor, in the order they were added.
+     * @returns False if the file does not exist or was not written by this cache version: in that case the files
+     * of the cache on disk cannot be trusted.
+     **/
+    static bool readLiveRecords(const std::string& filePath, unsigned int cacheVersion, RecordVisitor* visitor, ReadInfo* info);
+
+    /**
+     * @brief Atomically replaces the journal at filePath by one containing only the given records and keeps it
+     * open to append to it. The journal previously opened, if any, is closed after its queued records are written.
+     * @returns False if the journal could not be written, in which case the journal is left closed.
+     **/
+    bool open(const std::string& filePath, unsigned int cacheVersion, const std::vector<Record>& records);
+
+    /**
+     * @brief Keeps appending to the journal at filePath, as read by readLiveRecords(), without rewriting it.
+     * What follows the valid records is cut first, so that the records appended from now on can be read back.
+     * If the journal holds too many dead records, it is compacted by the background thread.
+     * @returns False if the journal could not be opened, in which case the journal is left closed.
+     **/
+    bool openForAppend(const std::string& filePath, unsigned int cacheVersion, const ReadInfo& info);
+
+    /**
+     * @brief Writes the queued records and stops journaling. Entries removed after this are still part of the table
+     * of contents on disk, this is called before destroying the cache so that freeing its entries does not empty
+     * the table of contents.
+     **/
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * @brief Records that an entry is stored at record.filePath, record.dataOffsetInFile.
+     * The payload of the record is produced by payloadSerializer when the record is written.
+     **/
+    void appendAdd(const Record& record, const PayloadSerializerPtr& payloadSerializer);
+
+    /**
+     * @brief Records that the entry stored at filePath, dataOffsetInFile is no longer part of the cache.
+     **/
+    void appendRemove(const std::string& filePath, U64 dataOffsetInFile);
+
+private:
+
+    boost::scoped_ptr<CacheTOCJournalPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_CACHETOCJOURNAL_H
@@ -0,0 +1,294 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHETOCRECORDARCHIVE_H
+#define NATRON_ENGINE_CACHETOCRECORDARCHIVE_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <cstring> // memcpy
+#include <string>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+GCC_DIAG_OFF(unused-parameter)
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <boost/mpl/bool.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/serialization.hpp>
+#include <boost/serialization/version.hpp>
+// For the base_object() of the params
+#include <boost/serialization/extended_type_info_typeid.hpp>
+#include <boost/serialization/void_cast.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/is_enum.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+GCC_DIAG_ON(unused-parameter)
+#endif
+
+#include "Global/GlobalDefines.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The archives used for the payload of the records of the table of contents journal (see CacheTOCJournal).
+ * They go through the serialize() functions of the keys and params, but without the type information, tracking and
+ * stream of the boost archives: numbers and enums are stored as they are in memory, strings and vectors are prefixed
+ * by their 32-bit length. The payload is read in place from the mapped journal, and every read is checked
+ * against the end of the record.
+ * Only what the cache keys and params need is supported: pointers are not.
+ **/
+class CacheTOCRecordOArchive
+{
+public:
+
+    typedef boost::mpl::bool_<false> is_loading;
+    typedef boost::mpl::bool_<true> is_saving;
+
+    explicit CacheTOCRecordOArchive(std::string* buffer)
+        : _buffer(buffer)
+    {
+    }
+
+    template<class T>
+    CacheTOCRecordOArchive& operator&(const boost::serialization::nvp<T>& t)
+    {
+        save( t.value() );
+
+        return *this;
+    }
+
+    template<class T>
+    CacheTOCRecordOArchive& operator&(const T& t)
+    {
+        save(t);
+
+        return *this;
+    }
+
+    template<class T>
+    CacheTOCRecordOArchive& operator<<(const T& t)
+    {
+        return *this & t;
+    }
+
+private:
+
+    void saveBytes(const void* data,
+                   std::size_t size)
+    {
+        _buffer->append( (const char*)data, size );
+    }
+
+    template<class T>
+    void save(const T& t)
+    {
+        saveValue( t, boost::mpl::bool_<boost::is_arithmetic<T>::value || boost::is_enum<T>::value>() );
+    }
+
+    void save(const bool& t)
+    {
+        unsigned char c = t ? 1 : 0;
+
+        saveBytes( &c, sizeof(c) );
+    }
+
+    void save(const std::string& t)
+    {
+        U32 size = (U32)t.size();
+
+        saveBytes( &size, sizeof(size) );
+        saveBytes( t.data(), t.size() );
+    }
+
+    template<class T>
+    void save(const std::vector<T>& t)
+    {
+        U32 size = (U32)t.size();
+
+        saveBytes( &size, sizeof(size) );
+        for (typename std::vector<T>::const_iterator it = t.begin(); it != t.end(); ++it) {
+            save(*it);
+        }
+    }
+
+    template<class T>
+    void saveValue(const T& t,
+                   boost::mpl::true_)
+    {
+        saveBytes( &t, sizeof(T) );
+    }
+
+    template<class T>
+    void saveValue(const T& t,
+                   boost::mpl::false_)
+    {
+        boost::serialization::serialize_adl( *this, const_cast<T&>(t), boost::serialization::version<T>::value );
+    }
+
+    std::string* _buffer;
+};
+
+class CacheTOCRecordIArchive
+{
+public:
+
+    typedef boost::mpl::bool_<true> is_loading;
+    typedef boost::mpl::bool_<false> is_saving;
+
+    CacheTOCRecordIArchive(const char* data,
+                           std::size_t size)
+        : _data(data)
+        , _end(data + size)
+        , _valid(true)
+    {
+    }
+
+    /**
+     * @brief Returns false if the record ended before everything was read, in which case the values read are garbage.
+     **/
+    bool isValid() const
+    {
+        return _valid;
+    }
+
+    /**
+     * @brief Returns true if the whole record was read.
+     **/
+    bool isAtEnd() const
+    {
+        return _valid && _data == _end;
+    }
+
+    template<class T>
+    CacheTOCRecordIArchive& operator&(const boost::serialization::nvp<T>& t)
+    {
+        load( t.value() );
+
+        return *this;
+    }
+
+    template<class T>
+    CacheTOCRecordIArchive& operator&(T& t)
+    {
+        load(t);
+
+        return *this;
+    }
+
+    template<class T>
+    CacheTOCRecordIArchive& operator>>(T& t)
+    {
+        return *this & t;
+    }
+
+private:
+
+    bool loadBytes(void* data,
+                   std::size_t size)
+    {
+        if ( !_valid || ( size > (std::size_t)(_end - _data) ) ) {
+            _valid = false;
+
+            return false;
+        }
+        std::memcpy(data, _data, size);
+        _data += size;
+
+        return true;
+    }
+
+    template<class T>
+    void load(T& t)
+    {
+        loadValue( t, boost::mpl::bool_<boost::is_arithmetic<T>::value || boost::is_enum<T>::value>() );
+    }
+
+    void load(bool& t)
+    {
+        unsigned char c = 0;
+
+        loadBytes( &c, sizeof(c) );
+        t = c != 0;
+    }
+
+    void load(std::string& t)
+    {
+        U32 size = 0;
+
+        if ( !loadBytes( &size, sizeof(size) ) ) {
+            return;
+        }
+        if ( size > (std::size_t)(_end - _data) ) {
+            _valid = false;
+
+            return;
+        }
+        t.assign(_data, size);
+        _data += size;
+    }
+
+    template<class T>
+    void load(std::vector<T>& t)
+    {
+        U32 size = 0;
+
+        // Each element takes at least one byte: this bounds the allocation when the record is garbage
+        if ( !loadBytes( &size, sizeof(size) ) ) {
+            return;
+        }
+        if ( size > (std::size_t)(_end - _data) ) {
+            _valid = false;
+
+            return;
+        }
+        t.resize(size);
+        for (typename std::vector<T>::iterator it = t.begin(); it != t.end() && _valid; ++it) {
+            load(*it);
+        }
+    }
+
+    template<class T>
+    void loadValue(T& t,
+                   boost::mpl::true_)
+    {
+        loadBytes( &t, sizeof(T) );
+    }
+
+    template<class T>
+    void loadValue(T& t,
+                   boost::mpl::false_)
+    {
+        boost::serialization::serialize_adl( *this, t, boost::serialization::version<T>::value );
+    }
+
+    const char* _data;
+    const char* _end;
+    bool _valid;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_CACHETOCRECORDARCHIVE_H
@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <cassert>
 #include <stdexcept>
+#include <vector>
 
 #if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
@@ -54,23 +55,6 @@ struct KeyFrameCloner
     }
 };
 
-class KeyFrameTimePredicate
-{
-public:
-    KeyFrameTimePredicate(double t)
-        : _t(t)
-    {
-    };
-
-    bool operator()(const KeyFrame & f)
-    {
-        return f.getTime() == _t;
-    }
-
-private:
-    double _t;
-};
-
 NATRON_NAMESPACE_ANONYMOUS_EXIT
 
 
@@ -304,6 +288,7 @@ Curve::setPeriodic(bool periodic)
     QMutexLocker k(&_imp->_lock);
     _imp->isPeriodic = periodic;
     _imp->keyFrames.clear();
+    _imp->invalidateSnapshot();
 }
 
 bool
@@ -324,6 +309,7 @@ Curve::clearKeyFrames()
     QMutexLocker l(&_imp->_lock);
 
     _imp->keyFrames.clear();
+    _imp->invalidateSnapshot();
 }
 
 bool
@@ -783,15 +769,31 @@ Curve::getKeyFrameWithTime(double time,
     return true;
 }
 
-/// compute interpolation parameters from keyframes and an iterator
+/// the first keyframe with time > t
+static KeyFrameSet::const_iterator
+upperBoundKeyFrame(const KeyFrameSet &keyFrames,
+                   double t)
+{
+    return keyFrames.upper_bound( KeyFrame(t, 0.) );
+}
+
+static std::vector<KeyFrame>::const_iterator
+upperBoundKeyFrame(const std::vector<KeyFrame> &keyFrames,
+                   double t)
+{
+    return std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(t, 0.), KeyFrame_compare_time() );
+}
+
+/// compute interpolation parameters from keyframes (a KeyFrameSet or a sorted vector) and an iterator
 /// to the next keyframe (the first with time > t)
+template <typename KeyFrames>
 static void
-interParams(const KeyFrameSet &keyFrames,
+interParams(const KeyFrames &keyFrames,
             bool isPeriodic,
             double xMin,
             double xMax,
             double *t,
-            KeyFrameSet::const_iterator itup,
+            typename KeyFrames::const_iterator itup,
             double *tcur,
             double *vcur,
             double *vcurDerivRight,
@@ -817,7 +819,7 @@ interParams(const KeyFrameSet &keyFrames,
             }
             assert(*t >= minKeyFrameX && *t <= minKeyFrameX + period);
         }
-        itup = keyFrames.upper_bound(KeyFrame(*t, 0.));
+        itup = upperBoundKeyFrame(keyFrames, *t);
     }
     if ( itup == keyFrames.begin() ) {
         // We are in the case where all keys have a greater time
@@ -827,7 +829,7 @@ interParams(const KeyFrameSet &keyFrames,
             *vnext = itup->getValue();
             *vnextDerivLeft = itup->getLeftDerivative();
             *interpNext = itup->getInterpolation();
-            KeyFrameSet::const_reverse_iterator last =  keyFrames.rbegin();
+            typename KeyFrames::const_reverse_iterator last =  keyFrames.rbegin();
             *tcur = last->getTime() - period;
             *vcur = last->getValue();
             *vcurDerivRight = last->getRightDerivative();
@@ -848,8 +850,8 @@ interParams(const KeyFrameSet &keyFrames,
         // We are in the case where no key has a greater time
         // If periodic, we are in-between the last keyframe and xMax
         if (isPeriodic) {
-            KeyFrameSet::const_iterator next = keyFrames.begin();
-            KeyFrameSet::const_reverse_iterator prev = keyFrames.rbegin();
+            typename KeyFrames::const_iterator next = keyFrames.begin();
+            typename KeyFrames::const_reverse_iterator prev = keyFrames.rbegin();
             *tcur = prev->getTime();
             *vcur = prev->getValue();
             *vcurDerivRight = prev->getRightDerivative();
@@ -860,7 +862,7 @@ interParams(const KeyFrameSet &keyFrames,
             *interpNext = next->getInterpolation();
         } else {
 
-            KeyFrameSet::const_reverse_iterator itlast = keyFrames.rbegin();
+            typename KeyFrames::const_reverse_iterator itlast = keyFrames.rbegin();
             *tcur = itlast->getTime();
             *vcur = itlast->getValue();
             *vcurDerivRight = itlast->getRightDerivative();
@@ -874,7 +876,7 @@ interParams(const KeyFrameSet &keyFrames,
     } else {
         // between two keyframes
         // get the last keyframe with time <= t
-        KeyFrameSet::const_iterator itcur = itup;
+        typename KeyFrames::const_iterator itcur = itup;
         --itcur;
         assert(itcur->getTime() <= *t);
         *tcur = itcur->getTime();
@@ -888,76 +890,128 @@ interParams(const KeyFrameSet &keyFrames,
     }
 }
 
-double
-Curve::getValueAt(double t,
-                  bool doClamp) const
+/// the clamping range of a curve, @see Curve::getCurveYRange()
+static Curve::YRange
+getCurveYRangeForOwner(KnobI* owner,
+                       int dimensionInOwner,
+                       double yMin,
+                       double yMax)
 {
-    QMutexLocker l(&_imp->_lock);
+    if ( !owner && (yMin == -std::numeric_limits<double>::infinity()) && (yMax == std::numeric_limits<double>::infinity()) ) {
+        // nothing to clamp
+        return Curve::YRange( -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity() );
+    }
+    if (!owner) {
+        return Curve::YRange(yMin, yMax);
+    }
 
-    if ( _imp->keyFrames.empty() ) {
-        //throw std::runtime_error("Curve has no control points!");
+    KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>(owner);
+    KnobIntBase* isInt = dynamic_cast<KnobIntBase*>(owner);
+    if (isDouble) {
+        double min = isDouble->getMinimum(dimensionInOwner);
+        if (min <= -DBL_MAX) {
+            min = -std::numeric_limits<double>::infinity();
+        }
+        double max = isDouble->getMaximum(dimensionInOwner);
+        if (max >= DBL_MAX) {
+            max = std::numeric_limits<double>::infinity();
+        }
 
-        // A curve with no control points is considered to be 0
-        // this is to avoid returning StatFailed when KnobParametric::getValue() is called on a parametric curve without control point.
-        return 0.;
+        return Curve::YRange(min, max);
+    } else if (isInt) {
+        double min = isInt->getMinimum(dimensionInOwner);
+        double max = isInt->getMaximum(dimensionInOwner);
 
-        // There is no special case for a curve with one (1) keyframe: the result is a linear curve before and after the keyframe.
-    //} else if (_imp->keyFrames.size() == 1) {
-    //    return _imp->keyFrames.begin()->getValue();
+        return Curve::YRange(min, max);
+    } else {
+        return Curve::YRange( -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity() );
     }
+}
 
-    double v;
-#ifdef NATRON_CURVE_USE_CACHE
-    std::map<double, double>::const_iterator foundCached = _imp->resultCache.find(t);
-    if ( foundCached != _imp->resultCache.end() ) {
-        v = foundCached->second;
-    } else
-#endif
-    {
-        // even when there is only one keyframe, there may be tangents!
-        //if (_imp->keyFrames.size() == 1) {
-        //    //if there's only 1 keyframe, don't bother interpolating
-        //    return (*_imp->keyFrames.begin()).getValue();
-        //}
-        double tcur, tnext;
-        double vcurDerivRight, vnextDerivLeft, vcur, vnext;
-        KeyframeTypeEnum interp, interpNext;
-        KeyFrame k(t, 0.);
-        // find the first keyframe with time greater than t
-        KeyFrameSet::const_iterator itup;
-        itup = _imp->keyFrames.upper_bound(k);
-        interParams(_imp->keyFrames,
-                    _imp->isPeriodic,
-                    _imp->xMin,
-                    _imp->xMax,
-                    &t,
-                    itup,
-                    &tcur,
-                    &vcur,
-                    &vcurDerivRight,
-                    &interp,
-                    &tnext,
-                    &vnext,
-                    &vnextDerivLeft,
-                    &interpNext);
+/// Returns the snapshot of the current state of the curve, building it if the curve changed since the last call.
+/// Only the build takes the lock.
+static CurvePrivate::SnapshotPtr
+getCurveSnapshot(CurvePrivate& imp)
+{
+    CurvePrivate::SnapshotPtr ret = boost::atomic_load(&imp.snapshot);
 
-        v = Interpolation::interpolate(tcur, vcur,
-                                       vcurDerivRight,
-                                       vnextDerivLeft,
-                                       tnext, vnext,
-                                       t,
-                                       interp,
-                                       interpNext);
-#ifdef NATRON_CURVE_USE_CACHE
-        _imp->resultCache[t] = v;
-#endif
+    if (ret) {
+        return ret;
     }
 
-    if ( doClamp && mustClamp() ) {
-        v = clampValueToCurveYRange(v);
+    QMutexLocker l(&imp._lock);
+    // another thread may have built it while we were waiting for the lock
+    ret = boost::atomic_load(&imp.snapshot);
+    if (ret) {
+        return ret;
+    }
+
+    boost::shared_ptr<CurvePrivate::Snapshot> snapshot(new CurvePrivate::Snapshot);
+    snapshot->keyFrames.assign( imp.keyFrames.begin(), imp.keyFrames.end() );
+    snapshot->owner = imp.owner;
+    snapshot->dimensionInOwner = imp.dimensionInOwner;
+    snapshot->type = imp.type;
+    snapshot->xMin = imp.xMin;
+    snapshot->xMax = imp.xMax;
+    snapshot->yMin = imp.yMin;
+    snapshot->yMax = imp.yMax;
+    snapshot->isPeriodic = imp.isPeriodic;
+    ret = snapshot;
+    boost::atomic_store(&imp.snapshot, ret);
+
+    return ret;
+}
+
+/// interpolates the curve at time t, itup being the first keyframe with time > t
+static double
+interpolateSnapshot(const CurvePrivate::Snapshot& snapshot,
+                    double t,
+                    std::vector<KeyFrame>::const_iterator itup)
+{
+    // even when there is only one keyframe, there may be tangents!
+    double tcur, tnext;
+    double vcurDerivRight, vnextDerivLeft, vcur, vnext;
+    KeyframeTypeEnum interp, interpNext;
+
+    interParams(snapshot.keyFrames,
+                snapshot.isPeriodic,
+                snapshot.xMin,
+                snapshot.xMax,
+                &t,
+                itup,
+                &tcur,
+                &vcur,
+                &vcurDerivRight,
+                &interp,
+                &tnext,
+                &vnext,
+                &vnextDerivLeft,
+                &interpNext);
+
+    return Interpolation::interpolate(tcur, vcur,
+                                      vcurDerivRight,
+                                      vnextDerivLeft,
+                                      tnext, vnext,
+                                      t,
+                                      interp,
+                                      interpNext);
+}
+
+/// clamps the interpolated value v and rounds it according to the curve type
+static double
+finalizeSnapshotValue(const CurvePrivate::Snapshot& snapshot,
+                      const Curve::YRange* clampRange,
+                      double v)
+{
+    if (clampRange) {
+        if (v > clampRange->max) {
+            v = clampRange->max;
+        } else if (v < clampRange->min) {
+            v = clampRange->min;
+        }
     }
 
-    switch (_imp->type) {
+    switch (snapshot.type) {
     case CurvePrivate::eCurveTypeString:
     case CurvePrivate::eCurveTypeInt:
 
@@ -972,8 +1026,76 @@ Curve::getValueAt(double t,
 
         return v;
     }
+}
+
+double
+Curve::getValueAt(double t,
+                  bool doClamp) const
+{
+    CurvePrivate::SnapshotPtr snapshot = getCurveSnapshot(*_imp);
+
+    if ( snapshot->keyFrames.empty() ) {
+        //throw std::runtime_error("Curve has no control points!");
+
+        // A curve with no control points is considered to be 0
+        // this is to avoid returning StatFailed when KnobParametric::getValue() is called on a parametric curve without control point.
+        return 0.;
+
+        // There is no special case for a curve with one (1) keyframe: the result is a linear curve before and after the keyframe.
+    }
+
+    // find the first keyframe with time greater than t
+    double v = interpolateSnapshot( *snapshot, t, upperBoundKeyFrame(snapshot->keyFrames, t) );
+
+    if (doClamp) {
+        YRange clampRange = getCurveYRangeForOwner(snapshot->owner, snapshot->dimensionInOwner, snapshot->yMin, snapshot->yMax);
+
+        return finalizeSnapshotValue(*snapshot, &clampRange, v);
+    }
+
+    return finalizeSnapshotValue(*snapshot, NULL, v);
 } // getValueAt
 
+void
+Curve::getValuesAt(const double* times,
+                   double* out,
+                   int n,
+                   bool doClamp) const
+{
+    if (n <= 0) {
+        return;
+    }
+    assert(times && out);
+
+    CurvePrivate::SnapshotPtr snapshot = getCurveSnapshot(*_imp);
+    const std::vector<KeyFrame>& keyFrames = snapshot->keyFrames;
+
+    if ( keyFrames.empty() ) {
+        // A curve with no control points is considered to be 0, @see getValueAt
+        std::fill(out, out + n, 0.);
+
+        return;
+    }
+
+    // the range does not depend on the time: fetch it once
+    YRange clampRange = getCurveYRangeForOwner(snapshot->owner, snapshot->dimensionInOwner, snapshot->yMin, snapshot->yMax);
+    const YRange* clampRangePtr = doClamp ? &clampRange : NULL;
+    std::vector<KeyFrame>::const_iterator itup = upperBoundKeyFrame(keyFrames, times[0]);
+
+    for (int i = 0; i < n; ++i) {
+        const double t = times[i];
+        if ( (i > 0) && (t >= times[i - 1]) ) {
+            // increasing times: the next keyframe is at or after the previous one
+            while ( itup != keyFrames.end() && itup->getTime() <= t ) {
+                ++itup;
+            }
+        } else if (i > 0) {
+            itup = upperBoundKeyFrame(keyFrames, t);
+        }
+        out[i] = finalizeSnapshotValue( *snapshot, clampRangePtr, interpolateSnapshot(*snapshot, t, itup) );
+    }
+} // getValuesAt
+
 double
 Curve::getDerivativeAt(double t) const
 {
@@ -1188,35 +1310,7 @@ Curve::YRange Curve::getCurveYRange() const
 {
     QMutexLocker l(&_imp->_lock);
 
-    if ( !mustClamp() ) {
-        return YRange( -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity() );
-    }
-    if (!_imp->owner) {
-        return YRange(_imp->yMin, _imp->yMax);
-    }
-
-    KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>(_imp->owner);
-    KnobIntBase* isInt = dynamic_cast<KnobIntBase*>(_imp->owner);
-    if (isDouble) {
-        double min = isDouble->getMinimum(_imp->dimensionInOwner);
-        if (min <= -DBL_MAX) {
-            min = -std::numeric_limits<double>::infinity();
-        }
-        double max = isDouble->getMaximum(_imp->dimensionInOwner);
-        if (max >= DBL_MAX) {
-            max = std::numeric_limits<double>::infinity();
-        }
-
-        return YRange(min, max);
-    } else if (isInt) {
-        double min = isInt->getMinimum(_imp->dimensionInOwner);
-        double max = isInt->getMaximum(_imp->dimensionInOwner);
-
-        return YRange(min, max);
-    } else {
-        return YRange( -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity() );
-    }
-
+    return getCurveYRangeForOwner(_imp->owner, _imp->dimensionInOwner, _imp->yMin, _imp->yMax);
 }
 
 double
@@ -1252,6 +1346,7 @@ Curve::setXRange(double a,
 
     _imp->xMin = a;
     _imp->xMax = b;
+    _imp->invalidateSnapshot();
 }
 
 std::pair<double, double> Curve::getXRange() const
@@ -1727,7 +1822,8 @@ KeyFrameSet::const_iterator
 Curve::findWithTime(const KeyFrameSet& keys,
                     double time)
 {
-    return std::find_if( keys.begin(), keys.end(), KeyFrameTimePredicate(time) );
+    // the set is ordered by time only, so this is the keyframe with exactly this time
+    return keys.find( KeyFrame(time, 0.) );
 }
 
 KeyFrameSet::const_iterator
@@ -1817,6 +1913,7 @@ Curve::setYRange(double yMin,
 
     _imp->yMin = yMin;
     _imp->yMax = yMax;
+    _imp->invalidateSnapshot();
 }
 
 bool
@@ -1830,12 +1927,11 @@ void
 Curve::onCurveChanged()
 {
     // PRIVATE - should not lock
+    // the next reader rebuilds the snapshot: this way a series of modifications only builds it once
+    _imp->invalidateSnapshot();
     if (_imp->owner) {
         _imp->owner->clearExpressionsResults(_imp->dimensionInOwner);
     }
-#ifdef NATRON_CURVE_USE_CACHE
-    _imp->resultCache.clear();
-#endif
 }
 
 void
@@ -250,9 +250,18 @@ public:
     /*
      * The interpolated curve value.
      * An empty curve has a value of zero everywhere/
+     * This does not lock the curve: it reads an immutable snapshot of the keyframes, which is rebuilt
+     * by the first call following a modification.
      */
     double getValueAt(double t, bool clamp = true) const WARN_UNUSED_RETURN;
 
+    /*
+     * Same as getValueAt() for the n times in times, the results are written to out.
+     * All values are computed from the same state of the curve, and the keyframes are searched incrementally
+     * when the times are increasing (e.g: the columns of the curve editor, or the motion blur samples).
+     */
+    void getValuesAt(const double* times, double* out, int n, bool clamp = true) const;
+
     double getDerivativeAt(double t) const WARN_UNUSED_RETURN;
 
     double getIntegrateFromTo(double t1, double t2) const WARN_UNUSED_RETURN;
@@ -27,6 +27,8 @@
 
 #include "Global/Macros.h"
 
+#include <vector>
+
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
 #endif
@@ -39,8 +41,6 @@
 #include "Engine/KnobFile.h"
 #include "Engine/EngineFwd.h"
 
-//#define NATRON_CURVE_USE_CACHE
-
 NATRON_NAMESPACE_ENTER
 
 struct CurvePrivate
@@ -55,12 +55,25 @@ struct CurvePrivate
         // and times
     };
 
-    KeyFrameSet keyFrames;
+    /**
+     * @brief An immutable copy of everything needed to evaluate the curve, with the keyframes in a sorted array.
+     * Readers (getValueAt, getValuesAt) access it without taking _lock: it is never modified once published,
+     * and any change to the curve replaces the pointer instead (@see Curve::onCurveChanged).
+     **/
+    struct Snapshot
+    {
+        std::vector<KeyFrame> keyFrames; //< sorted by increasing time, like the KeyFrameSet
+        KnobI* owner;
+        int dimensionInOwner;
+        CurveTypeEnum type;
+        double xMin, xMax;
+        double yMin, yMax;
+        bool isPeriodic;
+    };
 
-#ifdef NATRON_CURVE_USE_CACHE
-    std::map<double, double> resultCache; //< a cache for interpolations
-#endif
+    typedef boost::shared_ptr<const Snapshot> SnapshotPtr;
 
+    KeyFrameSet keyFrames;
     KnobI* owner;
     int dimensionInOwner;
     CurveTypeEnum type;
@@ -70,11 +83,13 @@ struct CurvePrivate
     bool isParametric;
     bool isPeriodic;
 
+    // The snapshot of the current state, built lazily by the first reader after a change.
+    // It must be accessed with boost::atomic_load/boost::atomic_store, and reset with invalidateSnapshot() whenever
+    // one of the members above changes.
+    SnapshotPtr snapshot;
+
     CurvePrivate()
         : keyFrames()
-#ifdef NATRON_CURVE_USE_CACHE
-        , resultCache()
-#endif
         , owner(NULL)
         , dimensionInOwner(-1)
         , type(eCurveTypeDouble)
@@ -85,6 +100,7 @@ struct CurvePrivate
         , _lock(QMutex::Recursive)
         , isParametric(false)
         , isPeriodic(false)
+        , snapshot()
     {
     }
 
@@ -106,9 +122,13 @@ struct CurvePrivate
         yMin = other.yMin;
         yMax = other.yMax;
         isPeriodic = other.isPeriodic;
+        invalidateSnapshot();
     }
 
-    
+    void invalidateSnapshot()
+    {
+        boost::atomic_store( &snapshot, SnapshotPtr() );
+    }
 };
 
 NATRON_NAMESPACE_EXIT
@@ -72,6 +72,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/PluginMemory.h"
 #include "Engine/Project.h"
 #include "Engine/RenderStats.h"
+#include "Engine/RenderTrace.h"
 #include "Engine/RotoContext.h"
 #include "Engine/RotoDrawableItem.h"
 #include "Engine/ReadNode.h"
@@ -1636,6 +1637,7 @@ EffectInstance::getImageFromCacheAndConvertIfNeeded(bool /*useCache*/,
                                                     const OSGLContextAttacherPtr& glContextAttacher,
                                                     ImagePtr* image)
 {
+    RenderTraceScope trace(kRenderTraceCategoryCache, "getImageFromCache", this, roi);
     ImageList cachedImages;
     bool isCached = false;
 
@@ -2151,8 +2153,8 @@ EffectInstance::Implementation::tiledRenderingFunctor(EffectInstance::Implementa
     if (callingThread != curThread) {
         ///We are in the case of host frame threading, see kOfxImageEffectPluginPropHostFrameThreading
         ///We know that in the renderAction, TLS will be needed, so we do a deep copy of the TLS from the caller thread
-        ///to this thread
-        appPTR->getAppTLS()->copyTLS(callingThread, curThread);
+        ///to this thread. The caller thread renders tiles too and modifies its TLS meanwhile: copy its snapshot instead.
+        appPTR->getAppTLS()->copyTLS(args.callingThreadTLS, callingThread, curThread);
     }
 
 
@@ -2176,12 +2178,24 @@ EffectInstance::Implementation::tiledRenderingFunctor(EffectInstance::Implementa
                                                                         args.processChannels,
                                                                         args.planes);
 
-    //Exit of the host frame threading thread
-    appPTR->getAppTLS()->cleanupTLSForThread();
+    //Exit of the host frame threading thread. The calling thread also renders tiles while it waits and keeps its TLS
+    if (callingThread != curThread) {
+        appPTR->getAppTLS()->cleanupTLSForThread();
+    }
 
     return ret;
 }
 
+void
+EffectInstance::Implementation::tiledRenderingTask(TiledRenderingFunctorArgs* args,
+                                                   const std::vector<RectToRender>* rects,
+                                                   QThread* callingThread,
+                                                   std::vector<RenderingFunctorRetEnum>* results,
+                                                   int index)
+{
+    (*results)[index] = tiledRenderingFunctor(*args, (*rects)[index], callingThread);
+}
+
 EffectInstance::RenderingFunctorRetEnum
 EffectInstance::Implementation::tiledRenderingFunctor(const RectToRender & rectToRender,
                                                       const bool renderFullScaleThenDownscale,
@@ -2203,6 +2217,8 @@ EffectInstance::Implementation::tiledRenderingFunctor(const RectToRender & rectT
                                                       const std::bitset<4>& processChannels,
                                                       const ImagePlanesToRenderPtr & planes) // when MT, planes is a copy so there's is no data race
 {
+    RenderTraceScope trace(kRenderTraceCategoryRender, "renderTile", _publicInterface, rectToRender.rect);
+
     ///There cannot be the same thread running 2 concurrent instances of renderRoI on the same effect.
 #ifdef DEBUG
     {
@@ -3741,6 +3757,7 @@ EffectInstance::render_public(const RenderActionArgs & args)
 {
     NON_RECURSIVE_ACTION();
     REPORT_CURRENT_THREAD_ACTION( kOfxImageEffectActionRender, getNode() );
+    RenderTraceScope trace(kRenderTraceCategoryAction, "render", this, args.roi);
 
     return render(args);
 }
@@ -3754,6 +3771,7 @@ EffectInstance::getTransform_public(double time,
                                     Transform::Matrix3x3* transform)
 {
     RECURSIVE_ACTION();
+    RenderTraceScope trace(kRenderTraceCategoryAction, "getTransform", this);
     //assert( getNode()->getCurrentCanTransform() ); // called in every case for overlays
 
     return getTransform(time, renderScale, draftRender, view, inputToTransform, transform);
@@ -3770,6 +3788,7 @@ EffectInstance::isIdentity_public(bool useIdentityCache, // only set to true whe
                                   ViewIdx* inputView,
                                   int* inputNb)
 {
+    RenderTraceScope trace(kRenderTraceCategoryAction, "isIdentity", this, renderWindow);
     //assert( !( (supportsRenderScaleMaybe() == eSupportsNo) && !(scale.x == 1. && scale.y == 1.) ) );
 
     if (useIdentityCache) {
@@ -3865,6 +3884,7 @@ EffectInstance::getRegionOfDefinition_public(U64 hash,
         return eStatusFailed;
     }
 
+    RenderTraceScope trace(kRenderTraceCategoryAction, "getRegionOfDefinition", this);
     unsigned int mipMapLevel = Image::getLevelFromScale(scale.x);
     bool foundInCache = _imp->actionsCache->getRoDResult(hash, time, view, mipMapLevel, rod);
     if (foundInCache) {
@@ -3951,6 +3971,7 @@ EffectInstance::getRegionsOfInterest_public(double time,
                                             RoIMap* ret)
 {
     NON_RECURSIVE_ACTION();
+    RenderTraceScope trace(kRenderTraceCategoryAction, "getRegionsOfInterest", this);
     assert(outputRoD.x2 >= outputRoD.x1 && outputRoD.y2 >= outputRoD.y1);
     assert(renderWindow.x2 >= renderWindow.x1 && renderWindow.y2 >= renderWindow.y1);
 
@@ -3964,6 +3985,7 @@ EffectInstance::getFramesNeeded_public(U64 hash,
                                        unsigned int mipMapLevel)
 {
     NON_RECURSIVE_ACTION();
+    RenderTraceScope trace(kRenderTraceCategoryAction, "getFramesNeeded", this);
     FramesNeededMap framesNeeded;
     bool foundInCache = _imp->actionsCache->getFramesNeededResult(hash, time, view, mipMapLevel, &framesNeeded);
     if (foundInCache) {
@@ -4011,6 +4033,7 @@ EffectInstance::getFrameRange_public(U64 hash,
         }
 
         NON_RECURSIVE_ACTION();
+        RenderTraceScope trace(kRenderTraceCategoryAction, "getFrameRange", this);
         getFrameRange(first, last);
         _imp->actionsCache->setTimeDomainResult(hash, *first, *last);
     }
@@ -4031,6 +4054,7 @@ EffectInstance::beginSequenceRender_public(double first,
 {
     NON_RECURSIVE_ACTION();
     REPORT_CURRENT_THREAD_ACTION( kOfxImageEffectActionBeginSequenceRender, getNode() );
+    RenderTraceScope trace(kRenderTraceCategoryAction, "beginSequenceRender", this);
     EffectTLSDataPtr tls = _imp->tlsData->getOrCreateTLSData();
     assert(tls);
     ++tls->beginEndRenderCount;
@@ -4054,6 +4078,7 @@ EffectInstance::endSequenceRender_public(double first,
 {
     NON_RECURSIVE_ACTION();
     REPORT_CURRENT_THREAD_ACTION( kOfxImageEffectActionEndSequenceRender, getNode() );
+    RenderTraceScope trace(kRenderTraceCategoryAction, "endSequenceRender", this);
     EffectTLSDataPtr tls = _imp->tlsData->getOrCreateTLSData();
     assert(tls);
     --tls->beginEndRenderCount;
@@ -4425,6 +4450,7 @@ EffectInstance::getComponentsNeededAndProduced_public(U64 hash,
 
 {
     RECURSIVE_ACTION();
+    RenderTraceScope trace(kRenderTraceCategoryAction, "getComponentsNeededAndProduced", this);
 
     {
         ViewIdx ptView;
@@ -5293,6 +5319,7 @@ EffectInstance::isPaintingOverItselfEnabled() const
 StatusEnum
 EffectInstance::getPreferredMetadata_public(NodeMetadata& metadata)
 {
+    RenderTraceScope trace(kRenderTraceCategoryAction, "getPreferredMetadata", this);
     StatusEnum stat = getDefaultMetadata(metadata);
 
     if (stat == eStatusFailed) {
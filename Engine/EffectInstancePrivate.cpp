@@ -31,6 +31,7 @@
 #include "Engine/AppInstance.h"
 #include "Engine/Node.h"
 #include "Engine/NodeGroup.h"
+#include "Engine/RenderTrace.h"
 #include "Engine/ViewIdx.h"
 
 
@@ -601,6 +602,7 @@ EffectInstance::Implementation::waitForImageBeingRenderedElsewhere(const RectI &
 
     bool ab = _publicInterface->aborted();
 
+    RenderTraceScope trace(kRenderTraceCategoryLock, "waitForImageBeingRenderedElsewhere", _publicInterface, roi);
     QMutexLocker kk(&ibr->lock);
     while (!ab && isBeingRenderedElseWhere && !ibr->failed && ibr->refCount > 1) {
         ibr->cond.wait(&ibr->lock, 50);
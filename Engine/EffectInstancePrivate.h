@@ -334,11 +334,20 @@ public:
         bool byPassCache;
         std::bitset<4> processChannels;
         ImagePlanesToRenderPtr planes;
+        // The TLS of the calling thread before it renders any tile, copied by the other threads
+        TLSSnapshotPtr callingThreadTLS;
     };
 
     RenderingFunctorRetEnum tiledRenderingFunctor(TiledRenderingFunctorArgs & args,  const RectToRender & specificData,
                                                   QThread* callingThread);
 
+    /// Renders rects[index] with tiledRenderingFunctor and stores the result in results[index], for TaskScheduler::parallelFor
+    void tiledRenderingTask(TiledRenderingFunctorArgs* args,
+                            const std::vector<RectToRender>* rects,
+                            QThread* callingThread,
+                            std::vector<RenderingFunctorRetEnum>* results,
+                            int index);
+
     RenderingFunctorRetEnum tiledRenderingFunctor(const RectToRender & rectToRender,
                                                   const bool renderFullScaleThenDownscale,
                                                   const bool isSequentialRender,
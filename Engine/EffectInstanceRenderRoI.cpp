@@ -38,7 +38,6 @@
 #include <QtCore/QThreadPool>
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QCoreApplication>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
 #include <QtConcurrentRun> // QtCore on Qt4, QtConcurrent on Qt5
 
 #if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
@@ -70,9 +69,11 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/PluginMemory.h"
 #include "Engine/Project.h"
 #include "Engine/RenderStats.h"
+#include "Engine/RenderTrace.h"
 #include "Engine/RotoContext.h"
 #include "Engine/RotoDrawableItem.h"
 #include "Engine/Settings.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/Timer.h"
 #include "Engine/Transform.h"
 #include "Engine/ThreadPool.h"
@@ -334,6 +335,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
 
         return eRenderRoIRetCodeOk;
     }
+    RenderTraceScope trace(kRenderTraceCategoryRender, "renderRoI", this, args.roi);
 
     // Make sure this call is not made recursively from getImage on a render clone on which we are already calling renderRoI.
     // If so, forward the call to the main instance
@@ -1563,8 +1565,10 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
         assert(renderInstance);
 
         if (safety == eRenderSafetyInstanceSafe) {
+            RenderTraceScope trace(kRenderTraceCategoryLock, "lockRenderInstances", this);
             locker.reset( new QMutexLocker( &getNode()->getRenderInstancesSharedMutex() ) );
         } else if (safety == eRenderSafetyUnsafe) {
+            RenderTraceScope trace(kRenderTraceCategoryLock, "lockPlugin", this);
             const Plugin* p = getNode()->getPlugin();
             assert(p);
             locker.reset( new QMutexLocker( p->getPluginLock() ) );
@@ -1995,14 +1999,20 @@ EffectInstance::renderRoIInternal(EffectInstance* self,
 #else
 
 
-            QFuture<RenderingFunctorRetEnum> ret = QtConcurrent::mapped( planesToRender->rectsToRender,
-                                                                         boost::bind(&EffectInstance::Implementation::tiledRenderingFunctor,
-                                                                                     self->_imp.get(),
-                                                                                     *tiledArgs,
-                                                                                     _1,
-                                                                                     currentThread) );
-            ret.waitForFinished();
-            QFuture<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
+            // The tiles are rendered by the workers of the task scheduler and by this thread, which does not block a worker while waiting.
+            // The workers copy the TLS of this thread as it is before it renders a tile, i.e without valid RenderArgs.
+            tiledArgs->callingThreadTLS = appPTR->getAppTLS()->takeSnapshot();
+            std::vector<RectToRender> rects( planesToRender->rectsToRender.begin(), planesToRender->rectsToRender.end() );
+            std::vector<EffectInstance::RenderingFunctorRetEnum> ret( rects.size(), eRenderingFunctorRetFailed );
+            appPTR->getTaskScheduler()->parallelFor( (int)rects.size(),
+                                                     boost::bind(&EffectInstance::Implementation::tiledRenderingTask,
+                                                                 self->_imp.get(),
+                                                                 tiledArgs.get(),
+                                                                 &rects,
+                                                                 currentThread,
+                                                                 &ret,
+                                                                 _1) );
+            std::vector<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
 
 #endif
             for (it2 = ret.begin(); it2 != ret.end(); ++it2) {
@@ -76,6 +76,7 @@ SOURCES += \
     BlockingBackgroundRender.cpp \
     CLArgs.cpp \
     Cache.cpp \
+    CacheTOCJournal.cpp \
     CoonsRegularization.cpp \
     CreateNodeArgs.cpp \
     Curve.cpp \
@@ -104,6 +105,7 @@ SOURCES += \
     HostOverlaySupport.cpp \
     Image.cpp \
     ImageConvert.cpp \
+    ImageConvertSIMD.cpp \
     ImageCopyChannels.cpp \
     ImageKey.cpp \
     ImageMaskMix.cpp \
@@ -112,6 +114,7 @@ SOURCES += \
     Interpolation.cpp \
     JoinViewsNode.cpp \
     Knob.cpp \
+    KnobExpression.cpp \
     KnobFactory.cpp \
     KnobFile.cpp \
     KnobSerialization.cpp \
@@ -122,6 +125,7 @@ SOURCES += \
     Markdown.cpp \
     MemoryFile.cpp \
     MemoryInfo.cpp \
+    NUMATopology.cpp \
     NoOpBase.cpp \
     Node.cpp \
     NodeDocumentation.cpp \
@@ -151,6 +155,7 @@ SOURCES += \
     OutputEffectInstance.cpp \
     OutputSchedulerThread.cpp \
     ParallelRenderArgs.cpp \
+    ParallelRenderController.cpp \
     Plugin.cpp \
     PluginMemory.cpp \
     PrecompNode.cpp \
@@ -166,10 +171,12 @@ SOURCES += \
     PyRoto.cpp \
     PySideCompat.cpp \
     PyTracker.cpp \
+    RamBufferPool.cpp \
     ReadNode.cpp \
     RectD.cpp \
     RectI.cpp \
     RenderStats.cpp \
+    RenderTrace.cpp \
     RotoContext.cpp \
     RotoDrawableItem.cpp \
     RotoItem.cpp \
@@ -185,6 +192,7 @@ SOURCES += \
     StandardPaths.cpp \
     StringAnimationManager.cpp \
     TLSHolder.cpp \
+    TaskScheduler.cpp \
     Texture.cpp \
     TextureRect.cpp \
     ThreadPool.cpp \
@@ -275,6 +283,8 @@ HEADERS += \
     CacheEntry.h \
     CacheEntryHolder.h \
     CacheSerialization.h \
+    CacheTOCJournal.h \
+    CacheTOCRecordArchive.h \
     ChoiceOption.h \
     CoonsRegularization.h \
     CreateNodeArgs.h \
@@ -310,6 +320,7 @@ HEADERS += \
     HistogramCPU.h \
     HostOverlaySupport.h \
     Image.h \
+    ImageConvertSIMD.h \
     ImageKey.h \
     ImageLocker.h \
     ImageParams.h \
@@ -320,6 +331,7 @@ HEADERS += \
     JoinViewsNode.h \
     KeyHelper.h \
     Knob.h \
+    KnobExpression.h \
     KnobFactory.h \
     KnobFile.h \
     KnobGuiI.h \
@@ -335,6 +347,7 @@ HEADERS += \
     MemoryFile.h \
     MemoryInfo.h \
     MergingEnum.h \
+    NUMATopology.h \
     NoOpBase.h \
     Node.h \
     NodeGraphI.h \
@@ -365,6 +378,7 @@ HEADERS += \
     OutputSchedulerThread.h \
     OverlaySupport.h \
     ParallelRenderArgs.h \
+    ParallelRenderController.h \
     Plugin.h \
     PluginActionShortcut.h \
     PluginMemory.h \
@@ -382,12 +396,14 @@ HEADERS += \
     PyRoto.h \
     PyTracker.h \
     Pyside_Engine_Python.h \
+    RamBufferPool.h \
     ReadNode.h \
     RectD.h \
     RectDSerialization.h \
     RectI.h \
     RectISerialization.h \
     RenderStats.h \
+    RenderTrace.h \
     RotoContext.h \
     RotoContextPrivate.h \
     RotoContextSerialization.h \
@@ -412,6 +428,7 @@ HEADERS += \
     StringAnimationManager.h \
     TLSHolder.h \
     TLSHolderImpl.h \
+    TaskScheduler.h \
     Texture.h \
     TextureRect.h \
     TextureRectSerialization.h \
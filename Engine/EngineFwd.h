@@ -170,6 +170,7 @@ class KnobButton;
 class KnobChoice;
 class KnobColor;
 class KnobDouble;
+class KnobExpression;
 class KnobFactory;
 class KnobFile;
 class KnobGroup;
@@ -249,6 +250,7 @@ class RotoStrokeItemSerialization;
 class Settings;
 class StringAnimationManager;
 class TLSHolderBase;
+class TaskScheduler;
 class Texture;
 class TextureRect;
 class TileCacheFile;
@@ -356,6 +358,7 @@ typedef boost::shared_ptr<KnobButton> KnobButtonPtr;
 typedef boost::shared_ptr<KnobChoice> KnobChoicePtr;
 typedef boost::shared_ptr<KnobColor> KnobColorPtr;
 typedef boost::shared_ptr<KnobDouble> KnobDoublePtr;
+typedef boost::shared_ptr<KnobExpression> KnobExpressionPtr;
 typedef boost::shared_ptr<KnobFactory> KnobFactoryPtr;
 typedef boost::shared_ptr<KnobFile> KnobFilePtr;
 typedef boost::shared_ptr<KnobGroup> KnobGroupPtr;
@@ -43,10 +43,8 @@ FrameEntry::pixelAt(int x,
         return 0;
     }
     std::size_t rowSize = bounds.width();
-    unsigned int srcPixelSize = 4;
-    if ( (ImageBitDepthEnum)_key.getBitDepth() == eImageBitDepthFloat ) {
-        srcPixelSize *= sizeof(float);
-    }
+    // always RGBA
+    unsigned int srcPixelSize = 4 * getSizeOfForBitDepth( (ImageBitDepthEnum)_key.getBitDepth() );
     rowSize *= srcPixelSize;
 
     return data() +  (y - bounds.y1) * rowSize + (x - bounds.x1) * srcPixelSize;
@@ -65,17 +63,11 @@ FrameEntry::copy(const FrameEntry& other)
     const TextureRect& srcBounds = other.getKey().getTexRect();
     const TextureRect& dstBounds = _key.getTexRect();
     std::size_t srcRowSize = srcBounds.width();
-    unsigned int srcPixelSize = 4;
-    if ( (ImageBitDepthEnum)other.getKey().getBitDepth() == eImageBitDepthFloat ) {
-        srcPixelSize *= sizeof(float);
-    }
+    unsigned int srcPixelSize = 4 * getSizeOfForBitDepth( (ImageBitDepthEnum)other.getKey().getBitDepth() );
     srcRowSize *= srcPixelSize;
 
     std::size_t dstRowSize = srcBounds.width();
-    unsigned int dstPixelSize = 4;
-    if ( (ImageBitDepthEnum)_key.getBitDepth() == eImageBitDepthFloat ) {
-        dstPixelSize *= sizeof(float);
-    }
+    unsigned int dstPixelSize = 4 * getSizeOfForBitDepth( (ImageBitDepthEnum)_key.getBitDepth() );
     dstRowSize *= dstPixelSize;
 
     // Fill with black and transparent because src might be smaller
@@ -24,13 +24,9 @@
 
 #include "Hash64.h"
 
-#include <algorithm>  // for std::for_each
 #include <cassert>
 #include <stdexcept>
 
-#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
-#include <boost/crc.hpp>
-#endif
 #include <QtCore/QString>
 
 #include "Engine/Node.h"
@@ -40,30 +36,94 @@ NATRON_NAMESPACE_ENTER
 void
 Hash64::computeHash()
 {
-    if ( node_values.empty() ) {
+    if (_totalCount == 0) {
         return;
     }
 
-    const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
-    boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
-    crc_64 = std::for_each( data, data + node_values.size() * sizeof(node_values[0]), crc_64 );
-    hash = crc_64();
+    // This does not modify the streaming state so more values may be appended afterwards
+    U64 h;
+    if (_totalCount >= 4) {
+        h = rotl(_lanes[0], 1) + rotl(_lanes[1], 7) + rotl(_lanes[2], 12) + rotl(_lanes[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            h ^= mixRound(0, _lanes[i]);
+            h = h * NATRON_HASH64_PRIME1 + NATRON_HASH64_PRIME4;
+        }
+    } else {
+        h = NATRON_HASH64_PRIME5;
+    }
+
+    h += _totalCount * sizeof(U64);
+
+    for (unsigned int i = 0; i < _stripeCount; ++i) {
+        h ^= mixRound(0, _stripe[i]);
+        h = rotl(h, 27) * NATRON_HASH64_PRIME1 + NATRON_HASH64_PRIME4;
+    }
+
+    // Final avalanche
+    h ^= h >> 33;
+    h *= NATRON_HASH64_PRIME2;
+    h ^= h >> 29;
+    h *= NATRON_HASH64_PRIME3;
+    h ^= h >> 32;
+
+    hash = h;
 }
 
 void
 Hash64::reset()
 {
-    node_values.clear();
+    _lanes[0] = NATRON_HASH64_PRIME1 + NATRON_HASH64_PRIME2;
+    _lanes[1] = NATRON_HASH64_PRIME2;
+    _lanes[2] = 0;
+    _lanes[3] = 0 - NATRON_HASH64_PRIME1;
+    _stripeCount = 0;
+    _totalCount = 0;
     hash = 0;
 }
 
+void
+Hash64::appendBytes(const void* data,
+                    std::size_t nBytes)
+{
+    appendU64( (U64)nBytes );
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = bytes + nBytes;
+
+    // Fill the pending stripe first, then process whole stripes directly from the input
+    while (_stripeCount != 0 && end - bytes >= 8) {
+        U64 w;
+        std::memcpy(&w, bytes, sizeof(U64));
+        appendU64(w);
+        bytes += 8;
+    }
+    if (_stripeCount == 0) {
+        U64 stripe[4];
+        while (end - bytes >= 32) {
+            std::memcpy(stripe, bytes, sizeof(stripe));
+            processStripe(stripe);
+            _totalCount += 4;
+            bytes += 32;
+        }
+    }
+    while (end - bytes >= 8) {
+        U64 w;
+        std::memcpy(&w, bytes, sizeof(U64));
+        appendU64(w);
+        bytes += 8;
+    }
+    if (bytes != end) {
+        U64 w = 0;
+        std::memcpy(&w, bytes, end - bytes);
+        appendU64(w);
+    }
+}
+
 void
 Hash64_appendQString(Hash64* hash,
                      const QString & str)
 {
-    Q_FOREACH (QChar ch, str) {
-        hash->append<unsigned short>( ch.unicode() );
-    }
+    hash->appendBytes( str.utf16(), str.size() * sizeof(ushort) );
 }
 
 NATRON_NAMESPACE_EXIT
@@ -28,6 +28,8 @@
 #include "Global/Macros.h"
 
 #include <vector>
+#include <cstddef> // size_t
+#include <cstring> // memcpy
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/static_assert.hpp>
 #endif
@@ -36,11 +38,22 @@
 
 #include "Engine/EngineFwd.h"
 
+#define NATRON_HASH64_PRIME1 11400714785074694791ULL
+#define NATRON_HASH64_PRIME2 14029467366897019727ULL
+#define NATRON_HASH64_PRIME3 1609587929392839161ULL
+#define NATRON_HASH64_PRIME4 9650029242287828579ULL
+#define NATRON_HASH64_PRIME5 2870177450012600261ULL
+
 NATRON_NAMESPACE_ENTER
 
-/*The hash of a Node is the checksum of the vector of data containing:
+/*The hash of a Node is the checksum of the stream of data containing:
     - the values of the current knob for this node + the name of the node
     - the hash values for the  tree upstream
+
+   The values are mixed as they are appended: there is no intermediate storage and no heap allocation.
+   The stream is processed in 32 bytes stripes over 4 independent 64-bit lanes (this is the xxHash64 algorithm,
+   the result is the same as XXH64 with a seed of 0 on the appended bytes on little endian machines), so that the
+   compiler can interleave or vectorize the lanes.
  */
 
 class Hash64
@@ -48,12 +61,7 @@ class Hash64
 public:
     Hash64()
     {
-        hash = 0;
-    }
-
-    ~Hash64()
-    {
-        node_values.clear();
+        reset();
     }
 
     U64 value() const
@@ -86,9 +94,26 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
     template<typename T>
     void append(T value)
     {
-        node_values.push_back( toU64(value) );
+        appendU64( toU64(value) );
     }
 
+    void appendU64(U64 value)
+    {
+        _stripe[_stripeCount++] = value;
+        ++_totalCount;
+        if (_stripeCount == 4) {
+            processStripe(_stripe);
+            _stripeCount = 0;
+        }
+    }
+
+    /**
+     * @brief Appends a block of memory, e.g the content of a string or an array of keyframes.
+     * The byte count is appended first so that consecutive blocks cannot collide with their concatenation,
+     * then the data is appended by 64-bit words, the last word being padded with zeroes.
+     **/
+    void appendBytes(const void* data, std::size_t nBytes);
+
     bool operator== (const Hash64 & h) const
     {
         return this->hash == h.value();
@@ -115,8 +140,35 @@ private:
         };
     };
 
+    static U64 rotl(U64 x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static U64 mixRound(U64 acc, U64 input)
+    {
+        acc += input * NATRON_HASH64_PRIME2;
+        acc = rotl(acc, 31);
+        acc *= NATRON_HASH64_PRIME1;
+
+        return acc;
+    }
+
+    void processStripe(const U64* stripe)
+    {
+        _lanes[0] = mixRound(_lanes[0], stripe[0]);
+        _lanes[1] = mixRound(_lanes[1], stripe[1]);
+        _lanes[2] = mixRound(_lanes[2], stripe[2]);
+        _lanes[3] = mixRound(_lanes[3], stripe[3]);
+    }
+
     U64 hash;
-    std::vector<U64> node_values;
+
+    // Streaming state
+    U64 _lanes[4];
+    U64 _stripe[4]; // pending words, not yet mixed into the lanes
+    unsigned int _stripeCount;
+    U64 _totalCount; // number of 64-bit words appended since the last reset()
 };
 
 void Hash64_appendQString(Hash64* hash, const QString & str);
@@ -32,12 +32,16 @@
 #if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 #include <boost/math/special_functions/fpclassify.hpp>
+// /usr/local/include/boost/bind/arg.hpp:37:9: warning: unused typedef 'boost_static_assert_typedef_37' [-Wunused-local-typedef]
+#include <boost/bind.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #endif
 
 #include <QtCore/QDebug>
 
 #include "Engine/AppManager.h"
+#include "Engine/ImageConvertSIMD.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/GPUContextPool.h"
 #include "Engine/OSGLContext.h"
@@ -49,6 +53,9 @@ NATRON_NAMESPACE_ENTER
 
 #define PIXEL_UNAVAILABLE 2
 
+// Mipmaps of images smaller than this number of pixels per thread are built in the calling thread
+#define NATRON_MIPMAP_MIN_PIXELS_PER_THREAD (256 * 256)
+
 template <int trimap>
 RectI
 minimalNonMarkedBbox_internal(const RectI& roi,
@@ -1807,262 +1814,333 @@ Image::getRowElements() const
     return getComponentsCount() * _bounds.width();
 }
 
-// code proofread and fixed by @devernay on 4/12/2014
-template <typename PIX, int maxValue>
+namespace {
+/// The 2x2 box filter of one pixel of a mipmap level, for the pixels on the edges of the RoI of the previous level:
+/// only the source pixels within srcX1..srcX2 and the source rows which are not NULL are averaged.
+template <typename PIX>
 void
-Image::halveRoIForDepth(const RectI & roi,
-                        bool copyBitMap,
-                        Image* output) const
+halvePixelOnEdge(const PIX* const srcRows[2],
+                 int srcX1,
+                 int srcX2,
+                 int nComps,
+                 int x,
+                 PIX* dstPix)
+{
+    const int srcx = x * 2;
+    const bool pickThisCol = srcX1 <= (srcx + 0) && (srcx + 0) < srcX2;
+    const bool pickNextCol = srcX1 <= (srcx + 1) && (srcx + 1) < srcX2;
+    const bool pickThisRow = srcRows[0] != NULL;
+    const bool pickNextRow = srcRows[1] != NULL;
+    const int sum = ( (int)pickThisCol + (int)pickNextCol ) * ( (int)pickThisRow + (int)pickNextRow );
+
+    assert(0 < sum && sum <= 4);
+    const PIX* const thisRow = pickThisRow ? srcRows[0] + (srcx - srcX1) * nComps : NULL;
+    const PIX* const nextRow = pickNextRow ? srcRows[1] + (srcx - srcX1) * nComps : NULL;
+    for (int k = 0; k < nComps; ++k) {
+        ///a b
+        ///c d
+
+        const PIX a = (pickThisCol && pickThisRow) ? thisRow[k] : 0;
+        const PIX b = (pickNextCol && pickThisRow) ? thisRow[k + nComps] : 0;
+        const PIX c = (pickThisCol && pickNextRow) ? nextRow[k] : 0;
+        const PIX d = (pickNextCol && pickNextRow) ? nextRow[k + nComps] : 0;
+        dstPix[k] = (a + b + c + d) / sum;
+    }
+}
+
+/// The 2x2 box filter of nPixels pixels whose 4 source pixels are all available
+template <typename PIX>
+void
+halveInnerRow(const PIX* thisRow,
+              const PIX* nextRow,
+              int nComps,
+              int nPixels,
+              PIX* dst)
+{
+    for (int x = 0; x < nPixels; ++x, thisRow += 2 * nComps, nextRow += 2 * nComps, dst += nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            dst[k] = (thisRow[k] + thisRow[k + nComps] + nextRow[k] + nextRow[k + nComps]) / 4;
+        }
+    }
+}
+
+template <>
+void
+halveInnerRow<float>(const float* thisRow,
+                     const float* nextRow,
+                     int nComps,
+                     int nPixels,
+                     float* dst)
 {
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) ||
-            (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) ||
-            (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    ImageConvertSIMD::halveRowsFloat(thisRow, nextRow, dst, nPixels, nComps);
+}
 
-    ///handle case where there is only 1 column/row
-    if ( (roi.width() == 1) || (roi.height() == 1) ) {
-        assert( !(roi.width() == 1 && roi.height() == 1) ); /// can't be 1x1
-        halve1DImage(roi, output);
+/**
+ * @brief Computes the rows of a mipmap level directly from the rows of the source image, without storing the
+ * intermediate levels in images: a row of level i is the 2x2 box filter of 2 rows of level i - 1, which are computed
+ * recursively in row buffers, so that only 2 rows per intermediate level are in memory at any time and the rows of
+ * the source image are read only once.
+ * The RoI of level i is the smallest enclosing RoI of the RoI of level i - 1. On its edges, a pixel is the
+ * average of the pixels of level i - 1 which are within its RoI, instead of being left uninitialized.
+ * Each level is computed with the same arithmetic as halving it on its own, e.g. integers are truncated at each level.
+ * Rows of the last level may be built concurrently as they do not depend on each other.
+ **/
+template <typename PIX>
+class MipMapRowsBuilder
+{
+    std::vector<RectI> _levelRoIs; //< the RoI of each level, starting at the source RoI
+    int _nComps;
+    const PIX* _srcPixels; //< pixel at the bottom left of srcBounds
+    const char* _srcBmPixels;
+    RectI _srcBounds;
+    PIX* _dstPixels; //< pixel at the bottom left of dstBounds
+    char* _dstBmPixels;
+    RectI _dstBounds;
+
+    /// 2 rows for each intermediate level
+    struct RowBuffers
+    {
+        std::vector<std::vector<PIX> > pixels;
+        std::vector<std::vector<char> > bitmap;
+    };
 
-        return;
+public:
+
+    /// If the bitmap pointers are NULL, the bitmap is not downscaled.
+    /// The bitmaps must have the same bounds as the images.
+    MipMapRowsBuilder(const RectI& srcRoI,
+                      unsigned int level,
+                      int nComps,
+                      const PIX* srcPixels,
+                      const char* srcBmPixels,
+                      const RectI& srcBounds,
+                      PIX* dstPixels,
+                      char* dstBmPixels,
+                      const RectI& dstBounds)
+        : _levelRoIs(level + 1)
+        , _nComps(nComps)
+        , _srcPixels(srcPixels)
+        , _srcBmPixels(srcBmPixels)
+        , _srcBounds(srcBounds)
+        , _dstPixels(dstPixels)
+        , _dstBmPixels(dstBmPixels)
+        , _dstBounds(dstBounds)
+    {
+        assert(level > 0);
+        assert( (srcBmPixels == NULL) == (dstBmPixels == NULL) );
+        _levelRoIs[0] = srcRoI;
+        for (unsigned int i = 1; i <= level; ++i) {
+            _levelRoIs[i] = _levelRoIs[i - 1].downscalePowerOfTwoSmallestEnclosing(1);
+        }
+        assert( dstBounds.contains(_levelRoIs[level]) );
+    }
+
+    const RectI& getLastLevelRoI() const
+    {
+        return _levelRoIs.back();
+    }
+
+    /**
+     * @brief Builds the rows from rows.y1 to rows.y2 of the last level into the destination image.
+     * Only the y coordinates of rows are used.
+     **/
+    void buildRows(const RectI& rows) const
+    {
+        const unsigned int level = _levelRoIs.size() - 1;
+        RowBuffers buffers;
+
+        buffers.pixels.resize(2 * level);
+        buffers.bitmap.resize(2 * level);
+        for (unsigned int i = 1; i < level; ++i) {
+            for (int slot = 0; slot < 2; ++slot) {
+                buffers.pixels[2 * i + slot].resize(_levelRoIs[i].width() * _nComps);
+                if (_srcBmPixels) {
+                    buffers.bitmap[2 * i + slot].resize( _levelRoIs[i].width() );
+                }
+            }
+        }
+
+        const RectI& roi = _levelRoIs[level];
+        const int dstRowSize = _dstBounds.width();
+        for (int y = rows.y1; y < rows.y2; ++y) {
+            const std::size_t dstOffset = (std::size_t)(y - _dstBounds.y1) * dstRowSize + (roi.x1 - _dstBounds.x1);
+            buildRow(level, y, buffers, _dstPixels + dstOffset * _nComps, _dstBmPixels ? _dstBmPixels + dstOffset : NULL);
+        }
     }
 
-    /// Take the lock for both bitmaps since we're about to read/write from them!
-    QWriteLocker k1(&output->_entryLock);
-    QReadLocker k2(&_entryLock);
+    /// Builds the rows of (*bands)[index], for TaskScheduler::parallelFor
+    void buildBand(const std::vector<RectI>* bands,
+                   int index) const
+    {
+        buildRows( (*bands)[index] );
+    }
 
-    ///The source rectangle, intersected to this image region of definition in pixels
-    const RectI &srcBounds = _bounds;
-    const RectI &dstBounds = output->_bounds;
-    const RectI &srcBmBounds = _bitmap.getBounds();
-    const RectI &dstBmBounds = output->_bitmap.getBounds();
-    assert( !copyBitMap || usesBitMap() );
-    assert( !usesBitMap() || (srcBmBounds == srcBounds && dstBmBounds == dstBounds) );
-
-    // the srcRoD of the output should be enclosed in half the roi.
-    // It does not have to be exactly half of the input.
-    //    assert(dstRoD.x1*2 >= roi.x1 &&
-    //           dstRoD.x2*2 <= roi.x2 &&
-    //           dstRoD.y1*2 >= roi.y1 &&
-    //           dstRoD.y2*2 <= roi.y2 &&
-    //           dstRoD.width()*2 <= roi.width() &&
-    //           dstRoD.height()*2 <= roi.height());
-    assert( getComponents() == output->getComponents() );
-
-    RectI dstRoI;
-    RectI srcRoI = roi;
-    srcRoI.intersect(srcBounds, &srcRoI); // intersect srcRoI with the region of definition
-
-    dstRoI.x1 = (srcRoI.x1 + 1) / 2; // equivalent to ceil(srcRoI.x1/2.0)
-    dstRoI.y1 = (srcRoI.y1 + 1) / 2; // equivalent to ceil(srcRoI.y1/2.0)
-    dstRoI.x2 = srcRoI.x2 / 2; // equivalent to floor(srcRoI.x2/2.0)
-    dstRoI.y2 = srcRoI.y2 / 2; // equivalent to floor(srcRoI.y2/2.0)
-
-
-    const PIX* const srcPixels      = (const PIX*)pixelAt(srcBounds.x1,   srcBounds.y1);
-    const char* const srcBmPixels   = _bitmap.getBitmapAt(srcBmBounds.x1, srcBmBounds.y1);
-    PIX* const dstPixels          = (PIX*)output->pixelAt(dstBounds.x1,   dstBounds.y1);
-    char* const dstBmPixels = output->_bitmap.getBitmapAt(dstBmBounds.x1, dstBmBounds.y1);
-    int srcRowSize = srcBounds.width() * _nbComponents;
-    int dstRowSize = dstBounds.width() * _nbComponents;
-
-    // offset pointers so that srcData and dstData correspond to pixel (0,0)
-    const PIX* const srcData = srcPixels - (srcBounds.x1 * _nbComponents + srcRowSize * srcBounds.y1);
-    PIX* const dstData       = dstPixels - (dstBounds.x1 * _nbComponents + dstRowSize * dstBounds.y1);
-    const int srcBmRowSize = srcBmBounds.width();
-    const int dstBmRowSize = dstBmBounds.width();
-    const char* const srcBmData = srcBmPixels - (srcBmBounds.x1 + srcBmRowSize * srcBmBounds.y1);
-    char* const dstBmData       = dstBmPixels - (dstBmBounds.x1 + dstBmRowSize * dstBmBounds.y1);
-
-    for (int y = dstRoI.y1; y < dstRoI.y2; ++y) {
-        const PIX* const srcLineStart    = srcData + y * 2 * srcRowSize;
-        PIX* const dstLineStart          = dstData + y     * dstRowSize;
-        const char* const srcBmLineStart = srcBmData + y * 2 * srcBmRowSize;
-        char* const dstBmLineStart       = dstBmData + y     * dstBmRowSize;
-
-        // The current dst row, at y, covers the src rows y*2 (thisRow) and y*2+1 (nextRow).
-        // Check that if are within srcBounds.
-        int srcy = y * 2;
-        bool pickThisRow = srcBounds.y1 <= (srcy + 0) && (srcy + 0) < srcBounds.y2;
-        bool pickNextRow = srcBounds.y1 <= (srcy + 1) && (srcy + 1) < srcBounds.y2;
-        int sumH = (int)pickNextRow + (int)pickThisRow;
-        assert(sumH == 1 || sumH == 2);
-
-        for (int x = dstRoI.x1; x < dstRoI.x2; ++x) {
-            const PIX* const srcPixStart    = srcLineStart   + x * 2 * _nbComponents;
-            const char* const srcBmPixStart = srcBmLineStart + x * 2;
-            PIX* const dstPixStart          = dstLineStart   + x * _nbComponents;
-            char* const dstBmPixStart       = dstBmLineStart + x;
-
-            // The current dst col, at y, covers the src cols x*2 (thisCol) and x*2+1 (nextCol).
-            // Check that if are within srcBounds.
-            int srcx = x * 2;
-            bool pickThisCol = srcBounds.x1 <= (srcx + 0) && (srcx + 0) < srcBounds.x2;
-            bool pickNextCol = srcBounds.x1 <= (srcx + 1) && (srcx + 1) < srcBounds.x2;
-            int sumW = (int)pickThisCol + (int)pickNextCol;
-            assert(sumW == 1 || sumW == 2);
-            const int sum = sumW * sumH;
-            assert(0 < sum && sum <= 4);
-
-            if (sum == 0) { // never happens
-                for (int k = 0; k < _nbComponents; ++k) {
-                    dstPixStart[k] = 0;
-                }
-                if (copyBitMap) {
-                    dstBmPixStart[0] = 0;
-                }
+private:
+
+    void buildRow(unsigned int level,
+                  int y,
+                  RowBuffers& buffers,
+                  PIX* dst,
+                  char* dstBm) const
+    {
+        const RectI& srcRoI = _levelRoIs[level - 1];
+        const RectI& roi = _levelRoIs[level];
+        const PIX* srcRows[2] = {NULL, NULL};
+        const char* srcBmRows[2] = {NULL, NULL};
+
+        for (int i = 0; i < 2; ++i) {
+            const int srcy = y * 2 + i;
+            if ( (srcy < srcRoI.y1) || (srcRoI.y2 <= srcy) ) {
                 continue;
             }
+            if (level == 1) {
+                // Read directly from the source image
+                const std::size_t srcOffset = (std::size_t)(srcy - _srcBounds.y1) * _srcBounds.width() + (srcRoI.x1 - _srcBounds.x1);
+                srcRows[i] = _srcPixels + srcOffset * _nComps;
+                srcBmRows[i] = _srcBmPixels ? _srcBmPixels + srcOffset : NULL;
+            } else {
+                // The rows of a slot at a lower level are overwritten by the next call, but this row is already computed
+                PIX* row = &buffers.pixels[2 * (level - 1) + i][0];
+                char* bmRow = dstBm ? &buffers.bitmap[2 * (level - 1) + i][0] : NULL;
+                buildRow(level - 1, srcy, buffers, row, bmRow);
+                srcRows[i] = row;
+                srcBmRows[i] = bmRow;
+            }
+        }
+        assert(srcRows[0] || srcRows[1]);
 
-            for (int k = 0; k < _nbComponents; ++k) {
-                ///a b
-                ///c d
-
-                const PIX a = (pickThisCol && pickThisRow) ? *(srcPixStart + k) : 0;
-                const PIX b = (pickNextCol && pickThisRow) ? *(srcPixStart + k + _nbComponents) : 0;
-                const PIX c = (pickThisCol && pickNextRow) ? *(srcPixStart + k + srcRowSize) : 0;
-                const PIX d = (pickNextCol && pickNextRow) ? *(srcPixStart + k + srcRowSize  + _nbComponents)  : 0;
+        halveRow(srcRows, srcRoI.x1, srcRoI.x2, roi.x1, roi.x2, dst);
+        if (dstBm) {
+            halveBitmapRow(srcBmRows, srcRoI.x1, srcRoI.x2, roi.x1, roi.x2, dstBm);
+        }
+    }
 
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
-                dstPixStart[k] = (a + b + c + d) / sum;
+    void halveRow(const PIX* const srcRows[2],
+                  int srcX1,
+                  int srcX2,
+                  int x1,
+                  int x2,
+                  PIX* dst) const
+    {
+        if (!srcRows[0] || !srcRows[1]) {
+            // Single row on the edge of the RoI
+            for (int x = x1; x < x2; ++x) {
+                halvePixelOnEdge(srcRows, srcX1, srcX2, _nComps, x, dst + (x - x1) * _nComps);
             }
 
-            if (copyBitMap) {
-                ///a b
-                ///c d
+            return;
+        }
 
-                char a = (pickThisCol && pickThisRow) ? *(srcBmPixStart) : 0;
-                char b = (pickNextCol && pickThisRow) ? *(srcBmPixStart + 1) : 0;
-                char c = (pickThisCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize) : 0;
-                char d = (pickNextCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize  + 1)  : 0;
-#if NATRON_ENABLE_TRIMAP
-                /*
-                   The only correct solution is to convert pixels being rendered to 0 otherwise the caller
-                   would have to wait for the original fullscale image render to be finished and then re-downscale again.
-                 */
-                if (a == PIXEL_UNAVAILABLE) {
-                    a = 0;
-                }
-                if (b == PIXEL_UNAVAILABLE) {
-                    b = 0;
-                }
-                if (c == PIXEL_UNAVAILABLE) {
-                    c = 0;
-                }
-                if (d == PIXEL_UNAVAILABLE) {
-                    d = 0;
+        // The pixels whose 2 source columns are within srcX1..srcX2 (>> rounds towards minus infinity)
+        const int innerX1 = std::max(x1, (srcX1 + 1) >> 1);
+        const int innerX2 = std::max(innerX1, std::min(x2, srcX2 >> 1) );
+        for (int x = x1; x < innerX1; ++x) {
+            halvePixelOnEdge(srcRows, srcX1, srcX2, _nComps, x, dst + (x - x1) * _nComps);
+        }
+        if (innerX1 < innerX2) {
+            const int srcOffset = (innerX1 * 2 - srcX1) * _nComps;
+            halveInnerRow(srcRows[0] + srcOffset, srcRows[1] + srcOffset, _nComps, innerX2 - innerX1, dst + (innerX1 - x1) * _nComps);
+        }
+        for (int x = innerX2; x < x2; ++x) {
+            halvePixelOnEdge(srcRows, srcX1, srcX2, _nComps, x, dst + (x - x1) * _nComps);
+        }
+    }
+
+    void halveBitmapRow(const char* const srcRows[2],
+                        int srcX1,
+                        int srcX2,
+                        int x1,
+                        int x2,
+                        char* dst) const
+    {
+        for (int x = x1; x < x2; ++x) {
+            const int srcx = x * 2;
+            int sum = 0;
+            int total = 0;
+            for (int i = 0; i < 2; ++i) {
+                if (!srcRows[i]) {
+                    continue;
                 }
+                for (int j = 0; j < 2; ++j) {
+                    if ( (srcx + j < srcX1) || (srcX2 <= srcx + j) ) {
+                        continue;
+                    }
+                    char v = srcRows[i][srcx + j - srcX1];
+#if NATRON_ENABLE_TRIMAP
+                    /*
+                       The only correct solution is to convert pixels being rendered to 0 otherwise the caller
+                       would have to wait for the original fullscale image render to be finished and then re-downscale again.
+                     */
+                    if (v == PIXEL_UNAVAILABLE) {
+                        v = 0;
+                    }
 #endif
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
-                assert(a + b + c + d <= sum); // bitmaps are 0 or 1
-                // the following is an integer division, the result can be 0 or 1
-                dstBmPixStart[0] = (a + b + c + d) / sum;
-                assert(dstBmPixStart[0] == 0 || dstBmPixStart[0] == 1);
+                    sum += v;
+                    ++total;
+                }
             }
+            assert(0 < total && sum <= total); // bitmaps are 0 or 1
+            // the following is an integer division, the result can be 0 or 1
+            dst[x - x1] = sum / total;
         }
     }
-} // halveRoIForDepth
+};
+} // anon namespace
 
-// code proofread and fixed by @devernay on 8/8/2014
+template <typename PIX>
 void
-Image::halveRoI(const RectI & roi,
-                bool copyBitMap,
-                Image* output) const
+Image::buildMipMapLevelForDepth(const RectI & roi,
+                                unsigned int level,
+                                bool copyBitMap,
+                                Image* output) const
 {
-    switch ( getBitDepth() ) {
-    case eImageBitDepthByte:
-        halveRoIForDepth<unsigned char, 255>(roi, copyBitMap,  output);
-        break;
-    case eImageBitDepthShort:
-        halveRoIForDepth<unsigned short, 65535>(roi, copyBitMap, output);
-        break;
-    case eImageBitDepthHalf:
-        assert(false);
-        break;
-    case eImageBitDepthFloat:
-        halveRoIForDepth<float, 1>(roi, copyBitMap, output);
-        break;
-    case eImageBitDepthNone:
-        break;
-    }
-}
-
-// code proofread and fixed by @devernay on 8/8/2014
-template <typename PIX, int maxValue>
-void
-Image::halve1DImageForDepth(const RectI & roi,
-                            Image* output) const
-{
-    int width = roi.width();
-    int height = roi.height();
-
-    assert(width == 1 || height == 1); /// must be 1D
-    assert( output->getComponents() == getComponents() );
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) ||
+            (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) ||
+            (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( output->getBitDepth() == getBitDepth() );
 
     /// Take the lock for both bitmaps since we're about to read/write from them!
     QWriteLocker k1(&output->_entryLock);
     QReadLocker k2(&_entryLock);
-    const RectI & srcBounds = _bounds;
-    const RectI & dstBounds = output->_bounds;
-//    assert(dstBounds.x1 * 2 == roi.x1 &&
-//           dstBounds.y1 * 2 == roi.y1 &&
-//           (
-//               dstBounds.x2 * 2 == roi.x2 || // we halve in only 1 dimension
-//               dstBounds.y2 * 2 == roi.y2)
-//           );
-    int halfWidth = width / 2;
-    int halfHeight = height / 2;
-    if (height == 1) { //1 row
-        assert(width != 1); /// widthxheight can't be 1x1
-
-        const PIX* src = (const PIX*)pixelAt(roi.x1, roi.y1);
-        PIX* dst = (PIX*)output->pixelAt(dstBounds.x1, dstBounds.y1);
-        assert(src && dst);
-        for (int x = 0; x < halfWidth; ++x) {
-            for (int k = 0; k < _nbComponents; ++k) {
-                *dst++ = PIX( (float)( *src + *(src + _nbComponents) ) / 2. );
-                ++src;
-            }
-            src += _nbComponents;
-        }
-    } else if (width == 1) {
-        int rowSize = srcBounds.width() * _nbComponents;
-        const PIX* src = (const PIX*)pixelAt(roi.x1, roi.y1);
-        PIX* dst = (PIX*)output->pixelAt(dstBounds.x1, dstBounds.y1);
-        assert(src && dst);
-        for (int y = 0; y < halfHeight; ++y) {
-            for (int k = 0; k < _nbComponents; ++k) {
-                *dst++ = PIX( (float)( *src + (*src + rowSize) ) / 2. );
-                ++src;
-            }
-            src += rowSize;
-        }
+
+    RectI srcRoI;
+    if ( !roi.intersect(_bounds, &srcRoI) ) {
+        return;
     }
-}
 
-// code proofread and fixed by @devernay on 8/8/2014
-void
-Image::halve1DImage(const RectI & roi,
-                    Image* output) const
-{
-    switch ( getBitDepth() ) {
-    case eImageBitDepthByte:
-        halve1DImageForDepth<unsigned char, 255>(roi, output);
-        break;
-    case eImageBitDepthShort:
-        halve1DImageForDepth<unsigned short, 65535>(roi, output);
-        break;
-    case eImageBitDepthHalf:
-        assert(false);
-        break;
-    case eImageBitDepthFloat:
-        halve1DImageForDepth<float, 1>(roi, output);
-        break;
-    case eImageBitDepthNone:
-        break;
+    const RectI &srcBounds = _bounds;
+    const RectI &dstBounds = output->_bounds;
+    assert( !copyBitMap || usesBitMap() );
+    assert( !copyBitMap || (_bitmap.getBounds() == srcBounds && output->_bitmap.getBounds() == dstBounds) );
+
+    MipMapRowsBuilder<PIX> builder( srcRoI, level, _nbComponents,
+                                    (const PIX*)pixelAt(srcBounds.x1, srcBounds.y1),
+                                    copyBitMap ? _bitmap.getBitmapAt(srcBounds.x1, srcBounds.y1) : NULL,
+                                    srcBounds,
+                                    (PIX*)output->pixelAt(dstBounds.x1, dstBounds.y1),
+                                    copyBitMap ? output->_bitmap.getBitmapAt(dstBounds.x1, dstBounds.y1) : NULL,
+                                    dstBounds );
+    const RectI& lastLevelRoI = builder.getLastLevelRoI();
+
+    // Split the rows of the last level in bands run by the task scheduler, unless the image is too small to be worth it.
+    // This is called from the tiles of the renders: when all the workers are busy rendering, no band is stolen and
+    // this thread builds them all, so the machine is never oversubscribed.
+    int nBands = std::min( (int)( (qint64)srcRoI.area() / NATRON_MIPMAP_MIN_PIXELS_PER_THREAD ), appPTR->getMaxThreadCount() );
+    nBands = std::min( nBands, lastLevelRoI.height() );
+    if (nBands <= 1) {
+        builder.buildRows(lastLevelRoI);
+
+        return;
     }
-}
+
+    std::vector<RectI> bands(nBands);
+    for (int i = 0; i < nBands; ++i) {
+        bands[i] = lastLevelRoI;
+        bands[i].y1 = lastLevelRoI.y1 + (int)( (qint64)lastLevelRoI.height() * i / nBands );
+        bands[i].y2 = lastLevelRoI.y1 + (int)( (qint64)lastLevelRoI.height() * (i + 1) / nBands );
+    }
+    appPTR->getTaskScheduler()->parallelFor( nBands, boost::bind(&MipMapRowsBuilder<PIX>::buildBand, &builder, &bands, _1) );
+} // buildMipMapLevelForDepth
 
 // code proofread and fixed by @devernay on 8/8/2014
 void
@@ -2090,9 +2168,6 @@ Image::downscaleMipMap(const RectD& dstRod,
     assert( !copyBitMap || _bitmap.getBitmap() );
 
     RectI dstRoI  = roi.downscalePowerOfTwoSmallestEnclosing(downscaleLvls);
-    ImagePtr tmpImg = boost::make_shared<Image>( getComponents(), dstRod, dstRoI, toLevel, par, getBitDepth(), getPremultiplication(), getFieldingOrder(), true);
-
-    buildMipMapLevel( dstRod, roi, downscaleLvls, copyBitMap, tmpImg.get() );
 
     // check that the downscaled mipmap is inside the output image (it may not be equal to it)
     assert(dstRoI.x1 >= output->_bounds.x1);
@@ -2100,6 +2175,17 @@ Image::downscaleMipMap(const RectD& dstRod,
     assert(dstRoI.y1 >= output->_bounds.y1);
     assert(dstRoI.y2 <= output->_bounds.y2);
 
+    if ( (output->getStorageMode() != eStorageModeGLTex) && ( output->getBitDepth() == getBitDepth() ) ) {
+        ///The mipmap is built directly in the output image
+        buildMipMapLevel(dstRod, roi, downscaleLvls, copyBitMap, output);
+
+        return;
+    }
+
+    ImagePtr tmpImg = boost::make_shared<Image>( getComponents(), dstRod, dstRoI, toLevel, par, getBitDepth(), getPremultiplication(), getFieldingOrder(), true);
+
+    buildMipMapLevel( dstRod, roi, downscaleLvls, copyBitMap, tmpImg.get() );
+
     ///Now copy the result of tmpImg into the output image
     output->pasteFrom(*tmpImg, dstRoI, copyBitMap);
 }
@@ -2265,42 +2351,24 @@ Image::buildMipMapLevel(const RectD& dstRoD,
         return;
     }
 
-    const Image* srcImg = this;
-    Image* dstImg = NULL;
-    bool mustFreeSrc = false;
-    RectI previousRoI = roi;
-    ///Build all the mipmap levels until we reach the one we are interested in
-    for (unsigned int i = 1; i <= level; ++i) {
-        ///Halve the smallest enclosing po2 rect as we need to render a minimum of the renderWindow
-        RectI halvedRoI = previousRoI.downscalePowerOfTwoSmallestEnclosing(1);
-
-        ///Allocate an image with half the size of the source image
-        dstImg = new Image( getComponents(), dstRoD, halvedRoI, getMipMapLevel() + i, getPixelAspectRatio(), getBitDepth(), getPremultiplication(), getFieldingOrder(), true);
-
-        ///Half the source image into dstImg.
-        ///We pass the closestPo2 roi which might not be the entire size of the source image
-        ///If the source image'sroi was originally a po2.
-        srcImg->halveRoI(previousRoI, copyBitMap, dstImg);
-
-        ///Clean-up, we should use shared_ptrs for safety
-        if (mustFreeSrc) {
-            delete srcImg;
-        }
-
-        ///Switch for next pass
-        previousRoI = halvedRoI;
-        srcImg = dstImg;
-        mustFreeSrc = true;
-    }
-
-    assert(srcImg->getBounds() == lastLevelRoI);
+    Q_UNUSED(dstRoD);
 
-    ///Finally copy the last mipmap level into output.
-    output->pasteFrom( *srcImg, srcImg->getBounds(), copyBitMap);
-
-    ///Clean-up, we should use shared_ptrs for safety
-    if (mustFreeSrc) {
-        delete srcImg;
+    ///Build all the mipmap levels until we reach the one we are interested in, in a single pass over the rows of this image
+    switch ( getBitDepth() ) {
+    case eImageBitDepthByte:
+        buildMipMapLevelForDepth<unsigned char>(roi, level, copyBitMap, output);
+        break;
+    case eImageBitDepthShort:
+        buildMipMapLevelForDepth<unsigned short>(roi, level, copyBitMap, output);
+        break;
+    case eImageBitDepthHalf:
+        assert(false);
+        break;
+    case eImageBitDepthFloat:
+        buildMipMapLevelForDepth<float>(roi, level, copyBitMap, output);
+        break;
+    case eImageBitDepthNone:
+        break;
     }
 } // buildMipMapLevel
 
@@ -26,7 +26,9 @@
 
 #include <algorithm> // min, max
 #include <cassert>
+#include <cstring> // memcpy
 #include <stdexcept>
+#include <vector>
 
 #ifndef Q_MOC_RUN
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
@@ -37,6 +39,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include <QtCore/QDebug>
 
 #include "Engine/AppManager.h"
+#include "Engine/ImageConvertSIMD.h"
 #include "Engine/Lut.h"
 
 NATRON_NAMESPACE_ENTER
@@ -132,6 +135,294 @@ lutFromColorspace(ViewerColorSpaceEnum cs)
     return lut;
 }
 
+///Row conversion functions used when the SIMD kernels are available, @see ImageConvertSIMD.
+///They give exactly the same results as the per-pixel code of the convertToFormatInternal functions, including
+///the error diffusion and the calls to rand().
+namespace {
+///Converts n values with Image::convertPixelDepth
+template <typename SRCPIX, typename DSTPIX>
+void
+convertRowDepth(const SRCPIX* from,
+                DSTPIX* to,
+                int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = Image::convertPixelDepth<SRCPIX, DSTPIX>(from[i]);
+    }
+}
+
+template <>
+void
+convertRowDepth(const unsigned char* from,
+                unsigned char* to,
+                int n)
+{
+    std::memcpy( to, from, n * sizeof(unsigned char) );
+}
+
+template <>
+void
+convertRowDepth(const unsigned short* from,
+                unsigned short* to,
+                int n)
+{
+    std::memcpy( to, from, n * sizeof(unsigned short) );
+}
+
+template <>
+void
+convertRowDepth(const float* from,
+                float* to,
+                int n)
+{
+    std::memcpy( to, from, n * sizeof(float) );
+}
+
+template <>
+void
+convertRowDepth(const unsigned char* from,
+                float* to,
+                int n)
+{
+    ImageConvertSIMD::byteToFloat(from, to, n);
+}
+
+template <>
+void
+convertRowDepth(const unsigned short* from,
+                float* to,
+                int n)
+{
+    ImageConvertSIMD::shortToFloat(from, to, n);
+}
+
+template <>
+void
+convertRowDepth(const float* from,
+                unsigned char* to,
+                int n)
+{
+    ImageConvertSIMD::floatToByte(from, to, n);
+}
+
+template <>
+void
+convertRowDepth(const float* from,
+                unsigned short* to,
+                int n)
+{
+    ImageConvertSIMD::floatToShort(from, to, n);
+}
+
+///Returns the n values converted to float with Image::convertPixelDepth, in buffer unless they are already floats
+const float*
+rowToFloat(const unsigned char* from,
+           float* buffer,
+           int n)
+{
+    ImageConvertSIMD::byteToFloat(from, buffer, n);
+
+    return buffer;
+}
+
+const float*
+rowToFloat(const unsigned short* from,
+           float* buffer,
+           int n)
+{
+    ImageConvertSIMD::shortToFloat(from, buffer, n);
+
+    return buffer;
+}
+
+const float*
+rowToFloat(const float* from,
+           float* /*buffer*/,
+           int /*n*/)
+{
+    return from;
+}
+
+///Converts a row to linear floats, using the fast functions of the lut if any. The alpha channel, if any, is undefined.
+///The result is in buffer unless the row is already linear floats.
+const float*
+decodeRowToLinear(const Color::Lut* lut,
+                  const unsigned char* from,
+                  float* buffer,
+                  int nPixels,
+                  int nComps)
+{
+    if (!lut) {
+        return rowToFloat(from, buffer, nPixels * nComps);
+    }
+    lut->fromColorSpaceUint8ToLinearFloatFast(from, buffer, nPixels * nComps);
+
+    return buffer;
+}
+
+const float*
+decodeRowToLinear(const Color::Lut* lut,
+                  const unsigned short* from,
+                  float* buffer,
+                  int nPixels,
+                  int nComps)
+{
+    if (!lut) {
+        return rowToFloat(from, buffer, nPixels * nComps);
+    }
+    lut->fromColorSpaceUint16ToLinearFloatFast(from, buffer, nPixels * nComps);
+
+    return buffer;
+}
+
+const float*
+decodeRowToLinear(const Color::Lut* lut,
+                  const float* from,
+                  float* buffer,
+                  int nPixels,
+                  int nComps)
+{
+    if (!lut) {
+        return from;
+    }
+    lut->fromColorSpaceFloatToLinearFloatFast(from, buffer, nPixels * nComps);
+
+    return buffer;
+}
+
+///Error diffusion of a row of 0-0xff00 values to bytes, in both directions from start, for the color channels
+void
+ditherRow(const unsigned short* from,
+          unsigned char* to,
+          int nPixels,
+          int nComps,
+          int start)
+{
+    const int nColorComps = std::min(nComps, 3);
+
+    for (int backward = 0; backward < 2; ++backward) {
+        unsigned error[3] = {
+            0x80, 0x80, 0x80
+        };
+        const int end = backward ? -1 : nPixels;
+        const int step = backward ? -1 : 1;
+        for (int x = backward ? start - 1 : start; x != end; x += step) {
+            for (int k = 0; k < nColorComps; ++k) {
+                error[k] = (error[k] & 0xff) + from[x * nComps + k];
+                to[x * nComps + k] = (unsigned char)(error[k] >> 8);
+            }
+        }
+    }
+}
+
+///Converts a row of linear floats to the destination color-space and depth. Only the color channels are written:
+///the alpha channel, if any, must be written by the caller. uint8xxBuffer is only used for bytes, start is the start
+///of the error diffusion.
+void
+encodeRowFromLinear(const Color::Lut* lut,
+                    const float* from,
+                    unsigned char* to,
+                    int nPixels,
+                    int nComps,
+                    int start,
+                    unsigned short* uint8xxBuffer)
+{
+    if (lut) {
+        lut->toColorSpaceUint8xxFromLinearFloatFast(from, uint8xxBuffer, nPixels * nComps);
+    } else {
+        ImageConvertSIMD::floatToUint8xx(from, uint8xxBuffer, nPixels * nComps);
+    }
+    ditherRow(uint8xxBuffer, to, nPixels, nComps, start);
+}
+
+void
+encodeRowFromLinear(const Color::Lut* lut,
+                    const float* from,
+                    unsigned short* to,
+                    int nPixels,
+                    int nComps,
+                    int /*start*/,
+                    unsigned short* /*uint8xxBuffer*/)
+{
+    if (!lut) {
+        ImageConvertSIMD::floatToShort(from, to, nPixels * nComps);
+
+        return;
+    }
+    // The alpha channel is converted too, but it is overwritten by the caller
+    lut->toColorSpaceUint16FromLinearFloatFast(from, to, nPixels * nComps);
+}
+
+void
+encodeRowFromLinear(const Color::Lut* lut,
+                    const float* from,
+                    float* to,
+                    int nPixels,
+                    int nComps,
+                    int /*start*/,
+                    unsigned short* /*uint8xxBuffer*/)
+{
+    if (!lut) {
+        std::memcpy( to, from, nPixels * nComps * sizeof(float) );
+
+        return;
+    }
+    // The alpha channel is converted too, but it is overwritten by the caller
+    lut->toColorSpaceFloatFromLinearFloatFast(from, to, nPixels * nComps);
+}
+
+///Converts the alpha channel of nPixels RGBA pixels with Image::convertPixelDepth
+template <typename SRCPIX, typename DSTPIX>
+void
+convertRowAlphaDepth(const SRCPIX* from,
+                     DSTPIX* to,
+                     int nPixels)
+{
+    for (int i = 0; i < nPixels; ++i) {
+        to[4 * i + 3] = Image::convertPixelDepth<SRCPIX, DSTPIX>(from[4 * i + 3]);
+    }
+}
+
+template <typename PIX>
+void
+fillRowAlpha(PIX* to,
+             int nPixels,
+             PIX alpha)
+{
+    for (int i = 0; i < nPixels; ++i) {
+        to[4 * i + 3] = alpha;
+    }
+}
+
+template <typename PIX>
+void
+dropRowAlpha(const PIX* from,
+             PIX* to,
+             int nPixels)
+{
+    for (int i = 0; i < nPixels; ++i, from += 4, to += 3) {
+        to[0] = from[0];
+        to[1] = from[1];
+        to[2] = from[2];
+    }
+}
+
+template <typename PIX>
+void
+addRowAlpha(const PIX* from,
+            PIX* to,
+            int nPixels,
+            PIX alpha)
+{
+    for (int i = 0; i < nPixels; ++i, from += 3, to += 4) {
+        to[0] = from[0];
+        to[1] = from[1];
+        to[2] = from[2];
+        to[3] = alpha;
+    }
+}
+} // anon namespace
+
 ///Fast version when components are the same
 template <typename SRCPIX, typename DSTPIX, int srcMaxValue, int dstMaxValue>
 void
@@ -162,6 +453,38 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
     if ( intersection.isNull() ) {
         return;
     }
+
+    if (ImageConvertSIMD::getInstructionSet() != ImageConvertSIMD::eInstructionSetScalar) {
+        ///Convert whole rows with the SIMD kernels, the result is the same as the per-pixel code below
+        const int width = intersection.width();
+        const int n = width * nComp;
+        const bool useLuts = srcLut || dstLut;
+        std::vector<float> linearRow(useLuts ? n : 0);
+        std::vector<unsigned short> uint8xxRow( (useLuts && dstDepth == eImageBitDepthByte) ? n : 0 );
+        for (int y = 0; y < intersection.height(); ++y) {
+            ///Start of the line for error diffusion, rand() is called as many times as in the per-pixel code
+            // coverity[dont_call]
+            int start = rand() % width;
+            const SRCPIX* srcPixels = (const SRCPIX*)srcImg.pixelAt(intersection.x1, intersection.y1 + y);
+            DSTPIX* dstPixels = (DSTPIX*)dstImg.pixelAt(intersection.x1, intersection.y1 + y);
+            if (!useLuts) {
+                convertRowDepth<SRCPIX, DSTPIX>(srcPixels, dstPixels, n);
+            } else {
+                const float* linear = decodeRowToLinear(srcLut, srcPixels, &linearRow[0], width, nComp);
+                encodeRowFromLinear(dstLut, linear, dstPixels, width, nComp, start, uint8xxRow.empty() ? 0 : &uint8xxRow[0]);
+                if (nComp == 4) {
+                    ///The alpha channel is not color-space converted
+                    convertRowAlphaDepth<SRCPIX, DSTPIX>(srcPixels, dstPixels, width);
+                }
+            }
+            if (copyBitmap) {
+                dstImg.copyBitmapRowPortion(intersection.x1, intersection.x2, intersection.y1 + y, srcImg);
+            }
+        }
+
+        return;
+    }
+
     for (int y = 0; y < intersection.height(); ++y) {
         // coverity[dont_call]
         int start = rand() % intersection.width();
@@ -194,7 +517,7 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
                             } else if (srcDepth == eImageBitDepthShort) {
                                 pixFloat = srcLut->fromColorSpaceUint16ToLinearFloatFast(srcPixels[k]);
                             } else {
-                                pixFloat = srcLut->fromColorSpaceFloatToLinearFloat(srcPixels[k]);
+                                pixFloat = srcLut->fromColorSpaceFloatToLinearFloatFast(srcPixels[k]);
                             }
                         } else {
                             pixFloat = convertPixelDepth<SRCPIX, float>(srcPixels[k]);
@@ -210,7 +533,7 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
                                   convertPixelDepth<float, DSTPIX>(pixFloat);
                         } else {
                             if (dstLut) {
-                                pixFloat = dstLut->toColorSpaceFloatFromLinearFloat(pixFloat);
+                                pixFloat = dstLut->toColorSpaceFloatFromLinearFloatFast(pixFloat);
                             }
                             pix = convertPixelDepth<float, DSTPIX>(pixFloat);
                         }
@@ -306,6 +629,68 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
     const Color::Lut* const srcLut = useColorspaces ? lutFromColorspace( (ViewerColorSpaceEnum)srcColorSpace ) : 0;
     const Color::Lut* const dstLut = useColorspaces ? lutFromColorspace( (ViewerColorSpaceEnum)dstColorSpace ) : 0;
 
+    if ( ( ( (srcNComps == 4) && (dstNComps == 3) ) || ( (srcNComps == 3) && (dstNComps == 4) ) ) &&
+         ( ImageConvertSIMD::getInstructionSet() != ImageConvertSIMD::eInstructionSetScalar) ) {
+        ///RGBA <-> RGB: convert whole rows with the SIMD kernels, the result is the same as the per-pixel code below
+        const int width = renderWindow.width();
+        const bool convertColorSpace = srcLut || dstLut;
+        ///The color channels go through linear floats when converting color-spaces or when diffusing the error to bytes
+        const bool useLinear = convertColorSpace || (dstMaxValue == 255);
+        const bool unpremultChannels = requiresUnpremult && convertColorSpace;
+        const DSTPIX alpha = convertPixelDepth<float, DSTPIX>(useAlpha0 ? 0.f : 1.f);
+        std::vector<float> srcRow(useLinear ? width * srcNComps : 0);
+        std::vector<float> linearRow(useLinear ? width * dstNComps : 0);
+        std::vector<unsigned short> uint8xxRow( (useLinear && dstMaxValue == 255) ? width * dstNComps : 0 );
+        std::vector<SRCPIX> srcRGBRow( (!useLinear && srcNComps == 4) ? width * 3 : 0 );
+        std::vector<DSTPIX> dstRGBRow( (!useLinear && dstNComps == 4) ? width * 3 : 0 );
+
+        for (int y = 0; y < renderWindow.height(); ++y) {
+            ///Start of the line for error diffusion, rand() is called as many times as in the per-pixel code
+            // coverity[dont_call]
+            int start = rand() % renderWindow.width();
+            const SRCPIX* srcPixels = (const SRCPIX*)srcImg.pixelAt(renderWindow.x1, renderWindow.y1 + y);
+            DSTPIX* dstPixels = (DSTPIX*)dstImg.pixelAt(renderWindow.x1, renderWindow.y1 + y);
+
+            if (!useLinear) {
+                if (srcNComps == 4) {
+                    dropRowAlpha(srcPixels, &srcRGBRow[0], width);
+                    convertRowDepth<SRCPIX, DSTPIX>(&srcRGBRow[0], dstPixels, width * 3);
+                } else {
+                    convertRowDepth<SRCPIX, DSTPIX>(srcPixels, &dstRGBRow[0], width * 3);
+                    addRowAlpha(&dstRGBRow[0], dstPixels, width, alpha);
+                }
+                continue;
+            }
+
+            if (srcNComps == 4) {
+                if (unpremultChannels) {
+                    ///Unpremult before doing colorspace conversion from linear to X
+                    const float* srcFloat = rowToFloat(srcPixels, &srcRow[0], width * 4);
+                    ImageConvertSIMD::rgbaToRgb(srcFloat, &linearRow[0], width, true);
+                    if (srcLut) {
+                        srcLut->fromColorSpaceFloatToLinearFloatFast(&linearRow[0], &linearRow[0], width * 3);
+                    }
+                } else {
+                    const float* linear = decodeRowToLinear(srcLut, srcPixels, &srcRow[0], width, 4);
+                    ImageConvertSIMD::rgbaToRgb(linear, &linearRow[0], width, false);
+                }
+            } else {
+                const float* linear = decodeRowToLinear(srcLut, srcPixels, &srcRow[0], width, 3);
+                ImageConvertSIMD::rgbToRgba(linear, &linearRow[0], width, 0.f);
+            }
+            encodeRowFromLinear(dstLut, &linearRow[0], dstPixels, width, dstNComps, start, uint8xxRow.empty() ? 0 : &uint8xxRow[0]);
+            if (dstNComps == 4) {
+                fillRowAlpha(dstPixels, width, alpha);
+            }
+        }
+
+        if (copyBitmap) {
+            dstImg.copyBitmapPortion(renderWindow, srcImg);
+        }
+
+        return;
+    }
+
     for (int y = 0; y < renderWindow.height(); ++y) {
         ///Start of the line for error diffusion
         // coverity[dont_call]
@@ -405,7 +790,7 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
                                     pixFloat = convertPixelDepth<SRCPIX, float>(sourcePixel);
                                     pixFloat = alphaForUnPremult == 0.f ? 0. : pixFloat / alphaForUnPremult;
                                     if (srcLut) {
-                                        pixFloat = srcLut->fromColorSpaceFloatToLinearFloat(pixFloat);
+                                        pixFloat = srcLut->fromColorSpaceFloatToLinearFloatFast(pixFloat);
                                     }
                                 } else if (srcLut) {
                                     if (srcMaxValue == 255) {
@@ -413,7 +798,7 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
                                     } else if (srcMaxValue == 65535) {
                                         pixFloat = srcLut->fromColorSpaceUint16ToLinearFloatFast(sourcePixel);
                                     } else {
-                                        pixFloat = srcLut->fromColorSpaceFloatToLinearFloat(sourcePixel);
+                                        pixFloat = srcLut->fromColorSpaceFloatToLinearFloatFast(sourcePixel);
                                     }
                                 } else {
                                     pixFloat = convertPixelDepth<SRCPIX, float>(sourcePixel);
@@ -430,7 +815,7 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
                                           convertPixelDepth<float, DSTPIX>(pixFloat);
                                 } else {
                                     if (dstLut) {
-                                        pixFloat = dstLut->toColorSpaceFloatFromLinearFloat(pixFloat);
+                                        pixFloat = dstLut->toColorSpaceFloatFromLinearFloatFast(pixFloat);
                                     }
                                     pix = convertPixelDepth<float, DSTPIX>(pixFloat);
                                 }
@@ -0,0 +1,1821 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ImageConvertSIMD.h"
+
+#include <algorithm> // min, max
+#include <cstring> // memcpy
+#include <limits>
+
+#ifdef NATRON_IMAGECONVERT_SIMD
+#include <immintrin.h>
+#endif
+
+#include "Engine/Lut.h"
+
+#ifdef NATRON_IMAGECONVERT_SIMD
+// Only enables the given instruction set in a function. AVX2 does not imply FMA, so that the compiler cannot fuse
+// multiplications and additions, which would not give the same result as the scalar code.
+#define NATRON_TARGET_SSE41 __attribute__( ( target("sse4.1") ) )
+#define NATRON_TARGET_AVX2 __attribute__( ( target("avx2") ) )
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+namespace ImageConvertSIMD {
+namespace {
+struct Kernels
+{
+    void (*byteToFloat)(const unsigned char* from, float* to, int n);
+    void (*shortToFloat)(const unsigned short* from, float* to, int n);
+    void (*floatToByte)(const float* from, unsigned char* to, int n);
+    void (*floatToShort)(const float* from, unsigned short* to, int n);
+    void (*floatToUint8xx)(const float* from, unsigned short* to, int n);
+    void (*lutUint8ToFloat)(const float* table, const unsigned char* from, float* to, int n);
+    void (*lutUint16ToFloat)(const float* table, const unsigned short* from, float* to, int n);
+    void (*lutFloatToUint8xx)(const unsigned short* table, const float* from, unsigned short* to, int n);
+    void (*lutFloatToFloat)(const float* table, float (*func)(float), const float* from, float* to, int n);
+    void (*viewerTransform)(const ViewerTransform& t, float* r, float* g, float* b, int n);
+    void (*rgbToLuminance)(const float* r, const float* g, const float* b, float* to, int n);
+    void (*rgbaToPlanes)(const float* from, float* c0, float* c1, float* c2, float* c3, int nPixels);
+    void (*diffuseErrorUint8xx)(const unsigned short* from, unsigned char* to, int n, bool backward);
+    void (*planesToBGRA)(const unsigned char* r, const unsigned char* g, const unsigned char* b, const unsigned char* a, unsigned int* to, int n);
+    void (*rgbaToRgb)(const float* from, float* to, int nPixels, bool unpremult);
+    void (*rgbToRgba)(const float* from, float* to, int nPixels, float alpha);
+    void (*halveRowsFloat)(const float* row0, const float* row1, float* to, int nPixels, int nComps);
+    void (*floatToHalf)(const float* from, unsigned short* to, int n);
+    void (*halfToFloat)(const unsigned short* from, float* to, int n);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Scalar kernels, also used for the last values of a row by the SIMD kernels
+
+// Same as hipart() in Lut.cpp
+inline unsigned short
+floatHipart(float f)
+{
+    union
+    {
+        float f;
+        unsigned short us[2];
+    }
+
+    tmp;
+
+    tmp.us[0] = tmp.us[1] = 0;
+    tmp.f = f;
+
+    return tmp.us[1];
+}
+
+void
+byteToFloatScalar(const unsigned char* from,
+                  float* to,
+                  int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = Color::intToFloat<256>(from[i]);
+    }
+}
+
+void
+shortToFloatScalar(const unsigned short* from,
+                   float* to,
+                   int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = Color::intToFloat<65536>(from[i]);
+    }
+}
+
+void
+floatToByteScalar(const float* from,
+                  unsigned char* to,
+                  int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = (unsigned char)Color::floatToInt<256>(from[i]);
+    }
+}
+
+void
+floatToShortScalar(const float* from,
+                   unsigned short* to,
+                   int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = (unsigned short)Color::floatToInt<65536>(from[i]);
+    }
+}
+
+void
+floatToUint8xxScalar(const float* from,
+                     unsigned short* to,
+                     int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = (unsigned short)Color::floatToInt<0xff01>(from[i]);
+    }
+}
+
+void
+lutUint8ToFloatScalar(const float* table,
+                      const unsigned char* from,
+                      float* to,
+                      int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = table[from[i]];
+    }
+}
+
+void
+lutUint16ToFloatScalar(const float* table,
+                       const unsigned short* from,
+                       float* to,
+                       int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = table[from[i]];
+    }
+}
+
+void
+lutFloatToUint8xxScalar(const unsigned short* table,
+                        const float* from,
+                        unsigned short* to,
+                        int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = table[floatHipart(from[i])];
+    }
+}
+
+void
+lutFloatToFloatScalar(const float* table,
+                      float (*func)(float),
+                      const float* from,
+                      float* to,
+                      int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = lutFloatToFloatPixel(table, func, from[i]);
+    }
+}
+
+// Same as ViewerInstancePrivate::lookupGammaLut
+inline float
+viewerGammaLutPixel(const float* lut,
+                    int lutSize,
+                    float value)
+{
+    if (value < 0.) {
+        return 0.;
+    } else if ( !(value <= 1.) ) { // also NaN, which must not be used as an index
+        return 1.;
+    }
+    int i = (int)(value * lutSize);
+    float alpha = std::max( 0.f, std::min(value * lutSize - i, 1.f) );
+    float a = lut[i];
+    float b = (i < lutSize) ? lut[i + 1] : 0.f;
+
+    return a * (1.f - alpha) + b * alpha;
+}
+
+inline double
+viewerGammaZeroPixel(double v)
+{
+    return (v < 1.) ? 0. : (v == 1. ? 1. : std::numeric_limits<double>::infinity() );
+}
+
+void
+viewerTransformScalar(const ViewerTransform& t,
+                      float* r,
+                      float* g,
+                      float* b,
+                      int n)
+{
+    for (int i = 0; i < n; ++i) {
+        double vr = r[i] * t.gain + t.offset;
+        double vg = g[i] * t.gain + t.offset;
+        double vb = b[i] * t.gain + t.offset;
+        if (t.gammaZero) {
+            vr = viewerGammaZeroPixel(vr);
+            vg = viewerGammaZeroPixel(vg);
+            vb = viewerGammaZeroPixel(vb);
+        } else if (t.gammaLut) {
+            vr = viewerGammaLutPixel(t.gammaLut, t.gammaLutSize, (float)vr);
+            vg = viewerGammaLutPixel(t.gammaLut, t.gammaLutSize, (float)vg);
+            vb = viewerGammaLutPixel(t.gammaLut, t.gammaLutSize, (float)vb);
+        }
+        if (t.luminance) {
+            vr = 0.299 * vr + 0.587 * vg + 0.114 * vb;
+            vg = vr;
+            vb = vr;
+        }
+        r[i] = (float)vr;
+        g[i] = (float)vg;
+        b[i] = (float)vb;
+    }
+}
+
+// The first pass of the viewer transform when the gamma uses the table, which is applied to the rounded values
+void
+viewerGainScalar(double gain,
+                 double offset,
+                 float* v,
+                 int n)
+{
+    for (int i = 0; i < n; ++i) {
+        v[i] = (float)(v[i] * gain + offset);
+    }
+}
+
+void
+viewerGammaLutRowScalar(const float* lut,
+                        int lutSize,
+                        float* v,
+                        int n)
+{
+    for (int i = 0; i < n; ++i) {
+        v[i] = viewerGammaLutPixel(lut, lutSize, v[i]);
+    }
+}
+
+void
+rgbToLuminanceScalar(const float* r,
+                     const float* g,
+                     const float* b,
+                     float* to,
+                     int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = (float)(0.299 * (double)r[i] + 0.587 * (double)g[i] + 0.114 * (double)b[i]);
+    }
+}
+
+void
+rgbaToPlanesScalar(const float* from,
+                   float* c0,
+                   float* c1,
+                   float* c2,
+                   float* c3,
+                   int nPixels)
+{
+    for (int i = 0; i < nPixels; ++i, from += 4) {
+        c0[i] = from[0];
+        c1[i] = from[1];
+        c2[i] = from[2];
+        c3[i] = from[3];
+    }
+}
+
+// Continues an error diffusion: only the low byte of error is used
+inline void
+diffuseErrorUint8xxPixels(unsigned error,
+                          const unsigned short* from,
+                          unsigned char* to,
+                          int n,
+                          bool backward)
+{
+    for (int k = 0; k < n; ++k) {
+        const int i = backward ? n - 1 - k : k;
+        error = (error & 0xff) + from[i];
+        to[i] = (unsigned char)(error >> 8);
+    }
+}
+
+void
+diffuseErrorUint8xxScalar(const unsigned short* from,
+                          unsigned char* to,
+                          int n,
+                          bool backward)
+{
+    diffuseErrorUint8xxPixels(0x80, from, to, n, backward);
+}
+
+void
+planesToBGRAScalar(const unsigned char* r,
+                   const unsigned char* g,
+                   const unsigned char* b,
+                   const unsigned char* a,
+                   unsigned int* to,
+                   int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = (a[i] << 24) | (r[i] << 16) | (g[i] << 8) | b[i];
+    }
+}
+
+void
+rgbaToRgbScalar(const float* from,
+                float* to,
+                int nPixels,
+                bool unpremult)
+{
+    for (int i = 0; i < nPixels; ++i, from += 4, to += 3) {
+        if (unpremult) {
+            const float a = from[3];
+            for (int k = 0; k < 3; ++k) {
+                to[k] = a == 0.f ? 0.f : from[k] / a;
+            }
+        } else {
+            for (int k = 0; k < 3; ++k) {
+                to[k] = from[k];
+            }
+        }
+    }
+}
+
+void
+rgbToRgbaScalar(const float* from,
+                float* to,
+                int nPixels,
+                float alpha)
+{
+    for (int i = 0; i < nPixels; ++i, from += 3, to += 4) {
+        to[0] = from[0];
+        to[1] = from[1];
+        to[2] = from[2];
+        to[3] = alpha;
+    }
+}
+
+void
+halveRowsFloatScalar(const float* row0,
+                     const float* row1,
+                     float* to,
+                     int nPixels,
+                     int nComps)
+{
+    for (int i = 0; i < nPixels; ++i, row0 += 2 * nComps, row1 += 2 * nComps, to += nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            // Same summation order as the integer box filter, the division by 4 is exact
+            to[k] = ( ( (row0[k] + row0[k + nComps]) + row1[k] ) + row1[k + nComps] ) * 0.25f;
+        }
+    }
+}
+
+inline unsigned int
+floatBits(float f)
+{
+    union
+    {
+        float f;
+        unsigned int i;
+    }
+
+    tmp;
+
+    tmp.f = f;
+
+    return tmp.i;
+}
+
+inline float
+bitsToFloat(unsigned int i)
+{
+    union
+    {
+        unsigned int i;
+        float f;
+    }
+
+    tmp;
+
+    tmp.i = i;
+
+    return tmp.f;
+}
+
+// Rounds to the nearest half float, ties to even. Values above the largest half give infinity and NaNs give 0x7e00.
+inline unsigned short
+floatToHalfPixel(float f)
+{
+    unsigned int x = floatBits(f);
+    const unsigned int sign = x & 0x80000000U;
+    unsigned int h;
+
+    x ^= sign;
+    if (x >= 0x47800000U) {
+        // 2^16 or more, infinity or NaN
+        h = (x > 0x7f800000U) ? 0x7e00U : 0x7c00U;
+    } else if (x < 0x38800000U) {
+        // Below 2^-14, the half is denormalized: adding 0.5 aligns its 10 bits of mantissa with the lowest bits of the
+        // float, and the float addition rounds them to nearest even
+        h = floatBits( bitsToFloat(x) + bitsToFloat(126U << 23) ) - (126U << 23);
+    } else {
+        // Rebias the exponent and round the 13 dropped bits of the mantissa to nearest even. A carry may go up to infinity.
+        h = ( x + ( (unsigned int)(15 - 127) << 23 ) + 0xfffU + ( (x >> 13) & 1U ) ) >> 13;
+    }
+
+    return (unsigned short)( (sign >> 16) | h );
+}
+
+// The conversion of a half float to float is exact
+inline float
+halfToFloatPixel(unsigned short h)
+{
+    const unsigned int shiftedExponent = 0x7c00U << 13;
+    unsigned int x = (h & 0x7fffU) << 13;
+    const unsigned int exponent = x & shiftedExponent;
+
+    x += (127 - 15) << 23;
+    if (exponent == shiftedExponent) {
+        // infinity or NaN
+        x += (128 - 16) << 23;
+    } else if (exponent == 0) {
+        // zero or denormalized: x + 2^-14 is a normalized float, subtracting 2^-14 gives x exactly
+        x = floatBits( bitsToFloat( x + (1U << 23) ) - bitsToFloat(113U << 23) );
+    }
+
+    return bitsToFloat( x | ( (h & 0x8000U) << 16 ) );
+}
+
+void
+floatToHalfScalar(const float* from,
+                  unsigned short* to,
+                  int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = floatToHalfPixel(from[i]);
+    }
+}
+
+void
+halfToFloatScalar(const unsigned short* from,
+                  float* to,
+                  int n)
+{
+    for (int i = 0; i < n; ++i) {
+        to[i] = halfToFloatPixel(from[i]);
+    }
+}
+
+const Kernels scalarKernels = {
+    byteToFloatScalar,
+    shortToFloatScalar,
+    floatToByteScalar,
+    floatToShortScalar,
+    floatToUint8xxScalar,
+    lutUint8ToFloatScalar,
+    lutUint16ToFloatScalar,
+    lutFloatToUint8xxScalar,
+    lutFloatToFloatScalar,
+    viewerTransformScalar,
+    rgbToLuminanceScalar,
+    rgbaToPlanesScalar,
+    diffuseErrorUint8xxScalar,
+    planesToBGRAScalar,
+    rgbaToRgbScalar,
+    rgbToRgbaScalar,
+    halveRowsFloatScalar,
+    floatToHalfScalar,
+    halfToFloatScalar
+};
+
+#ifdef NATRON_IMAGECONVERT_SIMD
+
+////////////////////////////////////////////////////////////////////////////////
+// SSE4.1 kernels, 4 values at a time
+
+// Same as Color::floatToInt<maxValue + 1>: v <= 0 gives 0, v >= 1 gives maxValue, NaN gives 0x80000000 as int(NaN)
+NATRON_TARGET_SSE41 inline __m128i
+floatToIntSSE41(__m128 v,
+                float maxValue)
+{
+    __m128 le0 = _mm_cmple_ps( v, _mm_setzero_ps() );
+    __m128 ge1 = _mm_cmpge_ps( v, _mm_set1_ps(1.f) );
+    __m128i r = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( v, _mm_set1_ps(maxValue) ), _mm_set1_ps(0.5f) ) );
+
+    r = _mm_blendv_epi8( r, _mm_set1_epi32( (int)maxValue ), _mm_castps_si128(ge1) );
+
+    return _mm_andnot_si128(_mm_castps_si128(le0), r);
+}
+
+NATRON_TARGET_SSE41 void
+byteToFloatSSE41(const unsigned char* from,
+                 float* to,
+                 int n)
+{
+    const __m128 div = _mm_set1_ps(255.f);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        int packed;
+        std::memcpy(&packed, from + i, 4);
+        __m128 v = _mm_cvtepi32_ps( _mm_cvtepu8_epi32( _mm_cvtsi32_si128(packed) ) );
+        _mm_storeu_ps( to + i, _mm_div_ps(v, div) );
+    }
+    byteToFloatScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+shortToFloatSSE41(const unsigned short* from,
+                  float* to,
+                  int n)
+{
+    const __m128 div = _mm_set1_ps(65535.f);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_cvtepi32_ps( _mm_cvtepu16_epi32( _mm_loadl_epi64( (const __m128i*)(from + i) ) ) );
+        _mm_storeu_ps( to + i, _mm_div_ps(v, div) );
+    }
+    shortToFloatScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+floatToByteSSE41(const float* from,
+                 unsigned char* to,
+                 int n)
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i r = floatToIntSSE41(_mm_loadu_ps(from + i), 255.f);
+        r = _mm_packus_epi32(r, r);
+        r = _mm_packus_epi16(r, r);
+        int packed = _mm_cvtsi128_si32(r);
+        std::memcpy(to + i, &packed, 4);
+    }
+    floatToByteScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+floatToShortSSE41(const float* from,
+                  unsigned short* to,
+                  int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = floatToIntSSE41(_mm_loadu_ps(from + i), 65535.f);
+        __m128i hi = floatToIntSSE41(_mm_loadu_ps(from + i + 4), 65535.f);
+        _mm_storeu_si128( (__m128i*)(to + i), _mm_packus_epi32(lo, hi) );
+    }
+    floatToShortScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+floatToUint8xxSSE41(const float* from,
+                    unsigned short* to,
+                    int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = floatToIntSSE41(_mm_loadu_ps(from + i), 65280.f);
+        __m128i hi = floatToIntSSE41(_mm_loadu_ps(from + i + 4), 65280.f);
+        _mm_storeu_si128( (__m128i*)(to + i), _mm_packus_epi32(lo, hi) );
+    }
+    floatToUint8xxScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+lutUint8ToFloatSSE41(const float* table,
+                     const unsigned char* from,
+                     float* to,
+                     int n)
+{
+    // There is no gather before AVX2
+    lutUint8ToFloatScalar(table, from, to, n);
+}
+
+NATRON_TARGET_SSE41 void
+lutUint16ToFloatSSE41(const float* table,
+                      const unsigned short* from,
+                      float* to,
+                      int n)
+{
+    // There is no gather before AVX2
+    lutUint16ToFloatScalar(table, from, to, n);
+}
+
+NATRON_TARGET_SSE41 void
+lutFloatToUint8xxSSE41(const unsigned short* table,
+                       const float* from,
+                       unsigned short* to,
+                       int n)
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i index = _mm_srli_epi32(_mm_castps_si128( _mm_loadu_ps(from + i) ), 16);
+        to[i] = table[_mm_extract_epi32(index, 0)];
+        to[i + 1] = table[_mm_extract_epi32(index, 1)];
+        to[i + 2] = table[_mm_extract_epi32(index, 2)];
+        to[i + 3] = table[_mm_extract_epi32(index, 3)];
+    }
+    lutFloatToUint8xxScalar(table, from + i, to + i, n - i);
+}
+
+// Computes table[index] + frac * (table[index + 1] - table[index]), see lutFloatToFloatPixel
+NATRON_TARGET_SSE41 void
+lutFloatToFloatSSE41(const float* table,
+                     float (*func)(float),
+                     const float* from,
+                     float* to,
+                     int n)
+{
+    const __m128i minBits = _mm_set1_epi32(NATRON_LUT_FLOAT_MIN_BITS);
+    const __m128i maxOffset = _mm_set1_epi32(NATRON_LUT_FLOAT_MAX_BITS - NATRON_LUT_FLOAT_MIN_BITS - 1);
+    const __m128i fracMask = _mm_set1_epi32( (1 << NATRON_LUT_FLOAT_INDEX_SHIFT) - 1 );
+    const __m128 fracScale = _mm_set1_ps( 1.f / (1 << NATRON_LUT_FLOAT_INDEX_SHIFT) );
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i bits = _mm_castps_si128( _mm_loadu_ps(from + i) );
+        __m128i offset = _mm_sub_epi32(bits, minBits);
+        // The values outside of the table wrap to large unsigned offsets
+        __m128i inTable = _mm_cmpeq_epi32(_mm_min_epu32(offset, maxOffset), offset);
+        if (_mm_movemask_ps( _mm_castsi128_ps(inTable) ) != 0xf) {
+            lutFloatToFloatScalar(table, func, from + i, to + i, 4);
+            continue;
+        }
+        int index[4];
+        _mm_storeu_si128( (__m128i*)index, _mm_srli_epi32(offset, NATRON_LUT_FLOAT_INDEX_SHIFT) );
+        __m128 lo = _mm_setr_ps(table[index[0]], table[index[1]], table[index[2]], table[index[3]]);
+        __m128 hi = _mm_setr_ps(table[index[0] + 1], table[index[1] + 1], table[index[2] + 1], table[index[3] + 1]);
+        __m128 frac = _mm_mul_ps(_mm_cvtepi32_ps( _mm_and_si128(bits, fracMask) ), fracScale);
+        _mm_storeu_ps( to + i, _mm_add_ps( lo, _mm_mul_ps( frac, _mm_sub_ps(hi, lo) ) ) );
+    }
+    lutFloatToFloatScalar(table, func, from + i, to + i, n - i);
+}
+
+// Same as viewerGammaLutPixel. The two entries around each value are read with scalar loads.
+NATRON_TARGET_SSE41 inline __m128
+viewerGammaLutSSE41(const float* lut,
+                    int lutSize,
+                    __m128 v)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    __m128 lt0 = _mm_cmplt_ps(v, zero);
+    __m128 gt1 = _mm_cmpnle_ps(v, one); // also NaN
+    __m128 scaled = _mm_mul_ps( v, _mm_set1_ps( (float)lutSize ) );
+    // The values outside of [0,1] read the first entry, their result is replaced below
+    __m128i i = _mm_andnot_si128( _mm_castps_si128( _mm_or_ps(lt0, gt1) ), _mm_cvttps_epi32(scaled) );
+    // Same operand order as std::max(0.f, std::min(x, 1.f)), which matters for -0
+    __m128 alpha = _mm_max_ps( _mm_min_ps( one, _mm_sub_ps( scaled, _mm_cvtepi32_ps(i) ) ), zero );
+    int index[4];
+    _mm_storeu_si128( (__m128i*)index, i );
+    __m128 a = _mm_setr_ps(lut[index[0]], lut[index[1]], lut[index[2]], lut[index[3]]);
+    __m128 b = _mm_setr_ps(index[0] < lutSize ? lut[index[0] + 1] : 0.f, index[1] < lutSize ? lut[index[1] + 1] : 0.f,
+                           index[2] < lutSize ? lut[index[2] + 1] : 0.f, index[3] < lutSize ? lut[index[3] + 1] : 0.f);
+    __m128 r = _mm_add_ps( _mm_mul_ps( a, _mm_sub_ps(one, alpha) ), _mm_mul_ps(b, alpha) );
+    r = _mm_blendv_ps(r, one, gt1);
+
+    return _mm_andnot_ps(lt0, r);
+}
+
+NATRON_TARGET_SSE41 inline __m128d
+viewerGammaZeroSSE41(__m128d v)
+{
+    const __m128d one = _mm_set1_pd(1.);
+    __m128d r = _mm_blendv_pd( _mm_set1_pd( std::numeric_limits<double>::infinity() ), one, _mm_cmpeq_pd(v, one) );
+
+    return _mm_andnot_pd(_mm_cmplt_pd(v, one), r);
+}
+
+NATRON_TARGET_SSE41 inline __m128d
+luminanceSSE41(__m128d r,
+               __m128d g,
+               __m128d b)
+{
+    __m128d y = _mm_add_pd( _mm_mul_pd(_mm_set1_pd(0.299), r), _mm_mul_pd(_mm_set1_pd(0.587), g) );
+
+    return _mm_add_pd( y, _mm_mul_pd(_mm_set1_pd(0.114), b) );
+}
+
+// 4 floats to 2 x 2 doubles, and back
+NATRON_TARGET_SSE41 inline void
+floatsToDoublesSSE41(__m128 v,
+                     __m128d* d)
+{
+    d[0] = _mm_cvtps_pd(v);
+    d[1] = _mm_cvtps_pd( _mm_movehl_ps(v, v) );
+}
+
+NATRON_TARGET_SSE41 inline __m128
+doublesToFloatsSSE41(const __m128d* d)
+{
+    return _mm_movelh_ps( _mm_cvtpd_ps(d[0]), _mm_cvtpd_ps(d[1]) );
+}
+
+NATRON_TARGET_SSE41 void
+rgbToLuminanceSSE41(const float* r,
+                    const float* g,
+                    const float* b,
+                    float* to,
+                    int n)
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128d vr[2], vg[2], vb[2], y[2];
+        floatsToDoublesSSE41(_mm_loadu_ps(r + i), vr);
+        floatsToDoublesSSE41(_mm_loadu_ps(g + i), vg);
+        floatsToDoublesSSE41(_mm_loadu_ps(b + i), vb);
+        y[0] = luminanceSSE41(vr[0], vg[0], vb[0]);
+        y[1] = luminanceSSE41(vr[1], vg[1], vb[1]);
+        _mm_storeu_ps( to + i, doublesToFloatsSSE41(y) );
+    }
+    rgbToLuminanceScalar(r + i, g + i, b + i, to + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+viewerGainSSE41(double gain,
+                double offset,
+                float* v,
+                int n)
+{
+    const __m128d g = _mm_set1_pd(gain);
+    const __m128d o = _mm_set1_pd(offset);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128d d[2];
+        floatsToDoublesSSE41(_mm_loadu_ps(v + i), d);
+        d[0] = _mm_add_pd(_mm_mul_pd(d[0], g), o);
+        d[1] = _mm_add_pd(_mm_mul_pd(d[1], g), o);
+        _mm_storeu_ps( v + i, doublesToFloatsSSE41(d) );
+    }
+    viewerGainScalar(gain, offset, v + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+viewerGammaLutRowSSE41(const float* lut,
+                       int lutSize,
+                       float* v,
+                       int n)
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps( v + i, viewerGammaLutSSE41(lut, lutSize, _mm_loadu_ps(v + i)) );
+    }
+    viewerGammaLutRowScalar(lut, lutSize, v + i, n - i);
+}
+
+// Without the gamma table, all the transform is computed in double precision in a single pass. With the table,
+// which is applied to the values rounded to float, the gain, the gamma and the luminance are separate passes.
+NATRON_TARGET_SSE41 void
+viewerTransformSSE41(const ViewerTransform& t,
+                     float* r,
+                     float* g,
+                     float* b,
+                     int n)
+{
+    if (!t.gammaZero && t.gammaLut) {
+        float* planes[3] = { r, g, b };
+        for (int c = 0; c < 3; ++c) {
+            viewerGainSSE41(t.gain, t.offset, planes[c], n);
+            viewerGammaLutRowSSE41(t.gammaLut, t.gammaLutSize, planes[c], n);
+        }
+        if (t.luminance) {
+            rgbToLuminanceSSE41(r, g, b, r, n);
+            std::copy(r, r + n, g);
+            std::copy(r, r + n, b);
+        }
+
+        return;
+    }
+
+    const __m128d gain = _mm_set1_pd(t.gain);
+    const __m128d offset = _mm_set1_pd(t.offset);
+    const bool gammaZero = t.gammaZero;
+    const bool luminance = t.luminance;
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128d vr[2], vg[2], vb[2];
+        floatsToDoublesSSE41(_mm_loadu_ps(r + i), vr);
+        floatsToDoublesSSE41(_mm_loadu_ps(g + i), vg);
+        floatsToDoublesSSE41(_mm_loadu_ps(b + i), vb);
+        for (int k = 0; k < 2; ++k) {
+            vr[k] = _mm_add_pd(_mm_mul_pd(vr[k], gain), offset);
+            vg[k] = _mm_add_pd(_mm_mul_pd(vg[k], gain), offset);
+            vb[k] = _mm_add_pd(_mm_mul_pd(vb[k], gain), offset);
+            if (gammaZero) {
+                vr[k] = viewerGammaZeroSSE41(vr[k]);
+                vg[k] = viewerGammaZeroSSE41(vg[k]);
+                vb[k] = viewerGammaZeroSSE41(vb[k]);
+            }
+            if (luminance) {
+                vr[k] = vg[k] = vb[k] = luminanceSSE41(vr[k], vg[k], vb[k]);
+            }
+        }
+        _mm_storeu_ps( r + i, doublesToFloatsSSE41(vr) );
+        _mm_storeu_ps( g + i, doublesToFloatsSSE41(vg) );
+        _mm_storeu_ps( b + i, doublesToFloatsSSE41(vb) );
+    }
+    viewerTransformScalar(t, r + i, g + i, b + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+rgbaToPlanesSSE41(const float* from,
+                  float* c0,
+                  float* c1,
+                  float* c2,
+                  float* c3,
+                  int nPixels)
+{
+    int i = 0;
+
+    for (; i + 4 <= nPixels; i += 4) {
+        __m128 p0 = _mm_loadu_ps(from + 4 * i);
+        __m128 p1 = _mm_loadu_ps(from + 4 * i + 4);
+        __m128 p2 = _mm_loadu_ps(from + 4 * i + 8);
+        __m128 p3 = _mm_loadu_ps(from + 4 * i + 12);
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        _mm_storeu_ps(c0 + i, p0);
+        _mm_storeu_ps(c1 + i, p1);
+        _mm_storeu_ps(c2 + i, p2);
+        _mm_storeu_ps(c3 + i, p3);
+    }
+    rgbaToPlanesScalar(from + 4 * i, c0 + i, c1 + i, c2 + i, c3 + i, nPixels - i);
+}
+
+// The error before a value is 0x80 plus the sum of the previous values, modulo 256: it is computed with prefix sums
+// of 8 values in 16-bit integers, which are exact modulo 256. So is the result, since (error >> 8) is truncated to a byte.
+NATRON_TARGET_SSE41 void
+diffuseErrorUint8xxSSE41(const unsigned short* from,
+                         unsigned char* to,
+                         int n,
+                         bool backward)
+{
+    const __m128i lowByte = _mm_set1_epi16(0xff);
+    const __m128i reverse = _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+    unsigned error = 0x80;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const int offset = backward ? n - 8 - i : i;
+        __m128i v = _mm_loadu_si128( (const __m128i*)(from + offset) );
+        if (backward) {
+            v = _mm_shuffle_epi8(v, reverse);
+        }
+        __m128i sum = _mm_add_epi16( v, _mm_slli_si128(v, 2) );
+        sum = _mm_add_epi16( sum, _mm_slli_si128(sum, 4) );
+        sum = _mm_add_epi16( sum, _mm_slli_si128(sum, 8) );
+        __m128i before = _mm_and_si128( _mm_add_epi16( _mm_set1_epi16( (short)error ), _mm_sub_epi16(sum, v) ), lowByte );
+        __m128i r = _mm_srli_epi16(_mm_add_epi16(before, v), 8);
+        if (backward) {
+            r = _mm_shuffle_epi8(r, reverse);
+        }
+        _mm_storel_epi64( (__m128i*)(to + offset), _mm_packus_epi16(r, r) );
+        error += _mm_extract_epi16(sum, 7);
+    }
+    if (backward) {
+        diffuseErrorUint8xxPixels(error, from, to, n - i, true);
+    } else {
+        diffuseErrorUint8xxPixels(error, from + i, to + i, n - i, false);
+    }
+}
+
+NATRON_TARGET_SSE41 void
+planesToBGRASSE41(const unsigned char* r,
+                  const unsigned char* g,
+                  const unsigned char* b,
+                  const unsigned char* a,
+                  unsigned int* to,
+                  int n)
+{
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i vr = _mm_loadu_si128( (const __m128i*)(r + i) );
+        __m128i vg = _mm_loadu_si128( (const __m128i*)(g + i) );
+        __m128i vb = _mm_loadu_si128( (const __m128i*)(b + i) );
+        __m128i va = _mm_loadu_si128( (const __m128i*)(a + i) );
+        __m128i bg0 = _mm_unpacklo_epi8(vb, vg);
+        __m128i bg1 = _mm_unpackhi_epi8(vb, vg);
+        __m128i ra0 = _mm_unpacklo_epi8(vr, va);
+        __m128i ra1 = _mm_unpackhi_epi8(vr, va);
+        _mm_storeu_si128( (__m128i*)(to + i), _mm_unpacklo_epi16(bg0, ra0) );
+        _mm_storeu_si128( (__m128i*)(to + i + 4), _mm_unpackhi_epi16(bg0, ra0) );
+        _mm_storeu_si128( (__m128i*)(to + i + 8), _mm_unpacklo_epi16(bg1, ra1) );
+        _mm_storeu_si128( (__m128i*)(to + i + 12), _mm_unpackhi_epi16(bg1, ra1) );
+    }
+    planesToBGRAScalar(r + i, g + i, b + i, a + i, to + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+rgbaToRgbSSE41(const float* from,
+               float* to,
+               int nPixels,
+               bool unpremult)
+{
+    // Each pixel is stored with 4 floats, the 4th one being overwritten by the next pixel:
+    // the last pixel is converted by the scalar code so that nothing is written past the end of the row
+    int i = 0;
+
+    if (unpremult) {
+        const __m128 zero = _mm_setzero_ps();
+        for (; i + 1 < nPixels; ++i) {
+            __m128 v = _mm_loadu_ps(from + 4 * i);
+            __m128 a = _mm_shuffle_ps( v, v, _MM_SHUFFLE(3, 3, 3, 3) );
+            __m128 r = _mm_andnot_ps( _mm_cmpeq_ps(a, zero), _mm_div_ps(v, a) );
+            _mm_storeu_ps(to + 3 * i, r);
+        }
+    } else {
+        for (; i + 1 < nPixels; ++i) {
+            _mm_storeu_ps( to + 3 * i, _mm_loadu_ps(from + 4 * i) );
+        }
+    }
+    rgbaToRgbScalar(from + 4 * i, to + 3 * i, nPixels - i, unpremult);
+}
+
+NATRON_TARGET_SSE41 void
+rgbToRgbaSSE41(const float* from,
+               float* to,
+               int nPixels,
+               float alpha)
+{
+    // Each pixel is loaded with 4 floats: the last pixel is converted by the scalar code so that nothing is read
+    // past the end of the row
+    const __m128 a = _mm_set1_ps(alpha);
+    int i = 0;
+
+    for (; i + 1 < nPixels; ++i) {
+        _mm_storeu_ps( to + 4 * i, _mm_blend_ps(_mm_loadu_ps(from + 3 * i), a, 0x8) );
+    }
+    rgbToRgbaScalar(from + 3 * i, to + 4 * i, nPixels - i, alpha);
+}
+
+NATRON_TARGET_SSE41 void
+halveRowsFloatSSE41(const float* row0,
+                    const float* row1,
+                    float* to,
+                    int nPixels,
+                    int nComps)
+{
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    int i = 0;
+
+    if (nComps == 4) {
+        // One pixel per register
+        for (; i < nPixels; ++i) {
+            __m128 s = _mm_add_ps( _mm_loadu_ps(row0 + 8 * i), _mm_loadu_ps(row0 + 8 * i + 4) );
+            s = _mm_add_ps( s, _mm_loadu_ps(row1 + 8 * i) );
+            s = _mm_add_ps( s, _mm_loadu_ps(row1 + 8 * i + 4) );
+            _mm_storeu_ps( to + 4 * i, _mm_mul_ps(s, quarter) );
+        }
+    } else if (nComps == 1) {
+        // Separate the even and odd columns of 8 source pixels
+        for (; i + 4 <= nPixels; i += 4) {
+            __m128 a0 = _mm_loadu_ps(row0 + 2 * i);
+            __m128 a1 = _mm_loadu_ps(row0 + 2 * i + 4);
+            __m128 b0 = _mm_loadu_ps(row1 + 2 * i);
+            __m128 b1 = _mm_loadu_ps(row1 + 2 * i + 4);
+            __m128 s = _mm_add_ps( _mm_shuffle_ps( a0, a1, _MM_SHUFFLE(2, 0, 2, 0) ), _mm_shuffle_ps( a0, a1, _MM_SHUFFLE(3, 1, 3, 1) ) );
+            s = _mm_add_ps( s, _mm_shuffle_ps( b0, b1, _MM_SHUFFLE(2, 0, 2, 0) ) );
+            s = _mm_add_ps( s, _mm_shuffle_ps( b0, b1, _MM_SHUFFLE(3, 1, 3, 1) ) );
+            _mm_storeu_ps( to + i, _mm_mul_ps(s, quarter) );
+        }
+    }
+    halveRowsFloatScalar(row0 + 2 * nComps * i, row1 + 2 * nComps * i, to + nComps * i, nPixels - i, nComps);
+}
+
+// Same as floatToHalfPixel, the halves are in the low 16 bits of each value
+NATRON_TARGET_SSE41 inline __m128i
+floatToHalfSSE41(__m128 v)
+{
+    __m128i x = _mm_castps_si128(v);
+    const __m128i sign = _mm_and_si128( x, _mm_set1_epi32( (int)0x80000000U ) );
+
+    x = _mm_xor_si128(x, sign);
+    const __m128i infNaN = _mm_or_si128( _mm_set1_epi32(0x7c00), _mm_and_si128( _mm_cmpgt_epi32( x, _mm_set1_epi32(0x7f800000) ), _mm_set1_epi32(0x200) ) );
+    const __m128i half = _mm_set1_epi32(126 << 23);
+    const __m128i denormal = _mm_sub_epi32( _mm_castps_si128( _mm_add_ps( _mm_castsi128_ps(x), _mm_castsi128_ps(half) ) ), half );
+    const __m128i odd = _mm_and_si128( _mm_srli_epi32(x, 13), _mm_set1_epi32(1) );
+    const __m128i normal = _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( x, _mm_set1_epi32( (int)( ( (unsigned int)(15 - 127) << 23 ) + 0xfffU ) ) ), odd ), 13 );
+    __m128i h = _mm_blendv_epi8( normal, denormal, _mm_cmplt_epi32( x, _mm_set1_epi32(0x38800000) ) );
+
+    h = _mm_blendv_epi8( h, infNaN, _mm_cmpgt_epi32( x, _mm_set1_epi32(0x477fffff) ) );
+
+    return _mm_or_si128( h, _mm_srli_epi32(sign, 16) );
+}
+
+// Same as halfToFloatPixel, the halves are in the low 16 bits of each value
+NATRON_TARGET_SSE41 inline __m128
+halfToFloatSSE41(__m128i h)
+{
+    const __m128i shiftedExponent = _mm_set1_epi32(0x7c00 << 13);
+    __m128i x = _mm_slli_epi32( _mm_and_si128( h, _mm_set1_epi32(0x7fff) ), 13 );
+    const __m128i exponent = _mm_and_si128(x, shiftedExponent);
+
+    x = _mm_add_epi32( x, _mm_set1_epi32( (127 - 15) << 23 ) );
+    x = _mm_add_epi32( x, _mm_and_si128( _mm_cmpeq_epi32(exponent, shiftedExponent), _mm_set1_epi32( (128 - 16) << 23 ) ) );
+    const __m128i denormal = _mm_castps_si128( _mm_sub_ps( _mm_castsi128_ps( _mm_add_epi32( x, _mm_set1_epi32(1 << 23) ) ), _mm_castsi128_ps( _mm_set1_epi32(113 << 23) ) ) );
+    x = _mm_blendv_epi8( x, denormal, _mm_cmpeq_epi32( exponent, _mm_setzero_si128() ) );
+
+    return _mm_castsi128_ps( _mm_or_si128( x, _mm_slli_epi32( _mm_and_si128( h, _mm_set1_epi32(0x8000) ), 16 ) ) );
+}
+
+NATRON_TARGET_SSE41 void
+floatToHalfSSE41(const float* from,
+                 unsigned short* to,
+                 int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128( (__m128i*)(to + i), _mm_packus_epi32( floatToHalfSSE41( _mm_loadu_ps(from + i) ), floatToHalfSSE41( _mm_loadu_ps(from + i + 4) ) ) );
+    }
+    floatToHalfScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_SSE41 void
+halfToFloatSSE41(const unsigned short* from,
+                 float* to,
+                 int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128( (const __m128i*)(from + i) );
+        _mm_storeu_ps( to + i, halfToFloatSSE41( _mm_cvtepu16_epi32(h) ) );
+        _mm_storeu_ps( to + i + 4, halfToFloatSSE41( _mm_cvtepu16_epi32( _mm_srli_si128(h, 8) ) ) );
+    }
+    halfToFloatScalar(from + i, to + i, n - i);
+}
+
+const Kernels sse41Kernels = {
+    byteToFloatSSE41,
+    shortToFloatSSE41,
+    floatToByteSSE41,
+    floatToShortSSE41,
+    floatToUint8xxSSE41,
+    lutUint8ToFloatSSE41,
+    lutUint16ToFloatSSE41,
+    lutFloatToUint8xxSSE41,
+    lutFloatToFloatSSE41,
+    viewerTransformSSE41,
+    rgbToLuminanceSSE41,
+    rgbaToPlanesSSE41,
+    diffuseErrorUint8xxSSE41,
+    planesToBGRASSE41,
+    rgbaToRgbSSE41,
+    rgbToRgbaSSE41,
+    halveRowsFloatSSE41,
+    floatToHalfSSE41,
+    halfToFloatSSE41
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels, 8 values at a time
+
+NATRON_TARGET_AVX2 inline __m256i
+floatToIntAVX2(__m256 v,
+               float maxValue)
+{
+    __m256 le0 = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LE_OQ);
+    __m256 ge1 = _mm256_cmp_ps(v, _mm256_set1_ps(1.f), _CMP_GE_OQ);
+    __m256i r = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( v, _mm256_set1_ps(maxValue) ), _mm256_set1_ps(0.5f) ) );
+
+    r = _mm256_blendv_epi8( r, _mm256_set1_epi32( (int)maxValue ), _mm256_castps_si256(ge1) );
+
+    return _mm256_andnot_si256(_mm256_castps_si256(le0), r);
+}
+
+// Packs 8 ints in [0, 65535] to 8 unsigned shorts, in order
+NATRON_TARGET_AVX2 inline __m128i
+packUint16AVX2(__m256i r)
+{
+    return _mm_packus_epi32( _mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1) );
+}
+
+NATRON_TARGET_AVX2 void
+byteToFloatAVX2(const unsigned char* from,
+                float* to,
+                int n)
+{
+    const __m256 div = _mm256_set1_ps(255.f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(from + i) ) ) );
+        _mm256_storeu_ps( to + i, _mm256_div_ps(v, div) );
+    }
+    byteToFloatScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+shortToFloatAVX2(const unsigned short* from,
+                 float* to,
+                 int n)
+{
+    const __m256 div = _mm256_set1_ps(65535.f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_cvtepi32_ps( _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(from + i) ) ) );
+        _mm256_storeu_ps( to + i, _mm256_div_ps(v, div) );
+    }
+    shortToFloatScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+floatToByteAVX2(const float* from,
+                unsigned char* to,
+                int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i r = packUint16AVX2( floatToIntAVX2(_mm256_loadu_ps(from + i), 255.f) );
+        _mm_storel_epi64( (__m128i*)(to + i), _mm_packus_epi16(r, r) );
+    }
+    floatToByteScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+floatToShortAVX2(const float* from,
+                 unsigned short* to,
+                 int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128( (__m128i*)(to + i), packUint16AVX2( floatToIntAVX2(_mm256_loadu_ps(from + i), 65535.f) ) );
+    }
+    floatToShortScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+floatToUint8xxAVX2(const float* from,
+                   unsigned short* to,
+                   int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128( (__m128i*)(to + i), packUint16AVX2( floatToIntAVX2(_mm256_loadu_ps(from + i), 65280.f) ) );
+    }
+    floatToUint8xxScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+lutUint8ToFloatAVX2(const float* table,
+                    const unsigned char* from,
+                    float* to,
+                    int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i index = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(from + i) ) );
+        _mm256_storeu_ps( to + i, _mm256_i32gather_ps(table, index, 4) );
+    }
+    lutUint8ToFloatScalar(table, from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+lutUint16ToFloatAVX2(const float* table,
+                     const unsigned short* from,
+                     float* to,
+                     int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i index = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(from + i) ) );
+        _mm256_storeu_ps( to + i, _mm256_i32gather_ps(table, index, 4) );
+    }
+    lutUint16ToFloatScalar(table, from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+lutFloatToUint8xxAVX2(const unsigned short* table,
+                      const float* from,
+                      unsigned short* to,
+                      int n)
+{
+    // A 32-bit gather would read 2 bytes past the end of the table for the last index: the indices are computed
+    // with SIMD instructions, but the table is read with scalar loads
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        int index[8];
+        _mm256_storeu_si256( (__m256i*)index, _mm256_srli_epi32(_mm256_castps_si256( _mm256_loadu_ps(from + i) ), 16) );
+        for (int k = 0; k < 8; ++k) {
+            to[i + k] = table[index[k]];
+        }
+    }
+    lutFloatToUint8xxScalar(table, from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+lutFloatToFloatAVX2(const float* table,
+                    float (*func)(float),
+                    const float* from,
+                    float* to,
+                    int n)
+{
+    // The two entries around each value are read with scalar loads: two gathers are slower on most CPUs
+    const __m256i minBits = _mm256_set1_epi32(NATRON_LUT_FLOAT_MIN_BITS);
+    const __m256i maxOffset = _mm256_set1_epi32(NATRON_LUT_FLOAT_MAX_BITS - NATRON_LUT_FLOAT_MIN_BITS - 1);
+    const __m256i fracMask = _mm256_set1_epi32( (1 << NATRON_LUT_FLOAT_INDEX_SHIFT) - 1 );
+    const __m256 fracScale = _mm256_set1_ps( 1.f / (1 << NATRON_LUT_FLOAT_INDEX_SHIFT) );
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i bits = _mm256_castps_si256( _mm256_loadu_ps(from + i) );
+        __m256i offset = _mm256_sub_epi32(bits, minBits);
+        // The values outside of the table wrap to large unsigned offsets
+        __m256i inTable = _mm256_cmpeq_epi32(_mm256_min_epu32(offset, maxOffset), offset);
+        if (_mm256_movemask_ps( _mm256_castsi256_ps(inTable) ) != 0xff) {
+            lutFloatToFloatScalar(table, func, from + i, to + i, 8);
+            continue;
+        }
+        int index[8];
+        _mm256_storeu_si256( (__m256i*)index, _mm256_srli_epi32(offset, NATRON_LUT_FLOAT_INDEX_SHIFT) );
+        __m256 lo = _mm256_setr_ps(table[index[0]], table[index[1]], table[index[2]], table[index[3]],
+                                   table[index[4]], table[index[5]], table[index[6]], table[index[7]]);
+        __m256 hi = _mm256_setr_ps(table[index[0] + 1], table[index[1] + 1], table[index[2] + 1], table[index[3] + 1],
+                                   table[index[4] + 1], table[index[5] + 1], table[index[6] + 1], table[index[7] + 1]);
+        __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps( _mm256_and_si256(bits, fracMask) ), fracScale);
+        _mm256_storeu_ps( to + i, _mm256_add_ps( lo, _mm256_mul_ps( frac, _mm256_sub_ps(hi, lo) ) ) );
+    }
+    lutFloatToFloatSSE41(table, func, from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 inline __m256
+viewerGammaLutAVX2(const float* lut,
+                   int lutSize,
+                   __m256 v)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    __m256 lt0 = _mm256_cmp_ps(v, zero, _CMP_LT_OQ);
+    __m256 gt1 = _mm256_cmp_ps(v, one, _CMP_NLE_UQ); // also NaN
+    __m256 scaled = _mm256_mul_ps( v, _mm256_set1_ps( (float)lutSize ) );
+    __m256i i = _mm256_andnot_si256( _mm256_castps_si256( _mm256_or_ps(lt0, gt1) ), _mm256_cvttps_epi32(scaled) );
+    __m256 alpha = _mm256_max_ps( _mm256_min_ps( one, _mm256_sub_ps( scaled, _mm256_cvtepi32_ps(i) ) ), zero );
+    // The next entry is only read below the last one
+    __m256 hasNext = _mm256_castsi256_ps( _mm256_cmpgt_epi32(_mm256_set1_epi32(lutSize), i) );
+    __m256 a = _mm256_i32gather_ps(lut, i, 4);
+    __m256 b = _mm256_mask_i32gather_ps(zero, lut + 1, i, hasNext, 4);
+    __m256 r = _mm256_add_ps( _mm256_mul_ps( a, _mm256_sub_ps(one, alpha) ), _mm256_mul_ps(b, alpha) );
+    r = _mm256_blendv_ps(r, one, gt1);
+
+    return _mm256_andnot_ps(lt0, r);
+}
+
+NATRON_TARGET_AVX2 inline __m256d
+viewerGammaZeroAVX2(__m256d v)
+{
+    const __m256d one = _mm256_set1_pd(1.);
+    __m256d r = _mm256_blendv_pd( _mm256_set1_pd( std::numeric_limits<double>::infinity() ), one, _mm256_cmp_pd(v, one, _CMP_EQ_OQ) );
+
+    return _mm256_andnot_pd(_mm256_cmp_pd(v, one, _CMP_LT_OQ), r);
+}
+
+NATRON_TARGET_AVX2 inline __m256d
+luminanceAVX2(__m256d r,
+              __m256d g,
+              __m256d b)
+{
+    __m256d y = _mm256_add_pd( _mm256_mul_pd(_mm256_set1_pd(0.299), r), _mm256_mul_pd(_mm256_set1_pd(0.587), g) );
+
+    return _mm256_add_pd( y, _mm256_mul_pd(_mm256_set1_pd(0.114), b) );
+}
+
+// 8 floats to 2 x 4 doubles, and back
+NATRON_TARGET_AVX2 inline void
+floatsToDoublesAVX2(__m256 v,
+                    __m256d* d)
+{
+    d[0] = _mm256_cvtps_pd( _mm256_castps256_ps128(v) );
+    d[1] = _mm256_cvtps_pd( _mm256_extractf128_ps(v, 1) );
+}
+
+NATRON_TARGET_AVX2 inline __m256
+doublesToFloatsAVX2(const __m256d* d)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256( _mm256_cvtpd_ps(d[0]) ), _mm256_cvtpd_ps(d[1]), 1);
+}
+
+NATRON_TARGET_AVX2 void
+rgbToLuminanceAVX2(const float* r,
+                   const float* g,
+                   const float* b,
+                   float* to,
+                   int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256d vr[2], vg[2], vb[2], y[2];
+        floatsToDoublesAVX2(_mm256_loadu_ps(r + i), vr);
+        floatsToDoublesAVX2(_mm256_loadu_ps(g + i), vg);
+        floatsToDoublesAVX2(_mm256_loadu_ps(b + i), vb);
+        y[0] = luminanceAVX2(vr[0], vg[0], vb[0]);
+        y[1] = luminanceAVX2(vr[1], vg[1], vb[1]);
+        _mm256_storeu_ps( to + i, doublesToFloatsAVX2(y) );
+    }
+    rgbToLuminanceSSE41(r + i, g + i, b + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+viewerGainAVX2(double gain,
+               double offset,
+               float* v,
+               int n)
+{
+    const __m256d g = _mm256_set1_pd(gain);
+    const __m256d o = _mm256_set1_pd(offset);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256d d[2];
+        floatsToDoublesAVX2(_mm256_loadu_ps(v + i), d);
+        d[0] = _mm256_add_pd(_mm256_mul_pd(d[0], g), o);
+        d[1] = _mm256_add_pd(_mm256_mul_pd(d[1], g), o);
+        _mm256_storeu_ps( v + i, doublesToFloatsAVX2(d) );
+    }
+    viewerGainSSE41(gain, offset, v + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+viewerGammaLutRowAVX2(const float* lut,
+                      int lutSize,
+                      float* v,
+                      int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps( v + i, viewerGammaLutAVX2(lut, lutSize, _mm256_loadu_ps(v + i)) );
+    }
+    viewerGammaLutRowSSE41(lut, lutSize, v + i, n - i);
+}
+
+// Without the gamma table, all the transform is computed in double precision in a single pass. With the table,
+// which is applied to the values rounded to float, the gain, the gamma and the luminance are separate passes.
+NATRON_TARGET_AVX2 void
+viewerTransformAVX2(const ViewerTransform& t,
+                    float* r,
+                    float* g,
+                    float* b,
+                    int n)
+{
+    if (!t.gammaZero && t.gammaLut) {
+        float* planes[3] = { r, g, b };
+        for (int c = 0; c < 3; ++c) {
+            viewerGainAVX2(t.gain, t.offset, planes[c], n);
+            viewerGammaLutRowAVX2(t.gammaLut, t.gammaLutSize, planes[c], n);
+        }
+        if (t.luminance) {
+            rgbToLuminanceAVX2(r, g, b, r, n);
+            std::copy(r, r + n, g);
+            std::copy(r, r + n, b);
+        }
+
+        return;
+    }
+
+    const __m256d gain = _mm256_set1_pd(t.gain);
+    const __m256d offset = _mm256_set1_pd(t.offset);
+    const bool gammaZero = t.gammaZero;
+    const bool luminance = t.luminance;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256d vr[2], vg[2], vb[2];
+        floatsToDoublesAVX2(_mm256_loadu_ps(r + i), vr);
+        floatsToDoublesAVX2(_mm256_loadu_ps(g + i), vg);
+        floatsToDoublesAVX2(_mm256_loadu_ps(b + i), vb);
+        for (int k = 0; k < 2; ++k) {
+            vr[k] = _mm256_add_pd(_mm256_mul_pd(vr[k], gain), offset);
+            vg[k] = _mm256_add_pd(_mm256_mul_pd(vg[k], gain), offset);
+            vb[k] = _mm256_add_pd(_mm256_mul_pd(vb[k], gain), offset);
+            if (gammaZero) {
+                vr[k] = viewerGammaZeroAVX2(vr[k]);
+                vg[k] = viewerGammaZeroAVX2(vg[k]);
+                vb[k] = viewerGammaZeroAVX2(vb[k]);
+            }
+            if (luminance) {
+                vr[k] = vg[k] = vb[k] = luminanceAVX2(vr[k], vg[k], vb[k]);
+            }
+        }
+        _mm256_storeu_ps( r + i, doublesToFloatsAVX2(vr) );
+        _mm256_storeu_ps( g + i, doublesToFloatsAVX2(vg) );
+        _mm256_storeu_ps( b + i, doublesToFloatsAVX2(vb) );
+    }
+    viewerTransformSSE41(t, r + i, g + i, b + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+halveRowsFloatAVX2(const float* row0,
+                   const float* row1,
+                   float* to,
+                   int nPixels,
+                   int nComps)
+{
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    int i = 0;
+
+    if (nComps == 4) {
+        // Two pixels per register: gather the left and right source pixels of 2 destination pixels
+        for (; i + 2 <= nPixels; i += 2) {
+            __m256 a0 = _mm256_loadu_ps(row0 + 8 * i);
+            __m256 a1 = _mm256_loadu_ps(row0 + 8 * i + 8);
+            __m256 b0 = _mm256_loadu_ps(row1 + 8 * i);
+            __m256 b1 = _mm256_loadu_ps(row1 + 8 * i + 8);
+            __m256 s = _mm256_add_ps( _mm256_permute2f128_ps(a0, a1, 0x20), _mm256_permute2f128_ps(a0, a1, 0x31) );
+            s = _mm256_add_ps( s, _mm256_permute2f128_ps(b0, b1, 0x20) );
+            s = _mm256_add_ps( s, _mm256_permute2f128_ps(b0, b1, 0x31) );
+            _mm256_storeu_ps( to + 4 * i, _mm256_mul_ps(s, quarter) );
+        }
+    } else if (nComps == 1) {
+        // The shuffles work within 128-bit lanes: the sums are computed with the pairs of destination pixels
+        // in the order 0 2 1 3, which is restored before storing
+        for (; i + 8 <= nPixels; i += 8) {
+            __m256 a0 = _mm256_loadu_ps(row0 + 2 * i);
+            __m256 a1 = _mm256_loadu_ps(row0 + 2 * i + 8);
+            __m256 b0 = _mm256_loadu_ps(row1 + 2 * i);
+            __m256 b1 = _mm256_loadu_ps(row1 + 2 * i + 8);
+            __m256 s = _mm256_add_ps( _mm256_shuffle_ps( a0, a1, _MM_SHUFFLE(2, 0, 2, 0) ), _mm256_shuffle_ps( a0, a1, _MM_SHUFFLE(3, 1, 3, 1) ) );
+            s = _mm256_add_ps( s, _mm256_shuffle_ps( b0, b1, _MM_SHUFFLE(2, 0, 2, 0) ) );
+            s = _mm256_add_ps( s, _mm256_shuffle_ps( b0, b1, _MM_SHUFFLE(3, 1, 3, 1) ) );
+            s = _mm256_castpd_ps( _mm256_permute4x64_pd( _mm256_castps_pd(s), _MM_SHUFFLE(3, 1, 2, 0) ) );
+            _mm256_storeu_ps( to + i, _mm256_mul_ps(s, quarter) );
+        }
+    }
+    halveRowsFloatSSE41(row0 + 2 * nComps * i, row1 + 2 * nComps * i, to + nComps * i, nPixels - i, nComps);
+}
+
+// Same as floatToHalfSSE41
+NATRON_TARGET_AVX2 inline __m256i
+floatToHalfAVX2(__m256 v)
+{
+    __m256i x = _mm256_castps_si256(v);
+    const __m256i sign = _mm256_and_si256( x, _mm256_set1_epi32( (int)0x80000000U ) );
+
+    x = _mm256_xor_si256(x, sign);
+    const __m256i infNaN = _mm256_or_si256( _mm256_set1_epi32(0x7c00), _mm256_and_si256( _mm256_cmpgt_epi32( x, _mm256_set1_epi32(0x7f800000) ), _mm256_set1_epi32(0x200) ) );
+    const __m256i half = _mm256_set1_epi32(126 << 23);
+    const __m256i denormal = _mm256_sub_epi32( _mm256_castps_si256( _mm256_add_ps( _mm256_castsi256_ps(x), _mm256_castsi256_ps(half) ) ), half );
+    const __m256i odd = _mm256_and_si256( _mm256_srli_epi32(x, 13), _mm256_set1_epi32(1) );
+    const __m256i normal = _mm256_srli_epi32( _mm256_add_epi32( _mm256_add_epi32( x, _mm256_set1_epi32( (int)( ( (unsigned int)(15 - 127) << 23 ) + 0xfffU ) ) ), odd ), 13 );
+    __m256i h = _mm256_blendv_epi8( normal, denormal, _mm256_cmpgt_epi32(_mm256_set1_epi32(0x38800000), x) );
+
+    h = _mm256_blendv_epi8( h, infNaN, _mm256_cmpgt_epi32( x, _mm256_set1_epi32(0x477fffff) ) );
+
+    return _mm256_or_si256( h, _mm256_srli_epi32(sign, 16) );
+}
+
+// Same as halfToFloatSSE41
+NATRON_TARGET_AVX2 inline __m256
+halfToFloatAVX2(__m256i h)
+{
+    const __m256i shiftedExponent = _mm256_set1_epi32(0x7c00 << 13);
+    __m256i x = _mm256_slli_epi32( _mm256_and_si256( h, _mm256_set1_epi32(0x7fff) ), 13 );
+    const __m256i exponent = _mm256_and_si256(x, shiftedExponent);
+
+    x = _mm256_add_epi32( x, _mm256_set1_epi32( (127 - 15) << 23 ) );
+    x = _mm256_add_epi32( x, _mm256_and_si256( _mm256_cmpeq_epi32(exponent, shiftedExponent), _mm256_set1_epi32( (128 - 16) << 23 ) ) );
+    const __m256i denormal = _mm256_castps_si256( _mm256_sub_ps( _mm256_castsi256_ps( _mm256_add_epi32( x, _mm256_set1_epi32(1 << 23) ) ), _mm256_castsi256_ps( _mm256_set1_epi32(113 << 23) ) ) );
+    x = _mm256_blendv_epi8( x, denormal, _mm256_cmpeq_epi32( exponent, _mm256_setzero_si256() ) );
+
+    return _mm256_castsi256_ps( _mm256_or_si256( x, _mm256_slli_epi32( _mm256_and_si256( h, _mm256_set1_epi32(0x8000) ), 16 ) ) );
+}
+
+NATRON_TARGET_AVX2 void
+floatToHalfAVX2(const float* from,
+                unsigned short* to,
+                int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128( (__m128i*)(to + i), packUint16AVX2( floatToHalfAVX2( _mm256_loadu_ps(from + i) ) ) );
+    }
+    floatToHalfScalar(from + i, to + i, n - i);
+}
+
+NATRON_TARGET_AVX2 void
+halfToFloatAVX2(const unsigned short* from,
+                float* to,
+                int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps( to + i, halfToFloatAVX2( _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(from + i) ) ) ) );
+    }
+    halfToFloatScalar(from + i, to + i, n - i);
+}
+
+const Kernels avx2Kernels = {
+    byteToFloatAVX2,
+    shortToFloatAVX2,
+    floatToByteAVX2,
+    floatToShortAVX2,
+    floatToUint8xxAVX2,
+    lutUint8ToFloatAVX2,
+    lutUint16ToFloatAVX2,
+    lutFloatToUint8xxAVX2,
+    lutFloatToFloatAVX2,
+    viewerTransformAVX2,
+    rgbToLuminanceAVX2,
+    // The prefix sums and the shuffles of bytes work within 128-bit lanes
+    rgbaToPlanesSSE41,
+    diffuseErrorUint8xxSSE41,
+    planesToBGRASSE41,
+    // Shuffling pixels of 3 floats does not benefit from 256-bit registers
+    rgbaToRgbSSE41,
+    rgbToRgbaSSE41,
+    halveRowsFloatAVX2,
+    floatToHalfAVX2,
+    halfToFloatAVX2
+};
+
+#endif // NATRON_IMAGECONVERT_SIMD
+
+InstructionSetEnum
+detectInstructionSet()
+{
+#ifdef NATRON_IMAGECONVERT_SIMD
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) {
+        return eInstructionSetAVX2;
+    }
+    if ( __builtin_cpu_supports("sse4.1") ) {
+        return eInstructionSetSSE41;
+    }
+#endif
+
+    return eInstructionSetScalar;
+}
+
+const Kernels*
+getKernels(InstructionSetEnum set)
+{
+    switch (set) {
+#ifdef NATRON_IMAGECONVERT_SIMD
+    case eInstructionSetAVX2:
+
+        return &avx2Kernels;
+    case eInstructionSetSSE41:
+
+        return &sse41Kernels;
+#endif
+    default:
+
+        return &scalarKernels;
+    }
+}
+
+struct DispatchState
+{
+    InstructionSetEnum supported;
+    InstructionSetEnum current;
+    const Kernels* kernels;
+
+    DispatchState()
+        : supported( detectInstructionSet() )
+        , current(supported)
+        , kernels( getKernels(supported) )
+    {
+    }
+};
+
+DispatchState&
+getDispatchState()
+{
+    // Initialized on first use, so that the kernels may be used during static initialization
+    static DispatchState state;
+
+    return state;
+}
+
+inline const Kernels&
+kernels()
+{
+    return *getDispatchState().kernels;
+}
+} // anon namespace
+
+InstructionSetEnum
+getSupportedInstructionSet()
+{
+    return getDispatchState().supported;
+}
+
+InstructionSetEnum
+getInstructionSet()
+{
+    return getDispatchState().current;
+}
+
+void
+setInstructionSet(InstructionSetEnum set)
+{
+    DispatchState& state = getDispatchState();
+
+    if (set > state.supported) {
+        set = state.supported;
+    }
+    state.current = set;
+    state.kernels = getKernels(set);
+}
+
+void
+byteToFloat(const unsigned char* from,
+            float* to,
+            int n)
+{
+    kernels().byteToFloat(from, to, n);
+}
+
+void
+shortToFloat(const unsigned short* from,
+             float* to,
+             int n)
+{
+    kernels().shortToFloat(from, to, n);
+}
+
+void
+floatToByte(const float* from,
+            unsigned char* to,
+            int n)
+{
+    kernels().floatToByte(from, to, n);
+}
+
+void
+floatToShort(const float* from,
+             unsigned short* to,
+             int n)
+{
+    kernels().floatToShort(from, to, n);
+}
+
+void
+floatToUint8xx(const float* from,
+               unsigned short* to,
+               int n)
+{
+    kernels().floatToUint8xx(from, to, n);
+}
+
+void
+lutUint8ToFloat(const float* table,
+                const unsigned char* from,
+                float* to,
+                int n)
+{
+    kernels().lutUint8ToFloat(table, from, to, n);
+}
+
+void
+lutUint16ToFloat(const float* table,
+                 const unsigned short* from,
+                 float* to,
+                 int n)
+{
+    kernels().lutUint16ToFloat(table, from, to, n);
+}
+
+void
+lutFloatToUint8xx(const unsigned short* table,
+                  const float* from,
+                  unsigned short* to,
+                  int n)
+{
+    kernels().lutFloatToUint8xx(table, from, to, n);
+}
+
+void
+lutFloatToFloat(const float* table,
+                float (*func)(float),
+                const float* from,
+                float* to,
+                int n)
+{
+    kernels().lutFloatToFloat(table, func, from, to, n);
+}
+
+void
+viewerTransform(const ViewerTransform& t,
+                float* r,
+                float* g,
+                float* b,
+                int n)
+{
+    kernels().viewerTransform(t, r, g, b, n);
+}
+
+void
+rgbToLuminance(const float* r,
+               const float* g,
+               const float* b,
+               float* to,
+               int n)
+{
+    kernels().rgbToLuminance(r, g, b, to, n);
+}
+
+void
+rgbaToPlanes(const float* from,
+             float* c0,
+             float* c1,
+             float* c2,
+             float* c3,
+             int nPixels)
+{
+    kernels().rgbaToPlanes(from, c0, c1, c2, c3, nPixels);
+}
+
+void
+diffuseErrorUint8xx(const unsigned short* from,
+                    unsigned char* to,
+                    int n,
+                    bool backward)
+{
+    kernels().diffuseErrorUint8xx(from, to, n, backward);
+}
+
+void
+planesToBGRA(const unsigned char* r,
+             const unsigned char* g,
+             const unsigned char* b,
+             const unsigned char* a,
+             unsigned int* to,
+             int n)
+{
+    kernels().planesToBGRA(r, g, b, a, to, n);
+}
+
+void
+rgbaToRgb(const float* from,
+          float* to,
+          int nPixels,
+          bool unpremult)
+{
+    kernels().rgbaToRgb(from, to, nPixels, unpremult);
+}
+
+void
+rgbToRgba(const float* from,
+          float* to,
+          int nPixels,
+          float alpha)
+{
+    kernels().rgbToRgba(from, to, nPixels, alpha);
+}
+
+void
+halveRowsFloat(const float* row0,
+               const float* row1,
+               float* to,
+               int nPixels,
+               int nComps)
+{
+    kernels().halveRowsFloat(row0, row1, to, nPixels, nComps);
+}
+
+void
+floatToHalf(const float* from,
+            unsigned short* to,
+            int n)
+{
+    kernels().floatToHalf(from, to, n);
+}
+
+void
+halfToFloat(const unsigned short* from,
+            float* to,
+            int n)
+{
+    kernels().halfToFloat(from, to, n);
+}
+} // namespace ImageConvertSIMD
+
+NATRON_NAMESPACE_EXIT
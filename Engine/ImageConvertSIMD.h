@@ -0,0 +1,214 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_IMAGECONVERTSIMD_H
+#define NATRON_ENGINE_IMAGECONVERTSIMD_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include "Engine/EngineFwd.h"
+
+// The SIMD kernels are compiled with per-function target attributes, so that the rest of the application
+// does not need to be built for a specific instruction set: they are selected at runtime depending on the CPU.
+// 32-bit x86 is excluded because its scalar float code may run on the x87 unit, with a different rounding.
+#if defined(__x86_64__) && \
+    ( defined(__clang__) || ( defined(__GNUC__) && ( (__GNUC__ > 4) || ( (__GNUC__ == 4) && (__GNUC_MINOR__ >= 9) ) ) ) )
+#define NATRON_IMAGECONVERT_SIMD
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Row kernels used by Image::convertToFormat and the Lut to convert pixel depths and color-spaces,
+ * by Image::buildMipMapLevel to downscale images, and by the viewer to compute its textures.
+ * Each kernel converts n contiguous values and gives exactly the same result as the scalar functions it replaces
+ * (Image::convertPixelDepth, Color::floatToInt, Color::intToFloat, the Lut fast functions and the box filter of
+ * the mipmaps): divisions are not replaced by multiplications with the reciprocal (except by powers of 2) and no
+ * multiply-add is fused.
+ * The best instruction set supported by the CPU is selected the first time it is needed.
+ **/
+namespace ImageConvertSIMD {
+/*
+ * The float to float tables of the Lut are indexed like half floats, by the exponent and the 10 upper bits of the
+ * mantissa of the value, for values in [2^-14, 2^16). The function is linearly interpolated between two entries
+ * using the 13 lower bits of the mantissa. Other values (negative, very small or very large) use the function itself.
+ */
+#define NATRON_LUT_FLOAT_MIN_BITS 0x38800000U // 2^-14
+#define NATRON_LUT_FLOAT_MAX_BITS 0x47800000U // 2^16
+#define NATRON_LUT_FLOAT_INDEX_SHIFT 13
+#define NATRON_LUT_FLOAT_TABLE_SIZE ( ( (NATRON_LUT_FLOAT_MAX_BITS - NATRON_LUT_FLOAT_MIN_BITS) >> NATRON_LUT_FLOAT_INDEX_SHIFT ) + 1 )
+
+/// Returns the value of the float at index i in a float to float table
+inline float
+lutFloatIndexToFloat(unsigned int i)
+{
+    union
+    {
+        unsigned int i;
+        float f;
+    }
+
+    tmp;
+
+    tmp.i = NATRON_LUT_FLOAT_MIN_BITS + (i << NATRON_LUT_FLOAT_INDEX_SHIFT);
+
+    return tmp.f;
+}
+
+/// Evaluates func(v) using a table of NATRON_LUT_FLOAT_TABLE_SIZE entries filled with func(lutFloatIndexToFloat(i))
+inline float
+lutFloatToFloatPixel(const float* table,
+                     float (*func)(float),
+                     float v)
+{
+    union
+    {
+        float f;
+        unsigned int i;
+    }
+
+    tmp;
+
+    tmp.f = v;
+    if ( (tmp.i < NATRON_LUT_FLOAT_MIN_BITS) || (tmp.i >= NATRON_LUT_FLOAT_MAX_BITS) ) {
+        return func(v);
+    }
+    const unsigned int i = (tmp.i - NATRON_LUT_FLOAT_MIN_BITS) >> NATRON_LUT_FLOAT_INDEX_SHIFT;
+    const float frac = (tmp.i & ( (1U << NATRON_LUT_FLOAT_INDEX_SHIFT) - 1 )) * ( 1.f / (1U << NATRON_LUT_FLOAT_INDEX_SHIFT) );
+
+    return table[i] + frac * (table[i + 1] - table[i]);
+}
+
+/**
+ * @brief The display transform of the viewer, applied to linear RGB values before they are converted to the
+ * color-space of the viewer (see scaleToTexture8bits_generic in ViewerInstance.cpp).
+ **/
+struct ViewerTransform
+{
+    double gain;
+    double offset;
+
+    // A gamma <= 0 gives 0 below 1, 1 at 1 and infinity above 1
+    bool gammaZero;
+
+    // If not NULL and gammaZero is false, the table of the gamma used by ViewerInstance::interpolateGammaLut,
+    // with gammaLutSize + 1 entries
+    const float* gammaLut;
+    int gammaLutSize;
+
+    // The three channels are replaced by the luminance
+    bool luminance;
+};
+
+enum InstructionSetEnum
+{
+    eInstructionSetScalar = 0, //< the per-pixel code in ImageConvert.cpp is used
+    eInstructionSetSSE41,
+    eInstructionSetAVX2
+};
+
+/**
+ * @brief Returns the best instruction set supported by the CPU and by this build.
+ **/
+InstructionSetEnum getSupportedInstructionSet();
+
+/**
+ * @brief Returns the instruction set currently used by the kernels.
+ **/
+InstructionSetEnum getInstructionSet();
+
+/**
+ * @brief Selects the instruction set used by the kernels. It is clamped to getSupportedInstructionSet().
+ * eInstructionSetScalar makes Image::convertToFormat and the viewer use their per-pixel code: this is used to compare both.
+ * This is not MT-safe and should not be called while images are converted.
+ **/
+void setInstructionSet(InstructionSetEnum set);
+
+/// to[i] = Color::intToFloat<256>(from[i])
+void byteToFloat(const unsigned char* from, float* to, int n);
+
+/// to[i] = Color::intToFloat<65536>(from[i])
+void shortToFloat(const unsigned short* from, float* to, int n);
+
+/// to[i] = Color::floatToInt<256>(from[i])
+void floatToByte(const float* from, unsigned char* to, int n);
+
+/// to[i] = Color::floatToInt<65536>(from[i])
+void floatToShort(const float* from, unsigned short* to, int n);
+
+/// to[i] = Color::floatToInt<0xff01>(from[i]), the input of the error diffusion when converting to bytes
+void floatToUint8xx(const float* from, unsigned short* to, int n);
+
+/// Same as Lut::fromColorSpaceUint8ToLinearFloatFast, table has 256 entries
+void lutUint8ToFloat(const float* table, const unsigned char* from, float* to, int n);
+
+/// Same as Lut::fromColorSpaceUint16ToLinearFloatFast, table has 0x10000 entries
+void lutUint16ToFloat(const float* table, const unsigned short* from, float* to, int n);
+
+/// Same as Lut::toColorSpaceUint8xxFromLinearFloatFast, table has 0x10000 entries indexed by the high 16 bits of the float
+void lutFloatToUint8xx(const unsigned short* table, const float* from, unsigned short* to, int n);
+
+/// Same as lutFloatToFloatPixel for n contiguous values
+void lutFloatToFloat(const float* table, float (*func)(float), const float* from, float* to, int n);
+
+/// Applies t to n pixels stored in 3 planes: v * gain + offset, then the gamma, then the luminance, in double precision
+/// like the per-pixel code of the viewer, and rounds the result to float
+void viewerTransform(const ViewerTransform& t, float* r, float* g, float* b, int n);
+
+/// to[i] = 0.299 * r[i] + 0.587 * g[i] + 0.114 * b[i] in double precision, rounded to float. to may be r, g or b.
+void rgbToLuminance(const float* r, const float* g, const float* b, float* to, int n);
+
+/// Splits nPixels pixels of 4 floats in 4 planes
+void rgbaToPlanes(const float* from, float* c0, float* c1, float* c2, float* c3, int nPixels);
+
+/// Error diffusion of n values of the uint8xx range (see Color::Lut::toColorSpaceUint8xxFromLinearFloatFast) to bytes,
+/// like the per-pixel code: the error starts at 0x80, then error = (error & 0xff) + from[i] and to[i] = error >> 8.
+/// If backward is true, the values are processed from the last one to the first one.
+void diffuseErrorUint8xx(const unsigned short* from, unsigned char* to, int n, bool backward);
+
+/// to[i] = (a[i] << 24) | (r[i] << 16) | (g[i] << 8) | b[i], the pixels of the 8-bit textures of the viewer
+void planesToBGRA(const unsigned char* r, const unsigned char* g, const unsigned char* b, const unsigned char* a, unsigned int* to, int n);
+
+/// Drops the alpha channel of nPixels RGBA pixels. If unpremult is true, the RGB channels are divided by alpha,
+/// and set to 0 where alpha is 0.
+void rgbaToRgb(const float* from, float* to, int nPixels, bool unpremult);
+
+/// Adds an alpha channel of value alpha to nPixels RGB pixels
+void rgbToRgba(const float* from, float* to, int nPixels, float alpha);
+
+/// 2x2 box filter of two rows of pixels with nComps floats, to nPixels pixels:
+/// to[x] = (((row0[2x] + row0[2x+1]) + row1[2x]) + row1[2x+1]) / 4, for each component
+void halveRowsFloat(const float* row0, const float* row1, float* to, int nPixels, int nComps);
+
+/// to[i] = from[i] rounded to the nearest half float (IEEE 754 binary16), ties to even, as the bits of the half.
+/// Values beyond the largest half give infinity, NaNs give the quiet NaN 0x7e00.
+void floatToHalf(const float* from, unsigned short* to, int n);
+
+/// to[i] = the half float of bits from[i], which is exact
+void halfToFloat(const unsigned short* from, float* to, int n);
+} // namespace ImageConvertSIMD
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_IMAGECONVERTSIMD_H
@@ -44,6 +44,7 @@
 #include "Engine/Curve.h"
 #include "Engine/DockablePanelI.h"
 #include "Engine/Hash64.h"
+#include "Engine/KnobExpression.h"
 #include "Engine/KnobFile.h"
 #include "Engine/KnobGuiI.h"
 #include "Engine/KnobSerialization.h"
@@ -225,10 +226,13 @@ struct Expr
     ///The list of pair<knob, dimension> dpendencies for an expression
     std::list<std::pair<KnobIWPtr, int> > dependencies;
 
+    ///The expression compiled to a native program, if it is simple enough
+    KnobExpressionPtr native;
+
     //PyObject* code;
 
     Expr()
-        : expression(), originalExpression(), exprInvalid(), hasRet(false) /*, code(0)*/ {}
+        : expression(), originalExpression(), exprInvalid(), hasRet(false), native() /*, code(0)*/ {}
 };
 
 struct KnobHelperPrivate
@@ -2665,10 +2669,17 @@ KnobHelper::setExpressionInternal(int dimension,
         }
     }
 
+    // Single-line expressions may be evaluated without Python
+    KnobExpressionPtr native;
+    if ( exprInvalid.empty() && !hasRetVariable ) {
+        native = KnobExpression::compile(this, dimension, expression);
+    }
+
     //Set internal fields
 
     {
         QMutexLocker k(&_imp->expressionMutex);
+        _imp->expressions[dimension].native = native;
         _imp->expressions[dimension].hasRet = hasRetVariable;
         _imp->expressions[dimension].expression = exprCpy;
         _imp->expressions[dimension].originalExpression = expression;
@@ -2765,6 +2776,7 @@ KnobHelper::clearExpression(int dimension,
         _imp->expressions[dimension].expression.clear();
         _imp->expressions[dimension].originalExpression.clear();
         _imp->expressions[dimension].exprInvalid.clear();
+        _imp->expressions[dimension].native.reset();
         //Py_XDECREF(_imp->expressions[dimension].code); //< new ref
         //_imp->expressions[dimension].code = 0;
     }
@@ -2935,6 +2947,14 @@ KnobHelper::executeExpression(const std::string& expr,
     return true;
 }
 
+KnobExpressionPtr
+KnobHelper::getNativeExpression(int dimension) const
+{
+    QMutexLocker k(&_imp->expressionMutex);
+
+    return _imp->expressions[dimension].native;
+}
+
 std::string
 KnobHelper::getExpression(int dimension) const
 {
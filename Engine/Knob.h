@@ -1588,6 +1588,12 @@ protected:
     ///The return value must be Py_DECRREF
     bool executeExpression(double time, ViewIdx view, int dimension, PyObject** ret, std::string* error) const;
 
+    /**
+     * @brief Returns the expression of the given dimension compiled to a native program, or NULL if it is not
+     * in the subset supported by KnobExpression: it must then be evaluated by Python.
+     **/
+    KnobExpressionPtr getNativeExpression(int dimension) const;
+
 public:
 
     /// The return value must be Py_DECRREF
@@ -2112,6 +2118,7 @@ private:
         QMutexLocker k(&_valueMutex);
 
         _exprRes[dimension].clear();
+        ++_exprResAge[dimension];
     }
 
 
@@ -2134,6 +2141,25 @@ private:
 
     bool getValueFromExpression_pod(double time, ViewIdx view, int dimension, bool clamp, double* ret);
 
+    /**
+     * @brief Evaluates the expression of the given dimension without Python if it was compiled to a native program.
+     * Returns false if it must be evaluated by Python.
+     **/
+    bool evaluateNativeExpression(double time, ViewIdx view, int dimension, double* ret);
+
+    /**
+     * @brief Returns true if the result of the expression of the given dimension at the given time is in _exprRes.
+     * In any case, age is set to the current age of the results of this dimension, to be passed
+     * to cacheExpressionResult().
+     **/
+    bool getCachedExpressionResult(double time, int dimension, bool clamp, T* ret, U64* age) const;
+
+    /**
+     * @brief Stores the (unclamped) result of an expression, unless the results of this dimension were cleared
+     * since getCachedExpressionResult() returned age: the value may then be outdated.
+     **/
+    void cacheExpressionResult(double time, int dimension, const T& value, U64 age);
+
     //////////////////////////////////////////////////////////////////////
     /////////////////////////////////// End implementation of KnobI
     //////////////////////////////////////////////////////////////////////
@@ -2211,6 +2237,9 @@ private:
     };
     std::vector<DefaultValue> _defaultValues;
     mutable ExprResults _exprRes;
+    // Incremented each time the results of a dimension are cleared, so that an expression evaluated
+    // during a change does not put its result back in the cache
+    std::vector<U64> _exprResAge;
 
     //Only for double and int
     mutable QReadWriteLock _minMaxMutex;
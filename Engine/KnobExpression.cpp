@@ -0,0 +1,2083 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "KnobExpression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <boost/math/special_functions/fpclassify.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#endif
+
+#include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/Knob.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+#include "Engine/PyExprUtils.h"
+
+// Integers are held in doubles: all the integers up to 2^53 are exactly represented. Beyond that, Python would
+// promote them to long integers, so the evaluation fails and is left to Python.
+#define NATRON_KNOB_EXPRESSION_MAX_INT 9007199254740992. // 2^53
+
+// Maximum depth of the evaluation stack, and of the nested parenthesis when parsing
+#define NATRON_KNOB_EXPRESSION_MAX_STACK 64
+#define NATRON_KNOB_EXPRESSION_MAX_NESTING 64
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/// A Python number: an int (or bool) or a float. Values on the evaluation stack are always finite.
+struct Value
+{
+    double v;
+    bool isInt;
+};
+
+inline Value
+makeValue(double v,
+          bool isInt)
+{
+    Value ret;
+
+    ret.v = v;
+    ret.isInt = isInt;
+
+    return ret;
+}
+
+inline bool
+isFinite(double v)
+{
+    return (boost::math::isfinite)(v);
+}
+
+inline bool
+isTrue(const Value& v)
+{
+    return v.v != 0.;
+}
+
+/// Sets ret to the int v. Returns false if it would not be exactly represented.
+inline bool
+setInt(double v,
+       Value* ret)
+{
+    if ( !( std::fabs(v) <= NATRON_KNOB_EXPRESSION_MAX_INT ) ) {
+        return false;
+    }
+    ret->v = v + 0.; // no negative zero
+    ret->isInt = true;
+
+    return true;
+}
+
+/// Sets ret to the float v. Returns false if v is not finite: Python would either raise an exception or
+/// propagate an inf or a nan, which is left to Python.
+inline bool
+setFloat(double v,
+         Value* ret)
+{
+    if ( !isFinite(v) ) {
+        return false;
+    }
+    ret->v = v;
+    ret->isInt = false;
+
+    return true;
+}
+
+enum OpEnum
+{
+    eOpPushConstant = 0, //< pushes value
+    eOpPushFrame, //< pushes the frame argument of the expression
+    eOpPushView, //< pushes the view argument of the expression
+    eOpPop,
+    eOpNegate,
+    eOpPositive,
+    eOpNot,
+    eOpAdd,
+    eOpSubtract,
+    eOpMultiply,
+    eOpDivide,
+    eOpFloorDivide,
+    eOpModulo,
+    eOpPower,
+    eOpLess,
+    eOpLessEqual,
+    eOpGreater,
+    eOpGreaterEqual,
+    eOpEqual,
+    eOpNotEqual,
+    eOpJump, //< pc += arg
+    eOpJumpIfFalse, //< pops the condition, jumps if it is false
+    eOpJumpIfFalseOrPop, //< jumps if the top is false and keeps it, pops it otherwise ("and")
+    eOpJumpIfTrueOrPop, //< jumps if the top is true and keeps it, pops it otherwise ("or")
+    eOpCallFunction, //< calls the function arg with nArgs arguments
+    eOpGetValue, //< pops dimension, pushes the value of the knob arg
+    eOpGetValueAtTime, //< pops time and dimension, pushes the value of the knob arg
+    eOpGetCurveValue //< pops time and dimension, pushes the value of the animation curve of the knob arg
+};
+
+enum FunctionEnum
+{
+    // math module
+    eFunctionSin = 0,
+    eFunctionCos,
+    eFunctionTan,
+    eFunctionAsin,
+    eFunctionAcos,
+    eFunctionAtan,
+    eFunctionAtan2,
+    eFunctionSinh,
+    eFunctionCosh,
+    eFunctionTanh,
+    eFunctionExp,
+    eFunctionLog,
+    eFunctionLog10,
+    eFunctionSqrt,
+    eFunctionPow,
+    eFunctionFabs,
+    eFunctionFloor,
+    eFunctionCeil,
+    eFunctionFmod,
+    eFunctionHypot,
+    eFunctionDegrees,
+    eFunctionRadians,
+
+    // builtins
+    eFunctionAbs,
+    eFunctionMin,
+    eFunctionMax,
+    eFunctionInt,
+    eFunctionFloat,
+    eFunctionRound,
+
+    // ExprUtils
+    eFunctionBoxstep,
+    eFunctionLinearstep,
+    eFunctionSmoothstep,
+    eFunctionGaussstep,
+    eFunctionRemap,
+    eFunctionMix,
+    eFunctionNoise
+};
+
+struct FunctionDef
+{
+    const char* name;
+    FunctionEnum function;
+    int minArgs;
+    int maxArgs;
+};
+
+const FunctionDef mathFunctions[] = {
+    { "sin", eFunctionSin, 1, 1 },
+    { "cos", eFunctionCos, 1, 1 },
+    { "tan", eFunctionTan, 1, 1 },
+    { "asin", eFunctionAsin, 1, 1 },
+    { "acos", eFunctionAcos, 1, 1 },
+    { "atan", eFunctionAtan, 1, 1 },
+    { "atan2", eFunctionAtan2, 2, 2 },
+    { "sinh", eFunctionSinh, 1, 1 },
+    { "cosh", eFunctionCosh, 1, 1 },
+    { "tanh", eFunctionTanh, 1, 1 },
+    { "exp", eFunctionExp, 1, 1 },
+    { "log", eFunctionLog, 1, 2 },
+    { "log10", eFunctionLog10, 1, 1 },
+    { "sqrt", eFunctionSqrt, 1, 1 },
+    { "pow", eFunctionPow, 2, 2 },
+    { "fabs", eFunctionFabs, 1, 1 },
+    { "floor", eFunctionFloor, 1, 1 },
+    { "ceil", eFunctionCeil, 1, 1 },
+    { "fmod", eFunctionFmod, 2, 2 },
+    { "hypot", eFunctionHypot, 2, 2 },
+    { "degrees", eFunctionDegrees, 1, 1 },
+    { "radians", eFunctionRadians, 1, 1 },
+    { 0, eFunctionSin, 0, 0 }
+};
+
+const FunctionDef builtinFunctions[] = {
+    { "abs", eFunctionAbs, 1, 1 },
+    { "min", eFunctionMin, 2, NATRON_KNOB_EXPRESSION_MAX_STACK },
+    { "max", eFunctionMax, 2, NATRON_KNOB_EXPRESSION_MAX_STACK },
+    { "int", eFunctionInt, 1, 1 },
+    { "float", eFunctionFloat, 1, 1 },
+    { "round", eFunctionRound, 1, 1 },
+    { 0, eFunctionAbs, 0, 0 }
+};
+
+const FunctionDef exprUtilsFunctions[] = {
+    { "boxstep", eFunctionBoxstep, 2, 2 },
+    { "linearstep", eFunctionLinearstep, 3, 3 },
+    { "smoothstep", eFunctionSmoothstep, 3, 3 },
+    { "gaussstep", eFunctionGaussstep, 3, 3 },
+    { "remap", eFunctionRemap, 5, 5 },
+    { "mix", eFunctionMix, 3, 3 },
+    { "noise", eFunctionNoise, 1, 1 },
+    { 0, eFunctionBoxstep, 0, 0 }
+};
+
+const FunctionDef*
+findFunction(const FunctionDef* table,
+             const std::string& name)
+{
+    for (; table->name; ++table) {
+        if (name == table->name) {
+            return table;
+        }
+    }
+
+    return 0;
+}
+
+struct Instruction
+{
+    OpEnum op;
+    int arg;
+    int nArgs;
+    Value value;
+};
+
+typedef std::vector<Instruction> Code;
+
+enum KnobTypeEnum
+{
+    eKnobTypeInt = 0,
+    eKnobTypeDouble,
+    eKnobTypeBool
+};
+
+/// A knob read by the expression
+struct KnobRef
+{
+    KnobTypeEnum type;
+    KnobIntBaseWPtr intKnob;
+    KnobDoubleBaseWPtr doubleKnob;
+    KnobBoolBaseWPtr boolKnob;
+    NodeWPtr node;
+    int nDims;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+struct KnobExpressionPrivate
+{
+    Code code;
+    std::vector<KnobRef> knobs;
+    KnobTypeEnum resultType;
+
+    KnobExpressionPrivate()
+        : code()
+        , knobs()
+        , resultType(eKnobTypeDouble)
+    {
+    }
+
+    bool readKnob(OpEnum op, const KnobRef& knob, const Value& time, const Value& dimension, Value* ret) const;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+bool nativeExpressionsEnabled = true;
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Evaluation
+
+/// Floored division and modulo of floats, as done by Python (float_divmod)
+void
+floatDivMod(double x,
+            double y,
+            double* floorDiv,
+            double* mod)
+{
+    assert(y != 0.);
+    double m = std::fmod(x, y);
+    double div = (x - m) / y;
+    if (m != 0.) {
+        if ( (y < 0.) != (m < 0.) ) {
+            m += y;
+            div -= 1.;
+        }
+    } else {
+        // the remainder has the sign of the divisor
+        m = (y < 0.) ? -0. : 0.;
+    }
+    double floorDivValue;
+    if (div != 0.) {
+        floorDivValue = std::floor(div);
+        if (div - floorDivValue > 0.5) {
+            floorDivValue += 1.;
+        }
+    } else {
+        // the zero has the sign of the true quotient
+        const bool xNegative = (x < 0.) || ( (x == 0.) && (1. / x < 0.) );
+        floorDivValue = ( xNegative != (y < 0.) ) ? -0. : 0.;
+    }
+    *floorDiv = floorDivValue;
+    *mod = m;
+}
+
+/// x ** y for floats, as done by Python (float_pow): only the cases where Python does not raise an exception
+/// are handled, the result is then the one of pow()
+bool
+floatPower(double x,
+           double y,
+           Value* ret)
+{
+    if ( (x == 0.) && (y < 0.) ) {
+        // ZeroDivisionError
+        return false;
+    }
+    if ( (x < 0.) && (y != std::floor(y)) ) {
+        // ValueError (a complex number in Python 3)
+        return false;
+    }
+
+    return setFloat(std::pow(x, y), ret);
+}
+
+bool
+floatOperation(OpEnum op,
+               double x,
+               double y,
+               Value* ret)
+{
+    switch (op) {
+    case eOpAdd:
+
+        return setFloat(x + y, ret);
+    case eOpSubtract:
+
+        return setFloat(x - y, ret);
+    case eOpMultiply:
+
+        return setFloat(x * y, ret);
+    case eOpDivide:
+        if (y == 0.) {
+            return false;
+        }
+
+        return setFloat(x / y, ret);
+    case eOpFloorDivide:
+    case eOpModulo: {
+        if (y == 0.) {
+            return false;
+        }
+        double floorDiv, mod;
+        floatDivMod(x, y, &floorDiv, &mod);
+
+        return setFloat(op == eOpFloorDivide ? floorDiv : mod, ret);
+    }
+    case eOpPower:
+
+        return floatPower(x, y, ret);
+    default:
+        break;
+    }
+    assert(false);
+
+    return false;
+}
+
+bool
+intOperation(OpEnum op,
+             long long x,
+             long long y,
+             Value* ret)
+{
+    switch (op) {
+    case eOpAdd:
+
+        return setInt( (double)(x + y), ret );
+    case eOpSubtract:
+
+        return setInt( (double)(x - y), ret );
+    case eOpMultiply:
+        if ( std::fabs( (double)x * (double)y ) > NATRON_KNOB_EXPRESSION_MAX_INT ) {
+            return false;
+        }
+
+        return setInt( (double)(x * y), ret );
+    case eOpDivide:
+#if PY_MAJOR_VERSION >= 3
+        // true division: both ints are exactly represented, so this is correctly rounded as in Python
+
+        return floatOperation(op, (double)x, (double)y, ret);
+#endif
+    // the division of ints is a floor division in Python 2
+    case eOpFloorDivide: {
+        if (y == 0) {
+            return false;
+        }
+        long long q = x / y;
+        if ( (x % y != 0) && ( (x < 0) != (y < 0) ) ) {
+            --q;
+        }
+
+        return setInt( (double)q, ret );
+    }
+    case eOpModulo: {
+        if (y == 0) {
+            return false;
+        }
+        long long r = x % y;
+        if ( (r != 0) && ( (r < 0) != (y < 0) ) ) {
+            r += y;
+        }
+
+        return setInt( (double)r, ret );
+    }
+    case eOpPower: {
+        if (y < 0) {
+            // Python returns a float
+
+            return floatPower( (double)x, (double)y, ret );
+        }
+        if ( (x == 0) || (x == 1) || (x == -1) ) {
+            if ( (y == 0) || ( (x == -1) && (y % 2 == 0) ) ) {
+                return setInt(1., ret);
+            }
+
+            return setInt( (double)x, ret );
+        }
+        // |x| >= 2: this overflows after at most 53 multiplications
+        double r = 1.;
+        for (long long i = 0; i < y; ++i) {
+            r *= (double)x;
+            if (std::fabs(r) > NATRON_KNOB_EXPRESSION_MAX_INT) {
+                return false;
+            }
+        }
+
+        return setInt(r, ret);
+    }
+    default:
+        break;
+    }
+    assert(false);
+
+    return false;
+}
+
+bool
+binaryOperation(OpEnum op,
+                const Value& x,
+                const Value& y,
+                Value* ret)
+{
+    switch (op) {
+    case eOpLess:
+
+        return setInt(x.v < y.v, ret);
+    case eOpLessEqual:
+
+        return setInt(x.v <= y.v, ret);
+    case eOpGreater:
+
+        return setInt(x.v > y.v, ret);
+    case eOpGreaterEqual:
+
+        return setInt(x.v >= y.v, ret);
+    case eOpEqual:
+
+        return setInt(x.v == y.v, ret);
+    case eOpNotEqual:
+
+        return setInt(x.v != y.v, ret);
+    default:
+        break;
+    }
+    if (x.isInt && y.isInt) {
+        return intOperation( op, (long long)x.v, (long long)y.v, ret );
+    }
+
+    return floatOperation(op, x.v, y.v, ret);
+}
+
+/// Rounds half away from zero as Python 2 (half to even in Python 3)
+double
+roundValue(double x)
+{
+    double r = std::floor(x);
+    const double diff = x - r; // exact
+
+#if PY_MAJOR_VERSION >= 3
+    if ( (diff > 0.5) || ( (diff == 0.5) && (std::fmod(r, 2.) != 0.) ) ) {
+#else
+    if ( (diff > 0.5) || ( (diff == 0.5) && (x > 0.) ) ) {
+#endif
+        r += 1.;
+    }
+
+    return r;
+}
+
+bool
+callFunction(FunctionEnum function,
+             const Value* args,
+             int nArgs,
+             Value* ret)
+{
+    // In Python the degrees and radians conversion factors are computed once
+    static const double degToRad = M_PI / 180.;
+    static const double radToDeg = 180. / M_PI;
+    const double x = args[0].v;
+    double r = 0.;
+
+    switch (function) {
+    case eFunctionSin:
+        r = std::sin(x);
+        break;
+    case eFunctionCos:
+        r = std::cos(x);
+        break;
+    case eFunctionTan:
+        r = std::tan(x);
+        break;
+    case eFunctionAsin:
+        r = std::asin(x);
+        break;
+    case eFunctionAcos:
+        r = std::acos(x);
+        break;
+    case eFunctionAtan:
+        r = std::atan(x);
+        break;
+    case eFunctionAtan2:
+        r = std::atan2(x, args[1].v);
+        break;
+    case eFunctionSinh:
+        r = std::sinh(x);
+        break;
+    case eFunctionCosh:
+        r = std::cosh(x);
+        break;
+    case eFunctionTanh:
+        r = std::tanh(x);
+        break;
+    case eFunctionExp:
+        r = std::exp(x);
+        break;
+    case eFunctionLog:
+        r = std::log(x);
+        if (nArgs == 2) {
+            const double base = std::log(args[1].v);
+            if ( !isFinite(r) || !isFinite(base) || (base == 0.) ) {
+                return false;
+            }
+            r /= base;
+        }
+        break;
+    case eFunctionLog10:
+        r = std::log10(x);
+        break;
+    case eFunctionSqrt:
+        r = std::sqrt(x);
+        break;
+    case eFunctionPow:
+        r = std::pow(x, args[1].v);
+        break;
+    case eFunctionFabs:
+        r = std::fabs(x);
+        break;
+    case eFunctionFloor:
+#if PY_MAJOR_VERSION >= 3
+
+        return setInt(std::floor(x), ret);
+#endif
+        r = std::floor(x);
+        break;
+    case eFunctionCeil:
+#if PY_MAJOR_VERSION >= 3
+
+        return setInt(std::ceil(x), ret);
+#endif
+        r = std::ceil(x);
+        break;
+    case eFunctionFmod:
+        r = std::fmod(x, args[1].v);
+        break;
+    case eFunctionHypot:
+        r = ::hypot(x, args[1].v);
+        break;
+    case eFunctionDegrees:
+        r = x * radToDeg;
+        break;
+    case eFunctionRadians:
+        r = x * degToRad;
+        break;
+    case eFunctionAbs:
+        if (args[0].isInt) {
+            return setInt(std::fabs(x), ret);
+        }
+        r = std::fabs(x);
+        break;
+    case eFunctionMin:
+    case eFunctionMax: {
+        // the first of the smallest (or largest) values is returned, with its type
+        const Value* best = &args[0];
+        for (int i = 1; i < nArgs; ++i) {
+            if ( (function == eFunctionMin) ? (args[i].v < best->v) : (args[i].v > best->v) ) {
+                best = &args[i];
+            }
+        }
+        *ret = *best;
+
+        return true;
+    }
+    case eFunctionInt:
+
+        return setInt( (x < 0.) ? std::ceil(x) : std::floor(x), ret );
+    case eFunctionFloat:
+        r = x;
+        break;
+    case eFunctionRound:
+#if PY_MAJOR_VERSION >= 3
+
+        return setInt(roundValue(x), ret);
+#endif
+        r = roundValue(x);
+        break;
+    case eFunctionBoxstep:
+        r = NATRON_PYTHON_NAMESPACE::ExprUtils::boxstep(x, args[1].v);
+        break;
+    case eFunctionLinearstep:
+        r = NATRON_PYTHON_NAMESPACE::ExprUtils::linearstep(x, args[1].v, args[2].v);
+        break;
+    case eFunctionSmoothstep:
+        r = NATRON_PYTHON_NAMESPACE::ExprUtils::smoothstep(x, args[1].v, args[2].v);
+        break;
+    case eFunctionGaussstep:
+        r = NATRON_PYTHON_NAMESPACE::ExprUtils::gaussstep(x, args[1].v, args[2].v);
+        break;
+    case eFunctionRemap:
+        r = NATRON_PYTHON_NAMESPACE::ExprUtils::remap(x, args[1].v, args[2].v, args[3].v, args[4].v);
+        break;
+    case eFunctionMix:
+        r = NATRON_PYTHON_NAMESPACE::ExprUtils::mix(x, args[1].v, args[2].v);
+        break;
+    case eFunctionNoise:
+        r = NATRON_PYTHON_NAMESPACE::ExprUtils::noise(x);
+        break;
+    }
+
+    // the math module raises ValueError or OverflowError when the result is not finite
+    return setFloat(r, ret);
+} // callFunction
+
+/// The frame argument of the Python expression, which is called with the time written by a std::stringstream
+/// (see KnobHelper::executeExpression): an int for integer times, a float rounded to 6 significant digits otherwise.
+bool
+getFrameValue(double time,
+              Value* frame)
+{
+    if ( (time == std::floor(time)) && (std::fabs(time) < 1e6) ) {
+        frame->v = time + 0.;
+        frame->isInt = true;
+
+        return true;
+    }
+    std::stringstream ss;
+    ss << time;
+    const std::string str = ss.str();
+    if (str.find_first_of("ni") != std::string::npos) {
+        // inf or nan are not valid Python
+        return false;
+    }
+    std::stringstream parse(str);
+    parse >> frame->v;
+    frame->isInt = str.find_first_of(".e") == std::string::npos;
+
+    return !parse.fail() && isFinite(frame->v);
+}
+
+template <typename T>
+bool
+readKnobValue(const boost::weak_ptr<Knob<T> >& knobWPtr,
+              bool isInt,
+              OpEnum op,
+              double time,
+              int dimension,
+              Value* ret)
+{
+    boost::shared_ptr<Knob<T> > knob = knobWPtr.lock();
+
+    if (!knob) {
+        return false;
+    }
+    switch (op) {
+    case eOpGetValue:
+        ret->v = knob->getValue(dimension);
+        ret->isInt = isInt;
+        break;
+    case eOpGetValueAtTime:
+        ret->v = knob->getValueAtTime(time, dimension);
+        ret->isInt = isInt;
+        break;
+    case eOpGetCurveValue:
+        ret->v = knob->getRawCurveValueAt(time, ViewSpec::current(), dimension);
+        ret->isInt = false;
+        break;
+    default:
+        assert(false);
+
+        return false;
+    }
+
+    return isFinite(ret->v);
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+bool
+KnobExpressionPrivate::readKnob(OpEnum op,
+                                const KnobRef& knob,
+                                const Value& time,
+                                const Value& dimension,
+                                Value* ret) const
+{
+    // Python would not find a deleted node
+    NodePtr node = knob.node.lock();
+
+    if ( !node || !node->isActivated() ) {
+        return false;
+    }
+    if ( !dimension.isInt || (dimension.v < 0) || (dimension.v >= knob.nDims) ) {
+        return false;
+    }
+    const int dim = (int)dimension.v;
+    switch (knob.type) {
+    case eKnobTypeInt:
+
+        return readKnobValue(knob.intKnob, true, op, time.v, dim, ret);
+    case eKnobTypeDouble:
+
+        return readKnobValue(knob.doubleKnob, false, op, time.v, dim, ret);
+    case eKnobTypeBool:
+
+        return readKnobValue(knob.boolKnob, true, op, time.v, dim, ret);
+    }
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Compilation
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+enum TokenTypeEnum
+{
+    eTokenTypeEnd = 0,
+    eTokenTypeName,
+    eTokenTypeNumber,
+    eTokenTypeOperator
+};
+
+struct Token
+{
+    TokenTypeEnum type;
+    std::string text;
+    Value number;
+};
+
+/// The Python keywords, which cannot be used as names
+const char* const pythonKeywords[] = {
+    "and", "as", "assert", "break", "class", "continue", "def", "del", "elif", "else", "except", "exec",
+    "finally", "for", "from", "global", "if", "import", "in", "is", "lambda", "nonlocal", "not", "or",
+    "pass", "print", "raise", "return", "try", "while", "with", "yield", "None", 0
+};
+
+bool
+isKeyword(const std::string& name)
+{
+    for (const char* const* it = pythonKeywords; *it; ++it) {
+        if (name == *it) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+inline bool
+isNameStart(char c)
+{
+    return ( (c >= 'a') && (c <= 'z') ) || ( (c >= 'A') && (c <= 'Z') ) || (c == '_');
+}
+
+inline bool
+isDigit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+/// Splits the expression in tokens. Returns false if it contains anything that is not supported.
+bool
+tokenize(const std::string& expr,
+         std::vector<Token>* tokens)
+{
+    static const char* const operators[] = {
+        "**", "//", "<=", ">=", "==", "!=", "+", "-", "*", "/", "%", "<", ">", "(", ")", ",", ".", 0
+    };
+    std::size_t i = 0;
+    const std::size_t n = expr.size();
+
+    while (i < n) {
+        const char c = expr[i];
+        if ( (c == ' ') || (c == '\t') ) {
+            ++i;
+            continue;
+        }
+        if (c == '#') {
+            break;
+        }
+        Token token;
+        token.number = makeValue(0., true);
+        if ( isDigit(c) || ( (c == '.') && (i + 1 < n) && isDigit(expr[i + 1]) ) ) {
+            const std::size_t start = i;
+            bool isFloat = false;
+            while ( i < n && isDigit(expr[i]) ) {
+                ++i;
+            }
+            if ( (i < n) && (expr[i] == '.') ) {
+                isFloat = true;
+                ++i;
+                while ( i < n && isDigit(expr[i]) ) {
+                    ++i;
+                }
+            }
+            if ( (i < n) && ( (expr[i] == 'e') || (expr[i] == 'E') ) ) {
+                isFloat = true;
+                ++i;
+                if ( (i < n) && ( (expr[i] == '+') || (expr[i] == '-') ) ) {
+                    ++i;
+                }
+                if ( (i >= n) || !isDigit(expr[i]) ) {
+                    return false;
+                }
+                while ( i < n && isDigit(expr[i]) ) {
+                    ++i;
+                }
+            }
+            if ( (i < n) && ( isNameStart(expr[i]) || isDigit(expr[i]) ) ) {
+                // long, imaginary and hexadecimal literals
+                return false;
+            }
+            token.type = eTokenTypeNumber;
+            token.text = expr.substr(start, i - start);
+            if ( !isFloat && (token.text.size() > 1) && (token.text[0] == '0') ) {
+                // octal literal
+                return false;
+            }
+            std::istringstream ss(token.text);
+            ss.imbue( std::locale::classic() );
+            ss >> token.number.v;
+            if ( ss.fail() ) {
+                return false;
+            }
+            token.number.isInt = !isFloat;
+            if ( isFloat ? !isFinite(token.number.v) : (token.number.v > NATRON_KNOB_EXPRESSION_MAX_INT) ) {
+                return false;
+            }
+        } else if ( isNameStart(c) ) {
+            const std::size_t start = i;
+            while ( i < n && ( isNameStart(expr[i]) || isDigit(expr[i]) ) ) {
+                ++i;
+            }
+            token.type = eTokenTypeName;
+            token.text = expr.substr(start, i - start);
+        } else {
+            const char* const* op = operators;
+            for (; *op; ++op) {
+                if (expr.compare(i, std::strlen(*op), *op) == 0) {
+                    break;
+                }
+            }
+            if (!*op) {
+                return false;
+            }
+            token.type = eTokenTypeOperator;
+            token.text = *op;
+            i += token.text.size();
+        }
+        tokens->push_back(token);
+    }
+    Token end;
+    end.type = eTokenTypeEnd;
+    end.number = makeValue(0., true);
+    tokens->push_back(end);
+
+    return true;
+} // tokenize
+
+void
+emit(Code& code,
+     OpEnum op,
+     int arg = 0,
+     int nArgs = 0)
+{
+    Instruction i;
+
+    i.op = op;
+    i.arg = arg;
+    i.nArgs = nArgs;
+    i.value = makeValue(0., true);
+    code.push_back(i);
+}
+
+void
+emitConstant(Code& code,
+             double v,
+             bool isInt)
+{
+    emit(code, eOpPushConstant);
+    code.back().value = makeValue(v, isInt);
+}
+
+void
+append(Code& code,
+       const Code& other)
+{
+    code.insert( code.end(), other.begin(), other.end() );
+}
+
+/// Returns the maximum depth of the stack when executing code. Conditional expressions are over-estimated.
+int
+getMaxStackDepth(const Code& code)
+{
+    int depth = 0;
+    int maxDepth = 0;
+
+    for (Code::const_iterator it = code.begin(); it != code.end(); ++it) {
+        switch (it->op) {
+        case eOpPushConstant:
+        case eOpPushFrame:
+        case eOpPushView:
+            ++depth;
+            break;
+        case eOpNegate:
+        case eOpPositive:
+        case eOpNot:
+        case eOpJump:
+        case eOpGetValue:
+            break;
+        case eOpCallFunction:
+            depth += 1 - it->nArgs;
+            break;
+        default:
+            // binary operators, conditional jumps and the knob accessors that take 2 arguments
+            --depth;
+            break;
+        }
+        maxDepth = std::max(depth, maxDepth);
+    }
+
+    return maxDepth;
+}
+
+/// Borrowed reference to a global variable of the Python main module, or NULL
+PyObject*
+getPythonGlobal(const char* name)
+{
+    PyObject* mainModule = NATRON_PYTHON_NAMESPACE::getMainModule();
+
+    if (!mainModule) {
+        return 0;
+    }
+
+    return PyDict_GetItemString(PyModule_GetDict(mainModule), name);
+}
+
+/// Borrowed reference to an imported Python module, or NULL
+PyObject*
+getPythonModule(const char* name)
+{
+    return PyDict_GetItemString(PyImport_GetModuleDict(), name);
+}
+
+/// Returns true if obj is the attribute name of parent
+bool
+isPythonAttribute(PyObject* obj,
+                  PyObject* parent,
+                  const char* name)
+{
+    if (!obj || !parent) {
+        return false;
+    }
+    PyObject* attr = PyObject_GetAttrString(parent, name); // new ref
+    if (!attr) {
+        PyErr_Clear();
+
+        return false;
+    }
+    const bool ret = (attr == obj);
+    Py_DECREF(attr);
+
+    return ret;
+}
+
+/// New reference to the attribute name of parent if it is a Natron object (node or parameter) with this script-name
+/// and a method typeMethod, or NULL
+PyObject*
+getNatronPythonAttribute(PyObject* parent,
+                         const std::string& name,
+                         const char* typeMethod)
+{
+    PyObject* attr = PyObject_GetAttrString( parent, name.c_str() ); // new ref
+
+    if (!attr) {
+        PyErr_Clear();
+
+        return 0;
+    }
+    bool ok = false;
+    if ( PyObject_HasAttrString(attr, typeMethod) ) {
+        PyObject* scriptName = PyObject_CallMethod(attr, const_cast<char*>("getScriptName"), NULL); // new ref
+        if (scriptName) {
+            ok = NATRON_PYTHON_NAMESPACE::PyStringToStdString(scriptName) == name;
+            Py_DECREF(scriptName);
+        }
+    }
+    PyErr_Clear();
+    if (!ok) {
+        Py_DECREF(attr);
+
+        return 0;
+    }
+
+    return attr;
+}
+
+/**
+ * @brief Recursive descent parser of the Python expression grammar, restricted to the supported subset.
+ * Each parse function appends the code of what it parsed to the given code and returns false if the
+ * expression is not supported.
+ **/
+class ExpressionCompiler
+{
+    enum LocalEnum
+    {
+        eLocalNone = 0, //< not a local variable: a global or a builtin
+        eLocalThisGroup,
+        eLocalThisNode,
+        eLocalThisParam,
+        eLocalCurve,
+        eLocalDimension,
+        eLocalSibling,
+        eLocalFrame,
+        eLocalView,
+        eLocalUnsupported //< random, randomInt, app
+    };
+
+    enum ParamTypeEnum
+    {
+        eParamTypeInt = 0,
+        eParamTypeDouble,
+        eParamTypeColor,
+        eParamTypeBool,
+        eParamTypeChoice
+    };
+
+    struct ParamRef
+    {
+        int index; //< in KnobExpressionPrivate::knobs
+        ParamTypeEnum type;
+        int nDims;
+    };
+
+    KnobExpressionPrivate* _program;
+    KnobIPtr _knob;
+    int _dimension;
+    NodePtr _node;
+    NodeCollectionPtr _collection;
+    std::string _appID;
+    std::vector<Token> _tokens;
+    std::size_t _pos;
+    int _nesting;
+
+public:
+
+    ExpressionCompiler(KnobExpressionPrivate* program,
+                       const KnobIPtr& knob,
+                       int dimension,
+                       const NodePtr& node,
+                       const NodeCollectionPtr& collection,
+                       const std::string& appID)
+        : _program(program)
+        , _knob(knob)
+        , _dimension(dimension)
+        , _node(node)
+        , _collection(collection)
+        , _appID(appID)
+        , _tokens()
+        , _pos(0)
+        , _nesting(0)
+    {
+    }
+
+    bool compile(const std::string& expression)
+    {
+        if ( !tokenize(expression, &_tokens) ) {
+            return false;
+        }
+        Code code;
+        if ( !parseTest(code) || (peek().type != eTokenTypeEnd) ) {
+            return false;
+        }
+        if (getMaxStackDepth(code) > NATRON_KNOB_EXPRESSION_MAX_STACK) {
+            return false;
+        }
+        _program->code = code;
+
+        return true;
+    }
+
+private:
+
+    const Token& peek() const
+    {
+        return _tokens[_pos];
+    }
+
+    bool peekOperator(const char* op) const
+    {
+        return peek().type == eTokenTypeOperator && peek().text == op;
+    }
+
+    bool acceptOperator(const char* op)
+    {
+        if ( !peekOperator(op) ) {
+            return false;
+        }
+        ++_pos;
+
+        return true;
+    }
+
+    bool acceptKeyword(const char* keyword)
+    {
+        if ( (peek().type != eTokenTypeName) || (peek().text != keyword) ) {
+            return false;
+        }
+        ++_pos;
+
+        return true;
+    }
+
+    // test: or_test ['if' or_test 'else' test]
+    bool parseTest(Code& code)
+    {
+        if (++_nesting > NATRON_KNOB_EXPRESSION_MAX_NESTING) {
+            return false;
+        }
+        Code body;
+        if ( !parseOrTest(body) ) {
+            return false;
+        }
+        if ( acceptKeyword("if") ) {
+            // the condition is evaluated first
+            Code condition, orElse;
+            if ( !parseOrTest(condition) || !acceptKeyword("else") || !parseTest(orElse) ) {
+                return false;
+            }
+            append(code, condition);
+            emit(code, eOpJumpIfFalse, (int)body.size() + 1);
+            append(code, body);
+            emit(code, eOpJump, (int)orElse.size());
+            append(code, orElse);
+        } else {
+            append(code, body);
+        }
+        --_nesting;
+
+        return true;
+    }
+
+    // or_test: and_test ('or' and_test)*
+    bool parseOrTest(Code& code)
+    {
+        if ( !parseAndTest(code) ) {
+            return false;
+        }
+        while ( acceptKeyword("or") ) {
+            Code rhs;
+            if ( !parseAndTest(rhs) ) {
+                return false;
+            }
+            emit(code, eOpJumpIfTrueOrPop, (int)rhs.size());
+            append(code, rhs);
+        }
+
+        return true;
+    }
+
+    // and_test: not_test ('and' not_test)*
+    bool parseAndTest(Code& code)
+    {
+        if ( !parseNotTest(code) ) {
+            return false;
+        }
+        while ( acceptKeyword("and") ) {
+            Code rhs;
+            if ( !parseNotTest(rhs) ) {
+                return false;
+            }
+            emit(code, eOpJumpIfFalseOrPop, (int)rhs.size());
+            append(code, rhs);
+        }
+
+        return true;
+    }
+
+    // not_test: 'not' not_test | comparison
+    bool parseNotTest(Code& code)
+    {
+        if ( acceptKeyword("not") ) {
+            if ( !parseNotTest(code) ) {
+                return false;
+            }
+            emit(code, eOpNot);
+
+            return true;
+        }
+
+        return parseComparison(code);
+    }
+
+    // comparison: arith_expr [comp_op arith_expr] (chained comparisons are not supported)
+    bool parseComparison(Code& code)
+    {
+        if ( !parseArithmetic(code) ) {
+            return false;
+        }
+        OpEnum op;
+        if ( !acceptComparison(&op) ) {
+            return true;
+        }
+        if ( !parseArithmetic(code) ) {
+            return false;
+        }
+        emit(code, op);
+        OpEnum chained;
+
+        return !acceptComparison(&chained);
+    }
+
+    bool acceptComparison(OpEnum* op)
+    {
+        if ( acceptOperator("<") ) {
+            *op = eOpLess;
+        } else if ( acceptOperator("<=") ) {
+            *op = eOpLessEqual;
+        } else if ( acceptOperator(">") ) {
+            *op = eOpGreater;
+        } else if ( acceptOperator(">=") ) {
+            *op = eOpGreaterEqual;
+        } else if ( acceptOperator("==") ) {
+            *op = eOpEqual;
+        } else if ( acceptOperator("!=") ) {
+            *op = eOpNotEqual;
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    // arith_expr: term (('+'|'-') term)*
+    bool parseArithmetic(Code& code)
+    {
+        if ( !parseTerm(code) ) {
+            return false;
+        }
+        for (;; ) {
+            OpEnum op;
+            if ( acceptOperator("+") ) {
+                op = eOpAdd;
+            } else if ( acceptOperator("-") ) {
+                op = eOpSubtract;
+            } else {
+                return true;
+            }
+            if ( !parseTerm(code) ) {
+                return false;
+            }
+            emit(code, op);
+        }
+    }
+
+    // term: factor (('*'|'/'|'%'|'//') factor)*
+    bool parseTerm(Code& code)
+    {
+        if ( !parseFactor(code) ) {
+            return false;
+        }
+        for (;; ) {
+            OpEnum op;
+            if ( acceptOperator("*") ) {
+                op = eOpMultiply;
+            } else if ( acceptOperator("/") ) {
+                op = eOpDivide;
+            } else if ( acceptOperator("//") ) {
+                op = eOpFloorDivide;
+            } else if ( acceptOperator("%") ) {
+                op = eOpModulo;
+            } else {
+                return true;
+            }
+            if ( !parseFactor(code) ) {
+                return false;
+            }
+            emit(code, op);
+        }
+    }
+
+    // factor: ('+'|'-') factor | power
+    bool parseFactor(Code& code)
+    {
+        if ( acceptOperator("-") ) {
+            if ( !parseFactor(code) ) {
+                return false;
+            }
+            emit(code, eOpNegate);
+
+            return true;
+        }
+        if ( acceptOperator("+") ) {
+            if ( !parseFactor(code) ) {
+                return false;
+            }
+            emit(code, eOpPositive);
+
+            return true;
+        }
+
+        return parsePower(code);
+    }
+
+    // power: primary ['**' factor]
+    bool parsePower(Code& code)
+    {
+        if ( !parsePrimary(code) ) {
+            return false;
+        }
+        if ( acceptOperator("**") ) {
+            if ( !parseFactor(code) ) {
+                return false;
+            }
+            emit(code, eOpPower);
+        }
+
+        return true;
+    }
+
+    // primary: '(' test ')' | NUMBER | NAME ('.' NAME)* ['(' [test (',' test)*] ')' ['.' NAME]]
+    bool parsePrimary(Code& code)
+    {
+        const Token& token = peek();
+
+        if (token.type == eTokenTypeNumber) {
+            emitConstant(code, token.number.v, token.number.isInt);
+            ++_pos;
+        } else if ( acceptOperator("(") ) {
+            if ( !parseTest(code) || !acceptOperator(")") ) {
+                return false;
+            }
+        } else if ( (token.type == eTokenTypeName) && !isKeyword(token.text) ) {
+            std::vector<std::string> names(1, token.text);
+            ++_pos;
+            while ( acceptOperator(".") ) {
+                if ( (peek().type != eTokenTypeName) || isKeyword(peek().text) ) {
+                    return false;
+                }
+                names.push_back(peek().text);
+                ++_pos;
+            }
+            if ( !acceptOperator("(") ) {
+                if ( !compileName(names, code) ) {
+                    return false;
+                }
+            } else {
+                std::vector<Code> args;
+                if ( !acceptOperator(")") ) {
+                    do {
+                        args.push_back( Code() );
+                        if ( !parseTest( args.back() ) ) {
+                            return false;
+                        }
+                    } while ( acceptOperator(",") );
+                    if ( !acceptOperator(")") ) {
+                        return false;
+                    }
+                }
+                std::string member;
+                if ( acceptOperator(".") ) {
+                    if (peek().type != eTokenTypeName) {
+                        return false;
+                    }
+                    member = peek().text;
+                    ++_pos;
+                }
+                if ( !compileCall(names, args, member, code) ) {
+                    return false;
+                }
+            }
+        } else {
+            return false;
+        }
+
+        // attributes, calls and subscripts of the result are not supported
+        return !peekOperator(".") && !peekOperator("(");
+    } // parsePrimary
+
+    /// Which local variable of the Python expression function (see KnobHelper::validateExpression) is name
+    LocalEnum getLocal(const std::string& name,
+                       NodePtr* sibling) const
+    {
+        // in the order of their declaration in KnobHelperPrivate::declarePythonVariables: the last one wins
+        if (name == "dimension") {
+            return eLocalDimension;
+        } else if (name == "curve") {
+            return eLocalCurve;
+        } else if ( (name == "random") || (name == "randomInt") ) {
+            return eLocalUnsupported;
+        } else if (name == "thisParam") {
+            return eLocalThisParam;
+        } else if (name == "thisNode") {
+            return eLocalThisNode;
+        } else if (name == "thisGroup") {
+            return eLocalThisGroup;
+        }
+        NodePtr node = _collection->getNodeByName(name);
+        if ( node && node->isActivated() && !node->getParentMultiInstance() ) {
+            *sibling = node;
+
+            return eLocalSibling;
+        }
+        if ( (name == "app") && (_appID != "app") ) {
+            return eLocalUnsupported;
+        } else if (name == "frame") {
+            return eLocalFrame;
+        } else if (name == "view") {
+            return eLocalView;
+        }
+
+        return eLocalNone;
+    }
+
+    /// A name used as a value
+    bool compileName(const std::vector<std::string>& names,
+                     Code& code) const
+    {
+        const std::string& name = names[0];
+        NodePtr sibling;
+
+        switch ( getLocal(name, &sibling) ) {
+        case eLocalDimension:
+            emitConstant(code, _dimension, true);
+            break;
+        case eLocalFrame:
+            emit(code, eOpPushFrame);
+            break;
+        case eLocalView:
+            emit(code, eOpPushView);
+            break;
+        case eLocalNone: {
+            // True and False, pi and e from the math module
+            if (names.size() == 1) {
+                if ( (name == "True") || (name == "False") ) {
+                    if ( getPythonGlobal( name.c_str() ) ) {
+                        return false;
+                    }
+                    emitConstant(code, name == "True" ? 1. : 0., true);
+
+                    return true;
+                }
+            } else if ( (names.size() != 2) || (name != "math") || ( getPythonGlobal("math") != getPythonModule("math") ) ) {
+                return false;
+            }
+            const std::string& constant = names.back();
+            if ( (constant != "pi") && (constant != "e") ) {
+                return false;
+            }
+            PyObject* math = getPythonModule("math");
+            PyObject* value = math ? PyObject_GetAttrString( math, constant.c_str() ) : 0; // new ref
+            if (!value) {
+                PyErr_Clear();
+
+                return false;
+            }
+            const bool ok = PyFloat_Check(value) && ( (names.size() == 2) || ( getPythonGlobal( constant.c_str() ) == value ) );
+            if (ok) {
+                emitConstant(code, PyFloat_AsDouble(value), false);
+            }
+            Py_DECREF(value);
+
+            return ok;
+        }
+        default:
+
+            return false;
+        }
+
+        // frame, view and dimension have no attributes
+        return names.size() == 1;
+    } // compileName
+
+    /// A function or a parameter method call
+    bool compileCall(const std::vector<std::string>& names,
+                     const std::vector<Code>& args,
+                     const std::string& member,
+                     Code& code)
+    {
+        NodePtr sibling;
+        const LocalEnum local = getLocal(names[0], &sibling);
+
+        if (local == eLocalNone) {
+            const FunctionDef* function = findGlobalFunction(names);
+            const int nArgs = (int)args.size();
+            if ( !function || !member.empty() || (nArgs < function->minArgs) || (nArgs > function->maxArgs) ) {
+                return false;
+            }
+            for (std::size_t i = 0; i < args.size(); ++i) {
+                append(code, args[i]);
+            }
+            emit(code, eOpCallFunction, function->function, nArgs);
+
+            return true;
+        }
+
+        ParamRef param;
+        if ( (local == eLocalCurve) && (names.size() == 1) ) {
+            // curve is thisParam.curve
+            if ( !addParam(_node, _knob, &param) ) {
+                return false;
+            }
+
+            return compileParamCall(param, "curve", args, member, code);
+        }
+        if ( (names.size() < 2) || !resolveParam(local, sibling, names, &param) ) {
+            return false;
+        }
+
+        return compileParamCall(param, names.back(), args, member, code);
+    }
+
+    /// The functions of the math module (imported in the main module with "from math import *"),
+    /// the builtins and the ExprUtils functions
+    const FunctionDef* findGlobalFunction(const std::vector<std::string>& names) const
+    {
+        const std::string& name = names.back();
+
+        if (names.size() == 1) {
+            const FunctionDef* function = findFunction(mathFunctions, name);
+            if (function) {
+                return isPythonAttribute(getPythonGlobal( name.c_str() ), getPythonModule("math"), name.c_str() ) ? function : 0;
+            }
+            function = findFunction(builtinFunctions, name);
+            if (function) {
+                // not redefined by a global
+                return getPythonGlobal( name.c_str() ) ? 0 : function;
+            }
+
+            return 0;
+        }
+
+        PyObject* engineModule = getPythonModule(NATRON_ENGINE_PYTHON_MODULE_NAME);
+        PyObject* exprUtils = 0;
+        if (engineModule) {
+            exprUtils = PyObject_GetAttrString(engineModule, "ExprUtils"); // new ref
+            if (!exprUtils) {
+                PyErr_Clear();
+            }
+        }
+        bool ok = false;
+        if ( (names.size() == 2) && (names[0] == "math") ) {
+            if ( getPythonGlobal("math") == getPythonModule("math") ) {
+                Py_XDECREF(exprUtils);
+
+                return findFunction(mathFunctions, name);
+            }
+        } else if (names.size() == 2) {
+            ok = exprUtils && (names[0] == "ExprUtils") && (getPythonGlobal("ExprUtils") == exprUtils);
+        } else if (names.size() == 3) {
+            ok = exprUtils && (names[0] == NATRON_ENGINE_PYTHON_MODULE_NAME) && (names[1] == "ExprUtils") &&
+                 ( getPythonGlobal(NATRON_ENGINE_PYTHON_MODULE_NAME) == engineModule );
+        }
+        Py_XDECREF(exprUtils);
+
+        return ok ? findFunction(exprUtilsFunctions, name) : 0;
+    }
+
+    /// Resolves the parameter names[0..n-2] (names.back() is the method)
+    bool resolveParam(LocalEnum local,
+                      const NodePtr& sibling,
+                      const std::vector<std::string>& names,
+                      ParamRef* param)
+    {
+        const std::size_t knobIndex = names.size() - 2;
+        std::size_t i = 1;
+        NodePtr node;
+
+        switch (local) {
+        case eLocalThisParam:
+            if (knobIndex != 0) {
+                return false;
+            }
+
+            return addParam(_node, _knob, param);
+        case eLocalThisNode:
+            node = _node;
+            break;
+        case eLocalSibling:
+            node = sibling;
+            break;
+        case eLocalThisGroup: {
+            NodeGroup* isParentGroup = dynamic_cast<NodeGroup*>( _collection.get() );
+            if (isParentGroup) {
+                node = isParentGroup->getNode();
+            } else if (knobIndex > 1) {
+                // thisGroup is the app
+                node = _collection->getNodeByName(names[i]);
+                ++i;
+            }
+            break;
+        }
+        default:
+
+            return false;
+        }
+
+        // children of groups
+        for (; node && i < knobIndex; ++i) {
+            NodeGroup* isGroup = dynamic_cast<NodeGroup*>( node->getEffectInstance().get() );
+            node = isGroup ? isGroup->getNodeByName(names[i]) : NodePtr();
+        }
+        if ( !node || (i != knobIndex) || !node->isActivated() || node->getParentMultiInstance() ) {
+            return false;
+        }
+        KnobIPtr knob = node->getKnobByName(names[knobIndex]);
+        if (!knob) {
+            return false;
+        }
+
+        return addParam(node, knob, param);
+    }
+
+    /// Checks that the Python attribute <app>.<node>.<knob> is this parameter
+    bool isPythonParam(const NodePtr& node,
+                       const KnobIPtr& knob) const
+    {
+        PyObject* obj = PyObject_GetAttrString( NATRON_PYTHON_NAMESPACE::getMainModule(), _appID.c_str() ); // new ref
+
+        if (!obj) {
+            PyErr_Clear();
+
+            return false;
+        }
+        const std::string nodeName = node->getFullyQualifiedName();
+        std::size_t start = 0;
+        for (;; ) {
+            const std::size_t foundDot = nodeName.find('.', start);
+            const std::string name = nodeName.substr(start, foundDot == std::string::npos ? std::string::npos : foundDot - start);
+            PyObject* child = getNatronPythonAttribute(obj, name, "getParam");
+            Py_DECREF(obj);
+            if (!child) {
+                return false;
+            }
+            obj = child;
+            if (foundDot == std::string::npos) {
+                break;
+            }
+            start = foundDot + 1;
+        }
+        PyObject* param = getNatronPythonAttribute(obj, knob->getName(), "getNumDimensions");
+        Py_DECREF(obj);
+        if (!param) {
+            return false;
+        }
+        Py_DECREF(param);
+
+        return true;
+    }
+
+    /// Adds a parameter read by the expression. Only the parameters wrapped in Python by an IntParam, DoubleParam,
+    /// ColorParam, BooleanParam or ChoiceParam are supported (see Effect::createParamWrapperForKnob)
+    bool addParam(const NodePtr& node,
+                  const KnobIPtr& knob,
+                  ParamRef* param)
+    {
+        KnobRef ref;
+        ref.node = node;
+        ref.nDims = knob->getDimension();
+        param->nDims = ref.nDims;
+        if ( KnobChoicePtr isChoice = boost::dynamic_pointer_cast<KnobChoice>(knob) ) {
+            ref.type = eKnobTypeInt;
+            ref.intKnob = isChoice;
+            param->type = eParamTypeChoice;
+        } else if ( KnobIntPtr isInt = boost::dynamic_pointer_cast<KnobInt>(knob) ) {
+            ref.type = eKnobTypeInt;
+            ref.intKnob = isInt;
+            param->type = eParamTypeInt;
+        } else if ( KnobColorPtr isColor = boost::dynamic_pointer_cast<KnobColor>(knob) ) {
+            ref.type = eKnobTypeDouble;
+            ref.doubleKnob = isColor;
+            param->type = eParamTypeColor;
+        } else if ( KnobDoublePtr isDouble = boost::dynamic_pointer_cast<KnobDouble>(knob) ) {
+            ref.type = eKnobTypeDouble;
+            ref.doubleKnob = isDouble;
+            param->type = eParamTypeDouble;
+        } else if ( KnobBoolPtr isBool = boost::dynamic_pointer_cast<KnobBool>(knob) ) {
+            ref.type = eKnobTypeBool;
+            ref.boolKnob = isBool;
+            param->type = eParamTypeBool;
+        } else {
+            return false;
+        }
+        if ( (param->type == eParamTypeInt) || (param->type == eParamTypeDouble) ) {
+            if ( (ref.nDims < 1) || (ref.nDims > 3) ) {
+                return false;
+            }
+        } else if (param->type == eParamTypeColor) {
+            if ( (ref.nDims != 3) && (ref.nDims != 4) ) {
+                return false;
+            }
+        }
+        if ( !isPythonParam(node, knob) ) {
+            return false;
+        }
+        param->index = (int)_program->knobs.size();
+        _program->knobs.push_back(ref);
+
+        return true;
+    }
+
+    /// The methods of the Python parameters that return numbers (see PyParameter.h)
+    bool compileParamCall(const ParamRef& param,
+                          const std::string& method,
+                          const std::vector<Code>& args,
+                          const std::string& member,
+                          Code& code) const
+    {
+        const int nArgs = (int)args.size();
+        // BooleanParam and ChoiceParam have no dimension argument
+        const int maxDimensionArgs = ( (param.type == eParamTypeBool) || (param.type == eParamTypeChoice) ) ? 0 : 1;
+
+        if (method == "curve") {
+            if ( !member.empty() || (nArgs < 1) || (nArgs > 2) ) {
+                return false;
+            }
+            appendTimeAndDimension(args, 0, code);
+            emit(code, eOpGetCurveValue, param.index);
+        } else if (method == "getValue") {
+            if ( !member.empty() || (nArgs > maxDimensionArgs) ) {
+                return false;
+            }
+            if (nArgs == 1) {
+                append(code, args[0]);
+            } else {
+                emitConstant(code, 0., true);
+            }
+            emit(code, eOpGetValue, param.index);
+        } else if (method == "getValueAtTime") {
+            if ( !member.empty() || (nArgs < 1) || (nArgs > 1 + maxDimensionArgs) ) {
+                return false;
+            }
+            appendTimeAndDimension(args, 0, code);
+            emit(code, eOpGetValueAtTime, param.index);
+        } else if (method == "get") {
+            // get() returns a tuple for the multi-dimensional parameters, of which only a member is supported
+            if (nArgs > 1) {
+                return false;
+            }
+            const bool isTuple = (param.type == eParamTypeColor) ||
+                                 ( ( (param.type == eParamTypeInt) || (param.type == eParamTypeDouble) ) && (param.nDims > 1) );
+            if ( isTuple == member.empty() ) {
+                return false;
+            }
+            int dimension = 0;
+            if (param.type == eParamTypeColor) {
+                const char* const members[] = { "r", "g", "b", "a" };
+                dimension = std::find(members, members + 4, member) - members;
+                if (dimension == 4) {
+                    return false;
+                }
+                if (dimension == 3) {
+                    if (param.nDims != 4) {
+                        // the alpha of 3-dimensional colors is 1
+                        if (nArgs == 1) {
+                            append(code, args[0]);
+                            emit(code, eOpPop);
+                        }
+                        emitConstant(code, 1., false);
+
+                        return true;
+                    }
+                    // ColorParam::get(frame) reads the alpha at dimension 2
+                    dimension = (nArgs == 1) ? 2 : 3;
+                }
+            } else if (isTuple) {
+                const char* const members[] = { "x", "y", "z" };
+                dimension = std::find(members, members + param.nDims, member) - members;
+                if (dimension == param.nDims) {
+                    return false;
+                }
+            }
+            if (nArgs == 1) {
+                append(code, args[0]);
+                emitConstant(code, dimension, true);
+                emit(code, eOpGetValueAtTime, param.index);
+            } else {
+                emitConstant(code, dimension, true);
+                emit(code, eOpGetValue, param.index);
+            }
+        } else {
+            return false;
+        }
+
+        return true;
+    } // compileParamCall
+
+    /// Appends the time argument args[i] and the optional dimension args[i+1], 0 by default
+    static void appendTimeAndDimension(const std::vector<Code>& args,
+                                       std::size_t i,
+                                       Code& code)
+    {
+        append(code, args[i]);
+        if (i + 1 < args.size()) {
+            append(code, args[i + 1]);
+        } else {
+            emitConstant(code, 0., true);
+        }
+    }
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+KnobExpression::KnobExpression()
+    : _imp( new KnobExpressionPrivate() )
+{
+}
+
+KnobExpression::~KnobExpression()
+{
+}
+
+KnobExpressionPtr
+KnobExpression::compile(KnobHelper* knob,
+                        int dimension,
+                        const std::string& expression)
+{
+#ifdef NATRON_RUN_WITHOUT_PYTHON
+
+    return KnobExpressionPtr();
+#endif
+    if (!knob) {
+        return KnobExpressionPtr();
+    }
+    KnobExpressionPtr ret( new KnobExpression() );
+    if ( dynamic_cast<KnobIntBase*>(knob) ) {
+        ret->_imp->resultType = eKnobTypeInt;
+    } else if ( dynamic_cast<KnobDoubleBase*>(knob) ) {
+        ret->_imp->resultType = eKnobTypeDouble;
+    } else if ( dynamic_cast<KnobBoolBase*>(knob) ) {
+        ret->_imp->resultType = eKnobTypeBool;
+    } else {
+        return KnobExpressionPtr();
+    }
+    EffectInstance* effect = dynamic_cast<EffectInstance*>( knob->getHolder() );
+    if (!effect) {
+        return KnobExpressionPtr();
+    }
+    try {
+        NodePtr node = effect->getNode();
+        NodeCollectionPtr collection = node ? node->getGroup() : NodeCollectionPtr();
+        AppInstancePtr app = node ? node->getApp() : AppInstancePtr();
+        if (!collection || !app) {
+            return KnobExpressionPtr();
+        }
+        ExpressionCompiler compiler( ret->_imp.get(), knob->shared_from_this(), dimension, node, collection, app->getAppIDString() );
+        if ( !compiler.compile(expression) ) {
+            return KnobExpressionPtr();
+        }
+    } catch (const std::exception&) {
+        return KnobExpressionPtr();
+    }
+
+    return ret;
+}
+
+bool
+KnobExpression::evaluate(double time,
+                         ViewIdx view,
+                         double* ret) const
+{
+    Value frame;
+
+    if ( !getFrameValue(time, &frame) ) {
+        return false;
+    }
+
+    Value stack[NATRON_KNOB_EXPRESSION_MAX_STACK];
+    int sp = 0;
+    const Code& code = _imp->code;
+    const int n = (int)code.size();
+    for (int pc = 0; pc < n; ++pc) {
+        const Instruction& i = code[pc];
+        switch (i.op) {
+        case eOpPushConstant:
+            stack[sp++] = i.value;
+            break;
+        case eOpPushFrame:
+            stack[sp++] = frame;
+            break;
+        case eOpPushView:
+            stack[sp++] = makeValue( (int)view, true );
+            break;
+        case eOpPop:
+            --sp;
+            break;
+        case eOpNegate:
+            stack[sp - 1].v = -stack[sp - 1].v;
+            if (stack[sp - 1].isInt) {
+                stack[sp - 1].v += 0.; // no negative zero
+            }
+            break;
+        case eOpPositive:
+            break;
+        case eOpNot:
+            stack[sp - 1] = makeValue(isTrue(stack[sp - 1]) ? 0. : 1., true);
+            break;
+        case eOpAdd:
+        case eOpSubtract:
+        case eOpMultiply:
+        case eOpDivide:
+        case eOpFloorDivide:
+        case eOpModulo:
+        case eOpPower:
+        case eOpLess:
+        case eOpLessEqual:
+        case eOpGreater:
+        case eOpGreaterEqual:
+        case eOpEqual:
+        case eOpNotEqual:
+            --sp;
+            if ( !binaryOperation(i.op, stack[sp - 1], stack[sp], &stack[sp - 1]) ) {
+                return false;
+            }
+            break;
+        case eOpJump:
+            pc += i.arg;
+            break;
+        case eOpJumpIfFalse:
+            --sp;
+            if ( !isTrue(stack[sp]) ) {
+                pc += i.arg;
+            }
+            break;
+        case eOpJumpIfFalseOrPop:
+            if ( !isTrue(stack[sp - 1]) ) {
+                pc += i.arg;
+            } else {
+                --sp;
+            }
+            break;
+        case eOpJumpIfTrueOrPop:
+            if ( isTrue(stack[sp - 1]) ) {
+                pc += i.arg;
+            } else {
+                --sp;
+            }
+            break;
+        case eOpCallFunction:
+            sp -= i.nArgs;
+            if ( !callFunction( (FunctionEnum)i.arg, &stack[sp], i.nArgs, &stack[sp] ) ) {
+                return false;
+            }
+            ++sp;
+            break;
+        case eOpGetValue:
+            if ( !_imp->readKnob(i.op, _imp->knobs[i.arg], frame, stack[sp - 1], &stack[sp - 1]) ) {
+                return false;
+            }
+            break;
+        case eOpGetValueAtTime:
+        case eOpGetCurveValue:
+            --sp;
+            if ( !_imp->readKnob(i.op, _imp->knobs[i.arg], stack[sp - 1], stack[sp], &stack[sp - 1]) ) {
+                return false;
+            }
+            break;
+        }
+    }
+    assert(sp == 1);
+
+    const Value& result = stack[0];
+    if ( result.isInt || (_imp->resultType == eKnobTypeInt) ) {
+        // ints are converted with a C cast of the Python int (floats are truncated in Python 2): leave the
+        // overflows to Python
+#if PY_MAJOR_VERSION >= 3
+        if ( !result.isInt && (_imp->resultType == eKnobTypeInt) ) {
+            return false;
+        }
+#endif
+        if ( (result.v <= (double)INT_MIN - 1.) || (result.v >= (double)INT_MAX + 1.) ) {
+            return false;
+        }
+    }
+    *ret = result.v;
+
+    return true;
+} // KnobExpression::evaluate
+
+void
+KnobExpression::setEnabled(bool enabled)
+{
+    nativeExpressionsEnabled = enabled;
+}
+
+bool
+KnobExpression::isEnabled()
+{
+    return nativeExpressionsEnabled;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,91 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_KNOBEXPRESSION_H
+#define NATRON_ENGINE_KNOBEXPRESSION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Engine/ViewIdx.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+struct KnobExpressionPrivate;
+
+/**
+ * @brief A single-line knob expression compiled to a small stack program, that is evaluated without Python.
+ * The supported subset is made of numbers, arithmetic, comparisons, boolean operators, conditional expressions,
+ * the functions of the math module, abs, min, max, int, float and round, the scalar functions of ExprUtils,
+ * frame, view, dimension, curve() and the values of the Int, Double, Color, Boolean and Choice parameters
+ * of the nodes reachable from the expression (thisParam, thisNode, thisGroup and the sibling nodes).
+ * The parameters are resolved once, when the expression is compiled. Anything else is left to Python.
+ *
+ * The result is the one the Python expression would give, including the Python integer semantics: when the
+ * evaluation would raise an exception in Python (division by zero, math domain error, overflow...) evaluate()
+ * fails and the expression should be run by Python, which reports the error.
+ **/
+class KnobExpression
+{
+    KnobExpression();
+
+public:
+
+    ~KnobExpression();
+
+    /**
+     * @brief Compiles the given expression of the knob. Returns NULL if the expression is not in the supported subset.
+     * The Python GIL must be held: the global names of the expression are checked against the Python main module.
+     **/
+    static KnobExpressionPtr compile(KnobHelper* knob, int dimension, const std::string& expression);
+
+    /**
+     * @brief Evaluates the expression at the given time and view. The result is what the Python conversion of the
+     * returned object to a double would give (an int for Int knobs). This is MT-safe and does not take the GIL.
+     * Returns false if the expression cannot be evaluated natively: it should then be evaluated by Python.
+     **/
+    bool evaluate(double time, ViewIdx view, double* ret) const WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Globally enables or disables the native evaluation, so that all expressions are run by Python.
+     * This is used to compare both in the tests.
+     **/
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+private:
+
+    boost::scoped_ptr<KnobExpressionPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_KNOBEXPRESSION_H
@@ -55,6 +55,7 @@ GCC_DIAG_ON(unused-parameter)
 #include "Engine/AppInstance.h"
 #include "Engine/Project.h"
 #include "Engine/EffectInstance.h"
+#include "Engine/KnobExpression.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/EngineFwd.h"
@@ -107,6 +108,7 @@ Knob<T>::Knob(KnobHolder*  holder,
     , _guiValues(dimension)
     , _defaultValues(dimension)
     , _exprRes(dimension)
+    , _exprResAge(dimension, 0)
     , _minMaxMutex(QReadWriteLock::Recursive)
     , _minimums(dimension)
     , _maximums(dimension)
@@ -387,6 +389,24 @@ KnobHelper::pyObjectToType(PyObject* o)
     return std::string( PyString_AsString(o) );
 }
 
+/// Converts the result of a native expression (see KnobExpression::evaluate) as pyObjectToType converts the Python object
+template <typename T>
+inline T
+nativeExpressionResultToType(double v)
+{
+    return (T)v;
+}
+
+template <>
+inline std::string
+nativeExpressionResultToType(double /*v*/)
+{
+    // string knobs do not have native expressions
+    assert(false);
+
+    return std::string();
+}
+
 inline unsigned int
 hashFunction(unsigned int a)
 {
@@ -475,6 +495,71 @@ Knob<T>::evaluateExpression_pod(double time,
     return true;
 }
 
+template <typename T>
+bool
+Knob<T>::getCachedExpressionResult(double time,
+                                   int dimension,
+                                   bool clamp,
+                                   T* ret,
+                                   U64* age) const
+{
+    QMutexLocker k(&_valueMutex);
+
+    *age = _exprResAge[dimension];
+    typename FrameValueMap::const_iterator found = _exprRes[dimension].find(time);
+    if ( found == _exprRes[dimension].end() ) {
+        return false;
+    }
+    // the results are not clamped, so that they do not depend on the first caller
+    *ret = clamp ? clampToMinMax(found->second, dimension) : found->second;
+
+    return true;
+}
+
+template <typename T>
+void
+Knob<T>::cacheExpressionResult(double time,
+                               int dimension,
+                               const T& value,
+                               U64 age)
+{
+    QMutexLocker k(&_valueMutex);
+
+    if (_exprResAge[dimension] != age) {
+        // the knob (or a knob it depends on) changed during the evaluation
+        return;
+    }
+    _exprRes[dimension].insert( std::make_pair(time, value) );
+}
+
+template <typename T>
+bool
+Knob<T>::evaluateNativeExpression(double time,
+                                  ViewIdx view,
+                                  int dimension,
+                                  double* ret)
+{
+    if ( !KnobExpression::isEnabled() ) {
+        return false;
+    }
+    KnobExpressionPtr native = getNativeExpression(dimension);
+    if (!native) {
+        return false;
+    }
+    {
+        EXPR_RECURSION_LEVEL();
+        if ( !native->evaluate(time, view, ret) ) {
+            // Python raises the error, if any
+            return false;
+        }
+    }
+    if ( !isExpressionValid(dimension, 0) ) {
+        setExpressionInvalid( dimension, true, std::string() );
+    }
+
+    return true;
+}
+
 template <typename T>
 bool
 Knob<T>::getValueFromExpression(double time,
@@ -490,15 +575,29 @@ Knob<T>::getValueFromExpression(double time,
 
 
     ///Check first if a value was already computed:
+    U64 age;
+    if ( getCachedExpressionResult(time, dimension, clamp, ret, &age) ) {
+        return true;
+    }
 
-    {
-        QMutexLocker k(&_valueMutex);
-        typename FrameValueMap::iterator found = _exprRes[dimension].find(time);
-        if ( found != _exprRes[dimension].end() ) {
-            *ret = found->second;
-
-            return true;
+    ///Simple expressions are evaluated without Python, and without the GIL
+    double nativeRet;
+    if ( evaluateNativeExpression(time, view, dimension, &nativeRet) ) {
+        *ret = nativeExpressionResultToType<T>(nativeRet);
+        cacheExpressionResult(time, dimension, *ret, age);
+        if (clamp) {
+            *ret =  clampToMinMax(*ret, dimension);
         }
+
+        return true;
+    }
+
+    ///The evaluation takes the Python and Natron GILs anyway: take them before checking again, so that when
+    ///all the render threads of a frame (one per tile) ask for the same value, the expression is evaluated only
+    ///by the first one and the others get its result.
+    PythonGILLocker pgl;
+    if ( getCachedExpressionResult(time, dimension, clamp, ret, &age) ) {
+        return true;
     }
 
     bool exprWasValid = isExpressionValid(dimension, 0);
@@ -517,13 +616,12 @@ Knob<T>::getValueFromExpression(double time,
         }
     }
 
+    cacheExpressionResult(time, dimension, *ret, age);
+
     if (clamp) {
         *ret =  clampToMinMax(*ret, dimension);
     }
 
-    QMutexLocker k(&_valueMutex);
-    _exprRes[dimension].insert( std::make_pair(time, *ret) );
-
     return true;
 }
 
@@ -577,17 +675,30 @@ Knob<T>::getValueFromExpression_pod(double time,
     }
 
 
-    ///Check first if a value was already computed:
+    ///Check first if a value was already computed (@see getValueFromExpression):
+    U64 age;
+    T cached;
+    if ( getCachedExpressionResult(time, dimension, clamp, &cached, &age) ) {
+        *ret = cached;
 
+        return true;
+    }
 
-    QMutexLocker k(&_valueMutex);
-    typename FrameValueMap::iterator found = _exprRes[dimension].find(time);
-    if ( found != _exprRes[dimension].end() ) {
-        *ret = found->second;
+    if ( evaluateNativeExpression(time, view, dimension, ret) ) {
+        cacheExpressionResult(time, dimension, (T)*ret, age);
+        if (clamp) {
+            *ret =  clampToMinMax(*ret, dimension);
+        }
 
         return true;
     }
 
+    PythonGILLocker pgl;
+    if ( getCachedExpressionResult(time, dimension, clamp, &cached, &age) ) {
+        *ret = cached;
+
+        return true;
+    }
 
     bool exprWasValid = isExpressionValid(dimension, 0);
     {
@@ -605,13 +716,12 @@ Knob<T>::getValueFromExpression_pod(double time,
         }
     }
 
+    cacheExpressionResult(time, dimension, (T)*ret, age);
+
     if (clamp) {
         *ret =  clampToMinMax(*ret, dimension);
     }
 
-    //QWriteLocker k(&_valueMutex);
-    _exprRes[dimension].insert( std::make_pair(time, *ret) );
-
     return true;
 }
 
@@ -2719,6 +2829,7 @@ Knob<T>::cloneExpressionsResults(KnobI* other,
             otherKnob->getExpressionResults(i, results);
             QMutexLocker k(&_valueMutex);
             _exprRes[i] = results;
+            ++_exprResAge[i];
         }
     } else {
         if (otherDimension == -1) {
@@ -2728,6 +2839,7 @@ Knob<T>::cloneExpressionsResults(KnobI* other,
         otherKnob->getExpressionResults(otherDimension, results);
         QMutexLocker k(&_valueMutex);
         _exprRes[dimension] = results;
+        ++_exprResAge[dimension];
     }
 }
 
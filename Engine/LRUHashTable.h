@@ -45,6 +45,7 @@
 #include <map>
 #include <list>
 #include <utility>
+#include <algorithm>
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 CLANG_DIAG_OFF(unknown-pragmas)
 CLANG_DIAG_OFF(redeclared-class-member)
@@ -58,6 +59,7 @@ CLANG_DIAG_ON(unknown-pragmas)
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #endif
 
+#include "Global/Enums.h"
 #include "Engine/EngineFwd.h"
 
 
@@ -65,6 +67,16 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #define NATRON_CACHE_USE_HASH
 #define NATRON_CACHE_USE_BOOST
 
+// With eCacheReplacementPolicy2Q, the probationary segment is evicted first while it holds more than 1/N of the records
+#define NATRON_CACHE_2Q_PROBATION_DIVISOR 4
+
+// Number of look-ups after which a probationary record is protected. The first look-up usually comes from
+// the same render that inserted the record, so it does not tell that the record is re-used.
+#define NATRON_CACHE_2Q_PROMOTION_HITS 2
+
+// Minimum number of keys remembered in the ghost list of the 2Q policy, it holds at most half the number of records otherwise
+#define NATRON_CACHE_2Q_MIN_GHOSTS 64
+
 
 /**@brief 4 types of LRU caches are defined here:
  *
@@ -131,6 +143,16 @@ public:
     {
     }
 
+    // Only eCacheReplacementPolicyLRU is implemented by this container
+    void setReplacementPolicy(NATRON_NAMESPACE::CacheReplacementPolicyEnum /*policy*/)
+    {
+    }
+
+    NATRON_NAMESPACE::CacheReplacementPolicyEnum getReplacementPolicy() const
+    {
+        return NATRON_NAMESPACE::eCacheReplacementPolicyLRU;
+    }
+
     // Obtain value of the cached function for k
     typename key_to_value_type::iterator operator()(const key_type & k)
     {
@@ -146,6 +168,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record
+    typename key_to_value_type::iterator find(const key_type & k)
+    {
+        return _key_to_value.find(k);
+    }
+
     void erase(typename key_to_value_type::iterator it)
     {
         _key_tracker.erase(it->second.second);
@@ -264,6 +292,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record
+    typename container_type::left_iterator find(const key_type & k)
+    {
+        return _container.left.find(k);
+    }
+
     void erase(typename container_type::left_iterator it)
     {
         _container.left.erase(it);
@@ -365,6 +399,16 @@ public:
     {
     }
 
+    // Only eCacheReplacementPolicyLRU is implemented by this container
+    void setReplacementPolicy(NATRON_NAMESPACE::CacheReplacementPolicyEnum /*policy*/)
+    {
+    }
+
+    NATRON_NAMESPACE::CacheReplacementPolicyEnum getReplacementPolicy() const
+    {
+        return NATRON_NAMESPACE::eCacheReplacementPolicyLRU;
+    }
+
     // Obtain value of the cached function for k
     typename key_to_value_type::iterator operator()(const key_type & k)
     {
@@ -380,6 +424,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record
+    typename key_to_value_type::iterator find(const key_type & k)
+    {
+        return _key_to_value.find(k);
+    }
+
     void erase(typename key_to_value_type::iterator it)
     {
         _key_tracker.erase(it->second.second);
@@ -469,18 +519,72 @@ private:
 #  else // NATRON_CACHE_USE_BOOST
 
 #    ifdef NATRON_CACHE_USE_HASH
+
+/**
+ * @brief The records are kept in a single access list split in 2 segments:
+ * [probationary records, oldest first | protected records, least recently used first].
+ * With eCacheReplacementPolicyLRU every record is protected and this is a plain LRU.
+ * With eCacheReplacementPolicy2Q new records are appended to the probationary segment, which
+ * is a FIFO: they are promoted to the protected segment only once they have been looked-up
+ * NATRON_CACHE_2Q_PROMOTION_HITS times. The probationary segment is evicted first as long as it
+ * holds more than 1/NATRON_CACHE_2Q_PROBATION_DIVISOR of the records, so that a one-pass scan
+ * (scrubbing the timeline, a background render) only recycles its own records.
+ * The keys of the records evicted from the probationary segment are remembered in a ghost list:
+ * a record inserted again while its key is still there goes directly to the protected segment.
+ **/
 template <typename K, typename V>
 class BoostLRUHashTable
 {
+    struct RecordInfo
+    {
+        bool isProtected;
+        int nProbationHits;
+
+        RecordInfo(bool isProtected)
+            : isProtected(isProtected)
+            , nProbationHits(0)
+        {
+        }
+    };
+
 public:
     typedef K key_type;
     typedef std::list<V> value_type;
-    typedef boost::bimaps::bimap<boost::bimaps::unordered_set_of<key_type>, boost::bimaps::list_of<value_type> > container_type;
+    typedef boost::bimaps::bimap<boost::bimaps::unordered_set_of<key_type>, boost::bimaps::list_of<value_type>, boost::bimaps::with_info<RecordInfo> > container_type;
+
+private:
+    typedef typename container_type::right_iterator list_iterator;
+
+    // Keys of the records evicted from the probationary segment, oldest first
+    typedef boost::bimaps::bimap<boost::bimaps::unordered_set_of<key_type>, boost::bimaps::list_of<char> > ghost_container_type;
+
+public:
 
     BoostLRUHashTable()
+        : _policy(NATRON_NAMESPACE::eCacheReplacementPolicyLRU)
+        , _container()
+        , _ghosts()
+        , _firstProtected()
+        , _nProbation(0)
+    {
+        _firstProtected = _container.right.end();
+    }
+
+    void setReplacementPolicy(NATRON_NAMESPACE::CacheReplacementPolicyEnum policy)
+    {
+        _policy = policy;
+        if (_policy == NATRON_NAMESPACE::eCacheReplacementPolicyLRU) {
+            // Records still in probation are promoted on their next look-up and evicted first meanwhile
+            _ghosts.clear();
+        }
+    }
+
+    NATRON_NAMESPACE::CacheReplacementPolicyEnum getReplacementPolicy() const
     {
+        return _policy;
     }
 
+    // Look-up of k on behalf of a cache user: counts as a hit of the record
     typename container_type::left_iterator operator()(const key_type & k)
     {
         // Attempt to find existing record
@@ -488,14 +592,37 @@ public:
         if ( it != _container.left.end() ) {
             // We do have it:
             // Update the access record view.
-            _container.right.relocate( _container.right.end(), _container.project_right(it) );
+            if (it->info.isProtected) {
+                moveToProtectedBack( _container.project_right(it) );
+            } else {
+                ++it->info.nProbationHits;
+                if ( (_policy == NATRON_NAMESPACE::eCacheReplacementPolicyLRU) || (it->info.nProbationHits >= NATRON_CACHE_2Q_PROMOTION_HITS) ) {
+                    it->info.isProtected = true;
+                    --_nProbation;
+                    moveToProtectedBack( _container.project_right(it) );
+                }
+            }
         }
 
         return it;
     }
 
+    // Find the record of k without updating the access record nor counting a probation hit
+    typename container_type::left_iterator find(const key_type & k)
+    {
+        return _container.left.find(k);
+    }
+
     void erase(typename container_type::left_iterator it)
     {
+        list_iterator listIt = _container.project_right(it);
+
+        if (listIt == _firstProtected) {
+            ++_firstProtected;
+        }
+        if (!it->info.isProtected) {
+            --_nProbation;
+        }
         _container.left.erase(it);
     }
 
@@ -514,59 +641,166 @@ public:
     void insert(const key_type & k,
                 const value_type& list)
     {
-        _container.insert( typename container_type::value_type(k, list) );
+        bool isProtected = (_policy == NATRON_NAMESPACE::eCacheReplacementPolicyLRU);
+
+        if (!isProtected) {
+            typename ghost_container_type::left_iterator ghost = _ghosts.left.find(k);
+            if ( ghost != _ghosts.left.end() ) {
+                // Evicted recently: this record is part of the working set
+                _ghosts.left.erase(ghost);
+                isProtected = true;
+            }
+        }
+
+        std::pair<typename container_type::left_iterator, bool> inserted =
+            _container.left.insert( typename container_type::left_value_type( k, list, RecordInfo(isProtected) ) );
+        if (!inserted.second) {
+            return;
+        }
+
+        // The new record is at the back of the access list
+        list_iterator listIt = _container.project_right(inserted.first);
+        if (isProtected) {
+            if ( _firstProtected == _container.right.end() ) {
+                _firstProtected = listIt;
+            }
+        } else {
+            ++_nProbation;
+            if ( _firstProtected != _container.right.end() ) {
+                _container.right.relocate(_firstProtected, listIt);
+            }
+        }
     }
 
     void insert(const key_type & k,
                 const V & v)
     {
-        // Create a new record from the key and the value
-        // bimap's list_view defaults to inserting this at
-        // the list tail (considered most-recently-used).
-        typename container_type::left_iterator found = this->operator ()(k);
+        // Appending a value is not a look-up: it does not count towards the promotion of a probationary record
+        typename container_type::left_iterator found = find(k);
         if ( found != _container.left.end() ) {
             found->second.push_back(v);
+            if (found->info.isProtected) {
+                moveToProtectedBack( _container.project_right(found) );
+            }
         } else {
             value_type list;
             list.push_back(v);
-            _container.insert( typename container_type::value_type(k, list) );
+            insert(k, list);
         }
     }
 
     void clear()
     {
         _container.clear();
+        _ghosts.clear();
+        _firstProtected = _container.right.end();
+        _nProbation = 0;
     }
 
     std::pair<key_type, V> evict()
     {
-        typename container_type::right_iterator it = _container.right.begin();
-        while ( it != _container.right.end() ) {
+        bool found = false;
+        std::pair<key_type, V> ret;
+
+        if ( (_policy == NATRON_NAMESPACE::eCacheReplacementPolicy2Q) &&
+             (_nProbation * NATRON_CACHE_2Q_PROBATION_DIVISOR <= _container.size()) ) {
+            // The probationary segment is within its share: evict the least recently used protected record first
+            ret = evictInRange(_firstProtected, _container.right.end(), &found);
+            if (!found) {
+                ret = evictInRange(_container.right.begin(), _firstProtected, &found);
+            }
+        } else {
+            // Probationary records are at the front of the access list
+            ret = evictInRange(_container.right.begin(), _container.right.end(), &found);
+        }
+
+        return ret;
+    }
+
+    unsigned int size()
+    {
+        return _container.size();
+    }
+
+private:
+
+    // Non copyable: _firstProtected is an iterator in the access list of this container
+    BoostLRUHashTable(const BoostLRUHashTable &);
+    BoostLRUHashTable & operator=(const BoostLRUHashTable &);
+
+    void moveToProtectedBack(list_iterator listIt)
+    {
+        if (listIt == _firstProtected) {
+            ++_firstProtected;
+            if ( _firstProtected == _container.right.end() ) {
+                // Already the most recently used record
+                _firstProtected = listIt;
+
+                return;
+            }
+        }
+        _container.right.relocate(_container.right.end(), listIt);
+        if ( _firstProtected == _container.right.end() ) {
+            _firstProtected = listIt;
+        }
+    }
+
+    /**
+     * @brief Evicts the first value in [first, last[ that is not referenced outside of the cache.
+     **/
+    std::pair<key_type, V> evictInRange(list_iterator first,
+                                        list_iterator last,
+                                        bool* found)
+    {
+        for (list_iterator it = first; it != last; ++it) {
             for (typename std::list<V>::iterator it2 = it->first.begin(); it2 != it->first.end(); ++it2) {
                 if (it2->use_count() == 1) {
                     std::pair<key_type, V> ret = std::make_pair(it->second, *it2);
                     if (it->first.size() == 1) {
+                        bool wasProbation = !it->info.isProtected;
+                        if (it == _firstProtected) {
+                            ++_firstProtected;
+                        }
+                        if (wasProbation) {
+                            --_nProbation;
+                        }
                         _container.right.erase(it);
+                        if ( wasProbation && (_policy == NATRON_NAMESPACE::eCacheReplacementPolicy2Q) ) {
+                            rememberGhost(ret.first);
+                        }
                     } else {
                         it->first.erase(it2);
                     }
+                    *found = true;
 
                     return ret;
                 }
             }
-            ++it;
         }
+        *found = false;
 
         return std::make_pair( key_type(), V() );
     }
 
-    unsigned int size()
+    void rememberGhost(const key_type & k)
     {
-        return _container.size();
+        _ghosts.insert( typename ghost_container_type::value_type(k, 0) );
+
+        std::size_t maxGhosts = std::max( (std::size_t)NATRON_CACHE_2Q_MIN_GHOSTS, (std::size_t)_container.size() / 2 );
+        while (_ghosts.size() > maxGhosts) {
+            _ghosts.right.erase( _ghosts.right.begin() );
+        }
     }
 
-private:
+    NATRON_NAMESPACE::CacheReplacementPolicyEnum _policy;
     container_type _container;
+    ghost_container_type _ghosts;
+
+    // First record of the protected segment in the access list, or its end if the protected segment is empty
+    list_iterator _firstProtected;
+
+    // Number of records in the probationary segment
+    std::size_t _nProbation;
 };
 
 #    else // !NATRON_CACHE_USE_HASH
@@ -596,6 +830,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record
+    typename container_type::left_iterator find(const key_type & k)
+    {
+        return _container.left.find(k);
+    }
+
     void erase(typename container_type::left_iterator it)
     {
         _container.left.erase(it);
@@ -29,6 +29,7 @@
 #include <cassert>
 #include <stdexcept>
 
+#include "Engine/ImageConvertSIMD.h"
 #include "Engine/RectI.h"
 
 /*
@@ -261,62 +262,96 @@ Lut::toColorSpaceUint8xxFromLinearFloatFast(float v) const
     return toFunc_hipart_to_uint8xx[hipart(v)];
 }
 
-// the following only works for increasing LUTs
+float
+Lut::fromColorSpaceFloatToLinearFloatFast(float v) const
+{
+    assert(init_);
+
+    return ImageConvertSIMD::lutFloatToFloatPixel(&fromFunc_half_to_float[0], _fromFunc, v);
+}
+
+float
+Lut::toColorSpaceFloatFromLinearFloatFast(float v) const
+{
+    assert(init_);
+
+    return ImageConvertSIMD::lutFloatToFloatPixel(&toFunc_half_to_float[0], _toFunc, v);
+}
+
 unsigned short
 Lut::toColorSpaceUint16FromLinearFloatFast(float v) const
 {
     assert(init_);
-    // algorithm:
-    // - convert to 8 bits -> val8u
-    // - convert val8u-1, val8u and val8u+1 to float
-    // - interpolate linearly in the right interval
-    unsigned char v8u = toColorSpaceUint8FromLinearFloatFast(v);
-    unsigned char v8u_next, v8u_prev;
-    float v32f_next, v32f_prev;
-    if (v8u == 0) {
-        v8u_prev = 0;
-        v8u_next = 1;
-        v32f_prev = fromColorSpaceUint8ToLinearFloatFast(0);
-        v32f_next = fromColorSpaceUint8ToLinearFloatFast(1);
-    } else if (v8u == 255) {
-        v8u_prev = 254;
-        v8u_next = 255;
-        v32f_prev = fromColorSpaceUint8ToLinearFloatFast(254);
-        v32f_next = fromColorSpaceUint8ToLinearFloatFast(255);
-    } else {
-        float v32f = fromColorSpaceUint8ToLinearFloatFast(v8u);
-        // we suppose the LUT is an increasing func
-        if (v < v32f) {
-            v8u_prev = v8u - 1;
-            v32f_prev = fromColorSpaceUint8ToLinearFloatFast(v8u_prev);
-            v8u_next = v8u;
-            v32f_next = v32f;
-        } else {
-            v8u_prev = v8u;
-            v32f_prev = v32f;
-            v8u_next = v8u + 1;
-            v32f_next = fromColorSpaceUint8ToLinearFloatFast(v8u_next);
-        }
-    }
 
-    // interpolate linearly
-    return (v8u_prev << 8) + v8u_prev + (v - v32f_prev) * ( ( (v8u_next - v8u_prev) << 8 ) + (v8u_next + v8u_prev) ) / (v32f_next - v32f_prev) + 0.5;
+    return Color::floatToInt<65536>( toColorSpaceFloatFromLinearFloatFast(v) );
 }
 
 float
 Lut::fromColorSpaceUint16ToLinearFloatFast(unsigned short v) const
 {
     assert(init_);
-    // the following is from ImageMagick's quantum.h
-    unsigned char v8u_prev = ( v - (v >> 8) ) >> 8;
-    unsigned char v8u_next = v8u_prev + 1;
-    unsigned short v16u_prev = (v8u_prev << 8) + v8u_prev;
-    unsigned short v16u_next = (v8u_next << 8) + v8u_next;
-    float v32f_prev = fromColorSpaceUint8ToLinearFloatFast(v8u_prev);
-    float v32f_next = fromColorSpaceUint8ToLinearFloatFast(v8u_next);
 
-    // interpolate linearly
-    return v32f_prev + (v - v16u_prev) * (v32f_next - v32f_prev) / (v16u_next - v16u_prev);
+    return fromFunc_uint16_to_float[v];
+}
+
+void
+Lut::toColorSpaceUint8xxFromLinearFloatFast(const float* from,
+                                            unsigned short* to,
+                                            int n) const
+{
+    assert(init_);
+    ImageConvertSIMD::lutFloatToUint8xx(toFunc_hipart_to_uint8xx, from, to, n);
+}
+
+void
+Lut::fromColorSpaceUint8ToLinearFloatFast(const unsigned char* from,
+                                          float* to,
+                                          int n) const
+{
+    assert(init_);
+    ImageConvertSIMD::lutUint8ToFloat(fromFunc_uint8_to_float, from, to, n);
+}
+
+void
+Lut::fromColorSpaceUint16ToLinearFloatFast(const unsigned short* from,
+                                           float* to,
+                                           int n) const
+{
+    assert(init_);
+    ImageConvertSIMD::lutUint16ToFloat(&fromFunc_uint16_to_float[0], from, to, n);
+}
+
+void
+Lut::fromColorSpaceFloatToLinearFloatFast(const float* from,
+                                          float* to,
+                                          int n) const
+{
+    assert(init_);
+    ImageConvertSIMD::lutFloatToFloat(&fromFunc_half_to_float[0], _fromFunc, from, to, n);
+}
+
+void
+Lut::toColorSpaceFloatFromLinearFloatFast(const float* from,
+                                          float* to,
+                                          int n) const
+{
+    assert(init_);
+    ImageConvertSIMD::lutFloatToFloat(&toFunc_half_to_float[0], _toFunc, from, to, n);
+}
+
+void
+Lut::toColorSpaceUint16FromLinearFloatFast(const float* from,
+                                           unsigned short* to,
+                                           int n) const
+{
+    assert(init_);
+    // Convert by chunks that fit in the cache
+    float buffer[1024];
+    for (int i = 0; i < n; i += 1024) {
+        const int chunk = std::min(n - i, 1024);
+        ImageConvertSIMD::lutFloatToFloat(&toFunc_half_to_float[0], _toFunc, from + i, buffer, chunk);
+        ImageConvertSIMD::floatToShort(buffer, to + i, chunk);
+    }
 }
 
 void
@@ -342,6 +377,19 @@ Lut::fillTables() const
         int i = hipart(f);
         toFunc_hipart_to_uint8xx[i] = Color::charToUint8xx(b);
     }
+    // the 16-bit table contains the exact transform of each value,
+    // and the byte values give the same floats as fromFunc_uint8_to_float
+    fromFunc_uint16_to_float.resize(0x10000);
+    for (int i = 0; i < 0x10000; ++i) {
+        fromFunc_uint16_to_float[i] = _fromFunc( Color::intToFloat<65536>(i) );
+    }
+    fromFunc_half_to_float.resize(NATRON_LUT_FLOAT_TABLE_SIZE);
+    toFunc_half_to_float.resize(NATRON_LUT_FLOAT_TABLE_SIZE);
+    for (unsigned int i = 0; i < NATRON_LUT_FLOAT_TABLE_SIZE; ++i) {
+        float inp = ImageConvertSIMD::lutFloatIndexToFloat(i);
+        fromFunc_half_to_float[i] = _fromFunc(inp);
+        toFunc_half_to_float[i] = _toFunc(inp);
+    }
 }
 
 #ifdef DEAD_CODE
@@ -423,11 +471,11 @@ Lut::to_float_planar(float* to,
     validate();
     if (!alpha) {
         for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = toColorSpaceFloatFromLinearFloat(from[f]);
+            to[t] = toColorSpaceFloatFromLinearFloatFast(from[f]);
         }
     } else {
         for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = toColorSpaceFloatFromLinearFloat(from[f] * alpha[f]);
+            to[t] = toColorSpaceFloatFromLinearFloatFast(from[f] * alpha[f]);
         }
     }
 }
@@ -516,22 +564,61 @@ Lut::to_byte_packed(unsigned char* to,
     }
 } // to_byte_packed
 
-#ifdef DEAD_CODE
 void
-Lut::to_short_packed(unsigned short* /*to*/,
-                     const float* /*from*/,
-                     const RectI & /*conversionRect*/,
-                     const RectI & /*srcBounds*/,
-                     const RectI & /*dstBounds*/,
-                     PixelPackingEnum /*inputPacking*/,
-                     PixelPackingEnum /*outputPacking*/,
-                     bool /*invertY*/,
-                     bool /*premult*/) const
+Lut::to_short_packed(unsigned short* to,
+                     const float* from,
+                     const RectI & conversionRect,
+                     const RectI & srcBounds,
+                     const RectI & dstBounds,
+                     PixelPackingEnum inputPacking,
+                     PixelPackingEnum outputPacking,
+                     bool invertY,
+                     bool premult) const
 {
-    throw std::runtime_error("Lut::to_short_packed not implemented yet.");
-}
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
 
-#endif // DEAD_CODE
+    if ( !clip(&rect, srcBounds) || !clip(&rect, dstBounds) ) {
+        return;
+    }
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+    int inPackingSize, outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+    validate();
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+
+        int dstY = dstBounds.y2 - y - 1;
+        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
+        unsigned short *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        for (int x = rect.x1; x < rect.x2; ++x) {
+            int inCol = x * inPackingSize;
+            int outCol = x * outPackingSize;
+            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
+            // 16 bits are precise enough, there is no need for error diffusion
+            dst_pixels[outCol + outROffset] = toColorSpaceUint16FromLinearFloatFast(src_pixels[inCol + inROffset] * a);
+            dst_pixels[outCol + outGOffset] = toColorSpaceUint16FromLinearFloatFast(src_pixels[inCol + inGOffset] * a);
+            dst_pixels[outCol + outBOffset] = toColorSpaceUint16FromLinearFloatFast(src_pixels[inCol + inBOffset] * a);
+            if (outputHasAlpha) {
+                // alpha is linear
+                dst_pixels[outCol + outAOffset] = floatToInt<65536>(a);
+            }
+        }
+    }
+} // to_short_packed
 
 void
 Lut::to_float_packed(float* to,
@@ -578,9 +665,9 @@ Lut::to_float_packed(float* to,
             int inCol = x * inPackingSize;
             int outCol = x * outPackingSize;
             float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;;
-            dst_pixels[outCol + outROffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inROffset] * a);
-            dst_pixels[outCol + outGOffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inGOffset] * a);
-            dst_pixels[outCol + outBOffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inBOffset] * a);
+            dst_pixels[outCol + outROffset] = toColorSpaceFloatFromLinearFloatFast(src_pixels[inCol + inROffset] * a);
+            dst_pixels[outCol + outGOffset] = toColorSpaceFloatFromLinearFloatFast(src_pixels[inCol + inGOffset] * a);
+            dst_pixels[outCol + outBOffset] = toColorSpaceFloatFromLinearFloatFast(src_pixels[inCol + inBOffset] * a);
             if (outputHasAlpha) {
                 // alpha is linear and should not be dithered
                 dst_pixels[outCol + outAOffset] = a;
@@ -610,14 +697,24 @@ Lut::from_byte_planar(float* to,
 }
 
 void
-Lut::from_short_planar(float* /*to*/,
-                       const unsigned short* /*from*/,
-                       int /*W*/,
-                       const unsigned short*/* alpha*/,
-                       int /*inDelta*/,
-                       int /* outDelta*/) const
+Lut::from_short_planar(float* to,
+                       const unsigned short* from,
+                       int W,
+                       const unsigned short* alpha,
+                       int inDelta,
+                       int outDelta) const
 {
-    throw std::runtime_error("Lut::from_short_planar not implemented yet.");
+    validate();
+    if (!alpha) {
+        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
+            to[t] = fromFunc_uint16_to_float[from[f]];
+        }
+    } else {
+        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
+            float a = Color::intToFloat<65536>(alpha[f]);
+            to[t] = a <= 0. ? 0. : fromColorSpaceFloatToLinearFloatFast(Color::intToFloat<65536>(from[f]) / a) * a;
+        }
+    }
 }
 
 void
@@ -631,12 +728,12 @@ Lut::from_float_planar(float* to,
     validate();
     if (!alpha) {
         for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = fromColorSpaceFloatToLinearFloat(from[f]);
+            to[t] = fromColorSpaceFloatToLinearFloatFast(from[f]);
         }
     } else {
         for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
             float a = alpha[f];
-            to[t] = a <= 0. ? 0. : fromColorSpaceFloatToLinearFloat(from[f] / a) * a;
+            to[t] = a <= 0. ? 0. : fromColorSpaceFloatToLinearFloatFast(from[f] / a) * a;
         }
     }
 }
@@ -722,18 +819,79 @@ Lut::from_byte_packed(float* to,
 } // from_byte_packed
 
 void
-Lut::from_short_packed(float* /*to*/,
-                       const unsigned short* /*from*/,
-                       const RectI & /*conversionRect*/,
-                       const RectI & /*srcBounds*/,
-                       const RectI & /*dstBounds*/,
-                       PixelPackingEnum /*inputPacking*/,
-                       PixelPackingEnum /*outputPacking*/,
-                       bool /*invertY*/,
-                       bool /*premult*/) const
+Lut::from_short_packed(float* to,
+                       const unsigned short* from,
+                       const RectI & conversionRect,
+                       const RectI & srcBounds,
+                       const RectI & dstBounds,
+                       PixelPackingEnum inputPacking,
+                       PixelPackingEnum outputPacking,
+                       bool invertY,
+                       bool premult) const
 {
-    throw std::runtime_error("Lut::from_short_packed not implemented yet.");
-}
+    if ( ( inputPacking == ePixelPackingPLANAR) || ( outputPacking == ePixelPackingPLANAR) ) {
+        throw std::runtime_error("Invalid pixel format.");
+    }
+
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
+    if ( !clip(&rect, srcBounds) || !clip(&rect, dstBounds) ) {
+        return;
+    }
+
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+    int inPackingSize, outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+    validate();
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+
+        const unsigned short *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
+        float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        for (int x = rect.x1; x < rect.x2; ++x) {
+            int inCol = x * inPackingSize;
+            int outCol = x * outPackingSize;
+            if (inputHasAlpha && premult) {
+                float rf = 0., gf = 0., bf = 0.;
+                float a = Color::intToFloat<65536>(src_pixels[inCol + inAOffset]);
+                if (a > 0) {
+                    rf = Color::intToFloat<65536>(src_pixels[inCol + inROffset]) / a;
+                    gf = Color::intToFloat<65536>(src_pixels[inCol + inGOffset]) / a;
+                    bf = Color::intToFloat<65536>(src_pixels[inCol + inBOffset]) / a;
+                }
+                // unlike bytes, the unpremultiplied values are not quantized again
+                dst_pixels[outCol + outROffset] = fromColorSpaceFloatToLinearFloatFast(rf) * a;
+                dst_pixels[outCol + outGOffset] = fromColorSpaceFloatToLinearFloatFast(gf) * a;
+                dst_pixels[outCol + outBOffset] = fromColorSpaceFloatToLinearFloatFast(bf) * a;
+                if (outputHasAlpha) {
+                    // alpha is linear
+                    dst_pixels[outCol + outAOffset] = a;
+                }
+            } else {
+                dst_pixels[outCol + outROffset] = fromFunc_uint16_to_float[src_pixels[inCol + inROffset]];
+                dst_pixels[outCol + outGOffset] = fromFunc_uint16_to_float[src_pixels[inCol + inGOffset]];
+                dst_pixels[outCol + outBOffset] = fromFunc_uint16_to_float[src_pixels[inCol + inBOffset]];
+                if (outputHasAlpha) {
+                    // alpha is linear
+                    float a = inputHasAlpha ? Color::intToFloat<65536>(src_pixels[inCol + inAOffset]) : 1.f;
+                    dst_pixels[outCol + outAOffset] = a;
+                }
+            }
+        }
+    }
+} // from_short_packed
 
 void
 Lut::from_float_packed(float* to,
@@ -787,9 +945,9 @@ Lut::from_float_packed(float* to,
                 gf = src_pixels[inCol + inGOffset] / a;
                 bf = src_pixels[inCol + inBOffset] / a;
             }
-            dst_pixels[outCol + outROffset] = fromColorSpaceFloatToLinearFloat(rf) * a;
-            dst_pixels[outCol + outGOffset] = fromColorSpaceFloatToLinearFloat(gf) * a;
-            dst_pixels[outCol + outBOffset] = fromColorSpaceFloatToLinearFloat(bf) * a;
+            dst_pixels[outCol + outROffset] = fromColorSpaceFloatToLinearFloatFast(rf) * a;
+            dst_pixels[outCol + outGOffset] = fromColorSpaceFloatToLinearFloatFast(gf) * a;
+            dst_pixels[outCol + outBOffset] = fromColorSpaceFloatToLinearFloatFast(bf) * a;
             if (outputHasAlpha) {
                 // alpha is linear
                 dst_pixels[outCol + outAOffset] = a;
@@ -904,16 +1062,59 @@ from_byte_packed(float *to,
 }
 
 void
-from_short_packed(float */*to*/,
-                  const unsigned short */*from*/,
-                  const RectI & /*rect*/,
-                  const RectI & /*srcRod*/,
-                  const RectI & /*rod*/,
-                  PixelPackingEnum /*inputFormat*/,
-                  PixelPackingEnum /*format*/,
-                  bool /*invertY*/)
-{
-    throw std::runtime_error("Linear::from_short_packed not yet implemented.");
+from_short_packed(float *to,
+                  const unsigned short *from,
+                  const RectI &conversionRect,
+                  const RectI &srcBounds,
+                  const RectI &dstBounds,
+                  PixelPackingEnum inputPacking,
+                  PixelPackingEnum outputPacking,
+                  bool invertY)
+{
+    if ( ( inputPacking == ePixelPackingPLANAR) || ( outputPacking == ePixelPackingPLANAR) ) {
+        throw std::runtime_error("Invalid pixel format.");
+    }
+
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
+    if ( !clip(&rect, srcBounds) || !clip(&rect, dstBounds) ) {
+        return;
+    }
+
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+
+    int inPackingSize, outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+        const unsigned short *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
+        float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        for (int x = rect.x1; x < rect.x2; ++x) {
+            int inCol = x * inPackingSize;
+            int outCol = x * outPackingSize;
+            unsigned short a = inputHasAlpha ? src_pixels[inCol + inAOffset] : 65535;
+            dst_pixels[outCol + outROffset] = Color::intToFloat<65536>(src_pixels[inCol + inROffset]);
+            dst_pixels[outCol + outGOffset] = Color::intToFloat<65536>(src_pixels[inCol + inGOffset]);
+            dst_pixels[outCol + outBOffset] = Color::intToFloat<65536>(src_pixels[inCol + inBOffset]);
+            if (outputHasAlpha) {
+                // alpha is linear
+                dst_pixels[outCol + outAOffset] = Color::intToFloat<65536>(a);
+            }
+        }
+    }
 }
 
 void
@@ -35,6 +35,7 @@
 #include <cmath>
 #include <map>
 #include <string>
+#include <vector>
 
 CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QMutex>
@@ -139,6 +140,9 @@ class Lut
     /// and never change afterwards
     mutable unsigned short toFunc_hipart_to_uint8xx[0x10000];         /// contains  2^16 = 65536 values between 0-255
     mutable float fromFunc_uint8_to_float[256];         /// values between 0-1.f
+    mutable std::vector<float> fromFunc_uint16_to_float;         /// contains 2^16 values between 0-1.f
+    mutable std::vector<float> fromFunc_half_to_float;         /// fromFunc indexed like a half float, @see ImageConvertSIMD
+    mutable std::vector<float> toFunc_half_to_float;         /// toFunc indexed like a half float, @see ImageConvertSIMD
     mutable bool init_;         ///< false if the tables are not yet initialized
     mutable QMutex _lock;         ///< protects init_
 
@@ -197,12 +201,17 @@ public:
         return _name;
     }
 
-    /* @brief Converts a float ranging in [0 - 1.f] in linear color-space using the look-up tables.
+    /* @brief Converts a float ranging in [0 - 1.f] in the destination color-space to linear color-space using the
+     * look-up tables, which are linearly interpolated. The error is below 2e-5 (relative above 1) for the built-in color-spaces.
+     * @return A float in [0 - 1.f] in linear color-space.
+     */
+    float fromColorSpaceFloatToLinearFloatFast(float v) const;
+
+    /* @brief Converts a float ranging in [0 - 1.f] in linear color-space using the look-up tables,
+     * which are linearly interpolated. The error is below 2e-5 (relative above 1) for the built-in color-spaces.
      * @return A float in [0 - 1.f] in the destination color-space.
      */
-    // It is not recommended to use this function, because the output is quantized
-    // If one really needs float, one has to use the full function (or OpenColorIO)
-    //float toColorSpaceFloatFromLinearFloatFast(float v) const;
+    float toColorSpaceFloatFromLinearFloatFast(float v) const;
 
     /* @brief Converts a float ranging in [0 - 1.f] in linear color-space using the look-up tables.
      * @return A byte in [0 - 255] in the destination color-space.
@@ -216,7 +225,7 @@ public:
 
     /* @brief Converts a float ranging in [0 - 1.f] in linear color-space using the look-up tables.
      * @return An unsigned short in [0 - 65535] in the destination color-space.
-     * This function uses localluy linear approximations of the transfer function.
+     * @see toColorSpaceFloatFromLinearFloatFast(float)
      */
     unsigned short toColorSpaceUint16FromLinearFloatFast(float v) const;
 
@@ -230,6 +239,16 @@ public:
      */
     float fromColorSpaceUint16ToLinearFloatFast(unsigned short v) const;
 
+    /* @brief Same as the functions above, for n contiguous values. These use SIMD instructions when available,
+     * @see ImageConvertSIMD
+     */
+    void toColorSpaceUint8xxFromLinearFloatFast(const float* from, unsigned short* to, int n) const;
+    void fromColorSpaceUint8ToLinearFloatFast(const unsigned char* from, float* to, int n) const;
+    void fromColorSpaceUint16ToLinearFloatFast(const unsigned short* from, float* to, int n) const;
+    void fromColorSpaceFloatToLinearFloatFast(const float* from, float* to, int n) const;
+    void toColorSpaceFloatFromLinearFloatFast(const float* from, float* to, int n) const;
+    void toColorSpaceUint16FromLinearFloatFast(const float* from, unsigned short* to, int n) const;
+
 
     /////@TODO the following functions expects a float input buffer, one could extend it to cover all bitdepths.
 
@@ -284,9 +303,9 @@ public:
     void to_byte_packed(unsigned char* to, const float* from, const RectI & conversionRect,
                         const RectI & srcRoD, const RectI & dstRoD,
                         PixelPackingEnum inputPacking, PixelPackingEnum outputPacking, bool invertY, bool premult) const; // used by QtWriter
-    //void to_short_packed(unsigned short* to, const float* from,const RectI & conversionRect,
-    //                     const RectI & srcRoD,const RectI & dstRoD,
-    //                     PixelPackingEnum inputPacking,PixelPackingEnum outputPacking,bool invertY,bool premult) const;
+    void to_short_packed(unsigned short* to, const float* from, const RectI & conversionRect,
+                         const RectI & srcRoD, const RectI & dstRoD,
+                         PixelPackingEnum inputPacking, PixelPackingEnum outputPacking, bool invertY, bool premult) const;
     void to_float_packed(float* to, const float* from, const RectI & conversionRect,
                          const RectI & srcRoD, const RectI & dstRoD,
                          PixelPackingEnum inputPacking, PixelPackingEnum outputPacking, bool invertY, bool premult) const;
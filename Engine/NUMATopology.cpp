@@ -0,0 +1,343 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "NUMATopology.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <sstream> // stringstream
+#include <string>
+#include <vector>
+
+#ifdef __NATRON_LINUX__
+#include <dirent.h>
+#include <sched.h> // sched_setaffinity, sched_getcpu
+#include <unistd.h> // syscall, sysconf
+#include <sys/syscall.h> // SYS_mbind, SYS_get_mempolicy
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+
+// From <numaif.h>, which is only installed with libnuma
+#define NATRON_MPOL_PREFERRED 1
+#define NATRON_MPOL_F_NODE (1 << 0)
+#define NATRON_MPOL_F_ADDR (1 << 1)
+
+// The highest system node number that can be passed to mbind
+#define NATRON_NUMA_MAX_SYSTEM_NODE 1023
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+struct NUMAState
+{
+    // Set by detect() before the render threads are started, then read-only
+    int nNodes;
+    int systemNodes[NATRON_NUMA_MAX_NODES];
+    std::vector<int> nodeCPUs[NATRON_NUMA_MAX_NODES];
+#ifdef __NATRON_LINUX__
+    cpu_set_t nodeCPUSets[NATRON_NUMA_MAX_NODES];
+    cpu_set_t processCPUSet;
+#endif
+    std::vector<int> cpuNodes;
+
+    QAtomicInt enabled;
+
+    // Protects nBoundThreads
+    QMutex boundThreadsMutex;
+    int nBoundThreads[NATRON_NUMA_MAX_NODES];
+
+    NUMAState()
+        : nNodes(1)
+        , cpuNodes()
+        , enabled(0)
+        , boundThreadsMutex()
+    {
+        for (int i = 0; i < NATRON_NUMA_MAX_NODES; ++i) {
+            systemNodes[i] = i;
+            nBoundThreads[i] = 0;
+        }
+    }
+};
+
+NUMAState numa;
+
+// The node the current thread is bound to, or -1
+NATRON_THREAD_LOCAL int currentThreadNode = -1;
+
+#ifdef __NATRON_LINUX__
+/// Parses a list of CPUs as found in /sys, e.g "0-7,16-23"
+std::vector<int>
+parseCPUList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::size_t pos = 0;
+
+    while ( pos < list.size() ) {
+        std::size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string range = list.substr(pos, end - pos);
+        pos = end + 1;
+        if ( range.empty() || (range[0] < '0') || (range[0] > '9') ) {
+            continue;
+        }
+        std::size_t dash = range.find('-');
+        int first = std::atoi( range.c_str() );
+        int last = (dash == std::string::npos) ? first : std::atoi( range.c_str() + dash + 1 );
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+#endif // __NATRON_LINUX__
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+void
+NUMATopology::detect()
+{
+#ifdef __NATRON_LINUX__
+    if (sched_getaffinity( 0, sizeof(cpu_set_t), &numa.processCPUSet ) != 0) {
+        return;
+    }
+
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (!dir) {
+        return;
+    }
+    std::vector<int> systemNodes;
+    while (struct dirent* entry = readdir(dir)) {
+        const std::string name(entry->d_name);
+        if ( (name.size() > 4) && (name.compare(0, 4, "node") == 0) && (name[4] >= '0') && (name[4] <= '9') ) {
+            systemNodes.push_back( std::atoi( name.c_str() + 4 ) );
+        }
+    }
+    closedir(dir);
+    std::sort( systemNodes.begin(), systemNodes.end() );
+
+    int nNodes = 0;
+    for (std::size_t i = 0; i < systemNodes.size() && nNodes < NATRON_NUMA_MAX_NODES; ++i) {
+        if (systemNodes[i] > NATRON_NUMA_MAX_SYSTEM_NODE) {
+            continue;
+        }
+        std::stringstream path;
+        path << "/sys/devices/system/node/node" << systemNodes[i] << "/cpulist";
+        std::ifstream file( path.str().c_str() );
+        std::string list;
+        if ( !file || !std::getline(file, list) ) {
+            continue;
+        }
+
+        // Only keep the CPUs this process may run on, and the nodes that have some (the others only have memory)
+        std::vector<int> cpus = parseCPUList(list);
+        std::vector<int> allowedCPUs;
+        CPU_ZERO(&numa.nodeCPUSets[nNodes]);
+        for (std::size_t c = 0; c < cpus.size(); ++c) {
+            if ( (cpus[c] < CPU_SETSIZE) && CPU_ISSET(cpus[c], &numa.processCPUSet) ) {
+                allowedCPUs.push_back(cpus[c]);
+                CPU_SET(cpus[c], &numa.nodeCPUSets[nNodes]);
+            }
+        }
+        if ( allowedCPUs.empty() ) {
+            continue;
+        }
+        numa.systemNodes[nNodes] = systemNodes[i];
+        numa.nodeCPUs[nNodes] = allowedCPUs;
+        for (std::size_t c = 0; c < allowedCPUs.size(); ++c) {
+            if ( (int)numa.cpuNodes.size() <= allowedCPUs[c] ) {
+                numa.cpuNodes.resize(allowedCPUs[c] + 1, -1);
+            }
+            numa.cpuNodes[allowedCPUs[c]] = nNodes;
+        }
+        ++nNodes;
+    }
+    numa.nNodes = std::max(1, nNodes);
+#endif // __NATRON_LINUX__
+}
+
+int
+NUMATopology::getNumNodes()
+{
+    return numa.nNodes;
+}
+
+void
+NUMATopology::setEnabled(bool enabled)
+{
+    numa.enabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
+bool
+NUMATopology::isEnabled()
+{
+    return (int)numa.enabled && numa.nNodes > 1;
+}
+
+int
+NUMATopology::bindCurrentThread()
+{
+    if ( !isEnabled() ) {
+        return -1;
+    }
+    int node = 0;
+    {
+        QMutexLocker k(&numa.boundThreadsMutex);
+        for (int i = 1; i < numa.nNodes; ++i) {
+            if (numa.nBoundThreads[i] < numa.nBoundThreads[node]) {
+                node = i;
+            }
+        }
+    }
+
+    return bindCurrentThreadToNode(node) ? node : -1;
+}
+
+bool
+NUMATopology::bindCurrentThreadToNode(int node)
+{
+    if ( (node < 0) || (node >= numa.nNodes) || (numa.nNodes <= 1) ) {
+        return false;
+    }
+    if (currentThreadNode == node) {
+        return true;
+    }
+#ifdef __NATRON_LINUX__
+    if (sched_setaffinity( 0, sizeof(cpu_set_t), &numa.nodeCPUSets[node] ) != 0) {
+        return false;
+    }
+    QMutexLocker k(&numa.boundThreadsMutex);
+    if (currentThreadNode != -1) {
+        --numa.nBoundThreads[currentThreadNode];
+    }
+    ++numa.nBoundThreads[node];
+    currentThreadNode = node;
+
+    return true;
+#else
+
+    return false;
+#endif
+}
+
+void
+NUMATopology::unbindCurrentThread()
+{
+    if (currentThreadNode == -1) {
+        return;
+    }
+#ifdef __NATRON_LINUX__
+    sched_setaffinity( 0, sizeof(cpu_set_t), &numa.processCPUSet );
+#endif
+    QMutexLocker k(&numa.boundThreadsMutex);
+    --numa.nBoundThreads[currentThreadNode];
+    currentThreadNode = -1;
+}
+
+int
+NUMATopology::getCurrentThreadNode()
+{
+    return currentThreadNode;
+}
+
+int
+NUMATopology::getCurrentNode()
+{
+    if (currentThreadNode != -1) {
+        return currentThreadNode;
+    }
+#ifdef __NATRON_LINUX__
+    if (numa.nNodes > 1) {
+        int cpu = sched_getcpu();
+        if ( (cpu >= 0) && ( cpu < (int)numa.cpuNodes.size() ) && (numa.cpuNodes[cpu] != -1) ) {
+            return numa.cpuNodes[cpu];
+        }
+    }
+#endif
+
+    return 0;
+}
+
+void
+NUMATopology::bindMemoryToNode(void* ptr,
+                               std::size_t nBytes,
+                               int node)
+{
+#if defined(__NATRON_LINUX__) && defined(SYS_mbind)
+    if ( !ptr || (node < 0) || (node >= numa.nNodes) || (numa.nNodes <= 1) ) {
+        return;
+    }
+    // mbind only takes whole pages: the pages that are partly outside of the buffer are left to the first touch
+    const std::size_t pageSize = (std::size_t)sysconf(_SC_PAGESIZE);
+    std::size_t begin = ( (std::size_t)ptr + pageSize - 1 ) / pageSize * pageSize;
+    std::size_t end = ( (std::size_t)ptr + nBytes ) / pageSize * pageSize;
+    if (end <= begin) {
+        return;
+    }
+    const int bitsPerLong = 8 * sizeof(unsigned long);
+    unsigned long mask[(NATRON_NUMA_MAX_SYSTEM_NODE + 1) / (8 * sizeof(unsigned long))] = {0};
+    const int systemNode = numa.systemNodes[node];
+    mask[systemNode / bitsPerLong] |= 1UL << (systemNode % bitsPerLong);
+    // Preferred rather than bound, so that the allocation falls back on the other nodes when the node is full
+    syscall(SYS_mbind, begin, end - begin, NATRON_MPOL_PREFERRED, mask, (unsigned long)(NATRON_NUMA_MAX_SYSTEM_NODE + 2), 0);
+#else
+    Q_UNUSED(ptr);
+    Q_UNUSED(nBytes);
+    Q_UNUSED(node);
+#endif
+}
+
+int
+NUMATopology::getMemoryNode(const void* ptr)
+{
+#if defined(__NATRON_LINUX__) && defined(SYS_get_mempolicy)
+    if ( !ptr || (numa.nNodes <= 1) ) {
+        return -1;
+    }
+    int systemNode = -1;
+    if (syscall(SYS_get_mempolicy, &systemNode, (unsigned long*)0, 0UL, ptr, NATRON_MPOL_F_NODE | NATRON_MPOL_F_ADDR) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < numa.nNodes; ++i) {
+        if (numa.systemNodes[i] == systemNode) {
+            return i;
+        }
+    }
+#else
+    Q_UNUSED(ptr);
+#endif
+
+    return -1;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,109 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_NUMATopology_h
+#define Engine_NUMATopology_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#include "Engine/EngineFwd.h"
+
+// The maximum number of NUMA nodes that are used. On machines with more nodes, the extra nodes are ignored.
+#define NATRON_NUMA_MAX_NODES 16
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The NUMA nodes of the machine, and the placement of the render threads and of the image buffers on them.
+ * The topology is read from /sys/devices/system/node by detect() at startup; on other systems, or if there is a
+ * single node, the machine has 1 node and nothing is ever bound.
+ *
+ * When NUMA-aware rendering is enabled (it is opt-in, see Settings), the parallel frame render threads and the workers of
+ * the TaskScheduler are bound to the CPUs of a node, the tile renders started by a thread are only run by the workers of
+ * its node, and the image buffers allocated by a thread are placed on the memory of its node.
+ * This class is MT-safe.
+ **/
+class NUMATopology
+{
+public:
+
+    /**
+     * @brief Reads the NUMA nodes and their CPUs. Called once by AppManager at startup.
+     **/
+    static void detect();
+
+    /**
+     * @brief Returns the number of NUMA nodes, at least 1.
+     **/
+    static int getNumNodes();
+
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief Returns true if NUMA-aware rendering is enabled and the machine has more than 1 node.
+     **/
+    static bool isEnabled();
+
+    /**
+     * @brief Binds the calling thread to the CPUs of the node that has the fewest bound threads, and returns it.
+     * Returns -1 if NUMA-aware rendering is disabled or the thread could not be bound.
+     **/
+    static int bindCurrentThread();
+
+    /**
+     * @brief Binds the calling thread to the CPUs of the given node.
+     **/
+    static bool bindCurrentThreadToNode(int node);
+
+    /**
+     * @brief Lets the calling thread run on all CPUs again.
+     **/
+    static void unbindCurrentThread();
+
+    /**
+     * @brief Returns the node the calling thread is bound to, or -1.
+     **/
+    static int getCurrentThreadNode();
+
+    /**
+     * @brief Returns the node the calling thread is bound to, or else the node of the CPU it is running on.
+     **/
+    static int getCurrentNode();
+
+    /**
+     * @brief Asks the system to place the pages of a buffer that were not touched yet on the memory of the given node.
+     **/
+    static void bindMemoryToNode(void* ptr, std::size_t nBytes, int node);
+
+    /**
+     * @brief Returns the node of the memory of the first page of the buffer, or -1 if it is unknown.
+     **/
+    static int getMemoryNode(const void* ptr);
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // Engine_NUMATopology_h
@@ -793,15 +793,37 @@ Node::computeHashInternal()
 
     U64 oldHash, newHash;
     {
+        ///The project's creation time is in the hash because 2 projects opened concurrently
+        ///could reproduce the same (especially simple graphs like Viewer-Reader)
+        qint64 creationTime =  getApp()->getProject()->getProjectCreationTime();
+        std::string scriptName = getScriptName();
+
         QWriteLocker l(&_imp->knobsAgeMutex);
 
         oldHash = _imp->hash.value();
 
+        ///The node's own part of the hash (its age, its script name to distinguish 2 instances with the same parameters
+        ///and the project creation time) only changes along with these values: do not recompute it when we are
+        ///rehashed only because an input changed.
+        if ( !_imp->ownHashValid || (_imp->ownHashKnobsAge != _imp->knobsAge) || (_imp->ownHashCreationTime != creationTime) ||
+             (_imp->ownHashScriptName != scriptName) ) {
+            Hash64 ownHash;
+            ownHash.append(_imp->knobsAge);
+            Hash64_appendQString( &ownHash, QString::fromUtf8( scriptName.c_str() ) );
+            ownHash.append(creationTime);
+            ownHash.computeHash();
+            _imp->ownHashValue = ownHash.value();
+            _imp->ownHashKnobsAge = _imp->knobsAge;
+            _imp->ownHashCreationTime = creationTime;
+            _imp->ownHashScriptName = scriptName;
+            _imp->ownHashValid = true;
+        }
+
         ///reset the hash value
         _imp->hash.reset();
 
-        ///append the effect's own age
-        _imp->hash.append(_imp->knobsAge);
+        ///append the effect's own hash
+        _imp->hash.append(_imp->ownHashValue);
 
         ///append all inputs hash
         RotoDrawableItemPtr attachedStroke = _imp->paintStroke.lock();
@@ -849,14 +871,6 @@ Node::computeHashInternal()
         //            _imp->hash.append(rotoAge);
         //        }
 
-        ///Also append the effect's label to distinguish 2 instances with the same parameters
-        Hash64_appendQString( &_imp->hash, QString::fromUtf8( getScriptName().c_str() ) );
-
-        ///Also append the project's creation time in the hash because 2 projects opened concurrently
-        ///could reproduce the same (especially simple graphs like Viewer-Reader)
-        qint64 creationTime =  getApp()->getProject()->getProjectCreationTime();
-        _imp->hash.append(creationTime);
-
         _imp->hash.computeHash();
 
         newHash = _imp->hash.value();
@@ -878,24 +892,11 @@ Node::computeHashInternal()
 } // Node::computeHashInternal
 
 void
-Node::computeHashRecursive(std::list<Node*>& marked)
+Node::getHashDependents(NodesList* dependents) const
 {
-    if ( std::find(marked.begin(), marked.end(), this) != marked.end() ) {
-        return;
-    }
-
-    bool hasChanged = computeHashInternal();
-    marked.push_back(this);
-    if (!hasChanged) {
-        //Nothing changed, no need to recurse on outputs
-        return;
-    }
-
-
     bool isRotoPaint = _imp->effect->isRotoPaintNode();
-
-    ///call it on all the outputs
     NodesList outputs;
+
     getOutputsWithGroupRedirection(outputs);
     for (NodesList::iterator it = outputs.begin(); it != outputs.end(); ++it) {
         assert(*it);
@@ -905,18 +906,32 @@ Node::computeHashRecursive(std::list<Node*>& marked)
         if ( isRotoPaint && attachedStroke && (attachedStroke->getContext()->getNode().get() == this) ) {
             continue;
         }
-        (*it)->computeHashRecursive(marked);
+        dependents->push_back(*it);
     }
 
-
-    ///If the node has a rotopaint tree, compute the hash of the nodes in the tree
+    ///If the node has a rotopaint tree, the hash of the nodes in the tree depends on this node
     if (_imp->rotoContext) {
-        NodesList allItems;
-        _imp->rotoContext->getRotoPaintTreeNodes(&allItems);
-        for (NodesList::iterator it = allItems.begin(); it != allItems.end(); ++it) {
-            (*it)->computeHashRecursive(marked);
+        _imp->rotoContext->getRotoPaintTreeNodes(dependents);
+    }
+}
+
+void
+Node::collectHashDependentsRecursive(U64 generation,
+                                     std::vector<Node*>* postOrder)
+{
+    if (_imp->hashVisitGeneration == generation) {
+        return;
+    }
+    _imp->hashVisitGeneration = generation;
+
+    if (_imp->effect) {
+        NodesList dependents;
+        getHashDependents(&dependents);
+        for (NodesList::iterator it = dependents.begin(); it != dependents.end(); ++it) {
+            (*it)->collectHashDependentsRecursive(generation, postOrder);
         }
     }
+    postOrder->push_back(this);
 }
 
 void
@@ -972,10 +987,65 @@ Node::computeHash()
 
         return;
     }
-    std::list<Node*> marked;
-    computeHashRecursive(marked);
+    std::list<Node*> roots;
+    roots.push_back(this);
+    computeHashOfNodes(roots);
 } // computeHash
 
+/*
+ * Each hash pass has its own generation so that marking a node as visited or dirty is O(1)
+ * and never needs to be cleared. Only ever read/written on the main thread.
+ */
+static U64 hashPassGeneration = 0;
+
+void
+Node::computeHashOfNodes(const std::list<Node*>& roots)
+{
+    assert( QThread::currentThread() == qApp->thread() );
+
+    U64 generation = ++hashPassGeneration;
+
+    ///Gather all nodes downstream of the roots. Walking the post-order backwards yields a topological order,
+    ///hence a node is only rehashed once all the nodes it depends on have their final hash.
+    std::vector<Node*> postOrder;
+    for (std::list<Node*>::const_iterator it = roots.begin(); it != roots.end(); ++it) {
+        (*it)->collectHashDependentsRecursive(generation, &postOrder);
+        (*it)->_imp->hashDirtyGeneration = generation;
+    }
+
+    std::vector<Node*> rehashed;
+    for (std::vector<Node*>::reverse_iterator it = postOrder.rbegin(); it != postOrder.rend(); ++it) {
+        Node* node = *it;
+        if (node->_imp->hashDirtyGeneration != generation) {
+            ///Nothing upstream changed
+            continue;
+        }
+        rehashed.push_back(node);
+        if ( !node->computeHashInternal() ) {
+            continue;
+        }
+        NodesList dependents;
+        node->getHashDependents(&dependents);
+        for (NodesList::iterator it2 = dependents.begin(); it2 != dependents.end(); ++it2) {
+            (*it2)->_imp->hashDirtyGeneration = generation;
+        }
+    }
+
+    int nbRehashed = (int)rehashed.size();
+    for (std::vector<Node*>::iterator it = rehashed.begin(); it != rehashed.end(); ++it) {
+        QWriteLocker l(&(*it)->_imp->knobsAgeMutex);
+        (*it)->_imp->nbNodesRehashedByLastHashChange = nbRehashed;
+    }
+} // computeHashOfNodes
+
+int
+Node::getNbNodesRehashedByLastHashChange() const
+{
+    QReadLocker l(&_imp->knobsAgeMutex);
+
+    return _imp->nbNodesRehashedByLastHashChange;
+}
+
 
 void
 Node::loadKnobs(const NodeSerialization & serialization,
@@ -4912,12 +4982,13 @@ Node::onEffectKnobValueChanged(KnobI* what,
             ///When a group is disabled we have to force a hash change of all nodes inside otherwise the image will stay cached
 
             NodesList nodes = isGroup->getNodes();
-            std::list<Node*> markedNodes;
+            std::list<Node*> roots;
             for (NodesList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
                 //This will not trigger a hash recomputation
                 (*it)->incrementKnobsAge_internal();
-                (*it)->computeHashRecursive(markedNodes);
+                roots.push_back( it->get() );
             }
+            computeHashOfNodes(roots);
         }
     } else if ( what == _imp->nodeLabelKnob.lock().get() ) {
         Q_EMIT nodeExtraLabelChanged( QString::fromUtf8( _imp->nodeLabelKnob.lock()->getValue().c_str() ) );
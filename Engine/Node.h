@@ -222,6 +222,11 @@ public:
      **/
     U64 getHashValue() const;
 
+    /**
+     * @brief Returns the number of nodes that were rehashed by the last hash change that reached this node.
+     **/
+    int getNbNodesRehashedByLastHashChange() const;
+
     virtual std::string getCacheID() const OVERRIDE FINAL;
 
     /**
@@ -1332,7 +1337,17 @@ private:
 
     bool setStreamWarningInternal(StreamWarningEnum warning, const QString& message);
 
-    void computeHashRecursive(std::list<Node*>& marked);
+    /**
+     * @brief Appends to dependents the nodes whose hash depends on the hash of this node, i.e: its outputs
+     * (with group redirection) and the nodes of its rotopaint tree.
+     **/
+    void getHashDependents(NodesList* dependents) const;
+
+    /**
+     * @brief Appends to postOrder all nodes whose hash depends on this node, in post-order, so that
+     * walking postOrder backwards visits the nodes in topological order.
+     **/
+    void collectHashDependentsRecursive(U64 generation, std::vector<Node*>* postOrder);
 
     /**
      * @brief Refreshes the node hash depending on its context (knobs age, inputs etc...)
@@ -1503,6 +1518,13 @@ protected:
      **/
     void computeHash();
 
+    /**
+     * @brief Same as computeHash() but for several nodes at once: the nodes downstream of all roots are visited
+     * in topological order and each of them is rehashed at most once, only if one of its inputs hash changed.
+     * Must be called on the main thread.
+     **/
+    static void computeHashOfNodes(const std::list<Node*>& roots);
+
 private:
 
 
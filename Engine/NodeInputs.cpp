@@ -843,9 +843,17 @@ Node::Implementation::ifGroupForceHashChangeOfInputs()
     if ( isGrp && !isGrp->getApp()->isCreatingNodeTree() ) {
         NodesList inputsOutputs;
         isGrp->getInputsOutputs(&inputsOutputs, false);
+        std::list<Node*> roots;
         for (NodesList::iterator it = inputsOutputs.begin(); it != inputsOutputs.end(); ++it) {
             (*it)->incrementKnobsAge_internal();
-            (*it)->computeHash();
+            roots.push_back( it->get() );
+        }
+        if ( QThread::currentThread() == qApp->thread() ) {
+            Node::computeHashOfNodes(roots);
+        } else {
+            for (std::list<Node*>::iterator it = roots.begin(); it != roots.end(); ++it) {
+                (*it)->computeHash();
+            }
         }
     }
 }
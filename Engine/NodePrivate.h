@@ -175,6 +175,14 @@ public:
         , renderInstancesSharedMutex(QMutex::Recursive)
         , knobsAge(0)
         , knobsAgeMutex()
+        , ownHashValue(0)
+        , ownHashKnobsAge(0)
+        , ownHashCreationTime(0)
+        , ownHashScriptName()
+        , ownHashValid(false)
+        , hashVisitGeneration(0)
+        , hashDirtyGeneration(0)
+        , nbNodesRehashedByLastHashChange(0)
         , masterNodeMutex()
         , masterNode()
         , nodeLinks()
@@ -359,6 +367,14 @@ public:
     U64 knobsAge; //< the age of the knobs in this effect. It gets incremented every times the effect has its evaluate() function called.
     mutable QReadWriteLock knobsAgeMutex; //< protects knobsAge and hash
     Hash64 hash; //< recomputed every time knobsAge is changed.
+    U64 ownHashValue; //< hash of knobsAge, script name and project creation time, reused when only the inputs changed
+    U64 ownHashKnobsAge; //< the knobsAge ownHashValue was computed with
+    qint64 ownHashCreationTime; //< the project creation time ownHashValue was computed with
+    std::string ownHashScriptName; //< the script name ownHashValue was computed with
+    bool ownHashValid;
+    U64 hashVisitGeneration; //< main-thread only: generation of the last hash pass that visited this node, see Node::computeHashOfNodes
+    U64 hashDirtyGeneration; //< main-thread only: generation of the last hash pass in which an upstream node changed
+    int nbNodesRehashedByLastHashChange; //< protected by knobsAgeMutex
     mutable QMutex masterNodeMutex; //< protects masterNode and nodeLinks
     NodeWPtr masterNode; //< this points to the master when the node is a clone
     KnobLinkList nodeLinks; //< these point to the parents of the params links
@@ -33,6 +33,7 @@
 #include <cctype> // tolower
 #include <algorithm> // transform, min, max
 #include <string>
+#include <vector>
 #include <cstring> // for std::memcpy, std::memset, std::strcmp
 
 CLANG_DIAG_OFF(deprecated)
@@ -49,7 +50,6 @@ CLANG_DIAG_ON(deprecated-register)
 #ifdef OFX_SUPPORTS_MULTITHREAD
 #include <QtCore/QThread>
 #include <QtCore/QThreadStorage>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 // /usr/local/include/boost/bind/arg.hpp:37:9: warning: unused typedef 'boost_static_assert_typedef_37' [-Wunused-local-typedef]
 #include <boost/bind.hpp>
@@ -107,6 +107,7 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Engine/Project.h"
 #include "Engine/Settings.h"
 #include "Engine/StandardPaths.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/TLSHolder.h"
 #include "Engine/ThreadPool.h"
 
@@ -1213,6 +1214,7 @@ threadFunctionWrapper(OfxThreadFunctionV1 func,
                       unsigned int threadIndex,
                       unsigned int threadMax,
                       QThread* spawnerThread,
+                      const TLSSnapshotPtr& spawnerTLS,
                       void *customArg)
 {
 #ifdef DEBUG
@@ -1226,7 +1228,7 @@ threadFunctionWrapper(OfxThreadFunctionV1 func,
 
     QThread* spawnedThread = QThread::currentThread();
     if (spawnedThread != spawnerThread) {
-        appPTR->getAppTLS()->softCopy(spawnerThread, spawnedThread);
+        appPTR->getAppTLS()->softCopy(spawnerTLS, spawnerThread, spawnedThread);
     }
 
     OfxStatus ret = kOfxStatOK;
@@ -1248,6 +1250,18 @@ threadFunctionWrapper(OfxThreadFunctionV1 func,
     return ret;
 }
 
+static void
+threadFunctionTask(std::vector<OfxStatus>* status,
+                   OfxThreadFunctionV1 func,
+                   unsigned int threadMax,
+                   QThread* spawnerThread,
+                   const TLSSnapshotPtr& spawnerTLS,
+                   void *customArg,
+                   int threadIndex)
+{
+    (*status)[threadIndex] = threadFunctionWrapper(func, (unsigned int)threadIndex, threadMax, spawnerThread, spawnerTLS, customArg);
+}
+
 class OfxThread
     : public QThread
       , public AbortableThread
@@ -1354,19 +1368,15 @@ OfxHost::multiThread(OfxThreadFunctionV1 func,
     bool useThreadPool = appPTR->getUseThreadPool();
 
     if (useThreadPool) {
-        std::vector<unsigned int> threadIndexes(nThreads);
-        for (unsigned int i = 0; i < nThreads; ++i) {
-            threadIndexes[i] = i;
-        }
+        std::vector<OfxStatus> status(nThreads, kOfxStatFailed);
 
-        /// DON'T set the maximum thread count, this is a global application setting, and see the documentation excerpt above
-        //QThreadPool::globalInstance()->setMaxThreadCount(nThreads);
-        QFuture<OfxStatus> future = QtConcurrent::mapped( threadIndexes, boost::bind(threadFunctionWrapper, func, _1, nThreads, spawnerThread, customArg) );
-        future.waitForFinished();
-        ///DON'T reset back to the original value the maximum thread count
-        //QThreadPool::globalInstance()->setMaxThreadCount(QThread::idealThreadCount());
+        /// The threads are run by the workers of the task scheduler, whose number follows the maximum thread count of the
+        /// global thread pool, and by the spawner thread. See the documentation excerpt above.
+        /// The spawner thread modifies its TLS while it runs the function, so the workers copy a snapshot of it.
+        const TLSSnapshotPtr spawnerTLS = appPTR->getAppTLS()->takeSnapshot();
+        appPTR->getTaskScheduler()->parallelFor( (int)nThreads, boost::bind(threadFunctionTask, &status, func, nThreads, spawnerThread, spawnerTLS, customArg, _1) );
 
-        for (QFuture<OfxStatus>::const_iterator it = future.begin(); it != future.end(); ++it) {
+        for (std::vector<OfxStatus>::const_iterator it = status.begin(); it != status.end(); ++it) {
             OfxStatus stat = *it;
             if (stat != kOfxStatOK) {
                 return stat;
@@ -438,6 +438,29 @@ OutputEffectInstance::reportStats(int time,
     }
 
     ofile << "Time spent to render frame (wall clock time): " << Timer::printAsTime(wallTime, false).toStdString() << std::endl;
+
+    // Hit-rate of the image cache over the whole frame, to compare replacement policies
+    int totalCacheMisses = 0, totalCacheHits = 0;
+    for (std::map<NodePtr, NodeRenderStats >::const_iterator it = stats.begin(); it != stats.end(); ++it) {
+        int nbCacheMiss, nbCacheHit, nbCacheHitButDownscaled;
+        it->second.getCacheAccessInfos(&nbCacheMiss, &nbCacheHit, &nbCacheHitButDownscaled);
+        totalCacheMisses += nbCacheMiss;
+        totalCacheHits += nbCacheHit;
+    }
+    ofile << "Image cache replacement policy: "
+          << (appPTR->getCurrentSettings()->getImageCacheReplacementPolicy() == eCacheReplacementPolicy2Q ? "2Q" : "LRU") << std::endl;
+    ofile << "Image cache hit rate: ";
+    if (totalCacheHits + totalCacheMisses > 0) {
+        ofile << (100. * totalCacheHits) / (totalCacheHits + totalCacheMisses) << "% (" << totalCacheHits << " hits, " << totalCacheMisses << " misses)";
+    } else {
+        ofile << "no access";
+    }
+    ofile << std::endl;
+    for (std::map<NodePtr, NodeRenderStats >::const_iterator it = stats.begin(); it != stats.end(); ++it) {
+        if ( !it->second.getSchedulerDecision().empty() ) {
+            ofile << "Scheduler decision: " << it->second.getSchedulerDecision() << std::endl;
+        }
+    }
     for (std::map<NodePtr, NodeRenderStats >::const_iterator it = stats.begin(); it != stats.end(); ++it) {
         ofile << "------------------------------- " << it->first->getScriptName_mt_safe() << "------------------------------- " << std::endl;
         ofile << "Time spent rendering: " << Timer::printAsTime(it->second.getTotalTimeSpentRendering(), false).toStdString() << std::endl;
@@ -502,9 +525,10 @@ OutputEffectInstance::reportStats(int time,
         ofile << std::endl;
         int nbCacheMiss, nbCacheHit, nbCacheHitButDownscaled;
         it->second.getCacheAccessInfos(&nbCacheMiss, &nbCacheHit, &nbCacheHitButDownscaled);
-        ofile << "Nb cache hit: " << nbCacheMiss << std::endl;
+        ofile << "Nb cache hit: " << nbCacheHit << std::endl;
         ofile << "Nb cache miss: " << nbCacheMiss << std::endl;
         ofile << "Nb cache hit requiring mipmap downscaling: " << nbCacheHitButDownscaled << std::endl;
+        ofile << "Nb nodes rehashed by the last change: " << it->second.getNbNodesRehashed() << std::endl;
 
         const std::set<std::string> & planes = it->second.getPlanesRendered();
         ofile << "Plane(s) rendered: ";
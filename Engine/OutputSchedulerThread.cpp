@@ -55,7 +55,9 @@
 #include "Engine/Image.h"
 #include "Engine/KnobFile.h"
 #include "Engine/Node.h"
+#include "Engine/NUMATopology.h"
 #include "Engine/OpenGLViewerI.h"
+#include "Engine/ParallelRenderController.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
 #include "Engine/Project.h"
 #include "Engine/RenderStats.h"
@@ -90,6 +92,12 @@
 
 #define NATRON_SCHEDULER_ABORT_AFTER_X_UNSUCCESSFUL_ITERATIONS 5000
 
+/*
+   A viewer render of the current frame is split into a coarse pass and a full resolution pass
+   only if the previous full resolution render took at least this long.
+ */
+#define NATRON_VIEWER_PROGRESSIVE_RENDER_MIN_TIME_SECONDS 0.1
+
 NATRON_NAMESPACE_ENTER
 
 
@@ -219,6 +227,9 @@ struct OutputSchedulerThreadPrivate
     ///Render threads wait in this condition and the scheduler wake them when it needs to render some frames
     QWaitCondition framesToRenderNotEmptyCond;
 
+    ///Chooses the number of parallel renders when it is automatic
+    ParallelRenderController parallelRenders;
+
 #endif
 
     ///Work queue filled by the scheduler thread when in playback/render on disk
@@ -268,6 +279,7 @@ struct OutputSchedulerThreadPrivate
         , allRenderThreadsQuitCond()
         , framesToRender()
         , framesToRenderNotEmptyCond()
+        , parallelRenders()
 #endif
         , framesToRenderMutex()
         , lastFramePushedIndex(0)
@@ -859,6 +871,8 @@ OutputSchedulerThread::pickFrameToRender(RenderThreadTask* thread,
             found->active = true;
         }
 
+        _imp->parallelRenders.notifyFrameStarted(frame);
+
         OutputSchedulerThreadStartArgsPtr args = _imp->runArgs.lock();
         *enableRenderStats = args->enableRenderStats;
         *viewsToRender = args->viewsToRender;
@@ -1034,6 +1048,9 @@ OutputSchedulerThread::startRender()
 
     // Start measuring
     _imp->renderTimer.reset(new TimeLapse);
+#ifndef NATRON_PLAYBACK_USES_THREAD_POOL
+    _imp->parallelRenders.reset( appPTR->getHardwareIdealThreadCount(), appPTR->getHardwareIdealThreadCount() );
+#endif
 
     ///We will push frame to renders starting at startingFrame.
     ///They will be in the range determined by firstFrame-lastFrame
@@ -1520,13 +1537,24 @@ OutputSchedulerThread::adjustNumberOfThreads(int* newNThreads,
     *lastNThreads = currentParallelRenders;
 
     if (userSettingParallelThreads == 0) {
-        ///User wants it to be automatically computed, do a simple heuristic: launch as many parallel renders
-        ///as there are cores
-        optimalNThreads = appPTR->getHardwareIdealThreadCount();
-    } else {
-        optimalNThreads = userSettingParallelThreads;
+        ///User wants it to be automatically computed: the ParallelRenderController measures the throughput of the render
+        ///and chooses how many frames are in flight, the remaining CPUs render the tiles of these frames
+        optimalNThreads = _imp->parallelRenders.getFramesInFlight();
+        if ( (currentParallelRenders < optimalNThreads) || (currentParallelRenders == 0) ) {
+            QMutexLocker l(&_imp->renderThreadsMutex);
+
+            _imp->appendRunnable( createRunnable() );
+            *newNThreads = currentParallelRenders +  1;
+        } else if (currentParallelRenders > optimalNThreads) {
+            stopRenderThreads(1);
+            *newNThreads = currentParallelRenders - 1;
+        } else {
+            *newNThreads = currentParallelRenders;
+        }
+
+        return;
     }
-    optimalNThreads = std::max(1, optimalNThreads);
+    optimalNThreads = std::max(1, userSettingParallelThreads);
 
 
     if ( ( (runningThreads < optimalNThreads) && (currentParallelRenders < optimalNThreads) ) || (currentParallelRenders == 0) ) {
@@ -1561,8 +1589,20 @@ OutputSchedulerThread::notifyFrameRendered(int frame,
 
     bool isLastView = viewIndex == viewsToRender[viewsToRender.size() - 1] || viewIndex == -1;
 
-    // Report render stats if desired
     OutputEffectInstancePtr effect = _imp->outputEffect.lock();
+#ifndef NATRON_PLAYBACK_USES_THREAD_POOL
+    if (isLastView) {
+        // Let the controller measure the render, the number of threads is adjusted below
+        U64 maxCacheMemory = appPTR->getCachesMaximumMemorySize();
+        double memoryPressure = maxCacheMemory ? (double)appPTR->getCachesTotalMemorySize() / maxCacheMemory : 0.;
+        std::string decision;
+        if ( _imp->parallelRenders.notifyFrameRendered(frame, memoryPressure, &decision) && stats ) {
+            stats->setSchedulerDecisionForNode(effect->getNode(), decision);
+        }
+    }
+#endif
+
+    // Report render stats if desired
     if (stats) {
         double timeSpentForFrame;
         std::map<NodePtr, NodeRenderStats > statResults = stats->getStats(&timeSpentForFrame);
@@ -2068,6 +2108,15 @@ RenderThreadTask::run()
 #ifdef TRACE_SCHEDULER
         qDebug() << "Parallel Render Thread: Picking frame to render: " << time;
 #endif
+        // With NUMA-aware rendering, each parallel render stays on a node: the buffers of its images are allocated on the
+        // memory of the node and its tiles are rendered by the task scheduler workers of the node
+        if ( NUMATopology::isEnabled() ) {
+            if (NUMATopology::getCurrentThreadNode() == -1) {
+                NUMATopology::bindCurrentThread();
+            }
+        } else {
+            NUMATopology::unbindCurrentThread();
+        }
         renderFrame(time, viewsToRender, enableRenderStats);
 
         appPTR->getAppTLS()->cleanupTLSForThread();
@@ -2081,10 +2130,14 @@ RenderThreadTask::run()
         QMutexLocker l(&_imp->mustQuitMutex);
         _imp->hasQuit = true;
     }
+    NUMATopology::unbindCurrentThread();
     notifyIsRunning(false);
     _imp->scheduler->notifyThreadAboutToQuit(this);
 #else // NATRON_PLAYBACK_USES_THREAD_POOL
+    NUMATopology::bindCurrentThread();
     renderFrame(_imp->time, _imp->viewsToRender, _imp->useRenderStats);
+    // the thread goes back to the global thread pool
+    NUMATopology::unbindCurrentThread();
     _imp->scheduler->notifyThreadAboutToQuit(this);
 #endif
 }
@@ -2820,7 +2873,7 @@ private:
 
         for (int i = 0; i < 2; ++i) {
             args[i] = boost::make_shared<ViewerArgs>();
-            status[i] = viewer->getRenderViewerArgsAndCheckCache_public( time, true, view, i, viewerHash, true, NodePtr(), stats, args[i].get() );
+            status[i] = viewer->getRenderViewerArgsAndCheckCache_public( time, true, false, view, i, viewerHash, true, NodePtr(), stats, args[i].get() );
             clearTexture[i] = status[i] == ViewerInstance::eViewerRenderRetCodeFail || status[i] == ViewerInstance::eViewerRenderRetCodeBlack;
             if (status[i] == ViewerInstance::eViewerRenderRetCodeFail) {
                 //Just clear the viewer, nothing to do
@@ -2946,6 +2999,9 @@ struct RenderEnginePrivate
     PlaybackModeEnum pbMode;
     ViewerCurrentFrameRequestScheduler* currentFrameScheduler;
 
+    // Prefetches the frames around the current frame when the viewer is idle
+    ViewerPrefetchScheduler* prefetchScheduler;
+
     // Only used on the main-thread
     boost::scoped_ptr<RenderEngineWatcher> engineWatcher;
     struct RefreshRequest
@@ -2970,9 +3026,18 @@ struct RenderEnginePrivate
         , pbModeMutex()
         , pbMode(ePlaybackModeLoop)
         , currentFrameScheduler(0)
+        , prefetchScheduler(0)
         , refreshQueue()
     {
     }
+
+    void abortPrefetch()
+    {
+        if (prefetchScheduler) {
+            // Abort even if the thread is idle so that the frame being rendered is aborted right away
+            prefetchScheduler->abortThreadedTask(false);
+        }
+    }
 };
 
 RenderEngine::RenderEngine(const OutputEffectInstancePtr& output)
@@ -2983,6 +3048,8 @@ RenderEngine::RenderEngine(const OutputEffectInstancePtr& output)
 
 RenderEngine::~RenderEngine()
 {
+    delete _imp->prefetchScheduler;
+    _imp->prefetchScheduler = 0;
     delete _imp->currentFrameScheduler;
     _imp->currentFrameScheduler = 0;
     delete _imp->scheduler;
@@ -3010,6 +3077,7 @@ RenderEngine::renderFrameRange(bool isBlocking,
                                const std::vector<ViewIdx>& viewsToRender,
                                RenderDirectionEnum forward)
 {
+    _imp->abortPrefetch();
     setPlaybackAutoRestartEnabled(true);
 
     {
@@ -3027,6 +3095,7 @@ RenderEngine::renderFromCurrentFrame(bool enableRenderStats,
                                      const std::vector<ViewIdx>& viewsToRender,
                                      RenderDirectionEnum forward)
 {
+    _imp->abortPrefetch();
     setPlaybackAutoRestartEnabled(true);
 
     {
@@ -3076,6 +3145,8 @@ RenderEngine::renderCurrentFrameInternal(bool enableRenderStats,
         return;
     }
 
+    // Stop prefetching, the viewer has something else to render
+    _imp->abortPrefetch();
 
     ///If the scheduler is already doing playback, continue it
     if (_imp->scheduler) {
@@ -3120,6 +3191,28 @@ RenderEngine::renderCurrentFrame(bool enableRenderStats,
     Q_EMIT currentFrameRenderRequestPosted();
 }
 
+void
+RenderEngine::prefetchAroundCurrentFrame()
+{
+    assert( QThread::currentThread() == qApp->thread() );
+
+    ViewerInstance* isViewer = dynamic_cast<ViewerInstance*>( _imp->output.lock().get() );
+    if (!isViewer) {
+        return;
+    }
+
+    // The playback already fills the viewer cache
+    if ( isDoingSequentialRender() ) {
+        return;
+    }
+
+    if (!_imp->prefetchScheduler) {
+        _imp->prefetchScheduler = new ViewerPrefetchScheduler(isViewer);
+    }
+
+    _imp->prefetchScheduler->prefetchAroundCurrentFrame();
+}
+
 void
 RenderEngine::setPlaybackAutoRestartEnabled(bool enabled)
 {
@@ -3146,6 +3239,10 @@ RenderEngine::quitEngine(bool allowRestarts)
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->quitThread(allowRestarts);
     }
+
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->quitThread(allowRestarts);
+    }
 }
 
 void
@@ -3158,6 +3255,10 @@ RenderEngine::waitForEngineToQuit_not_main_thread()
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->waitForThreadToQuit_not_main_thread();
     }
+
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->waitForThreadToQuit_not_main_thread();
+    }
 }
 
 void
@@ -3180,6 +3281,10 @@ RenderEngine::waitForEngineToQuit_enforce_blocking()
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->waitForThreadToQuit_enforce_blocking();
     }
+
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->waitForThreadToQuit_enforce_blocking();
+    }
 }
 
 bool
@@ -3187,6 +3292,9 @@ RenderEngine::abortRenderingInternal(bool keepOldestRender)
 {
     bool ret = false;
 
+    // The prefetch is not a render the caller knows about: do not report it
+    _imp->abortPrefetch();
+
     if (_imp->currentFrameScheduler) {
         ret |= _imp->currentFrameScheduler->abortThreadedTask(keepOldestRender);
     }
@@ -3230,6 +3338,9 @@ RenderEngine::waitForAbortToComplete_not_main_thread()
     if (_imp->scheduler) {
         _imp->scheduler->waitForAbortToComplete_not_main_thread();
     }
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->waitForAbortToComplete_not_main_thread();
+    }
 }
 
 void
@@ -3242,6 +3353,10 @@ RenderEngine::waitForAbortToComplete_enforce_blocking()
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->waitForAbortToComplete_enforce_blocking();
     }
+
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->waitForAbortToComplete_enforce_blocking();
+    }
 }
 
 void
@@ -3298,8 +3413,12 @@ RenderEngine::hasThreadsAlive() const
     if (_imp->currentFrameScheduler) {
         currentFrameSchedulerRunning = _imp->currentFrameScheduler->isRunning();
     }
+    bool prefetchSchedulerRunning = false;
+    if (_imp->prefetchScheduler) {
+        prefetchSchedulerRunning = _imp->prefetchScheduler->isRunning();
+    }
 
-    return schedulerRunning || currentFrameSchedulerRunning;
+    return schedulerRunning || currentFrameSchedulerRunning || prefetchSchedulerRunning;
 }
 
 bool
@@ -3315,6 +3434,10 @@ RenderEngine::hasThreadsWorking() const
         working |= _imp->currentFrameScheduler->isWorking();
     }
 
+    if (!working && _imp->prefetchScheduler) {
+        working |= _imp->prefetchScheduler->isWorking();
+    }
+
     return working;
 }
 
@@ -3391,6 +3514,10 @@ public:
     ViewerArgsPtr args[2];
     bool isRotoNeatRender;
 
+    // When set, args are first rendered at a lower mipmap level and displayed with this request
+    ViewerCurrentFrameRequestSchedulerStartArgsPtr coarseRequest;
+    ViewerArgsPtr coarseArgs[2];
+
     CurrentFrameFunctorArgs()
         : GenericThreadStartArgs()
         , view(0)
@@ -3405,6 +3532,8 @@ public:
         , strokeItem()
         , args()
         , isRotoNeatRender(false)
+        , coarseRequest()
+        , coarseArgs()
     {
     }
 
@@ -3431,6 +3560,8 @@ public:
         , strokeItem(strokeItem)
         , args()
         , isRotoNeatRender(isRotoNeatRender)
+        , coarseRequest()
+        , coarseArgs()
     {
         if (isRotoPaintRequest && isRotoNeatRender) {
             isRotoPaintRequest->getRotoContext()->setIsDoingNeatRender(true);
@@ -3469,6 +3600,10 @@ struct ViewerCurrentFrameRequestSchedulerPrivate
     // Used to attribute an age to each renderCurrentFrameRequest
     U64 ageCounter;
 
+    // Duration in seconds of the last full resolution render that was not aborted
+    mutable QMutex lastRenderTimeMutex;
+    double lastRenderTime;
+
     ViewerCurrentFrameRequestSchedulerPrivate(ViewerInstance* viewer)
         : viewer(viewer)
         , threadPool( QThreadPool::globalInstance() )
@@ -3479,7 +3614,23 @@ struct ViewerCurrentFrameRequestSchedulerPrivate
         , currentFrameRenderTasksCond()
         , currentFrameRenderTasks()
         , ageCounter(0)
+        , lastRenderTimeMutex()
+        , lastRenderTime(0.)
+    {
+    }
+
+    void setLastRenderTime(double time)
     {
+        QMutexLocker k(&lastRenderTimeMutex);
+
+        lastRenderTime = time;
+    }
+
+    double getLastRenderTime() const
+    {
+        QMutexLocker k(&lastRenderTimeMutex);
+
+        return lastRenderTime;
     }
 
     void appendRunnableTask(RenderCurrentFrameFunctorRunnable* task)
@@ -3560,10 +3711,18 @@ public:
         ViewerInstance::ViewerRenderRetCode stat = ViewerInstance::eViewerRenderRetCodeFail;
         BufferableObjectPtrList ret;
 
+        if (_args->coarseRequest) {
+            renderCoarsePass();
+        }
+
         try {
             if (!_args->isRotoPaintRequest || _args->isRotoNeatRender) {
+                TimeLapse timer;
                 stat = _args->viewer->renderViewer(_args->view, QThread::currentThread() == qApp->thread(), false, _args->viewerHash, _args->canAbort,
                                                    NodePtr(), true, _args->args, _args->request, _args->stats);
+                if ( (stat == ViewerInstance::eViewerRenderRetCodeRender) && !isRenderAborted(_args->args) ) {
+                    _args->scheduler->setLastRenderTime( timer.getTimeSinceCreation() );
+                }
             } else {
                 stat = _args->viewer->getViewerArgsAndRenderViewer(_args->time, _args->canAbort, _args->view, _args->viewerHash, _args->isRotoPaintRequest, _args->strokeItem.lock(), _args->stats, &_args->args[0], &_args->args[1]);
             }
@@ -3609,6 +3768,59 @@ public:
 
         _args->scheduler->removeRunnableTask(this);
     } // run
+
+private:
+
+    static bool isRenderAborted(const ViewerArgsPtr args[2])
+    {
+        for (int i = 0; i < 2; ++i) {
+            if ( args[i] && args[i]->params && args[i]->params->abortInfo && args[i]->params->abortInfo->isAborted() ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Renders and displays the coarse args, then skips the full resolution render
+     * if the coarse render failed or if the viewer was asked to render something else meanwhile.
+     **/
+    void renderCoarsePass()
+    {
+        ViewerInstance::ViewerRenderRetCode stat = ViewerInstance::eViewerRenderRetCodeFail;
+        BufferableObjectPtrList ret;
+
+        try {
+            stat = _args->viewer->renderViewer(_args->view, QThread::currentThread() == qApp->thread(), false, _args->viewerHash, _args->canAbort,
+                                               NodePtr(), true, _args->coarseArgs, _args->coarseRequest, RenderStatsPtr());
+        } catch (...) {
+            stat = ViewerInstance::eViewerRenderRetCodeFail;
+        }
+
+        bool skipRefinement = stat == ViewerInstance::eViewerRenderRetCodeFail;
+        if (!skipRefinement) {
+            for (int i = 0; i < 2; ++i) {
+                if (_args->coarseArgs[i] && _args->coarseArgs[i]->params) {
+                    if (_args->coarseArgs[i]->params->tiles.size() > 0) {
+                        ret.push_back(_args->coarseArgs[i]->params);
+                    }
+                    if ( _args->coarseArgs[i]->params->abortInfo &&
+                         _args->viewer->hasRenderRequestAfter( i, _args->coarseArgs[i]->params->abortInfo->getRenderAge() ) ) {
+                        skipRefinement = true;
+                    }
+                }
+            }
+        }
+
+        _args->scheduler->notifyFrameProduced(ret, RenderStatsPtr(), _args->coarseRequest->age);
+
+        if (skipRefinement) {
+            // The full resolution request still has to be notified so that the scheduler does not wait for it
+            _args->args[0].reset();
+            _args->args[1].reset();
+        }
+    }
 };
 
 
@@ -3619,9 +3831,11 @@ public:
 
     RenderStatsPtr stats;
     BufferableObjectPtrList frames;
+    U64 age;
 
     ViewerCurrentFrameRequestSchedulerExecOnMT()
         : GenericThreadExecOnMainThreadArgs()
+        , age(0)
     {
     }
 
@@ -3667,6 +3881,7 @@ ViewerCurrentFrameRequestScheduler::threadLoopOnce(const GenericThreadStartArgsP
 
     ///Wait for the work to be done
     ViewerCurrentFrameRequestSchedulerExecOnMTPtr mtArgs = boost::make_shared<ViewerCurrentFrameRequestSchedulerExecOnMT>();
+    mtArgs->age = args->age;
     {
         QMutexLocker k(&_imp->producedFramesMutex);
         ProducedFrameSet::iterator found = _imp->producedFrames.end();
@@ -3744,6 +3959,11 @@ ViewerCurrentFrameRequestScheduler::executeOnMainThread(const GenericThreadExecO
     assert(args);
     if (args) {
         _imp->processProducedFrame(args->stats, args->frames);
+
+        // The most recent request is displayed: the viewer is idle until the next one
+        if (args->age + 1 == _imp->ageCounter) {
+            _imp->viewer->getRenderEngine()->prefetchAroundCurrentFrame();
+        }
     }
 }
 
@@ -3868,7 +4088,7 @@ ViewerCurrentFrameRequestScheduler::renderCurrentFrame(bool enableRenderStats,
 
         for (int i = 0; i < 2; ++i) {
             args[i] = boost::make_shared<ViewerArgs>();
-            status[i] = _imp->viewer->getRenderViewerArgsAndCheckCache_public( frame, false, view, i, viewerHash, canAbort, rotoPaintNode, stats, args[i].get() );
+            status[i] = _imp->viewer->getRenderViewerArgsAndCheckCache_public( frame, false, false, view, i, viewerHash, canAbort, rotoPaintNode, stats, args[i].get() );
 
             clearTexture[i] = status[i] == ViewerInstance::eViewerRenderRetCodeFail || status[i] == ViewerInstance::eViewerRenderRetCodeBlack;
             if (clearTexture[i] || args[i]->params->isViewerPaused) {
@@ -3929,9 +4149,57 @@ ViewerCurrentFrameRequestScheduler::renderCurrentFrame(bool enableRenderStats,
              ( !args[1] && ( status[1] == ViewerInstance::eViewerRenderRetCodeRender) && args[0] && ( status[0] == ViewerInstance::eViewerRenderRetCodeFail) ) ) {
             _imp->viewer->redrawViewer();
 
+            // The textures were cached: unless older requests are still rendering, the viewer is idle
+            if ( hasTextureCached && !isWorking() ) {
+                _imp->viewer->getRenderEngine()->prefetchAroundCurrentFrame();
+            }
+
             return;
         }
     }
+
+    /*
+       If the last render was slow, first render the image at the auto-proxy level so the user gets feedback quickly,
+       then refine it to full resolution. This is not needed when draft mode is already enabled (the user is scrubbing
+       or dragging a slider) and not done for roto painting and tracking, where the render order matters.
+     */
+    ViewerArgsPtr coarseArgs[2];
+    bool hasCoarseArgs = false;
+    if ( !rotoPaintNode && !isTracking && canAbort &&
+         !_imp->viewer->getApp()->isDraftRenderEnabled() &&
+         ( appPTR->getCurrentSettings()->getNumberOfThreads() != -1 ) &&
+         appPTR->getCurrentSettings()->isViewerProgressiveRenderEnabled() &&
+         ( _imp->getLastRenderTime() >= NATRON_VIEWER_PROGRESSIVE_RENDER_MIN_TIME_SECONDS ) ) {
+        bool hasCoarseTextureCached = false;
+        for (int i = 0; i < 2; ++i) {
+            if ( !args[i] || !args[i]->params || (status[i] != ViewerInstance::eViewerRenderRetCodeRender) ||
+                 args[i]->forceRender || (args[i]->params->nbCachedTile > 0) ) {
+                continue;
+            }
+            coarseArgs[i] = boost::make_shared<ViewerArgs>();
+            ViewerInstance::ViewerRenderRetCode coarseStatus = _imp->viewer->getRenderViewerArgsAndCheckCache_public( frame, false, true, view, i, viewerHash, canAbort, rotoPaintNode, RenderStatsPtr(), coarseArgs[i].get() );
+            if ( (coarseStatus != ViewerInstance::eViewerRenderRetCodeRender) || !coarseArgs[i]->params ||
+                 (coarseArgs[i]->mipMapLevelWithDraft == coarseArgs[i]->mipmapLevelWithoutDraft) ) {
+                coarseArgs[i].reset();
+                continue;
+            }
+            if ( (coarseArgs[i]->params->nbCachedTile > 0) && ( coarseArgs[i]->params->nbCachedTile == (int)coarseArgs[i]->params->tiles.size() ) ) {
+                // The coarse texture was cached: display it while the full resolution render runs
+                if (!hasCoarseTextureCached) {
+                    _imp->viewer->aboutToUpdateTextures();
+                    hasCoarseTextureCached = true;
+                }
+                _imp->viewer->updateViewer(coarseArgs[i]->params);
+                coarseArgs[i].reset();
+                continue;
+            }
+            hasCoarseArgs = true;
+        }
+        if (hasCoarseTextureCached) {
+            _imp->viewer->redrawViewer();
+        }
+    }
+
 #ifdef BOOST_NO_CXX11_VARIADIC_TEMPLATES
     CurrentFrameFunctorArgsPtr functorArgs( new CurrentFrameFunctorArgs(view,
                                                                                         frame,
@@ -3957,11 +4225,26 @@ ViewerCurrentFrameRequestScheduler::renderCurrentFrame(bool enableRenderStats,
 #endif
     functorArgs->args[0] = args[0];
     functorArgs->args[1] = args[1];
+    functorArgs->coarseArgs[0] = coarseArgs[0];
+    functorArgs->coarseArgs[1] = coarseArgs[1];
 
     if (appPTR->getCurrentSettings()->getNumberOfThreads() == -1) {
         RenderCurrentFrameFunctorRunnable task(functorArgs);
         task.run();
     } else {
+        if (hasCoarseArgs) {
+            // The coarse pass is displayed before the full resolution render, give it the older age
+            ViewerCurrentFrameRequestSchedulerStartArgsPtr coarseRequest = boost::make_shared<ViewerCurrentFrameRequestSchedulerStartArgs>();
+            coarseRequest->age = _imp->ageCounter;
+            if ( _imp->ageCounter >= std::numeric_limits<U64>::max() ) {
+                _imp->ageCounter = 0;
+            } else {
+                ++_imp->ageCounter;
+            }
+            startTask(coarseRequest);
+            functorArgs->coarseRequest = coarseRequest;
+        }
+
         // Identify this render request with an age
         ViewerCurrentFrameRequestSchedulerStartArgsPtr request = boost::make_shared<ViewerCurrentFrameRequestSchedulerStartArgs>();
         request->age = _imp->ageCounter;
@@ -4017,6 +4300,215 @@ ViewerCurrentFrameRequestRendererBackup::threadLoopOnce(const GenericThreadStart
     return eThreadStateActive;
 }
 
+////////////////////////ViewerPrefetchScheduler////////////////////////
+class ViewerPrefetchStartArgs
+    : public GenericThreadStartArgs
+{
+public:
+
+    // The frames to render, in order
+    std::vector<int> frames;
+    ViewIdx view;
+    U64 viewerHash;
+
+    ViewerPrefetchStartArgs()
+        : GenericThreadStartArgs()
+        , frames()
+        , view(0)
+        , viewerHash(0)
+    {
+    }
+
+    virtual ~ViewerPrefetchStartArgs()
+    {
+    }
+};
+
+typedef boost::shared_ptr<ViewerPrefetchStartArgs> ViewerPrefetchStartArgsPtr;
+
+struct ViewerPrefetchSchedulerPrivate
+{
+    ViewerInstance* viewer;
+
+    // The current frame of the last prefetch and the direction in which the timeline moved to reach it.
+    // Only accessed on the main-thread
+    int lastTime;
+    bool lastTimeSet;
+    bool forward;
+
+    // The abort info of the frame being rendered, protected by abortInfoMutex
+    QMutex abortInfoMutex;
+    AbortableRenderInfoPtr abortInfo;
+
+    ViewerPrefetchSchedulerPrivate(ViewerInstance* viewer)
+        : viewer(viewer)
+        , lastTime(0)
+        , lastTimeSet(false)
+        , forward(true)
+        , abortInfoMutex()
+        , abortInfo()
+    {
+    }
+};
+
+ViewerPrefetchScheduler::ViewerPrefetchScheduler(ViewerInstance* viewer)
+    : GenericSchedulerThread()
+    , _imp( new ViewerPrefetchSchedulerPrivate(viewer) )
+{
+    setThreadName("ViewerPrefetchScheduler");
+}
+
+ViewerPrefetchScheduler::~ViewerPrefetchScheduler()
+{
+    // Should've been stopped before anyway
+    if ( quitThread(false) ) {
+        waitForThreadToQuit_enforce_blocking();
+    }
+}
+
+void
+ViewerPrefetchScheduler::getFramesToPrefetch(int time,
+                                             int first,
+                                             int last,
+                                             int count,
+                                             bool forward,
+                                             std::vector<int>* frames)
+{
+    frames->clear();
+
+    const int direction = forward ? 1 : -1;
+    int ahead = 0;
+    int behind = 0;
+    bool aheadDone = false;
+    bool behindDone = false;
+    while ( ( (int)frames->size() < count ) && (!aheadDone || !behindDone) ) {
+        for (int i = 0; i < 2 && !aheadDone && (int)frames->size() < count; ++i) {
+            int frame = time + direction * (ahead + 1);
+            if ( (frame < first) || (frame > last) ) {
+                aheadDone = true;
+            } else {
+                ++ahead;
+                frames->push_back(frame);
+            }
+        }
+        if ( !behindDone && ( (int)frames->size() < count ) ) {
+            int frame = time - direction * (behind + 1);
+            if ( (frame < first) || (frame > last) ) {
+                behindDone = true;
+            } else {
+                ++behind;
+                frames->push_back(frame);
+            }
+        }
+    }
+}
+
+void
+ViewerPrefetchScheduler::prefetchAroundCurrentFrame()
+{
+    assert( QThread::currentThread() == qApp->thread() );
+
+    int count = appPTR->getCurrentSettings()->getViewerPrefetchFramesCount();
+    // Without render threads everything is rendered on the main-thread, @see ViewerCurrentFrameRequestScheduler::renderCurrentFrame
+    if ( (count <= 0) || (appPTR->getCurrentSettings()->getNumberOfThreads() == -1) ) {
+        return;
+    }
+
+    ViewerInstance* viewer = _imp->viewer;
+    if ( !viewer->isViewerUIVisible() || viewer->isDoingPartialUpdates() ) {
+        return;
+    }
+
+    // Do not compete with the renders of a paint stroke
+    NodePtr rotoPaintNode;
+    RotoStrokeItemPtr curStroke;
+    bool isDrawing = false;
+    viewer->getApp()->getActiveRotoDrawingStroke(&rotoPaintNode, &curStroke, &isDrawing);
+    if (isDrawing) {
+        return;
+    }
+
+    // Prefetch more frames in the direction in which the timeline last moved, e.g. the direction of the last playback
+    int time = viewer->getTimeline()->currentFrame();
+    if ( _imp->lastTimeSet && (time != _imp->lastTime) ) {
+        _imp->forward = time > _imp->lastTime;
+    }
+    _imp->lastTime = time;
+    _imp->lastTimeSet = true;
+
+    int first, last;
+    viewer->getTimelineBounds(&first, &last);
+
+    ViewerPrefetchStartArgsPtr args = boost::make_shared<ViewerPrefetchStartArgs>();
+    getFramesToPrefetch(time, first, last, count, _imp->forward, &args->frames);
+    if ( args->frames.empty() ) {
+        return;
+    }
+    int viewsCount = viewer->getRenderViewsCount();
+    args->view = viewsCount > 0 ? viewer->getViewerCurrentView() : ViewIdx(0);
+    args->viewerHash = viewer->getHash();
+
+    startTask(args);
+}
+
+void
+ViewerPrefetchScheduler::onAbortRequested(bool /*keepOldestRender*/)
+{
+    // Abort the frame being rendered right away: the nodes check it in EffectInstance::aborted()
+    QMutexLocker k(&_imp->abortInfoMutex);
+
+    if (_imp->abortInfo) {
+        _imp->abortInfo->setAborted();
+    }
+}
+
+GenericSchedulerThread::ThreadStateEnum
+ViewerPrefetchScheduler::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
+{
+    ViewerPrefetchStartArgsPtr args = boost::dynamic_pointer_cast<ViewerPrefetchStartArgs>(inArgs);
+
+    assert(args);
+
+    // Leave the CPU to the interactive renders and the playback
+    setPriority(QThread::LowestPriority);
+
+    ThreadStateEnum state = eThreadStateActive;
+    for (std::vector<int>::const_iterator it = args->frames.begin(); it != args->frames.end(); ++it) {
+        AbortableRenderInfoPtr abortInfo = AbortableRenderInfo::create(true, 0);
+        {
+            QMutexLocker k(&_imp->abortInfoMutex);
+            _imp->abortInfo = abortInfo;
+        }
+
+        // An abort requested before abortInfo was set is seen here, a later one aborts abortInfo
+        state = resolveState();
+        if ( (state == eThreadStateAborted) || (state == eThreadStateStopped) ) {
+            break;
+        }
+
+        ViewerInstance::ViewerRenderRetCode stat;
+        try {
+            stat = _imp->viewer->prefetchFrame(*it, args->view, args->viewerHash, abortInfo);
+        } catch (...) {
+            stat = ViewerInstance::eViewerRenderRetCodeFail;
+        }
+        if (stat == ViewerInstance::eViewerRenderRetCodeFail) {
+            // The render of the current frame reports the errors, the other frames would most likely fail as well
+            break;
+        }
+    }
+
+    {
+        QMutexLocker k(&_imp->abortInfoMutex);
+        _imp->abortInfo.reset();
+    }
+
+    ///This thread is done, clean-up its TLS
+    appPTR->getAppTLS()->cleanupTLSForThread();
+
+    return state;
+} // ViewerPrefetchScheduler::threadLoopOnce
+
 NATRON_NAMESPACE_EXIT
 
 NATRON_NAMESPACE_USING
@@ -622,6 +622,47 @@ private:
     virtual ThreadStateEnum threadLoopOnce(const GenericThreadStartArgsPtr& inArgs) OVERRIDE FINAL WARN_UNUSED_RETURN;
 };
 
+/**
+ * @brief Low priority thread rendering in the viewer cache the frames around the current frame while the viewer is idle,
+ * so that they are cached when the user scrubs the timeline back and forth.
+ * The RenderEngine aborts it as soon as the viewer has to render anything else.
+ **/
+struct ViewerPrefetchSchedulerPrivate;
+class ViewerPrefetchScheduler
+    : public GenericSchedulerThread
+{
+public:
+
+    ViewerPrefetchScheduler(ViewerInstance* viewer);
+
+    virtual ~ViewerPrefetchScheduler();
+
+    /**
+     * @brief Starts to prefetch the frames around the current frame of the viewer. Must be called on the main-thread
+     * once the viewer displayed the most recent render request.
+     **/
+    void prefetchAroundCurrentFrame();
+
+    /**
+     * @brief Returns in frames the count frames to prefetch around time, in the order in which they should be rendered:
+     * two frames are taken in the given direction for each frame taken in the other direction, within [first, last].
+     **/
+    static void getFramesToPrefetch(int time, int first, int last, int count, bool forward, std::vector<int>* frames);
+
+private:
+
+    virtual TaskQueueBehaviorEnum tasksQueueBehaviour() const OVERRIDE FINAL
+    {
+        return eTaskQueueBehaviorSkipToMostRecent;
+    }
+
+    virtual void onAbortRequested(bool keepOldestRender) OVERRIDE FINAL;
+
+    virtual ThreadStateEnum threadLoopOnce(const GenericThreadStartArgsPtr& inArgs) OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    boost::scoped_ptr<ViewerPrefetchSchedulerPrivate> _imp;
+};
+
 
 /**
  * @brief This class manages multiple OutputThreadScheduler so that each render request gets processed as soon as possible.
@@ -672,6 +713,13 @@ public:
      **/
     void renderCurrentFrame(bool enableRenderStats, bool canAbort);
 
+    /**
+     * @brief Called on the main-thread when the viewer has displayed the most recent render of the current frame
+     * and has nothing else to render: prefetches the frames around the current frame in the viewer cache.
+     * Any other render request aborts the prefetch.
+     **/
+    void prefetchAroundCurrentFrame();
+
     /**
      * @brief Whether the playback can be automatically restarted by a single render request
      **/
@@ -0,0 +1,302 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ParallelRenderController.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <sstream> // stringstream
+
+#ifdef __NATRON_WIN32__
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h> // getrusage
+#endif
+
+#include <QtCore/QMutex>
+
+#include "Engine/Timer.h"
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/// The CPU time used by all the threads of the process, in seconds
+double
+getProcessCPUTime()
+{
+#ifdef __NATRON_WIN32__
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if ( !GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime) ) {
+        return 0.;
+    }
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    // in units of 100 ns
+    return (kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.;
+    }
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+struct ParallelRenderControllerPrivate
+{
+    mutable QMutex lock;
+
+    int maxFramesInFlight;
+    int nCPUs;
+    int framesInFlight;
+
+    // The clock of the render, and the time each frame in flight was started at
+    TimeLapse clock;
+    std::map<int, double> frameStartTimes;
+
+    // The current measure
+    int framesToSkip; // frames started before the last change, which do not count
+    int nMeasuredFrames;
+    double measureStartTime;
+    double measureStartCPUTime;
+    double frameTimeSum;
+
+    // The previous measure and the change made after it (-1, 0 or 1)
+    bool hasPreviousMeasure;
+    ParallelRenderMeasure previousMeasure;
+    int lastChange;
+
+    // Number of frames in flight that was found slower, 0 if none
+    int slowerFramesInFlight;
+    int nMeasuresSinceChange;
+
+    ParallelRenderControllerPrivate()
+        : lock()
+        , maxFramesInFlight(1)
+        , nCPUs(1)
+        , framesInFlight(1)
+        , clock()
+        , frameStartTimes()
+        , framesToSkip(0)
+        , nMeasuredFrames(0)
+        , measureStartTime(0.)
+        , measureStartCPUTime(0.)
+        , frameTimeSum(0.)
+        , hasPreviousMeasure(false)
+        , previousMeasure()
+        , lastChange(0)
+        , slowerFramesInFlight(0)
+        , nMeasuresSinceChange(0)
+    {
+    }
+
+    void startMeasure()
+    {
+        nMeasuredFrames = 0;
+        frameTimeSum = 0.;
+        measureStartTime = clock.getTimeSinceCreation();
+        measureStartCPUTime = getProcessCPUTime();
+    }
+
+    bool canAddFrame(const ParallelRenderMeasure& measure) const
+    {
+        return framesInFlight < maxFramesInFlight &&
+               (slowerFramesInFlight == 0 || framesInFlight + 1 < slowerFramesInFlight) &&
+               measure.memoryPressure < NATRON_PARALLEL_RENDERS_MEMORY_HIGH;
+    }
+
+    std::string decide(const ParallelRenderMeasure& measure);
+};
+
+std::string
+ParallelRenderControllerPrivate::decide(const ParallelRenderMeasure& measure)
+{
+    // Private, should not lock
+    assert( !lock.tryLock() );
+
+    const int oldFramesInFlight = framesInFlight;
+    const char* reason;
+    if ( (measure.memoryPressure >= NATRON_PARALLEL_RENDERS_MEMORY_FULL) && (framesInFlight > 1) ) {
+        --framesInFlight;
+        slowerFramesInFlight = oldFramesInFlight;
+        reason = "the image cache is full";
+    } else if ( (lastChange != 0) && hasPreviousMeasure &&
+                ( measure.throughput < previousMeasure.throughput * (1. - NATRON_PARALLEL_RENDERS_THROUGHPUT_TOLERANCE) ) ) {
+        framesInFlight = previousMeasure.nFramesInFlight;
+        if (lastChange > 0) {
+            slowerFramesInFlight = oldFramesInFlight;
+        }
+        reason = "the last change made the render slower, reverting it";
+    } else if ( (measure.cpuUsage < NATRON_PARALLEL_RENDERS_CPU_IDLE) && canAddFrame(measure) ) {
+        ++framesInFlight;
+        reason = "the CPUs are idle";
+    } else if ( (lastChange > 0) && hasPreviousMeasure && canAddFrame(measure) &&
+                ( measure.throughput > previousMeasure.throughput * (1. + NATRON_PARALLEL_RENDERS_THROUGHPUT_TOLERANCE) ) ) {
+        ++framesInFlight;
+        reason = "the last added frame made the render faster";
+    } else {
+        reason = "keeping the current setting";
+    }
+
+    if (framesInFlight != oldFramesInFlight) {
+        lastChange = framesInFlight > oldFramesInFlight ? 1 : -1;
+        nMeasuresSinceChange = 0;
+        // the frames started with the previous setting are not measured
+        framesToSkip = oldFramesInFlight;
+    } else {
+        lastChange = 0;
+        if (++nMeasuresSinceChange >= NATRON_PARALLEL_RENDERS_RETRY_MEASURES) {
+            // the tree or the machine load may have changed since
+            slowerFramesInFlight = 0;
+            nMeasuresSinceChange = 0;
+        }
+    }
+    previousMeasure = measure;
+    hasPreviousMeasure = true;
+
+    std::stringstream ss;
+    ss << "Parallel renders: " << oldFramesInFlight << " -> " << framesInFlight << " frame(s) in flight, "
+       << std::max(1, nCPUs / framesInFlight) << " tile thread(s) per frame ("
+       << (int)(measure.cpuUsage * 100.) << "% CPU, "
+       << measure.throughput << " fps, "
+       << measure.frameTime << " s per frame, image cache memory "
+       << (int)(measure.memoryPressure * 100.) << "% full): " << reason;
+
+    return ss.str();
+} // ParallelRenderControllerPrivate::decide
+
+ParallelRenderController::ParallelRenderController()
+    : _imp( new ParallelRenderControllerPrivate() )
+{
+}
+
+ParallelRenderController::~ParallelRenderController()
+{
+}
+
+void
+ParallelRenderController::reset(int maxFramesInFlight,
+                                int nCPUs)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->maxFramesInFlight = std::max(1, maxFramesInFlight);
+    _imp->nCPUs = std::max(1, nCPUs);
+    _imp->framesInFlight = 1;
+    _imp->frameStartTimes.clear();
+    _imp->framesToSkip = 0;
+    _imp->hasPreviousMeasure = false;
+    _imp->lastChange = 0;
+    _imp->slowerFramesInFlight = 0;
+    _imp->nMeasuresSinceChange = 0;
+    _imp->startMeasure();
+}
+
+void
+ParallelRenderController::notifyFrameStarted(int time)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->frameStartTimes[time] = _imp->clock.getTimeSinceCreation();
+}
+
+bool
+ParallelRenderController::notifyFrameRendered(int time,
+                                              double memoryPressure,
+                                              std::string* decision)
+{
+    QMutexLocker k(&_imp->lock);
+    std::map<int, double>::iterator found = _imp->frameStartTimes.find(time);
+
+    if ( found == _imp->frameStartTimes.end() ) {
+        return false;
+    }
+    const double now = _imp->clock.getTimeSinceCreation();
+    const double frameTime = now - found->second;
+    _imp->frameStartTimes.erase(found);
+
+    if (_imp->framesToSkip > 0) {
+        if (--_imp->framesToSkip == 0) {
+            _imp->startMeasure();
+        }
+
+        return false;
+    }
+
+    ++_imp->nMeasuredFrames;
+    _imp->frameTimeSum += frameTime;
+    const double elapsed = now - _imp->measureStartTime;
+    if ( (_imp->nMeasuredFrames < _imp->framesInFlight) || (elapsed < NATRON_PARALLEL_RENDERS_MIN_MEASURE_TIME) ) {
+        return false;
+    }
+
+    ParallelRenderMeasure measure;
+    measure.nFramesInFlight = _imp->framesInFlight;
+    measure.throughput = _imp->nMeasuredFrames / elapsed;
+    measure.frameTime = _imp->frameTimeSum / _imp->nMeasuredFrames;
+    measure.cpuUsage = (getProcessCPUTime() - _imp->measureStartCPUTime) / (elapsed * _imp->nCPUs);
+    measure.memoryPressure = memoryPressure;
+
+    *decision = _imp->decide(measure);
+    _imp->startMeasure();
+
+    return true;
+}
+
+std::string
+ParallelRenderController::decide(const ParallelRenderMeasure& measure)
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->decide(measure);
+}
+
+int
+ParallelRenderController::getFramesInFlight() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->framesInFlight;
+}
+
+int
+ParallelRenderController::getTileThreadsPerFrame() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return std::max(1, _imp->nCPUs / _imp->framesInFlight);
+}
+
+NATRON_NAMESPACE_EXIT
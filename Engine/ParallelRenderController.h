@@ -0,0 +1,149 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_ParallelRenderController_h
+#define Engine_ParallelRenderController_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+// Below this fraction of the CPUs used, a frame is added in flight
+#define NATRON_PARALLEL_RENDERS_CPU_IDLE 0.8
+
+// Relative change of throughput below which two measures are considered equal
+#define NATRON_PARALLEL_RENDERS_THROUGHPUT_TOLERANCE 0.05
+
+// Above this occupation of the memory portion of the image cache, no frame is added. The evictor of the cache keeps it
+// between its watermarks (80% to 90%), so this only happens when the frames in flight hold more images than the cache can evict.
+#define NATRON_PARALLEL_RENDERS_MEMORY_HIGH 0.95
+
+// Above this occupation of the memory portion of the image cache, a frame is removed
+#define NATRON_PARALLEL_RENDERS_MEMORY_FULL 1.
+
+// Minimum duration of a measure, in seconds
+#define NATRON_PARALLEL_RENDERS_MIN_MEASURE_TIME 0.5
+
+// Number of measures without change after which a number of frames that was found slower is tried again
+#define NATRON_PARALLEL_RENDERS_RETRY_MEASURES 8
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief What was measured while rendering with a given number of frames in flight
+ **/
+struct ParallelRenderMeasure
+{
+    int nFramesInFlight;
+
+    // Frames rendered per second
+    double throughput;
+
+    // Mean wall clock time to render a frame, in seconds
+    double frameTime;
+
+    // Fraction of the CPUs used by the process
+    double cpuUsage;
+
+    // Occupation of the memory portion of the image cache
+    double memoryPressure;
+
+    ParallelRenderMeasure()
+        : nFramesInFlight(1)
+        , throughput(0.)
+        , frameTime(0.)
+        , cpuUsage(0.)
+        , memoryPressure(0.)
+    {
+    }
+};
+
+struct ParallelRenderControllerPrivate;
+
+/**
+ * @brief Chooses how many frames the OutputSchedulerThread renders at the same time. The other threads of the
+ * TaskScheduler render the tiles of these frames, so the fewer frames are in flight, the more threads work on the tiles
+ * of each frame.
+ *
+ * The render starts with 1 frame in flight. After each measure (at least NATRON_PARALLEL_RENDERS_MIN_MEASURE_TIME seconds and
+ * as many frames as in flight, once the frames started with the previous setting are done):
+ * - if the image cache is full, a frame is removed: each frame in flight holds its images;
+ * - if the last change made the throughput drop, it is reverted, and this number of frames is not tried again for a while;
+ * - if the CPUs are idle, or the last added frame improved the throughput, a frame is added;
+ * - otherwise nothing changes.
+ * Effects that render in a single thread thus get as many frames in flight as needed to use all the CPUs, while a tree whose
+ * tiles parallelize well stays with few frames, which is faster and uses less memory.
+ * This class is MT-safe.
+ **/
+class ParallelRenderController
+{
+public:
+
+    ParallelRenderController();
+
+    ~ParallelRenderController();
+
+    /**
+     * @brief Starts a new render with 1 frame in flight, up to maxFramesInFlight. nCPUs is the number of CPUs to share
+     * between the frames.
+     **/
+    void reset(int maxFramesInFlight, int nCPUs);
+
+    /**
+     * @brief Called when a render thread starts to render a frame
+     **/
+    void notifyFrameStarted(int time);
+
+    /**
+     * @brief Called when a frame is rendered. Returns true if a measure was completed, in which case decision describes
+     * what was measured and decided.
+     **/
+    bool notifyFrameRendered(int time, double memoryPressure, std::string* decision);
+
+    /**
+     * @brief Updates the number of frames in flight from a measure. Returns a description of the decision.
+     **/
+    std::string decide(const ParallelRenderMeasure& measure);
+
+    int getFramesInFlight() const;
+
+    /**
+     * @brief Returns the number of CPUs available for the tiles of each frame
+     **/
+    int getTileThreadsPerFrame() const;
+
+private:
+
+    boost::scoped_ptr<ParallelRenderControllerPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // Engine_ParallelRenderController_h
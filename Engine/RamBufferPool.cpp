@@ -0,0 +1,409 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RamBufferPool.h"
+
+#include <cstdlib>
+#include <cassert>
+#include <climits>
+#include <vector>
+
+#ifdef __NATRON_LINUX__
+#include <sys/mman.h> // madvise
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+
+#include "Engine/NUMATopology.h"
+
+NATRON_NAMESPACE_ENTER
+
+#define NATRON_RAMBUFFER_POOL_N_CLASSES (NATRON_RAMBUFFER_POOL_N_OCTAVES * NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE)
+
+// Default maximum amount of memory kept for reuse, see Settings::getRamBufferPoolMaximumSize()
+#define NATRON_RAMBUFFER_POOL_DEFAULT_MAX_BYTES (512ULL * 1024ULL * 1024ULL)
+
+// The pooled bytes are counted in units of the smallest size class step: all size classes are multiples of it
+#define NATRON_RAMBUFFER_POOL_UNIT_BYTES (NATRON_RAMBUFFER_POOL_MIN_BYTES / NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE)
+
+// Size of the header placed before the buffers of a size class. It keeps the buffers aligned for SIMD code.
+#define NATRON_RAMBUFFER_POOL_HEADER_BYTES 64
+
+namespace {
+/// Placed before each buffer that belongs to a size class
+struct BufferHeader
+{
+    // False if the buffer was allocated with its exact size while the pool was disabled: it is smaller than its
+    // size class and must never go to a free list, even if the pool is enabled before it is released
+    bool pooled;
+
+    // The NUMA node the buffer was bound to when it was allocated, or -1 if NUMA-aware rendering was disabled
+    int node;
+};
+
+struct PoolSizeClass
+{
+    // Protects all the members
+    QMutex lock;
+    std::vector<void*> freeBuffers;
+
+    // Statistics of the class, summed by RamBufferPool::getStats()
+    U64 nHits;
+    U64 nMisses;
+    U64 nReleased;
+
+    PoolSizeClass()
+        : lock()
+        , freeBuffers()
+        , nHits(0)
+        , nMisses(0)
+        , nReleased(0)
+    {
+    }
+};
+
+struct PoolState
+{
+    // The free buffers of each NUMA node. When NUMA-aware rendering is disabled, only node 0 is used.
+    PoolSizeClass classes[NATRON_NUMA_MAX_NODES][NATRON_RAMBUFFER_POOL_N_CLASSES];
+
+    // In units of NATRON_RAMBUFFER_POOL_UNIT_BYTES, so that allocations and deallocations only take the lock of their class
+    QAtomicInt pooledUnits;
+    QAtomicInt maxPooledUnits;
+
+    PoolState()
+        : pooledUnits(0)
+        , maxPooledUnits(NATRON_RAMBUFFER_POOL_DEFAULT_MAX_BYTES / NATRON_RAMBUFFER_POOL_UNIT_BYTES)
+    {
+    }
+};
+
+PoolState pool;
+
+/**
+ * @brief Computes the size class of a buffer of nBytes bytes.
+ * Each octave (2^e, 2^(e+1)] above NATRON_RAMBUFFER_POOL_MIN_BYTES is split in NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE
+ * classes of equal width.
+ * @returns False if the buffer is too small or too large to be pooled.
+ **/
+bool
+getSizeClass(std::size_t nBytes,
+             int* classIndex,
+             std::size_t* classBytes)
+{
+    if (nBytes <= NATRON_RAMBUFFER_POOL_MIN_BYTES) {
+        return false;
+    }
+
+    // e = floor(log2(nBytes - 1)), so that 2^e < nBytes <= 2^(e+1)
+    int e = 0;
+    for (std::size_t v = nBytes - 1; v >>= 1; ) {
+        ++e;
+    }
+    int minE = 0;
+    for (std::size_t v = NATRON_RAMBUFFER_POOL_MIN_BYTES; v >>= 1; ) {
+        ++minE;
+    }
+    assert(e >= minE);
+    int octave = e - minE;
+    if (octave >= NATRON_RAMBUFFER_POOL_N_OCTAVES) {
+        return false;
+    }
+
+    std::size_t step = ( (std::size_t)1 << e ) / NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE;
+    std::size_t k = (nBytes + step - 1) / step; // in ]CLASSES_PER_OCTAVE, 2 * CLASSES_PER_OCTAVE]
+    assert(k > NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE && k <= 2 * NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE);
+    *classIndex = octave * NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE + (int)(k - NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE - 1);
+    *classBytes = k * step;
+
+    return true;
+}
+
+/// Recovers the size of a class from its index, see getSizeClass()
+std::size_t
+getClassBytes(int classIndex)
+{
+    int octave = classIndex / NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE;
+    int classInOctave = classIndex % NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE;
+    std::size_t octaveStart = (std::size_t)NATRON_RAMBUFFER_POOL_MIN_BYTES << octave;
+
+    return octaveStart + (octaveStart / NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE) * (classInOctave + 1);
+}
+
+int
+getClassUnits(std::size_t classBytes)
+{
+    assert(classBytes % NATRON_RAMBUFFER_POOL_UNIT_BYTES == 0);
+    U64 units = classBytes / NATRON_RAMBUFFER_POOL_UNIT_BYTES;
+
+    // A buffer this large never fits in the pool
+    return units > INT_MAX ? INT_MAX : (int)units;
+}
+
+BufferHeader*
+getHeader(void* ptr)
+{
+    return (BufferHeader*)( (char*)ptr - NATRON_RAMBUFFER_POOL_HEADER_BYTES );
+}
+
+const BufferHeader*
+getHeader(const void* ptr)
+{
+    return (const BufferHeader*)( (const char*)ptr - NATRON_RAMBUFFER_POOL_HEADER_BYTES );
+}
+
+void*
+systemAllocate(std::size_t nBytes)
+{
+#ifdef __NATRON_LINUX__
+    if (nBytes >= NATRON_RAMBUFFER_POOL_HUGE_PAGE_BYTES) {
+        // Align on the huge page size and let the kernel back the buffer with huge pages:
+        // this divides the number of page faults and TLB misses when touching large images.
+        void* ptr = 0;
+        if (posix_memalign(&ptr, NATRON_RAMBUFFER_POOL_HUGE_PAGE_BYTES, nBytes) != 0) {
+            return 0;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, nBytes, MADV_HUGEPAGE);
+#endif
+
+        return ptr;
+    }
+#endif
+
+    return malloc(nBytes);
+}
+
+/// Allocates a buffer of nBytes bytes preceded by its header
+void*
+allocateWithHeader(std::size_t nBytes,
+                   bool pooled,
+                   int node)
+{
+    char* base = (char*)systemAllocate(NATRON_RAMBUFFER_POOL_HEADER_BYTES + nBytes);
+
+    if (!base) {
+        return 0;
+    }
+    void* ptr = base + NATRON_RAMBUFFER_POOL_HEADER_BYTES;
+    getHeader(ptr)->pooled = pooled;
+    getHeader(ptr)->node = node;
+    if (node >= 0) {
+        NUMATopology::bindMemoryToNode(base, NATRON_RAMBUFFER_POOL_HEADER_BYTES + nBytes, node);
+    }
+
+    return ptr;
+}
+
+void
+freeWithHeader(void* ptr)
+{
+    free( getHeader(ptr) );
+}
+
+/**
+ * @brief The node whose free lists receive a buffer that is released: the node it was bound to at allocation,
+ * read from its header rather than asked to the kernel, or the node of the releasing thread if it was not bound.
+ **/
+int
+getDeallocationNode(void* ptr)
+{
+    if ( !NUMATopology::isEnabled() ) {
+        return 0;
+    }
+    int node = getHeader(ptr)->node;
+
+    return node >= 0 ? node : NUMATopology::getCurrentNode();
+}
+} // anon namespace
+
+void*
+RamBufferPool::allocate(std::size_t nBytes)
+{
+    int classIndex;
+    std::size_t classBytes;
+
+    if ( !getSizeClass(nBytes, &classIndex, &classBytes) ) {
+        return malloc(nBytes);
+    }
+
+    if ( (int)pool.maxPooledUnits == 0 ) {
+        // Do not round up to the size class a buffer that will not be reused
+        return allocateWithHeader(nBytes, false, -1);
+    }
+
+    // With NUMA-aware rendering, the buffer is taken from, or placed on, the node of the calling thread
+    const bool numa = NUMATopology::isEnabled();
+    const int node = numa ? NUMATopology::getCurrentNode() : 0;
+    void* ptr = 0;
+    {
+        PoolSizeClass& sizeClass = pool.classes[node][classIndex];
+        QMutexLocker k(&sizeClass.lock);
+        if ( sizeClass.freeBuffers.empty() ) {
+            ++sizeClass.nMisses;
+        } else {
+            ptr = sizeClass.freeBuffers.back();
+            sizeClass.freeBuffers.pop_back();
+            ++sizeClass.nHits;
+        }
+    }
+    if (ptr) {
+        pool.pooledUnits.fetchAndAddOrdered( -getClassUnits(classBytes) );
+
+        return ptr;
+    }
+
+    return allocateWithHeader(classBytes, true, numa ? node : -1);
+}
+
+void
+RamBufferPool::deallocate(void* ptr,
+                          std::size_t nBytes)
+{
+    if (!ptr) {
+        return;
+    }
+    int classIndex;
+    std::size_t classBytes;
+    if ( !getSizeClass(nBytes, &classIndex, &classBytes) ) {
+        free(ptr);
+
+        return;
+    }
+    if (!getHeader(ptr)->pooled) {
+        freeWithHeader(ptr);
+
+        return;
+    }
+
+    // Reserve room for the buffer in the pool, or give it back if the pool is full
+    const int units = getClassUnits(classBytes);
+    const int maxUnits = (int)pool.maxPooledUnits;
+    bool reserved = false;
+    bool fits = false;
+    if (units <= maxUnits) {
+        reserved = true;
+        fits = pool.pooledUnits.fetchAndAddOrdered(units) <= maxUnits - units;
+    }
+    PoolSizeClass& sizeClass = pool.classes[getDeallocationNode(ptr)][classIndex];
+    {
+        QMutexLocker k(&sizeClass.lock);
+        if (fits) {
+            sizeClass.freeBuffers.push_back(ptr);
+
+            return;
+        }
+        ++sizeClass.nReleased;
+    }
+    if (reserved) {
+        pool.pooledUnits.fetchAndAddOrdered(-units);
+    }
+    freeWithHeader(ptr);
+}
+
+std::size_t
+RamBufferPool::getAllocationSize(std::size_t nBytes)
+{
+    int classIndex;
+    std::size_t classBytes;
+
+    if ( !getSizeClass(nBytes, &classIndex, &classBytes) || ( (int)pool.maxPooledUnits == 0 ) ) {
+        return nBytes;
+    }
+
+    return classBytes;
+}
+
+std::size_t
+RamBufferPool::getAllocationSize(const void* ptr,
+                                 std::size_t nBytes)
+{
+    int classIndex;
+    std::size_t classBytes;
+
+    if ( !getSizeClass(nBytes, &classIndex, &classBytes) || !getHeader(ptr)->pooled ) {
+        return nBytes;
+    }
+
+    return classBytes;
+}
+
+void
+RamBufferPool::setMaximumPooledBytes(U64 maxBytes)
+{
+    U64 maxUnits = maxBytes / NATRON_RAMBUFFER_POOL_UNIT_BYTES;
+
+    pool.maxPooledUnits.fetchAndStoreOrdered( maxUnits > INT_MAX ? INT_MAX : (int)maxUnits );
+    if ( (int)pool.pooledUnits > (int)pool.maxPooledUnits ) {
+        clear();
+    }
+}
+
+U64
+RamBufferPool::getMaximumPooledBytes()
+{
+    return (U64)(int)pool.maxPooledUnits * NATRON_RAMBUFFER_POOL_UNIT_BYTES;
+}
+
+void
+RamBufferPool::clear()
+{
+    for (int node = 0; node < NATRON_NUMA_MAX_NODES; ++node) {
+        for (int i = 0; i < NATRON_RAMBUFFER_POOL_N_CLASSES; ++i) {
+            PoolSizeClass& sizeClass = pool.classes[node][i];
+            std::vector<void*> buffers;
+            {
+                QMutexLocker k(&sizeClass.lock);
+                buffers.swap(sizeClass.freeBuffers);
+            }
+            if ( buffers.empty() ) {
+                continue;
+            }
+            for (std::vector<void*>::iterator it = buffers.begin(); it != buffers.end(); ++it) {
+                freeWithHeader(*it);
+            }
+            pool.pooledUnits.fetchAndAddOrdered( -getClassUnits( getClassBytes(i) ) * (int)buffers.size() );
+        }
+    }
+}
+
+void
+RamBufferPool::getStats(Stats* stats)
+{
+    *stats = Stats();
+    for (int node = 0; node < NATRON_NUMA_MAX_NODES; ++node) {
+        for (int i = 0; i < NATRON_RAMBUFFER_POOL_N_CLASSES; ++i) {
+            PoolSizeClass& sizeClass = pool.classes[node][i];
+            QMutexLocker k(&sizeClass.lock);
+            stats->pooledBytes += getClassBytes(i) * sizeClass.freeBuffers.size();
+            stats->nPooledBuffers += sizeClass.freeBuffers.size();
+            stats->nHits += sizeClass.nHits;
+            stats->nMisses += sizeClass.nMisses;
+            stats->nReleased += sizeClass.nReleased;
+        }
+    }
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,124 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_RAMBUFFERPOOL_H
+#define NATRON_ENGINE_RAMBUFFERPOOL_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#include "Global/GlobalDefines.h"
+#include "Engine/EngineFwd.h"
+
+// Buffers smaller than this are not pooled: malloc is good enough for them
+#define NATRON_RAMBUFFER_POOL_MIN_BYTES (64 * 1024)
+
+// Each power of 2 is split in this many size classes, so a pooled buffer wastes at most 1/8 of its size
+#define NATRON_RAMBUFFER_POOL_CLASSES_PER_OCTAVE 8
+
+// Number of octaves above NATRON_RAMBUFFER_POOL_MIN_BYTES that are pooled (up to 128 TiB)
+#define NATRON_RAMBUFFER_POOL_N_OCTAVES 31
+
+// Buffers at least this big are aligned so they can be backed by transparent huge pages
+#define NATRON_RAMBUFFER_POOL_HUGE_PAGE_BYTES (2 * 1024 * 1024)
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief A process-wide pool of large memory buffers, used by RamBuffer and by the viewer textures.
+ * Buffer sizes are rounded up to a size class, and buffers that are released go back to the free list of their
+ * class instead of being returned to the system, up to getMaximumPooledBytes() bytes.
+ * During playback, images and textures mostly have the same few sizes, so most allocations are served
+ * from the pool without page faults nor fragmentation.
+ * On Linux, buffers larger than NATRON_RAMBUFFER_POOL_HUGE_PAGE_BYTES are advised to use huge pages.
+ * Buffers larger than NATRON_RAMBUFFER_POOL_MIN_BYTES are preceded by a small header that tells whether they may be pooled.
+ * This class is MT-safe.
+ **/
+class RamBufferPool
+{
+public:
+
+    struct Stats
+    {
+        // Bytes currently held by the pool, ready for reuse
+        U64 pooledBytes;
+        U64 nPooledBuffers;
+
+        // Number of allocations served from the pool / by the system
+        U64 nHits;
+        U64 nMisses;
+
+        // Number of buffers that were returned to the system because the pool was full
+        U64 nReleased;
+
+        Stats()
+            : pooledBytes(0)
+            , nPooledBuffers(0)
+            , nHits(0)
+            , nMisses(0)
+            , nReleased(0)
+        {
+        }
+    };
+
+    /**
+     * @brief Returns a buffer of at least nBytes bytes, or NULL if the allocation failed.
+     * The buffer must be released with deallocate() with the same nBytes.
+     **/
+    static void* allocate(std::size_t nBytes);
+
+    /**
+     * @brief Releases a buffer returned by allocate(nBytes).
+     **/
+    static void deallocate(void* ptr, std::size_t nBytes);
+
+    /**
+     * @brief Returns the number of bytes that allocate(nBytes) would allocate now.
+     **/
+    static std::size_t getAllocationSize(std::size_t nBytes);
+
+    /**
+     * @brief Returns the number of bytes actually allocated for ptr, which was returned by allocate(nBytes).
+     **/
+    static std::size_t getAllocationSize(const void* ptr, std::size_t nBytes);
+
+    /**
+     * @brief Set the maximum number of bytes kept in the pool for reuse. Extra buffers are returned to the system.
+     * With a maximum of 0 the pool is disabled and buffers are allocated with their exact size.
+     **/
+    static void setMaximumPooledBytes(U64 maxBytes);
+    static U64 getMaximumPooledBytes();
+
+    /**
+     * @brief Returns all pooled buffers to the system.
+     **/
+    static void clear();
+
+    static void getStats(Stats* stats);
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_RAMBUFFERPOOL_H
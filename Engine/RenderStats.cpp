@@ -77,6 +77,12 @@ struct NodeRenderStatsPrivate
     //Premultiplication of the output imge
     ImagePremultiplicationEnum outputPremult;
 
+    //Number of nodes rehashed by the last change that modified the hash of this node
+    int nbNodesRehashed;
+
+    //What the scheduler measured and decided when the frame was rendered, empty if nothing
+    std::string schedulerDecision;
+
     NodeRenderStatsPrivate()
         : totalTimeSpentRendering(0)
         , rod()
@@ -92,6 +98,8 @@ struct NodeRenderStatsPrivate
         , renderScaleSupportEnabled(false)
         , channelsEnabled()
         , outputPremult(eImagePremultiplicationOpaque)
+        , nbNodesRehashed(0)
+        , schedulerDecision()
     {
         for (int i = 0; i < 4; ++i) {
             channelsEnabled[i] = false;
@@ -133,6 +141,8 @@ NodeRenderStats::operator=(const NodeRenderStats& other)
         _imp->channelsEnabled[i] = other._imp->channelsEnabled[i];
     }
     _imp->outputPremult = other._imp->outputPremult;
+    _imp->nbNodesRehashed = other._imp->nbNodesRehashed;
+    _imp->schedulerDecision = other._imp->schedulerDecision;
 }
 
 void
@@ -301,6 +311,30 @@ NodeRenderStats::getOutputPremult() const
     return _imp->outputPremult;
 }
 
+void
+NodeRenderStats::setNbNodesRehashed(int nbNodes)
+{
+    _imp->nbNodesRehashed = nbNodes;
+}
+
+int
+NodeRenderStats::getNbNodesRehashed() const
+{
+    return _imp->nbNodesRehashed;
+}
+
+void
+NodeRenderStats::setSchedulerDecision(const std::string& decision)
+{
+    _imp->schedulerDecision = decision;
+}
+
+const std::string&
+NodeRenderStats::getSchedulerDecision() const
+{
+    return _imp->schedulerDecision;
+}
+
 struct RenderStatsPrivate
 {
     mutable QMutex lock;
@@ -399,6 +433,7 @@ RenderStats::setGlobalRenderInfosForNode(const NodePtr& node,
     stats.addMipMapLevelRendered(mipmapLevel);
     stats.setChannelsRendered(channelsRendered);
     stats.setRoD(rod);
+    stats.setNbNodesRehashed( node->getNbNodesRehashedByLastHashChange() );
 }
 
 void
@@ -435,6 +470,16 @@ RenderStats::addRenderInfosForNode(const NodePtr& node,
     stats.addPlaneRendered(plane);
 }
 
+void
+RenderStats::setSchedulerDecisionForNode(const NodePtr& node,
+                                         const std::string& decision)
+{
+    QMutexLocker k(&_imp->lock);
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+
+    stats.setSchedulerDecision(decision);
+}
+
 std::map<NodePtr, NodeRenderStats >
 RenderStats::getStats(double *totalTimeSpent) const
 {
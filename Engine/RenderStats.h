@@ -99,6 +99,12 @@ public:
     void setOutputPremult(ImagePremultiplicationEnum premult);
     ImagePremultiplicationEnum getOutputPremult() const;
 
+    void setNbNodesRehashed(int nbNodes);
+    int getNbNodesRehashed() const;
+
+    void setSchedulerDecision(const std::string& decision);
+    const std::string& getSchedulerDecision() const;
+
 private:
 
     boost::scoped_ptr<NodeRenderStatsPrivate> _imp;
@@ -142,6 +148,11 @@ public:
                                const RectI& rectangle,
                                double timeSpent);
 
+    /**
+     * @brief Records what the ParallelRenderController measured and decided when this frame was rendered
+     **/
+    void setSchedulerDecisionForNode(const NodePtr& node, const std::string& decision);
+
     std::map<NodePtr, NodeRenderStats > getStats(double *totalTimeSpent) const;
 
 private:
@@ -0,0 +1,317 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RenderTrace.h"
+
+#include <algorithm>
+#include <cstdio> // snprintf
+#include <cstring> // strncpy
+#include <iomanip>
+#include <list>
+#include <sstream> // stringstream
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+
+#include "Global/FStreamsSupport.h"
+
+#include "Engine/EffectInstance.h"
+#include "Engine/RectI.h"
+
+#ifdef _MSC_VER
+#define snprintf _snprintf
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+struct TraceEvent
+{
+    const char* category;
+    const char* name;
+    U64 startTime;
+    U64 duration;
+    char arg[NATRON_RENDER_TRACE_ARG_SIZE];
+};
+
+/// The events of a thread. Only this thread writes them.
+struct ThreadTrace
+{
+    int id;
+    std::string threadName;
+
+    // Ring buffer of the last NATRON_RENDER_TRACE_EVENTS_PER_THREAD events
+    std::vector<TraceEvent> events;
+
+    // Number of events recorded
+    U64 nEvents;
+};
+
+typedef boost::shared_ptr<ThreadTrace> ThreadTracePtr;
+
+struct RenderTraceState
+{
+    QAtomicInt enabled;
+
+    // Protects clockStarted and threads
+    QMutex lock;
+    QElapsedTimer clock;
+    QAtomicInt clockStarted;
+    std::list<ThreadTracePtr> threads;
+
+    RenderTraceState()
+        : enabled(0)
+        , lock()
+        , clock()
+        , clockStarted(0)
+        , threads()
+    {
+    }
+};
+
+RenderTraceState trace;
+
+// The events of the current thread, created with its first event
+NATRON_THREAD_LOCAL ThreadTrace* currentThreadTrace = 0;
+
+ThreadTrace*
+getCurrentThreadTrace()
+{
+    if (currentThreadTrace) {
+        return currentThreadTrace;
+    }
+    ThreadTracePtr threadTrace(new ThreadTrace);
+    threadTrace->events.resize(NATRON_RENDER_TRACE_EVENTS_PER_THREAD);
+    threadTrace->nEvents = 0;
+
+    QThread* curThread = QThread::currentThread();
+    QMutexLocker k(&trace.lock);
+    threadTrace->id = (int)trace.threads.size() + 1;
+    threadTrace->threadName = (qApp && qApp->thread() == curThread) ? "Main" : curThread->objectName().toStdString();
+    if ( threadTrace->threadName.empty() ) {
+        std::stringstream ss;
+        ss << "Thread " << threadTrace->id;
+        threadTrace->threadName = ss.str();
+    }
+    trace.threads.push_back(threadTrace);
+    currentThreadTrace = threadTrace.get();
+
+    return currentThreadTrace;
+}
+
+void
+writeJSONString(std::ostream& os,
+                const std::string& str)
+{
+    os << '"';
+    for (std::size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = (unsigned char)str[i];
+        if ( (c == '"') || (c == '\\') ) {
+            os << '\\' << (char)c;
+        } else if (c < 0x20) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+        } else {
+            os << (char)c;
+        }
+    }
+    os << '"';
+}
+
+/// Writes a time in nanoseconds as microseconds, the unit of the trace event format
+void
+writeMicroseconds(std::ostream& os,
+                  U64 ns)
+{
+    os << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000;
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+void
+RenderTrace::setEnabled(bool enabled)
+{
+    if (enabled) {
+        QMutexLocker k(&trace.lock);
+        if ( !(int)trace.clockStarted ) {
+            trace.clock.start();
+            trace.clockStarted.fetchAndStoreOrdered(1);
+        }
+    }
+    trace.enabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
+bool
+RenderTrace::isEnabled()
+{
+    return (int)trace.enabled;
+}
+
+U64
+RenderTrace::getTime()
+{
+    if ( !(int)trace.clockStarted ) {
+        return 0;
+    }
+
+    return (U64)trace.clock.nsecsElapsed();
+}
+
+void
+RenderTrace::addEvent(const char* category,
+                      const char* name,
+                      const char* arg,
+                      U64 startTime,
+                      U64 duration)
+{
+    ThreadTrace* threadTrace = getCurrentThreadTrace();
+    TraceEvent& event = threadTrace->events[threadTrace->nEvents % NATRON_RENDER_TRACE_EVENTS_PER_THREAD];
+
+    event.category = category;
+    event.name = name;
+    event.startTime = startTime;
+    event.duration = duration;
+    if (arg) {
+        std::strncpy(event.arg, arg, NATRON_RENDER_TRACE_ARG_SIZE - 1);
+        event.arg[NATRON_RENDER_TRACE_ARG_SIZE - 1] = 0;
+    } else {
+        event.arg[0] = 0;
+    }
+    ++threadTrace->nEvents;
+}
+
+bool
+RenderTrace::writeChromeTrace(const std::string& filename)
+{
+    FStreamsSupport::ofstream ofile;
+
+    FStreamsSupport::open(&ofile, filename);
+    if (!ofile) {
+        return false;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QMutexLocker k(&trace.lock);
+    bool first = true;
+    ofile << "{\"traceEvents\":[\n";
+    for (std::list<ThreadTracePtr>::const_iterator it = trace.threads.begin(); it != trace.threads.end(); ++it) {
+        const ThreadTrace& threadTrace = **it;
+        if (!first) {
+            ofile << ",\n";
+        }
+        first = false;
+        ofile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << threadTrace.id << ",\"args\":{\"name\":";
+        writeJSONString(ofile, threadTrace.threadName);
+        ofile << "}}";
+
+        const U64 nEvents = std::min( threadTrace.nEvents, (U64)NATRON_RENDER_TRACE_EVENTS_PER_THREAD );
+        for (U64 i = threadTrace.nEvents - nEvents; i < threadTrace.nEvents; ++i) {
+            const TraceEvent& event = threadTrace.events[i % NATRON_RENDER_TRACE_EVENTS_PER_THREAD];
+            ofile << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"ts\":";
+            writeMicroseconds(ofile, event.startTime);
+            ofile << ",\"dur\":";
+            writeMicroseconds(ofile, event.duration);
+            ofile << ",\"pid\":" << pid << ",\"tid\":" << threadTrace.id;
+            if (event.arg[0]) {
+                ofile << ",\"args\":{\"arg\":";
+                writeJSONString( ofile, std::string(event.arg) );
+                ofile << '}';
+            }
+            ofile << '}';
+        }
+    }
+    ofile << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    return (bool)ofile;
+} // RenderTrace::writeChromeTrace
+
+void
+RenderTrace::clear()
+{
+    QMutexLocker k(&trace.lock);
+
+    for (std::list<ThreadTracePtr>::const_iterator it = trace.threads.begin(); it != trace.threads.end(); ++it) {
+        (*it)->nEvents = 0;
+    }
+}
+
+RenderTraceScope::RenderTraceScope(const char* category,
+                                   const char* name)
+    : _category(category)
+    , _name(name)
+    , _enabled( RenderTrace::isEnabled() )
+    , _startTime(0)
+{
+    if (_enabled) {
+        _arg[0] = 0;
+        _startTime = RenderTrace::getTime();
+    }
+}
+
+RenderTraceScope::RenderTraceScope(const char* category,
+                                   const char* name,
+                                   const EffectInstance* effect)
+    : _category(category)
+    , _name(name)
+    , _enabled( RenderTrace::isEnabled() )
+    , _startTime(0)
+{
+    if (_enabled) {
+        snprintf( _arg, NATRON_RENDER_TRACE_ARG_SIZE, "%s", effect->getScriptName_mt_safe().c_str() );
+        _startTime = RenderTrace::getTime();
+    }
+}
+
+RenderTraceScope::RenderTraceScope(const char* category,
+                                   const char* name,
+                                   const EffectInstance* effect,
+                                   const RectI& rect)
+    : _category(category)
+    , _name(name)
+    , _enabled( RenderTrace::isEnabled() )
+    , _startTime(0)
+{
+    if (_enabled) {
+        snprintf( _arg, NATRON_RENDER_TRACE_ARG_SIZE, "%s %d,%d,%d,%d", effect->getScriptName_mt_safe().c_str(), rect.x1, rect.y1, rect.x2, rect.y2 );
+        _startTime = RenderTrace::getTime();
+    }
+}
+
+RenderTraceScope::~RenderTraceScope()
+{
+    if (_enabled) {
+        RenderTrace::addEvent(_category, _name, _arg, _startTime, RenderTrace::getTime() - _startTime);
+    }
+}
+
+NATRON_NAMESPACE_EXIT
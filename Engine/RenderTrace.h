@@ -0,0 +1,115 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_RenderTrace_h
+#define Engine_RenderTrace_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#include "Global/GlobalDefines.h"
+#include "Engine/EngineFwd.h"
+
+// The number of events kept for each thread: when a thread records more, its oldest events are overwritten
+#define NATRON_RENDER_TRACE_EVENTS_PER_THREAD 16384
+
+// The maximum length of the argument of an event (the node name and the rectangle), including the terminating 0
+#define NATRON_RENDER_TRACE_ARG_SIZE 48
+
+// The categories of the events
+#define kRenderTraceCategoryAction "action"
+#define kRenderTraceCategoryRender "render"
+#define kRenderTraceCategoryCache "cache"
+#define kRenderTraceCategoryMemory "memory"
+#define kRenderTraceCategoryLock "lock"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief A tracer of the renders: the actions of the effects, the tiles, the cache lookups, the image allocations
+ * and the waits on locks are recorded with their duration, and can be written to a file in the Chrome trace event
+ * format, which can be opened in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * It is disabled by default, see the --trace command-line option. When disabled, a RenderTraceScope only reads a flag.
+ * When enabled, each thread records its events in its own ring buffer, without any lock.
+ * This class is MT-safe.
+ **/
+class RenderTrace
+{
+public:
+
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled();
+
+    /**
+     * @brief Returns the time elapsed since the tracer was first enabled, in nanoseconds
+     **/
+    static U64 getTime();
+
+    /**
+     * @brief Records an event of the calling thread. category and name must be string literals, arg may be NULL.
+     **/
+    static void addEvent(const char* category, const char* name, const char* arg, U64 startTime, U64 duration);
+
+    /**
+     * @brief Writes the events of all threads to filename in the Chrome trace event JSON format.
+     * The threads should not be rendering anymore, otherwise the events they are recording may be partially written.
+     **/
+    static bool writeChromeTrace(const std::string& filename);
+
+    /**
+     * @brief Removes the events of all threads. Same restriction as writeChromeTrace.
+     **/
+    static void clear();
+};
+
+/**
+ * @brief Records an event lasting from its construction to its destruction, if the tracer is enabled
+ **/
+class RenderTraceScope
+{
+public:
+
+    RenderTraceScope(const char* category, const char* name);
+
+    RenderTraceScope(const char* category, const char* name, const EffectInstance* effect);
+
+    RenderTraceScope(const char* category, const char* name, const EffectInstance* effect, const RectI& rect);
+
+    ~RenderTraceScope();
+
+private:
+
+    const char* _category;
+    const char* _name;
+    bool _enabled;
+    U64 _startTime;
+    char _arg[NATRON_RENDER_TRACE_ARG_SIZE];
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // Engine_RenderTrace_h
@@ -47,6 +47,8 @@
 #include "Engine/KnobTypes.h"
 #include "Engine/LibraryBinary.h"
 #include "Engine/MemoryInfo.h" // getSystemTotalRAM, isApplication32Bits, printAsRAM
+#include "Engine/NUMATopology.h"
+#include "Engine/RamBufferPool.h"
 #include "Engine/Node.h"
 #include "Engine/OSGLContext.h"
 #include "Engine/OutputSchedulerThread.h"
@@ -326,6 +328,14 @@ Settings::initializeKnobsThreading()
     _nThreadsPerEffect->disableSlider();
     _threadingPage->addKnob(_nThreadsPerEffect);
 
+    _numaAwareRendering = AppManager::createKnob<KnobBool>( this, tr("NUMA-aware rendering") );
+    _numaAwareRendering->setName("numaAwareRendering");
+    _numaAwareRendering->setHintToolTip( tr("On machines with several processors (NUMA nodes), keep each parallel render on one "
+                                            "processor: its threads only run on the cores of the processor and its images are "
+                                            "allocated in the memory attached to it, which avoids slow accesses to the memory "
+                                            "of the other processors. This has no effect on machines with a single NUMA node.") );
+    _threadingPage->addKnob(_numaAwareRendering);
+
     _renderInSeparateProcess = AppManager::createKnob<KnobBool>( this, tr("Render in a separate process") );
     _renderInSeparateProcess->setName("renderNewProcess");
     _renderInSeparateProcess->setHintToolTip( tr("If true, %1 will render frames to disk in "
@@ -1044,12 +1054,15 @@ Settings::initializeKnobsViewers()
                                         tr("Post-processing done by the viewer (such as colorspace conversion) is done "
                                            "by the CPU. The size of cached textures is thus smaller.").toStdString() ));
 
-    //textureModes.push_back("16bits half-float");
-    //helpStringsTextureModes.push_back("Not available yet. Similar to 32bits fp.");
     textureModes.push_back(ChoiceOption("32f",
                                         tr("32-bit floating-point").toStdString(),
                                         tr("Post-processing done by the viewer (such as colorspace conversion) is done "
                                            "by the GPU, using GLSL. The size of cached textures is thus larger.").toStdString()));
+    textureModes.push_back(ChoiceOption("16f",
+                                        tr("16-bit half floating-point").toStdString(),
+                                        tr("Same as 32-bit floating-point, but the cached textures are stored as half floats, "
+                                           "which halves their size: twice as many frames fit in the viewer cache. "
+                                           "The values keep 11 significant bits and values above 65504 are clipped to infinity.").toStdString()));
     _texturesMode->populateChoices(textureModes);
 
 
@@ -1113,6 +1126,48 @@ Settings::initializeKnobsViewers()
 
     _viewersTab->addKnob(_autoProxyLevel);
 
+    _autoContrastFromPreviousFrame = AppManager::createKnob<KnobBool>( this, tr("Auto-contrast from the previous frame") );
+    _autoContrastFromPreviousFrame->setName("autoContrastPreviousFrame");
+    _autoContrastFromPreviousFrame->setHintToolTip( tr("When checked, during playback and when scrubbing the timeline, the auto-contrast "
+                                                       "of the viewer uses the range of values of the previous frame, which is measured "
+                                                       "while the frame is displayed, so that the image is read only once. "
+                                                       "When unchecked, the range of each frame is computed before displaying it, "
+                                                       "which is slower on large images. Still frames always use their own range.") );
+    _autoContrastFromPreviousFrame->setAddNewLine(false);
+    _viewersTab->addKnob(_autoContrastFromPreviousFrame);
+
+    _autoContrastConvergence = AppManager::createKnob<KnobDouble>( this, tr("Convergence") );
+    _autoContrastConvergence->setName("autoContrastConvergence");
+    _autoContrastConvergence->setHintToolTip( tr("How fast the auto-contrast range follows the range of the frames during playback "
+                                                 "and scrubbing. At 1, each frame uses the range of the previous frame. Lower values "
+                                                 "smooth the range over several frames, which reduces the flickering of the "
+                                                 "auto-contrast on noisy sequences.") );
+    _autoContrastConvergence->setMinimum(0.01);
+    _autoContrastConvergence->setMaximum(1.);
+    _autoContrastConvergence->setDisplayMinimum(0.01);
+    _autoContrastConvergence->setDisplayMaximum(1.);
+    _viewersTab->addKnob(_autoContrastConvergence);
+
+    _viewerPrefetchFrames = AppManager::createKnob<KnobInt>( this, tr("Frames prefetched around the current frame (0=\"none\")") );
+    _viewerPrefetchFrames->setName("viewerPrefetchFrames");
+    _viewerPrefetchFrames->setHintToolTip( tr("When the viewer is idle, this many frames around the current frame are rendered "
+                                              "in the background and kept in the viewer cache, so that they are displayed "
+                                              "immediately when scrubbing the timeline. More frames are rendered in the direction "
+                                              "in which the timeline last moved, within the in and out points of the viewer. "
+                                              "These renders are interrupted as soon as the viewer needs to render anything else.") );
+    _viewerPrefetchFrames->setMinimum(0);
+    _viewerPrefetchFrames->setMaximum(100);
+    _viewerPrefetchFrames->disableSlider();
+    _viewersTab->addKnob(_viewerPrefetchFrames);
+
+    _viewerProgressiveRender = AppManager::createKnob<KnobBool>( this, tr("Progressive refinement") );
+    _viewerProgressiveRender->setName("viewerProgressiveRender");
+    _viewerProgressiveRender->setHintToolTip( tr("When checked and the previous render of the viewer was slow, a parameter change "
+                                                 "first renders and displays the image at the auto-proxy level, then refines it "
+                                                 "to full resolution. The refinement is skipped if the image changes again "
+                                                 "before it starts.") );
+    _viewersTab->addKnob(_viewerProgressiveRender);
+
     _maximumNodeViewerUIOpened = AppManager::createKnob<KnobInt>( this, tr("Max. opened node viewer interface") );
     _maximumNodeViewerUIOpened->setName("maxNodeUiOpened");
     _maximumNodeViewerUIOpened->setMinimum(1);
@@ -1250,6 +1305,28 @@ Settings::initializeKnobsCaching()
     _unreachableRAMLabel->setAsLabel();
     _cachingTab->addKnob(_unreachableRAMLabel);
 
+    _ramBufferPoolMB = AppManager::createKnob<KnobInt>( this, tr("Memory kept for reuse by the image buffers pool (MiB)") );
+    _ramBufferPoolMB->setName("ramBufferPoolMB");
+    _ramBufferPoolMB->disableSlider();
+    _ramBufferPoolMB->setMinimum(0);
+    _ramBufferPoolMB->setHintToolTip( tr("Image and texture buffers that are released are kept in a pool to be reused by the next images "
+                                         "of the same size, instead of being returned to the system. This avoids page faults and memory "
+                                         "fragmentation during playback. This setting is the maximum amount of memory held by the pool, "
+                                         "in addition to the memory used by the caches. Set it to 0 to disable the pool.") );
+    _cachingTab->addKnob(_ramBufferPoolMB);
+
+    _ramBufferPoolLabel = AppManager::createKnob<KnobString>( this, std::string() );
+    _ramBufferPoolLabel->setName("ramBufferPoolLabel");
+    _ramBufferPoolLabel->setIsPersistent(false);
+    _ramBufferPoolLabel->setAsLabel();
+    _ramBufferPoolLabel->setAddNewLine(false);
+    _cachingTab->addKnob(_ramBufferPoolLabel);
+
+    _refreshRamBufferPoolLabel = AppManager::createKnob<KnobButton>( this, tr("Refresh") );
+    _refreshRamBufferPoolLabel->setName("refreshRamBufferPoolLabel");
+    _refreshRamBufferPoolLabel->setHintToolTip( tr("Refresh the usage statistics of the image buffers pool.") );
+    _cachingTab->addKnob(_refreshRamBufferPoolLabel);
+
     _maxViewerDiskCacheGB = AppManager::createKnob<KnobInt>( this, tr("Maximum playback disk cache size (GiB)") );
     _maxViewerDiskCacheGB->setName("maxViewerDiskCache");
     _maxViewerDiskCacheGB->disableSlider();
@@ -1280,6 +1357,38 @@ Settings::initializeKnobsCaching()
     _diskCachePath->setHintToolTip( diskCacheTt + defaultLocation );
     _cachingTab->addKnob(_diskCachePath);
 
+    _shardedCache = AppManager::createKnob<KnobBool>( this, tr("Sharded cache") );
+    _shardedCache->setName("shardedCache");
+    _shardedCache->setHintToolTip( tr("WARNING: Changing this parameter requires a restart of the application. \n"
+                                      "When checked, each cache is split into several independently locked parts "
+                                      "(one per processor core), so that render threads looking up different images "
+                                      "never wait on each other. This is recommended on computers with many cores. "
+                                      "When unchecked, a single lock protects each cache.") );
+    _cachingTab->addKnob(_shardedCache);
+
+    std::vector<ChoiceOption> cachePolicies;
+    cachePolicies.push_back(ChoiceOption("lru",
+                                         tr("LRU").toStdString(),
+                                         tr("The least recently used entries are evicted first.").toStdString() ));
+    cachePolicies.push_back(ChoiceOption("2q",
+                                         tr("2Q").toStdString(),
+                                         tr("New entries are evicted first unless they are re-used, so that scrubbing the timeline "
+                                            "or rendering a long sequence does not evict the entries of the frame being worked on.").toStdString() ));
+
+    _imageCachePolicy = AppManager::createKnob<KnobChoice>( this, tr("Image cache replacement policy") );
+    _imageCachePolicy->setName("imageCachePolicy");
+    _imageCachePolicy->populateChoices(cachePolicies);
+    _imageCachePolicy->setHintToolTip( tr("Which images are evicted first from the image cache and the DiskCache node cache when they are full."
+                                          " Hover each option with the mouse for a detailed description.") );
+    _cachingTab->addKnob(_imageCachePolicy);
+
+    _viewerCachePolicy = AppManager::createKnob<KnobChoice>( this, tr("Playback cache replacement policy") );
+    _viewerCachePolicy->setName("viewerCachePolicy");
+    _viewerCachePolicy->populateChoices(cachePolicies);
+    _viewerCachePolicy->setHintToolTip( tr("Which frames are evicted first from the playback cache when it is full."
+                                           " Hover each option with the mouse for a detailed description.") );
+    _cachingTab->addKnob(_viewerCachePolicy);
+
     _wipeDiskCache = AppManager::createKnob<KnobButton>( this, tr("Wipe Disk Cache") );
     _wipeDiskCache->setHintToolTip( tr("Cleans-up all caches, deleting all folders that may contain cached data. "
                                        "This is provided in case %1 lost track of cached images "
@@ -1420,6 +1529,16 @@ Settings::setCachingLabels()
 
     _maxRAMLabel->setValue( printAsRAM(maxRAM).toStdString() );
     _unreachableRAMLabel->setValue( printAsRAM( (double)systemTotalRam * ( (double)_unreachableRAMPercent->getValue() / 100. ) ).toStdString() );
+
+    RamBufferPool::Stats poolStats;
+    RamBufferPool::getStats(&poolStats);
+    U64 nAllocs = poolStats.nHits + poolStats.nMisses;
+    int hitPercent = nAllocs == 0 ? 0 : (int)( (100 * poolStats.nHits) / nAllocs );
+    _ramBufferPoolLabel->setValue( tr("%1 in %2 buffers, %3% of allocations reused, %4 buffers released to the system")
+                                   .arg( printAsRAM(poolStats.pooledBytes) )
+                                   .arg(poolStats.nPooledBuffers)
+                                   .arg(hitPercent)
+                                   .arg(poolStats.nReleased).toStdString() );
 }
 
 void
@@ -1446,6 +1565,7 @@ Settings::setDefaultValues()
 #endif
     _useThreadPool->setDefaultValue(true);
     _nThreadsPerEffect->setDefaultValue(0);
+    _numaAwareRendering->setDefaultValue(false);
     _renderInSeparateProcess->setDefaultValue(false, 0);
     _queueRenders->setDefaultValue(false);
 
@@ -1498,9 +1618,13 @@ Settings::setDefaultValues()
     _aggressiveCaching->setDefaultValue(false);
     _maxRAMPercent->setDefaultValue(50, 0);
     _unreachableRAMPercent->setDefaultValue(5);
+    _ramBufferPoolMB->setDefaultValue(512);
     _maxViewerDiskCacheGB->setDefaultValue(5, 0);
     _maxDiskCacheNodeGB->setDefaultValue(10, 0);
     //_diskCachePath
+    _shardedCache->setDefaultValue(false);
+    _imageCachePolicy->setDefaultValue(eCacheReplacementPolicy2Q);
+    _viewerCachePolicy->setDefaultValue(eCacheReplacementPolicyLRU);
     setCachingLabels();
 
     // Viewer
@@ -1518,6 +1642,10 @@ Settings::setDefaultValues()
     _autoWipe->setDefaultValue(true);
     _autoProxyWhenScrubbingTimeline->setDefaultValue(true);
     _autoProxyLevel->setDefaultValue(1);
+    _autoContrastFromPreviousFrame->setDefaultValue(true);
+    _autoContrastConvergence->setDefaultValue(1.);
+    _viewerPrefetchFrames->setDefaultValue(10);
+    _viewerProgressiveRender->setDefaultValue(true);
     _maximumNodeViewerUIOpened->setDefaultValue(2);
     _viewerKeys->setDefaultValue(true);
 
@@ -2120,6 +2248,7 @@ Settings::restoreSettings(bool useDefault)
         appPTR->setNThreadsPerEffect( getNumberOfThreadsPerEffect() );
         appPTR->setNThreadsToRender( getNumberOfThreads() );
         appPTR->setUseThreadPool( _useThreadPool->getValue() );
+        NUMATopology::setEnabled( isNUMAAwareRenderingEnabled() );
         appPTR->setPluginsUseInputImageCopyToRender( _pluginUseImageCopyForSource->getValue() );
     } catch (std::logic_error&) {
         // ignore
@@ -2252,6 +2381,19 @@ Settings::onKnobValueChanged(KnobI* k,
             appPTR->setApplicationsCachesMaximumMemoryPercent( getRamMaximumPercent() );
         }
         setCachingLabels();
+    } else if ( k == _imageCachePolicy.get() ) {
+        if (!_restoringSettings) {
+            appPTR->setApplicationsCachesReplacementPolicy( getImageCacheReplacementPolicy(), getViewerCacheReplacementPolicy() );
+        }
+    } else if ( k == _viewerCachePolicy.get() ) {
+        if (!_restoringSettings) {
+            appPTR->setApplicationsCachesReplacementPolicy( getImageCacheReplacementPolicy(), getViewerCacheReplacementPolicy() );
+        }
+    } else if ( k == _ramBufferPoolMB.get() ) {
+        RamBufferPool::setMaximumPooledBytes( getRamBufferPoolMaximumSize() );
+        setCachingLabels();
+    } else if ( k == _refreshRamBufferPoolLabel.get() ) {
+        setCachingLabels();
     } else if ( k == _diskCachePath.get() ) {
         QString path = QString::fromUtf8(_diskCachePath->getValue().c_str());
         qputenv(NATRON_DISK_CACHE_PATH_ENV_VAR, path.toUtf8());
@@ -2271,6 +2413,10 @@ Settings::onKnobValueChanged(KnobI* k,
         }
     } else if ( k == _nThreadsPerEffect.get() ) {
         appPTR->setNThreadsPerEffect( getNumberOfThreadsPerEffect() );
+    } else if ( k == _numaAwareRendering.get() ) {
+        NUMATopology::setEnabled( isNUMAAwareRenderingEnabled() );
+        // the pooled buffers are kept per node only in NUMA-aware mode
+        RamBufferPool::clear();
     } else if ( k == _ocioConfigKnob.get() ) {
         if (_ocioConfigKnob->getActiveEntry().id == NATRON_CUSTOM_OCIO_CONFIG_NAME) {
             _customOcioConfigFile->setAllDimensionsEnabled(true);
@@ -2310,6 +2456,8 @@ Settings::onKnobValueChanged(KnobI* k,
         appPTR->toggleAutoHideGraphInputs();
     } else if ( k == _autoProxyWhenScrubbingTimeline.get() ) {
         _autoProxyLevel->setSecret( !_autoProxyWhenScrubbingTimeline->getValue() );
+    } else if ( k == _autoContrastFromPreviousFrame.get() ) {
+        _autoContrastConvergence->setSecret( !_autoContrastFromPreviousFrame->getValue() );
     } else if ( !_restoringSettings &&
                 ( ( k == _sunkenColor.get() ) ||
                   ( k == _baseColor.get() ) ||
@@ -2396,6 +2544,8 @@ Settings::getViewersBitDepth() const
         return eImageBitDepthByte;
     } else if (v == 1) {
         return eImageBitDepthFloat;
+    } else if (v == 2) {
+        return eImageBitDepthHalf;
     } else {
         return eImageBitDepthByte;
     }
@@ -2455,6 +2605,30 @@ Settings::getAutoProxyMipMapLevel() const
     return (unsigned int)_autoProxyLevel->getValue() + 1;
 }
 
+bool
+Settings::isAutoContrastFromPreviousFrameEnabled() const
+{
+    return _autoContrastFromPreviousFrame->getValue();
+}
+
+double
+Settings::getAutoContrastConvergence() const
+{
+    return _autoContrastConvergence->getValue();
+}
+
+int
+Settings::getViewerPrefetchFramesCount() const
+{
+    return _viewerPrefetchFrames->getValue();
+}
+
+bool
+Settings::isViewerProgressiveRenderEnabled() const
+{
+    return _viewerProgressiveRender->getValue();
+}
+
 int
 Settings::getMaxOpenedNodesViewerContext() const
 {
@@ -2494,6 +2668,30 @@ Settings::getMaximumDiskCacheNodeSize() const
     return (U64)( _maxDiskCacheNodeGB->getValue() ) * std::pow(1024., 3.);
 }
 
+bool
+Settings::isShardedCacheEnabled() const
+{
+    return _shardedCache->getValue();
+}
+
+CacheReplacementPolicyEnum
+Settings::getImageCacheReplacementPolicy() const
+{
+    return (CacheReplacementPolicyEnum)_imageCachePolicy->getValue();
+}
+
+CacheReplacementPolicyEnum
+Settings::getViewerCacheReplacementPolicy() const
+{
+    return (CacheReplacementPolicyEnum)_viewerCachePolicy->getValue();
+}
+
+U64
+Settings::getRamBufferPoolMaximumSize() const
+{
+    return (U64)( _ramBufferPoolMB->getValue() ) * 1024ULL * 1024ULL;
+}
+
 ///////////////////////////////////////////////////
 
 double
@@ -3067,6 +3265,12 @@ Settings::isTransformConcatenationEnabled() const
     return _activateTransformConcatenationSupport->getValue();
 }
 
+bool
+Settings::isNUMAAwareRenderingEnabled() const
+{
+    return _numaAwareRendering->getValue();
+}
+
 bool
 Settings::useGlobalThreadPool() const
 {
@@ -110,6 +110,14 @@ public:
 
     U64 getMaximumDiskCacheNodeSize() const;
 
+    bool isShardedCacheEnabled() const;
+
+    CacheReplacementPolicyEnum getImageCacheReplacementPolicy() const;
+
+    CacheReplacementPolicyEnum getViewerCacheReplacementPolicy() const;
+
+    U64 getRamBufferPoolMaximumSize() const;
+
     double getUnreachableRamPercent() const;
 
     bool getColorPickerLinear() const;
@@ -126,6 +134,8 @@ public:
 
     bool useGlobalThreadPool() const;
 
+    bool isNUMAAwareRenderingEnabled() const;
+
     void setUseGlobalThreadPool(bool use);
 
     void restorePluginSettings();
@@ -247,6 +257,11 @@ public:
     bool isAutoWipeEnabled() const;
     bool isAutoProxyEnabled() const;
     unsigned int getAutoProxyMipMapLevel() const;
+
+    bool isAutoContrastFromPreviousFrameEnabled() const;
+    double getAutoContrastConvergence() const;
+    int getViewerPrefetchFramesCount() const;
+    bool isViewerProgressiveRenderEnabled() const;
     int getMaxOpenedNodesViewerContext() const;
     bool isViewerKeysEnabled() const;
     ///////////////////////////////////////////////////////
@@ -435,6 +450,7 @@ private:
     KnobIntPtr _numberOfParallelRenders;
     KnobBoolPtr _useThreadPool;
     KnobIntPtr _nThreadsPerEffect;
+    KnobBoolPtr _numaAwareRendering;
     KnobBoolPtr _renderInSeparateProcess;
     KnobBoolPtr _queueRenders;
 
@@ -509,10 +525,18 @@ private:
     KnobIntPtr _unreachableRAMPercent;
     KnobStringPtr _unreachableRAMLabel;
 
+    ///The memory kept by the RamBufferPool for reuse and its usage statistics
+    KnobIntPtr _ramBufferPoolMB;
+    KnobStringPtr _ramBufferPoolLabel;
+    KnobButtonPtr _refreshRamBufferPoolLabel;
+
     ///The total disk space allowed for all Natron's caches
     KnobIntPtr _maxViewerDiskCacheGB;
     KnobIntPtr _maxDiskCacheNodeGB;
     KnobPathPtr _diskCachePath;
+    KnobBoolPtr _shardedCache;
+    KnobChoicePtr _imageCachePolicy;
+    KnobChoicePtr _viewerCachePolicy;
     KnobButtonPtr _wipeDiskCache;
 
     // Viewer
@@ -525,6 +549,10 @@ private:
     KnobBoolPtr _autoWipe;
     KnobBoolPtr _autoProxyWhenScrubbingTimeline;
     KnobChoicePtr _autoProxyLevel;
+    KnobBoolPtr _autoContrastFromPreviousFrame;
+    KnobDoublePtr _autoContrastConvergence;
+    KnobIntPtr _viewerPrefetchFrames;
+    KnobBoolPtr _viewerProgressiveRender;
     KnobIntPtr _maximumNodeViewerUIOpened;
     KnobBoolPtr _viewerKeys;
 
@@ -26,7 +26,14 @@
 #include "TLSHolderImpl.h"
 
 #include <cassert>
+#include <list>
+#include <map>
 #include <stdexcept>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/make_shared.hpp>
+#endif
 
 #include "Engine/OfxClipInstance.h"
 #include "Engine/OfxHost.h"
@@ -34,18 +41,242 @@
 #include "Engine/Project.h"
 #include "Engine/ThreadPool.h"
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
 #include <QtCore/QThread>
 #include <QtCore/QDebug>
 
 NATRON_NAMESPACE_ENTER
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The data of a holder in a thread
+struct TLSSlot
+{
+    // The serial number of the holder, 0 if the slot is empty
+    U64 serial;
+    boost::shared_ptr<void> value;
+
+    TLSSlot()
+        : serial(0)
+        , value()
+    {
+    }
+};
+
+typedef std::vector<TLSSlot> TLSSlots;
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+struct TLSSnapshot
+{
+    // The index of each slot and the copy of its data
+    std::vector<std::pair<int, TLSSlot> > slots;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The TLS of a thread
+struct ThreadTLS
+{
+    // Protects the slots against the other threads. The thread itself reads its slots without locking, since they are
+    // only resized and written by itself: the other threads only read them (to copy them to a spawned thread) and
+    // clear the slot of a holder that is destroyed.
+    QMutex mutex;
+    TLSSlots slots;
+
+    // The thread that spawned this thread, if its TLS was not copied yet
+    const QThread* spawner;
+    // The snapshot of the TLS of the spawner thread to copy instead of its current TLS, if any
+    TLSSnapshotPtr snapshot;
+    // 1 if spawner or snapshot is set: checked without locking
+    QAtomicInt hasSpawner;
+
+    ThreadTLS()
+        : mutex()
+        , slots()
+        , spawner(0)
+        , snapshot()
+        , hasSpawner()
+    {
+    }
+};
+
+typedef std::map<const QThread*, ThreadTLS*> ThreadTLSMap;
+
+// The holder that owns a slot
+struct SlotOwner
+{
+    U64 serial;
+    const TLSHolderBase* holder;
+};
+
+// The slots of all holders and the TLS of all threads. The registry is never freed, since the holders may be destroyed
+// after the application. It is only accessed when a holder is created or destroyed, when a thread first uses TLS or
+// cleans it up, and to copy the TLS of a spawner thread.
+struct TLSRegistry
+{
+    QMutex mutex;
+    std::vector<SlotOwner> owners;
+    std::vector<int> freeSlots;
+    U64 lastSerial;
+    ThreadTLSMap threads;
+
+    TLSRegistry()
+        : mutex()
+        , owners()
+        , freeSlots()
+        , lastSerial(0)
+        , threads()
+    {
+    }
+
+    // Must be locked
+    ThreadTLS* getThreadTLS(const QThread* thread,
+                            bool create)
+    {
+        ThreadTLSMap::iterator found = threads.find(thread);
+
+        if ( found != threads.end() ) {
+            return found->second;
+        }
+        if (!create) {
+            return 0;
+        }
+        ThreadTLS* ret = new ThreadTLS();
+        threads.insert( std::make_pair(thread, ret) );
+
+        return ret;
+    }
+};
+
+TLSRegistry*
+getRegistry()
+{
+    static TLSRegistry* registry = 0;
+
+    if (!registry) {
+        registry = new TLSRegistry();
+    }
+
+    return registry;
+}
+
+// Create the registry when the library is loaded, before any other thread is started
+TLSRegistry* const registryAtLoad = getRegistry();
+
+// The TLS of the current thread, NULL until it first uses TLS. This is a plain pointer, so that it can use the
+// native thread-local storage of any compiler.
+NATRON_THREAD_LOCAL ThreadTLS* currentThreadTLS = 0;
+
+ThreadTLS*
+getCurrentThreadTLS()
+{
+    ThreadTLS* ret = currentThreadTLS;
+
+    if (!ret) {
+        //The QThread may have run on another OS thread before: it keeps its TLS
+        TLSRegistry* registry = getRegistry();
+        QMutexLocker k(&registry->mutex);
+        ret = registry->getThreadTLS(QThread::currentThread(), true);
+        currentThreadTLS = ret;
+    }
+
+    return ret;
+}
+
+// Appends to copies the copy of the data of a slot, if its holder still owns it and its data is inherited by spawned
+// threads. The registry must be locked.
+void
+copySlot(const TLSRegistry* registry,
+         int index,
+         const TLSSlot& slot,
+         std::vector<std::pair<int, TLSSlot> >* copies)
+{
+    if ( !slot.value || (registry->owners[index].serial != slot.serial) ) {
+        return;
+    }
+    boost::shared_ptr<void> copy = registry->owners[index].holder->copyTLSValue(slot.value);
+    if (copy) {
+        copies->push_back( std::make_pair( index, TLSSlot() ) );
+        copies->back().second.serial = slot.serial;
+        copies->back().second.value = copy;
+    }
+}
+
+// Copies the TLS of the spawner thread of tls, the TLS of the current thread, if any
+void
+copyTLSFromSpawnerThread(ThreadTLS* tls)
+{
+    const QThread* spawner;
+    TLSSnapshotPtr snapshot;
+    {
+        QMutexLocker k(&tls->mutex);
+        spawner = tls->spawner;
+        snapshot = tls->snapshot;
+        tls->spawner = 0;
+        tls->snapshot.reset();
+        tls->hasSpawner.fetchAndStoreRelaxed(0);
+    }
+    if (!spawner && !snapshot) {
+        return;
+    }
+
+    std::vector<std::pair<int, TLSSlot> > copies;
+    {
+        //The registry lock ensures that the holders are not destroyed while their data is copied
+        TLSRegistry* registry = getRegistry();
+        QMutexLocker k(&registry->mutex);
+        if (snapshot) {
+            //The snapshot is never modified: it is read without locking
+            for (std::size_t i = 0; i < snapshot->slots.size(); ++i) {
+                copySlot(registry, snapshot->slots[i].first, snapshot->slots[i].second, &copies);
+            }
+        } else {
+            ThreadTLS* spawnerTLS = registry->getThreadTLS(spawner, false);
+            if ( !spawnerTLS || (spawnerTLS == tls) ) {
+                return;
+            }
+            QMutexLocker l(&spawnerTLS->mutex);
+            for (std::size_t i = 0; i < spawnerTLS->slots.size(); ++i) {
+                copySlot(registry, (int)i, spawnerTLS->slots[i], &copies);
+            }
+        }
+    }
+
+    //The values that are replaced are destroyed after the lock is released
+    std::vector<TLSSlot> replaced( copies.size() );
+    {
+        QMutexLocker k(&tls->mutex);
+        for (std::size_t i = 0; i < copies.size(); ++i) {
+            const int index = copies[i].first;
+            if ( index >= (int)tls->slots.size() ) {
+                tls->slots.resize(index + 1);
+            }
+            std::swap(replaced[i], tls->slots[index]);
+            tls->slots[index] = copies[i].second;
+        }
+    }
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+TLSHolderBase::TLSHolderBase()
+    : _slot(-1)
+    , _serial(0)
+{
+    AppTLS::allocateSlot(this);
+}
+
+TLSHolderBase::~TLSHolderBase()
+{
+    AppTLS::releaseSlot(this);
+}
 
 AppTLS::AppTLS()
-    : _objectMutex()
-    , _object( new GLobalTLSObject() )
-    , _spawnsMutex()
-    , _spawns()
 {
 }
 
@@ -54,14 +285,85 @@ AppTLS::~AppTLS()
 }
 
 void
-AppTLS::registerTLSHolder(const TLSHolderBaseConstPtr& holder)
+AppTLS::allocateSlot(TLSHolderBase* holder)
 {
-    //This must be the first time for this thread that we reach here since cleanupTLSForThread() was made, otherwise
-    //the TLS data should always be available on the TLSHolder
+    TLSRegistry* registry = getRegistry();
+    QMutexLocker k(&registry->mutex);
+
+    holder->_serial = ++registry->lastSerial;
+    if ( !registry->freeSlots.empty() ) {
+        holder->_slot = registry->freeSlots.back();
+        registry->freeSlots.pop_back();
+    } else {
+        holder->_slot = (int)registry->owners.size();
+        registry->owners.push_back( SlotOwner() );
+    }
+    SlotOwner& owner = registry->owners[holder->_slot];
+    owner.serial = holder->_serial;
+    owner.holder = holder;
+}
+
+void
+AppTLS::releaseSlot(const TLSHolderBase* holder)
+{
+    //The data is destroyed after the locks are released, since it may own other holders
+    std::list<boost::shared_ptr<void> > values;
     {
-        QWriteLocker k(&_objectMutex);
-        //The insert call might not succeed because another thread inserted this holder in the set already, that's fine
-        _object->objects.insert(holder);
+        TLSRegistry* registry = getRegistry();
+        QMutexLocker k(&registry->mutex);
+        for (ThreadTLSMap::iterator it = registry->threads.begin(); it != registry->threads.end(); ++it) {
+            ThreadTLS* tls = it->second;
+            QMutexLocker l(&tls->mutex);
+            if ( ( holder->_slot < (int)tls->slots.size() ) && (tls->slots[holder->_slot].serial == holder->_serial) ) {
+                TLSSlot& slot = tls->slots[holder->_slot];
+                values.push_back(slot.value);
+                slot.value.reset();
+                slot.serial = 0;
+            }
+        }
+        SlotOwner& owner = registry->owners[holder->_slot];
+        owner.serial = 0;
+        owner.holder = 0;
+        registry->freeSlots.push_back(holder->_slot);
+    }
+}
+
+boost::shared_ptr<void>
+AppTLS::getTLSValue(const TLSHolderBase* holder)
+{
+    ThreadTLS* tls = getCurrentThreadTLS();
+
+    //This thread might be registered by a spawner thread, copy the TLS first
+    if ( (int)tls->hasSpawner ) {
+        copyTLSFromSpawnerThread(tls);
+    }
+
+    //Only this thread resizes its slots: no lock is needed
+    if ( holder->_slot < (int)tls->slots.size() ) {
+        const TLSSlot& slot = tls->slots[holder->_slot];
+        if (slot.serial == holder->_serial) {
+            return slot.value;
+        }
+    }
+
+    return boost::shared_ptr<void>();
+}
+
+void
+AppTLS::setTLSValue(const TLSHolderBase* holder,
+                    const boost::shared_ptr<void>& value)
+{
+    ThreadTLS* tls = getCurrentThreadTLS();
+    TLSSlot replaced;
+    {
+        QMutexLocker k(&tls->mutex);
+        if ( holder->_slot >= (int)tls->slots.size() ) {
+            tls->slots.resize(holder->_slot + 1);
+        }
+        TLSSlot& slot = tls->slots[holder->_slot];
+        std::swap(replaced, slot);
+        slot.serial = holder->_serial;
+        slot.value = value;
     }
 }
 
@@ -89,31 +391,86 @@ AppTLS::copyTLS(QThread* fromThread,
         return;
     }
 
+    softCopy(fromThread, toThread);
+    if ( toThread == QThread::currentThread() ) {
+        copyTLSFromSpawnerThread( getCurrentThreadTLS() );
+    }
+}
+
+void
+AppTLS::softCopy(QThread* fromThread,
+                 QThread* toThread)
+{
+    if ( (fromThread == toThread) || !fromThread || !toThread ) {
+        return;
+    }
+
     copyAbortInfo(fromThread, toThread);
 
-    QReadLocker k(&_objectMutex);
-    const TLSObjects& objectsCRef = _object->objects; // take a const ref, since it's a read lock
-    for (TLSObjects::const_iterator it = objectsCRef.begin();
-         it != objectsCRef.end(); ++it) {
-        TLSHolderBaseConstPtr p = (*it).lock();
-        if (p) {
-            p->copyTLS(fromThread, toThread);
+    TLSRegistry* registry = getRegistry();
+    QMutexLocker k(&registry->mutex);
+    ThreadTLS* tls = registry->getThreadTLS(toThread, true);
+    QMutexLocker l(&tls->mutex);
+    tls->spawner = fromThread;
+    tls->snapshot.reset();
+    tls->hasSpawner.fetchAndStoreRelaxed(1);
+}
+
+TLSSnapshotPtr
+AppTLS::takeSnapshot()
+{
+    ThreadTLS* tls = getCurrentThreadTLS();
+
+    if ( (int)tls->hasSpawner ) {
+        copyTLSFromSpawnerThread(tls);
+    }
+
+    boost::shared_ptr<TLSSnapshot> ret = boost::make_shared<TLSSnapshot>();
+    {
+        TLSRegistry* registry = getRegistry();
+        QMutexLocker k(&registry->mutex);
+        //The slots of the current thread are only written by itself: they are read without locking
+        for (std::size_t i = 0; i < tls->slots.size(); ++i) {
+            copySlot(registry, (int)i, tls->slots[i], &ret->slots);
         }
     }
+
+    return ret;
 }
 
 void
-AppTLS::softCopy(QThread* fromThread,
+AppTLS::copyTLS(const TLSSnapshotPtr& snapshot,
+                QThread* fromThread,
+                QThread* toThread)
+{
+    if ( (fromThread == toThread) || !fromThread || !toThread || !snapshot ) {
+        return;
+    }
+
+    softCopy(snapshot, fromThread, toThread);
+    if ( toThread == QThread::currentThread() ) {
+        copyTLSFromSpawnerThread( getCurrentThreadTLS() );
+    }
+}
+
+void
+AppTLS::softCopy(const TLSSnapshotPtr& snapshot,
+                 QThread* fromThread,
                  QThread* toThread)
 {
-    if ( (fromThread == toThread) || !fromThread || !toThread ) {
+    if ( (fromThread == toThread) || !fromThread || !toThread || !snapshot ) {
         return;
     }
 
     copyAbortInfo(fromThread, toThread);
 
-    QWriteLocker k(&_spawnsMutex);
-    _spawns[toThread] = fromThread;
+    TLSRegistry* registry = getRegistry();
+    QMutexLocker k(&registry->mutex);
+    ThreadTLS* tls = registry->getThreadTLS(toThread, true);
+    QMutexLocker l(&tls->mutex);
+    tls->spawner = fromThread;
+    tls->snapshot = snapshot;
+    tls->hasSpawner.fetchAndStoreRelaxed(1);
 }
 
 void
@@ -126,65 +483,23 @@ AppTLS::cleanupTLSForThread()
         isAbortableThread->clearAbortInfo();
     }
 
-    //Cleanup any cached data on the TLSHolder
-    {
-        QWriteLocker l(&_spawnsMutex);
-
-        //This thread was spawned, but TLS not used, do not bother to clean-up
-        ThreadSpawnMap::iterator foundSpawned = _spawns.find(curThread);
-        if ( foundSpawned != _spawns.end() ) {
-            _spawns.erase(foundSpawned);
-
-            return;
-        }
-    }
-    std::list<TLSHolderBaseConstPtr> objectsToClean;
+    //The data is destroyed after the lock is released, since it may own other holders
+    TLSSlots slots;
     {
-        QReadLocker k (&_objectMutex);
-        const TLSObjects& objectsCRef = _object->objects;
-        for (TLSObjects::iterator it = objectsCRef.begin();
-             it != objectsCRef.end();
-             ++it) {
-            TLSHolderBaseConstPtr p = (*it).lock();
-            if (p) {
-                if ( p->canCleanupPerThreadData(curThread) ) {
-                    objectsToClean.push_back(p);
-                }
+        TLSRegistry* registry = getRegistry();
+        QMutexLocker k(&registry->mutex);
+        //If this thread was spawned but did not use TLS, this also forgets its spawner thread
+        ThreadTLSMap::iterator found = registry->threads.find(curThread);
+        if ( found != registry->threads.end() ) {
+            ThreadTLS* tls = found->second;
+            {
+                QMutexLocker l(&tls->mutex);
+                tls->slots.swap(slots);
             }
+            delete tls;
+            registry->threads.erase(found);
         }
-    }
-    if ( !objectsToClean.empty() ) {
-#if 1
-        // version from 1a0712b
-        // should be OK, since the bug in 1a0712b was in canCleanupPerThreadData
-        QWriteLocker k (&_objectMutex);
-        for (std::list<TLSHolderBaseConstPtr>::iterator it = objectsToClean.begin();
-             it != objectsToClean.end();
-             ++it) {
-            if ( (*it)->cleanupPerThreadData(curThread) ) {
-                TLSObjects::iterator found = _object->objects.find(*it);
-                if ( found != _object->objects.end() ) {
-                    _object->objects.erase(found);
-                }
-            }
-        }
-#else
-        // original version
-        TLSObjects newObjects;
-        QWriteLocker k (&_objectMutex);
-        for (TLSObjects::iterator it = _object->objects.begin();
-             it != _object->objects.end(); ++it) {
-            TLSHolderBaseConstPtr p = (*it).lock();
-            if (p) {
-                if ( !p->cleanupPerThreadData(curThread) ) {
-                    //The TLSHolder still has TLS on it for another thread and is still alive,
-                    //then leave it in the set
-                    newObjects.insert(p);
-                }
-            }
-        }
-        _object->objects = newObjects;
-#endif
+        currentThreadTLS = 0;
     }
 } // AppTLS::cleanupTLSForThread
 
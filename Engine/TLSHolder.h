@@ -41,7 +41,6 @@
 #include <boost/enable_shared_from_this.hpp>
 #endif
 
-#include <QtCore/QReadWriteLock>
 #include <QtCore/QThread>
 
 #include "Engine/EngineFwd.h"
@@ -58,53 +57,45 @@ public:
     // TODO: enable_shared_from_this
     // constructors should be privatized in any class that derives from boost::enable_shared_from_this<>
 
-    TLSHolderBase() {}
+    TLSHolderBase();
 
 public:
-    virtual ~TLSHolderBase() {}
-
-protected:
-
     /**
-     * @brief Returns true if cleanupPerThreadData would do anything OR would return true.
-     * It does not return the same value as cleanupPerThreadData, since cleanupPerThreadData
-     * may do something and return false.
-     * This is much faster than cleanupPerThreadData as it does not take any write lock.
+     * @brief Releases the slot of this holder and the data it holds in all threads.
      **/
-    virtual bool canCleanupPerThreadData(const QThread* curThread) const = 0;
+    virtual ~TLSHolderBase();
 
     /**
-     * @brief Must clean-up any data stored for the given thread 'curThread'
-     * @returns True if this object no longer holds any per-thread data
+     * @brief Returns a copy of value, the data of this holder in a spawner thread, for a thread it spawned.
+     * Returns NULL if the data of this holder is not inherited by spawned threads.
      **/
-    virtual bool cleanupPerThreadData(const QThread* curThread) const = 0;
+    virtual boost::shared_ptr<void> copyTLSValue(const boost::shared_ptr<void>& value) const = 0;
 
-    /**
-     * @brief Copy all the TLS from fromThread to toThread
-     **/
-    virtual void copyTLS(const QThread* fromThread, const QThread* toThread) const = 0;
+protected:
+
+    //The index of this holder in the slots of each thread (see AppTLS), and a serial number that is unique to this holder,
+    //so that a slot that is reused by another holder is never mistaken for this one
+    int _slot;
+    U64 _serial;
 };
 
 
 /**
- * @brief Stores globally to the application any thread-local storage object so that it gets
- * destroyed when all threads are shutdown.
+ * @brief A copy of the TLS of a thread, see AppTLS::takeSnapshot()
  **/
-class AppTLS
-{
-    //This is the object in the QThreadStorage, it is duplicated on every thread
+struct TLSSnapshot;
+typedef boost::shared_ptr<const TLSSnapshot> TLSSnapshotPtr;
 
-    typedef std::set<TLSHolderBaseConstWPtr> TLSObjects;
-    struct GLobalTLSObject
-    {
-        TLSObjects objects;
-    };
-
-    typedef boost::shared_ptr<GLobalTLSObject> GLobalTLSObjectPtr;
-
-    //<spawned thread, spawner thread>
-    typedef std::map<const QThread*, const QThread*> ThreadSpawnMap;
 
+/**
+ * @brief Stores the thread-local data of all the TLSHolder objects.
+ * Each holder gets an index (slot) when it is created, and each thread a vector of slots, which is found through a
+ * native thread-local pointer: reading or writing the data of the current thread does not take any shared lock.
+ * The slots of all threads are also registered by thread, so that the data of a spawner thread can be copied to the
+ * threads it spawned and the data of a holder is released in all threads when the holder is destroyed.
+ **/
+class AppTLS
+{
 public:
 
     AppTLS();
@@ -112,19 +103,14 @@ public:
     virtual ~AppTLS();
 
     /**
-     * @brief Registers the holder as using TLS.
-     **/
-    void registerTLSHolder(const TLSHolderBaseConstPtr& holder);
-
-
-    /**
-     * @brief Copy all the TLS from fromThread to toThread
+     * @brief Copy all the TLS from fromThread to toThread.
+     * If toThread is not the current thread, the copy is done when toThread first accesses its TLS, as with softCopy().
      **/
     void copyTLS(QThread* fromThread, QThread* toThread);
 
     /**
      * @brief This function registers fromThread as a thread who spawned toThread.
-     * The first time attempting to call getOrCreateTLSData() for toThread, it will
+     * The first time attempting to call getTLSData() or getOrCreateTLSData() for toThread, it will
      * call copyTLS() first before returning the TLS value.
      * This is to ensure that threads that "may" need TLS do not always copy the TLS
      * if it is not needed.
@@ -135,59 +121,55 @@ public:
     void softCopy(QThread* fromThread, QThread* toThread);
 
     /**
-     * @brief Same as copyTLS() except that if a spawner thread was register for curThread beforehand
-     * with softCopy() then the TLS will be copied from the spawner thread.
-     * This function also returns the TLS for the given holder for convenience.
+     * @brief Returns a copy of the TLS of the current thread. It is never modified, so that the threads that work on
+     * behalf of the current thread may copy it with copyTLS() or softCopy() while the current thread keeps modifying
+     * its own TLS, e.g when it runs tasks of a TaskScheduler::parallelFor() too.
      **/
-    template <typename T>
-    boost::shared_ptr<T> copyTLSFromSpawnerThread(const TLSHolderBase* holder,
-                                                  const QThread* curThread);
+    TLSSnapshotPtr takeSnapshot();
 
+    /**
+     * @brief Same as copyTLS(fromThread, toThread), but the TLS is copied from snapshot, taken by fromThread.
+     **/
+    void copyTLS(const TLSSnapshotPtr& snapshot, QThread* fromThread, QThread* toThread);
+
+    /**
+     * @brief Same as softCopy(fromThread, toThread), but the TLS is copied from snapshot, taken by fromThread.
+     **/
+    void softCopy(const TLSSnapshotPtr& snapshot, QThread* fromThread, QThread* toThread);
 
     /**
      * @brief Should be called by any thread using TLS when done to cleanup its TLS
      **/
     void cleanupTLSForThread();
 
-private:
+    /**
+     * @brief Returns the data of the holder for the current thread, or NULL. If a spawner thread was registered for the
+     * current thread with softCopy(), the TLS of the spawner thread is copied first.
+     **/
+    static boost::shared_ptr<void> getTLSValue(const TLSHolderBase* holder);
 
-    template <typename T>
-    boost::shared_ptr<T> copyTLSFromSpawnerThreadInternal(const TLSHolderBase* holder,
-                                                          const QThread* curThread,
-                                                          const QThread* spawnerThread);
+    /**
+     * @brief Sets the data of the holder for the current thread.
+     **/
+    static void setTLSValue(const TLSHolderBase* holder, const boost::shared_ptr<void>& value);
 
+private:
 
-    //This is the "TLS" object: it stores a set of all TLSHolder's who used the TLS to clean it up afterwards
-    mutable QReadWriteLock _objectMutex;
-    GLobalTLSObjectPtr _object;
+    friend class TLSHolderBase;
 
-    //if a thread is a spawned thread, then copy the tls from the spawner thread instead
-    //of creating a new object and no longer mark it as spawned
-    mutable QReadWriteLock _spawnsMutex;
-    ThreadSpawnMap _spawns;
+    static void allocateSlot(TLSHolderBase* holder);
+    static void releaseSlot(const TLSHolderBase* holder);
 };
 
 
 /**
  * @brief Use this class if you need to hold TLS data on an object.
  * @param T is the data type held in the thread-local storage.
- * @param multipleInstance If true, then the TLS object will be mapped against this object
- * so that there can be multiple instance of it in the global TLS. Otherwise only
- * a single instance of the TLS object will be present.
  **/
 template <typename T>
 class TLSHolder
     : public TLSHolderBase
 {
-    friend class AppTLS;
-
-    struct ThreadData
-    {
-        boost::shared_ptr<T> value;
-    };
-
-    typedef std::map<const QThread*, ThreadData> ThreadDataMap;
-
 public:
 
     TLSHolder()
@@ -200,14 +182,7 @@ public:
 
 private:
 
-    virtual bool canCleanupPerThreadData(const QThread* curThread) const OVERRIDE FINAL WARN_UNUSED_RETURN;
-    virtual bool cleanupPerThreadData(const QThread* curThread) const OVERRIDE FINAL WARN_UNUSED_RETURN;
-    virtual void copyTLS(const QThread* fromThread, const QThread* toThread) const OVERRIDE FINAL;
-    boost::shared_ptr<T> copyAndReturnNewTLS(const QThread* fromThread, const QThread* toThread) const WARN_UNUSED_RETURN;
-
-    //Store a cache on the object to be faster than using the getOrCreate... function from AppTLS
-    mutable QReadWriteLock perThreadDataMutex;
-    mutable ThreadDataMap perThreadData;
+    virtual boost::shared_ptr<void> copyTLSValue(const boost::shared_ptr<void>& value) const OVERRIDE FINAL WARN_UNUSED_RETURN;
 };
 
 NATRON_NAMESPACE_EXIT
@@ -0,0 +1,448 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/NUMATopology.h"
+#include "Engine/RenderTrace.h"
+#include "Engine/ThreadPool.h"
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// A parallel loop: the indices are taken in order by the thread that started it and by the workers that steal it
+struct TaskGroup
+{
+    const TaskScheduler::TaskFunction* func;
+    int count;
+
+    // The next index to run
+    QAtomicInt next;
+
+    // The number of calls that did not return yet
+    QAtomicInt remaining;
+
+    // Protects the fields below
+    QMutex mutex;
+    QWaitCondition finishedCond;
+    bool finished;
+    bool failed;
+    std::string error;
+
+    TaskGroup(const TaskScheduler::TaskFunction* func,
+              int count)
+        : func(func)
+        , count(count)
+        , next(0)
+        , remaining(count)
+        , mutex()
+        , finishedCond()
+        , finished(false)
+        , failed(false)
+        , error()
+    {
+    }
+
+    bool isExhausted() const
+    {
+        return (int)next >= count;
+    }
+
+    bool takeIndex(int* index)
+    {
+        if ( isExhausted() ) {
+            return false;
+        }
+        *index = next.fetchAndAddRelaxed(1);
+
+        return *index < count;
+    }
+
+    void run(int index)
+    {
+        try {
+            (*func)(index);
+        } catch (const std::exception& e) {
+            QMutexLocker k(&mutex);
+            if (!failed) {
+                failed = true;
+                error = e.what();
+            }
+        } catch (...) {
+            QMutexLocker k(&mutex);
+            if (!failed) {
+                failed = true;
+                error = "Unknown exception in a parallel task";
+            }
+        }
+        if (remaining.fetchAndAddOrdered(-1) == 1) {
+            QMutexLocker k(&mutex);
+            finished = true;
+            finishedCond.wakeAll();
+        }
+    }
+};
+
+typedef boost::shared_ptr<TaskGroup> TaskGroupPtr;
+
+// The loops started by a thread that still have indices to run
+struct TaskDeque
+{
+    QMutex mutex;
+    std::deque<TaskGroupPtr> groups;
+
+    // The NUMA node of the threads that push to this deque
+    int node;
+
+    TaskDeque(int node)
+        : mutex()
+        , groups()
+        , node(node)
+    {
+    }
+};
+
+class TaskWorker
+    : public QThread
+      , public AbortableThread
+{
+public:
+
+    TaskWorker(TaskSchedulerPrivate* scheduler,
+               int index,
+               int node)
+        : QThread()
+        , AbortableThread(this)
+        , scheduler(scheduler)
+        , index(index)
+        , node(node)
+    {
+        setThreadName("Task Scheduler Worker");
+    }
+
+    virtual ~TaskWorker() {}
+
+    TaskSchedulerPrivate* const scheduler;
+
+    // The index of the deque of this worker
+    const int index;
+
+    // The NUMA node this worker is bound to when NUMA-aware rendering is enabled
+    const int node;
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+struct TaskSchedulerPrivate
+{
+    // The number of workers requested, 0 to follow the global thread pool
+    const int requestedWorkers;
+
+    // Protects the creation of the workers
+    QMutex workersMutex;
+    std::vector<TaskWorker*> workers;
+
+    // deques[i] belongs to workers[i]. The vector never grows, so that it can be read without locking up to nDeques.
+    std::vector<TaskDeque*> deques;
+    QAtomicInt nDeques;
+
+    // The deques shared by the threads that are not workers, one per NUMA node. Only the first one is used when
+    // NUMA-aware rendering is disabled.
+    std::vector<TaskDeque*> sharedDeques;
+
+    // The number of groups in the deques, which may be exhausted, in total and per NUMA node
+    QAtomicInt nQueuedGroups;
+    QAtomicInt nNodeQueuedGroups[NATRON_NUMA_MAX_NODES];
+
+    // The idle workers wait for work on this condition
+    QMutex idleMutex;
+    QWaitCondition workAvailable;
+    bool quit;
+
+    TaskSchedulerPrivate(int nWorkers)
+        : requestedWorkers( std::min(nWorkers, NATRON_TASK_SCHEDULER_MAX_WORKERS) )
+        , workersMutex()
+        , workers()
+        , deques(NATRON_TASK_SCHEDULER_MAX_WORKERS)
+        , nDeques(0)
+        , sharedDeques(NATRON_NUMA_MAX_NODES)
+        , nQueuedGroups(0)
+        , idleMutex()
+        , workAvailable()
+        , quit(false)
+    {
+        for (std::size_t i = 0; i < deques.size(); ++i) {
+            deques[i] = new TaskDeque(0);
+        }
+        for (std::size_t i = 0; i < sharedDeques.size(); ++i) {
+            sharedDeques[i] = new TaskDeque(i);
+        }
+    }
+
+    ~TaskSchedulerPrivate()
+    {
+        for (std::size_t i = 0; i < deques.size(); ++i) {
+            delete deques[i];
+        }
+        for (std::size_t i = 0; i < sharedDeques.size(); ++i) {
+            delete sharedDeques[i];
+        }
+    }
+
+    void startWorkers()
+    {
+        int nWorkers = requestedWorkers;
+
+        if (nWorkers <= 0) {
+            nWorkers = std::min(QThreadPool::globalInstance()->maxThreadCount() - 1, NATRON_TASK_SCHEDULER_MAX_WORKERS);
+            // at least 1 worker per NUMA node, so that the loops of each node can be stolen
+            nWorkers = std::max(NUMATopology::getNumNodes(), nWorkers);
+        }
+        if ( (int)nDeques >= nWorkers ) {
+            // already started
+            return;
+        }
+        QMutexLocker k(&workersMutex);
+        while ( (int)workers.size() < nWorkers ) {
+            // The workers are bound to the NUMA nodes in turn
+            const int index = (int)workers.size();
+            deques[index]->node = index % NUMATopology::getNumNodes();
+            TaskWorker* worker = new TaskWorker(this, index, deques[index]->node);
+            workers.push_back(worker);
+            nDeques.fetchAndStoreOrdered( (int)workers.size() );
+            worker->start();
+        }
+    }
+
+    void stopWorkers()
+    {
+        {
+            QMutexLocker k(&idleMutex);
+            quit = true;
+            workAvailable.wakeAll();
+        }
+        QMutexLocker k(&workersMutex);
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+            workers[i]->wait();
+            delete workers[i];
+        }
+        workers.clear();
+    }
+
+    /// The deque of the current thread
+    TaskDeque* getCurrentThreadDeque() const
+    {
+        TaskWorker* worker = dynamic_cast<TaskWorker*>( QThread::currentThread() );
+
+        if ( worker && (worker->scheduler == this) ) {
+            return deques[worker->index];
+        }
+
+        return sharedDeques[NUMATopology::isEnabled() ? NUMATopology::getCurrentNode() : 0];
+    }
+
+    void pushGroup(const TaskGroupPtr& group)
+    {
+        TaskDeque* deque = getCurrentThreadDeque();
+
+        // counted before it can be taken, so that the count never goes below 0
+        nQueuedGroups.fetchAndAddOrdered(1);
+        nNodeQueuedGroups[deque->node].fetchAndAddOrdered(1);
+        {
+            QMutexLocker k(&deque->mutex);
+            deque->groups.push_back(group);
+        }
+        QMutexLocker k(&idleMutex);
+        workAvailable.wakeAll();
+    }
+
+    /// Takes an index in the group at the back (own deque) or front (stolen) of the deque, removing the exhausted groups
+    bool takeFromDeque(TaskDeque* deque,
+                       bool back,
+                       TaskGroupPtr* group,
+                       int* index)
+    {
+        QMutexLocker k(&deque->mutex);
+
+        while ( !deque->groups.empty() ) {
+            TaskGroupPtr& candidate = back ? deque->groups.back() : deque->groups.front();
+            if ( candidate->takeIndex(index) ) {
+                *group = candidate;
+
+                return true;
+            }
+            if (back) {
+                deque->groups.pop_back();
+            } else {
+                deque->groups.pop_front();
+            }
+            nQueuedGroups.fetchAndAddOrdered(-1);
+            nNodeQueuedGroups[deque->node].fetchAndAddOrdered(-1);
+        }
+
+        return false;
+    }
+
+    /// With NUMA-aware rendering, a worker only runs the loops of the threads of its node, so that the tiles of a frame
+    /// are rendered next to the memory of its images
+    bool findTask(const TaskWorker* worker,
+                  bool numa,
+                  TaskGroupPtr* group,
+                  int* index)
+    {
+        // the last loop started by this worker first, then the loops started by other threads and finally
+        // the oldest loops of the other workers
+        if ( takeFromDeque(deques[worker->index], true, group, index) ) {
+            return true;
+        }
+        if (numa) {
+            if ( takeFromDeque(sharedDeques[worker->node], false, group, index) ) {
+                return true;
+            }
+        } else {
+            for (std::size_t i = 0; i < sharedDeques.size(); ++i) {
+                if ( ( (int)nNodeQueuedGroups[i] > 0 ) && takeFromDeque(sharedDeques[i], false, group, index) ) {
+                    return true;
+                }
+            }
+        }
+        const int n = (int)nDeques;
+        for (int i = 1; i < n; ++i) {
+            TaskDeque* victim = deques[(worker->index + i) % n];
+            if ( ( !numa || (victim->node == worker->node) ) && takeFromDeque(victim, false, group, index) ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void runWorker(TaskWorker* worker)
+    {
+        for (;;) {
+            const bool numa = NUMATopology::isEnabled();
+            if ( numa && (NUMATopology::getCurrentThreadNode() != worker->node) ) {
+                NUMATopology::bindCurrentThreadToNode(worker->node);
+            } else if ( !numa && (NUMATopology::getCurrentThreadNode() != -1) ) {
+                NUMATopology::unbindCurrentThread();
+            }
+
+            TaskGroupPtr group;
+            int index;
+            if ( findTask(worker, numa, &group, &index) ) {
+                group->run(index);
+                continue;
+            }
+            QMutexLocker k(&idleMutex);
+            if (quit) {
+                return;
+            }
+            if ( (int)(numa ? nNodeQueuedGroups[worker->node] : nQueuedGroups) == 0 ) {
+                workAvailable.wait(&idleMutex);
+            }
+        }
+    }
+};
+
+void
+TaskWorker::run()
+{
+    scheduler->runWorker(this);
+}
+
+TaskScheduler::TaskScheduler(int nWorkers)
+    : _imp( new TaskSchedulerPrivate(nWorkers) )
+{
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    _imp->stopWorkers();
+}
+
+void
+TaskScheduler::parallelFor(int n,
+                           const TaskFunction& func)
+{
+    if (n <= 0) {
+        return;
+    }
+    if (n == 1) {
+        func(0);
+
+        return;
+    }
+
+    _imp->startWorkers();
+
+    TaskGroupPtr group( new TaskGroup(&func, n) );
+    _imp->pushGroup(group);
+
+    // Help with the loop, then wait for the indices that were stolen
+    int index;
+    while ( group->takeIndex(&index) ) {
+        group->run(index);
+    }
+    {
+        RenderTraceScope trace(kRenderTraceCategoryLock, "waitForTasks");
+        QMutexLocker k(&group->mutex);
+        while (!group->finished) {
+            group->finishedCond.wait(&group->mutex);
+        }
+        if (group->failed) {
+            throw std::runtime_error(group->error);
+        }
+    }
+}
+
+int
+TaskScheduler::getNumWorkers() const
+{
+    return (int)_imp->nDeques;
+}
+
+NATRON_NAMESPACE_EXIT
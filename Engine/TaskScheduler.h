@@ -0,0 +1,96 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_TaskScheduler_h
+#define Engine_TaskScheduler_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+// The maximum number of worker threads of a TaskScheduler
+#define NATRON_TASK_SCHEDULER_MAX_WORKERS 256
+
+NATRON_NAMESPACE_ENTER
+
+struct TaskSchedulerPrivate;
+
+/**
+ * @brief A work-stealing scheduler for the parallel loops of the renders: the tiles of host frame threading,
+ * the threads of the OpenFX multi-thread suite and the tracks of the tracker.
+ *
+ * Each worker thread has a deque of task groups: a parallel loop started by a worker is pushed at the back of
+ * its own deque, and idle workers steal from the front of the deques of the others, one index at a time. The loops
+ * started by other threads go to a shared deque.
+ *
+ * The thread that starts a loop does not block a worker while waiting: it runs the indices of the loop that were not
+ * taken by other workers itself, and only waits for the ones that are running. Since a loop can always be completed by
+ * the thread that started it, nested loops (a tile render that renders its inputs with tiles) never deadlock and never
+ * wait behind unrelated work. The waiting thread does not run tasks of other loops, since its thread-local storage
+ * holds the state of the render it is waiting in.
+ *
+ * With NUMA-aware rendering (see NUMATopology), the workers are bound to the NUMA nodes in turn, each node has its own
+ * shared deque, and a worker only runs the loops started by the threads of its node.
+ **/
+class TaskScheduler
+{
+public:
+
+    typedef boost::function<void (int)> TaskFunction;
+
+    /**
+     * @brief If nWorkers is 0, the number of worker threads follows the maximum thread count of the global thread pool
+     * (minus one, for the thread that starts a loop). The worker threads are started on demand.
+     **/
+    explicit TaskScheduler(int nWorkers = 0);
+
+    /**
+     * @brief Stops the worker threads. No loop may be running.
+     **/
+    ~TaskScheduler();
+
+    /**
+     * @brief Calls func(i) for every i in [0, n), in parallel, and returns when all the calls have returned.
+     * If a call throws, the other calls still run, and a std::runtime_error with the message of the exception is thrown.
+     **/
+    void parallelFor(int n, const TaskFunction& func);
+
+    /**
+     * @brief Returns the number of worker threads started so far.
+     **/
+    int getNumWorkers() const;
+
+private:
+
+    boost::scoped_ptr<TaskSchedulerPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // Engine_TaskScheduler_h
@@ -25,6 +25,7 @@
 #include "TrackerContext.h"
 
 #include <set>
+#include <vector>
 #include <sstream> // stringstream
 
 CLANG_DIAG_OFF(deprecated)
@@ -43,6 +44,7 @@ CLANG_DIAG_ON(uninitialized)
 #include "Engine/NodeGroup.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/Project.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/Curve.h"
 #include "Engine/TLSHolder.h"
 #include "Engine/Transform.h"
@@ -1735,6 +1737,11 @@ struct TrackSchedulerPrivate
      * @param time The time at which to track. The reference frame is held in the args and can be different for each track
      */
     static bool trackStepFunctor(int trackIndex, const TrackArgs& args, int time);
+
+    /*
+     * @brief Calls trackStepFunctor and stores its result in results[trackIndex], for TaskScheduler::parallelFor
+     */
+    static void trackStepTask(const TrackArgs* args, int time, std::vector<char>* results, int trackIndex);
 };
 
 TrackScheduler::TrackScheduler(TrackerParamsProvider* paramsProvider,
@@ -1782,6 +1789,15 @@ TrackSchedulerPrivate::trackStepFunctor(int trackIndex,
     return ret;
 }
 
+void
+TrackSchedulerPrivate::trackStepTask(const TrackArgs* args,
+                                     int time,
+                                     std::vector<char>* results,
+                                     int trackIndex)
+{
+    (*results)[trackIndex] = trackStepFunctor(trackIndex, *args, time);
+}
+
 NATRON_NAMESPACE_ANONYMOUS_ENTER
 
 class IsTrackingFlagSetter_RAII
@@ -1853,9 +1869,7 @@ TrackScheduler::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
 
     const std::vector<TrackMarkerAndOptionsPtr>& tracks = args->getTracks();
     const int numTracks = (int)tracks.size();
-    std::vector<int> trackIndexes( tracks.size() );
     for (std::size_t i = 0; i < tracks.size(); ++i) {
-        trackIndexes[i] = i;
         tracks[i]->natronMarker->notifyTrackingStarted();
         // unslave the enabled knob, since it is slaved to the gui but we may modify it
         KnobBoolPtr enabledKnob = tracks[i]->natronMarker->getEnabledKnob();
@@ -1883,16 +1897,17 @@ TrackScheduler::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
 
 
         while (cur != end) {
-            ///Launch parallel thread for each track using the global thread pool
-            QFuture<bool> future = QtConcurrent::mapped( trackIndexes,
-                                                         boost::bind(&TrackSchedulerPrivate::trackStepFunctor,
-                                                                     _1,
-                                                                     *args,
-                                                                     cur) );
-            future.waitForFinished();
+            ///Track each marker in parallel using the task scheduler
+            std::vector<char> results(numTracks, 0);
+            appPTR->getTaskScheduler()->parallelFor( numTracks,
+                                                     boost::bind(&TrackSchedulerPrivate::trackStepTask,
+                                                                 args.get(),
+                                                                 cur,
+                                                                 &results,
+                                                                 _1) );
 
             allTrackFailed = true;
-            for (QFuture<bool>::const_iterator it = future.begin(); it != future.end(); ++it) {
+            for (std::vector<char>::const_iterator it = results.begin(); it != results.end(); ++it) {
                 if ( (*it) ) {
                     allTrackFailed = false;
                     break;
@@ -36,6 +36,7 @@
 #include "Global/Enums.h"
 
 #include "Engine/BufferableObject.h"
+#include "Engine/RamBufferPool.h"
 #include "Engine/RectD.h"
 #include "Engine/RectI.h"
 #include "Engine/TextureRect.h"
@@ -99,7 +100,7 @@ public:
     {
         if (mustFreeRamBuffer) {
             assert(tiles.size() == 1);
-            free(tiles.front().ramBuffer);
+            RamBufferPool::deallocate(tiles.front().ramBuffer, tiles.front().bytesCount);
         }
     }
 
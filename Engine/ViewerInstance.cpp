@@ -30,6 +30,7 @@
 #include <cassert>
 #include <cstring> // for std::memcpy
 #include <cfloat> // DBL_MAX
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -53,6 +54,7 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/AppManager.h"
 #include "Engine/Cache.h"
 #include "Engine/Image.h"
+#include "Engine/ImageConvertSIMD.h"
 #include "Engine/Log.h"
 #include "Engine/Lut.h"
 #include "Engine/MemoryFile.h"
@@ -62,11 +64,13 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/OpenGLViewerI.h"
 #include "Engine/OutputSchedulerThread.h"
 #include "Engine/Project.h"
+#include "Engine/RamBufferPool.h"
 #include "Engine/RenderStats.h"
 #include "Engine/RotoContext.h"
 #include "Engine/RotoPaint.h"
 #include "Engine/RotoStrokeItem.h"
 #include "Engine/Settings.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/TimeLine.h"
 #include "Engine/Timer.h"
 #include "Engine/UpdateViewerParams.h"
@@ -79,6 +83,10 @@ CLANG_DIAG_ON(deprecated)
 
 #define NATRON_TIME_ELASPED_BEFORE_PROGRESS_REPORT 4. //!< do not display the progress report if estimated total time is less than this (in seconds)
 
+// When the auto-contrast range is measured while converting the image to the texture, the rows of the image are read by bands
+// of this size (in bytes), so that a band is still in the CPU cache when it is converted after its range is measured
+#define NATRON_VIEWER_AUTOCONTRAST_BAND_SIZE (256 * 1024)
+
 NATRON_NAMESPACE_ENTER
 
 using std::make_pair;
@@ -98,6 +106,16 @@ struct MinMaxVal {
     {
     }
 
+    void merge(const MinMaxVal& other)
+    {
+        if (other.min < min) {
+            min = other.min;
+        }
+        if (other.max > max) {
+            max = other.max;
+        }
+    }
+
     double min;
     double max;
 };
@@ -113,6 +131,10 @@ static void scaleToTexture32bits(const RectI& roi,
                                  const RenderViewerArgs & args,
                                  const UpdateViewerParams::CachedTile& tile,
                                  float *output);
+static void scaleToTexture16bits(const RectI& roi,
+                                 const RenderViewerArgs & args,
+                                 const UpdateViewerParams::CachedTile& tile,
+                                 unsigned short *output);
 static MinMaxVal findAutoContrastVminVmax(const ImagePtr inputImage,
                                                          DisplayChannelsEnum channels,
                                                          const RectI & rect);
@@ -121,6 +143,24 @@ static void renderFunctor(const RectI& roi,
                           ViewerInstance* viewer,
                           UpdateViewerParams::CachedTile tile);
 
+/**
+ * @brief Same as renderFunctor, but also returns the auto-contrast range of roi, which is measured band by band
+ * just before converting each band, so that the image is read from memory only once.
+ * Only for the RoI render mode (see RenderViewerArgs::renderOnlyRoI), which is always used with auto-contrast.
+ **/
+static MinMaxVal renderFunctorWithAutoContrastRange(const RectI& roi,
+                                                    const RenderViewerArgs & args,
+                                                    ViewerInstance* viewer,
+                                                    UpdateViewerParams::CachedTile tile);
+
+/// Calls renderFunctorWithAutoContrastRange on (*bands)[index] and stores the range in (*results)[index], for TaskScheduler::parallelFor
+static void renderBandWithAutoContrastRange(const std::vector<RectI>* bands,
+                                            const RenderViewerArgs* args,
+                                            ViewerInstance* viewer,
+                                            const UpdateViewerParams::CachedTile* tile,
+                                            std::vector<MinMaxVal>* results,
+                                            int index);
+
 /**
  *@brief Actually converting to ARGB... but it is called BGRA by
    the texture format GL_UNSIGNED_INT_8_8_8_8_REV
@@ -534,7 +574,7 @@ ViewerInstance::getViewerArgsAndRenderViewer(SequenceTime time,
 
 
         if (args[i]) {
-            status[i] = getRenderViewerArgsAndCheckCache( time, false, view, i, viewerHash, rotoPaintNode, abortInfo, stats,  args[i].get() );
+            status[i] = getRenderViewerArgsAndCheckCache( time, false, false, view, i, viewerHash, rotoPaintNode, abortInfo, stats,  args[i].get() );
         }
 
 
@@ -608,6 +648,70 @@ ViewerInstance::getViewerArgsAndRenderViewer(SequenceTime time,
     return eViewerRenderRetCodeRender;
 } // ViewerInstance::getViewerArgsAndRenderViewer
 
+ViewerInstance::ViewerRenderRetCode
+ViewerInstance::prefetchFrame(SequenceTime time,
+                              ViewIdx view,
+                              U64 viewerHash,
+                              const AbortableRenderInfoPtr& abortInfo)
+{
+    if (!_imp->uiContext) {
+        return eViewerRenderRetCodeFail;
+    }
+
+    ViewerRenderRetCode ret = eViewerRenderRetCodeRedraw;
+    for (int i = 0; i < 2; ++i) {
+        if ( abortInfo->isAborted() ) {
+            return eViewerRenderRetCodeRedraw;
+        }
+        if ( (i == 1) && (_imp->uiContext->getCompositingOperator() == eViewerCompositingOperatorNone) ) {
+            break;
+        }
+
+        // This is rendered like a frame of a playback: the render ages of the viewer are left untouched so that the
+        // interactive renders do not see this render
+        ViewerArgs args;
+        ViewerRenderRetCode stat = getRenderViewerArgsAndCheckCache(time, true, false, view, i, viewerHash, NodePtr(), abortInfo, RenderStatsPtr(), &args);
+        if ( (stat != eViewerRenderRetCodeRender) || !args.params ) {
+            continue;
+        }
+        if (args.forceRender) {
+            // The refresh button was pressed: leave the forced render to the next render of the current frame
+            QMutexLocker forceRenderLocker(&_imp->forceRenderMutex);
+            _imp->forceRender[i] = true;
+
+            return eViewerRenderRetCodeRedraw;
+        }
+        if (args.autoContrast || args.userRoIEnabled || args.isDoingPartialUpdates) {
+            // The textures would not be cached
+            return eViewerRenderRetCodeRedraw;
+        }
+        if ( !args.mustComputeRoDAndLookupCache && (args.params->nbCachedTile == (int)args.params->tiles.size()) ) {
+            // Already cached
+            continue;
+        }
+
+        stat = renderViewer_internal(view,
+                                     false, // singleThreaded
+                                     true, // isSequentialRender
+                                     viewerHash,
+                                     true, // canAbort
+                                     NodePtr(),
+                                     true, // useTLS
+                                     ViewerCurrentFrameRequestSchedulerStartArgsPtr(),
+                                     RenderStatsPtr(),
+                                     args);
+        args.isRenderingFlag.reset();
+        if (stat == eViewerRenderRetCodeFail) {
+            return stat;
+        }
+        if (stat == eViewerRenderRetCodeRender) {
+            ret = stat;
+        }
+    }
+
+    return ret;
+} // ViewerInstance::prefetchFrame
+
 ViewerInstance::ViewerRenderRetCode
 ViewerInstance::renderViewer(ViewIdx view,
                              bool singleThreaded,
@@ -781,8 +885,7 @@ copyAndSwap(const TextureRect& srcRect,
         return false;
     }
 
-    // Use calloc so that newly allocated areas are already black and transparent
-    unsigned char* tmpBuf = (unsigned char*)calloc(dstBytesCount, 1);
+    unsigned char* tmpBuf = (unsigned char*)RamBufferPool::allocate(dstBytesCount);
 
     if (!tmpBuf) {
         *dstBuf = 0;
@@ -790,6 +893,9 @@ copyAndSwap(const TextureRect& srcRect,
         return true;
     }
 
+    // Clear the buffer so that newly allocated areas are black and transparent
+    std::memset(tmpBuf, 0, dstBytesCount);
+
     std::size_t pixelDepth = getSizeOfForBitDepth(bitdepth);
     unsigned char* dstPixels = getTexPixel(srcRect.x1, srcRect.y1, dstRect, pixelDepth, tmpBuf);
     assert(dstPixels);
@@ -811,6 +917,7 @@ copyAndSwap(const TextureRect& srcRect,
 ViewerInstance::ViewerRenderRetCode
 ViewerInstance::getRenderViewerArgsAndCheckCache_public(SequenceTime time,
                                                         bool isSequential,
+                                                        bool isProgressiveCoarsePass,
                                                         ViewIdx view,
                                                         int textureIndex,
                                                         U64 viewerHash,
@@ -820,7 +927,7 @@ ViewerInstance::getRenderViewerArgsAndCheckCache_public(SequenceTime time,
                                                         ViewerArgs* outArgs)
 {
     AbortableRenderInfoPtr abortInfo = _imp->createNewRenderRequest(textureIndex, canAbort);
-    ViewerRenderRetCode stat = getRenderViewerArgsAndCheckCache(time, isSequential, view, textureIndex, viewerHash, rotoPaintNode, abortInfo, stats, outArgs);
+    ViewerRenderRetCode stat = getRenderViewerArgsAndCheckCache(time, isSequential, isProgressiveCoarsePass, view, textureIndex, viewerHash, rotoPaintNode, abortInfo, stats, outArgs);
 
     if ( (stat == eViewerRenderRetCodeFail) || (stat == eViewerRenderRetCodeBlack) ) {
         _imp->checkAndUpdateDisplayAge( textureIndex, abortInfo->getRenderAge() );
@@ -835,6 +942,7 @@ ViewerInstance::setupMinimalUpdateViewerParams(const SequenceTime time,
                                                const int textureIndex,
                                                const AbortableRenderInfoPtr& abortInfo,
                                                const bool isSequential,
+                                               const bool isProgressiveCoarsePass,
                                                ViewerArgs* outArgs)
 {
     assert(_imp->uiContext);
@@ -867,10 +975,11 @@ ViewerInstance::setupMinimalUpdateViewerParams(const SequenceTime time,
     }
     outArgs->mipMapLevelWithDraft = outArgs->mipmapLevelWithoutDraft;
 
-    outArgs->draftModeEnabled = getApp()->isDraftRenderEnabled();
+    // The coarse pass of a progressive render is a draft render at the auto-proxy level, even if auto-proxy is disabled
+    outArgs->draftModeEnabled = isProgressiveCoarsePass || getApp()->isDraftRenderEnabled();
 
     // If draft mode is enabled, compute the mipmap level according to the auto-proxy setting in the preferences
-    if ( outArgs->draftModeEnabled && appPTR->getCurrentSettings()->isAutoProxyEnabled() ) {
+    if ( outArgs->draftModeEnabled && ( isProgressiveCoarsePass || appPTR->getCurrentSettings()->isAutoProxyEnabled() ) ) {
         unsigned int autoProxyLevel = appPTR->getCurrentSettings()->getAutoProxyMipMapLevel();
         if (zoomFactor > 1) {
             //Decrease draft mode at each inverse mipmaplevel level taken
@@ -1015,9 +1124,7 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
                     tile.rect.par = outArgs->params->pixelAspectRatio;
                     tile.bytesCount = tile.rect.area() * 4;
                     assert(tile.bytesCount > 0);
-                    if (outArgs->params->depth == eImageBitDepthFloat) {
-                        tile.bytesCount *= sizeof(float);
-                    }
+                    tile.bytesCount *= getSizeOfForBitDepth(outArgs->params->depth);
                     outArgs->params->tiles.push_back(tile);
                 }
             }
@@ -1029,9 +1136,7 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
                 tile.rect.par = outArgs->params->pixelAspectRatio;
                 tile.bytesCount = tile.rect.area() * 4;
                 assert(tile.bytesCount > 0);
-                if (outArgs->params->depth == eImageBitDepthFloat) {
-                    tile.bytesCount *= sizeof(float);
-                }
+                tile.bytesCount *= getSizeOfForBitDepth(outArgs->params->depth);
                 outArgs->params->tiles.push_back(tile);
             }
         }
@@ -1051,11 +1156,9 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
             tile.rect.par = outArgs->params->pixelAspectRatio;
             tile.bytesCount = outArgs->params->tileSize * outArgs->params->tileSize * 4; // RGBA
             assert( outArgs->params->roi.contains(tile.rect) );
-            // If we are using floating point textures, multiply by size of float
+            // If we are using floating point textures, multiply by size of float (or half float)
             assert(tile.bytesCount > 0);
-            if (outArgs->params->depth == eImageBitDepthFloat) {
-                tile.bytesCount *= sizeof(float);
-            }
+            tile.bytesCount *= getSizeOfForBitDepth(outArgs->params->depth);
             outArgs->params->tiles.push_back(tile);
         }
     }
@@ -1091,7 +1194,7 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
                          inputToRenderName,
                          outArgs->params->layer,
                          outArgs->params->alphaLayer.getPlaneID() + outArgs->params->alphaChannelName,
-                         outArgs->params->depth == eImageBitDepthFloat,
+                         outArgs->params->depth != eImageBitDepthByte,
                          isDraftMode);
             std::list<FrameEntryPtr> entries;
             bool hasTextureCached = appPTR->getTexture(key, &entries);
@@ -1243,6 +1346,7 @@ ViewerInstance::getRoDAndLookupCache(const bool useOnlyRoDCache,
 ViewerInstance::ViewerRenderRetCode
 ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time,
                                                  bool isSequential,
+                                                 bool isProgressiveCoarsePass,
                                                  ViewIdx view,
                                                  int textureIndex,
                                                  U64 viewerHash,
@@ -1290,7 +1394,7 @@ ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time,
     }
 
     // Fetch the render parameters from the Viewer UI
-    setupMinimalUpdateViewerParams(time, view, textureIndex, abortInfo, isSequential, outArgs);
+    setupMinimalUpdateViewerParams(time, view, textureIndex, abortInfo, isSequential, isProgressiveCoarsePass, outArgs);
 
     // Try to look-up the cache but do so only if we have a RoD valid in the cache because
 
@@ -1645,13 +1749,10 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
             UpdateViewerParams::CachedTile tile;
             tile.rect.set(viewerRenderRoI);
             tile.rectRounded = viewerRenderRoI;
-            std::size_t pixelSize = 4;
-            if (updateParams->depth == eImageBitDepthFloat) {
-                pixelSize *= sizeof(float);
-            }
+            std::size_t pixelSize = 4 * getSizeOfForBitDepth(updateParams->depth);
             std::size_t dstRowSize = tile.rect.width() * pixelSize;
             tile.bytesCount = tile.rect.height() * dstRowSize;
-            tile.ramBuffer =  (unsigned char*)malloc(tile.bytesCount);
+            tile.ramBuffer =  (unsigned char*)RamBufferPool::allocate(tile.bytesCount);
             updateParams->tiles.clear();
             updateParams->tiles.push_back(tile);
         }
@@ -1690,7 +1791,7 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                 if (!canUseOldTex) {
                     //The old texture did not exist or was not usable, just make a new buffer
                     updateParams->mustFreeRamBuffer = true;
-                    tile.ramBuffer =  (unsigned char*)malloc(tile.bytesCount);
+                    tile.ramBuffer =  (unsigned char*)RamBufferPool::allocate(tile.bytesCount);
                     unCachedTiles.push_back(tile);
                 } else {
                     //Overwrite the RoI to only the last portion rendered
@@ -1747,7 +1848,7 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                 assert(updateParams->tiles.size() == 1);
 
                 updateParams->mustFreeRamBuffer = true;
-                tile.ramBuffer =  (unsigned char*)malloc(tile.bytesCount);
+                tile.ramBuffer =  (unsigned char*)RamBufferPool::allocate(tile.bytesCount);
                 unCachedTiles.push_back(tile);
             }
         } else { // useTextureCache
@@ -1792,7 +1893,7 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                                  inputToRenderName,
                                  inArgs.params->layer,
                                  inArgs.params->alphaLayer.getPlaneID() + inArgs.params->alphaChannelName,
-                                 inArgs.params->depth == eImageBitDepthFloat,
+                                 inArgs.params->depth != eImageBitDepthByte,
                                  inArgs.draftModeEnabled);
 
 
@@ -1854,16 +1955,34 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
 
         std::size_t tileRowElements = inArgs.params->tileSize;
         // Internally the buffer is interpreted as U32 when 8bit, so we do not multiply it by 4 for RGBA
-        if (updateParams->depth == eImageBitDepthFloat) {
+        if (updateParams->depth != eImageBitDepthByte) {
             tileRowElements *= 4;
         }
 
+        /*
+           During playback and scrubbing, the auto-contrast may use the range of the previous frame displayed in this texture
+           instead of reading the whole image once to find its range before converting it: the range of this frame is then
+           measured while converting it (see renderFunctorWithAutoContrastRange) and is used by the next frame.
+           Other renders (e.g a still frame) use their own range, which is also remembered for the next frame.
+         */
+        const bool measureAutoContrast = inArgs.autoContrast && !inArgs.isDoingPartialUpdates;
+        MinMaxVal previousAutoContrastRange;
+        const bool autoContrastFromPreviousFrame = measureAutoContrast &&
+                                                   (inArgs.params->isSequential || inArgs.draftModeEnabled) &&
+                                                   appPTR->getCurrentSettings()->isAutoContrastFromPreviousFrameEnabled() &&
+                                                   _imp->getAutoContrastRange(inArgs.params->textureIndex, inArgs.channels,
+                                                                              &previousAutoContrastRange.min, &previousAutoContrastRange.max);
+        MinMaxVal measuredAutoContrastRange;
+
         if (singleThreaded) {
-            if (inArgs.autoContrast && !inArgs.isDoingPartialUpdates) {
+            if (measureAutoContrast) {
                 double vmin, vmax;
-                MinMaxVal vMinMax = findAutoContrastVminVmax(colorImage, inArgs.channels, viewerRenderRoI);
+                MinMaxVal vMinMax = autoContrastFromPreviousFrame ? previousAutoContrastRange : findAutoContrastVminVmax(colorImage, inArgs.channels, viewerRenderRoI);
                 vmin = vMinMax.min;
                 vmax = vMinMax.max;
+                if ( !autoContrastFromPreviousFrame && (vmin <= vmax) ) {
+                    _imp->setAutoContrastRange(inArgs.params->textureIndex, inArgs.channels, vmin, vmax);
+                }
 
                 ///if vmax - vmin is greater than 1 the gain will be really small and we won't see
                 ///anything in the image
@@ -1889,10 +2008,17 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                                         tileRowElements);
             QReadLocker k(&_imp->gammaLookupMutex);
             for (std::list<UpdateViewerParams::CachedTile>::iterator it = unCachedTiles.begin(); it != unCachedTiles.end(); ++it) {
-                renderFunctor(viewerRenderRoI,
-                              args,
-                              this,
-                              *it);
+                if (autoContrastFromPreviousFrame) {
+                    measuredAutoContrastRange.merge( renderFunctorWithAutoContrastRange(viewerRenderRoI,
+                                                                                        args,
+                                                                                        this,
+                                                                                        *it) );
+                } else {
+                    renderFunctor(viewerRenderRoI,
+                                  args,
+                                  this,
+                                  *it);
+                }
             }
         } else {
             bool runInCurrentThread = QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount();
@@ -1902,11 +2028,14 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
 
 
             ///if autoContrast is enabled, find out the vmin/vmax before rendering and mapping against new values
-            if (inArgs.autoContrast && !inArgs.isDoingPartialUpdates) {
+            if (measureAutoContrast) {
                 double vmin = std::numeric_limits<double>::infinity();
                 double vmax = -std::numeric_limits<double>::infinity();
 
-                if (runInCurrentThread) {
+                if (autoContrastFromPreviousFrame) {
+                    vmin = previousAutoContrastRange.min;
+                    vmax = previousAutoContrastRange.max;
+                } else if (runInCurrentThread) {
                     MinMaxVal vMinMax = findAutoContrastVminVmax(colorImage, inArgs.channels, viewerRenderRoI);
                     vmin = vMinMax.min;
                     vmax = vMinMax.max;
@@ -1928,6 +2057,9 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                         }
                     }
                 } // runInCurrentThread
+                if ( !autoContrastFromPreviousFrame && (vmin <= vmax) ) {
+                    _imp->setAutoContrastRange(inArgs.params->textureIndex, inArgs.channels, vmin, vmax);
+                }
 
                 if (vmax == vmin) {
                     vmin = vmax - 1.;
@@ -1956,7 +2088,39 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                                         viewerRenderRoiOnly,
                                         tileRowElements);
 
-            if (runInCurrentThread) {
+            if (autoContrastFromPreviousFrame) {
+                // The tiles are converted by horizontal bands run by the task scheduler. Unlike runInCurrentThread, it
+                // knows whether its workers are busy rendering: the bands that are not taken by idle workers are
+                // converted in this thread
+                std::vector<RectI> bands;
+                const int nBands = appPTR->getMaxThreadCount();
+                const int bandHeight = std::max(1, (viewerRenderRoI.height() + nBands - 1) / nBands);
+                for (int y = viewerRenderRoI.y1; y < viewerRenderRoI.y2; y += bandHeight) {
+                    bands.push_back( RectI( viewerRenderRoI.x1, y, viewerRenderRoI.x2, std::min(y + bandHeight, viewerRenderRoI.y2) ) );
+                }
+                QReadLocker k(&_imp->gammaLookupMutex);
+                for (std::list<UpdateViewerParams::CachedTile>::iterator it = unCachedTiles.begin(); it != unCachedTiles.end(); ++it) {
+                    if (bands.size() <= 1) {
+                        for (std::size_t i = 0; i < bands.size(); ++i) {
+                            measuredAutoContrastRange.merge( renderFunctorWithAutoContrastRange(bands[i], args, this, *it) );
+                        }
+                    } else {
+                        std::vector<MinMaxVal> results( bands.size() );
+                        const UpdateViewerParams::CachedTile& tile = *it;
+                        appPTR->getTaskScheduler()->parallelFor( (int)bands.size(),
+                                                                 boost::bind(&renderBandWithAutoContrastRange,
+                                                                             &bands,
+                                                                             &args,
+                                                                             this,
+                                                                             &tile,
+                                                                             &results,
+                                                                             _1) );
+                        for (std::size_t i = 0; i < results.size(); ++i) {
+                            measuredAutoContrastRange.merge(results[i]);
+                        }
+                    }
+                }
+            } else if (runInCurrentThread) {
                 QReadLocker k(&_imp->gammaLookupMutex);
                 for (std::list<UpdateViewerParams::CachedTile>::iterator it = unCachedTiles.begin(); it != unCachedTiles.end(); ++it) {
                     renderFunctor(viewerRenderRoI,
@@ -1977,6 +2141,15 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
             }
         } // if (singleThreaded)
 
+        if ( autoContrastFromPreviousFrame && (measuredAutoContrastRange.min <= measuredAutoContrastRange.max) ) {
+            // Move the range towards the range of this frame: with a convergence lower than 1, the range changes smoothly
+            // over several frames
+            const double convergence = appPTR->getCurrentSettings()->getAutoContrastConvergence();
+            _imp->setAutoContrastRange( inArgs.params->textureIndex, inArgs.channels,
+                                        previousAutoContrastRange.min + convergence * (measuredAutoContrastRange.min - previousAutoContrastRange.min),
+                                        previousAutoContrastRange.max + convergence * (measuredAutoContrastRange.max - previousAutoContrastRange.max) );
+        }
+
 
         if ( colorImage && stats && stats->isInDepthProfilingEnabled() ) {
             stats->addRenderInfosForNode( getNode(), NodePtr(), colorImage->getComponents().getChannelsLabel(), viewerRenderRoI, viewerRenderTimeRecorder->getTimeSinceCreation() );
@@ -2036,12 +2209,48 @@ renderFunctor(const RectI& roi,
     if ( (args.bitDepth == eImageBitDepthFloat) ) {
         // image is stored as linear, the OpenGL shader with do gamma/sRGB/Rec709 decompression, as well as gain and offset
         scaleToTexture32bits(roi, args, tile, (float*)tile.ramBuffer);
+    } else if (args.bitDepth == eImageBitDepthHalf) {
+        // same as float, stored as half floats. They are converted back to floats when uploaded to the OpenGL texture
+        scaleToTexture16bits(roi, args, tile, (unsigned short*)tile.ramBuffer);
     } else {
         // texture is stored as sRGB/Rec709 compressed 8-bit RGBA
         scaleToTexture8bits(roi, args, viewer, tile, (U32*)tile.ramBuffer);
     }
 }
 
+void
+renderBandWithAutoContrastRange(const std::vector<RectI>* bands,
+                                const RenderViewerArgs* args,
+                                ViewerInstance* viewer,
+                                const UpdateViewerParams::CachedTile* tile,
+                                std::vector<MinMaxVal>* results,
+                                int index)
+{
+    (*results)[index] = renderFunctorWithAutoContrastRange( (*bands)[index], *args, viewer, *tile );
+}
+
+MinMaxVal
+renderFunctorWithAutoContrastRange(const RectI& roi,
+                                   const RenderViewerArgs & args,
+                                   ViewerInstance* viewer,
+                                   UpdateViewerParams::CachedTile tile)
+{
+    assert(args.renderOnlyRoI);
+    MinMaxVal ret;
+    if ( roi.isNull() ) {
+        return ret;
+    }
+    const std::size_t rowBytes = (std::size_t)roi.width() * args.inputImage->getComponentsCount() * sizeof(float);
+    const int bandHeight = std::max(1, (int)(NATRON_VIEWER_AUTOCONTRAST_BAND_SIZE / rowBytes));
+    for (int y = roi.y1; y < roi.y2; y += bandHeight) {
+        const RectI band( roi.x1, y, roi.x2, std::min(y + bandHeight, roi.y2) );
+        ret.merge( findAutoContrastVminVmax(args.inputImage, args.channels, band) );
+        renderFunctor(band, args, viewer, tile);
+    }
+
+    return ret;
+}
+
 inline
 MinMaxVal
 findAutoContrastVminVmax_generic(const ImagePtr inputImage,
@@ -2286,9 +2495,9 @@ scaleToTexture8bits_generic(const RectI& roi,
                     break;
                 case sizeof(float):     //float
                     if (args.srcColorSpace) {
-                        r = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(r);
-                        g = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(g);
-                        b = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(b);
+                        r = args.srcColorSpace->fromColorSpaceFloatToLinearFloatFast(r);
+                        g = args.srcColorSpace->fromColorSpaceFloatToLinearFloatFast(g);
+                        b = args.srcColorSpace->fromColorSpaceFloatToLinearFloatFast(b);
                     }
                     break;
                 default:
@@ -2390,6 +2599,215 @@ scaleToTexture8bits_generic(const RectI& roi,
     } // for (int y = yRange.first; y < yRange.second;
 } // scaleToTexture8bits_generic
 
+// The SIMD versions of scaleToTexture8bits and scaleToTexture32bits convert the rows by chunks of this many pixels,
+// so that the intermediate planes stay in the L1 cache
+#define NATRON_VIEWER_SIMD_CHUNK_SIZE 256
+
+/// Converts n values of the input image to linear float, like the generic functions do for each pixel, and returns them.
+/// buffer holds the result if a conversion is needed.
+static const float*
+rowToLinearFloat(const RenderViewerArgs & args,
+                 const unsigned char* from,
+                 float* buffer,
+                 int n)
+{
+    if (args.srcColorSpace) {
+        args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast(from, buffer, n);
+    } else {
+        ImageConvertSIMD::byteToFloat(from, buffer, n);
+    }
+
+    return buffer;
+}
+
+// Without color-space, the generic functions convert the 16-bit values through an unsigned char: those images are
+// not converted with the SIMD kernels
+static const float*
+rowToLinearFloat(const RenderViewerArgs & args,
+                 const unsigned short* from,
+                 float* buffer,
+                 int n)
+{
+    assert(args.srcColorSpace);
+    args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast(from, buffer, n);
+
+    return buffer;
+}
+
+static const float*
+rowToLinearFloat(const RenderViewerArgs & args,
+                 const float* from,
+                 float* buffer,
+                 int n)
+{
+    if (!args.srcColorSpace) {
+        return from;
+    }
+    args.srcColorSpace->fromColorSpaceFloatToLinearFloatFast(from, buffer, n);
+
+    return buffer;
+}
+
+/**
+ * @brief A chunk of a row for the SIMD versions of scaleToTexture8bits and scaleToTexture32bits: r, g and b point
+ * to the channels of the input converted to linear float, and a to the alpha channel of the input, unconverted.
+ **/
+struct ViewerChunkPlanes
+{
+    float linear[NATRON_VIEWER_SIMD_CHUNK_SIZE * 4];
+    float planes[4][NATRON_VIEWER_SIMD_CHUNK_SIZE];
+    float copies[3][NATRON_VIEWER_SIMD_CHUNK_SIZE];
+    float alpha[NATRON_VIEWER_SIMD_CHUNK_SIZE];
+    float* r;
+    float* g;
+    float* b;
+    const float* a;
+
+    template <typename PIX, int nComps, bool opaque, int rOffset, int gOffset, int bOffset>
+    void fill(const RenderViewerArgs & args,
+              const PIX* src_pixels,
+              int n)
+    {
+        assert(n <= NATRON_VIEWER_SIMD_CHUNK_SIZE && nComps <= 4);
+        const float* values = rowToLinearFloat(args, src_pixels, linear, n * nComps);
+        if (nComps == 4) {
+            ImageConvertSIMD::rgbaToPlanes(values, planes[0], planes[1], planes[2], planes[3], n);
+        } else {
+            for (int x = 0; x < n; ++x) {
+                for (int k = 0; k < nComps; ++k) {
+                    planes[k][x] = values[x * nComps + k];
+                }
+            }
+        }
+        // The channels are modified in place by the kernels: when a channel is displayed several times, it is copied
+        const bool distinct = (rOffset != gOffset) && (rOffset != bOffset) && (gOffset != bOffset);
+        if (distinct) {
+            r = planes[rOffset];
+            g = planes[gOffset];
+            b = planes[bOffset];
+        } else {
+            std::copy(planes[rOffset], planes[rOffset] + n, copies[0]);
+            std::copy(planes[gOffset], planes[gOffset] + n, copies[1]);
+            std::copy(planes[bOffset], planes[bOffset] + n, copies[2]);
+            r = copies[0];
+            g = copies[1];
+            b = copies[2];
+        }
+        a = 0;
+        if (!opaque && nComps >= 4) {
+            // Without conversion, the alpha plane holds the input, unless it is also displayed
+            const bool alphaDisplayed = (rOffset == 3) || (gOffset == 3) || (bOffset == 3);
+            if ( ( (const void*)values == (const void*)src_pixels ) && distinct && !alphaDisplayed ) {
+                a = planes[3];
+            } else {
+                for (int x = 0; x < n; ++x) {
+                    alpha[x] = src_pixels[x * nComps + 3];
+                }
+                a = alpha;
+            }
+        }
+    }
+};
+
+/**
+ * @brief Same as scaleToTexture8bits_generic without matte for RGB(A) images, but the rows are converted
+ * with the SIMD kernels of ImageConvertSIMD, including the error diffusion which gives the same bytes.
+ * Returns false if the input image does not cover the tile, in which case the generic function must be used.
+ **/
+template <typename PIX, int nComps, bool opaque, int rOffset, int gOffset, int bOffset>
+bool
+scaleToTexture8bitsSIMD(const RectI& roi,
+                        const RenderViewerArgs & args,
+                        ViewerInstance* viewer,
+                        const UpdateViewerParams::CachedTile& tile,
+                        U32* tileBuffer)
+{
+    Image::ReadAccess acc = Image::ReadAccess( args.inputImage.get() );
+
+    if ( (args.renderOnlyRoI && !tile.rect.contains(roi)) || (!args.renderOnlyRoI && !roi.contains(tile.rect)) ) {
+        return true;
+    }
+    assert(tile.rect.x2 > tile.rect.x1);
+
+    const int y1 = args.renderOnlyRoI ? roi.y1 : tile.rect.y1;
+    const int y2 = args.renderOnlyRoI ? roi.y2 : tile.rect.y2;
+    const int x1 = args.renderOnlyRoI ? roi.x1 : tile.rect.x1;
+    const int x2 = args.renderOnlyRoI ? roi.x2 : tile.rect.x2;
+    const PIX* src_pixels = (const PIX*)acc.pixelAt(x1, y1);
+    if (!src_pixels) {
+        return false;
+    }
+
+    int dstRowElements;
+    U32* dst_pixels;
+    if (args.renderOnlyRoI) {
+        dstRowElements = tile.rect.width();
+        dst_pixels = tileBuffer + (roi.y1 - tile.rect.y1) * dstRowElements + (roi.x1 - tile.rect.x1);
+    } else {
+        dstRowElements = args.tileRowElements;
+        dst_pixels = tileBuffer + (tile.rect.y1 - tile.rectRounded.y1) * args.tileRowElements + (tile.rect.x1 - tile.rectRounded.x1);
+    }
+
+    const int srcRowElements = (int)args.inputImage->getRowElements();
+    const int width = x2 - x1;
+    ImageConvertSIMD::ViewerTransform transform;
+    transform.gain = args.gain;
+    transform.offset = args.offset;
+    transform.gammaZero = args.gamma <= 0;
+    transform.gammaLut = args.gamma != 1. ? viewer->getGammaLut() : 0;
+    transform.gammaLutSize = GAMMA_LUT_NB_VALUES;
+    transform.luminance = (args.channels == eDisplayChannelsY);
+
+    ViewerChunkPlanes planes;
+    // The values of the row in the color-space of the viewer, before the error diffusion, or the bytes without color-space
+    std::vector<unsigned short> uint8xx[3];
+    std::vector<unsigned char> bytes[4];
+    for (int c = 0; c < 3; ++c) {
+        if (args.colorSpace) {
+            uint8xx[c].resize(width);
+        }
+        bytes[c].resize(width);
+    }
+    bytes[3].resize(width, 255);
+
+    for (int y = y1; y < y2;
+         ++y,
+         dst_pixels += dstRowElements,
+         src_pixels += srcRowElements) {
+        for (int x = 0; x < width; x += NATRON_VIEWER_SIMD_CHUNK_SIZE) {
+            const int n = std::min(NATRON_VIEWER_SIMD_CHUNK_SIZE, width - x);
+            planes.fill<PIX, nComps, opaque, rOffset, gOffset, bOffset>(args, src_pixels + x * nComps, n);
+            ImageConvertSIMD::viewerTransform(transform, planes.r, planes.g, planes.b, n);
+            if (args.colorSpace) {
+                args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(planes.r, &uint8xx[0][x], n);
+                args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(planes.g, &uint8xx[1][x], n);
+                args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(planes.b, &uint8xx[2][x], n);
+            } else {
+                ImageConvertSIMD::floatToByte(planes.r, &bytes[0][x], n);
+                ImageConvertSIMD::floatToByte(planes.g, &bytes[1][x], n);
+                ImageConvertSIMD::floatToByte(planes.b, &bytes[2][x], n);
+            }
+            if (planes.a) {
+                ImageConvertSIMD::floatToByte(planes.a, &bytes[3][x], n);
+            }
+        }
+
+        // coverity[dont_call]
+        int start = (int)( rand() % width );
+
+        if (args.colorSpace) {
+            // Same error diffusion as the generic function: forward from start, then backward from start - 1
+            for (int c = 0; c < 3; ++c) {
+                ImageConvertSIMD::diffuseErrorUint8xx(&uint8xx[c][start], &bytes[c][start], width - start, false);
+                ImageConvertSIMD::diffuseErrorUint8xx(&uint8xx[c][0], &bytes[c][0], start, true);
+            }
+        }
+        ImageConvertSIMD::planesToBGRA(&bytes[0][0], &bytes[1][0], &bytes[2][0], &bytes[3][0], dst_pixels, width);
+    }
+
+    return true;
+} // scaleToTexture8bitsSIMD
+
 template <typename PIX, int maxValue, int nComps, bool opaque, bool matteOverlay, int rOffset, int gOffset, int bOffset>
 void
 scaleToTexture8bits_internal(const RectI& roi,
@@ -2398,6 +2816,14 @@ scaleToTexture8bits_internal(const RectI& roi,
                              const UpdateViewerParams::CachedTile& tile,
                              U32* output)
 {
+    // The SIMD version handles the RGB(A) images without matte overlay
+    if ( !matteOverlay && (nComps >= 3) && (rOffset < nComps) && (gOffset < nComps) && (bOffset < nComps) &&
+         ( (sizeof(PIX) != sizeof(unsigned short)) || args.srcColorSpace ) &&
+         (ImageConvertSIMD::getInstructionSet() != ImageConvertSIMD::eInstructionSetScalar) ) {
+        if ( scaleToTexture8bitsSIMD<PIX, nComps, opaque, rOffset, gOffset, bOffset>(roi, args, viewer, tile, output) ) {
+            return;
+        }
+    }
     scaleToTexture8bits_generic<PIX, maxValue, opaque, matteOverlay, rOffset, gOffset, bOffset>(roi, args, nComps, viewer, tile, output);
 }
 
@@ -2555,6 +2981,12 @@ ViewerInstance::interpolateGammaLut(float value)
     return _imp->lookupGammaLut(value);
 }
 
+const float*
+ViewerInstance::getGammaLut() const
+{
+    return &_imp->gammaLookup[0];
+}
+
 void
 ViewerInstance::markAllOnGoingRendersAsAborted(bool keepOldestRender)
 {
@@ -2579,6 +3011,16 @@ ViewerInstance::markAllOnGoingRendersAsAborted(bool keepOldestRender)
     }
 }
 
+bool
+ViewerInstance::hasRenderRequestAfter(int textureIndex,
+                                      U64 age) const
+{
+    QMutexLocker k(&_imp->renderAgeMutex);
+
+    // renderAge is the age of the next render request
+    return _imp->renderAge[textureIndex] > age + 1;
+}
+
 template <typename PIX, int maxValue, bool opaque, bool applyMatte, int rOffset, int gOffset, int bOffset>
 void
 scaleToTexture32bitsGeneric(const RectI& roi,
@@ -2683,9 +3125,9 @@ scaleToTexture32bitsGeneric(const RectI& roi,
                 break;
             case sizeof(float):
                 if (args.srcColorSpace) {
-                    r = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(r);
-                    g = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(g);
-                    b = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(b);
+                    r = args.srcColorSpace->fromColorSpaceFloatToLinearFloatFast(r);
+                    g = args.srcColorSpace->fromColorSpaceFloatToLinearFloatFast(g);
+                    b = args.srcColorSpace->fromColorSpaceFloatToLinearFloatFast(b);
                 }
                 break;
             default:
@@ -2749,6 +3191,70 @@ scaleToTexture32bitsGeneric(const RectI& roi,
     }
 } // scaleToTexture32bitsGeneric
 
+/**
+ * @brief Same as scaleToTexture32bitsGeneric without matte for float RGB(A) images, using the SIMD kernels of ImageConvertSIMD
+ * on each row. Returns false if the input image does not cover the tile, in which case the generic function must be used.
+ **/
+template <typename PIX, int nComps, bool opaque, int rOffset, int gOffset, int bOffset>
+bool
+scaleToTexture32bitsSIMD(const RectI& roi,
+                         const RenderViewerArgs & args,
+                         const UpdateViewerParams::CachedTile& tile,
+                         float *tileBuffer)
+{
+    const bool luminance = (args.channels == eDisplayChannelsY);
+    const int dstRowElements = args.renderOnlyRoI ? tile.rect.width() * 4 : args.tileRowElements;
+    Image::ReadAccess acc = Image::ReadAccess( args.inputImage.get() );
+
+    assert( (args.renderOnlyRoI && roi.x1 >= tile.rect.x1 && roi.x2 <= tile.rect.x2 && roi.y1 >= tile.rect.y1 && roi.y2 <= tile.rect.y2) || (!args.renderOnlyRoI && tile.rect.x1 >= roi.x1 && tile.rect.x2 <= roi.x2 && tile.rect.y1 >= roi.y1 && tile.rect.y2 <= roi.y2) );
+    assert(tile.rect.x2 > tile.rect.x1);
+
+    const int y1 = args.renderOnlyRoI ? roi.y1 : tile.rect.y1;
+    const int y2 = args.renderOnlyRoI ? roi.y2 : tile.rect.y2;
+    const int x1 = args.renderOnlyRoI ? roi.x1 : tile.rect.x1;
+    const int x2 = args.renderOnlyRoI ? roi.x2 : tile.rect.x2;
+    const PIX* src_pixels = (const PIX*)acc.pixelAt(x1, y1);
+    if (!src_pixels) {
+        return false;
+    }
+
+    float* dst_pixels;
+    if (args.renderOnlyRoI) {
+        dst_pixels = tileBuffer + (roi.y1 - tile.rect.y1) * dstRowElements + (roi.x1 - tile.rect.x1) * 4;
+    } else {
+        dst_pixels = tileBuffer + (tile.rect.y1 - tile.rectRounded.y1) * dstRowElements + (tile.rect.x1 - tile.rectRounded.x1) * 4;
+    }
+
+    const int srcRowElements = (int)args.inputImage->getRowElements();
+    const int width = x2 - x1;
+    ViewerChunkPlanes planes;
+
+    for (int y = y1; y < y2;
+         ++y,
+         dst_pixels += dstRowElements,
+         src_pixels += srcRowElements) {
+        for (int x = 0; x < width; x += NATRON_VIEWER_SIMD_CHUNK_SIZE) {
+            const int n = std::min(NATRON_VIEWER_SIMD_CHUNK_SIZE, width - x);
+            planes.fill<PIX, nComps, opaque, rOffset, gOffset, bOffset>(args, src_pixels + x * nComps, n);
+            if (luminance) {
+                ImageConvertSIMD::rgbToLuminance(planes.r, planes.g, planes.b, planes.r, n);
+            }
+            const float* r = planes.r;
+            const float* g = luminance ? planes.r : planes.g;
+            const float* b = luminance ? planes.r : planes.b;
+            float* dst = dst_pixels + x * 4;
+            for (int i = 0; i < n; ++i) {
+                dst[i * 4] = r[i]; // do not clamp! values may be more than 1 or less than 0
+                dst[i * 4 + 1] = g[i];
+                dst[i * 4 + 2] = b[i];
+                dst[i * 4 + 3] = (!opaque && nComps >= 4) ? planes.a[i] : 1.f;
+            }
+        }
+    }
+
+    return true;
+} // scaleToTexture32bitsSIMD
+
 template <typename PIX, int maxValue, int nComps, bool opaque, bool applyMatte, int rOffset, int gOffset, int bOffset>
 void
 scaleToTexture32bitsInternal(const RectI& roi,
@@ -2756,6 +3262,15 @@ scaleToTexture32bitsInternal(const RectI& roi,
                              const UpdateViewerParams::CachedTile& tile,
                              float *output)
 {
+    // The SIMD version handles the float RGB(A) images without matte overlay (the generic function reads the pixels
+    // of the other depths as floats)
+    if ( !applyMatte && (nComps >= 3) && (rOffset < nComps) && (gOffset < nComps) && (bOffset < nComps) &&
+         (sizeof(PIX) == sizeof(float)) &&
+         (ImageConvertSIMD::getInstructionSet() != ImageConvertSIMD::eInstructionSetScalar) ) {
+        if ( scaleToTexture32bitsSIMD<PIX, nComps, opaque, rOffset, gOffset, bOffset>(roi, args, tile, output) ) {
+            return;
+        }
+    }
     scaleToTexture32bitsGeneric<PIX, maxValue, opaque, applyMatte, rOffset, gOffset, bOffset>(roi, args, nComps, tile, output);
 }
 
@@ -2902,6 +3417,45 @@ scaleToTexture32bits(const RectI& roi,
     }
 } // scaleToTexture32bits
 
+void
+scaleToTexture16bits(const RectI& roi,
+                     const RenderViewerArgs & args,
+                     const UpdateViewerParams::CachedTile& tile,
+                     unsigned short *output)
+{
+    if ( (args.renderOnlyRoI && !tile.rect.contains(roi)) || (!args.renderOnlyRoI && !roi.contains(tile.rect)) ) {
+        return;
+    }
+    assert(tile.rect.x2 > tile.rect.x1);
+
+    const int dstRowElements = args.renderOnlyRoI ? tile.rect.width() * 4 : args.tileRowElements;
+    unsigned short* dst_pixels;
+    if (args.renderOnlyRoI) {
+        dst_pixels = output + (roi.y1 - tile.rect.y1) * dstRowElements + (roi.x1 - tile.rect.x1) * 4;
+    } else {
+        dst_pixels = output + (tile.rect.y1 - tile.rectRounded.y1) * dstRowElements + (tile.rect.x1 - tile.rectRounded.x1) * 4;
+    }
+
+    const int y1 = args.renderOnlyRoI ? roi.y1 : tile.rect.y1;
+    const int y2 = args.renderOnlyRoI ? roi.y2 : tile.rect.y2;
+    const int x1 = args.renderOnlyRoI ? roi.x1 : tile.rect.x1;
+    const int x2 = args.renderOnlyRoI ? roi.x2 : tile.rect.x2;
+
+    // Each row is converted to floats by scaleToTexture32bits, as the RoI of a tile of one row, then to half floats
+    RenderViewerArgs rowArgs(args);
+    rowArgs.renderOnlyRoI = true;
+    UpdateViewerParams::CachedTile rowTile(tile);
+    std::vector<float> row( (x2 - x1) * 4 );
+
+    for (int y = y1; y < y2; ++y, dst_pixels += dstRowElements) {
+        const RectI rowRect(x1, y, x2, y + 1);
+        rowTile.rect.set(rowRect);
+        rowTile.rectRounded = rowRect;
+        scaleToTexture32bits(rowRect, rowArgs, rowTile, &row[0]);
+        ImageConvertSIMD::floatToHalf( &row[0], dst_pixels, (int)row.size() );
+    }
+} // scaleToTexture16bits
+
 void
 ViewerInstance::ViewerInstancePrivate::updateViewer(UpdateViewerParamsPtr params)
 {
@@ -3100,6 +3654,10 @@ ViewerInstance::onAutoContrastChanged(bool autoContrast,
             changed = true;
         }
     }
+    if (changed) {
+        // the range of the last frames may be out of date, e.g the image may have changed while auto-contrast was disabled
+        _imp->invalidateAutoContrastRanges();
+    }
     if ( changed && refresh && !getApp()->getProject()->isLoadingProject() ) {
         renderCurrentFrame(true);
     }
@@ -117,6 +117,7 @@ public:
 
     ViewerRenderRetCode getRenderViewerArgsAndCheckCache_public(SequenceTime time,
                                                                 bool isSequential,
+                                                                bool isProgressiveCoarsePass,
                                                                 ViewIdx view,
                                                                 int textureIndex,
                                                                 U64 viewerHash,
@@ -131,6 +132,7 @@ private:
      **/
     ViewerRenderRetCode getRenderViewerArgsAndCheckCache(SequenceTime time,
                                                          bool isSequential,
+                                                         bool isProgressiveCoarsePass,
                                                          ViewIdx view,
                                                          int textureIndex,
                                                          U64 viewerHash,
@@ -148,6 +150,7 @@ private:
                                         const int textureIndex,
                                         const AbortableRenderInfoPtr& abortInfo,
                                         const bool isSequential,
+                                        const bool isProgressiveCoarsePass,
                                         ViewerArgs* outArgs);
 
 
@@ -215,6 +218,17 @@ public:
                                                      ViewerArgsPtr* argsA,
                                                      ViewerArgsPtr* argsB);
 
+    /**
+     * @brief Renders the textures of the frame at the given time in the viewer cache without displaying them,
+     * like a playback render would. Nothing is rendered if the textures are already cached or if the viewer
+     * would not use the cache to display them (auto-contrast, user RoI...).
+     * The render is aborted as soon as setAborted() is called on abortInfo.
+     **/
+    ViewerRenderRetCode prefetchFrame(SequenceTime time,
+                                      ViewIdx view,
+                                      U64 viewerHash,
+                                      const AbortableRenderInfoPtr& abortInfo);
+
     void aboutToUpdateTextures();
 
     void updateViewer(UpdateViewerParamsPtr & frame);
@@ -304,8 +318,18 @@ public:
 
     float interpolateGammaLut(float value);
 
+    /**
+     * @brief The table used by interpolateGammaLut, with GAMMA_LUT_NB_VALUES + 1 entries
+     **/
+    const float* getGammaLut() const;
+
     void markAllOnGoingRendersAsAborted(bool keepOldestRender);
 
+    /**
+     * @brief Returns true if a render of the given texture was requested after the render of the given age.
+     **/
+    bool hasRenderRequestAfter(int textureIndex, U64 age) const;
+
     /**
      * @brief Used to re-render only selected portions of the texture.
      * This requires that the renderviewer_internal() function gets called on a single thread
@@ -146,6 +146,11 @@ public:
         , gammaLookup()
         , lastRenderParamsMutex()
         , lastRenderParams()
+        , autoContrastRangeMutex()
+        , autoContrastRangeValid()
+        , autoContrastRangeChannels()
+        , autoContrastRangeMin()
+        , autoContrastRangeMax()
         , partialUpdateRects()
         , viewportCenter()
         , viewportCenterSet(false)
@@ -160,9 +165,53 @@ public:
             displayAge[i] = 0;
             isViewerPaused[i] = false;
             viewerParamsChannels[i] = eDisplayChannelsRGB;
+            autoContrastRangeValid[i] = false;
+            autoContrastRangeChannels[i] = eDisplayChannelsRGB;
+            autoContrastRangeMin[i] = 0.;
+            autoContrastRangeMax[i] = 0.;
         }
     }
 
+    /**
+     * @brief Returns the auto-contrast range of the last frame rendered in the texture, if it was computed
+     * on the same channels.
+     **/
+    bool getAutoContrastRange(int textureIndex,
+                              DisplayChannelsEnum channels,
+                              double* vmin,
+                              double* vmax) const
+    {
+        QMutexLocker k(&autoContrastRangeMutex);
+
+        if ( !autoContrastRangeValid[textureIndex] || (autoContrastRangeChannels[textureIndex] != channels) ) {
+            return false;
+        }
+        *vmin = autoContrastRangeMin[textureIndex];
+        *vmax = autoContrastRangeMax[textureIndex];
+
+        return true;
+    }
+
+    void setAutoContrastRange(int textureIndex,
+                              DisplayChannelsEnum channels,
+                              double vmin,
+                              double vmax)
+    {
+        QMutexLocker k(&autoContrastRangeMutex);
+
+        autoContrastRangeValid[textureIndex] = true;
+        autoContrastRangeChannels[textureIndex] = channels;
+        autoContrastRangeMin[textureIndex] = vmin;
+        autoContrastRangeMax[textureIndex] = vmax;
+    }
+
+    void invalidateAutoContrastRanges()
+    {
+        QMutexLocker k(&autoContrastRangeMutex);
+
+        autoContrastRangeValid[0] = autoContrastRangeValid[1] = false;
+    }
+
     void redrawViewer()
     {
         Q_EMIT mustRedrawViewer();
@@ -336,7 +385,7 @@ public:
     {
         if (value < 0.) {
             return 0.;
-        } else if (value > 1.) {
+        } else if ( !(value <= 1.) ) { // also NaN, which must not be used as an index
             return 1.;
         } else {
             int i = (int)(value * GAMMA_LUT_NB_VALUES);
@@ -401,6 +450,14 @@ public:
     mutable QMutex lastRenderParamsMutex;
     UpdateViewerParamsPtr lastRenderParams[2];
 
+    // The auto-contrast range of the last frame rendered in each texture: during playback and scrubbing, it may be used
+    // by the next frame so that the image is read only once, see ViewerInstance::renderViewer_internal
+    mutable QMutex autoContrastRangeMutex; //< protects the autoContrastRange members
+    bool autoContrastRangeValid[2];
+    DisplayChannelsEnum autoContrastRangeChannels[2];
+    double autoContrastRangeMin[2];
+    double autoContrastRangeMax[2];
+
     /*
      * @brief If this list is not empty, this is the list of canonical rectangles we should update on the viewer, completely
      * disregarding the RoI. This is protected by viewerParamsMutex
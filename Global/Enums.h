@@ -634,6 +634,13 @@ enum CursorEnum
     eCursorClosedHand
 };
 
+///The replacement policy of the LRU containers of a cache, @see BoostLRUHashTable
+enum CacheReplacementPolicyEnum
+{
+    eCacheReplacementPolicyLRU = 0, ///< the least recently used entry is evicted first
+    eCacheReplacementPolicy2Q ///< new entries go through a probationary FIFO, only re-used entries are protected from one-pass scans
+};
+
 ///Keep this in sync with @openfx-supportext/ofxsMerging.h
 enum MergingFunctionEnum
 {
@@ -601,6 +601,20 @@ CLANG_DIAG_OFF(expansion-to-defined)
 #define NATRON_EXTERN_C_END
 #endif
 
+/* NATRON_THREAD_LOCAL */
+
+// A native thread-local variable: thread_local is C++11, but the compilers have the same storage class as an extension
+// for the plain types
+#if !defined(NATRON_THREAD_LOCAL) && defined(__cplusplus)
+#if __cplusplus >= 201103L
+#define NATRON_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define NATRON_THREAD_LOCAL __declspec(thread)
+#else
+#define NATRON_THREAD_LOCAL __thread
+#endif
+#endif
+
 /* FALLTHROUGH */
 
 #if !defined(FALLTHROUGH) && defined(__cplusplus) && defined(__has_cpp_attribute)
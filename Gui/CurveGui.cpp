@@ -27,6 +27,7 @@
 #include <cmath>
 #include <algorithm> // min, max
 #include <stdexcept>
+#include <vector>
 
 #include <QtCore/QThread>
 #include <QtCore/QObject>
@@ -245,6 +246,16 @@ CurveGui::getInternalCurve() const
     return _internalCurve;
 }
 
+void
+CurveGui::evaluateCurve(const double* x,
+                        double* y,
+                        int n) const
+{
+    for (int i = 0; i < n; ++i) {
+        y[i] = evaluate(false, x[i]);
+    }
+}
+
 static void
 drawLineStrip(const std::vector<float>& vertices,
               const QPointF& btmLeft,
@@ -341,12 +352,17 @@ CurveGui::drawCurve(int curveIndex,
             bool isX1AKey = false;
             KeyFrame x1Key;
             KeyFrameSet::const_iterator lastUpperIt = keyframes.end();
+            // the points which are not keyframes are evaluated all at once once their positions are known
+            std::vector<double> evalX;
+            std::vector<std::size_t> evalVertexIndex;
 
             while ( x1 < (widgetWidth - 1) ) {
                 double x, y;
                 if (!isX1AKey) {
                     x = _curveWidget->toZoomCoordinates(x1, 0).x();
-                    y = evaluate(false, x);
+                    y = 0.;
+                    evalX.push_back(x);
+                    evalVertexIndex.push_back( vertices.size() + 1 );
                 } else {
                     x = x1Key.getTime();
                     y = x1Key.getValue();
@@ -360,9 +376,16 @@ CurveGui::drawCurve(int curveIndex,
             //also add the last point
             {
                 double x = _curveWidget->toZoomCoordinates(x1, 0).x();
-                double y = evaluate(false, x);
+                evalX.push_back(x);
+                evalVertexIndex.push_back( vertices.size() + 1 );
                 vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
+                vertices.push_back( 0.f );
+            }
+
+            std::vector<double> evalY( evalX.size() );
+            evaluateCurve( &evalX[0], &evalY[0], (int)evalX.size() );
+            for (std::size_t i = 0; i < evalX.size(); ++i) {
+                vertices[evalVertexIndex[i]] = (float)evalY[i];
             }
         } catch (...) {
         }
@@ -674,6 +697,17 @@ KnobCurveGui::evaluate(bool useExpr,
     }
 }
 
+void
+KnobCurveGui::evaluateCurve(const double* x,
+                            double* y,
+                            int n) const
+{
+    CurvePtr curve = getInternalCurve();
+
+    assert(curve);
+    curve->getValuesAt(x, y, n, false);
+}
+
 CurvePtr
 KnobCurveGui::getInternalCurve() const
 {
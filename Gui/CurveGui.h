@@ -121,6 +121,11 @@ public:
      * The coordinates are those of the curve, not of the widget.
      **/
     virtual double evaluate(bool useExpr, double x) const = 0;
+
+    /**
+     * @brief Same as evaluate(false, x[i]) for the n positions in x, which are usually increasing.
+     **/
+    virtual void evaluateCurve(const double* x, double* y, int n) const;
     virtual CurvePtr  getInternalCurve() const;
 
     void drawCurve(int curveIndex, int curvesCount);
@@ -200,6 +205,7 @@ public:
     }
 
     virtual double evaluate(bool useExpr, double x) const OVERRIDE FINAL WARN_UNUSED_RETURN;
+    virtual void evaluateCurve(const double* x, double* y, int n) const OVERRIDE FINAL;
     RotoContextPtr getRotoContext() const { return _roto; }
 
     KnobIPtr getInternalKnob() const;
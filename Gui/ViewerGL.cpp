@@ -51,6 +51,7 @@ GCC_DIAG_UNUSED_PRIVATE_FIELD_ON
 #include <QTreeWidget>
 #include <QTabBar>
 
+#include "Engine/ImageConvertSIMD.h"
 #include "Engine/Lut.h"
 #include "Engine/Node.h"
 #include "Engine/NodeGuiI.h"
@@ -1590,9 +1591,11 @@ ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
     if (bd == eImageBitDepthByte) {
         dataType = Texture::eDataTypeByte;
     } else {
-        //do 32bit fp textures either way, don't bother with half float. We might support it further on.
+        //do 32bit fp textures either way: half float textures are converted to floats when copied to the PBO
         dataType = Texture::eDataTypeFloat;
     }
+    const bool halfToFloat = (bd == eImageBitDepthHalf);
+    const size_t pboBytesCount = halfToFloat ? bytesCount / sizeof(unsigned short) * sizeof(float) : bytesCount;
     assert(textureIndex == 0 || textureIndex == 1);
 
     GLTexturePtr tex;
@@ -1640,7 +1643,7 @@ ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
     // If you do that, the previous data in PBO will be discarded and
     // glMapBufferARB() returns a new allocated pointer immediately
     // even if GPU is still working with the previous data.
-    glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, bytesCount, NULL, GL_DYNAMIC_DRAW_ARB);
+    glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, pboBytesCount, NULL, GL_DYNAMIC_DRAW_ARB);
 
     // map the buffer object into client's memory
     GLvoid *ret = glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
@@ -1649,7 +1652,11 @@ ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
     assert(ramBuffer);
     if (ret && ramBuffer) {
         // update data directly on the mapped buffer
-        std::memcpy(ret, (void*)ramBuffer, bytesCount);
+        if (halfToFloat) {
+            ImageConvertSIMD::halfToFloat( (const unsigned short*)ramBuffer, (float*)ret, (int)(bytesCount / sizeof(unsigned short)) );
+        } else {
+            std::memcpy(ret, (void*)ramBuffer, bytesCount);
+        }
         GLboolean result = glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB); // release the mapped buffer
         assert(result == GL_TRUE);
         Q_UNUSED(result);
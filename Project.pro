@@ -36,6 +36,7 @@ SUBDIRS += \
     Renderer \
     Gui \
     Tests \
+    Benchmarks \
     PythonBin \
     App
 
@@ -58,6 +59,7 @@ Engine.depends = libmv openMVG HostSupport libtess ceres
 Renderer.depends = Engine
 Gui.depends = Engine qhttpserver
 Tests.depends = Gui Engine
+Benchmarks.depends = Engine Renderer
 App.depends = Gui Engine
 
 OTHER_FILES += \
@@ -0,0 +1,377 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+
+#include "Engine/CacheSerialization.h"
+#include "Engine/CacheTOCJournal.h"
+#include "Engine/Image.h"
+#include "Engine/ImageKey.h"
+#include "Engine/ViewIdx.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+typedef std::vector<CacheTOCJournal::Record> Records;
+
+const unsigned int kCacheVersion = 1;
+
+/// A journal file of its own for each test, removed when the test ends
+class JournalFile
+{
+    std::string _filePath;
+
+public:
+
+    JournalFile(const char* name)
+        : _filePath()
+    {
+        _filePath = QDir::tempPath().toStdString() + "/NatronTOCJournalTest_" + name + "." NATRON_CACHE_FILE_EXT;
+        QFile::remove( QString::fromUtf8( _filePath.c_str() ) );
+    }
+
+    ~JournalFile()
+    {
+        QFile::remove( QString::fromUtf8( _filePath.c_str() ) );
+    }
+
+    const std::string& path() const
+    {
+        return _filePath;
+    }
+
+    qint64 size() const
+    {
+        return QFile( QString::fromUtf8( _filePath.c_str() ) ).size();
+    }
+};
+
+class FixedPayload
+    : public CacheTOCJournal::PayloadSerializer
+{
+    std::string _payload;
+
+public:
+
+    FixedPayload(const std::string& payload)
+        : CacheTOCJournal::PayloadSerializer()
+        , _payload(payload)
+    {
+    }
+
+    virtual void serialize(std::string* payload) const OVERRIDE FINAL
+    {
+        *payload = _payload;
+    }
+};
+
+/// Copies the live records out of the mapped journal
+class RecordCollector
+    : public CacheTOCJournal::RecordVisitor
+{
+    Records* _records;
+
+public:
+
+    RecordCollector(Records* records)
+        : CacheTOCJournal::RecordVisitor()
+        , _records(records)
+    {
+    }
+
+    virtual void visit(const CacheTOCJournal::RecordView& view) OVERRIDE FINAL
+    {
+        CacheTOCJournal::Record record;
+
+        record.hash = view.hash;
+        record.size = view.size;
+        record.dataOffsetInFile = view.dataOffsetInFile;
+        record.filePath.assign(view.filePath, view.filePathLength);
+        record.payload.assign(view.payload, view.payloadLength);
+        _records->push_back(record);
+    }
+};
+
+CacheTOCJournal::Record
+makeRecord(U64 hash,
+           const char* filePath,
+           U64 dataOffsetInFile)
+{
+    CacheTOCJournal::Record record;
+
+    record.hash = hash;
+    record.size = 1024;
+    record.filePath = filePath;
+    record.dataOffsetInFile = dataOffsetInFile;
+    record.payload = "payload of " + QString::number(hash).toStdString();
+
+    return record;
+}
+
+void
+appendAdd(CacheTOCJournal& journal,
+          const CacheTOCJournal::Record& record)
+{
+    CacheTOCJournal::PayloadSerializerPtr payload( new FixedPayload(record.payload) );
+
+    journal.appendAdd(record, payload);
+}
+
+bool
+readJournal(const JournalFile& file,
+            Records* records,
+            CacheTOCJournal::ReadInfo* info)
+{
+    RecordCollector collector(records);
+
+    records->clear();
+
+    return CacheTOCJournal::readLiveRecords(file.path(), kCacheVersion, &collector, info);
+}
+
+/// The hashes of the records, in order
+std::vector<U64>
+getHashes(const Records& records)
+{
+    std::vector<U64> ret;
+
+    for (Records::const_iterator it = records.begin(); it != records.end(); ++it) {
+        ret.push_back(it->hash);
+    }
+
+    return ret;
+}
+
+std::vector<U64>
+makeHashes(U64 a,
+           U64 b,
+           U64 c = 0)
+{
+    std::vector<U64> ret;
+
+    ret.push_back(a);
+    ret.push_back(b);
+    if (c) {
+        ret.push_back(c);
+    }
+
+    return ret;
+}
+
+/// Writes a journal with the records of hashes 1, 2 and 3 and closes it
+void
+writeThreeRecords(const JournalFile& file)
+{
+    CacheTOCJournal journal;
+
+    ASSERT_TRUE( journal.open( file.path(), kCacheVersion, Records() ) );
+    appendAdd( journal, makeRecord(1, "a", 0) );
+    appendAdd( journal, makeRecord(2, "a", 1) );
+    appendAdd( journal, makeRecord(3, "a", 2) );
+    journal.close();
+}
+
+/// Appends the record of hash 4 to the journal as it was read at launch, then reads it again
+void
+appendAfterCrash(const JournalFile& file,
+                 const CacheTOCJournal::ReadInfo& info,
+                 Records* records)
+{
+    {
+        CacheTOCJournal journal;
+        ASSERT_TRUE( journal.openForAppend(file.path(), kCacheVersion, info) );
+        appendAdd( journal, makeRecord(4, "b", 0) );
+        journal.close();
+    }
+    CacheTOCJournal::ReadInfo newInfo;
+    ASSERT_TRUE( readJournal(file, records, &newInfo) );
+}
+}
+
+TEST(CacheTOCJournal,
+     AddRemoveReplay)
+{
+    JournalFile file("AddRemoveReplay");
+    {
+        CacheTOCJournal journal;
+        Records initial;
+        initial.push_back( makeRecord(1, "a", 0) );
+        ASSERT_TRUE( journal.open(file.path(), kCacheVersion, initial) );
+        appendAdd( journal, makeRecord(2, "a", 1) );
+        appendAdd( journal, makeRecord(3, "b", 0) );
+        journal.appendRemove("a", 1);
+        // The last record for a location wins: 4 replaces 1
+        appendAdd( journal, makeRecord(4, "a", 0) );
+        // Removing a location that was never added is harmless
+        journal.appendRemove("c", 0);
+        // A location can be added again once removed
+        appendAdd( journal, makeRecord(5, "a", 1) );
+        journal.close();
+
+        // Closed: nothing is appended anymore
+        appendAdd( journal, makeRecord(6, "d", 0) );
+    }
+
+    Records records;
+    CacheTOCJournal::ReadInfo info;
+    ASSERT_TRUE( readJournal(file, &records, &info) );
+    EXPECT_EQ( makeHashes(3, 4, 5), getHashes(records) ) << "live records, in the order they were added";
+    ASSERT_EQ( 3u, records.size() );
+    EXPECT_EQ( "b", records[0].filePath );
+    EXPECT_EQ( makeRecord(4, "a", 0).payload, records[1].payload );
+    EXPECT_EQ( 1u, records[2].dataOffsetInFile );
+    EXPECT_EQ( 7u, info.nRecords );
+    EXPECT_EQ( 3u, info.nLiveRecords );
+    EXPECT_EQ( (U64)file.size(), info.validSize );
+
+    // Another version of the cache does not trust this journal
+    RecordCollector collector(&records);
+    EXPECT_FALSE( CacheTOCJournal::readLiveRecords(file.path(), kCacheVersion + 1, &collector, &info) );
+}
+
+TEST(CacheTOCJournal,
+     TruncatedTail)
+{
+    JournalFile file("TruncatedTail");
+
+    writeThreeRecords(file);
+    const qint64 fullSize = file.size();
+
+    // A crash in the middle of the last append
+    ASSERT_TRUE( QFile::resize(QString::fromUtf8( file.path().c_str() ), fullSize - 3) );
+    Records records;
+    CacheTOCJournal::ReadInfo info;
+    ASSERT_TRUE( readJournal(file, &records, &info) );
+    EXPECT_EQ( makeHashes(1, 2), getHashes(records) );
+    EXPECT_EQ( 2u, info.nRecords );
+    EXPECT_LT( (qint64)info.validSize, fullSize - 3 );
+
+    // The torn record is cut before appending, otherwise the new records would be hidden behind it
+    appendAfterCrash(file, info, &records);
+    EXPECT_EQ( makeHashes(1, 2, 4), getHashes(records) );
+}
+
+TEST(CacheTOCJournal,
+     BadChecksum)
+{
+    JournalFile file("BadChecksum");
+
+    writeThreeRecords(file);
+
+    // Corrupt the payload of the second record
+    {
+        QFile f( QString::fromUtf8( file.path().c_str() ) );
+        ASSERT_TRUE( f.open(QIODevice::ReadWrite) );
+        QByteArray content = f.readAll();
+        const std::string payload = makeRecord(2, "a", 1).payload;
+        int pos = content.indexOf( QByteArray( payload.c_str() ) );
+        ASSERT_GE(pos, 0);
+        content[pos] = content[pos] ^ 0x20;
+        ASSERT_TRUE( f.seek(0) );
+        ASSERT_EQ( (qint64)content.size(), f.write(content) );
+    }
+
+    // Reading stops at the invalid record: the records after it cannot be trusted either
+    Records records;
+    CacheTOCJournal::ReadInfo info;
+    ASSERT_TRUE( readJournal(file, &records, &info) );
+    ASSERT_EQ( 1u, records.size() );
+    EXPECT_EQ( 1u, records[0].hash );
+    EXPECT_EQ( 1u, info.nRecords );
+
+    appendAfterCrash(file, info, &records);
+    EXPECT_EQ( makeHashes(1, 4), getHashes(records) );
+}
+
+TEST(CacheTOCJournal,
+     CompactionKeepsLiveRecords)
+{
+    JournalFile file("CompactionKeepsLiveRecords");
+    const int nRecords = NATRON_CACHE_TOC_JOURNAL_COMPACTION_MIN_RECORDS + 100;
+    {
+        CacheTOCJournal journal;
+        ASSERT_TRUE( journal.open( file.path(), kCacheVersion, Records() ) );
+        appendAdd( journal, makeRecord(1, "b", 0) );
+        // The same tile reused over and over: all its records but the last are dead
+        for (int i = 0; i < nRecords; ++i) {
+            appendAdd( journal, makeRecord(100 + i, "a", 0) );
+        }
+        journal.close();
+    }
+
+    Records records;
+    CacheTOCJournal::ReadInfo info;
+    ASSERT_TRUE( readJournal(file, &records, &info) );
+    EXPECT_EQ( makeHashes(1, 100 + nRecords - 1), getHashes(records) );
+    EXPECT_LT( info.nRecords, (U64)nRecords ) << "the journal was compacted by its writer thread";
+}
+
+TEST(CacheTOCJournal,
+     ImagePayloadRoundTrip)
+{
+    JournalFile file("ImagePayloadRoundTrip");
+    const ImageKey key(0, 0x1234567890abcdefULL, true, 12., ViewIdx(1), 2., true, false);
+    const ImageParamsPtr params = Image::makeParams(RectD(-10, -20, 300, 200), RectI(-5, -10, 150, 100), 2., 1, false,
+                                                    ImagePlaneDesc::getRGBComponents(), eImageBitDepthByte,
+                                                    eImagePremultiplicationUnPremultiplied, eImageFieldingOrderLower);
+    {
+        Records initial(2);
+        initial[0].hash = key.getHash();
+        initial[0].filePath = "image";
+        serializeCacheTOCPayload<Image>(key, params, &initial[0].payload);
+        // A payload cut short is skipped instead of being restored with garbage
+        initial[1] = initial[0];
+        initial[1].filePath = "truncated";
+        initial[1].payload.resize(initial[1].payload.size() - 1);
+
+        CacheTOCJournal journal;
+        ASSERT_TRUE( journal.open(file.path(), kCacheVersion, initial) );
+        journal.close();
+    }
+
+    Cache<Image>::CacheTOC tableOfContents;
+    CacheTOCBuilder<Image> builder(&tableOfContents);
+    CacheTOCJournal::ReadInfo info;
+    ASSERT_TRUE( CacheTOCJournal::readLiveRecords(file.path(), kCacheVersion, &builder, &info) );
+    EXPECT_EQ( 2u, info.nLiveRecords );
+    ASSERT_EQ( 1u, tableOfContents.size() );
+
+    const Cache<Image>::SerializedEntry& entry = tableOfContents.front();
+    EXPECT_EQ( "image", entry.filePath );
+    EXPECT_TRUE(entry.key == key);
+    EXPECT_EQ( key.getHash(), entry.key.getHash() );
+    ASSERT_TRUE(entry.params);
+    EXPECT_TRUE(*entry.params == *params);
+    EXPECT_EQ( params->getRoD(), entry.params->getRoD() );
+    EXPECT_EQ( 1u, entry.params->getMipMapLevel() );
+}
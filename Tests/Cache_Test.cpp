@@ -0,0 +1,338 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <list>
+
+#include <gtest/gtest.h>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/bind.hpp>
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/AppManager.h"
+#include "Engine/Cache.h"
+#include "Engine/Image.h"
+#include "Engine/ImageKey.h"
+#include "Engine/TaskScheduler.h"
+#include "Engine/Timer.h"
+#include "Engine/ViewIdx.h"
+
+NATRON_NAMESPACE_USING
+
+// Number of shards of the cache tested
+#define CACHE_TEST_N_SHARDS 8
+
+// Keys looked up and removed by all threads at once
+#define CACHE_TEST_N_SHARED_KEYS 64
+
+// Operations of each thread
+#define CACHE_TEST_N_OPERATIONS 512
+
+// Capacity of the cache tested with the evictor thread, in entries
+#define CACHE_TEST_N_ENTRIES_MAX 100
+
+namespace {
+typedef Cache<Image> ImageCache;
+
+ImageKey
+makeKey(U64 hash)
+{
+    return ImageKey(0, hash, false, 0, ViewIdx(0), 1., false, false);
+}
+
+ImageParamsPtr
+makeParams()
+{
+    const RectI bounds(0, 0, 16, 16);
+    const RectD rod(0, 0, 16, 16);
+
+    return Image::makeParams(rod, bounds, 1., 0, false, ImagePlaneDesc::getRGBAComponents(), eImageBitDepthFloat,
+                             eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+}
+
+/// The keys only used by the thread threadIndex, after the shared keys
+U64
+getPrivateHash(int threadIndex,
+               int i)
+{
+    return CACHE_TEST_N_SHARED_KEYS + (U64)threadIndex * CACHE_TEST_N_OPERATIONS + i;
+}
+
+/**
+ * @brief Creates, looks up and removes entries with private keys, that must behave as if the thread was alone,
+ * interleaved with entries with shared keys, that all the threads create and remove concurrently.
+ * Errors are counted in nErrors rather than reported from the worker threads.
+ **/
+void
+stressCache(const ImageCache* cache,
+            const ImageParamsPtr& params,
+            QAtomicInt* nErrors,
+            int threadIndex)
+{
+    for (int i = 0; i < CACHE_TEST_N_OPERATIONS; ++i) {
+        {
+            ImageKey key = makeKey( getPrivateHash(threadIndex, i) );
+            ImagePtr image;
+            if ( cache->getOrCreate(key, params, NULL, &image) || !image ) {
+                nErrors->fetchAndAddRelaxed(1);
+                continue;
+            }
+            image->allocateMemory();
+            std::list<ImagePtr> found;
+            if ( !cache->get(key, &found) || (found.size() != 1) || (found.front() != image) ) {
+                nErrors->fetchAndAddRelaxed(1);
+            }
+            if (i % 2) {
+                cache->removeEntry(image);
+                found.clear();
+                if ( cache->get(key, &found) ) {
+                    nErrors->fetchAndAddRelaxed(1);
+                }
+            }
+        }
+        {
+            U64 hash = (U64)( (threadIndex * 7919 + i * 31) % CACHE_TEST_N_SHARED_KEYS );
+            ImagePtr image;
+            if ( !cache->getOrCreate(makeKey(hash), params, NULL, &image) ) {
+                if (!image) {
+                    nErrors->fetchAndAddRelaxed(1);
+                    continue;
+                }
+                image->allocateMemory();
+            }
+            if (i % 3 == 0) {
+                cache->removeEntry(hash);
+            }
+        }
+    }
+}
+
+/// Creates the entry of hash in the cache and allocates it unless allocate is false
+ImagePtr
+createEntry(const ImageCache& cache,
+            const ImageParamsPtr& params,
+            U64 hash,
+            bool allocate = true)
+{
+    ImagePtr image;
+
+    cache.getOrCreate(makeKey(hash), params, NULL, &image);
+    if (image && allocate) {
+        image->allocateMemory();
+    }
+
+    return image;
+}
+
+/// Sets the capacity of the cache, all in memory, to nEntries entries and returns the size of an entry
+std::size_t
+setCapacityInEntries(ImageCache& cache,
+                     const ImageParamsPtr& params,
+                     int nEntries)
+{
+    std::size_t entrySize;
+    {
+        ImagePtr probe = createEntry(cache, params, 0);
+        entrySize = probe->size();
+        cache.removeEntry(probe);
+    }
+    cache.waitForDeleterThread();
+    cache.setMaximumCacheSize( (U64)entrySize * nEntries );
+    cache.setMaximumInMemorySize(1.);
+
+    return entrySize;
+}
+
+/// Number of entry creations that had to wait for room in the cache
+U64
+getNbBlockedCreations(const ImageCache& cache)
+{
+    std::vector<U64> evictionBatches, creationBlocked;
+
+    cache.getEvictionLatencyHistograms(&evictionBatches, &creationBlocked);
+    U64 ret = 0;
+    for (std::size_t i = 0; i < creationBlocked.size(); ++i) {
+        ret += creationBlocked[i];
+    }
+
+    return ret;
+}
+
+/// Waits for the memory portion of the cache to go down to size, for at most timeout seconds
+void
+waitForMemoryCacheSize(const ImageCache& cache,
+                       std::size_t size,
+                       double timeout)
+{
+    TimeLapse timer;
+    QMutex mutex;
+    QWaitCondition cond;
+    QMutexLocker k(&mutex);
+
+    while ( cache.getMemoryCacheSize() > size && timer.getTimeSinceCreation() < timeout ) {
+        cond.wait(&mutex, 10);
+    }
+}
+
+/// Sum of the sizes of the entries left in the cache
+std::size_t
+getEntriesSize(const ImageCache& cache,
+               int nThreads)
+{
+    std::size_t ret = 0;
+    U64 nHashes = getPrivateHash(nThreads, 0);
+
+    for (U64 hash = 0; hash < nHashes; ++hash) {
+        std::list<ImagePtr> found;
+        if ( cache.get(makeKey(hash), &found) ) {
+            for (std::list<ImagePtr>::iterator it = found.begin(); it != found.end(); ++it) {
+                ret += (*it)->size();
+            }
+        }
+    }
+
+    return ret;
+}
+}
+
+TEST(ShardedCache,
+     ConcurrentGetInsertRemove)
+{
+    ImageCache cache("ShardedCacheTest", 1, (U64)1 << 30, 1., CACHE_TEST_N_SHARDS);
+
+    ASSERT_EQ( CACHE_TEST_N_SHARDS, cache.getNumShards() );
+
+    const ImageParamsPtr params = makeParams();
+    const int nThreads = std::max( 4, appPTR->getMaxThreadCount() );
+    QAtomicInt nErrors(0);
+    appPTR->getTaskScheduler()->parallelFor( nThreads, boost::bind(&stressCache, &cache, params, &nErrors, _1) );
+    EXPECT_EQ( 0, (int)nErrors );
+
+    // The removed entries are freed by the deleter thread: wait for it before checking the global size
+    cache.waitForDeleterThread();
+
+    // The private entries that were not removed are all there
+    for (int t = 0; t < nThreads; ++t) {
+        for (int i = 0; i < CACHE_TEST_N_OPERATIONS; i += 2) {
+            std::list<ImagePtr> found;
+            EXPECT_TRUE( cache.get(makeKey( getPrivateHash(t, i) ), &found) );
+        }
+    }
+
+    // The size accounted globally under _sizeLock matches the entries left in all shards
+    std::size_t entriesSize = getEntriesSize(cache, nThreads);
+    EXPECT_GT( entriesSize, 0u );
+    EXPECT_EQ( entriesSize, cache.getMemoryCacheSize() );
+
+    cache.clearInMemoryPortion(false);
+    cache.waitForDeleterThread();
+    EXPECT_EQ( 0u, getEntriesSize(cache, nThreads) );
+    EXPECT_EQ( 0u, cache.getMemoryCacheSize() );
+}
+
+TEST(CacheEvictor,
+     EvictionStopsAtLowWatermark)
+{
+    ImageCache cache("CacheEvictorTest", 1, (U64)1 << 30, 1.);
+    const ImageParamsPtr params = makeParams();
+    const std::size_t entrySize = setCapacityInEntries(cache, params, CACHE_TEST_N_ENTRIES_MAX);
+    const int nHigh = (int)(CACHE_TEST_N_ENTRIES_MAX * NATRON_CACHE_HIGH_WATERMARK_PERCENT);
+    const int nLow = (int)(CACHE_TEST_N_ENTRIES_MAX * NATRON_CACHE_LOW_WATERMARK_PERCENT);
+
+    // Up to the high watermark nothing is evicted: the entries are not referenced outside of the cache
+    // and could be, but the evictor thread is only woken up above the high watermark
+    for (int i = 1; i <= nHigh + 1; ++i) {
+        createEntry(cache, params, i);
+    }
+    cache.waitForDeleterThread();
+    EXPECT_EQ( (nHigh + 1) * entrySize, cache.getMemoryCacheSize() );
+
+    // This creation sees the cache above the high watermark and wakes up the evictor thread. It is not allocated
+    // so that the size of the cache does not change while the evictor thread runs.
+    ImagePtr last = createEntry(cache, params, nHigh + 2, false);
+    ASSERT_TRUE(last);
+    waitForMemoryCacheSize(cache, nLow * entrySize, 10.);
+
+    // Stop the evictor thread, then check that it did not evict past the low watermark
+    cache.waitForDeleterThread();
+    EXPECT_EQ( nLow * entrySize, cache.getMemoryCacheSize() );
+    EXPECT_EQ( 0u, getNbBlockedCreations(cache) );
+
+    // The least recently used entries were evicted
+    std::list<ImagePtr> found;
+    EXPECT_FALSE( cache.get(makeKey(1), &found) );
+    EXPECT_TRUE( cache.get(makeKey(nHigh + 1), &found) );
+    EXPECT_TRUE( cache.get(makeKey(nHigh + 2), &found) );
+
+    last.reset();
+    cache.clearInMemoryPortion(false);
+    cache.waitForDeleterThread();
+}
+
+TEST(CacheEvictor,
+     CreationBlocksWhenFull)
+{
+    ImageCache cache("CacheEvictorTest", 1, (U64)1 << 30, 1.);
+    const ImageParamsPtr params = makeParams();
+    const std::size_t entrySize = setCapacityInEntries(cache, params, CACHE_TEST_N_ENTRIES_MAX);
+    std::list<ImagePtr> held;
+
+    // Keep the entries alive so that neither the evictor thread nor the creating thread can evict them.
+    // Between the high watermark and the maximum size, creations wake up the evictor thread and do not wait.
+    for (int i = 1; i <= CACHE_TEST_N_ENTRIES_MAX; ++i) {
+        held.push_back( createEntry(cache, params, i) );
+    }
+    EXPECT_EQ( 0u, getNbBlockedCreations(cache) );
+    EXPECT_EQ( CACHE_TEST_N_ENTRIES_MAX * entrySize, cache.getMemoryCacheSize() );
+
+    // The cache is full: the creating thread evicts itself, which fails since every entry is in use
+    held.push_back( createEntry(cache, params, CACHE_TEST_N_ENTRIES_MAX + 1) );
+    EXPECT_EQ( 1u, getNbBlockedCreations(cache) );
+    EXPECT_EQ( (CACHE_TEST_N_ENTRIES_MAX + 1) * entrySize, cache.getMemoryCacheSize() );
+
+    // Once released, the creating thread evicts until the new entry fits
+    held.clear();
+    ImagePtr last = createEntry(cache, params, CACHE_TEST_N_ENTRIES_MAX + 2);
+    ASSERT_TRUE(last);
+    EXPECT_EQ( 2u, getNbBlockedCreations(cache) );
+    std::list<ImagePtr> found;
+    EXPECT_FALSE( cache.get(makeKey(1), &found) );
+
+    // The evictor thread, woken up by the same creation, brings the cache down to the low watermark
+    const int nLow = (int)(CACHE_TEST_N_ENTRIES_MAX * NATRON_CACHE_LOW_WATERMARK_PERCENT);
+    waitForMemoryCacheSize(cache, nLow * entrySize, 10.);
+    cache.waitForDeleterThread();
+    EXPECT_LE( cache.getMemoryCacheSize(), nLow * entrySize );
+
+    last.reset();
+    cache.clearInMemoryPortion(false);
+    cache.waitForDeleterThread();
+}
@@ -29,6 +29,8 @@
 #include <QtCore/QString>
 #include <QtCore/QDir>
 
+#include <vector>
+
 #include "Engine/Curve.h"
 
 NATRON_NAMESPACE_USING
@@ -124,3 +126,70 @@ TEST(Curve, Basic)
 }
 
 
+
+TEST(Curve, GetValuesAt)
+{
+    Curve c;
+
+    c.setYRange(-5., 25.);
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(0., 10.) ) );
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(1., 20., 0., 0., eKeyframeTypeConstant) ) );
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(3., -10., 0., 0., eKeyframeTypeCatmullRom) ) );
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(4.5, 30., 0., 0., eKeyframeTypeCubic) ) );
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(6., 0., 0., 0., eKeyframeTypeLinear) ) );
+
+    // increasing times, with some of them on the keyframes
+    std::vector<double> times;
+    for (double t = -2.; t <= 8.; t += 0.25) {
+        times.push_back(t);
+    }
+    // going back in time
+    times.push_back(2.);
+    times.push_back(-1.);
+    times.push_back(5.);
+    times.push_back(5.);
+    times.push_back(0.5);
+
+    for (int clamp = 0; clamp < 2; ++clamp) {
+        std::vector<double> values( times.size() );
+        c.getValuesAt( &times[0], &values[0], (int)times.size(), clamp != 0 );
+        for (std::size_t i = 0; i < times.size(); ++i) {
+            EXPECT_EQ( c.getValueAt(times[i], clamp != 0), values[i] );
+        }
+    }
+
+    // the values must follow the modifications of the curve
+    double t = 1.5;
+    double v;
+    c.getValuesAt(&t, &v, 1);
+    EXPECT_EQ(20., v);
+    c.removeKeyFrameWithTime(1.);
+    c.getValuesAt(&t, &v, 1);
+    EXPECT_EQ(c.getValueAt(t), v);
+    EXPECT_NE(20., v);
+    c.setYRange(0., 1.);
+    EXPECT_EQ( 1., c.getValueAt(0.) );
+
+    // periodic curve
+    Curve p;
+    p.setPeriodic(true);
+    p.setXRange(0., 10.);
+    EXPECT_TRUE( p.addKeyFrame( KeyFrame(2., 1.) ) );
+    EXPECT_TRUE( p.addKeyFrame( KeyFrame(5., 4.) ) );
+    EXPECT_TRUE( p.addKeyFrame( KeyFrame(9., 2.) ) );
+    std::vector<double> values( times.size() );
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        times[i] *= 3.;
+    }
+    p.getValuesAt( &times[0], &values[0], (int)times.size() );
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        EXPECT_EQ( p.getValueAt(times[i]), values[i] );
+    }
+
+    // empty curve
+    Curve e;
+    e.getValuesAt( &times[0], &values[0], (int)times.size() );
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        EXPECT_EQ( 0., values[i] );
+    }
+}
@@ -25,8 +25,11 @@
 #include "Global/Macros.h"
 
 #include <cstdlib>
+#include <vector>
 #include <gtest/gtest.h>
 
+#include <QtCore/QString>
+
 #include "Engine/Hash64.h"
 
 NATRON_NAMESPACE_USING
@@ -90,3 +93,53 @@ TEST(Hash64,
     EXPECT_NE(hash1, hash2);
 } // TEST
 
+
+TEST(Hash64,
+     Streaming)
+{
+    // Values mixed as they are appended must not depend on how they are grouped in stripes
+    Hash64 hash1, hash2;
+
+    for (int i = 0; i < 37; ++i) {
+        hash1.append<int>(i);
+    }
+    hash1.computeHash();
+    for (int i = 0; i < 37; ++i) {
+        hash2.append<int>(i);
+        hash2.computeHash();
+    }
+    EXPECT_EQ(hash1, hash2) << "computeHash() must not alter the streaming state";
+
+    // Known value: this is XXH64 with a seed of 0 over the 8 bytes of the value 1 (little endian)
+    Hash64 hash3;
+    hash3.appendU64(1);
+    hash3.computeHash();
+    EXPECT_EQ(0x9f29cb17a2a49995ULL, hash3.value());
+
+    // The byte count is part of the hash, so that concatenations do not collide
+    Hash64 hash4, hash5;
+    Hash64_appendQString( &hash4, QString::fromUtf8("ab") );
+    Hash64_appendQString( &hash4, QString::fromUtf8("c") );
+    Hash64_appendQString( &hash5, QString::fromUtf8("a") );
+    Hash64_appendQString( &hash5, QString::fromUtf8("bc") );
+    hash4.computeHash();
+    hash5.computeHash();
+    EXPECT_NE(hash4, hash5);
+
+    // appendBytes() on a large block must give the same result as appending the same words one by one
+    std::vector<U64> words;
+    for (U64 i = 0; i < 1000; ++i) {
+        words.push_back(i * 0x9E3779B97F4A7C15ULL);
+    }
+    Hash64 hash6, hash7;
+    hash6.append<int>(3);
+    hash6.appendBytes( &words.front(), words.size() * sizeof(U64) );
+    hash7.append<int>(3);
+    hash7.appendU64( words.size() * sizeof(U64) );
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        hash7.appendU64(words[i]);
+    }
+    hash6.computeHash();
+    hash7.computeHash();
+    EXPECT_EQ(hash6, hash7);
+}
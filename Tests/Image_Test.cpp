@@ -24,10 +24,17 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "Engine/Image.h"
+#include "Engine/ImageConvertSIMD.h"
+#include "Engine/Lut.h"
 #include "Engine/ViewIdx.h"
 
 NATRON_NAMESPACE_USING
@@ -159,3 +166,440 @@ TEST(ImageKeyTest, Difference) {
     ASSERT_TRUE(keyHash1 != keyHash2);
 }
 
+
+static std::size_t
+sizeOfBitDepth(ImageBitDepthEnum depth)
+{
+    switch (depth) {
+    case eImageBitDepthByte:
+
+        return sizeof(unsigned char);
+    case eImageBitDepthShort:
+
+        return sizeof(unsigned short);
+    case eImageBitDepthFloat:
+
+        return sizeof(float);
+    default:
+
+        return 0;
+    }
+}
+
+///Fills an image with random values, with some values outside of [0,1] and some null alpha for float images
+static void
+fillRandom(Image* image)
+{
+    const RectI& bounds = image->getBounds();
+    int nElements = bounds.area() * image->getComponentsCount();
+    Image::WriteAccess acc(image);
+    unsigned char* data = acc.pixelAt(bounds.x1, bounds.y1);
+
+    switch ( image->getBitDepth() ) {
+    case eImageBitDepthByte:
+        for (int i = 0; i < nElements; ++i) {
+            // coverity[dont_call]
+            data[i] = (unsigned char)(rand() % 256);
+        }
+        break;
+    case eImageBitDepthShort:
+        for (int i = 0; i < nElements; ++i) {
+            // coverity[dont_call]
+            ( (unsigned short*)data )[i] = (unsigned short)(rand() % 65536);
+        }
+        break;
+    case eImageBitDepthFloat:
+        for (int i = 0; i < nElements; ++i) {
+            // coverity[dont_call]
+            int r = rand() % 16;
+            // coverity[dont_call]
+            float f = (rand() / (float)RAND_MAX) * 1.4f - 0.2f;
+            if (r == 0) {
+                f = 0.f;
+            } else if (r == 1) {
+                f = 1.f;
+            } else if (r == 2) {
+                // coverity[dont_call]
+                f = Color::intToFloat<256>(rand() % 256);
+            }
+            ( (float*)data )[i] = f;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+///Converts srcImg to the given format with the per-pixel code and with each supported instruction set,
+///and checks that the results are the same
+static void
+checkConvertToFormatSIMD(const Image& srcImg,
+                         const ImagePlaneDesc& dstComps,
+                         ImageBitDepthEnum dstDepth,
+                         ViewerColorSpaceEnum srcColorSpace,
+                         ViewerColorSpaceEnum dstColorSpace,
+                         bool requiresUnpremult)
+{
+    const RectI& bounds = srcImg.getBounds();
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    std::vector<unsigned char> expected;
+
+    for (int set = ImageConvertSIMD::eInstructionSetScalar; set <= (int)supported; ++set) {
+        ImageConvertSIMD::setInstructionSet( (ImageConvertSIMD::InstructionSetEnum)set );
+        Image dstImg(dstComps, srcImg.getRoD(), bounds, 0, 1., dstDepth, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+        // The error diffusion to bytes starts at a random position on each line
+        srand(2000);
+        srcImg.convertToFormat(bounds, srcColorSpace, dstColorSpace, -1, false, requiresUnpremult, &dstImg);
+
+        std::size_t nBytes = bounds.area() * dstComps.getNumComponents() * sizeOfBitDepth(dstDepth);
+        Image::WriteAccess acc(&dstImg);
+        const unsigned char* data = acc.pixelAt(bounds.x1, bounds.y1);
+        if (set == ImageConvertSIMD::eInstructionSetScalar) {
+            expected.assign(data, data + nBytes);
+        } else {
+            EXPECT_TRUE(std::memcmp(&expected[0], data, nBytes) == 0) << "instruction set " << set << ", "
+                                                                     << srcImg.getComponentsCount() << " components of depth " << (int)srcImg.getBitDepth() << " to "
+                                                                     << dstComps.getNumComponents() << " components of depth " << (int)dstDepth
+                                                                     << ", color-spaces " << (int)srcColorSpace << " to " << (int)dstColorSpace
+                                                                     << ", unpremult " << requiresUnpremult;
+        }
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
+
+TEST(ImageConvertTest, SIMDIsBitExact) {
+    const ImageBitDepthEnum depths[3] = {
+        eImageBitDepthByte, eImageBitDepthShort, eImageBitDepthFloat
+    };
+    const ViewerColorSpaceEnum colorSpaces[3] = {
+        eViewerColorSpaceLinear, eViewerColorSpaceSRGB, eViewerColorSpaceRec709
+    };
+    // An odd width to exercise the end of the rows
+    RectI bounds(0, 0, 37, 5);
+    RectD rod(0, 0, 37, 5);
+
+    srand(2000);
+    for (int s = 0; s < 3; ++s) {
+        for (int c = 0; c < 2; ++c) {
+            const ImagePlaneDesc& srcComps = c == 0 ? ImagePlaneDesc::getRGBComponents() : ImagePlaneDesc::getRGBAComponents();
+            Image srcImg(srcComps, rod, bounds, 0, 1., depths[s], eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+            fillRandom(&srcImg);
+            for (int d = 0; d < 3; ++d) {
+                for (int i = 0; i < 3; ++i) {
+                    for (int o = 0; o < 3; ++o) {
+                        // Same components
+                        checkConvertToFormatSIMD(srcImg, srcComps, depths[d], colorSpaces[i], colorSpaces[o], false);
+                        // RGB <-> RGBA
+                        if (c == 0) {
+                            checkConvertToFormatSIMD(srcImg, ImagePlaneDesc::getRGBAComponents(), depths[d], colorSpaces[i], colorSpaces[o], false);
+                        } else {
+                            checkConvertToFormatSIMD(srcImg, ImagePlaneDesc::getRGBComponents(), depths[d], colorSpaces[i], colorSpaces[o], false);
+                            checkConvertToFormatSIMD(srcImg, ImagePlaneDesc::getRGBComponents(), depths[d], colorSpaces[i], colorSpaces[o], true);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+#define VIEWER_TEST_GAMMA_LUT_SIZE 1023
+
+///Same as ViewerInstancePrivate::lookupGammaLut
+static float
+lookupViewerGammaLut(const std::vector<float>& lut,
+                     float value)
+{
+    if (value < 0.) {
+        return 0.;
+    } else if ( !(value <= 1.) ) {
+        return 1.;
+    }
+    int i = (int)(value * VIEWER_TEST_GAMMA_LUT_SIZE);
+    float alpha = std::max( 0.f, std::min(value * VIEWER_TEST_GAMMA_LUT_SIZE - i, 1.f) );
+    float a = lut[i];
+    float b = (i < VIEWER_TEST_GAMMA_LUT_SIZE) ? lut[i + 1] : 0.f;
+
+    return a * (1.f - alpha) + b * alpha;
+}
+
+///Applies the gain, gamma and luminance to a pixel like scaleToTexture8bits_generic
+static void
+viewerTransformPixel(const ImageConvertSIMD::ViewerTransform& t,
+                     const std::vector<float>& lut,
+                     double* rgb)
+{
+    for (int c = 0; c < 3; ++c) {
+        rgb[c] = rgb[c] * t.gain + t.offset;
+        if (t.gammaZero) {
+            rgb[c] = (rgb[c] < 1.) ? 0. : (rgb[c] == 1. ? 1. : std::numeric_limits<double>::infinity() );
+        } else if (t.gammaLut) {
+            rgb[c] = lookupViewerGammaLut(lut, rgb[c]);
+        }
+    }
+    if (t.luminance) {
+        rgb[0] = rgb[1] = rgb[2] = 0.299 * rgb[0] + 0.587 * rgb[1] + 0.114 * rgb[2];
+    }
+}
+
+TEST(ImageConvertTest, ViewerTransformSIMDIsBitExact) {
+    // Same table as ViewerInstancePrivate::fillGammaLut for a gamma of 2.2
+    std::vector<float> lut(VIEWER_TEST_GAMMA_LUT_SIZE + 1);
+    for (int i = 0; i <= VIEWER_TEST_GAMMA_LUT_SIZE; ++i) {
+        lut[i] = (float)std::max( 0., std::min( 1., std::pow(double(i) / VIEWER_TEST_GAMMA_LUT_SIZE, 1. / 2.2) ) );
+    }
+    // 3 planes with an odd number of values, including the entries of the table, -0, infinity and NaN
+    const int n = 1037;
+    std::vector<float> from(3 * n);
+    srand(2000);
+    for (int i = 0; i < 3 * n; ++i) {
+        // coverity[dont_call]
+        from[i] = (rand() / (float)RAND_MAX) * 1.4f - 0.2f;
+    }
+    for (int i = 0; i <= 64; ++i) {
+        from[i] = i / (float)VIEWER_TEST_GAMMA_LUT_SIZE;
+    }
+    from[100] = -0.f;
+    from[101] = 1.f;
+    from[102] = std::numeric_limits<float>::infinity();
+    from[103] = -std::numeric_limits<float>::infinity();
+    from[104] = std::numeric_limits<float>::quiet_NaN();
+
+    const double gains[2] = { 1., 1.7 };
+    const double offsets[2] = { 0., 0.05 };
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    for (int g = 0; g < 2; ++g) {
+        for (int gamma = 0; gamma < 3; ++gamma) {
+            for (int l = 0; l < 2; ++l) {
+                ImageConvertSIMD::ViewerTransform t;
+                t.gain = gains[g];
+                t.offset = offsets[g];
+                t.gammaZero = gamma == 0;
+                t.gammaLut = gamma == 2 ? &lut[0] : 0;
+                t.gammaLutSize = VIEWER_TEST_GAMMA_LUT_SIZE;
+                t.luminance = l == 1;
+
+                std::vector<float> expected(3 * n);
+                for (int i = 0; i < n; ++i) {
+                    double rgb[3] = { from[i], from[n + i], from[2 * n + i] };
+                    viewerTransformPixel(t, lut, rgb);
+                    for (int c = 0; c < 3; ++c) {
+                        expected[c * n + i] = (float)rgb[c];
+                    }
+                }
+                for (int set = ImageConvertSIMD::eInstructionSetScalar; set <= (int)supported; ++set) {
+                    ImageConvertSIMD::setInstructionSet( (ImageConvertSIMD::InstructionSetEnum)set );
+                    std::vector<float> to(from);
+                    ImageConvertSIMD::viewerTransform(t, &to[0], &to[n], &to[2 * n], n);
+                    EXPECT_TRUE(std::memcmp( &expected[0], &to[0], 3 * n * sizeof(float) ) == 0) << "instruction set " << set
+                                                                                                << ", gain " << t.gain << ", gamma " << gamma << ", luminance " << t.luminance;
+                }
+            }
+        }
+    }
+
+    std::vector<float> expectedLuminance(n);
+    for (int i = 0; i < n; ++i) {
+        expectedLuminance[i] = (float)(0.299 * (double)from[i] + 0.587 * (double)from[n + i] + 0.114 * (double)from[2 * n + i]);
+    }
+    for (int set = ImageConvertSIMD::eInstructionSetScalar; set <= (int)supported; ++set) {
+        ImageConvertSIMD::setInstructionSet( (ImageConvertSIMD::InstructionSetEnum)set );
+        std::vector<float> luminance(n);
+        ImageConvertSIMD::rgbToLuminance(&from[0], &from[n], &from[2 * n], &luminance[0], n);
+        EXPECT_TRUE(std::memcmp( &expectedLuminance[0], &luminance[0], n * sizeof(float) ) == 0) << "instruction set " << set;
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
+
+TEST(ImageConvertTest, ViewerTextureSIMDIsBitExact) {
+    // Values of the uint8xx range with an odd count, including the largest ones, which make the error overflow
+    // its 16 bits in the per-pixel code
+    const int n = 1037;
+    std::vector<unsigned short> uint8xx(n);
+    std::vector<unsigned char> planes[4];
+    std::vector<float> rgba(4 * n);
+    srand(2001);
+    for (int i = 0; i < n; ++i) {
+        // coverity[dont_call]
+        uint8xx[i] = (unsigned short)(rand() % 0x10000);
+    }
+    for (int i = 0; i < 16; ++i) {
+        uint8xx[i] = i % 2 ? 0xffff : 0xff00;
+    }
+    for (int c = 0; c < 4; ++c) {
+        planes[c].resize(n);
+        for (int i = 0; i < n; ++i) {
+            // coverity[dont_call]
+            planes[c][i] = (unsigned char)(rand() % 256);
+        }
+    }
+    for (int i = 0; i < 4 * n; ++i) {
+        rgba[i] = (float)i;
+    }
+
+    // Same error diffusion as scaleToTexture8bits_generic, forward and backward
+    std::vector<unsigned char> expectedBytes[2];
+    for (int backward = 0; backward < 2; ++backward) {
+        expectedBytes[backward].resize(n);
+        unsigned error = 0x80;
+        for (int k = 0; k < n; ++k) {
+            const int i = backward ? n - 1 - k : k;
+            error = (error & 0xff) + uint8xx[i];
+            expectedBytes[backward][i] = (unsigned char)(error >> 8);
+        }
+    }
+    std::vector<unsigned int> expectedBGRA(n);
+    for (int i = 0; i < n; ++i) {
+        expectedBGRA[i] = (planes[3][i] << 24) | (planes[0][i] << 16) | (planes[1][i] << 8) | planes[2][i];
+    }
+
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    for (int set = ImageConvertSIMD::eInstructionSetScalar; set <= (int)supported; ++set) {
+        ImageConvertSIMD::setInstructionSet( (ImageConvertSIMD::InstructionSetEnum)set );
+        for (int backward = 0; backward < 2; ++backward) {
+            std::vector<unsigned char> bytes(n);
+            ImageConvertSIMD::diffuseErrorUint8xx(&uint8xx[0], &bytes[0], n, backward);
+            EXPECT_TRUE(bytes == expectedBytes[backward]) << "instruction set " << set << ", backward " << backward;
+        }
+        std::vector<unsigned int> bgra(n);
+        ImageConvertSIMD::planesToBGRA(&planes[0][0], &planes[1][0], &planes[2][0], &planes[3][0], &bgra[0], n);
+        EXPECT_TRUE(bgra == expectedBGRA) << "instruction set " << set;
+
+        std::vector<float> split(4 * n);
+        ImageConvertSIMD::rgbaToPlanes(&rgba[0], &split[0], &split[n], &split[2 * n], &split[3 * n], n);
+        for (int i = 0; i < n; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                ASSERT_EQ(rgba[4 * i + c], split[c * n + i]) << "instruction set " << set;
+            }
+        }
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
+
+TEST(ImageConvertTest, HalfFloatSIMDIsBitExact) {
+    // All the half floats, with an odd count to exercise the end of the rows
+    const int nHalves = 0x10000;
+    std::vector<unsigned short> halves(nHalves);
+    for (int i = 0; i < nHalves; ++i) {
+        halves[i] = (unsigned short)i;
+    }
+    // Random floats around the range of the half floats, and values at the limits of the rounding
+    const int n = 4097;
+    std::vector<float> floats(n);
+    srand(2002);
+    for (int i = 0; i < n; ++i) {
+        // coverity[dont_call]
+        floats[i] = (float)( (rand() - RAND_MAX / 2) * std::ldexp(1., rand() % 48 - 40) );
+    }
+    const float limits[12] = {
+        0.f, -0.f, 1.f, 65504.f, 65519.f, 65520.f, (float)std::ldexp(1., -24), (float)std::ldexp(1., -25),
+        (float)std::ldexp(3., -25), (float)std::ldexp(1., -14), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN()
+    };
+    const unsigned short expectedLimits[12] = {
+        0x0000, 0x8000, 0x3c00, 0x7bff, 0x7bff, 0x7c00, 0x0001, 0x0000, 0x0002, 0x0400, 0x7c00, 0x7e00
+    };
+    std::copy(limits, limits + 12, floats.begin());
+
+    std::vector<float> expectedFloats;
+    std::vector<unsigned short> expectedHalves;
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    for (int set = ImageConvertSIMD::eInstructionSetScalar; set <= (int)supported; ++set) {
+        ImageConvertSIMD::setInstructionSet( (ImageConvertSIMD::InstructionSetEnum)set );
+        std::vector<float> toFloats(nHalves - 1);
+        ImageConvertSIMD::halfToFloat(&halves[0], &toFloats[0], nHalves - 1);
+        std::vector<unsigned short> toHalves(n);
+        ImageConvertSIMD::floatToHalf(&floats[0], &toHalves[0], n);
+        for (int i = 0; i < 12; ++i) {
+            EXPECT_EQ(expectedLimits[i], toHalves[i]) << "instruction set " << set << ", value " << limits[i];
+        }
+        if (set == ImageConvertSIMD::eInstructionSetScalar) {
+            expectedFloats = toFloats;
+            expectedHalves = toHalves;
+            // The conversion to float is exact: converting back gives the same half, except for the NaNs
+            std::vector<unsigned short> roundTrip(nHalves - 1);
+            ImageConvertSIMD::floatToHalf(&toFloats[0], &roundTrip[0], nHalves - 1);
+            for (int i = 0; i < nHalves - 1; ++i) {
+                if ( (i & 0x7fff) <= 0x7c00 ) {
+                    ASSERT_EQ(halves[i], roundTrip[i]);
+                }
+            }
+        } else {
+            EXPECT_TRUE(std::memcmp( &expectedFloats[0], &toFloats[0], toFloats.size() * sizeof(float) ) == 0) << "instruction set " << set;
+            EXPECT_TRUE(expectedHalves == toHalves) << "instruction set " << set;
+        }
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
+
+///Downscales srcImg from level 0 to the given level and checks that the result is the same as halving it
+///level by level with the same arithmetic, with each supported instruction set
+template <typename PIX>
+static void
+checkDownscaleMipMap(const Image& srcImg,
+                     unsigned int level)
+{
+    const RectI& bounds = srcImg.getBounds();
+    const int nComps = srcImg.getComponentsCount();
+
+    // The bounds are aligned to the level, every destination pixel is the average of 4 source pixels
+    ASSERT_TRUE(bounds.x1 % (1 << level) == 0 && bounds.x2 % (1 << level) == 0 &&
+                bounds.y1 % (1 << level) == 0 && bounds.y2 % (1 << level) == 0);
+    std::vector<PIX> expected;
+    {
+        Image::ReadAccess acc(&srcImg);
+        const PIX* data = (const PIX*)acc.pixelAt(bounds.x1, bounds.y1);
+        expected.assign(data, data + bounds.area() * nComps);
+    }
+    int width = bounds.width();
+    int height = bounds.height();
+    for (unsigned int i = 0; i < level; ++i) {
+        std::vector<PIX> halved( (width / 2) * (height / 2) * nComps );
+        for (int y = 0; y < height / 2; ++y) {
+            for (int x = 0; x < width / 2; ++x) {
+                for (int k = 0; k < nComps; ++k) {
+                    const PIX a = expected[( (2 * y) * width + 2 * x ) * nComps + k];
+                    const PIX b = expected[( (2 * y) * width + 2 * x + 1 ) * nComps + k];
+                    const PIX c = expected[( (2 * y + 1) * width + 2 * x ) * nComps + k];
+                    const PIX d = expected[( (2 * y + 1) * width + 2 * x + 1 ) * nComps + k];
+                    halved[(y * (width / 2) + x) * nComps + k] = (a + b + c + d) / 4;
+                }
+            }
+        }
+        expected.swap(halved);
+        width /= 2;
+        height /= 2;
+    }
+
+    const RectI dstBounds = bounds.downscalePowerOfTwoSmallestEnclosing(level);
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    for (int set = ImageConvertSIMD::eInstructionSetScalar; set <= (int)supported; ++set) {
+        ImageConvertSIMD::setInstructionSet( (ImageConvertSIMD::InstructionSetEnum)set );
+        Image dstImg(srcImg.getComponents(), srcImg.getRoD(), dstBounds, level, 1., srcImg.getBitDepth(), eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+        srcImg.downscaleMipMap(srcImg.getRoD(), bounds, 0, level, false, &dstImg);
+
+        Image::ReadAccess acc(&dstImg);
+        const PIX* data = (const PIX*)acc.pixelAt(dstBounds.x1, dstBounds.y1);
+        EXPECT_TRUE(std::memcmp( &expected[0], data, expected.size() * sizeof(PIX) ) == 0) << "instruction set " << set << ", "
+                                                                                       << nComps << " components of depth " << (int)srcImg.getBitDepth()
+                                                                                       << ", level " << level;
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
+
+TEST(ImageMipMapTest, DownscaleMatchesHalving) {
+    RectI bounds(-16, 8, 80, 56);
+    RectD rod(-16, 8, 80, 56);
+
+    srand(2000);
+    for (int c = 0; c < 2; ++c) {
+        const ImagePlaneDesc& comps = c == 0 ? ImagePlaneDesc::getAlphaComponents() : ImagePlaneDesc::getRGBAComponents();
+        Image floatImg(comps, rod, bounds, 0, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+        fillRandom(&floatImg);
+        Image byteImg(comps, rod, bounds, 0, 1., eImageBitDepthByte, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+        fillRandom(&byteImg);
+        for (unsigned int level = 1; level <= 3; ++level) {
+            checkDownscaleMipMap<float>(floatImg, level);
+            checkDownscaleMipMap<unsigned char>(byteImg, level);
+        }
+    }
+}
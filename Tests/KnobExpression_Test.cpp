@@ -0,0 +1,114 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "BaseTest.h"
+
+#include "Engine/AppManager.h"
+#include "Engine/KnobExpression.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/Node.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+/// Evaluates the expression of the knob over a range of frames, natively and with Python, and checks that the results are identical.
+/// isNative tells whether the expression is in the subset compiled by KnobExpression.
+void
+checkExpression(KnobDouble* knob,
+                const std::string& expression,
+                bool isNative = true)
+{
+    {
+        PythonGILLocker pgl;
+        KnobExpressionPtr native = KnobExpression::compile(knob, 0, expression);
+        EXPECT_EQ( isNative, (bool)native ) << expression;
+    }
+    knob->setExpression(0, expression, false, true);
+    std::vector<double> nativeValues, pythonValues;
+    for (int native = 1; native >= 0; --native) {
+        KnobExpression::setEnabled(native != 0);
+        knob->clearExpressionsResults(0);
+        std::vector<double>& values = native ? nativeValues : pythonValues;
+        for (int i = -20; i <= 20; ++i) {
+            // integral and fractional frames
+            values.push_back( knob->getValueAtTime(i) );
+            values.push_back( knob->getValueAtTime(i + 0.25) );
+        }
+    }
+    KnobExpression::setEnabled(true);
+    knob->clearExpression(0, true);
+    ASSERT_EQ( nativeValues.size(), pythonValues.size() );
+    for (std::size_t i = 0; i < nativeValues.size(); ++i) {
+        EXPECT_EQ(nativeValues[i], pythonValues[i]) << expression << " at index " << i;
+    }
+}
+}
+
+TEST_F(BaseTest, NativeExpressions)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr other = createNode(_generatorPluginID);
+
+    ASSERT_TRUE(generator && other);
+    KnobDouble* knob = dynamic_cast<KnobDouble*>( generator->getKnobByName("noiseZSlope").get() );
+    KnobDouble* otherKnob = dynamic_cast<KnobDouble*>( other->getKnobByName("noiseZSlope").get() );
+    ASSERT_TRUE(knob && otherKnob);
+    otherKnob->setValue(0.5);
+    otherKnob->setValueAtTime(0, 0., ViewSpec::all(), 0);
+    otherKnob->setValueAtTime(10, 3., ViewSpec::all(), 0);
+
+    const std::string otherParam = other->getScriptName_mt_safe() + ".noiseZSlope";
+    const char* const expressions[] = {
+        "frame * 2 + sin(frame)",
+        "frame / 3",
+        "frame // 3 + frame % 3",
+        "-frame ** 2",
+        "2 ** frame",
+        "abs(frame - 5) + min(frame, 3) - max(frame, 1)",
+        "int(frame * 1.7) + round(frame / 4)",
+        "frame if frame > 2 else -frame",
+        "frame > 2 and 5 or 7",
+        "sqrt(frame) if frame >= 0 else 0",
+        "1 / (frame - 3) if frame != 3 else 0",
+        "ExprUtils.mix(1, 5, frame / 10.)",
+        "pi * e + dimension",
+        "curve(frame) * 2",
+    };
+    for (std::size_t i = 0; i < sizeof(expressions) / sizeof(expressions[0]); ++i) {
+        checkExpression(knob, expressions[i]);
+    }
+    checkExpression(knob, otherParam + ".get() / 3");
+    checkExpression(knob, otherParam + ".getValueAtTime(frame + 1) * frame");
+    checkExpression(knob, otherParam + ".curve(frame)");
+    // not in the native subset
+    checkExpression(knob, "[frame, 1][0] * 2", false);
+}
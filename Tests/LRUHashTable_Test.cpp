@@ -0,0 +1,212 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Engine/LRUHashTable.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+typedef BoostLRUHashTable<int, boost::shared_ptr<int> > Table;
+
+void
+insertRange(Table & table,
+            int first,
+            int last)
+{
+    for (int i = first; i < last; ++i) {
+        table.insert( i, boost::shared_ptr<int>( new int(i) ) );
+    }
+}
+
+/// Look-ups counting as hits, as done by Cache::get()
+void
+lookUp(Table & table,
+       int key,
+       int times)
+{
+    for (int i = 0; i < times; ++i) {
+        ASSERT_TRUE( table(key) != table.end() );
+    }
+}
+
+/// Evicts every record and returns the keys in eviction order
+std::vector<int>
+evictAll(Table & table)
+{
+    std::vector<int> ret;
+
+    while (table.size() > 0) {
+        ret.push_back(table.evict().first);
+    }
+
+    return ret;
+}
+}
+
+TEST(LRUHashTable,
+     LookUpPromotesProbationaryRecord)
+{
+    Table table;
+
+    table.setReplacementPolicy(eCacheReplacementPolicy2Q);
+    insertRange(table, 0, 8);
+
+    // 0 is looked-up enough to be protected, 1 is only looked-up once
+    lookUp(table, 0, NATRON_CACHE_2Q_PROMOTION_HITS);
+    lookUp(table, 1, NATRON_CACHE_2Q_PROMOTION_HITS - 1);
+
+    std::vector<int> order = evictAll(table);
+    ASSERT_EQ(8u, order.size());
+    EXPECT_EQ(1, order[0]) << "Probationary records are evicted oldest first, whatever their hits below the promotion threshold";
+    EXPECT_EQ(0, order[7]) << "The promoted record is evicted last";
+}
+
+TEST(LRUHashTable,
+     FindDoesNotCountAsHit)
+{
+    Table table;
+
+    table.setReplacementPolicy(eCacheReplacementPolicy2Q);
+    insertRange(table, 0, 8);
+
+    // Internal bookkeeping of the cache: existence checks and appending values to a record
+    for (int i = 0; i < NATRON_CACHE_2Q_PROMOTION_HITS * 2; ++i) {
+        ASSERT_TRUE( table.find(0) != table.end() );
+        table.insert( 0, boost::shared_ptr<int>( new int(0) ) );
+    }
+    EXPECT_TRUE( table.find(100) == table.end() );
+
+    std::vector<int> order = evictAll(table);
+    // Record 0 holds several values, it is evicted once per value
+    ASSERT_FALSE( order.empty() );
+    EXPECT_EQ(0, order[0]) << "find() and insert() must not promote a probationary record";
+}
+
+TEST(LRUHashTable,
+     ProbationaryRecordsEvictedFirst)
+{
+    Table table;
+
+    table.setReplacementPolicy(eCacheReplacementPolicy2Q);
+    insertRange(table, 0, 4);
+    for (int i = 0; i < 4; ++i) {
+        lookUp(table, i, NATRON_CACHE_2Q_PROMOTION_HITS);
+    }
+    // A one-pass scan: 16 records never looked-up again
+    insertRange(table, 4, 20);
+
+    // Protected records, least recently used first: 0 becomes the most recently used one
+    lookUp(table, 0, 1);
+
+    std::vector<int> order = evictAll(table);
+    ASSERT_EQ(20u, order.size());
+
+    // The scan only recycles its own records until the probationary segment is within its share
+    std::size_t i = 0;
+    for (; i < order.size() && order[i] >= 4; ++i) {
+        EXPECT_EQ( (int)i + 4, order[i] );
+    }
+    ASSERT_LT( i, order.size() );
+    EXPECT_GE(i, 14u);
+
+    // Then the least recently used protected record
+    EXPECT_EQ(1, order[i]);
+    EXPECT_EQ(0, order[order.size() - 1]);
+}
+
+TEST(LRUHashTable,
+     GhostReAdmittedAsProtected)
+{
+    Table table;
+
+    table.setReplacementPolicy(eCacheReplacementPolicy2Q);
+    insertRange(table, 0, 1);
+    EXPECT_EQ( 0, table.evict().first );
+    EXPECT_EQ(0u, table.size());
+
+    // 0 is still in the ghost list: it goes directly to the protected segment
+    insertRange(table, 0, 1);
+    insertRange(table, 1, 9);
+
+    std::vector<int> order = evictAll(table);
+    ASSERT_EQ(9u, order.size());
+    EXPECT_EQ(1, order[0]);
+    EXPECT_EQ(0, order[8]) << "A record evicted recently from probation must be re-admitted as protected";
+
+    // With the LRU policy there are no ghosts: the records are evicted in insertion order
+    table.setReplacementPolicy(eCacheReplacementPolicyLRU);
+    insertRange(table, 0, 4);
+    order = evictAll(table);
+    ASSERT_EQ(4u, order.size());
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(i, order[i]);
+    }
+}
+
+TEST(LRUHashTable,
+     EraseKeepsFirstProtectedValid)
+{
+    Table table;
+
+    table.setReplacementPolicy(eCacheReplacementPolicy2Q);
+    insertRange(table, 0, 4);
+    // 0 is the first record of the protected segment, then 1
+    lookUp(table, 0, NATRON_CACHE_2Q_PROMOTION_HITS);
+    lookUp(table, 1, NATRON_CACHE_2Q_PROMOTION_HITS);
+
+    table.erase( table.find(0) );
+    EXPECT_EQ(3u, table.size());
+
+    // New probationary records are inserted before the first protected record
+    insertRange(table, 4, 6);
+    lookUp(table, 4, NATRON_CACHE_2Q_PROMOTION_HITS);
+
+    std::vector<int> order = evictAll(table);
+    ASSERT_EQ(5u, order.size());
+    EXPECT_EQ(2, order[0]);
+    EXPECT_EQ(3, order[1]);
+    EXPECT_EQ(5, order[2]);
+    EXPECT_EQ(1, order[3]);
+    EXPECT_EQ(4, order[4]);
+
+    // Erasing the only protected record empties the protected segment
+    insertRange(table, 0, 2);
+    lookUp(table, 0, NATRON_CACHE_2Q_PROMOTION_HITS);
+    table.erase( table.find(0) );
+    insertRange(table, 6, 7);
+    order = evictAll(table);
+    ASSERT_EQ(2u, order.size());
+    EXPECT_EQ(1, order[0]);
+    EXPECT_EQ(6, order[1]);
+}
@@ -24,8 +24,17 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
 #include <gtest/gtest.h>
+
+#include <boost/math/special_functions/fpclassify.hpp>
+
+#include "Engine/ImageConvertSIMD.h"
 #include "Engine/Lut.h"
 
 NATRON_NAMESPACE_USING
@@ -51,3 +60,131 @@ TEST(Lut, IntConversions) {
         EXPECT_EQ( i, uint8xxToChar( charToUint8xx(i) ) );
     }
 }
+
+static std::vector<const Lut*>
+getBuiltinLuts()
+{
+    std::vector<const Lut*> luts;
+
+    luts.push_back( LutManager::sRGBLut() );
+    luts.push_back( LutManager::Rec709Lut() );
+    luts.push_back( LutManager::CineonLut() );
+    luts.push_back( LutManager::Gamma1_8Lut() );
+    luts.push_back( LutManager::Gamma2_2Lut() );
+    luts.push_back( LutManager::PanalogLut() );
+    luts.push_back( LutManager::ViperLogLut() );
+    luts.push_back( LutManager::REDLogLut() );
+    luts.push_back( LutManager::AlexaV3LogCLut() );
+    luts.push_back( LutManager::SLog1Lut() );
+    luts.push_back( LutManager::SLog2Lut() );
+    luts.push_back( LutManager::SLog3Lut() );
+    luts.push_back( LutManager::VLogLut() );
+    for (std::size_t i = 0; i < luts.size(); ++i) {
+        luts[i]->validate();
+    }
+
+    return luts;
+}
+
+static void
+expectNear(float exact,
+           float fast,
+           const Lut* lut,
+           float v)
+{
+    if ( (boost::math::isnan)(exact) ) {
+        EXPECT_TRUE( (boost::math::isnan)(fast) ) << lut->getName() << " at " << v;
+    } else {
+        EXPECT_NEAR( exact, fast, 2e-5 * std::max(1.f, std::abs(exact)) ) << lut->getName() << " at " << v;
+    }
+}
+
+TEST(Lut, FloatAccuracy) {
+    std::vector<const Lut*> luts = getBuiltinLuts();
+
+    for (std::size_t i = 0; i < luts.size(); ++i) {
+        const Lut* lut = luts[i];
+        // Values slightly outside of [0,1] are common
+        for (int k = -1000; k <= 12000; ++k) {
+            const float v = k / 10000.f;
+            expectNear( lut->fromColorSpaceFloatToLinearFloat(v), lut->fromColorSpaceFloatToLinearFloatFast(v), lut, v );
+            expectNear( lut->toColorSpaceFloatFromLinearFloat(v), lut->toColorSpaceFloatFromLinearFloatFast(v), lut, v );
+        }
+        // Small values, around the smallest value of the tables
+        for (float v = 1e-7f; v < 1e-2f; v *= 1.01f) {
+            expectNear( lut->fromColorSpaceFloatToLinearFloat(v), lut->fromColorSpaceFloatToLinearFloatFast(v), lut, v );
+            expectNear( lut->toColorSpaceFloatFromLinearFloat(v), lut->toColorSpaceFloatFromLinearFloatFast(v), lut, v );
+        }
+    }
+}
+
+TEST(Lut, Uint16Tables) {
+    std::vector<const Lut*> luts = getBuiltinLuts();
+
+    for (std::size_t i = 0; i < luts.size(); ++i) {
+        const Lut* lut = luts[i];
+        for (int v = 0; v < 0x10000; ++v) {
+            // The 16-bit table is exact
+            EXPECT_EQ( lut->fromColorSpaceFloatToLinearFloat( intToFloat<65536>(v) ), lut->fromColorSpaceUint16ToLinearFloatFast(v) );
+        }
+        for (int v = 0; v < 0x100; ++v) {
+            EXPECT_EQ( lut->fromColorSpaceUint8ToLinearFloatFast(v), lut->fromColorSpaceUint16ToLinearFloatFast( charToUint16(v) ) );
+        }
+    }
+
+    // The round-trip is the identity, within 1 for increasing functions without a clamp
+    const Lut* lut = LutManager::sRGBLut();
+    for (int v = 0; v < 0x10000; ++v) {
+        EXPECT_LE( std::abs( lut->toColorSpaceUint16FromLinearFloatFast( lut->fromColorSpaceUint16ToLinearFloatFast(v) ) - v ), 1 );
+    }
+}
+
+TEST(Lut, SIMDIsBitExact) {
+    const Lut* lut = LutManager::sRGBLut();
+
+    lut->validate();
+    // Values inside and outside the tables, including negative values, infinity and NaN
+    std::vector<float> from;
+    srand(2000);
+    for (int i = 0; i < 1000; ++i) {
+        // coverity[dont_call]
+        from.push_back( (rand() / (float)RAND_MAX) * 1.4f - 0.2f );
+    }
+    from[10] = 0.f;
+    from[20] = 1e-9f;
+    from[30] = 1e20f;
+    from[40] = std::numeric_limits<float>::infinity();
+    from[50] = -std::numeric_limits<float>::infinity();
+    from[60] = std::numeric_limits<float>::quiet_NaN();
+    std::vector<unsigned short> shorts(from.size());
+    for (std::size_t i = 0; i < shorts.size(); ++i) {
+        // coverity[dont_call]
+        shorts[i] = (unsigned short)(rand() % 65536);
+    }
+
+    const int n = (int)from.size();
+    std::vector<float> expectedLinear(n), expectedColor(n), expectedShorts(n);
+    std::vector<unsigned short> expectedUint16(n);
+    for (int i = 0; i < n; ++i) {
+        expectedLinear[i] = lut->fromColorSpaceFloatToLinearFloatFast(from[i]);
+        expectedColor[i] = lut->toColorSpaceFloatFromLinearFloatFast(from[i]);
+        expectedShorts[i] = lut->fromColorSpaceUint16ToLinearFloatFast(shorts[i]);
+        expectedUint16[i] = lut->toColorSpaceUint16FromLinearFloatFast(from[i]);
+    }
+
+    const ImageConvertSIMD::InstructionSetEnum supported = ImageConvertSIMD::getSupportedInstructionSet();
+    for (int set = ImageConvertSIMD::eInstructionSetScalar; set <= (int)supported; ++set) {
+        ImageConvertSIMD::setInstructionSet( (ImageConvertSIMD::InstructionSetEnum)set );
+        std::vector<float> linear(n), color(n), fromShorts(n);
+        std::vector<unsigned short> uint16(n);
+        lut->fromColorSpaceFloatToLinearFloatFast(&from[0], &linear[0], n);
+        lut->toColorSpaceFloatFromLinearFloatFast(&from[0], &color[0], n);
+        lut->fromColorSpaceUint16ToLinearFloatFast(&shorts[0], &fromShorts[0], n);
+        lut->toColorSpaceUint16FromLinearFloatFast(&from[0], &uint16[0], n);
+        EXPECT_TRUE(std::memcmp( &expectedLinear[0], &linear[0], n * sizeof(float) ) == 0) << "instruction set " << set;
+        EXPECT_TRUE(std::memcmp( &expectedColor[0], &color[0], n * sizeof(float) ) == 0) << "instruction set " << set;
+        EXPECT_TRUE(std::memcmp( &expectedShorts[0], &fromShorts[0], n * sizeof(float) ) == 0) << "instruction set " << set;
+        EXPECT_TRUE(std::memcmp( &expectedUint16[0], &uint16[0], n * sizeof(unsigned short) ) == 0) << "instruction set " << set;
+    }
+    ImageConvertSIMD::setInstructionSet(supported);
+}
@@ -0,0 +1,221 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <bitset>
+#include <list>
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include "BaseTest.h"
+
+#include "Engine/AppInstance.h"
+#include "Engine/CreateNodeArgs.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/GroupInput.h"
+#include "Engine/GroupOutput.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+#include "Engine/Project.h"
+#include "Engine/RenderStats.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+typedef std::map<NodePtr, U64> NodeHashes;
+
+/// Gives access to the hash passes of Node. Never instantiated.
+class NodeHashPass
+    : public Node
+{
+public:
+
+    /// Rehashes every node in the project, whether its inputs changed or not
+    static void computeHashOfAllNodes(const AppInstancePtr& app)
+    {
+        NodesList nodes;
+
+        app->getProject()->getNodes_recursive(nodes, false);
+        std::list<Node*> roots;
+        for (NodesList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+            roots.push_back( it->get() );
+        }
+        computeHashOfNodes(roots);
+    }
+};
+
+NodePtr
+createNodeNoAutoConnect(const AppInstancePtr& app,
+                        CreateNodeArgs& args)
+{
+    args.setProperty<bool>(kCreateNodeArgsPropAutoConnect, false);
+    args.setProperty<bool>(kCreateNodeArgsPropAddUndoRedoCommand, false);
+    args.setProperty<bool>(kCreateNodeArgsPropSettingsOpened, false);
+
+    return app->createNode(args);
+}
+
+/// The hash passes jump over groups and their input and output nodes to the nodes behind them, as renders do:
+/// their own hash is not maintained and a full recompute differs.
+bool
+isSkippedByHashPasses(const NodePtr& node)
+{
+    EffectInstance* effect = node->getEffectInstance().get();
+
+    return node->isEffectGroup() || dynamic_cast<GroupInput*>(effect) || dynamic_cast<GroupOutput*>(effect);
+}
+
+NodeHashes
+getAllHashes(const AppInstancePtr& app)
+{
+    NodesList nodes;
+
+    app->getProject()->getNodes_recursive(nodes, false);
+    NodeHashes ret;
+    for (NodesList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        ret[*it] = (*it)->getHashValue();
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Checks the hashes left by an incremental pass (after) against a full recompute of the project, and that the
+ * number of nodes rehashed by the pass, as reported in the render statistics of root, is the number of nodes whose hash changed.
+ **/
+void
+checkIncrementalHash(const AppInstancePtr& app,
+                     const NodePtr& root,
+                     const NodeHashes& before,
+                     const char* change)
+{
+    NodeHashes after = getAllHashes(app);
+    int nbChanged = 0;
+
+    for (NodeHashes::iterator it = after.begin(); it != after.end(); ++it) {
+        NodeHashes::const_iterator found = before.find(it->first);
+        if ( ( found == before.end() ) || (found->second != it->second) ) {
+            ++nbChanged;
+        }
+    }
+    EXPECT_NE( before.find(root)->second, after[root] ) << change;
+
+    RenderStats stats(true);
+    stats.setGlobalRenderInfosForNode(root, RectD(), eImagePremultiplicationOpaque, std::bitset<4>(), true, true, 0);
+    double timeSpent;
+    std::map<NodePtr, NodeRenderStats> nodeStats = stats.getStats(&timeSpent);
+    EXPECT_EQ( nbChanged, nodeStats[root].getNbNodesRehashed() ) << change;
+
+    // The full recompute is a fixed point: twice in a row gives the same hashes
+    for (int i = 0; i < 2; ++i) {
+        NodeHashPass::computeHashOfAllNodes(app);
+        NodeHashes full = getAllHashes(app);
+        for (NodeHashes::iterator it = after.begin(); it != after.end(); ++it) {
+            if ( !isSkippedByHashPasses(it->first) ) {
+                EXPECT_EQ( it->second, full[it->first] ) << change << ": " << it->first->getScriptName();
+            }
+        }
+    }
+} // checkIncrementalHash
+}
+
+TEST_F(BaseTest, IncrementalNodeHash)
+{
+    // generator -> dot -> join
+    //           -> group -> dot2
+    // generator2 -> other
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr generator2 = createNode(_generatorPluginID);
+    NodePtr dot = createNode( QString::fromUtf8(PLUGINID_NATRON_DOT) );
+    NodePtr dot2 = createNode( QString::fromUtf8(PLUGINID_NATRON_DOT) );
+    NodePtr join = createNode( QString::fromUtf8(PLUGINID_NATRON_DOT) );
+    NodePtr other = createNode( QString::fromUtf8(PLUGINID_NATRON_DOT) );
+    ASSERT_TRUE(generator && generator2 && dot && dot2 && join && other);
+
+    NodePtr group;
+    {
+        CreateNodeArgs args( PLUGINID_NATRON_GROUP, getApp()->getProject() );
+        args.setProperty<bool>(kCreateNodeArgsPropNodeGroupDisableCreateInitialNodes, true);
+        group = createNodeNoAutoConnect(getApp(), args);
+    }
+    ASSERT_TRUE(group);
+    NodeGroupPtr groupEffect = boost::dynamic_pointer_cast<NodeGroup>( group->getEffectInstance() );
+    ASSERT_TRUE(groupEffect);
+    NodePtr groupInput, groupOutput, groupDot;
+    {
+        CreateNodeArgs args(PLUGINID_NATRON_INPUT, groupEffect);
+        groupInput = createNodeNoAutoConnect(getApp(), args);
+    }
+    {
+        CreateNodeArgs args(PLUGINID_NATRON_OUTPUT, groupEffect);
+        groupOutput = createNodeNoAutoConnect(getApp(), args);
+    }
+    {
+        CreateNodeArgs args(PLUGINID_NATRON_DOT, groupEffect);
+        groupDot = createNodeNoAutoConnect(getApp(), args);
+    }
+    ASSERT_TRUE(groupInput && groupOutput && groupDot);
+
+    connectNodes(groupInput, groupOutput, 0, true);
+    connectNodes(generator, dot, 0, true);
+    connectNodes(dot, join, 0, true);
+    connectNodes(generator, group, 0, true);
+    connectNodes(group, dot2, 0, true);
+    connectNodes(generator2, other, 0, true);
+
+    // Knob change
+    {
+        NodeHashes before = getAllHashes( getApp() );
+        KnobDouble* knob = dynamic_cast<KnobDouble*>( generator->getKnobByName("noiseZSlope").get() );
+        ASSERT_TRUE(knob);
+        knob->setValue(knob->getValue() + 0.5);
+        checkIncrementalHash(getApp(), generator, before, "knob change");
+        EXPECT_EQ( before[generator2], generator2->getHashValue() ) << "unrelated branch rehashed";
+        EXPECT_EQ( before[other], other->getHashValue() ) << "unrelated branch rehashed";
+    }
+
+    // Input reconnected to another branch
+    {
+        disconnectNodes(dot, join, true);
+        NodeHashes before = getAllHashes( getApp() );
+        connectNodes(other, join, 0, true);
+        checkIncrementalHash(getApp(), join, before, "input reconnect");
+        EXPECT_EQ( before[generator], generator->getHashValue() );
+        EXPECT_EQ( before[dot2], dot2->getHashValue() );
+    }
+
+    // Node inserted in the group: group input -> groupDot -> group output
+    {
+        disconnectNodes(groupInput, groupOutput, true);
+        connectNodes(groupInput, groupDot, 0, true);
+        NodeHashes before = getAllHashes( getApp() );
+        connectNodes(groupDot, groupOutput, 0, true);
+        checkIncrementalHash(getApp(), groupOutput, before, "group edit");
+        EXPECT_NE( before[dot2], dot2->getHashValue() ) << "the outputs of the group depend on the nodes inside";
+        EXPECT_EQ( before[join], join->getHashValue() );
+    }
+}
@@ -0,0 +1,108 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <gtest/gtest.h>
+
+#include "Engine/ParallelRenderController.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+ParallelRenderMeasure
+makeMeasure(int nFramesInFlight,
+            double throughput,
+            double cpuUsage,
+            double memoryPressure = 0.5)
+{
+    ParallelRenderMeasure measure;
+
+    measure.nFramesInFlight = nFramesInFlight;
+    measure.throughput = throughput;
+    measure.frameTime = nFramesInFlight / throughput;
+    measure.cpuUsage = cpuUsage;
+    measure.memoryPressure = memoryPressure;
+
+    return measure;
+}
+}
+
+TEST(ParallelRenderController, AddsFramesWhileCPUsAreIdle)
+{
+    ParallelRenderController controller;
+
+    controller.reset(8, 8);
+    EXPECT_EQ( 1, controller.getFramesInFlight() );
+    EXPECT_EQ( 8, controller.getTileThreadsPerFrame() );
+
+    controller.decide( makeMeasure(1, 1., 0.2) );
+    EXPECT_EQ( 2, controller.getFramesInFlight() );
+    EXPECT_EQ( 4, controller.getTileThreadsPerFrame() );
+
+    // the CPUs are busy and the last frame did not make the render faster
+    controller.decide( makeMeasure(2, 1.02, 0.95) );
+    EXPECT_EQ( 2, controller.getFramesInFlight() );
+}
+
+TEST(ParallelRenderController, RevertsSlowerSetting)
+{
+    ParallelRenderController controller;
+
+    controller.reset(8, 8);
+    controller.decide( makeMeasure(1, 2., 0.5) );
+    EXPECT_EQ( 2, controller.getFramesInFlight() );
+
+    // adding a frame made the render slower: revert, and do not try 2 frames again right away
+    controller.decide( makeMeasure(2, 1.5, 0.5) );
+    EXPECT_EQ( 1, controller.getFramesInFlight() );
+    controller.decide( makeMeasure(1, 2., 0.5) );
+    EXPECT_EQ( 1, controller.getFramesInFlight() );
+
+    // until the setting was kept for a while
+    for (int i = 1; i < NATRON_PARALLEL_RENDERS_RETRY_MEASURES; ++i) {
+        controller.decide( makeMeasure(1, 2., 0.5) );
+    }
+    controller.decide( makeMeasure(1, 2., 0.5) );
+    EXPECT_EQ( 2, controller.getFramesInFlight() );
+}
+
+TEST(ParallelRenderController, RespectsLimits)
+{
+    ParallelRenderController controller;
+
+    controller.reset(2, 4);
+    controller.decide( makeMeasure(1, 1., 0.1) );
+    controller.decide( makeMeasure(2, 2., 0.1) );
+    EXPECT_EQ( 2, controller.getFramesInFlight() );
+
+    // a full image cache removes a frame
+    controller.decide( makeMeasure(2, 2., 0.1, 1.) );
+    EXPECT_EQ( 1, controller.getFramesInFlight() );
+
+    // and no frame is added while it is almost full
+    controller.reset(8, 8);
+    controller.decide( makeMeasure(1, 1., 0.1, 0.97) );
+    EXPECT_EQ( 1, controller.getFramesInFlight() );
+}
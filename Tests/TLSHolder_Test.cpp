@@ -0,0 +1,124 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <gtest/gtest.h>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/make_shared.hpp>
+#endif
+
+#include <QtCore/QThread>
+
+#include "BaseTest.h"
+
+#include "Engine/AppManager.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/TLSHolder.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+typedef TLSHolder<EffectInstance::EffectTLSData> EffectTLSHolder;
+
+/// Reads the TLS of a holder in a thread spawned by another thread
+class SpawnedThread
+    : public QThread
+{
+public:
+
+    SpawnedThread(QThread* spawner,
+                  const boost::shared_ptr<EffectTLSHolder>& holder,
+                  const TLSSnapshotPtr& snapshot = TLSSnapshotPtr())
+        : QThread()
+        , spawner(spawner)
+        , snapshot(snapshot)
+        , holder(holder)
+        , inheritedRecursionLevel(-1)
+        , hasTLSAfterCleanup(true)
+    {
+    }
+
+    void run() OVERRIDE
+    {
+        if (snapshot) {
+            appPTR->getAppTLS()->softCopy(snapshot, spawner, this);
+        } else {
+            appPTR->getAppTLS()->softCopy(spawner, this);
+        }
+        EffectInstance::EffectTLSDataPtr tls = holder->getTLSData();
+        if (tls) {
+            inheritedRecursionLevel = tls->actionRecursionLevel;
+            // the copy belongs to this thread
+            ++tls->actionRecursionLevel;
+        }
+        appPTR->getAppTLS()->cleanupTLSForThread();
+        hasTLSAfterCleanup = (bool)holder->getTLSData();
+    }
+
+    QThread* spawner;
+    TLSSnapshotPtr snapshot;
+    boost::shared_ptr<EffectTLSHolder> holder;
+    int inheritedRecursionLevel;
+    bool hasTLSAfterCleanup;
+};
+}
+
+TEST_F(BaseTest, TLSSpawnerThread)
+{
+    boost::shared_ptr<EffectTLSHolder> holder = boost::make_shared<EffectTLSHolder>();
+
+    holder->getOrCreateTLSData()->actionRecursionLevel = 3;
+
+    SpawnedThread thread(QThread::currentThread(), holder);
+    thread.start();
+    thread.wait();
+    EXPECT_EQ(3, thread.inheritedRecursionLevel);
+    EXPECT_FALSE(thread.hasTLSAfterCleanup);
+    // the spawner thread keeps its own value
+    EXPECT_EQ(3, holder->getTLSData()->actionRecursionLevel);
+
+    // a new holder never sees the data of a destroyed holder
+    holder.reset();
+    boost::shared_ptr<EffectTLSHolder> other = boost::make_shared<EffectTLSHolder>();
+    EXPECT_FALSE( other->getTLSData() );
+}
+
+TEST_F(BaseTest, TLSSnapshot)
+{
+    boost::shared_ptr<EffectTLSHolder> holder = boost::make_shared<EffectTLSHolder>();
+
+    holder->getOrCreateTLSData()->actionRecursionLevel = 3;
+    TLSSnapshotPtr snapshot = appPTR->getAppTLS()->takeSnapshot();
+    // the spawner thread modifies its TLS after the snapshot
+    holder->getTLSData()->actionRecursionLevel = 5;
+
+    SpawnedThread thread(QThread::currentThread(), holder, snapshot);
+    thread.start();
+    thread.wait();
+    EXPECT_EQ(3, thread.inheritedRecursionLevel);
+    EXPECT_FALSE(thread.hasTLSAfterCleanup);
+    EXPECT_EQ(5, holder->getTLSData()->actionRecursionLevel);
+}
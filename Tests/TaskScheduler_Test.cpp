@@ -0,0 +1,132 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/bind.hpp>
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThread>
+
+#include "Engine/TaskScheduler.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+/// Starts a loop of 4 indices in each index, down to depth 0, and counts the leaves
+void
+nestedTask(TaskScheduler* scheduler,
+           int depth,
+           QAtomicInt* leaves,
+           int index)
+{
+    Q_UNUSED(index);
+    if (depth == 0) {
+        leaves->fetchAndAddRelaxed(1);
+
+        return;
+    }
+    scheduler->parallelFor( 4, boost::bind(nestedTask, scheduler, depth - 1, leaves, _1) );
+}
+
+void
+failingTask(QAtomicInt* calls,
+            int index)
+{
+    calls->fetchAndAddRelaxed(1);
+    if (index == 3) {
+        throw std::runtime_error("failed");
+    }
+}
+
+/// Starts nested loops from a thread that is not a worker
+class SubmitterThread
+    : public QThread
+{
+public:
+
+    SubmitterThread(TaskScheduler* scheduler)
+        : QThread()
+        , scheduler(scheduler)
+        , leaves(0)
+    {
+    }
+
+    void run() OVERRIDE
+    {
+        for (int i = 0; i < 10; ++i) {
+            scheduler->parallelFor( 4, boost::bind(nestedTask, scheduler, 3, &leaves, _1) );
+        }
+    }
+
+    TaskScheduler* scheduler;
+    QAtomicInt leaves;
+};
+}
+
+TEST(TaskScheduler, NestedLoops)
+{
+    // fewer workers than the parallelism of the loops: the waiting threads must complete their own loops
+    TaskScheduler scheduler(3);
+    QAtomicInt leaves(0);
+
+    scheduler.parallelFor( 4, boost::bind(nestedTask, &scheduler, 6, &leaves, _1) );
+    EXPECT_EQ(16384, (int)leaves);
+    EXPECT_EQ( 3, scheduler.getNumWorkers() );
+}
+
+TEST(TaskScheduler, ConcurrentSubmitters)
+{
+    TaskScheduler scheduler(2);
+    std::vector<SubmitterThread*> threads;
+
+    for (int i = 0; i < 8; ++i) {
+        threads.push_back( new SubmitterThread(&scheduler) );
+    }
+    for (std::size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->start();
+    }
+    for (std::size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->wait();
+        EXPECT_EQ(10 * 256, (int)threads[i]->leaves);
+        delete threads[i];
+    }
+}
+
+TEST(TaskScheduler, Exception)
+{
+    TaskScheduler scheduler(2);
+    QAtomicInt calls(0);
+
+    EXPECT_THROW(scheduler.parallelFor( 16, boost::bind(failingTask, &calls, _1) ), std::runtime_error);
+    // the other calls still ran
+    EXPECT_EQ(16, (int)calls);
+}
@@ -43,11 +43,21 @@ SOURCES += \
     google-test/src/gtest-all.cc \
     google-mock/src/gmock-all.cc \
     BaseTest.cpp \
+    Cache_Test.cpp \
+    CacheTOCJournal_Test.cpp \
     Hash64_Test.cpp \
     Image_Test.cpp \
     Lut_Test.cpp \
+    LRUHashTable_Test.cpp \
     KnobFile_Test.cpp \
     Curve_Test.cpp \
+    KnobExpression_Test.cpp \
+    NodeHash_Test.cpp \
+    TLSHolder_Test.cpp \
+    ParallelRenderController_Test.cpp \
+    TaskScheduler_Test.cpp \
+    TileUsageBitmap_Test.cpp \
+    ViewerPrefetch_Test.cpp \
     Tracker_Test.cpp \
     wmain.cpp
 
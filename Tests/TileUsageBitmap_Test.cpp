@@ -0,0 +1,163 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Engine/CacheEntry.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+// A summary word covers 64 words of 64 tiles
+const std::size_t kTilesPerSummaryWord = 64 * 64;
+
+/// Same test as the one done by the cache to remove a tile file
+bool
+isFileEmpty(const TileUsageBitmap& bitmap)
+{
+    return bitmap.getNumFreeTiles() == bitmap.size();
+}
+
+void
+fill(TileUsageBitmap& bitmap)
+{
+    for (std::size_t i = 0; i < bitmap.size(); ++i) {
+        ASSERT_EQ( (int)i, bitmap.allocFirstFree() );
+    }
+    EXPECT_EQ( 0u, bitmap.getNumFreeTiles() );
+    EXPECT_EQ( -1, bitmap.allocFirstFree() );
+}
+}
+
+TEST(TileUsageBitmap,
+     FillSizesAroundWordBoundaries)
+{
+    // Partial tile word, partial summary word, exactly one summary word, exactly one full summary level...
+    const std::size_t sizes[] = {
+        1, 63, 64, 65, kTilesPerSummaryWord - 1, kTilesPerSummaryWord, kTilesPerSummaryWord + 1,
+        2 * kTilesPerSummaryWord + 100, 64 * kTilesPerSummaryWord
+    };
+
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        TileUsageBitmap bitmap;
+        bitmap.resize(sizes[s]);
+        EXPECT_EQ( sizes[s], bitmap.size() );
+        EXPECT_TRUE( isFileEmpty(bitmap) );
+        fill(bitmap);
+        EXPECT_FALSE( isFileEmpty(bitmap) ) << sizes[s];
+    }
+}
+
+TEST(TileUsageBitmap,
+     FreeAndReallocate)
+{
+    TileUsageBitmap bitmap;
+    const std::size_t nTiles = 2 * kTilesPerSummaryWord + 100;
+
+    bitmap.resize(nTiles);
+    fill(bitmap);
+
+    // Free tiles on each side of the tile and summary word boundaries, in decreasing order
+    const std::size_t freed[] = {
+        nTiles - 1, 2 * kTilesPerSummaryWord, 2 * kTilesPerSummaryWord - 1, kTilesPerSummaryWord, kTilesPerSummaryWord - 1, 64, 63, 0
+    };
+    const std::size_t nFreed = sizeof(freed) / sizeof(freed[0]);
+    for (std::size_t i = 0; i < nFreed; ++i) {
+        bitmap.setUsed(freed[i], false);
+        EXPECT_FALSE( bitmap.isUsed(freed[i]) );
+    }
+    EXPECT_EQ( nFreed, bitmap.getNumFreeTiles() );
+
+    // The lowest free tile is always returned first, whatever the summary word it is in
+    for (std::size_t i = 0; i < nFreed; ++i) {
+        EXPECT_EQ( (int)freed[nFreed - 1 - i], bitmap.allocFirstFree() );
+    }
+    EXPECT_EQ( -1, bitmap.allocFirstFree() );
+
+    // A tile freed in a summary word before the last allocated one is found again
+    bitmap.setUsed(kTilesPerSummaryWord + 5, false);
+    bitmap.setUsed(10, false);
+    EXPECT_EQ( 10, bitmap.allocFirstFree() );
+    EXPECT_EQ( (int)kTilesPerSummaryWord + 5, bitmap.allocFirstFree() );
+    EXPECT_EQ( -1, bitmap.allocFirstFree() );
+}
+
+TEST(TileUsageBitmap,
+     SetUsedSkippedByAllocation)
+{
+    // The tiles of the entries restored from the table of contents are marked used directly
+    TileUsageBitmap bitmap;
+
+    bitmap.resize(kTilesPerSummaryWord + 64);
+    for (std::size_t i = 0; i < kTilesPerSummaryWord; ++i) {
+        bitmap.setUsed(i, true);
+    }
+    // Setting a used tile again does not change the count
+    bitmap.setUsed(0, true);
+    EXPECT_EQ( 64u, bitmap.getNumFreeTiles() );
+    EXPECT_EQ( (int)kTilesPerSummaryWord, bitmap.allocFirstFree() );
+}
+
+TEST(TileUsageBitmap,
+     FileEmptyDetection)
+{
+    TileUsageBitmap bitmap;
+    const std::size_t nTiles = 2 * kTilesPerSummaryWord + 100;
+
+    bitmap.resize(nTiles);
+    fill(bitmap);
+
+    // Keep the last tile of each summary word and the first tile of the next one for last
+    const std::size_t kept[] = {
+        kTilesPerSummaryWord - 1, kTilesPerSummaryWord, 2 * kTilesPerSummaryWord - 1, 2 * kTilesPerSummaryWord, nTiles - 1
+    };
+    const std::size_t nKept = sizeof(kept) / sizeof(kept[0]);
+    std::vector<bool> isKept(nTiles, false);
+    for (std::size_t i = 0; i < nKept; ++i) {
+        isKept[kept[i]] = true;
+    }
+    for (std::size_t i = 0; i < nTiles; ++i) {
+        if (!isKept[i]) {
+            bitmap.setUsed(i, false);
+        }
+    }
+    for (std::size_t i = 0; i < nKept; ++i) {
+        EXPECT_FALSE( isFileEmpty(bitmap) ) << "tile " << kept[i] << " is still used";
+        bitmap.setUsed(kept[i], false);
+        // Freeing a free tile again does not change the count
+        bitmap.setUsed(kept[i], false);
+    }
+    EXPECT_TRUE( isFileEmpty(bitmap) );
+
+    // The file is reusable from its first tile
+    EXPECT_EQ( 0, bitmap.allocFirstFree() );
+    EXPECT_FALSE( isFileEmpty(bitmap) );
+    bitmap.setUsed(0, false);
+    EXPECT_TRUE( isFileEmpty(bitmap) );
+}
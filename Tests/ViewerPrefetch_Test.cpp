@@ -0,0 +1,72 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Engine/OutputSchedulerThread.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+std::vector<int>
+makeFrames(int n,
+           const int* values)
+{
+    return std::vector<int>(values, values + n);
+}
+}
+
+TEST(ViewerPrefetchTest, FramesAroundCurrentFrame)
+{
+    std::vector<int> frames;
+
+    // Two frames ahead for each frame behind
+    ViewerPrefetchScheduler::getFramesToPrefetch(10, 1, 100, 6, true, &frames);
+    const int forward[] = { 11, 12, 9, 13, 14, 8 };
+    EXPECT_EQ(makeFrames(6, forward), frames);
+
+    ViewerPrefetchScheduler::getFramesToPrefetch(10, 1, 100, 6, false, &frames);
+    const int backward[] = { 9, 8, 11, 7, 6, 12 };
+    EXPECT_EQ(makeFrames(6, backward), frames);
+
+    // Once a side reaches the in or out point, the other side gets the remaining frames
+    ViewerPrefetchScheduler::getFramesToPrefetch(99, 1, 100, 5, true, &frames);
+    const int atOutPoint[] = { 100, 98, 97, 96, 95 };
+    EXPECT_EQ(makeFrames(5, atOutPoint), frames);
+
+    // Never more than the frames within the in and out points
+    ViewerPrefetchScheduler::getFramesToPrefetch(2, 1, 4, 10, true, &frames);
+    const int all[] = { 3, 4, 1 };
+    EXPECT_EQ(makeFrames(3, all), frames);
+
+    ViewerPrefetchScheduler::getFramesToPrefetch(1, 1, 1, 10, true, &frames);
+    EXPECT_TRUE( frames.empty() );
+
+    ViewerPrefetchScheduler::getFramesToPrefetch(10, 1, 100, 0, true, &frames);
+    EXPECT_TRUE( frames.empty() );
+}